@@ -26,9 +26,9 @@
 #define USED_UART_DEBUG_PORT    0
 
 #if (USED_UART_DEBUG_PORT==0)
-#define DEBUG_UART_PORT    LPC_UART0
+#define DEBUG_UART_PORT    ((LPC_UART_TypeDef *)LPC_UART0)
 #elif (USED_UART_DEBUG_PORT==1)
-#define DEBUG_UART_PORT    LPC_UART1
+#define DEBUG_UART_PORT    ((LPC_UART_TypeDef *)LPC_UART1)
 #endif
 
 #define _DBG(x)         _db_msg(DEBUG_UART_PORT, x)
@@ -30,6 +30,7 @@
 /* Includes ------------------------------------------------------------------- */
 #include "LPC17xx.h"
 #include "lpc_types.h"
+#include "lpc17xx_gpdma.h"
 
 
 #ifdef __cplusplus
@@ -67,12 +68,62 @@ extern "C"
  */
 
 
-/* EMAC Memory Buffer configuration for 16K Ethernet RAM */
+/* EMAC Memory Buffer configuration for 16K Ethernet RAM. Ring sizes and
+ * the fragment size may be set on the compiler command line. A frame longer
+ * than EMAC_FRAG_SIZE spans several descriptors: with -DEMAC_FRAG_SIZE=256
+ * -DEMAC_NUM_RX_FRAG=40 -DEMAC_NUM_TX_FRAG=14 up to 39 small frames can wait
+ * in the Rx ring instead of 3. */
+#ifndef EMAC_NUM_RX_FRAG
 #define EMAC_NUM_RX_FRAG         4           /**< Num.of RX Fragments 4*1536= 6.0kB */
+#endif
+#ifndef EMAC_NUM_TX_FRAG
 #define EMAC_NUM_TX_FRAG         3           /**< Num.of TX Fragments 3*1536= 4.6kB */
+#endif
 #define EMAC_ETH_MAX_FLEN        1536        /**< Max. Ethernet Frame Size          */
+#ifndef EMAC_FRAG_SIZE
+#define EMAC_FRAG_SIZE           EMAC_ETH_MAX_FLEN /**< Size of one packet buffer   */
+#endif
 #define EMAC_TX_FRAME_TOUT       0x00100000  /**< Frame Transmit timeout count      */
 
+/** Linker section of the descriptors and packet buffers, must be in AHB SRAM */
+#ifndef EMAC_RAM_SECTION
+#define EMAC_RAM_SECTION         ".ahbram1"
+#endif
+/** Size of the memory behind EMAC_RAM_SECTION */
+#ifndef EMAC_RAM_SIZE
+#define EMAC_RAM_SIZE            0x4000
+#endif
+
+/** Fragments taken by a frame of EMAC_ETH_MAX_FLEN bytes */
+#define EMAC_FRAGS_PER_FRAME     ((EMAC_ETH_MAX_FLEN + EMAC_FRAG_SIZE - 1) / EMAC_FRAG_SIZE)
+/** Bytes taken by packet buffers, descriptors and statuses of both rings */
+#define EMAC_RAM_USED            ((EMAC_NUM_RX_FRAG * (EMAC_FRAG_SIZE + 16)) + \
+                                  (EMAC_NUM_TX_FRAG * (EMAC_FRAG_SIZE + 12)))
+
+#if ((EMAC_FRAG_SIZE & 3) != 0) || (EMAC_FRAG_SIZE < 64) || (EMAC_FRAG_SIZE > 2048)
+#error "EMAC_FRAG_SIZE must be a multiple of 4 in range from 64 to 2048"
+#endif
+#if (EMAC_NUM_RX_FRAG <= EMAC_FRAGS_PER_FRAME) || (EMAC_NUM_TX_FRAG <= EMAC_FRAGS_PER_FRAME)
+#error "EMAC rings must hold a maximum size frame plus one descriptor"
+#endif
+#if (EMAC_RAM_USED > EMAC_RAM_SIZE)
+#error "EMAC rings do not fit in EMAC_RAM_SIZE, reduce the ring sizes or EMAC_FRAG_SIZE"
+#endif
+
+/* CRC32 engine behind EMAC_CRC32(): EMAC_CRC32_NIBBLE uses a 64 byte table
+ * and two lookups per byte, EMAC_CRC32_SLICE4 uses 4kB of tables in flash
+ * and one lookup per byte, four bytes per loop iteration. */
+#define EMAC_CRC32_NIBBLE        1           /**< 16 entry table, 4 bits per step   */
+#define EMAC_CRC32_SLICE4        4           /**< 4x256 entry tables, 32 bits per step */
+#ifndef EMAC_CRC32_ENGINE
+#define EMAC_CRC32_ENGINE        EMAC_CRC32_SLICE4
+#endif
+#if (EMAC_CRC32_ENGINE != EMAC_CRC32_NIBBLE) && (EMAC_CRC32_ENGINE != EMAC_CRC32_SLICE4)
+#error "EMAC_CRC32_ENGINE must be EMAC_CRC32_NIBBLE or EMAC_CRC32_SLICE4"
+#endif
+/** Initial value for EMAC_CRC32Update() */
+#define EMAC_CRC32_INIT          0xFFFFFFFFUL
+
 /* --------------------- BIT DEFINITIONS -------------------------------------- */
 /*********************************************************************//**
  * Macro defines for MAC Configuration Register 1
@@ -625,6 +676,23 @@ typedef struct {
 	uint32_t *pbDataBuf;		/**< A word-align data pointer to data buffer */
 } EMAC_PACKETBUF_Type;
 
+/**
+ * @brief EMAC ring counters, to size EMAC_NUM_RX_FRAG and EMAC_NUM_TX_FRAG
+ * from measurements. Interrupt events are counted by EMAC_IntGetStatus()
+ * when it is asked about them.
+ */
+typedef struct {
+	uint32_t RxFrames;		/**< Frames released with EMAC_UpdateRxConsumeIndex()
+							or EMAC_ReturnRxBuffer() */
+	uint32_t RxErrors;		/**< Released frames with EMAC_RINFO_ERR set */
+	uint32_t RxOverrun;		/**< EMAC_INT_RX_OVERRUN events: frames lost */
+	uint32_t RxPeak;		/**< Most Rx fragments seen waiting for the software */
+	uint32_t TxFrames;		/**< Frames handed to the EMAC */
+	uint32_t TxUnderrun;	/**< EMAC_INT_TX_UNDERRUN events */
+	uint32_t TxErrors;		/**< EMAC_INT_TX_ERR events */
+	uint32_t TxPeak;		/**< Most Tx descriptors in use at once */
+} EMAC_STATS_Type;
+
 /**
  * @brief EMAC configuration structure definition
  */
@@ -664,9 +732,22 @@ int32_t EMAC_UpdatePHYStatus(void);
 void EMAC_SetHashFilter(uint8_t dstMAC_addr[], FunctionalState NewState);
 void EMAC_SetFilterMode(uint32_t ulFilterMode, FunctionalState NewState);
 
+/* CRC functions -------------*/
+uint32_t EMAC_CRC32Update(uint32_t ulCRC, const uint8_t *pbData, uint32_t ulLen);
+uint32_t EMAC_CRC32(const uint8_t *pbData, uint32_t ulLen);
+
 /* EMAC Packet Buffer functions */
 void EMAC_WritePacketBuffer(EMAC_PACKETBUF_Type *pDataStruct);
 void EMAC_ReadPacketBuffer(EMAC_PACKETBUF_Type *pDataStruct);
+Status EMAC_WritePacketBufferDMA(EMAC_PACKETBUF_Type *pDataStruct, GPDMA_XFER_Type *pXfer);
+Status EMAC_ReadPacketBufferDMA(EMAC_PACKETBUF_Type *pDataStruct, GPDMA_XFER_Type *pXfer);
+
+/* Zero-copy packet buffer functions */
+uint32_t *EMAC_BorrowRxBuffer(uint32_t *pulDataLen, Bool *pbLast);
+void EMAC_ReturnRxBuffer(void);
+uint32_t *EMAC_BorrowTxBuffer(void);
+void EMAC_ReturnTxBuffer(uint32_t ulDataLen, Bool bLast);
+Status EMAC_ReferTxBuffer(const uint32_t *pBuf, uint32_t ulDataLen, Bool bLast);
 
 /* EMAC Interrupt functions -------*/
 void EMAC_IntCmd(uint32_t ulIntType, FunctionalState NewState);
@@ -682,6 +763,10 @@ FlagStatus EMAC_CheckReceiveDataStatus(uint32_t ulRxStatType);
 uint32_t EMAC_GetReceiveDataSize(void);
 FlagStatus EMAC_GetWoLStatus(uint32_t ulWoLMode);
 
+/* Ring counters */
+void EMAC_GetStats(EMAC_STATS_Type *pStats);
+void EMAC_ResetStats(void);
+
 /**
  * @}
  */
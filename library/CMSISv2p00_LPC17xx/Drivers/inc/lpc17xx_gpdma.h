@@ -99,6 +99,30 @@ extern "C"
 #define GPDMA_REQSEL_UART 	((0UL)) /**< UART TX/RX is selected */
 #define GPDMA_REQSEL_TIMER 	((1UL)) /**< Timer match is selected */
 
+/** Channel number requesting a channel from the channel manager */
+#define GPDMA_CHANNEL_AUTO 	((0xFFUL))
+
+/** Channel allocation priority definitions. Channel 0 has the highest
+ * hardware priority and channel 7 the lowest */
+#define GPDMA_CHPRIO_HIGH 	((0UL)) /**< Take the lowest free channel number */
+#define GPDMA_CHPRIO_LOW 	((1UL)) /**< Take the highest free channel number */
+
+/** Maximum transfer count of one channel run or linked list item */
+#define GPDMA_MAX_TRANSFERSIZE 	((0xFFFUL))
+/** Number of linked list items needed for a segment of n transfers, usable
+ * to size descriptor arrays at build time */
+#define GPDMA_LLI_ITEMS(n) 	(((n) + GPDMA_MAX_TRANSFERSIZE - 1) / GPDMA_MAX_TRANSFERSIZE)
+
+/** Linked list build options */
+#define GPDMA_LLI_OPT_CIRCULAR 	((1UL<<0)) /**< Last item links back to the first one */
+#define GPDMA_LLI_OPT_INT_SEG 	((1UL<<1)) /**< Terminal count interrupt after every segment,
+											otherwise after the last one only */
+#define GPDMA_LLI_OPT_INT_NONE 	((1UL<<2)) /**< No terminal count interrupt at all */
+
+/** Channel event definitions, passed to channel and transfer callbacks */
+#define GPDMA_EVT_TC 		((1UL<<0)) /**< Terminal count interrupt */
+#define GPDMA_EVT_ERR 		((1UL<<1)) /**< Error interrupt, the channel is disabled */
+
 /**
  * @}
  */
@@ -281,6 +305,9 @@ extern "C"
 
 /* Macros check GPDMA request select type */
 #define PARAM_GPDMA_REQSEL(n)	((n==GPDMA_REQSEL_UART) || (n==GPDMA_REQSEL_TIMER))
+
+/* Macros check GPDMA channel allocation priority */
+#define PARAM_GPDMA_CHPRIO(n)	((n==GPDMA_CHPRIO_HIGH) || (n==GPDMA_CHPRIO_LOW))
 /**
  * @}
  */
@@ -387,6 +414,70 @@ typedef struct {
 	uint32_t Control;	/**< GPDMA Control of this LLI */
 } GPDMA_LLI_Type;
 
+/**
+ * @brief GPDMA linked list segment type definition. A segment longer than
+ * GPDMA_MAX_TRANSFERSIZE is split into several linked list items.
+ */
+typedef struct {
+	uint32_t SrcAddr;	/**< Source memory address, not used for P2M */
+	uint32_t DstAddr;	/**< Destination memory address, not used for M2P */
+	uint32_t Count;		/**< Number of transfers of TransferWidth each */
+} GPDMA_SEG_Type;
+
+/**
+ * @brief GPDMA linked list description. Scatter-gather chains list one
+ * segment per buffer; circular chains (e.g. a waveform table) and ping-pong
+ * chains (two segments with GPDMA_LLI_OPT_INT_SEG) add GPDMA_LLI_OPT_CIRCULAR.
+ */
+typedef struct {
+	uint32_t TransferType;		/**< GPDMA_TRANSFERTYPE_M2M, M2P or P2M */
+	uint32_t TransferWidth;		/**< GPDMA_WIDTH_xxx, used on both sides */
+	uint32_t SrcConn;			/**< Source peripheral connection for P2M */
+	uint32_t DstConn;			/**< Destination peripheral connection for M2P */
+	const GPDMA_SEG_Type *pSeg;	/**< Segment list */
+	uint32_t NumSeg;			/**< Number of segments */
+	uint32_t Options;			/**< GPDMA_LLI_OPT_xxx flags */
+} GPDMA_LLI_CFG_Type;
+
+/**
+ * @brief GPDMA channel/transfer callback type. Called from GPDMA_IntHandler()
+ * with the channel number, the GPDMA_EVT_xxx events and the user argument.
+ */
+typedef void (*fnGPDMACbs_Type)(uint32_t ChannelNum, uint32_t Event, void *pArg);
+
+/**
+ * @brief GPDMA scheduled transfer type definition. The structure is owned by
+ * the caller and must stay valid until its callback reports completion.
+ */
+typedef struct GPDMA_XFER_Tag {
+	GPDMA_Channel_CFG_Type Config;	/**< Transfer configuration. ChannelNum is
+									filled in by the scheduler */
+	uint32_t Priority;				/**< Allocation priority, should be:
+									- GPDMA_CHPRIO_HIGH
+									- GPDMA_CHPRIO_LOW
+									Queued transfers are started by priority,
+									in submission order within a priority */
+	fnGPDMACbs_Type pfnCallback;	/**< Completion callback, may be NULL */
+	void *pArg;						/**< User argument passed to the callback */
+	struct GPDMA_XFER_Tag *pNext;	/**< Private: next queued transfer */
+	uint32_t SubmitTime;			/**< Private: cycle counter at submission */
+} GPDMA_XFER_Type;
+
+/**
+ * @brief GPDMA channel manager counters. Times are in CPU cycles.
+ */
+typedef struct {
+	uint32_t Submitted;		/**< Transfers passed to GPDMA_Submit() */
+	uint32_t Completed;		/**< Transfers finished without error */
+	uint32_t Errors;		/**< Transfers finished with a bus error */
+	uint32_t Queued;		/**< Transfers waiting for a channel now */
+	uint32_t QueuedPeak;	/**< Highest Queued value seen */
+	uint32_t Busy;			/**< Channels allocated now */
+	uint32_t BusyPeak;		/**< Highest Busy value seen */
+	uint32_t LatencyMax;	/**< Longest wait from submission to channel start */
+	uint32_t LatencyTotal;	/**< Sum of waits, divide by Submitted for the mean */
+} GPDMA_STATS_Type;
+
 
 /**
  * @}
@@ -403,7 +494,18 @@ Status GPDMA_Setup(GPDMA_Channel_CFG_Type *GPDMAChannelConfig);
 IntStatus GPDMA_IntGetStatus(GPDMA_Status_Type type, uint8_t channel);
 void GPDMA_ClearIntPending(GPDMA_StateClear_Type type, uint8_t channel);
 void GPDMA_ChannelCmd(uint8_t channelNum, FunctionalState NewState);
-//void GPDMA_IntHandler(void);
+
+/* GPDMA linked list functions */
+int32_t GPDMA_LLIBuild(GPDMA_LLI_Type *pLLI, uint32_t MaxItems, const GPDMA_LLI_CFG_Type *pCfg);
+Status GPDMA_SetupLLI(uint32_t ChannelNum, const GPDMA_LLI_CFG_Type *pCfg, GPDMA_LLI_Type *pLLI);
+
+/* GPDMA channel manager functions */
+int32_t GPDMA_ChannelAlloc(uint32_t Priority, fnGPDMACbs_Type pfnCallback, void *pArg);
+void GPDMA_ChannelFree(uint32_t ChannelNum);
+Status GPDMA_Submit(GPDMA_XFER_Type *pXfer);
+void GPDMA_IntHandler(void);
+void GPDMA_GetStats(GPDMA_STATS_Type *pStats);
+void GPDMA_ResetStats(void);
 
 /**
  * @}
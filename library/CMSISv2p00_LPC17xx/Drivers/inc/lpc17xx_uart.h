@@ -47,6 +47,27 @@ extern "C"
  */
 #define UART_BLOCKING_TIMEOUT            (0xFFFFFFFFUL)
 
+/** UART ring buffer events, OR-ed together in the Event argument passed
+ * to the ring buffer callback (see UART_RING_CFG_Type)
+ */
+#define UART_RING_EVT_TXDONE        ((uint32_t)(1<<0))    /*!< Tx ring drained and Tx FIFO empty */
+#define UART_RING_EVT_TXLOW         ((uint32_t)(1<<1))    /*!< Tx ring fell to its low watermark */
+#define UART_RING_EVT_RXHIGH        ((uint32_t)(1<<2))    /*!< Rx ring reached its high watermark */
+#define UART_RING_EVT_RXIDLE        ((uint32_t)(1<<3))    /*!< Character time-out: Rx line idle */
+#define UART_RING_EVT_RXOVERRUN     ((uint32_t)(1<<4))    /*!< Rx ring full, received data dropped */
+#define UART_RING_EVT_LINEERR       ((uint32_t)(1<<5))    /*!< Line status error (OE, PE, FE, BI) */
+
+/** UART DMA stream events, passed to the DMA stream callback
+ * (see UART_DMA_CFG_Type)
+ */
+#define UART_DMA_EVT_RX_HALF        ((uint32_t)(1<<0))    /*!< Rx buffer 0 full, DMA now fills buffer 1 */
+#define UART_DMA_EVT_RX_FULL        ((uint32_t)(1<<1))    /*!< Rx buffer 1 full, DMA now fills buffer 0 */
+#define UART_DMA_EVT_TX_DONE        ((uint32_t)(1<<2))    /*!< Tx buffer sent, it may be reused */
+#define UART_DMA_EVT_ERROR          ((uint32_t)(1<<3))    /*!< GPDMA bus error, stream stopped */
+
+/** Maximum size of each DMA stream buffer (GPDMA transfer size field) */
+#define UART_DMA_MAX_BUFSIZE        (0xFFF)
+
 /**
  * @}
  */
@@ -310,6 +331,9 @@ extern "C"
 #define PARAM_UART_IrDA(x) (((uint32_t *)x)==((uint32_t *)LPC_UART3))
 #define PARAM_UART1_MODEM(x) (((uint32_t *)x)==((uint32_t *)LPC_UART1))
 
+/** Macro to check a ring buffer size: must be a non-zero power of two */
+#define PARAM_UART_RING_SIZE(x)    (((x) != 0) && (((x) & ((x) - 1)) == 0))
+
 /** Macro to check the input value for UART1_RS485_CFG_MATCHADDRVALUE parameter */
 #define PARAM_UART1_RS485_CFG_MATCHADDRVALUE(x) ((x<0xFF))
 
@@ -565,6 +589,48 @@ typedef struct {
     uint8_t DelayValue;                        /*!< delay time is in periods of the baud clock, 8-bit long */
 } UART1_RS485_CTRLCFG_Type;
 
+/**
+ * @brief UART ring buffer callback type. Called from UART_RingIntHandler()
+ * (interrupt context) with the UART_RING_EVT_xxx events that occurred.
+ */
+typedef void (*UART_RING_CBS_Type)(LPC_UART_TypeDef *UARTx, uint32_t Event);
+
+/********************************************************************//**
+* @brief UART ring buffer configuration structure definition
+**********************************************************************/
+typedef struct {
+    uint8_t *TxBuf;                    /**< Tx ring storage, owned by the caller */
+    uint32_t TxSize;                /**< Tx ring size in bytes, must be a power of two */
+    uint8_t *RxBuf;                    /**< Rx ring storage, owned by the caller */
+    uint32_t RxSize;                /**< Rx ring size in bytes, must be a power of two */
+    uint32_t TxLowWater;            /**< UART_RING_EVT_TXLOW fires when the pending Tx
+                                    count falls to this level, 0 to disable */
+    uint32_t RxHighWater;            /**< UART_RING_EVT_RXHIGH fires when the buffered Rx
+                                    count reaches this level, 0 to disable */
+    UART_RING_CBS_Type pfnCallback;    /**< Event callback, may be NULL */
+} UART_RING_CFG_Type;
+
+/**
+ * @brief UART DMA stream callback type. Called from UART_DMAIntHandler(), or
+ * from GPDMA_IntHandler() for GPDMA_CHANNEL_AUTO streams (interrupt context).
+ * Buf and Len describe the buffer the event refers to.
+ */
+typedef void (*UART_DMA_CBS_Type)(LPC_UART_TypeDef *UARTx, uint32_t Event, \
+                                    uint8_t *Buf, uint32_t Len);
+
+/********************************************************************//**
+* @brief UART DMA stream configuration structure definition
+**********************************************************************/
+typedef struct {
+    uint32_t ChannelNum;            /**< GPDMA channel used by this stream, 0..7, or
+                                    GPDMA_CHANNEL_AUTO to take one from the GPDMA
+                                    channel manager */
+    uint8_t *Buf[2];                /**< Ping-pong buffers, owned by the caller. They
+                                    must be in RAM reachable by the GPDMA */
+    uint32_t BufSize;                /**< Size of each buffer, up to UART_DMA_MAX_BUFSIZE */
+    UART_DMA_CBS_Type pfnCallback;    /**< Event callback, may be NULL */
+} UART_DMA_CFG_Type;
+
 /**
  * @}
  */
@@ -625,6 +691,26 @@ uint32_t UART_RS485SendData(LPC_UART1_TypeDef *UARTx, uint8_t *pData, uint32_t s
 void UART_IrDAInvtInputCmd(LPC_UART_TypeDef* UARTx, FunctionalState NewState);
 void UART_IrDACmd(LPC_UART_TypeDef* UARTx, FunctionalState NewState);
 void UART_IrDAPulseDivConfig(LPC_UART_TypeDef *UARTx, UART_IrDA_PULSE_Type PulseDiv);
+
+/* UART ring buffer (interrupt driven) functions ---------------------------------*/
+Status UART_RingInit(LPC_UART_TypeDef *UARTx, UART_RING_CFG_Type *RingCfg);
+void UART_RingDeInit(LPC_UART_TypeDef *UARTx);
+void UART_RingConfigStructInit(UART_RING_CFG_Type *RingCfg);
+uint32_t UART_RingSend(LPC_UART_TypeDef *UARTx, const uint8_t *txbuf, uint32_t buflen);
+uint32_t UART_RingReceive(LPC_UART_TypeDef *UARTx, uint8_t *rxbuf, uint32_t buflen);
+uint32_t UART_RingGetTxCount(LPC_UART_TypeDef *UARTx);
+uint32_t UART_RingGetRxCount(LPC_UART_TypeDef *UARTx);
+uint32_t UART_RingGetRxDropped(LPC_UART_TypeDef *UARTx);
+void UART_RingIntHandler(LPC_UART_TypeDef *UARTx);
+
+/* UART DMA stream functions ------------------------------------------------------*/
+Status UART_DMARxStreamStart(LPC_UART_TypeDef *UARTx, UART_DMA_CFG_Type *DmaCfg);
+uint32_t UART_DMARxStreamGetCount(LPC_UART_TypeDef *UARTx);
+Status UART_DMATxStreamInit(LPC_UART_TypeDef *UARTx, UART_DMA_CFG_Type *DmaCfg);
+uint8_t *UART_DMATxStreamGetBuffer(LPC_UART_TypeDef *UARTx);
+Status UART_DMATxStreamCommit(LPC_UART_TypeDef *UARTx, uint32_t Len);
+void UART_DMAStreamStop(LPC_UART_TypeDef *UARTx);
+void UART_DMAIntHandler(LPC_UART_TypeDef *UARTx);
 /**
  * @}
  */
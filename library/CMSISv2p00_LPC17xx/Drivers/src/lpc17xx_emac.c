@@ -49,29 +49,326 @@ const uint8_t EMAC_clkdiv[] = { 4, 6, 8, 10, 14, 20, 28 };
 
 /* EMAC local DMA Descriptors */
 
+/* The EMAC DMA only reaches the AHB SRAM banks, so descriptors, statuses
+ * and packet buffers are placed in EMAC_RAM_SECTION (AHBRAM1 by default) */
+#if defined ( __CC_ARM ) || defined ( __GNUC__ )
+#define EMAC_RAM	__attribute__ ((section (EMAC_RAM_SECTION)))
+#else
+#define EMAC_RAM
+#endif
+
 /** Rx Descriptor data array */
-static RX_Desc Rx_Desc[EMAC_NUM_RX_FRAG];
+static EMAC_RAM RX_Desc Rx_Desc[EMAC_NUM_RX_FRAG];
 
 /** Rx Status data array - Must be 8-Byte aligned */
 #if defined ( __CC_ARM   )
-static __align(8) RX_Stat Rx_Stat[EMAC_NUM_RX_FRAG];
+static EMAC_RAM __align(8) RX_Stat Rx_Stat[EMAC_NUM_RX_FRAG];
 #elif defined ( __ICCARM__ )
 #pragma data_alignment=8
 static RX_Stat Rx_Stat[EMAC_NUM_RX_FRAG];
 #elif defined   (  __GNUC__  )
-static __attribute__ ((aligned (8))) RX_Stat Rx_Stat[EMAC_NUM_RX_FRAG];
+static EMAC_RAM __attribute__ ((aligned (8))) RX_Stat Rx_Stat[EMAC_NUM_RX_FRAG];
 #endif
 
 /** Tx Descriptor data array */
-static TX_Desc Tx_Desc[EMAC_NUM_TX_FRAG];
+static EMAC_RAM TX_Desc Tx_Desc[EMAC_NUM_TX_FRAG];
 /** Tx Status data array */
-static TX_Stat Tx_Stat[EMAC_NUM_TX_FRAG];
+static EMAC_RAM TX_Stat Tx_Stat[EMAC_NUM_TX_FRAG];
 
 /* EMAC local DMA buffers */
 /** Rx buffer data */
-static uint32_t rx_buf[EMAC_NUM_RX_FRAG][EMAC_ETH_MAX_FLEN>>2];
+static EMAC_RAM uint32_t rx_buf[EMAC_NUM_RX_FRAG][EMAC_FRAG_SIZE>>2];
 /** Tx buffer data */
-static uint32_t tx_buf[EMAC_NUM_TX_FRAG][EMAC_ETH_MAX_FLEN>>2];
+static EMAC_RAM uint32_t tx_buf[EMAC_NUM_TX_FRAG][EMAC_FRAG_SIZE>>2];
+
+/** Rx fragments lent by EMAC_BorrowRxBuffer(), from RxConsumeIndex on */
+static uint32_t rx_borrowed;
+/** Tx fragments filled but not yet handed to the EMAC, from TxProduceIndex on */
+static uint32_t tx_filled;
+/** Tx fragments lent by EMAC_BorrowTxBuffer(), after the filled ones */
+static uint32_t tx_borrowed;
+
+/** Ring counters, see EMAC_GetStats() */
+static EMAC_STATS_Type emac_stats;
+
+/** CRC32 lookup tables for the reflected Ethernet polynomial 0xEDB88320 */
+#if (EMAC_CRC32_ENGINE == EMAC_CRC32_SLICE4)
+/* emac_crc_table[0] is the byte table, emac_crc_table[k][n] advances
+ * emac_crc_table[0][n] by k more zero bytes */
+static const uint32_t emac_crc_table[4][256] = {
+	{
+		0x00000000UL, 0x77073096UL, 0xEE0E612CUL, 0x990951BAUL,
+		0x076DC419UL, 0x706AF48FUL, 0xE963A535UL, 0x9E6495A3UL,
+		0x0EDB8832UL, 0x79DCB8A4UL, 0xE0D5E91EUL, 0x97D2D988UL,
+		0x09B64C2BUL, 0x7EB17CBDUL, 0xE7B82D07UL, 0x90BF1D91UL,
+		0x1DB71064UL, 0x6AB020F2UL, 0xF3B97148UL, 0x84BE41DEUL,
+		0x1ADAD47DUL, 0x6DDDE4EBUL, 0xF4D4B551UL, 0x83D385C7UL,
+		0x136C9856UL, 0x646BA8C0UL, 0xFD62F97AUL, 0x8A65C9ECUL,
+		0x14015C4FUL, 0x63066CD9UL, 0xFA0F3D63UL, 0x8D080DF5UL,
+		0x3B6E20C8UL, 0x4C69105EUL, 0xD56041E4UL, 0xA2677172UL,
+		0x3C03E4D1UL, 0x4B04D447UL, 0xD20D85FDUL, 0xA50AB56BUL,
+		0x35B5A8FAUL, 0x42B2986CUL, 0xDBBBC9D6UL, 0xACBCF940UL,
+		0x32D86CE3UL, 0x45DF5C75UL, 0xDCD60DCFUL, 0xABD13D59UL,
+		0x26D930ACUL, 0x51DE003AUL, 0xC8D75180UL, 0xBFD06116UL,
+		0x21B4F4B5UL, 0x56B3C423UL, 0xCFBA9599UL, 0xB8BDA50FUL,
+		0x2802B89EUL, 0x5F058808UL, 0xC60CD9B2UL, 0xB10BE924UL,
+		0x2F6F7C87UL, 0x58684C11UL, 0xC1611DABUL, 0xB6662D3DUL,
+		0x76DC4190UL, 0x01DB7106UL, 0x98D220BCUL, 0xEFD5102AUL,
+		0x71B18589UL, 0x06B6B51FUL, 0x9FBFE4A5UL, 0xE8B8D433UL,
+		0x7807C9A2UL, 0x0F00F934UL, 0x9609A88EUL, 0xE10E9818UL,
+		0x7F6A0DBBUL, 0x086D3D2DUL, 0x91646C97UL, 0xE6635C01UL,
+		0x6B6B51F4UL, 0x1C6C6162UL, 0x856530D8UL, 0xF262004EUL,
+		0x6C0695EDUL, 0x1B01A57BUL, 0x8208F4C1UL, 0xF50FC457UL,
+		0x65B0D9C6UL, 0x12B7E950UL, 0x8BBEB8EAUL, 0xFCB9887CUL,
+		0x62DD1DDFUL, 0x15DA2D49UL, 0x8CD37CF3UL, 0xFBD44C65UL,
+		0x4DB26158UL, 0x3AB551CEUL, 0xA3BC0074UL, 0xD4BB30E2UL,
+		0x4ADFA541UL, 0x3DD895D7UL, 0xA4D1C46DUL, 0xD3D6F4FBUL,
+		0x4369E96AUL, 0x346ED9FCUL, 0xAD678846UL, 0xDA60B8D0UL,
+		0x44042D73UL, 0x33031DE5UL, 0xAA0A4C5FUL, 0xDD0D7CC9UL,
+		0x5005713CUL, 0x270241AAUL, 0xBE0B1010UL, 0xC90C2086UL,
+		0x5768B525UL, 0x206F85B3UL, 0xB966D409UL, 0xCE61E49FUL,
+		0x5EDEF90EUL, 0x29D9C998UL, 0xB0D09822UL, 0xC7D7A8B4UL,
+		0x59B33D17UL, 0x2EB40D81UL, 0xB7BD5C3BUL, 0xC0BA6CADUL,
+		0xEDB88320UL, 0x9ABFB3B6UL, 0x03B6E20CUL, 0x74B1D29AUL,
+		0xEAD54739UL, 0x9DD277AFUL, 0x04DB2615UL, 0x73DC1683UL,
+		0xE3630B12UL, 0x94643B84UL, 0x0D6D6A3EUL, 0x7A6A5AA8UL,
+		0xE40ECF0BUL, 0x9309FF9DUL, 0x0A00AE27UL, 0x7D079EB1UL,
+		0xF00F9344UL, 0x8708A3D2UL, 0x1E01F268UL, 0x6906C2FEUL,
+		0xF762575DUL, 0x806567CBUL, 0x196C3671UL, 0x6E6B06E7UL,
+		0xFED41B76UL, 0x89D32BE0UL, 0x10DA7A5AUL, 0x67DD4ACCUL,
+		0xF9B9DF6FUL, 0x8EBEEFF9UL, 0x17B7BE43UL, 0x60B08ED5UL,
+		0xD6D6A3E8UL, 0xA1D1937EUL, 0x38D8C2C4UL, 0x4FDFF252UL,
+		0xD1BB67F1UL, 0xA6BC5767UL, 0x3FB506DDUL, 0x48B2364BUL,
+		0xD80D2BDAUL, 0xAF0A1B4CUL, 0x36034AF6UL, 0x41047A60UL,
+		0xDF60EFC3UL, 0xA867DF55UL, 0x316E8EEFUL, 0x4669BE79UL,
+		0xCB61B38CUL, 0xBC66831AUL, 0x256FD2A0UL, 0x5268E236UL,
+		0xCC0C7795UL, 0xBB0B4703UL, 0x220216B9UL, 0x5505262FUL,
+		0xC5BA3BBEUL, 0xB2BD0B28UL, 0x2BB45A92UL, 0x5CB36A04UL,
+		0xC2D7FFA7UL, 0xB5D0CF31UL, 0x2CD99E8BUL, 0x5BDEAE1DUL,
+		0x9B64C2B0UL, 0xEC63F226UL, 0x756AA39CUL, 0x026D930AUL,
+		0x9C0906A9UL, 0xEB0E363FUL, 0x72076785UL, 0x05005713UL,
+		0x95BF4A82UL, 0xE2B87A14UL, 0x7BB12BAEUL, 0x0CB61B38UL,
+		0x92D28E9BUL, 0xE5D5BE0DUL, 0x7CDCEFB7UL, 0x0BDBDF21UL,
+		0x86D3D2D4UL, 0xF1D4E242UL, 0x68DDB3F8UL, 0x1FDA836EUL,
+		0x81BE16CDUL, 0xF6B9265BUL, 0x6FB077E1UL, 0x18B74777UL,
+		0x88085AE6UL, 0xFF0F6A70UL, 0x66063BCAUL, 0x11010B5CUL,
+		0x8F659EFFUL, 0xF862AE69UL, 0x616BFFD3UL, 0x166CCF45UL,
+		0xA00AE278UL, 0xD70DD2EEUL, 0x4E048354UL, 0x3903B3C2UL,
+		0xA7672661UL, 0xD06016F7UL, 0x4969474DUL, 0x3E6E77DBUL,
+		0xAED16A4AUL, 0xD9D65ADCUL, 0x40DF0B66UL, 0x37D83BF0UL,
+		0xA9BCAE53UL, 0xDEBB9EC5UL, 0x47B2CF7FUL, 0x30B5FFE9UL,
+		0xBDBDF21CUL, 0xCABAC28AUL, 0x53B39330UL, 0x24B4A3A6UL,
+		0xBAD03605UL, 0xCDD70693UL, 0x54DE5729UL, 0x23D967BFUL,
+		0xB3667A2EUL, 0xC4614AB8UL, 0x5D681B02UL, 0x2A6F2B94UL,
+		0xB40BBE37UL, 0xC30C8EA1UL, 0x5A05DF1BUL, 0x2D02EF8DUL
+	},
+	{
+		0x00000000UL, 0x191B3141UL, 0x32366282UL, 0x2B2D53C3UL,
+		0x646CC504UL, 0x7D77F445UL, 0x565AA786UL, 0x4F4196C7UL,
+		0xC8D98A08UL, 0xD1C2BB49UL, 0xFAEFE88AUL, 0xE3F4D9CBUL,
+		0xACB54F0CUL, 0xB5AE7E4DUL, 0x9E832D8EUL, 0x87981CCFUL,
+		0x4AC21251UL, 0x53D92310UL, 0x78F470D3UL, 0x61EF4192UL,
+		0x2EAED755UL, 0x37B5E614UL, 0x1C98B5D7UL, 0x05838496UL,
+		0x821B9859UL, 0x9B00A918UL, 0xB02DFADBUL, 0xA936CB9AUL,
+		0xE6775D5DUL, 0xFF6C6C1CUL, 0xD4413FDFUL, 0xCD5A0E9EUL,
+		0x958424A2UL, 0x8C9F15E3UL, 0xA7B24620UL, 0xBEA97761UL,
+		0xF1E8E1A6UL, 0xE8F3D0E7UL, 0xC3DE8324UL, 0xDAC5B265UL,
+		0x5D5DAEAAUL, 0x44469FEBUL, 0x6F6BCC28UL, 0x7670FD69UL,
+		0x39316BAEUL, 0x202A5AEFUL, 0x0B07092CUL, 0x121C386DUL,
+		0xDF4636F3UL, 0xC65D07B2UL, 0xED705471UL, 0xF46B6530UL,
+		0xBB2AF3F7UL, 0xA231C2B6UL, 0x891C9175UL, 0x9007A034UL,
+		0x179FBCFBUL, 0x0E848DBAUL, 0x25A9DE79UL, 0x3CB2EF38UL,
+		0x73F379FFUL, 0x6AE848BEUL, 0x41C51B7DUL, 0x58DE2A3CUL,
+		0xF0794F05UL, 0xE9627E44UL, 0xC24F2D87UL, 0xDB541CC6UL,
+		0x94158A01UL, 0x8D0EBB40UL, 0xA623E883UL, 0xBF38D9C2UL,
+		0x38A0C50DUL, 0x21BBF44CUL, 0x0A96A78FUL, 0x138D96CEUL,
+		0x5CCC0009UL, 0x45D73148UL, 0x6EFA628BUL, 0x77E153CAUL,
+		0xBABB5D54UL, 0xA3A06C15UL, 0x888D3FD6UL, 0x91960E97UL,
+		0xDED79850UL, 0xC7CCA911UL, 0xECE1FAD2UL, 0xF5FACB93UL,
+		0x7262D75CUL, 0x6B79E61DUL, 0x4054B5DEUL, 0x594F849FUL,
+		0x160E1258UL, 0x0F152319UL, 0x243870DAUL, 0x3D23419BUL,
+		0x65FD6BA7UL, 0x7CE65AE6UL, 0x57CB0925UL, 0x4ED03864UL,
+		0x0191AEA3UL, 0x188A9FE2UL, 0x33A7CC21UL, 0x2ABCFD60UL,
+		0xAD24E1AFUL, 0xB43FD0EEUL, 0x9F12832DUL, 0x8609B26CUL,
+		0xC94824ABUL, 0xD05315EAUL, 0xFB7E4629UL, 0xE2657768UL,
+		0x2F3F79F6UL, 0x362448B7UL, 0x1D091B74UL, 0x04122A35UL,
+		0x4B53BCF2UL, 0x52488DB3UL, 0x7965DE70UL, 0x607EEF31UL,
+		0xE7E6F3FEUL, 0xFEFDC2BFUL, 0xD5D0917CUL, 0xCCCBA03DUL,
+		0x838A36FAUL, 0x9A9107BBUL, 0xB1BC5478UL, 0xA8A76539UL,
+		0x3B83984BUL, 0x2298A90AUL, 0x09B5FAC9UL, 0x10AECB88UL,
+		0x5FEF5D4FUL, 0x46F46C0EUL, 0x6DD93FCDUL, 0x74C20E8CUL,
+		0xF35A1243UL, 0xEA412302UL, 0xC16C70C1UL, 0xD8774180UL,
+		0x9736D747UL, 0x8E2DE606UL, 0xA500B5C5UL, 0xBC1B8484UL,
+		0x71418A1AUL, 0x685ABB5BUL, 0x4377E898UL, 0x5A6CD9D9UL,
+		0x152D4F1EUL, 0x0C367E5FUL, 0x271B2D9CUL, 0x3E001CDDUL,
+		0xB9980012UL, 0xA0833153UL, 0x8BAE6290UL, 0x92B553D1UL,
+		0xDDF4C516UL, 0xC4EFF457UL, 0xEFC2A794UL, 0xF6D996D5UL,
+		0xAE07BCE9UL, 0xB71C8DA8UL, 0x9C31DE6BUL, 0x852AEF2AUL,
+		0xCA6B79EDUL, 0xD37048ACUL, 0xF85D1B6FUL, 0xE1462A2EUL,
+		0x66DE36E1UL, 0x7FC507A0UL, 0x54E85463UL, 0x4DF36522UL,
+		0x02B2F3E5UL, 0x1BA9C2A4UL, 0x30849167UL, 0x299FA026UL,
+		0xE4C5AEB8UL, 0xFDDE9FF9UL, 0xD6F3CC3AUL, 0xCFE8FD7BUL,
+		0x80A96BBCUL, 0x99B25AFDUL, 0xB29F093EUL, 0xAB84387FUL,
+		0x2C1C24B0UL, 0x350715F1UL, 0x1E2A4632UL, 0x07317773UL,
+		0x4870E1B4UL, 0x516BD0F5UL, 0x7A468336UL, 0x635DB277UL,
+		0xCBFAD74EUL, 0xD2E1E60FUL, 0xF9CCB5CCUL, 0xE0D7848DUL,
+		0xAF96124AUL, 0xB68D230BUL, 0x9DA070C8UL, 0x84BB4189UL,
+		0x03235D46UL, 0x1A386C07UL, 0x31153FC4UL, 0x280E0E85UL,
+		0x674F9842UL, 0x7E54A903UL, 0x5579FAC0UL, 0x4C62CB81UL,
+		0x8138C51FUL, 0x9823F45EUL, 0xB30EA79DUL, 0xAA1596DCUL,
+		0xE554001BUL, 0xFC4F315AUL, 0xD7626299UL, 0xCE7953D8UL,
+		0x49E14F17UL, 0x50FA7E56UL, 0x7BD72D95UL, 0x62CC1CD4UL,
+		0x2D8D8A13UL, 0x3496BB52UL, 0x1FBBE891UL, 0x06A0D9D0UL,
+		0x5E7EF3ECUL, 0x4765C2ADUL, 0x6C48916EUL, 0x7553A02FUL,
+		0x3A1236E8UL, 0x230907A9UL, 0x0824546AUL, 0x113F652BUL,
+		0x96A779E4UL, 0x8FBC48A5UL, 0xA4911B66UL, 0xBD8A2A27UL,
+		0xF2CBBCE0UL, 0xEBD08DA1UL, 0xC0FDDE62UL, 0xD9E6EF23UL,
+		0x14BCE1BDUL, 0x0DA7D0FCUL, 0x268A833FUL, 0x3F91B27EUL,
+		0x70D024B9UL, 0x69CB15F8UL, 0x42E6463BUL, 0x5BFD777AUL,
+		0xDC656BB5UL, 0xC57E5AF4UL, 0xEE530937UL, 0xF7483876UL,
+		0xB809AEB1UL, 0xA1129FF0UL, 0x8A3FCC33UL, 0x9324FD72UL
+	},
+	{
+		0x00000000UL, 0x01C26A37UL, 0x0384D46EUL, 0x0246BE59UL,
+		0x0709A8DCUL, 0x06CBC2EBUL, 0x048D7CB2UL, 0x054F1685UL,
+		0x0E1351B8UL, 0x0FD13B8FUL, 0x0D9785D6UL, 0x0C55EFE1UL,
+		0x091AF964UL, 0x08D89353UL, 0x0A9E2D0AUL, 0x0B5C473DUL,
+		0x1C26A370UL, 0x1DE4C947UL, 0x1FA2771EUL, 0x1E601D29UL,
+		0x1B2F0BACUL, 0x1AED619BUL, 0x18ABDFC2UL, 0x1969B5F5UL,
+		0x1235F2C8UL, 0x13F798FFUL, 0x11B126A6UL, 0x10734C91UL,
+		0x153C5A14UL, 0x14FE3023UL, 0x16B88E7AUL, 0x177AE44DUL,
+		0x384D46E0UL, 0x398F2CD7UL, 0x3BC9928EUL, 0x3A0BF8B9UL,
+		0x3F44EE3CUL, 0x3E86840BUL, 0x3CC03A52UL, 0x3D025065UL,
+		0x365E1758UL, 0x379C7D6FUL, 0x35DAC336UL, 0x3418A901UL,
+		0x3157BF84UL, 0x3095D5B3UL, 0x32D36BEAUL, 0x331101DDUL,
+		0x246BE590UL, 0x25A98FA7UL, 0x27EF31FEUL, 0x262D5BC9UL,
+		0x23624D4CUL, 0x22A0277BUL, 0x20E69922UL, 0x2124F315UL,
+		0x2A78B428UL, 0x2BBADE1FUL, 0x29FC6046UL, 0x283E0A71UL,
+		0x2D711CF4UL, 0x2CB376C3UL, 0x2EF5C89AUL, 0x2F37A2ADUL,
+		0x709A8DC0UL, 0x7158E7F7UL, 0x731E59AEUL, 0x72DC3399UL,
+		0x7793251CUL, 0x76514F2BUL, 0x7417F172UL, 0x75D59B45UL,
+		0x7E89DC78UL, 0x7F4BB64FUL, 0x7D0D0816UL, 0x7CCF6221UL,
+		0x798074A4UL, 0x78421E93UL, 0x7A04A0CAUL, 0x7BC6CAFDUL,
+		0x6CBC2EB0UL, 0x6D7E4487UL, 0x6F38FADEUL, 0x6EFA90E9UL,
+		0x6BB5866CUL, 0x6A77EC5BUL, 0x68315202UL, 0x69F33835UL,
+		0x62AF7F08UL, 0x636D153FUL, 0x612BAB66UL, 0x60E9C151UL,
+		0x65A6D7D4UL, 0x6464BDE3UL, 0x662203BAUL, 0x67E0698DUL,
+		0x48D7CB20UL, 0x4915A117UL, 0x4B531F4EUL, 0x4A917579UL,
+		0x4FDE63FCUL, 0x4E1C09CBUL, 0x4C5AB792UL, 0x4D98DDA5UL,
+		0x46C49A98UL, 0x4706F0AFUL, 0x45404EF6UL, 0x448224C1UL,
+		0x41CD3244UL, 0x400F5873UL, 0x4249E62AUL, 0x438B8C1DUL,
+		0x54F16850UL, 0x55330267UL, 0x5775BC3EUL, 0x56B7D609UL,
+		0x53F8C08CUL, 0x523AAABBUL, 0x507C14E2UL, 0x51BE7ED5UL,
+		0x5AE239E8UL, 0x5B2053DFUL, 0x5966ED86UL, 0x58A487B1UL,
+		0x5DEB9134UL, 0x5C29FB03UL, 0x5E6F455AUL, 0x5FAD2F6DUL,
+		0xE1351B80UL, 0xE0F771B7UL, 0xE2B1CFEEUL, 0xE373A5D9UL,
+		0xE63CB35CUL, 0xE7FED96BUL, 0xE5B86732UL, 0xE47A0D05UL,
+		0xEF264A38UL, 0xEEE4200FUL, 0xECA29E56UL, 0xED60F461UL,
+		0xE82FE2E4UL, 0xE9ED88D3UL, 0xEBAB368AUL, 0xEA695CBDUL,
+		0xFD13B8F0UL, 0xFCD1D2C7UL, 0xFE976C9EUL, 0xFF5506A9UL,
+		0xFA1A102CUL, 0xFBD87A1BUL, 0xF99EC442UL, 0xF85CAE75UL,
+		0xF300E948UL, 0xF2C2837FUL, 0xF0843D26UL, 0xF1465711UL,
+		0xF4094194UL, 0xF5CB2BA3UL, 0xF78D95FAUL, 0xF64FFFCDUL,
+		0xD9785D60UL, 0xD8BA3757UL, 0xDAFC890EUL, 0xDB3EE339UL,
+		0xDE71F5BCUL, 0xDFB39F8BUL, 0xDDF521D2UL, 0xDC374BE5UL,
+		0xD76B0CD8UL, 0xD6A966EFUL, 0xD4EFD8B6UL, 0xD52DB281UL,
+		0xD062A404UL, 0xD1A0CE33UL, 0xD3E6706AUL, 0xD2241A5DUL,
+		0xC55EFE10UL, 0xC49C9427UL, 0xC6DA2A7EUL, 0xC7184049UL,
+		0xC25756CCUL, 0xC3953CFBUL, 0xC1D382A2UL, 0xC011E895UL,
+		0xCB4DAFA8UL, 0xCA8FC59FUL, 0xC8C97BC6UL, 0xC90B11F1UL,
+		0xCC440774UL, 0xCD866D43UL, 0xCFC0D31AUL, 0xCE02B92DUL,
+		0x91AF9640UL, 0x906DFC77UL, 0x922B422EUL, 0x93E92819UL,
+		0x96A63E9CUL, 0x976454ABUL, 0x9522EAF2UL, 0x94E080C5UL,
+		0x9FBCC7F8UL, 0x9E7EADCFUL, 0x9C381396UL, 0x9DFA79A1UL,
+		0x98B56F24UL, 0x99770513UL, 0x9B31BB4AUL, 0x9AF3D17DUL,
+		0x8D893530UL, 0x8C4B5F07UL, 0x8E0DE15EUL, 0x8FCF8B69UL,
+		0x8A809DECUL, 0x8B42F7DBUL, 0x89044982UL, 0x88C623B5UL,
+		0x839A6488UL, 0x82580EBFUL, 0x801EB0E6UL, 0x81DCDAD1UL,
+		0x8493CC54UL, 0x8551A663UL, 0x8717183AUL, 0x86D5720DUL,
+		0xA9E2D0A0UL, 0xA820BA97UL, 0xAA6604CEUL, 0xABA46EF9UL,
+		0xAEEB787CUL, 0xAF29124BUL, 0xAD6FAC12UL, 0xACADC625UL,
+		0xA7F18118UL, 0xA633EB2FUL, 0xA4755576UL, 0xA5B73F41UL,
+		0xA0F829C4UL, 0xA13A43F3UL, 0xA37CFDAAUL, 0xA2BE979DUL,
+		0xB5C473D0UL, 0xB40619E7UL, 0xB640A7BEUL, 0xB782CD89UL,
+		0xB2CDDB0CUL, 0xB30FB13BUL, 0xB1490F62UL, 0xB08B6555UL,
+		0xBBD72268UL, 0xBA15485FUL, 0xB853F606UL, 0xB9919C31UL,
+		0xBCDE8AB4UL, 0xBD1CE083UL, 0xBF5A5EDAUL, 0xBE9834EDUL
+	},
+	{
+		0x00000000UL, 0xB8BC6765UL, 0xAA09C88BUL, 0x12B5AFEEUL,
+		0x8F629757UL, 0x37DEF032UL, 0x256B5FDCUL, 0x9DD738B9UL,
+		0xC5B428EFUL, 0x7D084F8AUL, 0x6FBDE064UL, 0xD7018701UL,
+		0x4AD6BFB8UL, 0xF26AD8DDUL, 0xE0DF7733UL, 0x58631056UL,
+		0x5019579FUL, 0xE8A530FAUL, 0xFA109F14UL, 0x42ACF871UL,
+		0xDF7BC0C8UL, 0x67C7A7ADUL, 0x75720843UL, 0xCDCE6F26UL,
+		0x95AD7F70UL, 0x2D111815UL, 0x3FA4B7FBUL, 0x8718D09EUL,
+		0x1ACFE827UL, 0xA2738F42UL, 0xB0C620ACUL, 0x087A47C9UL,
+		0xA032AF3EUL, 0x188EC85BUL, 0x0A3B67B5UL, 0xB28700D0UL,
+		0x2F503869UL, 0x97EC5F0CUL, 0x8559F0E2UL, 0x3DE59787UL,
+		0x658687D1UL, 0xDD3AE0B4UL, 0xCF8F4F5AUL, 0x7733283FUL,
+		0xEAE41086UL, 0x525877E3UL, 0x40EDD80DUL, 0xF851BF68UL,
+		0xF02BF8A1UL, 0x48979FC4UL, 0x5A22302AUL, 0xE29E574FUL,
+		0x7F496FF6UL, 0xC7F50893UL, 0xD540A77DUL, 0x6DFCC018UL,
+		0x359FD04EUL, 0x8D23B72BUL, 0x9F9618C5UL, 0x272A7FA0UL,
+		0xBAFD4719UL, 0x0241207CUL, 0x10F48F92UL, 0xA848E8F7UL,
+		0x9B14583DUL, 0x23A83F58UL, 0x311D90B6UL, 0x89A1F7D3UL,
+		0x1476CF6AUL, 0xACCAA80FUL, 0xBE7F07E1UL, 0x06C36084UL,
+		0x5EA070D2UL, 0xE61C17B7UL, 0xF4A9B859UL, 0x4C15DF3CUL,
+		0xD1C2E785UL, 0x697E80E0UL, 0x7BCB2F0EUL, 0xC377486BUL,
+		0xCB0D0FA2UL, 0x73B168C7UL, 0x6104C729UL, 0xD9B8A04CUL,
+		0x446F98F5UL, 0xFCD3FF90UL, 0xEE66507EUL, 0x56DA371BUL,
+		0x0EB9274DUL, 0xB6054028UL, 0xA4B0EFC6UL, 0x1C0C88A3UL,
+		0x81DBB01AUL, 0x3967D77FUL, 0x2BD27891UL, 0x936E1FF4UL,
+		0x3B26F703UL, 0x839A9066UL, 0x912F3F88UL, 0x299358EDUL,
+		0xB4446054UL, 0x0CF80731UL, 0x1E4DA8DFUL, 0xA6F1CFBAUL,
+		0xFE92DFECUL, 0x462EB889UL, 0x549B1767UL, 0xEC277002UL,
+		0x71F048BBUL, 0xC94C2FDEUL, 0xDBF98030UL, 0x6345E755UL,
+		0x6B3FA09CUL, 0xD383C7F9UL, 0xC1366817UL, 0x798A0F72UL,
+		0xE45D37CBUL, 0x5CE150AEUL, 0x4E54FF40UL, 0xF6E89825UL,
+		0xAE8B8873UL, 0x1637EF16UL, 0x048240F8UL, 0xBC3E279DUL,
+		0x21E91F24UL, 0x99557841UL, 0x8BE0D7AFUL, 0x335CB0CAUL,
+		0xED59B63BUL, 0x55E5D15EUL, 0x47507EB0UL, 0xFFEC19D5UL,
+		0x623B216CUL, 0xDA874609UL, 0xC832E9E7UL, 0x708E8E82UL,
+		0x28ED9ED4UL, 0x9051F9B1UL, 0x82E4565FUL, 0x3A58313AUL,
+		0xA78F0983UL, 0x1F336EE6UL, 0x0D86C108UL, 0xB53AA66DUL,
+		0xBD40E1A4UL, 0x05FC86C1UL, 0x1749292FUL, 0xAFF54E4AUL,
+		0x322276F3UL, 0x8A9E1196UL, 0x982BBE78UL, 0x2097D91DUL,
+		0x78F4C94BUL, 0xC048AE2EUL, 0xD2FD01C0UL, 0x6A4166A5UL,
+		0xF7965E1CUL, 0x4F2A3979UL, 0x5D9F9697UL, 0xE523F1F2UL,
+		0x4D6B1905UL, 0xF5D77E60UL, 0xE762D18EUL, 0x5FDEB6EBUL,
+		0xC2098E52UL, 0x7AB5E937UL, 0x680046D9UL, 0xD0BC21BCUL,
+		0x88DF31EAUL, 0x3063568FUL, 0x22D6F961UL, 0x9A6A9E04UL,
+		0x07BDA6BDUL, 0xBF01C1D8UL, 0xADB46E36UL, 0x15080953UL,
+		0x1D724E9AUL, 0xA5CE29FFUL, 0xB77B8611UL, 0x0FC7E174UL,
+		0x9210D9CDUL, 0x2AACBEA8UL, 0x38191146UL, 0x80A57623UL,
+		0xD8C66675UL, 0x607A0110UL, 0x72CFAEFEUL, 0xCA73C99BUL,
+		0x57A4F122UL, 0xEF189647UL, 0xFDAD39A9UL, 0x45115ECCUL,
+		0x764DEE06UL, 0xCEF18963UL, 0xDC44268DUL, 0x64F841E8UL,
+		0xF92F7951UL, 0x41931E34UL, 0x5326B1DAUL, 0xEB9AD6BFUL,
+		0xB3F9C6E9UL, 0x0B45A18CUL, 0x19F00E62UL, 0xA14C6907UL,
+		0x3C9B51BEUL, 0x842736DBUL, 0x96929935UL, 0x2E2EFE50UL,
+		0x2654B999UL, 0x9EE8DEFCUL, 0x8C5D7112UL, 0x34E11677UL,
+		0xA9362ECEUL, 0x118A49ABUL, 0x033FE645UL, 0xBB838120UL,
+		0xE3E09176UL, 0x5B5CF613UL, 0x49E959FDUL, 0xF1553E98UL,
+		0x6C820621UL, 0xD43E6144UL, 0xC68BCEAAUL, 0x7E37A9CFUL,
+		0xD67F4138UL, 0x6EC3265DUL, 0x7C7689B3UL, 0xC4CAEED6UL,
+		0x591DD66FUL, 0xE1A1B10AUL, 0xF3141EE4UL, 0x4BA87981UL,
+		0x13CB69D7UL, 0xAB770EB2UL, 0xB9C2A15CUL, 0x017EC639UL,
+		0x9CA9FE80UL, 0x241599E5UL, 0x36A0360BUL, 0x8E1C516EUL,
+		0x866616A7UL, 0x3EDA71C2UL, 0x2C6FDE2CUL, 0x94D3B949UL,
+		0x090481F0UL, 0xB1B8E695UL, 0xA30D497BUL, 0x1BB12E1EUL,
+		0x43D23E48UL, 0xFB6E592DUL, 0xE9DBF6C3UL, 0x516791A6UL,
+		0xCCB0A91FUL, 0x740CCE7AUL, 0x66B96194UL, 0xDE0506F1UL
+	}
+};
+#else
+static const uint32_t emac_crc_table[16] = {
+	0x00000000UL, 0x1DB71064UL, 0x3B6E20C8UL, 0x26D930ACUL,
+	0x76DC4190UL, 0x6B6B51F4UL, 0x4DB26158UL, 0x5005713CUL,
+	0xEDB88320UL, 0xF00F9344UL, 0xD6D6A3E8UL, 0xCB61B38CUL,
+	0x9B64C2B0UL, 0x86D3D2D4UL, 0xA00AE278UL, 0xBDBDF21CUL
+};
+#endif
 
 /**
  * @}
@@ -84,7 +381,12 @@ static int32_t write_PHY (uint32_t PhyReg, uint16_t Value);
 static int32_t  read_PHY (uint32_t PhyReg);
 
 static void setEmacAddr(uint8_t abStationAddr[]);
-static int32_t emac_CRCCalc(uint8_t frame_no_fcs[], int32_t frame_len);
+static void emac_copy_words(uint32_t *dp, const uint32_t *sp, uint32_t len);
+static uint32_t rx_descr_ready(void);
+static uint32_t rx_frame_frags(void);
+static void rx_release(uint32_t num);
+static uint32_t tx_descr_free(void);
+static void tx_queue(uint32_t num);
 
 
 /*--------------------------- rx_descr_init ---------------------------------*/
@@ -100,7 +402,7 @@ static void rx_descr_init (void)
 
 	for (i = 0; i < EMAC_NUM_RX_FRAG; i++) {
 		Rx_Desc[i].Packet  = (uint32_t)&rx_buf[i];
-		Rx_Desc[i].Ctrl    = EMAC_RCTRL_INT | (EMAC_ETH_MAX_FLEN - 1);
+		Rx_Desc[i].Ctrl    = EMAC_RCTRL_INT | (EMAC_FRAG_SIZE - 1);
 		Rx_Stat[i].Info    = 0;
 		Rx_Stat[i].HashCRC = 0;
 	}
@@ -112,6 +414,7 @@ static void rx_descr_init (void)
 
 	/* Rx Descriptors Point to 0 */
 	LPC_EMAC->RxConsumeIndex  = 0;
+	rx_borrowed = 0;
 }
 
 
@@ -138,6 +441,8 @@ static void tx_descr_init (void) {
 
 	/* Tx Descriptors Point to 0 */
 	LPC_EMAC->TxProduceIndex  = 0;
+	tx_filled = 0;
+	tx_borrowed = 0;
 }
 
 
@@ -212,47 +517,117 @@ static void setEmacAddr(uint8_t abStationAddr[])
 
 
 /*********************************************************************//**
- * @brief		Calculates CRC code for number of bytes in the frame
- * @param[in]	frame_no_fcs	Pointer to the first byte of the frame
- * @param[in]	frame_len		length of the frame without the FCS
- * @return		the CRC as a 32 bit integer
+ * @brief		Copy a number of words, four per loop iteration so that the
+ * 				compiler can use LDM/STM for the bulk of the frame
+ * @param[in]	dp		Word-aligned destination
+ * @param[in]	sp		Word-aligned source
+ * @param[in]	len		Number of words
+ * @return		None
  **********************************************************************/
-static int32_t emac_CRCCalc(uint8_t frame_no_fcs[], int32_t frame_len)
+static void emac_copy_words(uint32_t *dp, const uint32_t *sp, uint32_t len)
 {
-	int i; 		// iterator
-	int j; 		// another iterator
-	char byte; 	// current byte
-	int crc; 	// CRC result
-	int q0, q1, q2, q3; // temporary variables
-	crc = 0xFFFFFFFF;
-	for (i = 0; i < frame_len; i++) {
-		byte = *frame_no_fcs++;
-		for (j = 0; j < 2; j++) {
-			if (((crc >> 28) ^ (byte >> 3)) & 0x00000001) {
-				q3 = 0x04C11DB7;
-			} else {
-				q3 = 0x00000000;
-			}
-			if (((crc >> 29) ^ (byte >> 2)) & 0x00000001) {
-				q2 = 0x09823B6E;
-			} else {
-				q2 = 0x00000000;
-			}
-			if (((crc >> 30) ^ (byte >> 1)) & 0x00000001) {
-				q1 = 0x130476DC;
-			} else {
-				q1 = 0x00000000;
-			}
-			if (((crc >> 31) ^ (byte >> 0)) & 0x00000001) {
-				q0 = 0x2608EDB8;
-			} else {
-				q0 = 0x00000000;
+	uint32_t w0, w1, w2, w3;
+
+	for (; len >= 4; len -= 4) {
+		w0 = sp[0];
+		w1 = sp[1];
+		w2 = sp[2];
+		w3 = sp[3];
+		dp[0] = w0;
+		dp[1] = w1;
+		dp[2] = w2;
+		dp[3] = w3;
+		sp += 4;
+		dp += 4;
+	}
+	for (; len; len--) {
+		*dp++ = *sp++;
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Number of received fragments between RxConsumeIndex and
+ * 				RxProduceIndex
+ * @param[in]	None
+ * @return		Fragments ready, borrowed ones included
+ **********************************************************************/
+static uint32_t rx_descr_ready(void)
+{
+	return (LPC_EMAC->RxProduceIndex + EMAC_NUM_RX_FRAG
+			- LPC_EMAC->RxConsumeIndex) % EMAC_NUM_RX_FRAG;
+}
+
+/*********************************************************************//**
+ * @brief		Number of fragments of the frame at RxConsumeIndex
+ * @param[in]	None
+ * @return		Fragments up to the one with EMAC_RINFO_LAST_FLAG, or 0
+ * 				if no complete frame has been received
+ **********************************************************************/
+static uint32_t rx_frame_frags(void)
+{
+	uint32_t idx, num, ready;
+
+	idx = LPC_EMAC->RxConsumeIndex;
+	ready = rx_descr_ready();
+	for (num = 1; num <= ready; num++) {
+		if (Rx_Stat[idx].Info & EMAC_RINFO_LAST_FLAG) {
+			return num;
+		}
+		if (++idx == EMAC_NUM_RX_FRAG) idx = 0;
+	}
+	return 0;
+}
+
+/*********************************************************************//**
+ * @brief		Release a number of fragments to the EMAC, from
+ * 				RxConsumeIndex on, and count the frames they end
+ * @param[in]	num		Number of fragments
+ * @return		None
+ **********************************************************************/
+static void rx_release(uint32_t num)
+{
+	uint32_t idx = LPC_EMAC->RxConsumeIndex;
+
+	for (; num; num--) {
+		if (Rx_Stat[idx].Info & EMAC_RINFO_LAST_FLAG) {
+			emac_stats.RxFrames++;
+			if (Rx_Stat[idx].Info & EMAC_RINFO_ERR) {
+				emac_stats.RxErrors++;
 			}
-			crc = (crc << 4) ^ q3 ^ q2 ^ q1 ^ q0;
-			byte >>= 4;
 		}
+		if (++idx == EMAC_NUM_RX_FRAG) idx = 0;
+	}
+	LPC_EMAC->RxConsumeIndex = idx;
+}
+
+/*********************************************************************//**
+ * @brief		Number of Tx descriptors the software may still fill. One
+ * 				descriptor stays unused to tell a full ring from an empty one.
+ * @param[in]	None
+ * @return		Free descriptors, borrowed ones included
+ **********************************************************************/
+static uint32_t tx_descr_free(void)
+{
+	return (LPC_EMAC->TxConsumeIndex + EMAC_NUM_TX_FRAG - 1
+			- LPC_EMAC->TxProduceIndex) % EMAC_NUM_TX_FRAG;
+}
+
+/*********************************************************************//**
+ * @brief		Hand a number of filled fragments to the EMAC by moving
+ * 				TxProduceIndex, which starts the transmission
+ * @param[in]	num		Number of fragments
+ * @return		None
+ **********************************************************************/
+static void tx_queue(uint32_t num)
+{
+	uint32_t used;
+
+	LPC_EMAC->TxProduceIndex = (LPC_EMAC->TxProduceIndex + num) % EMAC_NUM_TX_FRAG;
+	emac_stats.TxFrames++;
+	used = EMAC_NUM_TX_FRAG - 1 - tx_descr_free();
+	if (used > emac_stats.TxPeak) {
+		emac_stats.TxPeak = used;
 	}
-	return crc;
 }
 /* End of Private Functions --------------------------------------------------- */
 
@@ -636,12 +1011,17 @@ void EMAC_SetHashFilter(uint8_t dstMAC_addr[], FunctionalState NewState)
 {
 	uint32_t *pReg;
 	uint32_t tmp;
-	int32_t crc;
+	uint32_t crc, reg;
+	uint32_t i;
 
 	// Calculate the CRC from the destination MAC address
-	crc = emac_CRCCalc(dstMAC_addr, 6);
-	// Extract the value from CRC to get index value for hash filter table
-	crc = (crc >> 23) & 0x3F;
+	reg = EMAC_CRC32Update(EMAC_CRC32_INIT, dstMAC_addr, 6);
+	// Extract the value from CRC to get index value for hash filter table:
+	// bits [28:23] of the CRC are bits [3:8] of the reflected register
+	crc = 0;
+	for (i = 3; i <= 8; i++) {
+		crc = (crc << 1) | ((reg >> i) & 1);
+	}
 
 	pReg = (crc > 31) ? ((uint32_t *)&LPC_EMAC->HashFilterH) \
 								: ((uint32_t *)&LPC_EMAC->HashFilterL);
@@ -691,6 +1071,60 @@ void EMAC_SetFilterMode(uint32_t ulFilterMode, FunctionalState NewState)
 	}
 }
 
+/*********************************************************************//**
+ * @brief		Continue an Ethernet CRC32 over a number of bytes
+ * @param[in]	ulCRC		CRC register, EMAC_CRC32_INIT for the first
+ * 							block of a frame or the value returned for the
+ * 							previous block
+ * @param[in]	pbData		Pointer to the data, any alignment
+ * @param[in]	ulLen		Number of bytes
+ * @return		CRC register, bit-reflected and not inverted
+ *
+ * Note: the engine is selected at compile time with EMAC_CRC32_ENGINE.
+ * EMAC_CRC32_SLICE4 folds a word per iteration once pbData is word-aligned.
+ **********************************************************************/
+uint32_t EMAC_CRC32Update(uint32_t ulCRC, const uint8_t *pbData, uint32_t ulLen)
+{
+#if (EMAC_CRC32_ENGINE == EMAC_CRC32_SLICE4)
+	const uint32_t *wp;
+
+	while (ulLen && ((uint32_t)pbData & 3)) {
+		ulCRC = emac_crc_table[0][(ulCRC ^ *pbData++) & 0xFF] ^ (ulCRC >> 8);
+		ulLen--;
+	}
+	// Little endian: the first byte of the word is in the low bits
+	wp = (const uint32_t *)pbData;
+	while (ulLen >= 4) {
+		ulCRC ^= *wp++;
+		ulCRC = emac_crc_table[3][ulCRC & 0xFF] ^ emac_crc_table[2][(ulCRC >> 8) & 0xFF] \
+				^ emac_crc_table[1][(ulCRC >> 16) & 0xFF] ^ emac_crc_table[0][ulCRC >> 24];
+		ulLen -= 4;
+	}
+	pbData = (const uint8_t *)wp;
+	while (ulLen--) {
+		ulCRC = emac_crc_table[0][(ulCRC ^ *pbData++) & 0xFF] ^ (ulCRC >> 8);
+	}
+#else
+	while (ulLen--) {
+		ulCRC ^= *pbData++;
+		ulCRC = emac_crc_table[ulCRC & 0x0F] ^ (ulCRC >> 4);
+		ulCRC = emac_crc_table[ulCRC & 0x0F] ^ (ulCRC >> 4);
+	}
+#endif
+	return ulCRC;
+}
+
+/*********************************************************************//**
+ * @brief		Calculate the Ethernet CRC32 (FCS) of a number of bytes
+ * @param[in]	pbData		Pointer to the data, any alignment
+ * @param[in]	ulLen		Number of bytes
+ * @return		The FCS, to be sent least significant byte first
+ **********************************************************************/
+uint32_t EMAC_CRC32(const uint8_t *pbData, uint32_t ulLen)
+{
+	return ~EMAC_CRC32Update(EMAC_CRC32_INIT, pbData, ulLen);
+}
+
 /*********************************************************************//**
  * @brief		Get status of Wake On LAN Filter for each specified
  * 				type in EMAC peripheral, clear this status if it is set
@@ -721,7 +1155,9 @@ FlagStatus EMAC_GetWoLStatus(uint32_t ulWoLMode)
 
 /*********************************************************************//**
  * @brief		Write data to Tx packet data buffer at current index due to
- * 				TxProduceIndex
+ * 				TxProduceIndex. A frame longer than EMAC_FRAG_SIZE is split
+ * 				over consecutive descriptors, EMAC_UpdateTxProduceIndex()
+ * 				then sends all of them.
  * @param[in]	pDataStruct		Pointer to a EMAC_PACKETBUF_Type structure
  * 							data that contain specified information about
  * 							Packet data buffer.
@@ -729,22 +1165,29 @@ FlagStatus EMAC_GetWoLStatus(uint32_t ulWoLMode)
  **********************************************************************/
 void EMAC_WritePacketBuffer(EMAC_PACKETBUF_Type *pDataStruct)
 {
-	uint32_t idx,len;
-	uint32_t *sp,*dp;
+	uint32_t idx, len, left;
+	uint32_t *sp;
 
-	idx = LPC_EMAC->TxProduceIndex;
-	sp  = (uint32_t *)pDataStruct->pbDataBuf;
-	dp  = (uint32_t *)Tx_Desc[idx].Packet;
+	idx  = LPC_EMAC->TxProduceIndex;
+	sp   = (uint32_t *)pDataStruct->pbDataBuf;
+	left = pDataStruct->ulDataLen;
+	tx_filled = 0;
 	/* Copy frame data to EMAC packet buffers. */
-	for (len = (pDataStruct->ulDataLen + 3) >> 2; len; len--) {
-		*dp++ = *sp++;
-	}
-	Tx_Desc[idx].Ctrl = (pDataStruct->ulDataLen - 1) | (EMAC_TCTRL_INT | EMAC_TCTRL_LAST);
+	do {
+		len = (left > EMAC_FRAG_SIZE) ? EMAC_FRAG_SIZE : left;
+		Tx_Desc[idx].Packet = (uint32_t)&tx_buf[idx];
+		emac_copy_words(tx_buf[idx], sp, (len + 3) >> 2);
+		sp += len >> 2;
+		left -= len;
+		Tx_Desc[idx].Ctrl = (len - 1) | (left ? 0 : (EMAC_TCTRL_INT | EMAC_TCTRL_LAST));
+		if (++idx == EMAC_NUM_TX_FRAG) idx = 0;
+		tx_filled++;
+	} while (left);
 }
 
 /*********************************************************************//**
  * @brief		Read data from Rx packet data buffer at current index due
- * 				to RxConsumeIndex
+ * 				to RxConsumeIndex, gathering the fragments of the frame
  * @param[in]	pDataStruct		Pointer to a EMAC_PACKETBUF_Type structure
  * 							data that contain specified information about
  * 							Packet data buffer.
@@ -752,20 +1195,267 @@ void EMAC_WritePacketBuffer(EMAC_PACKETBUF_Type *pDataStruct)
  **********************************************************************/
 void EMAC_ReadPacketBuffer(EMAC_PACKETBUF_Type *pDataStruct)
 {
-	uint32_t idx, len;
-	uint32_t *dp, *sp;
+	uint32_t idx, len, left;
+	uint32_t *dp;
 
-	idx = LPC_EMAC->RxConsumeIndex;
-	dp = (uint32_t *)pDataStruct->pbDataBuf;
-	sp = (uint32_t *)Rx_Desc[idx].Packet;
+	idx  = LPC_EMAC->RxConsumeIndex;
+	dp   = (uint32_t *)pDataStruct->pbDataBuf;
+	left = pDataStruct->ulDataLen;
 
 	if (pDataStruct->pbDataBuf != NULL) {
-		for (len = (pDataStruct->ulDataLen + 3) >> 2; len; len--) {
-			*dp++ = *sp++;
+		while (left) {
+			len = (left > EMAC_FRAG_SIZE) ? EMAC_FRAG_SIZE : left;
+			emac_copy_words(dp, (uint32_t *)Rx_Desc[idx].Packet, (len + 3) >> 2);
+			dp += len >> 2;
+			left -= len;
+			if (++idx == EMAC_NUM_RX_FRAG) idx = 0;
 		}
 	}
 }
 
+#ifdef _GPDMA
+/*********************************************************************//**
+ * @brief		Copy data to the Tx packet buffer at TxProduceIndex with a
+ * 				GPDMA memory-to-memory transfer, see GPDMA_Submit(). The
+ * 				frame is not sent until EMAC_UpdateTxProduceIndex() is
+ * 				called, normally from the transfer callback.
+ * @param[in]	pDataStruct		Pointer to a EMAC_PACKETBUF_Type structure
+ * 							data that contain specified information about
+ * 							Packet data buffer, pbDataBuf must be word-aligned
+ * 							and ulDataLen at most EMAC_FRAG_SIZE.
+ * @param[in]	pXfer		GPDMA transfer descriptor owned by the caller,
+ * 							with Priority, pfnCallback and pArg filled in.
+ * 							Config is filled in here.
+ * @return		SUCCESS if the transfer is started or queued, otherwise ERROR
+ **********************************************************************/
+Status EMAC_WritePacketBufferDMA(EMAC_PACKETBUF_Type *pDataStruct, GPDMA_XFER_Type *pXfer)
+{
+	uint32_t idx;
+
+	if (pDataStruct->ulDataLen > EMAC_FRAG_SIZE) {
+		return ERROR;
+	}
+	idx = LPC_EMAC->TxProduceIndex;
+	pXfer->Config.TransferType = GPDMA_TRANSFERTYPE_M2M;
+	pXfer->Config.TransferWidth = GPDMA_WIDTH_WORD;
+	pXfer->Config.TransferSize = (pDataStruct->ulDataLen + 3) >> 2;
+	pXfer->Config.SrcMemAddr = (uint32_t)pDataStruct->pbDataBuf;
+	Tx_Desc[idx].Packet = (uint32_t)&tx_buf[idx];
+	pXfer->Config.DstMemAddr = Tx_Desc[idx].Packet;
+	pXfer->Config.SrcConn = 0;
+	pXfer->Config.DstConn = 0;
+	pXfer->Config.DMALLI = 0;
+	Tx_Desc[idx].Ctrl = (pDataStruct->ulDataLen - 1) | (EMAC_TCTRL_INT | EMAC_TCTRL_LAST);
+	tx_filled = 1;
+
+	return GPDMA_Submit(pXfer);
+}
+
+/*********************************************************************//**
+ * @brief		Copy data from the Rx packet buffer at RxConsumeIndex with a
+ * 				GPDMA memory-to-memory transfer, see GPDMA_Submit(). The
+ * 				buffer must not be released with EMAC_UpdateRxConsumeIndex()
+ * 				before the transfer callback reports completion.
+ * @param[in]	pDataStruct		Pointer to a EMAC_PACKETBUF_Type structure
+ * 							data that contain specified information about
+ * 							Packet data buffer, pbDataBuf must be word-aligned
+ * 							and ulDataLen at most EMAC_FRAG_SIZE.
+ * @param[in]	pXfer		GPDMA transfer descriptor owned by the caller,
+ * 							with Priority, pfnCallback and pArg filled in.
+ * 							Config is filled in here.
+ * @return		SUCCESS if the transfer is started or queued, otherwise ERROR
+ **********************************************************************/
+Status EMAC_ReadPacketBufferDMA(EMAC_PACKETBUF_Type *pDataStruct, GPDMA_XFER_Type *pXfer)
+{
+	uint32_t idx;
+
+	if ((pDataStruct->pbDataBuf == NULL) || (pDataStruct->ulDataLen > EMAC_FRAG_SIZE)) {
+		return ERROR;
+	}
+	idx = LPC_EMAC->RxConsumeIndex;
+	pXfer->Config.TransferType = GPDMA_TRANSFERTYPE_M2M;
+	pXfer->Config.TransferWidth = GPDMA_WIDTH_WORD;
+	pXfer->Config.TransferSize = (pDataStruct->ulDataLen + 3) >> 2;
+	pXfer->Config.SrcMemAddr = Rx_Desc[idx].Packet;
+	pXfer->Config.DstMemAddr = (uint32_t)pDataStruct->pbDataBuf;
+	pXfer->Config.SrcConn = 0;
+	pXfer->Config.DstConn = 0;
+	pXfer->Config.DMALLI = 0;
+
+	return GPDMA_Submit(pXfer);
+}
+#endif /* _GPDMA */
+
+/*********************************************************************//**
+ * @brief		Lend the next received fragment without copying it. With
+ * 				EMAC_FRAG_SIZE of at least EMAC_ETH_MAX_FLEN every frame is a
+ * 				single fragment. Fragments are lent in order, several may be
+ * 				out at the same time; each one is given back with
+ * 				EMAC_ReturnRxBuffer(), in the same order.
+ * @param[out]	pulDataLen	Size of the fragment in bytes, the FCS is in the
+ * 							last fragment of the frame, may be NULL
+ * @param[out]	pbLast		TRUE for the last fragment of the frame, may be NULL
+ * @return		Word-aligned pointer to the fragment in the Rx packet buffer,
+ * 				or NULL if no fragment is waiting
+ *
+ * Note: EMAC_CheckReceiveDataStatus() and EMAC_GetReceiveDataSize() refer
+ * to the oldest frame still lent. Do not mix with EMAC_ReadPacketBuffer()
+ * and EMAC_UpdateRxConsumeIndex() while fragments are lent.
+ **********************************************************************/
+uint32_t *EMAC_BorrowRxBuffer(uint32_t *pulDataLen, Bool *pbLast)
+{
+	uint32_t idx;
+
+	if (rx_borrowed >= rx_descr_ready()) {
+		return NULL;
+	}
+	idx = (LPC_EMAC->RxConsumeIndex + rx_borrowed) % EMAC_NUM_RX_FRAG;
+	rx_borrowed++;
+	if (pulDataLen != NULL) {
+		*pulDataLen = (Rx_Stat[idx].Info & EMAC_RINFO_SIZE) + 1;
+	}
+	if (pbLast != NULL) {
+		*pbLast = (Rx_Stat[idx].Info & EMAC_RINFO_LAST_FLAG) ? TRUE : FALSE;
+	}
+	return (uint32_t *)Rx_Desc[idx].Packet;
+}
+
+/*********************************************************************//**
+ * @brief		Give back the oldest fragment lent by EMAC_BorrowRxBuffer(),
+ * 				so that the EMAC can receive into its buffer again
+ * @param[in]	None
+ * @return		None
+ **********************************************************************/
+void EMAC_ReturnRxBuffer(void)
+{
+	if (rx_borrowed) {
+		rx_borrowed--;
+		rx_release(1);
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Lend a free Tx packet buffer, so that the frame is built in
+ * 				place instead of being copied. Buffers are lent in ring
+ * 				order and must be given back with EMAC_ReturnTxBuffer() in
+ * 				the same order.
+ * @param[in]	None
+ * @return		Word-aligned pointer to EMAC_FRAG_SIZE bytes, or NULL if
+ * 				all Tx descriptors are in use
+ **********************************************************************/
+uint32_t *EMAC_BorrowTxBuffer(void)
+{
+	uint32_t idx;
+
+	if (tx_filled + tx_borrowed >= tx_descr_free()) {
+		return NULL;
+	}
+	idx = (LPC_EMAC->TxProduceIndex + tx_filled + tx_borrowed) % EMAC_NUM_TX_FRAG;
+	tx_borrowed++;
+	Tx_Desc[idx].Packet = (uint32_t)&tx_buf[idx];
+	return tx_buf[idx];
+}
+
+/*********************************************************************//**
+ * @brief		Give back the oldest buffer lent by EMAC_BorrowTxBuffer()
+ * 				as one fragment of a frame. The frame is sent when its last
+ * 				fragment is given back.
+ * @param[in]	ulDataLen	Fragment size in bytes, should be in range from
+ * 							1 to EMAC_FRAG_SIZE and a multiple of 4 except
+ * 							in the last fragment
+ * @param[in]	bLast		TRUE for the last fragment of the frame
+ * @return		None
+ **********************************************************************/
+void EMAC_ReturnTxBuffer(uint32_t ulDataLen, Bool bLast)
+{
+	uint32_t idx;
+
+	if (tx_borrowed) {
+		tx_borrowed--;
+		idx = (LPC_EMAC->TxProduceIndex + tx_filled) % EMAC_NUM_TX_FRAG;
+		Tx_Desc[idx].Ctrl = (ulDataLen - 1) | ((bLast == TRUE) ? (EMAC_TCTRL_INT | EMAC_TCTRL_LAST) : 0);
+		tx_filled++;
+		if (bLast == TRUE) {
+			EMAC_UpdateTxProduceIndex();
+		}
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Add a buffer of the caller as the next fragment of a frame,
+ * 				without copying it: the EMAC reads it while sending. Used
+ * 				after the fragments given back with EMAC_ReturnTxBuffer(),
+ * 				if any, for data already in AHB SRAM (a DMA buffer, for
+ * 				instance). The frame is sent when its last fragment is added.
+ * @param[in]	pBuf		Word-aligned data in AHB SRAM. It must not change
+ * 							until the EMAC has sent the frame
+ * @param[in]	ulDataLen	Fragment size in bytes, should be in range from
+ * 							1 to 2048 and a multiple of 4 except in the last
+ * 							fragment
+ * @param[in]	bLast		TRUE for the last fragment of the frame
+ * @return		SUCCESS, ERROR if a buffer lent by EMAC_BorrowTxBuffer() has
+ * 				not been given back, or ERROR if no Tx descriptor is free:
+ * 				the frame is then dropped, fragments already added included
+ **********************************************************************/
+Status EMAC_ReferTxBuffer(const uint32_t *pBuf, uint32_t ulDataLen, Bool bLast)
+{
+	uint32_t idx;
+
+	if (tx_borrowed != 0) {
+		return ERROR;
+	}
+	if (tx_filled >= tx_descr_free()) {
+		tx_filled = 0;
+		return ERROR;
+	}
+	idx = (LPC_EMAC->TxProduceIndex + tx_filled) % EMAC_NUM_TX_FRAG;
+	Tx_Desc[idx].Packet = (uint32_t)pBuf;
+	Tx_Desc[idx].Ctrl = (ulDataLen - 1) | ((bLast == TRUE) ? (EMAC_TCTRL_INT | EMAC_TCTRL_LAST) : 0);
+	tx_filled++;
+	if (bLast == TRUE) {
+		EMAC_UpdateTxProduceIndex();
+	}
+	return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief		Get the ring counters
+ * @param[out]	pStats	Pointer to a EMAC_STATS_Type structure that
+ * 						receives a copy of the counters
+ * @return		None
+ **********************************************************************/
+void EMAC_GetStats(EMAC_STATS_Type *pStats)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	*pStats = emac_stats;
+	__set_PRIMASK(primask);
+}
+
+/*********************************************************************//**
+ * @brief		Reset the ring counters, peaks included
+ * @param[in]	None
+ * @return		None
+ **********************************************************************/
+void EMAC_ResetStats(void)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	emac_stats.RxFrames = 0;
+	emac_stats.RxErrors = 0;
+	emac_stats.RxOverrun = 0;
+	emac_stats.RxPeak = 0;
+	emac_stats.TxFrames = 0;
+	emac_stats.TxUnderrun = 0;
+	emac_stats.TxErrors = 0;
+	emac_stats.TxPeak = 0;
+	__set_PRIMASK(primask);
+}
+
 /*********************************************************************//**
  * @brief 		Enable/Disable interrupt for each type in EMAC
  * @param[in]	ulIntType	Interrupt Type, should be:
@@ -809,11 +1499,25 @@ void EMAC_IntCmd(uint32_t ulIntType, FunctionalState NewState)
  * 							- EMAC_INT_SOFT_INT: Software interrupt
  * 							- EMAC_INT_WAKEUP: Wakeup interrupt
  * @return		New state of specified interrupt (SET or RESET)
+ *
+ * Note: EMAC_INT_RX_OVERRUN, EMAC_INT_TX_UNDERRUN and EMAC_INT_TX_ERR found
+ * set here are counted in the statistics returned by EMAC_GetStats().
  **********************************************************************/
 IntStatus EMAC_IntGetStatus(uint32_t ulIntType)
 {
-	if (LPC_EMAC->IntStatus & ulIntType) {
+	uint32_t stat = LPC_EMAC->IntStatus & ulIntType;
+
+	if (stat) {
 		LPC_EMAC->IntClear = ulIntType;
+		if (stat & EMAC_INT_RX_OVERRUN) {
+			emac_stats.RxOverrun++;
+		}
+		if (stat & EMAC_INT_TX_UNDERRUN) {
+			emac_stats.TxUnderrun++;
+		}
+		if (stat & EMAC_INT_TX_ERR) {
+			emac_stats.TxErrors++;
+		}
 		return SET;
 	} else {
 		return RESET;
@@ -822,18 +1526,25 @@ IntStatus EMAC_IntGetStatus(uint32_t ulIntType)
 
 
 /*********************************************************************//**
- * @brief		Check whether if the current RxConsumeIndex is not equal to the
- * 				current RxProduceIndex.
+ * @brief		Check whether a complete frame is waiting between the
+ * 				current RxConsumeIndex and the current RxProduceIndex.
  * @param[in]	None
- * @return		TRUE if they're not equal, otherwise return FALSE
+ * @return		TRUE if a frame has been received, otherwise return FALSE
  *
  * Note: In case the RxConsumeIndex is not equal to the RxProduceIndex,
  * it means there're available data has been received. They should be read
  * out and released the Receive Data Buffer by updating the RxConsumeIndex value.
+ * A frame spanning several fragments is only reported once its last
+ * fragment has been received.
  **********************************************************************/
 Bool EMAC_CheckReceiveIndex(void)
 {
-	if (LPC_EMAC->RxConsumeIndex != LPC_EMAC->RxProduceIndex) {
+	uint32_t ready = rx_descr_ready();
+
+	if (ready > emac_stats.RxPeak) {
+		emac_stats.RxPeak = ready;
+	}
+	if (ready && rx_frame_frags()) {
 		return TRUE;
 	} else {
 		return FALSE;
@@ -842,19 +1553,17 @@ Bool EMAC_CheckReceiveIndex(void)
 
 
 /*********************************************************************//**
- * @brief		Check whether if the current TxProduceIndex is not equal to the
- * 				current RxProduceIndex - 1.
+ * @brief		Check whether there are enough free Tx descriptors after
+ * 				TxProduceIndex for a frame of EMAC_ETH_MAX_FLEN bytes.
  * @param[in]	None
- * @return		TRUE if they're not equal, otherwise return FALSE
+ * @return		TRUE if a frame can be written, otherwise return FALSE
  *
- * Note: In case the RxConsumeIndex is equal to the RxProduceIndex - 1,
- * it means the transmit buffer is available and data can be written to transmit
- * buffer to be sent.
+ * Note: One descriptor is always left unused, so that TxProduceIndex never
+ * catches up with TxConsumeIndex - 1 (the ring would look empty).
  **********************************************************************/
 Bool EMAC_CheckTransmitIndex(void)
 {
-	uint32_t tmp = LPC_EMAC->TxConsumeIndex -1;
-	if (LPC_EMAC->TxProduceIndex == tmp) {
+	if (tx_descr_free() < EMAC_FRAGS_PER_FRAME) {
 		return FALSE;
 	} else {
 		return TRUE;
@@ -879,12 +1588,16 @@ Bool EMAC_CheckTransmitIndex(void)
  * 							- EMAC_RINFO_NO_DESCR: No new Descriptor available
  * 							- EMAC_RINFO_LAST_FLAG: last Fragment in Frame
  * 							- EMAC_RINFO_ERR: Error Occurred (OR of all error)
- * @return		Current value of receive data (due to RxConsumeIndex)
+ * @return		Current value of receive data (due to RxConsumeIndex), taken
+ * 				from the last fragment of the frame where the EMAC reports
+ * 				the frame status
  **********************************************************************/
 FlagStatus EMAC_CheckReceiveDataStatus(uint32_t ulRxStatType)
 {
-	uint32_t idx;
-	idx = LPC_EMAC->RxConsumeIndex;
+	uint32_t idx, num;
+
+	num = rx_frame_frags();
+	idx = (LPC_EMAC->RxConsumeIndex + (num ? num - 1 : 0)) % EMAC_NUM_RX_FRAG;
 	return (((Rx_Stat[idx].Info) & ulRxStatType) ? SET : RESET);
 }
 
@@ -893,50 +1606,54 @@ FlagStatus EMAC_CheckReceiveDataStatus(uint32_t ulRxStatType)
  * @brief		Get size of current Received data in received buffer (due to
  * 				RxConsumeIndex)
  * @param[in]	None
- * @return		Size of received data
+ * @return		Size of received data minus one, FCS included, summed over
+ * 				the fragments of the frame (as in the RxStatus size field)
  **********************************************************************/
 uint32_t EMAC_GetReceiveDataSize(void)
 {
-	uint32_t idx;
-	idx =LPC_EMAC->RxConsumeIndex;
-	return ((Rx_Stat[idx].Info) & EMAC_RINFO_SIZE);
+	uint32_t idx, num, size;
+
+	idx = LPC_EMAC->RxConsumeIndex;
+	num = rx_frame_frags();
+	size = 0;
+	do {
+		size += (Rx_Stat[idx].Info & EMAC_RINFO_SIZE) + 1;
+		if (++idx == EMAC_NUM_RX_FRAG) idx = 0;
+	} while (num && --num);
+	return (size - 1);
 }
 
 /*********************************************************************//**
- * @brief		Increase the RxConsumeIndex (after reading the Receive buffer
- * 				to release the Receive buffer) and wrap-around the index if
- * 				it reaches the maximum Receive Number
+ * @brief		Increase the RxConsumeIndex past the current frame (after
+ * 				reading the Receive buffer to release the Receive buffer)
+ * 				and wrap-around the index if it reaches the maximum
+ * 				Receive Number
  * @param[in]	None
  * @return		None
  **********************************************************************/
 void EMAC_UpdateRxConsumeIndex(void)
 {
-	// Get current Rx consume index
-	uint32_t idx = LPC_EMAC->RxConsumeIndex;
+	uint32_t num = rx_frame_frags();
 
 	/* Release frame from EMAC buffer */
-	if (++idx == EMAC_NUM_RX_FRAG) idx = 0;
-	LPC_EMAC->RxConsumeIndex = idx;
+	rx_release(num ? num : 1);
 }
 
 /*********************************************************************//**
- * @brief		Increase the TxProduceIndex (after writting to the Transmit buffer
- * 				to enable the Transmit buffer) and wrap-around the index if
- * 				it reaches the maximum Transmit Number
+ * @brief		Increase the TxProduceIndex past the fragments written by
+ * 				EMAC_WritePacketBuffer() (to enable the Transmit buffer) and
+ * 				wrap-around the index if it reaches the maximum Transmit
+ * 				Number
  * @param[in]	None
  * @return		None
  **********************************************************************/
 void EMAC_UpdateTxProduceIndex(void)
 {
-	// Get current Tx produce index
-	uint32_t idx = LPC_EMAC->TxProduceIndex;
-
 	/* Start frame transmission */
-	if (++idx == EMAC_NUM_TX_FRAG) idx = 0;
-	LPC_EMAC->TxProduceIndex = idx;
+	tx_queue(tx_filled ? tx_filled : 1);
+	tx_filled = 0;
 }
 
-
 /**
  * @}
  */
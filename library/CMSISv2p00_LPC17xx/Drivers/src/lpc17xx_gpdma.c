@@ -32,6 +32,7 @@
 /* Includes ------------------------------------------------------------------- */
 #include "lpc17xx_gpdma.h"
 #include "lpc17xx_clkpwr.h"
+#include <string.h>
 
 /* If this source file built with example, the LPC17xx FW library configuration
  * file in each example directory ("lpc17xx_libcfg.h") must be included,
@@ -183,6 +184,140 @@ const uint8_t GPDMA_LUTPerWid[] = {
 		GPDMA_WIDTH_WORD				// MAT3.1
 };
 
+/** Cycle counter of the Cortex-M3 DWT unit, used to time queued transfers */
+#define GPDMA_DWT_CTRL		(*((volatile uint32_t *)0xE0001000UL))
+#define GPDMA_DWT_CYCCNT	(*((volatile uint32_t *)0xE0001004UL))
+#define GPDMA_DWT_CTRL_CYCCNTENA	((uint32_t)(1<<0))
+
+/** Memory the GPDMA can reach: local SRAM, AHB SRAM banks and, as a
+ * source only, the flash. May be overridden for other memory maps */
+#ifndef GPDMA_IS_RAM
+#define GPDMA_IS_RAM(a, n)		((((a) >= 0x10000000UL) && (((a) + (n)) <= 0x10008000UL)) \
+								|| (((a) >= 0x2007C000UL) && (((a) + (n)) <= 0x20084000UL)))
+#endif
+#ifndef GPDMA_IS_FLASH
+#define GPDMA_IS_FLASH(a, n)	(((a) + (n)) <= 0x00080000UL)
+#endif
+
+/** Channel manager state for one channel */
+typedef struct {
+	FunctionalState used;			/**< Channel is allocated */
+	fnGPDMACbs_Type pfnCallback;	/**< Callback of a GPDMA_ChannelAlloc() owner */
+	void *pArg;						/**< Callback argument */
+	GPDMA_XFER_Type *pXfer;			/**< Running GPDMA_Submit() transfer, or NULL */
+} GPDMA_CH_STATE_Type;
+
+static GPDMA_CH_STATE_Type gpdma_ch[8];
+/** Transfers waiting for a free channel, high priority entries first */
+static GPDMA_XFER_Type *gpdma_queue;
+static GPDMA_STATS_Type gpdma_stats;
+
+/**
+ * @}
+ */
+
+/* Private Functions ---------------------------------------------------------- */
+/** @defgroup GPDMA_Private_Functions GPDMA Private Functions
+ * @{
+ */
+
+/*********************************************************************//**
+ * @brief		Take a free channel, must be called with interrupts disabled.
+ * 				Channels enabled by users of GPDMA_Setup() are skipped.
+ * @param[in]	Priority	GPDMA_CHPRIO_HIGH or GPDMA_CHPRIO_LOW
+ * @return		Channel number, or -1 if all channels are busy
+ **********************************************************************/
+static int32_t gpdma_take_channel(uint32_t Priority)
+{
+	uint32_t i, ch, enabled;
+
+	enabled = LPC_GPDMA->DMACEnbldChns;
+	for (i = 0; i < 8; i++) {
+		ch = (Priority == GPDMA_CHPRIO_HIGH) ? i : (7 - i);
+		if ((gpdma_ch[ch].used == DISABLE) && !(enabled & GPDMA_DMACEnbldChns_Ch(ch))) {
+			gpdma_ch[ch].used = ENABLE;
+			gpdma_ch[ch].pfnCallback = NULL;
+			gpdma_ch[ch].pArg = NULL;
+			gpdma_ch[ch].pXfer = NULL;
+			if (++gpdma_stats.Busy > gpdma_stats.BusyPeak) {
+				gpdma_stats.BusyPeak = gpdma_stats.Busy;
+			}
+			return ch;
+		}
+	}
+	return -1;
+}
+
+/*********************************************************************//**
+ * @brief		Release a channel, must be called with interrupts disabled
+ * @param[in]	ch		Channel number
+ * @return		None
+ **********************************************************************/
+static void gpdma_release_channel(uint32_t ch)
+{
+	if (gpdma_ch[ch].used == ENABLE) {
+		gpdma_ch[ch].used = DISABLE;
+		gpdma_ch[ch].pXfer = NULL;
+		gpdma_stats.Busy--;
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Start a scheduled transfer on a channel, must be called
+ * 				with interrupts disabled
+ * @param[in]	ch		Channel number, already taken
+ * @param[in]	pXfer	Transfer to start
+ * @return		SUCCESS or ERROR if the configuration is rejected
+ **********************************************************************/
+static Status gpdma_start_xfer(uint32_t ch, GPDMA_XFER_Type *pXfer)
+{
+	uint32_t wait;
+
+	pXfer->Config.ChannelNum = ch;
+	if (GPDMA_Setup(&pXfer->Config) == ERROR) {
+		gpdma_release_channel(ch);
+		return ERROR;
+	}
+	gpdma_ch[ch].pXfer = pXfer;
+
+	wait = GPDMA_DWT_CYCCNT - pXfer->SubmitTime;
+	gpdma_stats.LatencyTotal += wait;
+	if (wait > gpdma_stats.LatencyMax) {
+		gpdma_stats.LatencyMax = wait;
+	}
+
+	GPDMA_ChannelCmd(ch, ENABLE);
+	return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief		Start queued transfers while channels are free, must be
+ * 				called with interrupts disabled. Rejected transfers are
+ * 				completed with GPDMA_EVT_ERR.
+ * @param		None
+ * @return		None
+ **********************************************************************/
+static void gpdma_dispatch_queue(void)
+{
+	GPDMA_XFER_Type *pXfer;
+	int32_t ch;
+
+	while ((pXfer = gpdma_queue) != NULL) {
+		ch = gpdma_take_channel(pXfer->Priority);
+		if (ch < 0) {
+			return;
+		}
+		gpdma_queue = pXfer->pNext;
+		gpdma_stats.Queued--;
+		if (gpdma_start_xfer(ch, pXfer) == ERROR) {
+			gpdma_stats.Errors++;
+			if (pXfer->pfnCallback != NULL) {
+				pXfer->pfnCallback(ch, GPDMA_EVT_ERR, pXfer->pArg);
+			}
+		}
+	}
+}
+
 /**
  * @}
  */
@@ -215,6 +350,15 @@ void GPDMA_Init(void)
 	/* Clear all DMA interrupt and error flag */
 	LPC_GPDMA->DMACIntTCClear = 0xFF;
 	LPC_GPDMA->DMACIntErrClr = 0xFF;
+
+	/* Reset the channel manager */
+	memset(gpdma_ch, 0, sizeof(gpdma_ch));
+	gpdma_queue = NULL;
+	GPDMA_ResetStats();
+
+	/* Start the cycle counter used for the latency counters */
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	GPDMA_DWT_CTRL |= GPDMA_DWT_CTRL_CYCCNTENA;
 }
 
 /********************************************************************//**
@@ -443,6 +587,361 @@ void GPDMA_ClearIntPending(GPDMA_StateClear_Type type, uint8_t channel)
 		LPC_GPDMA->DMACIntErrClr = GPDMA_DMACIntErrClr_Ch(channel);
 }
 
+/*********************************************************************//**
+ * @brief		Build a linked list item chain from a segment list. Control
+ * 				words follow the same rules as GPDMA_Setup(): memory sides
+ * 				increment, peripheral sides use the connection burst size,
+ * 				memory to memory uses 32-transfer bursts. Segments longer
+ * 				than GPDMA_MAX_TRANSFERSIZE are split.
+ * @param[out]	pLLI		Item array, word aligned in RAM. Item 0 is the
+ * 							first one run, see GPDMA_SetupLLI()
+ * @param[in]	MaxItems	Number of items in pLLI, GPDMA_LLI_ITEMS() gives
+ * 							the count needed per segment
+ * @param[in]	pCfg		Chain description
+ * @return		Number of items used, or -1 if the description is invalid,
+ * 				an address is unreachable or misaligned, or pLLI is too small
+ **********************************************************************/
+int32_t GPDMA_LLIBuild(GPDMA_LLI_Type *pLLI, uint32_t MaxItems, const GPDMA_LLI_CFG_Type *pCfg)
+{
+	const GPDMA_SEG_Type *pSeg;
+	uint32_t ctrl, src, dst, left, size, n, i, k, align;
+	uint32_t srcper = 0, dstper = 0;
+
+	if ((pCfg->NumSeg == 0) || (pCfg->pSeg == NULL) || (((uint32_t)pLLI & 0x03) != 0) \
+			|| !GPDMA_IS_RAM((uint32_t)pLLI, MaxItems * sizeof(GPDMA_LLI_Type)) \
+			|| !PARAM_GPDMA_WIDTH(pCfg->TransferWidth)) {
+		return -1;
+	}
+
+	ctrl = GPDMA_DMACCxControl_SWidth(pCfg->TransferWidth) \
+			| GPDMA_DMACCxControl_DWidth(pCfg->TransferWidth);
+	switch (pCfg->TransferType)
+	{
+	case GPDMA_TRANSFERTYPE_M2M:
+		ctrl |= GPDMA_DMACCxControl_SBSize(GPDMA_BSIZE_32) \
+				| GPDMA_DMACCxControl_DBSize(GPDMA_BSIZE_32) \
+				| GPDMA_DMACCxControl_SI | GPDMA_DMACCxControl_DI;
+		break;
+	case GPDMA_TRANSFERTYPE_M2P:
+		if (pCfg->DstConn > GPDMA_CONN_MAT3_1) {
+			return -1;
+		}
+		dstper = (uint32_t)GPDMA_LUTPerAddr[pCfg->DstConn];
+		ctrl |= GPDMA_DMACCxControl_SBSize((uint32_t)GPDMA_LUTPerBurst[pCfg->DstConn]) \
+				| GPDMA_DMACCxControl_DBSize((uint32_t)GPDMA_LUTPerBurst[pCfg->DstConn]) \
+				| GPDMA_DMACCxControl_SI;
+		break;
+	case GPDMA_TRANSFERTYPE_P2M:
+		if (pCfg->SrcConn > GPDMA_CONN_MAT3_1) {
+			return -1;
+		}
+		srcper = (uint32_t)GPDMA_LUTPerAddr[pCfg->SrcConn];
+		ctrl |= GPDMA_DMACCxControl_SBSize((uint32_t)GPDMA_LUTPerBurst[pCfg->SrcConn]) \
+				| GPDMA_DMACCxControl_DBSize((uint32_t)GPDMA_LUTPerBurst[pCfg->SrcConn]) \
+				| GPDMA_DMACCxControl_DI;
+		break;
+	// Peripheral to peripheral chains are not supported
+	default:
+		return -1;
+	}
+
+	align = (1UL << pCfg->TransferWidth) - 1;
+	n = 0;
+	for (i = 0; i < pCfg->NumSeg; i++) {
+		pSeg = &pCfg->pSeg[i];
+		size = pSeg->Count << pCfg->TransferWidth;
+		src = (pCfg->TransferType == GPDMA_TRANSFERTYPE_P2M) ? srcper : pSeg->SrcAddr;
+		dst = (pCfg->TransferType == GPDMA_TRANSFERTYPE_M2P) ? dstper : pSeg->DstAddr;
+
+		if ((pSeg->Count == 0) || ((n + GPDMA_LLI_ITEMS(pSeg->Count)) > MaxItems)) {
+			return -1;
+		}
+		if ((pCfg->TransferType != GPDMA_TRANSFERTYPE_P2M) && ((src & align) \
+				|| !(GPDMA_IS_RAM(src, size) || GPDMA_IS_FLASH(src, size)))) {
+			return -1;
+		}
+		if ((pCfg->TransferType != GPDMA_TRANSFERTYPE_M2P) && ((dst & align) \
+				|| !GPDMA_IS_RAM(dst, size))) {
+			return -1;
+		}
+
+		for (left = pSeg->Count; left > 0; left -= k) {
+			k = (left > GPDMA_MAX_TRANSFERSIZE) ? GPDMA_MAX_TRANSFERSIZE : left;
+			pLLI[n].SrcAddr = src;
+			pLLI[n].DstAddr = dst;
+			pLLI[n].NextLLI = (uint32_t)&pLLI[n + 1];
+			pLLI[n].Control = ctrl | GPDMA_DMACCxControl_TransferSize(k);
+			if ((k == left) && !(pCfg->Options & GPDMA_LLI_OPT_INT_NONE) \
+					&& ((pCfg->Options & GPDMA_LLI_OPT_INT_SEG) || (i == (pCfg->NumSeg - 1)))) {
+				pLLI[n].Control |= GPDMA_DMACCxControl_I;
+			}
+			if (pCfg->TransferType != GPDMA_TRANSFERTYPE_P2M) {
+				src += k << pCfg->TransferWidth;
+			}
+			if (pCfg->TransferType != GPDMA_TRANSFERTYPE_M2P) {
+				dst += k << pCfg->TransferWidth;
+			}
+			n++;
+		}
+	}
+
+	pLLI[n - 1].NextLLI = (pCfg->Options & GPDMA_LLI_OPT_CIRCULAR) ? (uint32_t)&pLLI[0] : 0;
+	return n;
+}
+
+/*********************************************************************//**
+ * @brief		Setup a GPDMA channel to run a chain built by GPDMA_LLIBuild().
+ * 				Item 0 is loaded into the channel registers as is, so its
+ * 				width and interrupt bit override the defaults GPDMA_Setup()
+ * 				would use, and the channel continues with item 1.
+ * @param[in]	ChannelNum	GPDMA channel, should be in range from 0 to 7
+ * @param[in]	pCfg		Chain description passed to GPDMA_LLIBuild()
+ * @param[in]	pLLI		Built chain, must stay valid while the channel runs
+ * @return		ERROR if the channel is enabled, SUCCESS otherwise. The
+ * 				channel is left disabled, see GPDMA_ChannelCmd()
+ **********************************************************************/
+Status GPDMA_SetupLLI(uint32_t ChannelNum, const GPDMA_LLI_CFG_Type *pCfg, GPDMA_LLI_Type *pLLI)
+{
+	GPDMA_Channel_CFG_Type GPDMACfg;
+	LPC_GPDMACH_TypeDef *pDMAch;
+
+	CHECK_PARAM(PARAM_GPDMA_CHANNEL(ChannelNum));
+
+	GPDMACfg.ChannelNum = ChannelNum;
+	GPDMACfg.TransferSize = pLLI[0].Control & GPDMA_DMACCxControl_TransferSize(GPDMA_MAX_TRANSFERSIZE);
+	GPDMACfg.TransferWidth = pCfg->TransferWidth;
+	GPDMACfg.SrcMemAddr = pLLI[0].SrcAddr;
+	GPDMACfg.DstMemAddr = pLLI[0].DstAddr;
+	GPDMACfg.TransferType = pCfg->TransferType;
+	GPDMACfg.SrcConn = pCfg->SrcConn;
+	GPDMACfg.DstConn = pCfg->DstConn;
+	GPDMACfg.DMALLI = pLLI[0].NextLLI;
+	if (GPDMA_Setup(&GPDMACfg) == ERROR) {
+		return ERROR;
+	}
+
+	pDMAch = (LPC_GPDMACH_TypeDef *) pGPDMACh[ChannelNum];
+	pDMAch->DMACCControl = pLLI[0].Control;
+	return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief		Allocate a GPDMA channel for a long-lived user such as a
+ * 				stream. The owner configures the channel with GPDMA_Setup()
+ * 				and gets every interrupt of the channel through pfnCallback,
+ * 				called from GPDMA_IntHandler(). Interrupt flags are cleared
+ * 				before the callback, the channel stays allocated until
+ * 				GPDMA_ChannelFree() is called.
+ * @param[in]	Priority	Allocation priority, should be:
+ * 					- GPDMA_CHPRIO_HIGH: lowest free channel number
+ * 					- GPDMA_CHPRIO_LOW: highest free channel number
+ * @param[in]	pfnCallback	Interrupt callback, may be NULL
+ * @param[in]	pArg		User argument passed to the callback
+ * @return		Channel number (0 to 7), or -1 if all channels are busy
+ **********************************************************************/
+int32_t GPDMA_ChannelAlloc(uint32_t Priority, fnGPDMACbs_Type pfnCallback, void *pArg)
+{
+	uint32_t primask;
+	int32_t ch;
+
+	CHECK_PARAM(PARAM_GPDMA_CHPRIO(Priority));
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	ch = gpdma_take_channel(Priority);
+	if (ch >= 0) {
+		gpdma_ch[ch].pfnCallback = pfnCallback;
+		gpdma_ch[ch].pArg = pArg;
+	}
+	__set_PRIMASK(primask);
+
+	return ch;
+}
+
+/*********************************************************************//**
+ * @brief		Release a channel taken with GPDMA_ChannelAlloc(). The
+ * 				channel is disabled and the first queued transfer, if any,
+ * 				is started on a free channel.
+ * @param[in]	ChannelNum	GPDMA channel, should be in range from 0 to 7
+ * @return		None
+ **********************************************************************/
+void GPDMA_ChannelFree(uint32_t ChannelNum)
+{
+	uint32_t primask;
+
+	CHECK_PARAM(PARAM_GPDMA_CHANNEL(ChannelNum));
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	if ((gpdma_ch[ChannelNum].used == ENABLE) && (gpdma_ch[ChannelNum].pXfer == NULL)) {
+		GPDMA_ChannelCmd(ChannelNum, DISABLE);
+		LPC_GPDMA->DMACIntTCClear = GPDMA_DMACIntTCClear_Ch(ChannelNum);
+		LPC_GPDMA->DMACIntErrClr = GPDMA_DMACIntErrClr_Ch(ChannelNum);
+		gpdma_release_channel(ChannelNum);
+		gpdma_dispatch_queue();
+	}
+	__set_PRIMASK(primask);
+}
+
+/*********************************************************************//**
+ * @brief		Submit a one-shot transfer. The transfer starts at once
+ * 				on a free channel, or waits in the queue until a channel
+ * 				is released. pfnCallback is called from GPDMA_IntHandler()
+ * 				on every terminal count of the transfer (one per LLI with
+ * 				the I bit set) and once with the channel already released
+ * 				when the transfer ends or fails.
+ * @param[in]	pXfer	Transfer descriptor, owned by the caller until the
+ * 						transfer ends. Config.ChannelNum is ignored.
+ * @return		SUCCESS if the transfer is started or queued, ERROR if
+ * 				its configuration is rejected by GPDMA_Setup()
+ **********************************************************************/
+Status GPDMA_Submit(GPDMA_XFER_Type *pXfer)
+{
+	GPDMA_XFER_Type **pp;
+	uint32_t primask;
+	int32_t ch;
+	Status ret = SUCCESS;
+
+	CHECK_PARAM(PARAM_GPDMA_CHPRIO(pXfer->Priority));
+	CHECK_PARAM(PARAM_GPDMA_TRANSFERTYPE(pXfer->Config.TransferType));
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+
+	gpdma_stats.Submitted++;
+	pXfer->SubmitTime = GPDMA_DWT_CYCCNT;
+	pXfer->pNext = NULL;
+
+	ch = (gpdma_queue == NULL) ? gpdma_take_channel(pXfer->Priority) : -1;
+	if (ch >= 0) {
+		if (gpdma_start_xfer(ch, pXfer) == ERROR) {
+			gpdma_stats.Errors++;
+			ret = ERROR;
+		}
+	} else {
+		/* Keep high priority transfers ahead of low priority ones */
+		pp = &gpdma_queue;
+		while ((*pp != NULL) && ((*pp)->Priority <= pXfer->Priority)) {
+			pp = &(*pp)->pNext;
+		}
+		pXfer->pNext = *pp;
+		*pp = pXfer;
+		if (++gpdma_stats.Queued > gpdma_stats.QueuedPeak) {
+			gpdma_stats.QueuedPeak = gpdma_stats.Queued;
+		}
+		/* Channels enabled through GPDMA_Setup() may have finished */
+		gpdma_dispatch_queue();
+	}
+
+	__set_PRIMASK(primask);
+	return ret;
+}
+
+/*********************************************************************//**
+ * @brief		GPDMA interrupt handler for channels of the channel manager,
+ * 				should be called from DMA_IRQHandler(). Interrupts of
+ * 				channels not allocated through the manager are left
+ * 				pending for their own handler.
+ * @param		None
+ * @return		None
+ **********************************************************************/
+void GPDMA_IntHandler(void)
+{
+	GPDMA_XFER_Type *pXfer;
+	fnGPDMACbs_Type pfnCallback;
+	uint32_t ch, stat, event, primask;
+
+	stat = LPC_GPDMA->DMACIntStat;
+	for (ch = 0; ch < 8; ch++) {
+		if (!(stat & GPDMA_DMACIntStat_Ch(ch)) || (gpdma_ch[ch].used == DISABLE)) {
+			continue;
+		}
+
+		event = 0;
+		if (LPC_GPDMA->DMACIntTCStat & GPDMA_DMACIntTCStat_Ch(ch)) {
+			LPC_GPDMA->DMACIntTCClear = GPDMA_DMACIntTCClear_Ch(ch);
+			event |= GPDMA_EVT_TC;
+		}
+		if (LPC_GPDMA->DMACIntErrStat & GPDMA_DMACIntErrStat_Ch(ch)) {
+			LPC_GPDMA->DMACIntErrClr = GPDMA_DMACIntErrClr_Ch(ch);
+			GPDMA_ChannelCmd(ch, DISABLE);
+			event |= GPDMA_EVT_ERR;
+		}
+
+		pXfer = gpdma_ch[ch].pXfer;
+		if (pXfer == NULL) {
+			/* Long-lived owner, it handles the channel itself */
+			if (gpdma_ch[ch].pfnCallback != NULL) {
+				gpdma_ch[ch].pfnCallback(ch, event, gpdma_ch[ch].pArg);
+			}
+			continue;
+		}
+
+		pfnCallback = pXfer->pfnCallback;
+		if (!(event & GPDMA_EVT_ERR)
+				&& (LPC_GPDMA->DMACEnbldChns & GPDMA_DMACEnbldChns_Ch(ch))) {
+			/* Terminal count of an intermediate LLI */
+			if (pfnCallback != NULL) {
+				pfnCallback(ch, event, pXfer->pArg);
+			}
+			continue;
+		}
+
+		/* Transfer ended, hand the channel to the next waiting transfer */
+		primask = __get_PRIMASK();
+		__disable_irq();
+		if (event & GPDMA_EVT_ERR) {
+			gpdma_stats.Errors++;
+		} else {
+			gpdma_stats.Completed++;
+		}
+		gpdma_release_channel(ch);
+		gpdma_dispatch_queue();
+		__set_PRIMASK(primask);
+
+		if (pfnCallback != NULL) {
+			pfnCallback(ch, event, pXfer->pArg);
+		}
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Read the channel manager counters
+ * @param[out]	pStats	Pointer to a GPDMA_STATS_Type to fill in
+ * @return		None
+ **********************************************************************/
+void GPDMA_GetStats(GPDMA_STATS_Type *pStats)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	*pStats = gpdma_stats;
+	__set_PRIMASK(primask);
+}
+
+/*********************************************************************//**
+ * @brief		Reset the cumulative channel manager counters. Queued and
+ * 				Busy keep tracking the current state, peaks restart from it.
+ * @param		None
+ * @return		None
+ **********************************************************************/
+void GPDMA_ResetStats(void)
+{
+	uint32_t primask;
+
+	primask = __get_PRIMASK();
+	__disable_irq();
+	gpdma_stats.Submitted = 0;
+	gpdma_stats.Completed = 0;
+	gpdma_stats.Errors = 0;
+	gpdma_stats.LatencyMax = 0;
+	gpdma_stats.LatencyTotal = 0;
+	gpdma_stats.QueuedPeak = gpdma_stats.Queued;
+	gpdma_stats.BusyPeak = gpdma_stats.Busy;
+	__set_PRIMASK(primask);
+}
+
 /**
  * @}
  */
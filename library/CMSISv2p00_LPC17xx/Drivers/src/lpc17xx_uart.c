@@ -25,6 +25,7 @@
 /* Includes ------------------------------------------------------------------- */
 #include "lpc17xx_uart.h"
 #include "lpc17xx_clkpwr.h"
+#include "lpc17xx_gpdma.h"
 
 /* If this source file built with example, the LPC17xx FW library configuration
  * file in each example directory ("lpc17xx_libcfg.h") must be included,
@@ -39,10 +40,130 @@
 
 #ifdef _UART
 
+/* Private Types -------------------------------------------------------------- */
+/** @defgroup UART_Private_Types UART Private Types
+ * @{
+ */
+
+/**
+ * @brief UART ring buffer state. Indexes are free running, the ring position
+ * is obtained by masking them with (size - 1). Tx head and Rx tail are only
+ * written by the application, Tx tail and Rx head only by the interrupt
+ * handler, so no critical section is needed around them.
+ */
+typedef struct
+{
+    UART_RING_CFG_Type  cfg;                /* Ring configuration (buffers, sizes, callback) */
+    __IO uint32_t       tx_head;            /* Tx write index (application) */
+    __IO uint32_t       tx_tail;            /* Tx read index (interrupt) */
+    __IO uint32_t       rx_head;            /* Rx write index (interrupt) */
+    __IO uint32_t       rx_tail;            /* Rx read index (application) */
+    __IO uint32_t       rx_dropped;         /* Bytes lost because the Rx ring was full */
+    __IO FlagStatus     tx_active;          /* SET while the Tx FIFO is being refilled on THRE */
+    FlagStatus          tx_low_armed;       /* TXLOW may fire on the next drop below watermark */
+    FlagStatus          rx_high_armed;      /* RXHIGH may fire on the next rise to watermark */
+    FunctionalState     enabled;            /* Ring attached to this UART */
+} UART_RING_T;
+
+#ifdef _GPDMA
+/**
+ * @brief UART DMA stream state. An Rx stream runs a circular two item LLI
+ * chain (buffer 0 -> buffer 1 -> buffer 0). A Tx stream sends each
+ * committed buffer as a one item chain; a buffer committed while the other
+ * one is being sent is linked behind it, so the GPDMA goes on by itself and
+ * the interrupt handler only restarts the channel if it stopped first.
+ */
+typedef struct
+{
+    UART_DMA_CFG_Type   cfg;                /* Stream configuration (channel, buffers, callback) */
+    GPDMA_LLI_Type      lli[2];             /* Linked list items, one per buffer */
+    __IO uint32_t       cur;                /* Rx: buffer being filled. Tx: buffer handed to the application */
+    __IO uint32_t       head;               /* Tx: buffer the channel sends first */
+    __IO uint32_t       state[2];           /* Tx: buffer states, UART_DMA_BUF_xxx */
+    __IO uint32_t       len[2];             /* Tx: committed lengths */
+    FunctionalState     enabled;            /* Stream running on this UART */
+    FlagStatus          allocated;          /* Channel taken from the GPDMA channel manager */
+} UART_DMA_T;
+#endif /* _GPDMA */
+
+/**
+ * @}
+ */
+
+/* Private Variables ---------------------------------------------------------- */
+/**
+ * @brief Ring buffer state for UART0..UART3
+ */
+static UART_RING_T uart_ring[4];
+
+#ifdef _GPDMA
+/** Tx DMA stream buffer states */
+#define UART_DMA_BUF_FREE       (0)     /* Owned by the driver */
+#define UART_DMA_BUF_FILLING    (1)     /* Handed to the application */
+#define UART_DMA_BUF_QUEUED     (2)     /* Committed, waiting for the channel to restart */
+#define UART_DMA_BUF_ACTIVE     (3)     /* Being sent, or linked behind the one being sent */
+
+/** GPDMA channel registers from the channel number */
+#define UART_DMA_CH(n)          ((LPC_GPDMACH_TypeDef *)(LPC_GPDMACH0_BASE + ((n) * 0x20)))
+
+/**
+ * @brief DMA stream state for UART0..UART3
+ */
+static UART_DMA_T uart_dma_rx[4];
+static UART_DMA_T uart_dma_tx[4];
+
+/** UART peripheral from the UART number */
+static LPC_UART_TypeDef * const uart_dma_port[4] = {
+    (LPC_UART_TypeDef *)LPC_UART0, (LPC_UART_TypeDef *)LPC_UART1,
+    LPC_UART2, LPC_UART3
+};
+#endif /* _GPDMA */
+
 /* Private Functions ---------------------------------------------------------- */
 
 static Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate);
 
+/* Get UART number */
+static int32_t uart_get_num(LPC_UART_TypeDef *UARTx);
+
+/* Get the ring attached to a UART, NULL if none */
+static UART_RING_T *uart_get_ring(LPC_UART_TypeDef *UARTx);
+
+/* Move data from the Tx ring into the Tx FIFO */
+static uint32_t uart_ring_tx_fill(LPC_UART_TypeDef *UARTx, UART_RING_T *ring);
+
+/* Move data from the Rx FIFO into the Rx ring */
+static uint32_t uart_ring_rx_drain(LPC_UART_TypeDef *UARTx, UART_RING_T *ring);
+
+#ifdef _GPDMA
+/* Check a DMA stream configuration */
+static Status uart_dma_check_cfg(UART_DMA_CFG_Type *DmaCfg);
+
+/* Build the linked list item of a Tx DMA stream buffer */
+static Status uart_dma_tx_item(int32_t num, uint32_t idx);
+
+/* Start sending a committed Tx DMA stream buffer */
+static void uart_dma_tx_start(int32_t num, uint32_t idx);
+
+/* Take the channel of a DMA stream, allocating it if requested */
+static Status uart_dma_take_channel(UART_DMA_T *strm, UART_DMA_CFG_Type *DmaCfg, \
+                                    uint32_t Priority, fnGPDMACbs_Type pfnCallback);
+
+/* Stop a DMA stream and release its channel */
+static void uart_dma_release(UART_DMA_T *strm);
+
+/* Read and clear the interrupt flags of a fixed stream channel */
+static uint32_t uart_dma_get_event(uint32_t ch);
+
+/* Handle GPDMA events of the Rx and Tx DMA streams */
+static void uart_dma_rx_event(int32_t num, uint32_t event);
+static void uart_dma_tx_event(int32_t num, uint32_t event);
+
+/* GPDMA channel manager callbacks of GPDMA_CHANNEL_AUTO streams */
+static void uart_dma_rx_cbs(uint32_t ChannelNum, uint32_t Event, void *pArg);
+static void uart_dma_tx_cbs(uint32_t ChannelNum, uint32_t Event, void *pArg);
+#endif /* _GPDMA */
+
 
 /*********************************************************************//**
  * @brief        Determines best dividers to get a target clock rate
@@ -169,6 +290,103 @@ static Status uart_set_divisors(LPC_UART_TypeDef *UARTx, uint32_t baudrate)
 /** @addtogroup UART_Public_Functions
  * @{
  */
+/*********************************************************************//**
+ * @brief        Convert from UART peripheral to number
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *                 - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @return         UART number, could be: 0..3, or -1 if invalid
+ **********************************************************************/
+static int32_t uart_get_num(LPC_UART_TypeDef *UARTx)
+{
+    if (UARTx == (LPC_UART_TypeDef *)LPC_UART0) {
+        return (0);
+    } else if (((LPC_UART1_TypeDef *)UARTx) == LPC_UART1) {
+        return (1);
+    } else if (UARTx == (LPC_UART_TypeDef *)LPC_UART2) {
+        return (2);
+    } else if (UARTx == (LPC_UART_TypeDef *)LPC_UART3) {
+        return (3);
+    }
+    return (-1);
+}
+
+/*********************************************************************//**
+ * @brief        Get the ring buffer attached to a UART
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         Pointer to the ring state, or NULL if no ring is attached
+ **********************************************************************/
+static UART_RING_T *uart_get_ring(LPC_UART_TypeDef *UARTx)
+{
+    int32_t num = uart_get_num(UARTx);
+
+    if ((num < 0) || (uart_ring[num].enabled == DISABLE)) {
+        return NULL;
+    }
+    return &uart_ring[num];
+}
+
+/*********************************************************************//**
+ * @brief        Move up to UART_TX_FIFO_SIZE bytes from the Tx ring into
+ *                 the Tx FIFO. Must only be called when THR is empty.
+ * @param[in]    UARTx    UART peripheral selected
+ * @param[in]    ring    Ring attached to UARTx
+ * @return         Number of bytes written to the Tx FIFO
+ *
+ * Note: the UART1 register block has the same THR offset as the others,
+ * so it is accessed through LPC_UART_TypeDef here.
+ **********************************************************************/
+static uint32_t uart_ring_tx_fill(LPC_UART_TypeDef *UARTx, UART_RING_T *ring)
+{
+    uint32_t tail = ring->tx_tail;
+    uint32_t count = ring->tx_head - tail;
+    uint32_t mask = ring->cfg.TxSize - 1;
+    uint32_t n;
+
+    if (count > UART_TX_FIFO_SIZE) {
+        count = UART_TX_FIFO_SIZE;
+    }
+    for (n = 0; n < count; n++) {
+        UARTx->THR = ring->cfg.TxBuf[(tail + n) & mask];
+    }
+    ring->tx_tail = tail + count;
+    return count;
+}
+
+/*********************************************************************//**
+ * @brief        Move every byte available in the Rx FIFO into the Rx ring.
+ *                 Bytes that do not fit are read out and dropped.
+ * @param[in]    UARTx    UART peripheral selected
+ * @param[in]    ring    Ring attached to UARTx
+ * @return         UART_RING_EVT_RXOVERRUN if data was dropped, otherwise 0
+ **********************************************************************/
+static uint32_t uart_ring_rx_drain(LPC_UART_TypeDef *UARTx, UART_RING_T *ring)
+{
+    uint32_t head = ring->rx_head;
+    uint32_t mask = ring->cfg.RxSize - 1;
+    uint32_t dropped = 0;
+    uint8_t data;
+
+    while (UARTx->LSR & UART_LSR_RDR) {
+        data = UARTx->RBR & UART_RBR_MASKBIT;
+        if ((head - ring->rx_tail) < ring->cfg.RxSize) {
+            ring->cfg.RxBuf[head & mask] = data;
+            head++;
+        } else {
+            dropped++;
+        }
+    }
+    ring->rx_head = head;
+
+    if (dropped) {
+        ring->rx_dropped += dropped;
+        return UART_RING_EVT_RXOVERRUN;
+    }
+    return 0;
+}
+
 /* UART Init/DeInit functions -------------------------------------------------*/
 /********************************************************************//**
  * @brief        Initializes the UARTx peripheral according to the specified
@@ -394,6 +612,10 @@ void UART_DeInit(LPC_UART_TypeDef* UARTx)
     // For debug mode
     CHECK_PARAM(PARAM_UARTx(UARTx));
 
+    UART_RingDeInit(UARTx);
+#ifdef _GPDMA
+    UART_DMAStreamStop(UARTx);
+#endif
     UART_TxCmd(UARTx, DISABLE);
 
 #ifdef _UART0
@@ -512,6 +734,9 @@ uint8_t UART_ReceiveByte(LPC_UART_TypeDef* UARTx)
  *
  * Note: when using UART in BLOCKING mode, a time-out condition is used
  * via defined symbol UART_BLOCKING_TIMEOUT.
+ * If a ring buffer is attached with UART_RingInit(), data is queued in the
+ * Tx ring and sent from the interrupt handler: NONE_BLOCKING queues what
+ * fits, BLOCKING only waits for ring space, never for the line.
  **********************************************************************/
 uint32_t UART_Send(LPC_UART_TypeDef *UARTx, uint8_t *txbuf,
         uint32_t buflen, TRANSFER_BLOCK_Type flag)
@@ -521,6 +746,24 @@ uint32_t UART_Send(LPC_UART_TypeDef *UARTx, uint8_t *txbuf,
 
     bToSend = buflen;
 
+    // Ring buffer attached: queue and return
+    if (uart_get_ring(UARTx) != NULL) {
+        bSent = UART_RingSend(UARTx, pChar, bToSend);
+        if (flag == BLOCKING) {
+            timeOut = UART_BLOCKING_TIMEOUT;
+            while ((bSent < bToSend) && timeOut) {
+                fifo_cnt = UART_RingSend(UARTx, pChar + bSent, bToSend - bSent);
+                if (fifo_cnt) {
+                    bSent += fifo_cnt;
+                    timeOut = UART_BLOCKING_TIMEOUT;
+                } else {
+                    timeOut--;
+                }
+            }
+        }
+        return bSent;
+    }
+
     // blocking mode
     if (flag == BLOCKING) {
         bSent = 0;
@@ -577,15 +820,35 @@ uint32_t UART_Send(LPC_UART_TypeDef *UARTx, uint8_t *txbuf,
  *
  * Note: when using UART in BLOCKING mode, a time-out condition is used
  * via defined symbol UART_BLOCKING_TIMEOUT.
+ * If a ring buffer is attached with UART_RingInit(), data is taken from
+ * the Rx ring filled by the interrupt handler.
  **********************************************************************/
 uint32_t UART_Receive(LPC_UART_TypeDef *UARTx, uint8_t *rxbuf, \
         uint32_t buflen, TRANSFER_BLOCK_Type flag)
 {
-    uint32_t bToRecv, bRecv, timeOut;
+    uint32_t bToRecv, bRecv, timeOut, len;
     uint8_t *pChar = rxbuf;
 
     bToRecv = buflen;
 
+    // Ring buffer attached: take from the Rx ring
+    if (uart_get_ring(UARTx) != NULL) {
+        bRecv = UART_RingReceive(UARTx, pChar, bToRecv);
+        if (flag == BLOCKING) {
+            timeOut = UART_BLOCKING_TIMEOUT;
+            while ((bRecv < bToRecv) && timeOut) {
+                len = UART_RingReceive(UARTx, pChar + bRecv, bToRecv - bRecv);
+                if (len) {
+                    bRecv += len;
+                    timeOut = UART_BLOCKING_TIMEOUT;
+                } else {
+                    timeOut--;
+                }
+            }
+        }
+        return bRecv;
+    }
+
     // Blocking mode
     if (flag == BLOCKING) {
         bRecv = 0;
@@ -1100,6 +1363,792 @@ void UART_IrDAPulseDivConfig(LPC_UART_TypeDef *UARTx, UART_IrDA_PULSE_Type Pulse
 #endif
 
 
+/* UART ring buffer (interrupt driven) functions -----------------------------*/
+/*********************************************************************//**
+ * @brief        Attach a Tx/Rx ring buffer to a UART and enable the Rx data
+ *                 and Rx line status interrupts that service it.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @param[in]    RingCfg    Pointer to a UART_RING_CFG_Type structure with the
+ *                         ring storage, sizes, watermarks and callback
+ * @return         SUCCESS, or ERROR if a ring size is not a power of two
+ *
+ * Note: UARTx must already be initialized with UART_Init(), its FIFOs
+ * enabled with UART_FIFOConfig() and UART_TxCmd() called. The application
+ * enables UARTn_IRQn in the NVIC and calls UART_RingIntHandler() from
+ * UARTn_IRQHandler. While attached, UART_Send() and UART_Receive() go
+ * through the ring. The buffers must stay valid until UART_RingDeInit().
+ **********************************************************************/
+Status UART_RingInit(LPC_UART_TypeDef *UARTx, UART_RING_CFG_Type *RingCfg)
+{
+    int32_t num;
+    UART_RING_T *ring;
+
+    CHECK_PARAM(PARAM_UARTx(UARTx));
+
+    num = uart_get_num(UARTx);
+    if ((num < 0) || (RingCfg->TxBuf == NULL) || (RingCfg->RxBuf == NULL) \
+            || !PARAM_UART_RING_SIZE(RingCfg->TxSize) \
+            || !PARAM_UART_RING_SIZE(RingCfg->RxSize)) {
+        return ERROR;
+    }
+
+    UART_RingDeInit(UARTx);
+
+    ring = &uart_ring[num];
+    ring->cfg = *RingCfg;
+    ring->tx_head = 0;
+    ring->tx_tail = 0;
+    ring->rx_head = 0;
+    ring->rx_tail = 0;
+    ring->rx_dropped = 0;
+    ring->tx_active = RESET;
+    ring->tx_low_armed = RESET;
+    ring->rx_high_armed = SET;
+    ring->enabled = ENABLE;
+
+    /* THRE is enabled by UART_RingSend() when there is data to send */
+    UART_IntConfig(UARTx, UART_INTCFG_RBR, ENABLE);
+    UART_IntConfig(UARTx, UART_INTCFG_RLS, ENABLE);
+
+    return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief        Detach the ring buffer from a UART and disable its Rx data,
+ *                 Rx line status and THRE interrupts. Data still queued in
+ *                 the Tx ring is discarded.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @return         None
+ **********************************************************************/
+void UART_RingDeInit(LPC_UART_TypeDef *UARTx)
+{
+    UART_RING_T *ring;
+
+    CHECK_PARAM(PARAM_UARTx(UARTx));
+
+    ring = uart_get_ring(UARTx);
+    if (ring == NULL) {
+        return;
+    }
+
+    UART_IntConfig(UARTx, UART_INTCFG_THRE, DISABLE);
+    UART_IntConfig(UARTx, UART_INTCFG_RLS, DISABLE);
+    UART_IntConfig(UARTx, UART_INTCFG_RBR, DISABLE);
+    ring->enabled = DISABLE;
+}
+
+/*****************************************************************************//**
+* @brief        Fills each RingCfg member with its default value:
+*                 - No buffers (must be set by the caller)
+*                 - No watermarks
+*                 - No callback
+* @param[in]    RingCfg Pointer to a UART_RING_CFG_Type structure
+*                    which will be initialized.
+* @return        None
+*******************************************************************************/
+void UART_RingConfigStructInit(UART_RING_CFG_Type *RingCfg)
+{
+    RingCfg->TxBuf = NULL;
+    RingCfg->TxSize = 0;
+    RingCfg->RxBuf = NULL;
+    RingCfg->RxSize = 0;
+    RingCfg->TxLowWater = 0;
+    RingCfg->RxHighWater = 0;
+    RingCfg->pfnCallback = NULL;
+}
+
+/*********************************************************************//**
+ * @brief        Queue data in the Tx ring and start transmission if the
+ *                 transmitter is idle. Never waits.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @param[in]    txbuf     Pointer to data to send
+ * @param[in]    buflen     Number of bytes to send
+ * @return         Number of bytes queued, may be less than buflen if the
+ *                 Tx ring is full, 0 if no ring is attached
+ **********************************************************************/
+uint32_t UART_RingSend(LPC_UART_TypeDef *UARTx, const uint8_t *txbuf, uint32_t buflen)
+{
+    UART_RING_T *ring = uart_get_ring(UARTx);
+    uint32_t head, space, mask, n;
+
+    if (ring == NULL) {
+        return 0;
+    }
+
+    head = ring->tx_head;
+    mask = ring->cfg.TxSize - 1;
+    space = ring->cfg.TxSize - (head - ring->tx_tail);
+    if (buflen > space) {
+        buflen = space;
+    }
+    for (n = 0; n < buflen; n++) {
+        ring->cfg.TxBuf[(head + n) & mask] = txbuf[n];
+    }
+    ring->tx_head = head + buflen;
+
+    if ((ring->cfg.TxLowWater != 0) \
+            && ((head + buflen - ring->tx_tail) > ring->cfg.TxLowWater)) {
+        ring->tx_low_armed = SET;
+    }
+
+    /* Transmitter idle: nothing will raise THRE, so prime the FIFO here.
+     * The THRE interrupt is masked meanwhile so the handler does not race
+     * with this refill. */
+    if ((buflen != 0) && (ring->tx_active == RESET)) {
+        UART_IntConfig(UARTx, UART_INTCFG_THRE, DISABLE);
+        if (ring->tx_active == RESET) {
+            if (UARTx->LSR & UART_LSR_THRE) {
+                uart_ring_tx_fill(UARTx, ring);
+            }
+            ring->tx_active = SET;
+        }
+        UART_IntConfig(UARTx, UART_INTCFG_THRE, ENABLE);
+    }
+
+    return buflen;
+}
+
+/*********************************************************************//**
+ * @brief        Take received data out of the Rx ring. Never waits.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @param[out]    rxbuf     Pointer to receive buffer
+ * @param[in]    buflen     Size of receive buffer
+ * @return         Number of bytes copied to rxbuf, 0 if no ring is attached
+ **********************************************************************/
+uint32_t UART_RingReceive(LPC_UART_TypeDef *UARTx, uint8_t *rxbuf, uint32_t buflen)
+{
+    UART_RING_T *ring = uart_get_ring(UARTx);
+    uint32_t tail, count, mask, n;
+
+    if (ring == NULL) {
+        return 0;
+    }
+
+    tail = ring->rx_tail;
+    mask = ring->cfg.RxSize - 1;
+    count = ring->rx_head - tail;
+    if (buflen > count) {
+        buflen = count;
+    }
+    for (n = 0; n < buflen; n++) {
+        rxbuf[n] = ring->cfg.RxBuf[(tail + n) & mask];
+    }
+    ring->rx_tail = tail + buflen;
+
+    if ((count - buflen) < ring->cfg.RxHighWater) {
+        ring->rx_high_armed = SET;
+    }
+
+    return buflen;
+}
+
+/*********************************************************************//**
+ * @brief        Get the number of bytes queued in the Tx ring and not yet
+ *                 moved to the Tx FIFO
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         Pending Tx byte count, 0 if no ring is attached
+ **********************************************************************/
+uint32_t UART_RingGetTxCount(LPC_UART_TypeDef *UARTx)
+{
+    UART_RING_T *ring = uart_get_ring(UARTx);
+
+    return (ring == NULL) ? 0 : (ring->tx_head - ring->tx_tail);
+}
+
+/*********************************************************************//**
+ * @brief        Get the number of received bytes waiting in the Rx ring
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         Buffered Rx byte count, 0 if no ring is attached
+ **********************************************************************/
+uint32_t UART_RingGetRxCount(LPC_UART_TypeDef *UARTx)
+{
+    UART_RING_T *ring = uart_get_ring(UARTx);
+
+    return (ring == NULL) ? 0 : (ring->rx_head - ring->rx_tail);
+}
+
+/*********************************************************************//**
+ * @brief        Get the number of received bytes dropped because the Rx
+ *                 ring was full, since UART_RingInit()
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         Dropped byte count, 0 if no ring is attached
+ **********************************************************************/
+uint32_t UART_RingGetRxDropped(LPC_UART_TypeDef *UARTx)
+{
+    UART_RING_T *ring = uart_get_ring(UARTx);
+
+    return (ring == NULL) ? 0 : ring->rx_dropped;
+}
+
+/*********************************************************************//**
+ * @brief        Ring buffer interrupt service. Call it from the UARTn
+ *                 interrupt handler of a UART with a ring attached.
+ *                 Drains the Rx FIFO on RDA/CTI, refills the Tx FIFO on
+ *                 THRE and reports events to the ring callback.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @return         None
+ **********************************************************************/
+void UART_RingIntHandler(LPC_UART_TypeDef *UARTx)
+{
+    UART_RING_T *ring = uart_get_ring(UARTx);
+    uint32_t intsrc, event = 0;
+
+    if (ring == NULL) {
+        return;
+    }
+
+    /* Service every pending source: reading IIR acknowledges THRE, reading
+     * LSR acknowledges RLS and reading RBR acknowledges RDA/CTI */
+    while (!((intsrc = UARTx->IIR) & UART_IIR_INTSTAT_PEND)) {
+        switch (intsrc & UART_IIR_INTID_MASK) {
+        case UART_IIR_INTID_RLS:
+            if (UARTx->LSR & (UART_LSR_OE | UART_LSR_PE | UART_LSR_FE \
+                    | UART_LSR_BI | UART_LSR_RXFE)) {
+                event |= UART_RING_EVT_LINEERR;
+            }
+            event |= uart_ring_rx_drain(UARTx, ring);
+            break;
+
+        case UART_IIR_INTID_CTI:
+            event |= UART_RING_EVT_RXIDLE;
+            /* no break */
+        case UART_IIR_INTID_RDA:
+            event |= uart_ring_rx_drain(UARTx, ring);
+            break;
+
+        case UART_IIR_INTID_THRE:
+            if (uart_ring_tx_fill(UARTx, ring) == 0) {
+                ring->tx_active = RESET;
+                event |= UART_RING_EVT_TXDONE;
+            }
+            break;
+
+        default:
+            /* Modem status (UART1): reading MSR clears it */
+            (void)((LPC_UART1_TypeDef *)UARTx)->MSR;
+            break;
+        }
+    }
+
+    if ((ring->tx_low_armed == SET) \
+            && ((ring->tx_head - ring->tx_tail) <= ring->cfg.TxLowWater)) {
+        ring->tx_low_armed = RESET;
+        event |= UART_RING_EVT_TXLOW;
+    }
+    if ((ring->cfg.RxHighWater != 0) && (ring->rx_high_armed == SET) \
+            && ((ring->rx_head - ring->rx_tail) >= ring->cfg.RxHighWater)) {
+        ring->rx_high_armed = RESET;
+        event |= UART_RING_EVT_RXHIGH;
+    }
+
+    if (event && (ring->cfg.pfnCallback != NULL)) {
+        ring->cfg.pfnCallback(UARTx, event);
+    }
+}
+
+
+#ifdef _GPDMA
+/* UART DMA stream functions ---------------------------------------------------*/
+/*********************************************************************//**
+ * @brief        Check a DMA stream configuration
+ * @param[in]    DmaCfg    Pointer to a UART_DMA_CFG_Type structure
+ * @return         SUCCESS or ERROR
+ **********************************************************************/
+static Status uart_dma_check_cfg(UART_DMA_CFG_Type *DmaCfg)
+{
+    if (((DmaCfg->ChannelNum > 7) && (DmaCfg->ChannelNum != GPDMA_CHANNEL_AUTO)) \
+            || (DmaCfg->Buf[0] == NULL) \
+            || (DmaCfg->Buf[1] == NULL) || (DmaCfg->BufSize == 0) \
+            || (DmaCfg->BufSize > UART_DMA_MAX_BUFSIZE)) {
+        return ERROR;
+    }
+    return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief        Build the one item chain that sends a Tx stream buffer
+ * @param[in]    num        UART number, 0..3
+ * @param[in]    idx        Buffer index, 0 or 1, with its length set
+ * @return         SUCCESS, or ERROR if the GPDMA cannot read the buffer
+ **********************************************************************/
+static Status uart_dma_tx_item(int32_t num, uint32_t idx)
+{
+    UART_DMA_T *strm = &uart_dma_tx[num];
+    GPDMA_SEG_Type seg;
+    GPDMA_LLI_CFG_Type LLICfg;
+
+    seg.SrcAddr = (uint32_t)strm->cfg.Buf[idx];
+    seg.DstAddr = 0;
+    seg.Count = strm->len[idx];
+    LLICfg.TransferType = GPDMA_TRANSFERTYPE_M2P;
+    LLICfg.TransferWidth = GPDMA_WIDTH_BYTE;
+    LLICfg.SrcConn = 0;
+    LLICfg.DstConn = GPDMA_CONN_UART0_Tx + (2 * num);
+    LLICfg.pSeg = &seg;
+    LLICfg.NumSeg = 1;
+    LLICfg.Options = 0;
+
+    return (GPDMA_LLIBuild(&strm->lli[idx], 1, &LLICfg) == 1) ? SUCCESS : ERROR;
+}
+
+/*********************************************************************//**
+ * @brief        Load a committed Tx stream buffer into the channel and
+ *                 enable it. The channel must be idle.
+ * @param[in]    num        UART number, 0..3
+ * @param[in]    idx        Buffer index, 0 or 1, with its item built
+ * @return         None
+ **********************************************************************/
+static void uart_dma_tx_start(int32_t num, uint32_t idx)
+{
+    UART_DMA_T *strm = &uart_dma_tx[num];
+    GPDMA_LLI_CFG_Type LLICfg;
+
+    LLICfg.TransferType = GPDMA_TRANSFERTYPE_M2P;
+    LLICfg.TransferWidth = GPDMA_WIDTH_BYTE;
+    LLICfg.SrcConn = 0;
+    LLICfg.DstConn = GPDMA_CONN_UART0_Tx + (2 * num);
+
+    strm->state[idx] = UART_DMA_BUF_ACTIVE;
+    strm->head = idx;
+    GPDMA_SetupLLI(strm->cfg.ChannelNum, &LLICfg, &strm->lli[idx]);
+    GPDMA_ChannelCmd(strm->cfg.ChannelNum, ENABLE);
+}
+
+/*********************************************************************//**
+ * @brief        Copy the configuration into a stream and take its channel.
+ *                 A GPDMA_CHANNEL_AUTO channel comes from GPDMA_ChannelAlloc()
+ *                 and its interrupts are routed back through pfnCallback.
+ * @param[in]    strm        Stream, must be stopped
+ * @param[in]    DmaCfg        Stream configuration
+ * @param[in]    Priority    Allocation priority, GPDMA_CHPRIO_xxx
+ * @param[in]    pfnCallback    GPDMA callback for an allocated channel
+ * @return         SUCCESS, or ERROR if no channel is free
+ **********************************************************************/
+static Status uart_dma_take_channel(UART_DMA_T *strm, UART_DMA_CFG_Type *DmaCfg, \
+                                    uint32_t Priority, fnGPDMACbs_Type pfnCallback)
+{
+    int32_t ch;
+
+    strm->cfg = *DmaCfg;
+    strm->allocated = RESET;
+    if (DmaCfg->ChannelNum == GPDMA_CHANNEL_AUTO) {
+        ch = GPDMA_ChannelAlloc(Priority, pfnCallback, strm);
+        if (ch < 0) {
+            return ERROR;
+        }
+        strm->cfg.ChannelNum = ch;
+        strm->allocated = SET;
+    }
+    return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief        Stop a stream and give an allocated channel back
+ * @param[in]    strm    Stream
+ * @return         None
+ **********************************************************************/
+static void uart_dma_release(UART_DMA_T *strm)
+{
+    if (strm->enabled == DISABLE) {
+        return;
+    }
+    strm->enabled = DISABLE;
+    GPDMA_ChannelCmd(strm->cfg.ChannelNum, DISABLE);
+    if (strm->allocated == SET) {
+        strm->allocated = RESET;
+        GPDMA_ChannelFree(strm->cfg.ChannelNum);
+    }
+}
+
+/*********************************************************************//**
+ * @brief        Read and clear the interrupt flags of a stream channel
+ *                 that is not handled by the GPDMA channel manager
+ * @param[in]    ch        GPDMA channel
+ * @return         GPDMA_EVT_xxx flags
+ **********************************************************************/
+static uint32_t uart_dma_get_event(uint32_t ch)
+{
+    uint32_t event = 0;
+
+    if (GPDMA_IntGetStatus(GPDMA_STAT_INTTC, ch) == SET) {
+        GPDMA_ClearIntPending(GPDMA_STATCLR_INTTC, ch);
+        event |= GPDMA_EVT_TC;
+    }
+    if (GPDMA_IntGetStatus(GPDMA_STAT_INTERR, ch) == SET) {
+        GPDMA_ClearIntPending(GPDMA_STATCLR_INTERR, ch);
+        event |= GPDMA_EVT_ERR;
+    }
+    return event;
+}
+
+/*********************************************************************//**
+ * @brief        Rx stream event: one buffer completed and the chain already
+ *                 moved to the other one, or a bus error stopped the stream
+ * @param[in]    num        UART number, 0..3
+ * @param[in]    event    GPDMA_EVT_xxx flags, already cleared
+ * @return         None
+ **********************************************************************/
+static void uart_dma_rx_event(int32_t num, uint32_t event)
+{
+    UART_DMA_T *strm = &uart_dma_rx[num];
+    LPC_UART_TypeDef *UARTx = uart_dma_port[num];
+    uint32_t idx;
+
+    if (event & GPDMA_EVT_TC) {
+        idx = strm->cur;
+        strm->cur = idx ^ 1;
+        if (strm->cfg.pfnCallback != NULL) {
+            strm->cfg.pfnCallback(UARTx, \
+                    (idx == 0) ? UART_DMA_EVT_RX_HALF : UART_DMA_EVT_RX_FULL, \
+                    strm->cfg.Buf[idx], strm->cfg.BufSize);
+        }
+    }
+    if (event & GPDMA_EVT_ERR) {
+        uart_dma_release(strm);
+        if (strm->cfg.pfnCallback != NULL) {
+            strm->cfg.pfnCallback(UARTx, UART_DMA_EVT_ERROR, NULL, 0);
+        }
+    }
+}
+
+/*********************************************************************//**
+ * @brief        Tx stream event: one or both buffers are sent. While the
+ *                 channel runs it is on the newest buffer, once stopped all
+ *                 of them are done. A buffer that missed the link is started
+ *                 before telling the application, so the line does not go
+ *                 idle meanwhile.
+ * @param[in]    num        UART number, 0..3
+ * @param[in]    event    GPDMA_EVT_xxx flags, already cleared
+ * @return         None
+ **********************************************************************/
+static void uart_dma_tx_event(int32_t num, uint32_t event)
+{
+    UART_DMA_T *strm = &uart_dma_tx[num];
+    LPC_UART_TypeDef *UARTx = uart_dma_port[num];
+    uint32_t done[2], n, i, running;
+
+    if (event & GPDMA_EVT_TC) {
+        running = LPC_GPDMA->DMACEnbldChns & GPDMA_DMACEnbldChns_Ch(strm->cfg.ChannelNum);
+        n = 0;
+        while ((n < 2) && (strm->state[strm->head] == UART_DMA_BUF_ACTIVE) \
+                && (!running || (strm->state[strm->head ^ 1] == UART_DMA_BUF_ACTIVE))) {
+            done[n++] = strm->head;
+            strm->state[strm->head] = UART_DMA_BUF_FREE;
+            strm->head ^= 1;
+        }
+        if (strm->state[strm->head] == UART_DMA_BUF_QUEUED) {
+            uart_dma_tx_start(num, strm->head);
+        }
+        for (i = 0; (i < n) && (strm->cfg.pfnCallback != NULL); i++) {
+            strm->cfg.pfnCallback(UARTx, UART_DMA_EVT_TX_DONE, \
+                    strm->cfg.Buf[done[i]], strm->len[done[i]]);
+        }
+    }
+    if (event & GPDMA_EVT_ERR) {
+        uart_dma_release(strm);
+        if (strm->cfg.pfnCallback != NULL) {
+            strm->cfg.pfnCallback(UARTx, UART_DMA_EVT_ERROR, NULL, 0);
+        }
+    }
+}
+
+/*********************************************************************//**
+ * @brief        GPDMA channel manager callbacks of GPDMA_CHANNEL_AUTO streams
+ * @param[in]    ChannelNum    GPDMA channel
+ * @param[in]    Event        GPDMA_EVT_xxx flags
+ * @param[in]    pArg        Stream the channel belongs to
+ * @return         None
+ **********************************************************************/
+static void uart_dma_rx_cbs(uint32_t ChannelNum, uint32_t Event, void *pArg)
+{
+    uart_dma_rx_event((UART_DMA_T *)pArg - uart_dma_rx, Event);
+}
+
+static void uart_dma_tx_cbs(uint32_t ChannelNum, uint32_t Event, void *pArg)
+{
+    uart_dma_tx_event((UART_DMA_T *)pArg - uart_dma_tx, Event);
+}
+
+/*********************************************************************//**
+ * @brief        Start a continuous DMA receive stream. The GPDMA fills the
+ *                 two buffers alternately without CPU intervention and the
+ *                 callback is told which one is ready (RX_HALF for buffer 0,
+ *                 RX_FULL for buffer 1). The callback must be done with a
+ *                 buffer before the GPDMA wraps back to it.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @param[in]    DmaCfg    Pointer to a UART_DMA_CFG_Type structure
+ * @return         SUCCESS, or ERROR if the configuration is invalid or the
+ *                 channel is in use
+ *
+ * Note: GPDMA_Init() must have been called and the UART FIFO configured
+ * with FIFO_DMAMode = ENABLE. The application enables DMA_IRQn in the NVIC
+ * and calls UART_DMAIntHandler() from DMA_IRQHandler.
+ **********************************************************************/
+Status UART_DMARxStreamStart(LPC_UART_TypeDef *UARTx, UART_DMA_CFG_Type *DmaCfg)
+{
+    int32_t num;
+    UART_DMA_T *strm;
+    GPDMA_SEG_Type seg[2];
+    GPDMA_LLI_CFG_Type LLICfg;
+
+    CHECK_PARAM(PARAM_UARTx(UARTx));
+
+    num = uart_get_num(UARTx);
+    if ((num < 0) || (uart_dma_check_cfg(DmaCfg) == ERROR)) {
+        return ERROR;
+    }
+
+    strm = &uart_dma_rx[num];
+    uart_dma_release(strm);
+    if (uart_dma_take_channel(strm, DmaCfg, GPDMA_CHPRIO_HIGH, uart_dma_rx_cbs) == ERROR) {
+        return ERROR;
+    }
+
+    /* Circular chain buffer 0 -> buffer 1 -> buffer 0, one interrupt per buffer */
+    seg[0].SrcAddr = 0;
+    seg[0].DstAddr = (uint32_t)strm->cfg.Buf[0];
+    seg[0].Count = strm->cfg.BufSize;
+    seg[1].SrcAddr = 0;
+    seg[1].DstAddr = (uint32_t)strm->cfg.Buf[1];
+    seg[1].Count = strm->cfg.BufSize;
+    LLICfg.TransferType = GPDMA_TRANSFERTYPE_P2M;
+    LLICfg.TransferWidth = GPDMA_WIDTH_BYTE;
+    LLICfg.SrcConn = GPDMA_CONN_UART0_Rx + (2 * num);
+    LLICfg.DstConn = 0;
+    LLICfg.pSeg = seg;
+    LLICfg.NumSeg = 2;
+    LLICfg.Options = GPDMA_LLI_OPT_CIRCULAR | GPDMA_LLI_OPT_INT_SEG;
+
+    if ((GPDMA_LLIBuild(strm->lli, 2, &LLICfg) != 2) \
+            || (GPDMA_SetupLLI(strm->cfg.ChannelNum, &LLICfg, strm->lli) == ERROR)) {
+        if (strm->allocated == SET) {
+            strm->allocated = RESET;
+            GPDMA_ChannelFree(strm->cfg.ChannelNum);
+        }
+        return ERROR;
+    }
+
+    strm->cur = 0;
+    strm->enabled = ENABLE;
+    GPDMA_ChannelCmd(strm->cfg.ChannelNum, ENABLE);
+
+    return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief        Get the number of bytes already received into the buffer
+ *                 the Rx stream is currently filling. Useful to flush a
+ *                 partially filled buffer when the line goes idle.
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         Byte count, 0 if no Rx stream is running
+ **********************************************************************/
+uint32_t UART_DMARxStreamGetCount(LPC_UART_TypeDef *UARTx)
+{
+    int32_t num = uart_get_num(UARTx);
+    UART_DMA_T *strm;
+    uint32_t left;
+
+    if ((num < 0) || (uart_dma_rx[num].enabled == DISABLE)) {
+        return 0;
+    }
+    strm = &uart_dma_rx[num];
+    left = UART_DMA_CH(strm->cfg.ChannelNum)->DMACCControl \
+            & GPDMA_DMACCxControl_TransferSize(0xFFF);
+    return (strm->cfg.BufSize - left);
+}
+
+/*********************************************************************//**
+ * @brief        Prepare a DMA transmit stream. Data is sent straight from
+ *                 the two caller-owned buffers: the application fills the
+ *                 buffer returned by UART_DMATxStreamGetBuffer() and hands
+ *                 it over with UART_DMATxStreamCommit(), while the GPDMA
+ *                 sends the other one.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @param[in]    DmaCfg    Pointer to a UART_DMA_CFG_Type structure
+ * @return         SUCCESS, or ERROR if the configuration is invalid
+ *
+ * Note: same requirements as UART_DMARxStreamStart(). Use a different
+ * GPDMA channel for the Rx and Tx streams.
+ **********************************************************************/
+Status UART_DMATxStreamInit(LPC_UART_TypeDef *UARTx, UART_DMA_CFG_Type *DmaCfg)
+{
+    int32_t num;
+    UART_DMA_T *strm;
+
+    CHECK_PARAM(PARAM_UARTx(UARTx));
+
+    num = uart_get_num(UARTx);
+    if ((num < 0) || (uart_dma_check_cfg(DmaCfg) == ERROR)) {
+        return ERROR;
+    }
+
+    strm = &uart_dma_tx[num];
+    uart_dma_release(strm);
+    if (uart_dma_take_channel(strm, DmaCfg, GPDMA_CHPRIO_LOW, uart_dma_tx_cbs) == ERROR) {
+        return ERROR;
+    }
+    strm->cur = 0;
+    strm->head = 0;
+    strm->state[0] = UART_DMA_BUF_FREE;
+    strm->state[1] = UART_DMA_BUF_FREE;
+    strm->len[0] = 0;
+    strm->len[1] = 0;
+    strm->enabled = ENABLE;
+
+    return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief        Get the Tx stream buffer the application may fill next
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         Pointer to a buffer of DmaCfg->BufSize bytes, or NULL if
+ *                 both buffers are queued or being sent
+ **********************************************************************/
+uint8_t *UART_DMATxStreamGetBuffer(LPC_UART_TypeDef *UARTx)
+{
+    int32_t num = uart_get_num(UARTx);
+    UART_DMA_T *strm;
+    uint32_t idx;
+
+    if ((num < 0) || (uart_dma_tx[num].enabled == DISABLE)) {
+        return NULL;
+    }
+    strm = &uart_dma_tx[num];
+    idx = strm->cur;
+    if (strm->state[idx] == UART_DMA_BUF_FREE) {
+        strm->state[idx] = UART_DMA_BUF_FILLING;
+    }
+    return (strm->state[idx] == UART_DMA_BUF_FILLING) ? strm->cfg.Buf[idx] : NULL;
+}
+
+/*********************************************************************//**
+ * @brief        Hand the buffer obtained with UART_DMATxStreamGetBuffer()
+ *                 to the GPDMA. If the other buffer is being sent, this one
+ *                 is linked behind it and follows without an interrupt.
+ * @param[in]    UARTx    UART peripheral selected
+ * @param[in]    Len        Number of bytes written to the buffer
+ * @return         SUCCESS, or ERROR if no buffer was taken, Len is invalid
+ *                 or the buffer is not in RAM reachable by the GPDMA
+ **********************************************************************/
+Status UART_DMATxStreamCommit(LPC_UART_TypeDef *UARTx, uint32_t Len)
+{
+    int32_t num = uart_get_num(UARTx);
+    UART_DMA_T *strm;
+    LPC_GPDMACH_TypeDef *ch;
+    uint32_t idx, primask;
+
+    if ((num < 0) || (uart_dma_tx[num].enabled == DISABLE)) {
+        return ERROR;
+    }
+    strm = &uart_dma_tx[num];
+    idx = strm->cur;
+    if ((strm->state[idx] != UART_DMA_BUF_FILLING) || (Len == 0) \
+            || (Len > strm->cfg.BufSize)) {
+        return ERROR;
+    }
+    strm->len[idx] = Len;
+    if (uart_dma_tx_item(num, idx) == ERROR) {
+        return ERROR;
+    }
+
+    /* The DMA interrupt may restart the channel too: decide atomically */
+    primask = __get_PRIMASK();
+    __disable_irq();
+    strm->state[idx] = UART_DMA_BUF_QUEUED;
+    strm->cur = idx ^ 1;
+    if (strm->state[idx ^ 1] != UART_DMA_BUF_ACTIVE) {
+        uart_dma_tx_start(num, idx);
+    } else {
+        /* Link behind the buffer being sent. If the channel stopped before
+         * loading the link, its source did not reach the end of this buffer:
+         * the pending TC interrupt starts it instead. */
+        ch = UART_DMA_CH(strm->cfg.ChannelNum);
+        ch->DMACCLLI = (uint32_t)&strm->lli[idx];
+        if ((LPC_GPDMA->DMACEnbldChns & GPDMA_DMACEnbldChns_Ch(strm->cfg.ChannelNum)) \
+                || (ch->DMACCSrcAddr == ((uint32_t)strm->cfg.Buf[idx] + Len))) {
+            strm->state[idx] = UART_DMA_BUF_ACTIVE;
+        }
+    }
+    __set_PRIMASK(primask);
+
+    return SUCCESS;
+}
+
+/*********************************************************************//**
+ * @brief        Stop the Rx and Tx DMA streams of a UART. Data in flight
+ *                 is abandoned.
+ * @param[in]    UARTx    UART peripheral selected
+ * @return         None
+ **********************************************************************/
+void UART_DMAStreamStop(LPC_UART_TypeDef *UARTx)
+{
+    int32_t num = uart_get_num(UARTx);
+
+    if (num < 0) {
+        return;
+    }
+    uart_dma_release(&uart_dma_rx[num]);
+    uart_dma_release(&uart_dma_tx[num]);
+}
+
+/*********************************************************************//**
+ * @brief        DMA stream interrupt service. Call it from DMA_IRQHandler
+ *                 for every UART with a stream running on a fixed channel.
+ *                 Only the channels owned by this UART's streams are checked
+ *                 and cleared. GPDMA_CHANNEL_AUTO streams are serviced by
+ *                 GPDMA_IntHandler() instead.
+ * @param[in]    UARTx    UART peripheral selected, should be:
+ *               - LPC_UART0: UART0 peripheral
+ *                 - LPC_UART1: UART1 peripheral
+ *                 - LPC_UART2: UART2 peripheral
+ *                 - LPC_UART3: UART3 peripheral
+ * @return         None
+ **********************************************************************/
+void UART_DMAIntHandler(LPC_UART_TypeDef *UARTx)
+{
+    int32_t num = uart_get_num(UARTx);
+
+    if (num < 0) {
+        return;
+    }
+    if ((uart_dma_rx[num].enabled == ENABLE) && (uart_dma_rx[num].allocated == RESET)) {
+        uart_dma_rx_event(num, uart_dma_get_event(uart_dma_rx[num].cfg.ChannelNum));
+    }
+    if ((uart_dma_tx[num].enabled == ENABLE) && (uart_dma_tx[num].allocated == RESET)) {
+        uart_dma_tx_event(num, uart_dma_get_event(uart_dma_tx[num].cfg.ChannelNum));
+    }
+}
+#endif /* _GPDMA */
+
+
 /* UART1 FullModem function ---------------------------------------------*/
 
 #ifdef _UART1
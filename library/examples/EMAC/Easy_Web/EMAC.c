@@ -33,6 +33,9 @@ static unsigned short *tptr;
  * NXP: Here AHBRAM1 section still not be used, so a mount of this section
  * will be used to store buffer data get from receive packet buffer of EMAC
  */
+#ifndef LPC_AHBRAM1_BASE
+#define LPC_AHBRAM1_BASE	(0x20080000UL)	// AHB SRAM bank 1, not named in this LPC17xx.h
+#endif
 static unsigned short *pgBuf = (unsigned short *)LPC_AHBRAM1_BASE;
 
 // configure port-pins for use with LAN-controller,
@@ -102,9 +105,33 @@ void Init_EMAC(void)
 		_DBG_("Error during initializing EMAC, restart after a while");
 		for (delay = 0x100000; delay; delay--);
 	}
+	// Interrupt on every received frame, only to wake up WaitForFrame_EMAC()
+	EMAC_IntCmd(EMAC_INT_RX_DONE, ENABLE);
+	NVIC_SetPriority(ENET_IRQn, 0);
+	NVIC_EnableIRQ(ENET_IRQn);
 	_DBG_("Init EMAC complete");
 }
 
+// EMAC interrupt: a frame has been received. The frames are read by
+// DoNetworkStuff() in thread mode, here the interrupt is just cleared.
+void ENET_IRQHandler(void)
+{
+	EMAC_IntGetStatus(EMAC_INT_RX_DONE);
+}
+
+// sleeps until a frame is received or another interrupt (e.g. the
+// SysTick of the TCP-timers) occurs. Returns at once if a frame is
+// waiting already: with interrupts masked, a frame received after the
+// check still ends the WFI.
+void WaitForFrame_EMAC(void)
+{
+	__disable_irq();
+	if (EMAC_CheckReceiveIndex() == FALSE) {
+		__WFI();
+	}
+	__enable_irq();
+}
+
 
 // reads a word in little-endian byte order from RX_BUFFER
 
@@ -199,10 +226,21 @@ void RequestSend(unsigned short FrameSize)
 // check if ethernet controller is ready to accept the
 // frame we want to send
 
+// NOTE: frames are now sent as soon as they are built, so with several
+//       sockets the TX ring may be full: wait for the EMAC a while (a
+//       full-size frame takes 1.2ms at 10Mbps) before giving up
+
+#define RDY4TX_TIMEOUT  0x40000                  // loops to wait for a free TX descriptor
+
 unsigned int Rdy4Tx(void)
 {
-  return (1);   // the ethernet controller transmits much faster
-}               // than the CPU can load its buffers
+  unsigned int Timeout;
+
+  for (Timeout = RDY4TX_TIMEOUT; Timeout; Timeout--)
+    if (EMAC_CheckTransmitIndex() == TRUE)
+      return (1);
+  return (0);
+}
 
 
 // writes a word in little-endian byte order to TX_BUFFER
@@ -38,6 +38,8 @@ void           DummyReadFrame_EMAC(unsigned short Size);
 unsigned short StartReadFrame(void);
 void           EndReadFrame(void);
 unsigned int   CheckFrameReceived(void);
+void           WaitForFrame_EMAC(void);
+void           ENET_IRQHandler(void);
 void           RequestSend(unsigned short FrameSize);
 unsigned int   Rdy4Tx(void);
 
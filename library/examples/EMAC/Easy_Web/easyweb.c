@@ -15,13 +15,13 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include "adc.h"
+#include "ADC.h"
 #include "lpc17xx_libcfg.h"
 #include "EMAC.h"         // Keil: *.c -> *.h    // ethernet packet driver
 #define extern            // Keil: Line added for modular project management
 
-#include "easyweb.h"
 #include "tcpip.h"        // Keil: *.c -> *.h    // easyWEB TCP/IP stack
+#include "easyweb.h"                             // (needs MAX_TCP_SOCKETS)
 #include "webpage.h"                             // webside for our HTTP server (HTML)
 
 /* Example group ----------------------------------------------------------- */
@@ -33,18 +33,29 @@
 // NXP: Include some header files that differs from the origin
 int main(void)
 {
+  unsigned char Sock;
+
   TCPLowLevelInit();
-  HTTPStatus = 0;                                // clear HTTP-server's flag register
 
-  TCPLocalPort = TCP_PORT_HTTP;                  // set port we want to listen to
+  for (Sock = 0; Sock < MAX_TCP_SOCKETS; Sock++)
+  {
+    HTTPStatus[Sock] = 0;                        // clear HTTP-server's flag registers
+    TCPSocket[Sock].LocalPort = TCP_PORT_HTTP;   // set port we want to listen to
+  }                                              // (with every socket: a browser each)
 
   while (1)                                      // repeat forever
   {
-    if (!(SocketStatus & SOCK_ACTIVE)) TCPPassiveOpen();   // listen for incoming TCP-connection
+    for (Sock = 0; Sock < MAX_TCP_SOCKETS; Sock++)
+      if (!(TCPSocket[Sock].Status & SOCK_ACTIVE))
+        TCPPassiveOpen(Sock);                              // listen for incoming TCP-connection
+
     DoNetworkStuff();                                      // handle network and easyWEB-stack
                                                            // events
-    HTTPServer();
-  }
+    for (Sock = 0; Sock < MAX_TCP_SOCKETS; Sock++)
+      HTTPServer(Sock);
+
+    TCPWaitForEvent();                                     // sleep until a frame is received
+  }                                                        // or the TCP-timers tick
 }
 
 // This function implements a very simple dynamic HTTP-server.
@@ -54,57 +65,59 @@ int main(void)
 // NOTE: For strings crossing page boundaries, replacing will
 // not work. In this case, simply add some extra lines
 // (e.g. CR and LFs) to the HTML-code.
+// Every socket is served on its own, so several browsers may
+// load the page at the same time.
 
-void HTTPServer(void)
+void HTTPServer(unsigned char Sock)
 {
-  if (SocketStatus & SOCK_CONNECTED)             // check if somebody has connected to our TCP
+  if (TCPSocket[Sock].Status & SOCK_CONNECTED)   // check if somebody has connected to our TCP
   {
-    if (SocketStatus & SOCK_DATA_AVAILABLE)      // check if remote TCP sent data
-      TCPReleaseRxBuffer();                      // and throw it away
+    if (TCPSocket[Sock].Status & SOCK_DATA_AVAILABLE)   // check if remote TCP sent data
+      TCPReleaseRxBuffer(Sock);                         // and throw it away
 
-    if (SocketStatus & SOCK_TX_BUF_RELEASED)     // check if buffer is free for TX
+    if (TCPSocket[Sock].Status & SOCK_TX_BUF_RELEASED)  // check if buffer is free for TX
     {
-      if (!(HTTPStatus & HTTP_SEND_PAGE))        // init byte-counter and pointer to webside
+      if (!(HTTPStatus[Sock] & HTTP_SEND_PAGE))  // init byte-counter and pointer to webside
       {                                          // if called the 1st time
-        HTTPBytesToSend = sizeof(WebSide) - 1;   // get HTML length, ignore trailing zero
-        PWebSide = (unsigned char *)WebSide;     // pointer to HTML-code
+        HTTPBytesToSend[Sock] = sizeof(WebSide) - 1;   // get HTML length, ignore trailing zero
+        PWebSide[Sock] = (unsigned char *)WebSide;     // pointer to HTML-code
       }
 
-      if (HTTPBytesToSend > MAX_TCP_TX_DATA_SIZE)     // transmit a segment of MAX_SIZE
+      if (HTTPBytesToSend[Sock] > MAX_TCP_TX_DATA_SIZE)   // transmit a segment of MAX_SIZE
       {
-        if (!(HTTPStatus & HTTP_SEND_PAGE))           // 1st time, include HTTP-header
+        if (!(HTTPStatus[Sock] & HTTP_SEND_PAGE))         // 1st time, include HTTP-header
         {
-          memcpy(TCP_TX_BUF, GetResponse, sizeof(GetResponse) - 1);
-          memcpy(TCP_TX_BUF + sizeof(GetResponse) - 1, PWebSide, MAX_TCP_TX_DATA_SIZE - sizeof(GetResponse) + 1);
-          HTTPBytesToSend -= MAX_TCP_TX_DATA_SIZE - sizeof(GetResponse) + 1;
-          PWebSide += MAX_TCP_TX_DATA_SIZE - sizeof(GetResponse) + 1;
+          memcpy(TCP_TX_BUF(Sock), GetResponse, sizeof(GetResponse) - 1);
+          memcpy(TCP_TX_BUF(Sock) + sizeof(GetResponse) - 1, PWebSide[Sock], MAX_TCP_TX_DATA_SIZE - sizeof(GetResponse) + 1);
+          HTTPBytesToSend[Sock] -= MAX_TCP_TX_DATA_SIZE - sizeof(GetResponse) + 1;
+          PWebSide[Sock] += MAX_TCP_TX_DATA_SIZE - sizeof(GetResponse) + 1;
         }
         else
         {
-          memcpy(TCP_TX_BUF, PWebSide, MAX_TCP_TX_DATA_SIZE);
-          HTTPBytesToSend -= MAX_TCP_TX_DATA_SIZE;
-          PWebSide += MAX_TCP_TX_DATA_SIZE;
+          memcpy(TCP_TX_BUF(Sock), PWebSide[Sock], MAX_TCP_TX_DATA_SIZE);
+          HTTPBytesToSend[Sock] -= MAX_TCP_TX_DATA_SIZE;
+          PWebSide[Sock] += MAX_TCP_TX_DATA_SIZE;
         }
 
-        TCPTxDataCount = MAX_TCP_TX_DATA_SIZE;   // bytes to xfer
-        InsertDynamicValues();                   // exchange some strings...
-        TCPTransmitTxBuffer();                   // xfer buffer
+        TCPSocket[Sock].TxDataCount = MAX_TCP_TX_DATA_SIZE;   // bytes to xfer
+        InsertDynamicValues(Sock);                            // exchange some strings...
+        TCPTransmitTxBuffer(Sock);                            // xfer buffer
       }
-      else if (HTTPBytesToSend)                  // transmit leftover bytes
+      else if (HTTPBytesToSend[Sock])                         // transmit leftover bytes
       {
-        memcpy(TCP_TX_BUF, PWebSide, HTTPBytesToSend);
-        TCPTxDataCount = HTTPBytesToSend;        // bytes to xfer
-        InsertDynamicValues();                   // exchange some strings...
-        TCPTransmitTxBuffer();                   // send last segment
-        TCPClose();                              // and close connection
-        HTTPBytesToSend = 0;                     // all data sent
+        memcpy(TCP_TX_BUF(Sock), PWebSide[Sock], HTTPBytesToSend[Sock]);
+        TCPSocket[Sock].TxDataCount = HTTPBytesToSend[Sock];  // bytes to xfer
+        InsertDynamicValues(Sock);                            // exchange some strings...
+        TCPTransmitTxBuffer(Sock);                            // send last segment
+        TCPClose(Sock);                                       // and close connection
+        HTTPBytesToSend[Sock] = 0;                            // all data sent
       }
 
-      HTTPStatus |= HTTP_SEND_PAGE;              // ok, 1st loop executed
+      HTTPStatus[Sock] |= HTTP_SEND_PAGE;        // ok, 1st loop executed
     }
   }
   else
-    HTTPStatus &= ~HTTP_SEND_PAGE;               // reset help-flag if not connected
+    HTTPStatus[Sock] &= ~HTTP_SEND_PAGE;         // reset help-flag if not connected
 }
 
 // samples and returns the AD-converter value of channel 2 (MCB1700 board) or channel 5 (IAR board)
@@ -130,17 +143,17 @@ unsigned int GetTempVal(void)
 // searches the TX-buffer for special strings and replaces them
 // with dynamic values (AD-converter results)
 
-void InsertDynamicValues(void)
+void InsertDynamicValues(unsigned char Sock)
 {
   unsigned char *Key;
            char NewKey[5];
   unsigned int i;
 
-  if (TCPTxDataCount < 4) return;                     // there can't be any special string
+  if (TCPSocket[Sock].TxDataCount < 4) return;        // there can't be any special string
 
-  Key = TCP_TX_BUF;
+  Key = TCP_TX_BUF(Sock);
 
-  for (i = 0; i < (TCPTxDataCount - 3); i++)
+  for (i = 0; i < (TCPSocket[Sock].TxDataCount - 3); i++)
   {
     if (*Key == 'A')
      if (*(Key + 1) == 'D')
@@ -23,15 +23,16 @@ const unsigned char GetResponse[] =              // 1st thing our server sends t
 
 void InitOsc(void);                              // prototypes
 void InitPorts(void);
-void HTTPServer(void);
-void InsertDynamicValues(void);
+void HTTPServer(unsigned char Sock);
+void InsertDynamicValues(unsigned char Sock);
 unsigned int GetAD7Val(void);
 unsigned int GetTempVal(void);
 
-unsigned char *PWebSide;                         // pointer to webside
-unsigned int HTTPBytesToSend;                    // bytes left to send
+// HTTP-server's state of every socket
+unsigned char *PWebSide[MAX_TCP_SOCKETS];        // pointer to webside
+unsigned int HTTPBytesToSend[MAX_TCP_SOCKETS];   // bytes left to send
 
-unsigned char HTTPStatus;                        // status byte
+unsigned char HTTPStatus[MAX_TCP_SOCKETS];       // status byte
 #define HTTP_SEND_PAGE               0x01        // help flag
 
 #endif
@@ -20,7 +20,7 @@
 #include "lpc17xx_libcfg.h"
 #include "lpc17xx_pinsel.h"
 //#include "lpc17xx_emac.h"
-#include "adc.h"
+#include "ADC.h"
 
 /* For debugging... */
 #include "debug_frmwrk.h"
@@ -99,6 +99,8 @@ void LED_Init (void)
 
 void TCPLowLevelInit(void)
 {
+	unsigned char i;
+
 	// ADC initializing
 	ADC_init();
 
@@ -116,10 +118,13 @@ void TCPLowLevelInit(void)
 	_DBG_("Hello NXP EMAC");
 
 	Init_EMAC();
-	TransmitControl = 0;
-	TCPFlags = 0;
-	TCPStateMachine = CLOSED;
-	SocketStatus = 0;
+	for (i = 0; i < MAX_TCP_SOCKETS; i++)
+	{
+		memset(&TCPSocket[i], 0, sizeof(TTCPSocket));	// no flags, no status
+		TCPSocket[i].StateMachine = CLOSED;
+		TCPSocket[i].TxFrame = TxFrame1(i);
+		TCPSocket[i].RxBuffer = RxTCPBuffer(i);
+	}
 
 	// NXP: Initialize System tick timer
 	// Generate interrupt each SYSTICK_PERIOD microsecond
@@ -133,58 +138,69 @@ void TCPLowLevelInit(void)
 }
 
 // easyWEB-API function
-// does a passive open (listen on 'MyIP:TCPLocalPort' for an incoming
-// connection)
+// does a passive open (listen on 'MyIP:TCPSocket[SockNr].LocalPort' for an
+// incoming connection)
+// NOTE: several sockets may listen to the same port, each one takes
+//       one connection
 
-void TCPPassiveOpen(void)
+void TCPPassiveOpen(unsigned char SockNr)
 {
-  if (TCPStateMachine == CLOSED)
+  TTCPSocket *Sock = &TCPSocket[SockNr];
+
+  if (Sock->StateMachine == CLOSED)
   {
-    TCPFlags &= ~TCP_ACTIVE_OPEN;                // let's do a passive open!
-    TCPStateMachine = LISTENING;
-    SocketStatus = SOCK_ACTIVE;                  // reset, socket now active
+    Sock->Flags &= ~TCP_ACTIVE_OPEN;             // let's do a passive open!
+    Sock->StateMachine = LISTENING;
+    Sock->Status = SOCK_ACTIVE;                  // reset, socket now active
   }
 }
 
 // easyWEB-API function
 // does an active open (tries to establish a connection between
-// 'MyIP:TCPLocalPort' and 'RemoteIP:TCPRemotePort')
+// 'MyIP:TCPSocket[SockNr].LocalPort' and 'RemoteIP:RemotePort' of the socket)
 
-void TCPActiveOpen(void)
+void TCPActiveOpen(unsigned char SockNr)
 {
-  if ((TCPStateMachine == CLOSED) || (TCPStateMachine == LISTENING))
+  TTCPSocket *Sock = &TCPSocket[SockNr];
+
+  if ((Sock->StateMachine == CLOSED) || (Sock->StateMachine == LISTENING))
   {
-    TCPFlags |= TCP_ACTIVE_OPEN;                 // let's do an active open!
-    TCPFlags &= ~IP_ADDR_RESOLVED;               // we haven't opponents MAC yet
+    Sock->Flags |= TCP_ACTIVE_OPEN;              // let's do an active open!
+    Sock->Flags &= ~(IP_ADDR_RESOLVED | CHECKSUMS_VALID); // we haven't opponents MAC yet
 
-    PrepareARP_REQUEST();                        // ask for MAC by sending a broadcast
-    LastFrameSent = ARP_REQUEST;
-    TCPStartRetryTimer();
-    SocketStatus = SOCK_ACTIVE;                  // reset, socket now active
+    PrepareARP_REQUEST(Sock);                    // ask for MAC by sending a broadcast
+    Sock->LastFrameSent = ARP_REQUEST;
+    TCPStartRetryTimer(Sock);
+    Sock->Status = SOCK_ACTIVE;                  // reset, socket now active
   }
 }
 
 // easyWEB-API function
 // closes an open connection
 
-void TCPClose(void)
+void TCPClose(unsigned char SockNr)
 {
-  switch (TCPStateMachine)
+  TTCPSocket *Sock = &TCPSocket[SockNr];
+
+  switch (Sock->StateMachine)
   {
     case LISTENING :
     case SYN_SENT :
     {
-      TCPStateMachine = CLOSED;
-      TCPFlags = 0;
-      SocketStatus = 0;
+      Sock->StateMachine = CLOSED;
+      Sock->Flags = 0;
+      Sock->Status = 0;
       break;
     }
     case SYN_RECD :
     case ESTABLISHED :
     {
-      TCPFlags |= TCP_CLOSE_REQUESTED;
+      Sock->Flags |= TCP_CLOSE_REQUESTED;
+      TCPHandleStateMachine(Sock);               // send FIN now if all data is ACKed
       break;
     }
+    default :
+      break;
   }
 }
 
@@ -193,29 +209,34 @@ void TCPClose(void)
 // NOTE: rx-buffer MUST be released periodically, else the other TCP
 //       get no ACKs for the data it sent
 
-void TCPReleaseRxBuffer(void)
+void TCPReleaseRxBuffer(unsigned char SockNr)
 {
-  SocketStatus &= ~SOCK_DATA_AVAILABLE;
+  TCPSocket[SockNr].Status &= ~SOCK_DATA_AVAILABLE;
 }
 
 // easyWEB-API function
-// transmitts data stored in 'TCP_TX_BUF'
-// NOTE: * number of bytes to transmit must have been written to 'TCPTxDataCount'
+// transmitts data stored in 'TCP_TX_BUF(SockNr)'
+// NOTE: * number of bytes to transmit must have been written to
+//         'TCPSocket[SockNr].TxDataCount'
 //       * data-count MUST NOT exceed 'MAX_TCP_TX_DATA_SIZE'
 
-void TCPTransmitTxBuffer(void)
+void TCPTransmitTxBuffer(unsigned char SockNr)
 {
-  if ((TCPStateMachine == ESTABLISHED) || (TCPStateMachine == CLOSE_WAIT))
-    if (SocketStatus & SOCK_TX_BUF_RELEASED)
+  TTCPSocket *Sock = &TCPSocket[SockNr];
+
+  if ((Sock->StateMachine == ESTABLISHED) || (Sock->StateMachine == CLOSE_WAIT))
+    if (Sock->Status & SOCK_TX_BUF_RELEASED)
     {
-      SocketStatus &= ~SOCK_TX_BUF_RELEASED;               // occupy tx-buffer
-      TCPUNASeqNr += TCPTxDataCount;                       // advance UNA
+      Sock->Status &= ~SOCK_TX_BUF_RELEASED;               // occupy tx-buffer
+      Sock->UNASeqNr += Sock->TxDataCount;                 // advance UNA
 
-      TxFrame1Size = ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + TCPTxDataCount;
-      TransmitControl |= SEND_FRAME1;
+      // sum the data once, retransmissions of the frame reuse it
+      Sock->TxDataSum = (unsigned short)~CalcChecksum(TCP_TX_BUF(SockNr), Sock->TxDataCount, NULL);
+      PrepareTCP_DATA_FRAME(Sock);                         // build frame w/ actual SEQ, ACK....
+      SendFrame1(Sock);
 
-      LastFrameSent = TCP_DATA_FRAME;
-      TCPStartRetryTimer();
+      Sock->LastFrameSent = TCP_DATA_FRAME;
+      TCPStartRetryTimer(Sock);
     }
 }
 
@@ -242,10 +263,14 @@ unsigned int IsBroadcast(void) {
 // easyWEB's 'main()'-function
 // must be called from user program periodically (the often - the better)
 // handles network, TCP/IP-stack and user events
+// all frames received since the last call are processed, then the timers
+// and pending state changes of every socket
 
 void DoNetworkStuff(void)
 {
-  if (CheckFrameReceived())                      // Packet received
+  unsigned char i;
+
+  while (CheckFrameReceived())                   // Packets received
   {
     if (IsBroadcast()) {
       ProcessEthBroadcastFrame();
@@ -255,114 +280,115 @@ void DoNetworkStuff(void)
     EndReadFrame();                              // release buffer in ethernet controller
   }
 
-  if (TCPFlags & TCP_TIMER_RUNNING)
-    if (TCPFlags & TIMER_TYPE_RETRY)
+  for (i = 0; i < MAX_TCP_SOCKETS; i++)
+  {
+    TCPHandleTimer(&TCPSocket[i]);
+    TCPHandleStateMachine(&TCPSocket[i]);
+  }
+}
+
+// easyWEB-API function
+// sleeps until there is something for 'DoNetworkStuff()' to do: a frame
+// received by the EMAC or the next tick of the TCP-timers
+// (call it when the sockets have been served)
+
+void TCPWaitForEvent(void)
+{
+  WaitForFrame_EMAC();
+}
+
+// easyWEB internal function
+// handles the timer of a socket: retransmissions and the end of TIME_WAIT
+
+void TCPHandleTimer(TTCPSocket *Sock)
+{
+  unsigned char Elapsed;
+
+  if (Sock->Flags & TCP_TIMER_RUNNING)
+  {
+    Elapsed = TCPTicks - Sock->TimerStart;       // ticks since the timer was (re)started
+
+    if (Sock->Flags & TIMER_TYPE_RETRY)
     {
-      if (TCPTimer > RETRY_TIMEOUT)
+      if (Elapsed > RETRY_TIMEOUT)
       {
-        TCPRestartTimer();                       // set a new timeout
+        TCPRestartTimer(Sock);                   // set a new timeout
 
-        if (RetryCounter)
+        if (Sock->RetryCounter)
         {
-          TCPHandleRetransmission();             // resend last frame
-          RetryCounter--;
+          TCPHandleRetransmission(Sock);         // resend last frame
+          Sock->RetryCounter--;
         }
         else
         {
-          TCPStopTimer();
-          TCPHandleTimeout();
+          TCPStopTimer(Sock);
+          TCPHandleTimeout(Sock);
         }
       }
     }
-    else if (TCPTimer > FIN_TIMEOUT)
+    else if (Elapsed > FIN_TIMEOUT)
     {
-      TCPStateMachine = CLOSED;
-      TCPFlags = 0;                              // reset all flags, stop retransmission...
-      SocketStatus &= SOCK_DATA_AVAILABLE;       // clear all flags but data available
+      Sock->StateMachine = CLOSED;
+      Sock->Flags = 0;                           // reset all flags, stop retransmission...
+      Sock->Status &= SOCK_DATA_AVAILABLE;       // clear all flags but data available
     }
+  }
+}
 
-  switch (TCPStateMachine)
+// easyWEB internal function
+// sends the frames a socket has been waiting for: the SYN of an active
+// open once the MAC is known, the FIN once all data is ACKed
+
+void TCPHandleStateMachine(TTCPSocket *Sock)
+{
+  switch (Sock->StateMachine)
   {
     case CLOSED :
     case LISTENING :
     {
-      if (TCPFlags & TCP_ACTIVE_OPEN)            // stack has to open a connection?
-        if (TCPFlags & IP_ADDR_RESOLVED)         // IP resolved?
-          if (!(TransmitControl & SEND_FRAME2))  // buffer free?
-          {
-            TCPSeqNr = ((unsigned long)ISNGenHigh << 16) | (SysTick->VAL & 0xFFFF);  // NXP: changed from T0TC to SysTick->VAL;
-                                                                // set local ISN
-            TCPUNASeqNr = TCPSeqNr;
-            TCPAckNr = 0;                                       // we don't know what to ACK!
-            TCPUNASeqNr++;                                      // count SYN as a byte
-            PrepareTCP_FRAME(TCP_CODE_SYN);                     // send SYN frame
-            LastFrameSent = TCP_SYN_FRAME;
-            TCPStartRetryTimer();                               // we NEED a retry-timeout
-            TCPStateMachine = SYN_SENT;
-          }
+      if (Sock->Flags & TCP_ACTIVE_OPEN)         // stack has to open a connection?
+        if (Sock->Flags & IP_ADDR_RESOLVED)      // IP resolved?
+        {
+          Sock->SeqNr = ((unsigned long)ISNGenHigh << 16) | (SysTick->VAL & 0xFFFF);  // NXP: changed from T0TC to SysTick->VAL;
+                                                              // set local ISN
+          Sock->UNASeqNr = Sock->SeqNr;
+          Sock->AckNr = 0;                                    // we don't know what to ACK!
+          Sock->UNASeqNr++;                                   // count SYN as a byte
+          PrepareTCP_FRAME(Sock, TCP_CODE_SYN);               // send SYN frame
+          Sock->LastFrameSent = TCP_SYN_FRAME;
+          TCPStartRetryTimer(Sock);                           // we NEED a retry-timeout
+          Sock->StateMachine = SYN_SENT;
+        }
       break;
     }
     case SYN_RECD :
     case ESTABLISHED :
     {
-      if (TCPFlags & TCP_CLOSE_REQUESTED)                  // user has user initated a close?
-        if (!(TransmitControl & (SEND_FRAME2 | SEND_FRAME1)))   // buffers free?
-          if (TCPSeqNr == TCPUNASeqNr)                          // all data ACKed?
-          {
-            TCPUNASeqNr++;
-            PrepareTCP_FRAME(TCP_CODE_FIN | TCP_CODE_ACK);
-            LastFrameSent = TCP_FIN_FRAME;
-            TCPStartRetryTimer();
-            TCPStateMachine = FIN_WAIT_1;
-          }
+      if (Sock->Flags & TCP_CLOSE_REQUESTED)                // user has user initated a close?
+        if (Sock->SeqNr == Sock->UNASeqNr)                  // all data ACKed?
+        {
+          Sock->UNASeqNr++;
+          PrepareTCP_FRAME(Sock, TCP_CODE_FIN | TCP_CODE_ACK);
+          Sock->LastFrameSent = TCP_FIN_FRAME;
+          TCPStartRetryTimer(Sock);
+          Sock->StateMachine = FIN_WAIT_1;
+        }
       break;
     }
     case CLOSE_WAIT :
     {
-      if (!(TransmitControl & (SEND_FRAME2 | SEND_FRAME1)))     // buffers free?
-        if (TCPSeqNr == TCPUNASeqNr)                            // all data ACKed?
-        {
-          TCPUNASeqNr++;                                        // count FIN as a byte
-          PrepareTCP_FRAME(TCP_CODE_FIN | TCP_CODE_ACK);        // we NEED a retry-timeout
-          LastFrameSent = TCP_FIN_FRAME;                        // time to say goodbye...
-          TCPStartRetryTimer();
-          TCPStateMachine = LAST_ACK;
-        }
+      if (Sock->SeqNr == Sock->UNASeqNr)                    // all data ACKed?
+      {
+        Sock->UNASeqNr++;                                   // count FIN as a byte
+        PrepareTCP_FRAME(Sock, TCP_CODE_FIN | TCP_CODE_ACK);// we NEED a retry-timeout
+        Sock->LastFrameSent = TCP_FIN_FRAME;                // time to say goodbye...
+        TCPStartRetryTimer(Sock);
+        Sock->StateMachine = LAST_ACK;
+      }
       break;
     }
-  }
-
-  if (TransmitControl & SEND_FRAME2)
-  {
-    RequestSend(TxFrame2Size);
-
-    if (Rdy4Tx()) {                               // NOTE: when using a very fast MCU, maybe
-    	_DBG_("Send Frm2");
-    	SendFrame2();                              // the EMAC isn't ready yet, include
-    } else {                                       // a kind of timer or counter here
-      TCPStateMachine = CLOSED;
-      SocketStatus = SOCK_ERR_ETHERNET;          // indicate an error to user
-      TCPFlags = 0;                              // clear all flags, stop timers etc.
-    }
-
-    TransmitControl &= ~SEND_FRAME2;             // clear tx-flag
-  }
-
-  if (TransmitControl & SEND_FRAME1)
-  {
-    PrepareTCP_DATA_FRAME();                     // build frame w/ actual SEQ, ACK....
-    RequestSend(TxFrame1Size);
-
-    if (Rdy4Tx()){                                // EMAC ready to accept our frame?
-    	_DBG_("Send Frm1");
-    	SendFrame1();                              // (see note above)
-    } else {
-      TCPStateMachine = CLOSED;
-      SocketStatus = SOCK_ERR_ETHERNET;          // indicate an error to user
-      TCPFlags = 0;                              // clear all flags, stop timers etc.
-    }
-
-    TransmitControl &= ~SEND_FRAME1;             // clear tx-flag
+    default :
+      break;
   }
 }
 
@@ -384,7 +410,7 @@ void ProcessEthBroadcastFrame(void)
             DummyReadFrame_EMAC(6);              // ignore target's hardware address
             CopyFromFrame_EMAC(&TargetIP, 4);    // read target's protocol address
             if (!memcmp(&MyIP, &TargetIP, 4))    // is it for us?
-              PrepareARP_ANSWER();               // yes->create ARP_ANSWER frame
+              PrepareARP_ANSWER();               // yes->send ARP_ANSWER frame
           }
 }
 
@@ -395,22 +421,41 @@ void ProcessEthBroadcastFrame(void)
 void ProcessEthIAFrame(void)
 {
   unsigned short TargetIP[2];
+  unsigned short SenderMAC[3];
   unsigned char ProtocolType;
+  unsigned char i;
+  TTCPSocket *Sock;
 
   switch (ReadFrameBE_EMAC())                     // get frame type
   {
     case FRAME_ARP :                             // check for ARP
     {
-      if ((TCPFlags & (TCP_ACTIVE_OPEN | IP_ADDR_RESOLVED)) == TCP_ACTIVE_OPEN)
-        if (ReadFrameBE_EMAC() == HARDW_ETH10)         // check for the right prot. etc.
-          if (ReadFrameBE_EMAC() == FRAME_IP)
-            if (ReadFrameBE_EMAC() == IP_HLEN_PLEN)
-              if (ReadFrameBE_EMAC() == OP_ARP_ANSWER)
+      if (ReadFrameBE_EMAC() == HARDW_ETH10)           // check for the right prot. etc.
+        if (ReadFrameBE_EMAC() == FRAME_IP)
+          if (ReadFrameBE_EMAC() == IP_HLEN_PLEN)
+            if (ReadFrameBE_EMAC() == OP_ARP_ANSWER)
+            {
+              CopyFromFrame_EMAC(&SenderMAC, 6);       // extract opponents MAC
+              CopyFromFrame_EMAC(&RecdFrameIP, 4);     // and the IP it belongs to
+
+              for (i = 0; i < MAX_TCP_SOCKETS; i++)    // every socket waiting for it
               {
-                TCPStopTimer();                       // OK, now we've the MAC we wanted ;-)
-                CopyFromFrame_EMAC(&RemoteMAC, 6);    // extract opponents MAC
-                TCPFlags |= IP_ADDR_RESOLVED;
+                Sock = &TCPSocket[i];
+                if ((Sock->Flags & (TCP_ACTIVE_OPEN | IP_ADDR_RESOLVED)) == TCP_ACTIVE_OPEN)
+                {
+                  if (((Sock->RemoteIP[0] ^ MyIP[0]) & SubnetMask[0]) || ((Sock->RemoteIP[1] ^ MyIP[1]) & SubnetMask[1]))
+                  {
+                    if (memcmp(&GatewayIP, &RecdFrameIP, 4)) continue;     // asked the gateway
+                  }
+                  else if (memcmp(&Sock->RemoteIP, &RecdFrameIP, 4)) continue;
+
+                  TCPStopTimer(Sock);                  // OK, now we've the MAC we wanted ;-)
+                  memcpy(&Sock->RemoteMAC, &SenderMAC, 6);
+                  Sock->Flags |= IP_ADDR_RESOLVED;
+                  TCPHandleStateMachine(Sock);         // send SYN
+                }
               }
+            }
       break;
     }
     case FRAME_IP :                                        // check for IP-type
@@ -460,12 +505,48 @@ void ProcessICMPFrame(void)
   }
 }
 
+// easyWEB internal function
+// returns the socket a just rec'd TCP-segment belongs to: the one whose
+// session has the segment's IP and ports or, if none, the first one
+// listening to its destination port. NULL if there is none of them
+
+TTCPSocket *TCPFindSocket(unsigned short SourcePort, unsigned short DestPort)
+{
+  TTCPSocket *Sock;
+  TTCPSocket *Listener = NULL;
+
+  for (Sock = TCPSocket; Sock < &TCPSocket[MAX_TCP_SOCKETS]; Sock++)
+  {
+    if (Sock->LocalPort != DestPort) continue;
+
+    switch (Sock->StateMachine)
+    {
+      case CLOSED :
+        break;
+      case LISTENING :
+      {
+        if (!Listener) Listener = Sock;
+        break;
+      }
+      default :
+      {
+        if ((Sock->RemotePort == SourcePort) && !memcmp(&Sock->RemoteIP, &RecdFrameIP, 4))
+          return (Sock);                         // segment of this session
+      }
+    }
+  }
+  return (Listener);
+}
+
 // easyWEB internal function
 // we've just rec'd an TCP-frame (Transmission Control Protocol)
 // this function mainly implements the TCP state machine according to RFC793
+// for the socket it belongs to
 
 void ProcessTCPFrame(void)
 {
+  static TTCPSocket NoSocket;                    // to answer segments of no socket with a RST
+  TTCPSocket *Sock;
   unsigned short TCPSegSourcePort;               // segment's source port
   unsigned short TCPSegDestPort;                 // segment's destination port
   unsigned long TCPSegSeq;                       // segment's sequence number
@@ -473,12 +554,11 @@ void ProcessTCPFrame(void)
   unsigned short TCPCode;                        // TCP code and header length
   unsigned char TCPHeaderSize;                   // real TCP header length
   unsigned short NrOfDataBytes;                  // real number of data
+  unsigned char i;
 
   TCPSegSourcePort = ReadFrameBE_EMAC();                    // get ports
   TCPSegDestPort = ReadFrameBE_EMAC();
 
-  if (TCPSegDestPort != TCPLocalPort) return;              // drop segment if port doesn't match
-
   TCPSegSeq = (unsigned long)ReadFrameBE_EMAC() << 16;      // get segment sequence nr.
   TCPSegSeq |= ReadFrameBE_EMAC();
 
@@ -495,27 +575,42 @@ void ProcessTCPFrame(void)
   if (TCPHeaderSize > TCP_HEADER_SIZE)                     // ignore options if any
     DummyReadFrame_EMAC(TCPHeaderSize - TCP_HEADER_SIZE);
 
-  switch (TCPStateMachine)                                 // implement the TCP state machine
+  Sock = TCPFindSocket(TCPSegSourcePort, TCPSegDestPort);
+  if (!Sock)
+  {
+    if (TCPCode & TCP_CODE_SYN)                            // all sockets of the port busy?
+      for (i = 0; i < MAX_TCP_SOCKETS; i++)                // drop the SYN, the other TCP
+        if ((TCPSocket[i].LocalPort == TCPSegDestPort) &&  // will retry later
+            (TCPSocket[i].Status & SOCK_ACTIVE))
+          return;
+
+    Sock = &NoSocket;                                      // nobody there, reset it
+    Sock->StateMachine = CLOSED;
+    Sock->LocalPort = TCPSegDestPort;
+  }
+
+  switch (Sock->StateMachine)                              // implement the TCP state machine
   {
     case CLOSED :
     {
       if (!(TCPCode & TCP_CODE_RST))
       {
-        TCPRemotePort = TCPSegSourcePort;
-        memcpy(&RemoteMAC, &RecdFrameMAC, 6);              // save opponents MAC and IP
-        memcpy(&RemoteIP, &RecdFrameIP, 4);                // for later use
+        Sock->RemotePort = TCPSegSourcePort;
+        memcpy(&Sock->RemoteMAC, &RecdFrameMAC, 6);        // save opponents MAC and IP
+        memcpy(&Sock->RemoteIP, &RecdFrameIP, 4);          // for later use
+        Sock->Flags &= ~CHECKSUMS_VALID;                   // they were of another one
 
         if (TCPCode & TCP_CODE_ACK)                        // make the reset sequence
         {                                                  // acceptable to the other
-          TCPSeqNr = TCPSegAck;                            // TCP
-          PrepareTCP_FRAME(TCP_CODE_RST);
+          Sock->SeqNr = TCPSegAck;                         // TCP
+          PrepareTCP_FRAME(Sock, TCP_CODE_RST);
         }
         else
         {
-          TCPSeqNr = 0;
-          TCPAckNr = TCPSegSeq + NrOfDataBytes;
-          if (TCPCode & (TCP_CODE_SYN | TCP_CODE_FIN)) TCPAckNr++;
-          PrepareTCP_FRAME(TCP_CODE_RST | TCP_CODE_ACK);
+          Sock->SeqNr = 0;
+          Sock->AckNr = TCPSegSeq + NrOfDataBytes;
+          if (TCPCode & (TCP_CODE_SYN | TCP_CODE_FIN)) Sock->AckNr++;
+          PrepareTCP_FRAME(Sock, TCP_CODE_RST | TCP_CODE_ACK);
         }
       }
       break;
@@ -524,43 +619,39 @@ void ProcessTCPFrame(void)
     {
       if (!(TCPCode & TCP_CODE_RST))                       // ignore segment containing RST
       {
-        TCPRemotePort = TCPSegSourcePort;
-        memcpy(&RemoteMAC, &RecdFrameMAC, 6);              // save opponents MAC and IP
-        memcpy(&RemoteIP, &RecdFrameIP, 4);                // for later use
+        Sock->RemotePort = TCPSegSourcePort;
+        memcpy(&Sock->RemoteMAC, &RecdFrameMAC, 6);        // save opponents MAC and IP
+        memcpy(&Sock->RemoteIP, &RecdFrameIP, 4);          // for later use
+        Sock->Flags &= ~CHECKSUMS_VALID;                   // they were of another one
 
         if (TCPCode & TCP_CODE_ACK)                        // reset a bad
         {                                                  // acknowledgement
-          TCPSeqNr = TCPSegAck;
-          PrepareTCP_FRAME(TCP_CODE_RST);
+          Sock->SeqNr = TCPSegAck;
+          PrepareTCP_FRAME(Sock, TCP_CODE_RST);
         }
         else if (TCPCode & TCP_CODE_SYN)
         {
-          TCPAckNr = TCPSegSeq + 1;                           // get remote ISN, next byte we expect
-            TCPSeqNr = ((unsigned long)ISNGenHigh << 16) | (SysTick->VAL & 0xFFFF);  // Keil: changed from TAR to T0TC;
+          Sock->AckNr = TCPSegSeq + 1;                        // get remote ISN, next byte we expect
+          Sock->SeqNr = ((unsigned long)ISNGenHigh << 16) | (SysTick->VAL & 0xFFFF);  // Keil: changed from TAR to T0TC;
                                                               // set local ISN
-          TCPUNASeqNr = TCPSeqNr + 1;                         // one byte out -> increase by one
-          PrepareTCP_FRAME(TCP_CODE_SYN | TCP_CODE_ACK);
-          LastFrameSent = TCP_SYN_ACK_FRAME;
-          TCPStartRetryTimer();
-          TCPStateMachine = SYN_RECD;
+          Sock->UNASeqNr = Sock->SeqNr + 1;                   // one byte out -> increase by one
+          PrepareTCP_FRAME(Sock, TCP_CODE_SYN | TCP_CODE_ACK);
+          Sock->LastFrameSent = TCP_SYN_ACK_FRAME;
+          TCPStartRetryTimer(Sock);
+          Sock->StateMachine = SYN_RECD;
         }
       }
       break;
     }
     case SYN_SENT :
     {
-      if (memcmp(&RemoteIP, &RecdFrameIP, 4)) break;  // drop segment if its IP doesn't belong
-                                                      // to current session
-
-      if (TCPSegSourcePort != TCPRemotePort) break;   // drop segment if port doesn't match
-
       if (TCPCode & TCP_CODE_ACK)                // ACK field significant?
-        if (TCPSegAck != TCPUNASeqNr)            // is our ISN ACKed?
+        if (TCPSegAck != Sock->UNASeqNr)         // is our ISN ACKed?
         {
           if (!(TCPCode & TCP_CODE_RST))
           {
-            TCPSeqNr = TCPSegAck;
-            PrepareTCP_FRAME(TCP_CODE_RST);
+            Sock->SeqNr = TCPSegAck;
+            PrepareTCP_FRAME(Sock, TCP_CODE_RST);
           }
           break;                                 // drop segment
         }
@@ -569,153 +660,153 @@ void ProcessTCPFrame(void)
       {
         if (TCPCode & TCP_CODE_ACK)              // if ACK was acceptable, reset
         {                                        // connection
-          TCPStateMachine = CLOSED;
-          TCPFlags = 0;                          // reset all flags, stop retransmission...
-          SocketStatus = SOCK_ERR_CONN_RESET;
+          Sock->StateMachine = CLOSED;
+          Sock->Flags = 0;                       // reset all flags, stop retransmission...
+          Sock->Status = SOCK_ERR_CONN_RESET;
         }
         break;                                   // drop segment
       }
 
       if (TCPCode & TCP_CODE_SYN)                // SYN??
       {
-        TCPAckNr = TCPSegSeq;                    // get opponents ISN
-        TCPAckNr++;                              // inc. by one...
+        Sock->AckNr = TCPSegSeq;                 // get opponents ISN
+        Sock->AckNr++;                           // inc. by one...
 
         if (TCPCode & TCP_CODE_ACK)
         {
-          TCPStopTimer();                        // stop retransmission, other TCP got our SYN
-          TCPSeqNr = TCPUNASeqNr;                // advance our sequence number
+          TCPStopTimer(Sock);                    // stop retransmission, other TCP got our SYN
+          Sock->SeqNr = Sock->UNASeqNr;          // advance our sequence number
 
-          PrepareTCP_FRAME(TCP_CODE_ACK);        // ACK this ISN
-          TCPStateMachine = ESTABLISHED;
-          SocketStatus |= SOCK_CONNECTED;
-          SocketStatus |= SOCK_TX_BUF_RELEASED;  // user may send data now :-)
+          PrepareTCP_FRAME(Sock, TCP_CODE_ACK);  // ACK this ISN
+          Sock->StateMachine = ESTABLISHED;
+          Sock->Status |= SOCK_CONNECTED;
+          Sock->Status |= SOCK_TX_BUF_RELEASED;  // user may send data now :-)
         }
         else
         {
-          TCPStopTimer();
-          PrepareTCP_FRAME(TCP_CODE_SYN | TCP_CODE_ACK);   // our SYN isn't ACKed yet,
-          LastFrameSent = TCP_SYN_ACK_FRAME;               // now continue with sending
-          TCPStartRetryTimer();                            // SYN_ACK frames
-          TCPStateMachine = SYN_RECD;
+          TCPStopTimer(Sock);
+          PrepareTCP_FRAME(Sock, TCP_CODE_SYN | TCP_CODE_ACK);   // our SYN isn't ACKed yet,
+          Sock->LastFrameSent = TCP_SYN_ACK_FRAME;               // now continue with sending
+          TCPStartRetryTimer(Sock);                              // SYN_ACK frames
+          Sock->StateMachine = SYN_RECD;
         }
       }
       break;
     }
     default :
     {
-      if (memcmp(&RemoteIP, &RecdFrameIP, 4)) break;  // drop segment if IP doesn't belong
-                                                      // to current session
-
-      if (TCPSegSourcePort != TCPRemotePort) break;   // drop segment if port doesn't match
-
-      if (TCPSegSeq != TCPAckNr) break;               // drop if it's not the segment we expect
+      if (TCPSegSeq != Sock->AckNr) break;       // drop if it's not the segment we expect
 
       if (TCPCode & TCP_CODE_RST)                // RST??
       {
-        TCPStateMachine = CLOSED;                // close the state machine
-        TCPFlags = 0;                            // reset all flags, stop retransmission...
-        SocketStatus = SOCK_ERR_CONN_RESET;      // indicate an error to user
+        Sock->StateMachine = CLOSED;             // close the state machine
+        Sock->Flags = 0;                         // reset all flags, stop retransmission...
+        Sock->Status = SOCK_ERR_CONN_RESET;      // indicate an error to user
         break;
       }
 
       if (TCPCode & TCP_CODE_SYN)                // SYN??
       {
-        PrepareTCP_FRAME(TCP_CODE_RST);          // is NOT allowed here! send a reset,
-        TCPStateMachine = CLOSED;                // close connection...
-        TCPFlags = 0;                            // reset all flags, stop retransmission...
-        SocketStatus = SOCK_ERR_REMOTE;          // fatal error!
+        PrepareTCP_FRAME(Sock, TCP_CODE_RST);    // is NOT allowed here! send a reset,
+        Sock->StateMachine = CLOSED;             // close connection...
+        Sock->Flags = 0;                         // reset all flags, stop retransmission...
+        Sock->Status = SOCK_ERR_REMOTE;          // fatal error!
         break;                                   // ...and drop the frame
       }
 
       if (!(TCPCode & TCP_CODE_ACK)) break;      // drop segment if the ACK bit is off
 
-      if (TCPSegAck == TCPUNASeqNr)              // is our last data sent ACKed?
+      if (TCPSegAck == Sock->UNASeqNr)           // is our last data sent ACKed?
       {
-        TCPStopTimer();                          // stop retransmission
-        TCPSeqNr = TCPUNASeqNr;                  // advance our sequence number
+        TCPStopTimer(Sock);                      // stop retransmission
+        Sock->SeqNr = Sock->UNASeqNr;            // advance our sequence number
 
-        switch (TCPStateMachine)                 // change state if necessary
+        switch (Sock->StateMachine)              // change state if necessary
         {
           case SYN_RECD :                        // ACK of our SYN?
           {
-            TCPStateMachine = ESTABLISHED;       // user may send data now :-)
-            SocketStatus |= SOCK_CONNECTED;
+            Sock->StateMachine = ESTABLISHED;    // user may send data now :-)
+            Sock->Status |= SOCK_CONNECTED;
             break;
           }
-          case FIN_WAIT_1 : { TCPStateMachine = FIN_WAIT_2; break; } // ACK of our FIN?
-          case CLOSING :    { TCPStateMachine = TIME_WAIT; break; }  // ACK of our FIN?
-          case LAST_ACK :                                            // ACK of our FIN?
+          case FIN_WAIT_1 : { Sock->StateMachine = FIN_WAIT_2; break; } // ACK of our FIN?
+          case CLOSING :    { Sock->StateMachine = TIME_WAIT; break; }  // ACK of our FIN?
+          case LAST_ACK :                                               // ACK of our FIN?
           {
-            TCPStateMachine = CLOSED;
-            TCPFlags = 0;                        // reset all flags, stop retransmission...
-            SocketStatus &= SOCK_DATA_AVAILABLE; // clear all flags but data available
+            Sock->StateMachine = CLOSED;
+            Sock->Flags = 0;                     // reset all flags, stop retransmission...
+            Sock->Status &= SOCK_DATA_AVAILABLE; // clear all flags but data available
             break;
           }
           case TIME_WAIT :
           {
-            PrepareTCP_FRAME(TCP_CODE_ACK);      // ACK a retransmission of remote FIN
-            TCPRestartTimer();                   // restart TIME_WAIT timeout
+            PrepareTCP_FRAME(Sock, TCP_CODE_ACK);  // ACK a retransmission of remote FIN
+            TCPRestartTimer(Sock);                 // restart TIME_WAIT timeout
             break;
           }
+          default :
+            break;
         }
 
-        if (TCPStateMachine == ESTABLISHED)      // if true, give the frame buffer back
-          SocketStatus |= SOCK_TX_BUF_RELEASED;  // to user
+        if (Sock->StateMachine == ESTABLISHED)   // if true, give the frame buffer back
+          Sock->Status |= SOCK_TX_BUF_RELEASED;  // to user
       }
 
-      if ((TCPStateMachine == ESTABLISHED) || (TCPStateMachine == FIN_WAIT_1) || (TCPStateMachine == FIN_WAIT_2))
+      if ((Sock->StateMachine == ESTABLISHED) || (Sock->StateMachine == FIN_WAIT_1) || (Sock->StateMachine == FIN_WAIT_2))
         if (NrOfDataBytes)                                 // data available?
-          if (!(SocketStatus & SOCK_DATA_AVAILABLE))       // rx data-buffer empty?
+          if (!(Sock->Status & SOCK_DATA_AVAILABLE))       // rx data-buffer empty?
           {
             DummyReadFrame_EMAC(6);                        // ignore window, checksum, urgent pointer
-            CopyFromFrame_EMAC(RxTCPBuffer, NrOfDataBytes);// fetch data and
-            TCPRxDataCount = NrOfDataBytes;                // ...tell the user...
-            SocketStatus |= SOCK_DATA_AVAILABLE;           // indicate the new data to user
-            TCPAckNr += NrOfDataBytes;
-            PrepareTCP_FRAME(TCP_CODE_ACK);                // ACK rec'd data
+            CopyFromFrame_EMAC(Sock->RxBuffer, NrOfDataBytes);// fetch data and
+            Sock->RxDataCount = NrOfDataBytes;             // ...tell the user...
+            Sock->Status |= SOCK_DATA_AVAILABLE;           // indicate the new data to user
+            Sock->AckNr += NrOfDataBytes;
+            PrepareTCP_FRAME(Sock, TCP_CODE_ACK);          // ACK rec'd data
           }
 
       if (TCPCode & TCP_CODE_FIN)                // FIN??
       {
-        switch (TCPStateMachine)
+        switch (Sock->StateMachine)
         {
           case SYN_RECD :
           case ESTABLISHED :
           {
-            TCPStateMachine = CLOSE_WAIT;
+            Sock->StateMachine = CLOSE_WAIT;
             break;
           }
           case FIN_WAIT_1 :
           {                                      // if our FIN was ACKed, we automatically
-            TCPStateMachine = CLOSING;           // enter FIN_WAIT_2 (look above) and therefore
-            SocketStatus &= ~SOCK_CONNECTED;     // TIME_WAIT
+            Sock->StateMachine = CLOSING;        // enter FIN_WAIT_2 (look above) and therefore
+            Sock->Status &= ~SOCK_CONNECTED;     // TIME_WAIT
             break;
           }
           case FIN_WAIT_2 :
           {
-            TCPStartTimeWaitTimer();
-            TCPStateMachine = TIME_WAIT;
-            SocketStatus &= ~SOCK_CONNECTED;
+            TCPStartTimeWaitTimer(Sock);
+            Sock->StateMachine = TIME_WAIT;
+            Sock->Status &= ~SOCK_CONNECTED;
             break;
           }
           case TIME_WAIT :
           {
-            TCPRestartTimer();
+            TCPRestartTimer(Sock);
             break;
           }
+          default :
+            break;
         }
-        TCPAckNr++;                              // ACK remote's FIN flag
-        PrepareTCP_FRAME(TCP_CODE_ACK);
+        Sock->AckNr++;                           // ACK remote's FIN flag
+        PrepareTCP_FRAME(Sock, TCP_CODE_ACK);
       }
     }
   }
 }
 
 // easyWEB internal function
-// prepares the TxFrame2-buffer to send an ARP-request
+// prepares the TxFrame2-buffer to send an ARP-request for the MAC of
+// the socket's remote IP (or of the gateway) and sends it
 
-void PrepareARP_REQUEST(void)
+void PrepareARP_REQUEST(TTCPSocket *Sock)
 {
   // Ethernet
   memset(&TxFrame2[ETH_DA_OFS], (char)0xFF, 6);                  // we don't know opposites MAC!
@@ -731,17 +822,17 @@ void PrepareARP_REQUEST(void)
   memcpy(&TxFrame2[ARP_SENDER_IP_OFS], &MyIP, 4);
   memset(&TxFrame2[ARP_TARGET_HA_OFS], 0x00, 6);           // we don't know opposites MAC!
 
-  if (((RemoteIP[0] ^ MyIP[0]) & SubnetMask[0]) || ((RemoteIP[1] ^ MyIP[1]) & SubnetMask[1]))
+  if (((Sock->RemoteIP[0] ^ MyIP[0]) & SubnetMask[0]) || ((Sock->RemoteIP[1] ^ MyIP[1]) & SubnetMask[1]))
     memcpy(&TxFrame2[ARP_TARGET_IP_OFS], &GatewayIP, 4);   // IP not in subnet, use gateway
   else
-    memcpy(&TxFrame2[ARP_TARGET_IP_OFS], &RemoteIP, 4);    // other IP is next to us...
+    memcpy(&TxFrame2[ARP_TARGET_IP_OFS], &Sock->RemoteIP, 4);  // other IP is next to us...
 
   TxFrame2Size = ETH_HEADER_SIZE + ARP_FRAME_SIZE;
-  TransmitControl |= SEND_FRAME2;
+  SendFrame2();
 }
 
 // easyWEB internal function
-// prepares the TxFrame2-buffer to send an ARP-answer (reply)
+// prepares the TxFrame2-buffer to send an ARP-answer (reply) and sends it
 
 void PrepareARP_ANSWER(void)
 {
@@ -761,11 +852,11 @@ void PrepareARP_ANSWER(void)
   memcpy(&TxFrame2[ARP_TARGET_IP_OFS], &RecdFrameIP, 4);
 
   TxFrame2Size = ETH_HEADER_SIZE + ARP_FRAME_SIZE;
-  TransmitControl |= SEND_FRAME2;
+  SendFrame2();
 }
 
 // easyWEB internal function
-// prepares the TxFrame2-buffer to send an ICMP-echo-reply
+// prepares the TxFrame2-buffer to send an ICMP-echo-reply and sends it
 
 void PrepareICMP_ECHO_REPLY(void)
 {
@@ -790,27 +881,27 @@ void PrepareICMP_ECHO_REPLY(void)
   *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = 0;
   memcpy(&TxFrame2[IP_SOURCE_OFS], &MyIP, 4);
   memcpy(&TxFrame2[IP_DESTINATION_OFS], &RecdFrameIP, 4);
-  *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = CalcChecksum(&TxFrame2[IP_VER_IHL_TOS_OFS], IP_HEADER_SIZE, 0);
+  *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = CalcChecksum(&TxFrame2[IP_VER_IHL_TOS_OFS], IP_HEADER_SIZE, NULL);
 
   // ICMP
   *(unsigned short *)&TxFrame2[ICMP_TYPE_CODE_OFS] = SWAPB(ICMP_ECHO_REPLY << 8);
   *(unsigned short *)&TxFrame2[ICMP_CHKSUM_OFS] = 0;                   // initialize checksum field
 
   CopyFromFrame_EMAC(&TxFrame2[ICMP_DATA_OFS], ICMPDataCount);        // get data to echo...
-  *(unsigned short *)&TxFrame2[ICMP_CHKSUM_OFS] = CalcChecksum(&TxFrame2[IP_DATA_OFS], ICMPDataCount + ICMP_HEADER_SIZE, 0);
+  *(unsigned short *)&TxFrame2[ICMP_CHKSUM_OFS] = CalcChecksum(&TxFrame2[IP_DATA_OFS], ICMPDataCount + ICMP_HEADER_SIZE, NULL);
 
   TxFrame2Size = ETH_HEADER_SIZE + IP_HEADER_SIZE + ICMP_HEADER_SIZE + ICMPDataCount;
-  TransmitControl |= SEND_FRAME2;
+  SendFrame2();
 }
 
 // easyWEB internal function
-// prepares the TxFrame2-buffer to send a general TCP frame
-// the TCPCode-field is passed as an argument
+// prepares the TxFrame2-buffer to send a general TCP frame of a socket
+// and sends it. the TCPCode-field is passed as an argument
 
-void PrepareTCP_FRAME(unsigned short TCPCode)
+void PrepareTCP_FRAME(TTCPSocket *Sock, unsigned short TCPCode)
 {
   // Ethernet
-  memcpy(&TxFrame2[ETH_DA_OFS], &RemoteMAC, 6);
+  memcpy(&TxFrame2[ETH_DA_OFS], &Sock->RemoteMAC, 6);
   memcpy(&TxFrame2[ETH_SA_OFS], &MyMAC, 6);
   *(unsigned short *)&TxFrame2[ETH_TYPE_OFS] = SWAPB(FRAME_IP);
 
@@ -827,15 +918,14 @@ void PrepareTCP_FRAME(unsigned short TCPCode)
   *(unsigned short *)&TxFrame2[IP_TTL_PROT_OFS] = SWAPB((DEFAULT_TTL << 8) | PROT_TCP);
   *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = 0;
   memcpy(&TxFrame2[IP_SOURCE_OFS], &MyIP, 4);
-  memcpy(&TxFrame2[IP_DESTINATION_OFS], &RemoteIP, 4);
-  *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = CalcChecksum(&TxFrame2[IP_VER_IHL_TOS_OFS], IP_HEADER_SIZE, 0);
+  memcpy(&TxFrame2[IP_DESTINATION_OFS], &Sock->RemoteIP, 4);
 
   // TCP
-  WriteWBE(&TxFrame2[TCP_SRCPORT_OFS], TCPLocalPort);
-  WriteWBE(&TxFrame2[TCP_DESTPORT_OFS], TCPRemotePort);
+  WriteWBE(&TxFrame2[TCP_SRCPORT_OFS], Sock->LocalPort);
+  WriteWBE(&TxFrame2[TCP_DESTPORT_OFS], Sock->RemotePort);
 
-  WriteDWBE(&TxFrame2[TCP_SEQNR_OFS], TCPSeqNr);
-  WriteDWBE(&TxFrame2[TCP_ACKNR_OFS], TCPAckNr);
+  WriteDWBE(&TxFrame2[TCP_SEQNR_OFS], Sock->SeqNr);
+  WriteDWBE(&TxFrame2[TCP_ACKNR_OFS], Sock->AckNr);
 
   *(unsigned short *)&TxFrame2[TCP_WINDOW_OFS] = SWAPB(MAX_TCP_RX_DATA_SIZE);    // data bytes to accept
   *(unsigned short *)&TxFrame2[TCP_CHKSUM_OFS] = 0;             // initalize checksum
@@ -846,67 +936,80 @@ void PrepareTCP_FRAME(unsigned short TCPCode)
     *(unsigned short *)&TxFrame2[TCP_DATA_CODE_OFS] = SWAPB(0x6000 | TCPCode);   // TCP header length = 24
     *(unsigned short *)&TxFrame2[TCP_DATA_OFS] = SWAPB(TCP_OPT_MSS);             // MSS option
     *(unsigned short *)&TxFrame2[TCP_DATA_OFS + 2] = SWAPB(MAX_TCP_RX_DATA_SIZE);// max. length of TCP-data we accept
-    *(unsigned short *)&TxFrame2[TCP_CHKSUM_OFS] = CalcChecksum(&TxFrame2[TCP_SRCPORT_OFS], TCP_HEADER_SIZE + TCP_OPT_MSS_SIZE, 1);
+    *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = CalcChecksum(&TxFrame2[IP_VER_IHL_TOS_OFS], IP_HEADER_SIZE, NULL);
+    *(unsigned short *)&TxFrame2[TCP_CHKSUM_OFS] = CalcChecksum(&TxFrame2[TCP_SRCPORT_OFS], TCP_HEADER_SIZE + TCP_OPT_MSS_SIZE, Sock);
     TxFrame2Size = ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + TCP_OPT_MSS_SIZE;
   }
   else
   {
     *(unsigned short *)&TxFrame2[TCP_DATA_CODE_OFS] = SWAPB(0x5000 | TCPCode);   // TCP header length = 20
-    *(unsigned short *)&TxFrame2[TCP_CHKSUM_OFS] = CalcChecksum(&TxFrame2[TCP_SRCPORT_OFS], TCP_HEADER_SIZE, 1);
+    TCPUpdateChecksums(Sock, TxFrame2);
+    *(unsigned short *)&TxFrame2[IP_HEAD_CHKSUM_OFS] = Sock->IPChecksum;
+    *(unsigned short *)&TxFrame2[TCP_CHKSUM_OFS] = Sock->TCPChecksum;
     TxFrame2Size = ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE;
   }
 
-  TransmitControl |= SEND_FRAME2;
+  SendFrame2();
 }
 
 // easyWEB internal function
-// prepares the TxFrame1-buffer to send a payload-packet
+// prepares the TxFrame1-buffer of a socket to send a payload-packet
 
-void PrepareTCP_DATA_FRAME(void)
+void PrepareTCP_DATA_FRAME(TTCPSocket *Sock)
 {
+  unsigned char *TxFrame1 = Sock->TxFrame;
+  unsigned short Checksum;
+
   // Ethernet
-  memcpy(&TxFrame1[ETH_DA_OFS], &RemoteMAC, 6);
+  memcpy(&TxFrame1[ETH_DA_OFS], &Sock->RemoteMAC, 6);
   memcpy(&TxFrame1[ETH_SA_OFS], &MyMAC, 6);
   *(unsigned short *)&TxFrame1[ETH_TYPE_OFS] = SWAPB(FRAME_IP);
 
   // IP
   *(unsigned short *)&TxFrame1[IP_VER_IHL_TOS_OFS] = SWAPB(IP_VER_IHL | IP_TOS_D);
-  WriteWBE(&TxFrame1[IP_TOTAL_LENGTH_OFS], IP_HEADER_SIZE + TCP_HEADER_SIZE + TCPTxDataCount);
+  *(unsigned short *)&TxFrame1[IP_TOTAL_LENGTH_OFS] = SWAPB(IP_HEADER_SIZE + TCP_HEADER_SIZE);  // set below
   *(unsigned short *)&TxFrame1[IP_IDENT_OFS] = 0;
   *(unsigned short *)&TxFrame1[IP_FLAGS_FRAG_OFS] = 0;
   *(unsigned short *)&TxFrame1[IP_TTL_PROT_OFS] = SWAPB((DEFAULT_TTL << 8) | PROT_TCP);
   *(unsigned short *)&TxFrame1[IP_HEAD_CHKSUM_OFS] = 0;
   memcpy(&TxFrame1[IP_SOURCE_OFS], &MyIP, 4);
-  memcpy(&TxFrame1[IP_DESTINATION_OFS], &RemoteIP, 4);
-  *(unsigned short *)&TxFrame1[IP_HEAD_CHKSUM_OFS] = CalcChecksum(&TxFrame1[IP_VER_IHL_TOS_OFS], IP_HEADER_SIZE, 0);
+  memcpy(&TxFrame1[IP_DESTINATION_OFS], &Sock->RemoteIP, 4);
 
   // TCP
-  WriteWBE(&TxFrame1[TCP_SRCPORT_OFS], TCPLocalPort);
-  WriteWBE(&TxFrame1[TCP_DESTPORT_OFS], TCPRemotePort);
+  WriteWBE(&TxFrame1[TCP_SRCPORT_OFS], Sock->LocalPort);
+  WriteWBE(&TxFrame1[TCP_DESTPORT_OFS], Sock->RemotePort);
 
-  WriteDWBE(&TxFrame1[TCP_SEQNR_OFS], TCPSeqNr);
-  WriteDWBE(&TxFrame1[TCP_ACKNR_OFS], TCPAckNr);
+  WriteDWBE(&TxFrame1[TCP_SEQNR_OFS], Sock->SeqNr);
+  WriteDWBE(&TxFrame1[TCP_ACKNR_OFS], Sock->AckNr);
   *(unsigned short *)&TxFrame1[TCP_DATA_CODE_OFS] = SWAPB(0x5000 | TCP_CODE_ACK);   // TCP header length = 20
   *(unsigned short *)&TxFrame1[TCP_WINDOW_OFS] = SWAPB(MAX_TCP_RX_DATA_SIZE);       // data bytes to accept
   *(unsigned short *)&TxFrame1[TCP_CHKSUM_OFS] = 0;
   *(unsigned short *)&TxFrame1[TCP_URGENT_OFS] = 0;
-  *(unsigned short *)&TxFrame1[TCP_CHKSUM_OFS] = CalcChecksum(&TxFrame1[TCP_SRCPORT_OFS], TCP_HEADER_SIZE + TCPTxDataCount, 1);
+
+  // checksums: the ones of this frame without data, with the lengths of
+  // IP header and pseudo-header changed (RFC 1624), plus the data's sum
+  TCPUpdateChecksums(Sock, TxFrame1);
+  WriteWBE(&TxFrame1[IP_TOTAL_LENGTH_OFS], IP_HEADER_SIZE + TCP_HEADER_SIZE + Sock->TxDataCount);
+  *(unsigned short *)&TxFrame1[IP_HEAD_CHKSUM_OFS] = UpdateChecksum(Sock->IPChecksum,
+    SWAPB(IP_HEADER_SIZE + TCP_HEADER_SIZE), *(unsigned short *)&TxFrame1[IP_TOTAL_LENGTH_OFS]);
+  Checksum = UpdateChecksum(Sock->TCPChecksum, SWAPB(TCP_HEADER_SIZE), SwapBytes(TCP_HEADER_SIZE + Sock->TxDataCount));
+  *(unsigned short *)&TxFrame1[TCP_CHKSUM_OFS] = UpdateChecksum(Checksum, 0, Sock->TxDataSum);
 }
 
 // easyWEB internal function
-// calculates the TCP/IP checksum. if 'IsTCP != 0', the TCP pseudo-header
-// will be included.
+// calculates the TCP/IP checksum. if 'Sock != NULL', the TCP pseudo-header
+// (to the socket's remote IP) will be included.
 
-unsigned short CalcChecksum(void *Start, unsigned short Count, unsigned char IsTCP)
+unsigned short CalcChecksum(void *Start, unsigned short Count, TTCPSocket *Sock)
 {
   unsigned long Sum = 0;
   unsigned short * piStart;                        // Keil: Pointer added to correct expression
 
-  if (IsTCP) {                                   // if we've a TCP frame...
+  if (Sock) {                                    // if we've a TCP frame...
     Sum += MyIP[0];                              // ...include TCP pseudo-header
     Sum += MyIP[1];
-    Sum += RemoteIP[0];
-    Sum += RemoteIP[1];
+    Sum += Sock->RemoteIP[0];
+    Sum += Sock->RemoteIP[1];
     Sum += SwapBytes(Count);                     // TCP header length plus data length
     Sum += SWAPB(PROT_TCP);
   }
@@ -929,71 +1032,127 @@ unsigned short CalcChecksum(void *Start, unsigned short Count, unsigned char IsT
 }
 
 // easyWEB internal function
-// starts the timer as a retry-timer (used for retransmission-timeout)
+// updates a checksum made by 'CalcChecksum()' when a word of the summed
+// data changes from 'Old' to 'New' (RFC 1624: HC' = ~(~HC + ~m + m')),
+// without summing the data again. the words are passed as they're stored
+// in the frame, like 'CalcChecksum()' reads them
+
+unsigned short UpdateChecksum(unsigned short Checksum, unsigned short Old, unsigned short New)
+{
+  unsigned long Sum;
+
+  Sum = (unsigned short)~Checksum;
+  Sum += (unsigned short)~Old;
+  Sum += New;
+  Sum = (Sum & 0xFFFF) + (Sum >> 16);            // fold twice, the first
+  Sum = (Sum & 0xFFFF) + (Sum >> 16);            // fold may carry again
+
+  return ~Sum;
+}
+
+// easyWEB internal function
+// brings 'IPChecksum' and 'TCPChecksum' of a socket up to date for its frame
+// without data in 'Frame' (headers written, checksums 0). during a connection
+// only SEQ, ACK and the code field of such a frame change, so just these
+// words are updated in the checksums of the last one (RFC 1624). the
+// headers are summed only for the first frame (no CHECKSUMS_VALID)
+
+void TCPUpdateChecksums(TTCPSocket *Sock, unsigned char *Frame)
+{
+  unsigned short *Words = (unsigned short *)&Frame[TCP_SEQNR_OFS];   // SEQ, ACK, code
+  unsigned long Sum;
+  unsigned char i;
+
+  if (Sock->Flags & CHECKSUMS_VALID)
+  {
+    Sum = (unsigned short)~Sock->TCPChecksum;
+    for (i = 0; i < 5; i++)
+    {
+      Sum += (unsigned short)~Sock->ChecksumWords[i];
+      Sum += Words[i];
+    }
+    Sum = (Sum & 0xFFFF) + (Sum >> 16);
+    Sum = (Sum & 0xFFFF) + (Sum >> 16);
+    Sock->TCPChecksum = ~Sum;
+  }
+  else
+  {
+    Sock->IPChecksum = CalcChecksum(&Frame[IP_VER_IHL_TOS_OFS], IP_HEADER_SIZE, NULL);
+    Sock->TCPChecksum = CalcChecksum(&Frame[TCP_SRCPORT_OFS], TCP_HEADER_SIZE, Sock);
+    Sock->Flags |= CHECKSUMS_VALID;
+  }
+
+  memcpy(Sock->ChecksumWords, Words, sizeof(Sock->ChecksumWords));
+}
+
+// easyWEB internal function
+// starts the timer of a socket as a retry-timer (used for
+// retransmission-timeout)
 
-void TCPStartRetryTimer(void)
+void TCPStartRetryTimer(TTCPSocket *Sock)
 {
-  TCPTimer = 0;
-  RetryCounter = MAX_RETRYS;
-  TCPFlags |= TCP_TIMER_RUNNING;
-  TCPFlags |= TIMER_TYPE_RETRY;
+  Sock->TimerStart = TCPTicks;
+  Sock->RetryCounter = MAX_RETRYS;
+  Sock->Flags |= TCP_TIMER_RUNNING;
+  Sock->Flags |= TIMER_TYPE_RETRY;
 }
 
 // easyWEB internal function
-// starts the timer as a 'TIME_WAIT'-timer (used to finish a TCP-session)
+// starts the timer of a socket as a 'TIME_WAIT'-timer (used to finish
+// a TCP-session)
 
-void TCPStartTimeWaitTimer(void)
+void TCPStartTimeWaitTimer(TTCPSocket *Sock)
 {
-  TCPTimer = 0;
-  TCPFlags |= TCP_TIMER_RUNNING;
-  TCPFlags &= ~TIMER_TYPE_RETRY;
+  Sock->TimerStart = TCPTicks;
+  Sock->Flags |= TCP_TIMER_RUNNING;
+  Sock->Flags &= ~TIMER_TYPE_RETRY;
 }
 
 // easyWEB internal function
-// restarts the timer
+// restarts the timer of a socket
 
-void TCPRestartTimer(void)
+void TCPRestartTimer(TTCPSocket *Sock)
 {
-  TCPTimer = 0;
+  Sock->TimerStart = TCPTicks;
 }
 
 // easyWEB internal function
-// stopps the timer
+// stopps the timer of a socket
 
-void TCPStopTimer(void)
+void TCPStopTimer(TTCPSocket *Sock)
 {
-  TCPFlags &= ~TCP_TIMER_RUNNING;
+  Sock->Flags &= ~TCP_TIMER_RUNNING;
 }
 
 // easyWEB internal function
 // if a retransmission-timeout occured, check which packet
 // to resend.
 
-void TCPHandleRetransmission(void)
+void TCPHandleRetransmission(TTCPSocket *Sock)
 {
-  switch (LastFrameSent)
+  switch (Sock->LastFrameSent)
   {
-    case ARP_REQUEST :       { PrepareARP_REQUEST(); break; }
-    case TCP_SYN_FRAME :     { PrepareTCP_FRAME(TCP_CODE_SYN); break; }
-    case TCP_SYN_ACK_FRAME : { PrepareTCP_FRAME(TCP_CODE_SYN | TCP_CODE_ACK); break; }
-    case TCP_FIN_FRAME :     { PrepareTCP_FRAME(TCP_CODE_FIN | TCP_CODE_ACK); break; }
-    case TCP_DATA_FRAME :    { TransmitControl |= SEND_FRAME1; break; }
+    case ARP_REQUEST :       { PrepareARP_REQUEST(Sock); break; }
+    case TCP_SYN_FRAME :     { PrepareTCP_FRAME(Sock, TCP_CODE_SYN); break; }
+    case TCP_SYN_ACK_FRAME : { PrepareTCP_FRAME(Sock, TCP_CODE_SYN | TCP_CODE_ACK); break; }
+    case TCP_FIN_FRAME :     { PrepareTCP_FRAME(Sock, TCP_CODE_FIN | TCP_CODE_ACK); break; }
+    case TCP_DATA_FRAME :    { PrepareTCP_DATA_FRAME(Sock); SendFrame1(Sock); break; }
   }
 }
 
 // easyWEB internal function
 // if all retransmissions failed, close connection and indicate an error
 
-void TCPHandleTimeout(void)
+void TCPHandleTimeout(TTCPSocket *Sock)
 {
-  TCPStateMachine = CLOSED;
+  Sock->StateMachine = CLOSED;
 
-  if ((TCPFlags & (TCP_ACTIVE_OPEN | IP_ADDR_RESOLVED)) == TCP_ACTIVE_OPEN)
-    SocketStatus = SOCK_ERR_ARP_TIMEOUT;         // indicate an error to user
+  if ((Sock->Flags & (TCP_ACTIVE_OPEN | IP_ADDR_RESOLVED)) == TCP_ACTIVE_OPEN)
+    Sock->Status = SOCK_ERR_ARP_TIMEOUT;         // indicate an error to user
   else
-    SocketStatus = SOCK_ERR_TCP_TIMEOUT;
+    Sock->Status = SOCK_ERR_TCP_TIMEOUT;
 
-  TCPFlags = 0;                                  // clear all flags
+  Sock->Flags = 0;                               // clear all flags
 }
 
 
@@ -1002,11 +1161,11 @@ void TCPHandleTimeout(void)
  */
 // easyWEB internal function
 // function executed every 0.210s by the CPU. used for the
-// inital sequence number generator (ISN) and the TCP-timer
+// inital sequence number generator (ISN) and the TCP-timers
 void SysTick_Handler (void) {           /* SysTick Interrupt Handler (1ms)    */
 	ISNGenHigh++;                                  // upper 16 bits of initial sequence number
-	TCPTimer++;                                    // timer for retransmissions
-	_tickVal = (++_tickVal) & 0x03;
+	TCPTicks++;                                    // time base of the sockets' timers
+	_tickVal = (_tickVal + 1) & 0x03;
 	if (!_tickVal){
 #ifdef MCB_LPC_1768
 		LPC_GPIO2->FIOPIN ^= LED_PIN;
@@ -1018,19 +1177,31 @@ void SysTick_Handler (void) {           /* SysTick Interrupt Handler (1ms)    */
 
 
 // easyWEB internal function
-// transfers the contents of 'TxFrame1'-Buffer to the EMAC
+// transfers the contents of a socket's 'TxFrame1'-Buffer to the EMAC
+// NOTE: if the EMAC has no room for it, the frame is dropped and
+//       resent by the retry-timer
 
-void SendFrame1(void)
+void SendFrame1(TTCPSocket *Sock)
 {
-  CopyToFrame_EMAC(TxFrame1, TxFrame1Size);
+  unsigned short TxFrame1Size;
+
+  TxFrame1Size = ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + Sock->TxDataCount;
+  RequestSend(TxFrame1Size);
+
+  if (Rdy4Tx())                                  // EMAC ready to accept our frame?
+    CopyToFrame_EMAC(Sock->TxFrame, TxFrame1Size);
 }
 
 // easyWEB internal function
 // transfers the contents of 'TxFrame2'-Buffer to the EMAC
+// (see note above, ACKs lost this way are repeated by the other TCP)
 
 void SendFrame2(void)
 {
-  CopyToFrame_EMAC(TxFrame2, TxFrame2Size);
+  RequestSend(TxFrame2Size);
+
+  if (Rdy4Tx())
+    CopyToFrame_EMAC(TxFrame2, TxFrame2Size);
 }
 
 // easyWEB internal function
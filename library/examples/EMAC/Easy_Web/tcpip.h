@@ -36,6 +36,9 @@
 #define MAX_RETRYS           4                   // nr. of resendings before reset conn.
                                                  // total nr. of transmissions = MAX_RETRYS + 1
 
+#define MAX_TCP_SOCKETS      4                   // nr. of TCP connections at the same time
+                                                 // (each one has its own TX- and RX-buffer)
+
 #define MAX_TCP_TX_DATA_SIZE 512                 // max. outgoing TCP data size (even!)
 #define MAX_TCP_RX_DATA_SIZE 256                 // max. incoming TCP data size (even!)
                                                  // (increasing the buffer-size dramatically
@@ -191,18 +194,39 @@ extern const unsigned short GatewayIP[2];        // "GWIP1.GWIP2.GWIP3.GWIP4"
 extern const unsigned char MyMAC[6];             // "M1-M2-M3-M4-M5-M6"
 #endif
 
+// one TCP connection (socket) of easyWEB
+typedef struct {
+  TTCPStateMachine StateMachine;                 // perhaps the most important var at all ;-)
+  TLastFrameSent LastFrameSent;                  // retransmission type
+  unsigned char Flags;                           // TCP_ACTIVE_OPEN... (see below)
+  unsigned char Status;                          // SOCK_ACTIVE... (see below)
+  unsigned char TimerStart;                      // 'TCPTicks' when its timer was (re)started
+  unsigned char RetryCounter;                    // nr. of retransmissions
+  unsigned long SeqNr;                           // next sequence number to send
+  unsigned long UNASeqNr;                        // last unaknowledged sequence number
+                                                 // incremented AFTER sending data
+  unsigned long AckNr;                           // next seq to receive and ack to send
+                                                 // incremented AFTER receiving data
+  unsigned short LocalPort;                      // TCP ports
+  unsigned short RemotePort;
+  unsigned short RemoteMAC[3];                   // MAC and IP of this TCP-session
+  unsigned short RemoteIP[2];
+  unsigned short RxDataCount;                    // nr. of bytes rec'd
+  unsigned short TxDataCount;                    // nr. of bytes to send
+  unsigned short TxDataSum;                      // their sum, for retransmissions
+  unsigned short IPChecksum;                     // checksums of its last frame without
+  unsigned short TCPChecksum;                    // data (if CHECKSUMS_VALID) and the
+  unsigned short ChecksumWords[5];               // SEQ, ACK and code in it
+  unsigned char *TxFrame;                        // its frame buffer ('TxFrame1(Sock)')
+  unsigned char *RxBuffer;                       // its data buffer ('RxTCPBuffer(Sock)')
+} TTCPSocket;
+
 // easyWEB's internal variables
-extern TTCPStateMachine TCPStateMachine;         // perhaps the most important var at all ;-)
-extern TLastFrameSent LastFrameSent;             // retransmission type
+extern TTCPSocket TCPSocket[MAX_TCP_SOCKETS];    // all connections, see 'easyWEB-API' below
 
 extern unsigned short ISNGenHigh;                // upper word of our Initial Sequence Number
-extern unsigned long TCPSeqNr;                   // next sequence number to send
-extern unsigned long TCPUNASeqNr;                // last unaknowledged sequence number
-                                                 // incremented AFTER sending data
-extern unsigned long TCPAckNr;                   // next seq to receive and ack to send
-                                                 // incremented AFTER receiving data
-extern unsigned char TCPTimer;                   // inc'd each 262ms
-extern unsigned char RetryCounter;               // nr. of retransmissions
+extern volatile unsigned char TCPTicks;          // inc'd each 210ms, the sockets' timers
+                                                 // count from their 'TimerStart'
 
 // properties of the just received frame
 extern unsigned short RecdFrameLength;           // EMAC reported frame length
@@ -212,66 +236,70 @@ extern unsigned short RecdIPFrameLength;         // 16 bit IP packet length
 
 // the next 3 buffers must be word-aligned!
 // (here the 'RecdIPFrameLength' above does that)
+// every socket has a TxFrame1 and a RxTCPBuffer, TxFrame2 is shared: frames
+// in it are handed to the EMAC right after they are prepared
 #if defined ( __CC_ARM   )
-extern unsigned short __align(4) _TxFrame1[(ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + MAX_TCP_TX_DATA_SIZE)/2];
+extern unsigned short __align(4) _TxFrame1[MAX_TCP_SOCKETS][(ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + MAX_TCP_TX_DATA_SIZE)/2];
 extern unsigned short __align(4) _TxFrame2[(ETH_HEADER_SIZE + MAX_ETH_TX_DATA_SIZE)/2];
-extern unsigned short __align(4) _RxTCPBuffer[MAX_TCP_RX_DATA_SIZE/2]; // space for incoming TCP-data
+extern unsigned short __align(4) _RxTCPBuffer[MAX_TCP_SOCKETS][MAX_TCP_RX_DATA_SIZE/2]; // space for incoming TCP-data
 #elif defined ( __ICCARM__ )
 #pragma data_alignment=4
-extern unsigned short _TxFrame1[(ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + MAX_TCP_TX_DATA_SIZE)/2];
+extern unsigned short _TxFrame1[MAX_TCP_SOCKETS][(ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + MAX_TCP_TX_DATA_SIZE)/2];
 #pragma data_alignment=4
 extern unsigned short _TxFrame2[(ETH_HEADER_SIZE + MAX_ETH_TX_DATA_SIZE)/2];
 #pragma data_alignment=4
-extern unsigned short _RxTCPBuffer[MAX_TCP_RX_DATA_SIZE/2]; // space for incoming TCP-data
+extern unsigned short _RxTCPBuffer[MAX_TCP_SOCKETS][MAX_TCP_RX_DATA_SIZE/2]; // space for incoming TCP-data
 #elif defined   (  __GNUC__  )
-extern unsigned short __attribute__ ((aligned (4))) _TxFrame1[(ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + MAX_TCP_TX_DATA_SIZE)/2];
+extern unsigned short __attribute__ ((aligned (4))) _TxFrame1[MAX_TCP_SOCKETS][(ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE + MAX_TCP_TX_DATA_SIZE)/2];
 extern unsigned short __attribute__ ((aligned (4))) _TxFrame2[(ETH_HEADER_SIZE + MAX_ETH_TX_DATA_SIZE)/2];
-extern unsigned short __attribute__ ((aligned (4))) _RxTCPBuffer[MAX_TCP_RX_DATA_SIZE/2]; // space for incoming TCP-data
+extern unsigned short __attribute__ ((aligned (4))) _RxTCPBuffer[MAX_TCP_SOCKETS][MAX_TCP_RX_DATA_SIZE/2]; // space for incoming TCP-data
 #endif
-#define TxFrame1      ((unsigned char *)_TxFrame1)
-#define TxFrame2      ((unsigned char *)_TxFrame2)
-#define RxTCPBuffer   ((unsigned char *)_RxTCPBuffer)
+#define TxFrame1(Sock)    ((unsigned char *)_TxFrame1[Sock])
+#define TxFrame2          ((unsigned char *)_TxFrame2)
+#define RxTCPBuffer(Sock) ((unsigned char *)_RxTCPBuffer[Sock])
 
-extern unsigned short TxFrame1Size;              // bytes to send in TxFrame1
 extern unsigned char TxFrame2Size;               // bytes to send in TxFrame2
 
-extern unsigned char TransmitControl;
-#define SEND_FRAME1                    0x01
-#define SEND_FRAME2                    0x02
-
-extern unsigned char TCPFlags;
+// flags of a socket ('TCPSocket[].Flags')
 #define TCP_ACTIVE_OPEN                0x01      // easyWEB shall initiate a connection
 #define IP_ADDR_RESOLVED               0x02      // IP sucessfully resolved to MAC
 #define TCP_TIMER_RUNNING              0x04
 #define TIMER_TYPE_RETRY               0x08
 #define TCP_CLOSE_REQUESTED            0x10
+#define CHECKSUMS_VALID                0x20      // 'IPChecksum'... are of this connection
 
 // prototypes
 void DoNetworkStuff(void);
+void TCPWaitForEvent(void);
 
 // Handlers for incoming frames
 void ProcessEthBroadcastFrame(void);
 void ProcessEthIAFrame(void);
 void ProcessICMPFrame(void);
 void ProcessTCPFrame(void);
+TTCPSocket *TCPFindSocket(unsigned short SourcePort, unsigned short DestPort);
 
-// fill TX-buffers
-void PrepareARP_REQUEST(void);
+// fill TX-buffers (and send the TxFrame2 ones)
+void PrepareARP_REQUEST(TTCPSocket *Sock);
 void PrepareARP_ANSWER(void);
 void PrepareICMP_ECHO_REPLY(void);
-void PrepareTCP_FRAME(unsigned short TCPCode);
-void PrepareTCP_DATA_FRAME(void);
+void PrepareTCP_FRAME(TTCPSocket *Sock, unsigned short TCPCode);
+void PrepareTCP_DATA_FRAME(TTCPSocket *Sock);
 
 // general help functions
-void SendFrame1(void);
+void SendFrame1(TTCPSocket *Sock);
 void SendFrame2(void);
-void TCPStartRetryTimer(void);
-void TCPStartTimeWaitTimer(void);
-void TCPRestartTimer(void);
-void TCPStopTimer(void);
-void TCPHandleRetransmission(void);
-void TCPHandleTimeout(void);
-unsigned short CalcChecksum(void *Start, unsigned short Count, unsigned char IsTCP);
+void TCPHandleStateMachine(TTCPSocket *Sock);
+void TCPHandleTimer(TTCPSocket *Sock);
+void TCPStartRetryTimer(TTCPSocket *Sock);
+void TCPStartTimeWaitTimer(TTCPSocket *Sock);
+void TCPRestartTimer(TTCPSocket *Sock);
+void TCPStopTimer(TTCPSocket *Sock);
+void TCPHandleRetransmission(TTCPSocket *Sock);
+void TCPHandleTimeout(TTCPSocket *Sock);
+unsigned short CalcChecksum(void *Start, unsigned short Count, TTCPSocket *Sock);
+unsigned short UpdateChecksum(unsigned short Checksum, unsigned short Old, unsigned short New);
+void TCPUpdateChecksums(TTCPSocket *Sock, unsigned char *Frame);
 
 // functions to work with big-endian numbers
 unsigned short SwapBytes(unsigned short Data);
@@ -279,27 +307,23 @@ void WriteWBE(unsigned char *Add, unsigned short Data);
 void WriteDWBE(unsigned char *Add, unsigned long Data);
 
 // easyWEB-API functions
+// (all but the first take the number of the socket, 0...MAX_TCP_SOCKETS-1)
 void TCPLowLevelInit(void);                      // setup timer, LAN-controller, flags...
-void TCPPassiveOpen(void);                       // listen for a connection
-void TCPActiveOpen(void);                        // open connection
-void TCPClose(void);                             // close connection
-void TCPReleaseRxBuffer(void);                   // indicate to discard rec'd packet
-void TCPTransmitTxBuffer(void);                  // initiate transfer after TxBuffer is filled
+void TCPPassiveOpen(unsigned char SockNr);       // listen for a connection
+void TCPActiveOpen(unsigned char SockNr);        // open connection
+void TCPClose(unsigned char SockNr);             // close connection
+void TCPReleaseRxBuffer(unsigned char SockNr);   // indicate to discard rec'd packet
+void TCPTransmitTxBuffer(unsigned char SockNr);  // initiate transfer after TxBuffer is filled
 //void TCPClockHandler(void) __irq;                // Keil: interrupt service routine for timer 0
 void SysTick_Handler (void);						// NXP: System tick timer is replaced for TCPClockHandler()
 
 
-// easyWEB-API global vars and flags
-extern unsigned short TCPRxDataCount;            // nr. of bytes rec'd
-extern unsigned short TCPTxDataCount;            // nr. of bytes to send
-
-extern unsigned short TCPLocalPort;              // TCP ports
-extern unsigned short TCPRemotePort;
-
-extern unsigned short RemoteMAC[3];              // MAC and IP of current TCP-session
-extern unsigned short RemoteIP[2];
-
-extern unsigned char SocketStatus;
+// easyWEB-API global vars and flags, per socket:
+// TCPSocket[].RxDataCount                       nr. of bytes rec'd
+// TCPSocket[].TxDataCount                       nr. of bytes to send
+// TCPSocket[].LocalPort, .RemotePort            TCP ports
+// TCPSocket[].RemoteIP                          IP of the other TCP (active open)
+// TCPSocket[].Status                            flags and errors:
 #define SOCK_ACTIVE                    0x01      // state machine NOT closed
 #define SOCK_CONNECTED                 0x02      // user may send & receive data
 #define SOCK_DATA_AVAILABLE            0x04      // new data available
@@ -314,8 +338,8 @@ extern unsigned char SocketStatus;
 #define SOCK_ERR_ETHERNET              0x50      // network interface error (timeout)
 
 // easyWEB-API buffer-pointers
-#define TCP_TX_BUF      ((unsigned char *)TxFrame1 + ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE)
-#define TCP_RX_BUF      ((unsigned char *)RxTCPBuffer)
+#define TCP_TX_BUF(Sock) (TCPSocket[Sock].TxFrame + ETH_HEADER_SIZE + IP_HEADER_SIZE + TCP_HEADER_SIZE)
+#define TCP_RX_BUF(Sock) (TCPSocket[Sock].RxBuffer)
 
 #endif
 
@@ -0,0 +1,189 @@
+/**
+ * \addtogroup telemetry
+ * @{
+ */
+
+/**
+ * \file
+ *         UDP telemetry sender
+ */
+
+/*
+ * Every datagram is a 16-bit sequence number followed by the samples.
+ *
+ * telemetry_send() fills in the few header fields that change from
+ * one datagram to the next (lengths, IP id, sequence number and the
+ * checksums; the IP id is the next one of uIP) in a copy of the headers kept here, and passes headers
+ * and samples to telemetry_output() as two pieces. The checksums
+ * start from sums of the constant fields, computed once by
+ * telemetry_init(), so only the samples are summed for each datagram,
+ * and not even them without UIP_UDP_CHECKSUMS.
+ *
+ * Until ARP knows the Ethernet address of the host, datagrams go the
+ * usual way instead: copied into uip_buf and sent by uip_process()
+ * (telemetry_send_uip()), so that uip_arp_out() sends the ARP
+ * request.
+ */
+
+#include "telemetry.h"
+#include "uip.h"
+#include "uip_arp.h"
+#include <string.h>
+
+#define ETHBUF ((struct uip_eth_hdr *)&hdr.b[0])
+#define UDPBUF ((struct uip_udpip_hdr *)&hdr.b[UIP_LLH_LEN])
+#define SEQBUF (&hdr.b[UIP_LLH_LEN + UIP_IPUDPH_LEN])
+
+static struct uip_udp_conn *conn;
+static u16_t seq;
+
+/* Sums of the constant fields of the IP header and of the UDP header
+   with its pseudo header, host byte order */
+static u16_t ipsum, udpsum;
+
+/* Block for telemetry_appcall() */
+static const void *pending;
+static u16_t pending_len;
+
+/* Header template, word-aligned for the driver */
+static union {
+  u8_t b[TELEMETRY_HDR_LEN];
+  uint32_t align;
+} hdr;
+/*---------------------------------------------------------------------------*/
+static u16_t
+fold(unsigned long sum)
+{
+  sum = (sum & 0xffff) + (sum >> 16);
+  return (u16_t)(sum + (sum >> 16));
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Opens the UDP connection to rport (network byte order) of ripaddr
+ * and prepares the header template. Must be called again if the host
+ * address of uIP changes.
+ */
+void
+telemetry_init(u16_t *ripaddr, u16_t rport)
+{
+  /* lport is 0 again after uip_init() */
+  if(conn == NULL || conn->lport == 0) {
+    conn = uip_udp_new((uip_ipaddr_t *)ripaddr, rport);
+    if(conn == NULL) {
+      return;
+    }
+  } else {
+    uip_ipaddr_copy(conn->ripaddr, ripaddr);
+    conn->rport = rport;
+  }
+
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(&ETHBUF->src, &uip_ethaddr, sizeof(struct uip_eth_addr));
+  ETHBUF->type = HTONS(UIP_ETHTYPE_IP);
+  UDPBUF->vhl = 0x45;
+  UDPBUF->ttl = conn->ttl;
+  UDPBUF->proto = UIP_PROTO_UDP;
+  uip_ipaddr_copy(UDPBUF->srcipaddr, uip_hostaddr);
+  uip_ipaddr_copy(UDPBUF->destipaddr, conn->ripaddr);
+  UDPBUF->srcport = conn->lport;
+  UDPBUF->destport = conn->rport;
+
+  /* Lengths, id and checksums are still 0 in the template */
+  ipsum = htons(uip_chksum((u16_t *)UDPBUF, UIP_IPH_LEN));
+  udpsum = fold((unsigned long)UIP_PROTO_UDP +
+		htons(uip_chksum((u16_t *)UDPBUF->srcipaddr,
+				 2 * sizeof(uip_ipaddr_t) + UIP_UDPH_LEN)));
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Sends len bytes of data in one datagram. Without a copy, data must
+ * stay unchanged until the driver has sent it. Returns 0 if the
+ * datagram could not be sent.
+ */
+int
+telemetry_send(const void *data, u16_t len)
+{
+  const struct uip_eth_addr *ethaddr;
+  u16_t iplen, ipid, sum;
+
+  if(conn == NULL || len > TELEMETRY_MAX_LEN) {
+    return 0;
+  }
+  ethaddr = uip_arp_lookup(conn->ripaddr);
+  if(ethaddr == NULL) {
+    return telemetry_send_uip(data, len);
+  }
+  memcpy(&ETHBUF->dest, ethaddr, sizeof(struct uip_eth_addr));
+
+  iplen = UIP_IPUDPH_LEN + 2 + len;
+  ipid = uip_nextipid();
+  UDPBUF->len[0] = iplen >> 8;
+  UDPBUF->len[1] = iplen & 0xff;
+  UDPBUF->ipid[0] = ipid >> 8;
+  UDPBUF->ipid[1] = ipid & 0xff;
+  sum = fold((unsigned long)ipsum + iplen + ipid);
+  UDPBUF->ipchksum = ~htons(sum);
+
+  UDPBUF->udplen = htons(iplen - UIP_IPH_LEN);
+  SEQBUF[0] = seq >> 8;
+  SEQBUF[1] = seq & 0xff;
+#if UIP_UDP_CHECKSUMS
+  sum = fold((unsigned long)udpsum + 2 * (unsigned long)(iplen - UIP_IPH_LEN) + seq +
+	     htons(uip_chksum((u16_t *)data, len)));
+  UDPBUF->udpchksum = (sum == 0xffff) ? 0xffff : ~htons(sum);
+#else /* UIP_UDP_CHECKSUMS */
+  UDPBUF->udpchksum = 0;
+#endif /* UIP_UDP_CHECKSUMS */
+
+  if(!telemetry_output(hdr.b, TELEMETRY_HDR_LEN, data, len)) {
+    return 0;
+  }
+  ++seq;
+#if UIP_STATISTICS
+  ++uip_stat.udp.sent;
+  ++uip_stat.ip.sent;
+#endif /* UIP_STATISTICS */
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/*
+ * Sends len bytes of data in one datagram through uip_buf, as any
+ * other uIP application would.
+ */
+int
+telemetry_send_uip(const void *data, u16_t len)
+{
+  if(conn == NULL || len > TELEMETRY_MAX_LEN) {
+    return 0;
+  }
+  pending = data;
+  pending_len = len;
+  uip_udp_periodic_conn(conn);
+  pending = NULL;
+  if(uip_len == 0) {
+    return 0;
+  }
+  uip_arp_out();
+  if(!telemetry_output(uip_buf, uip_len, NULL, 0)) {
+    return 0;
+  }
+  ++seq;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+telemetry_appcall(void)
+{
+  u8_t *p;
+
+  if(uip_udp_conn != conn || pending == NULL) {
+    return;
+  }
+  p = (u8_t *)uip_appdata;
+  p[0] = seq >> 8;
+  p[1] = seq & 0xff;
+  memcpy(p + 2, pending, pending_len);
+  uip_udp_send(pending_len + 2);
+}
+/*---------------------------------------------------------------------------*/
+/** @} */
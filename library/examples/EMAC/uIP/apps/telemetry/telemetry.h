@@ -0,0 +1,51 @@
+/**
+ * \addtogroup apps
+ * @{
+ */
+
+/**
+ * \defgroup telemetry UDP telemetry sender
+ * @{
+ *
+ * Sends blocks of samples to one host in UDP datagrams, each one
+ * starting with a 16-bit sequence number. When the Ethernet address
+ * of the host is known, the headers come from a template prepared by
+ * telemetry_init() and the samples are handed to the driver where
+ * they are, without going through uip_buf.
+ */
+
+/**
+ * \file
+ *         Header file for the UDP telemetry sender
+ */
+
+#ifndef __TELEMETRY_H__
+#define __TELEMETRY_H__
+
+#include "uipopt.h"
+
+/* Ethernet, IP and UDP headers and the sequence number: a multiple of
+   4 bytes, so the samples start word-aligned in the frame */
+#define TELEMETRY_HDR_LEN (14 + 20 + 8 + 2)
+
+/* Largest block of samples in one datagram */
+#define TELEMETRY_MAX_LEN (UIP_BUFSIZE - TELEMETRY_HDR_LEN)
+
+typedef int uip_udp_appstate_t;
+#define UIP_UDP_APPCALL telemetry_appcall
+
+void telemetry_init(u16_t *ripaddr, u16_t rport);
+int telemetry_send(const void *data, u16_t len);
+int telemetry_send_uip(const void *data, u16_t len);
+void telemetry_appcall(void);
+
+/* Implemented by the port: sends a frame made of hdr and data (data
+   may be NULL). hdr is only valid during the call, data until the
+   driver has sent the frame. Returns 0 if the frame could not be
+   queued. */
+int telemetry_output(const void *hdr, u16_t hlen, const void *data, u16_t dlen);
+
+#endif /* __TELEMETRY_H__ */
+
+/** @} */
+/** @} */
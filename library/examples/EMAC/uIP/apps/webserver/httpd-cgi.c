@@ -138,14 +138,26 @@ static const char *states[] = {
   last_ack};
   
 
+/* The stats generators fill the segment with as many rows as fit, from
+   s->count on, and leave in s->len the row the next segment starts at.
+   s->count only moves there once the segment is acknowledged, so a
+   retransmission renders the same rows again. */
 static unsigned short
 generate_tcp_stats(void *arg)
 {
   struct uip_conn *conn;
   struct httpd_state *s = (struct httpd_state *)arg;
-    
-  conn = &uip_conns[s->count];
-  return snprintf((char *)uip_appdata, UIP_APPDATA_SIZE,
+  char *buf = (char *)uip_appdata;
+  int len, row;
+  unsigned short i;
+
+  len = 0;
+  for(i = s->count; i < UIP_CONNS; ++i) {
+    conn = &uip_conns[i];
+    if((conn->tcpstateflags & UIP_TS_MASK) == UIP_CLOSED) {
+      continue;
+    }
+    row = snprintf(buf + len, uip_mss() - len,
 		 "<tr><td>%d</td><td>%u.%u.%u.%u:%u</td><td>%s</td><td>%u</td><td>%u</td><td>%c %c</td></tr>\r\n",
 		 htons(conn->lport),
 		 htons(conn->ripaddr[0]) >> 8,
@@ -158,6 +170,13 @@ generate_tcp_stats(void *arg)
 		 conn->timer,
 		 (uip_outstanding(conn))? '*':' ',
 		 (uip_stopped(conn))? '!':' ');
+    if(row >= uip_mss() - len) {
+      break;
+    }
+    len += row;
+  }
+  s->len = i;
+  return (unsigned short)len;
 }
 /*---------------------------------------------------------------------------*/
 static
@@ -166,10 +185,12 @@ PT_THREAD(tcp_stats(struct httpd_state *s, char *ptr))
   
   PSOCK_BEGIN(&s->sout);
 
-  for(s->count = 0; s->count < UIP_CONNS; ++s->count) {
-    if((uip_conns[s->count].tcpstateflags & UIP_TS_MASK) != UIP_CLOSED) {
-      PSOCK_GENERATOR_SEND(&s->sout, generate_tcp_stats, s);
+  for(s->count = 0; s->count < UIP_CONNS; s->count = s->len) {
+    if((uip_conns[s->count].tcpstateflags & UIP_TS_MASK) == UIP_CLOSED) {
+      s->len = s->count + 1;
+      continue;
     }
+    PSOCK_GENERATOR_SEND(&s->sout, generate_tcp_stats, s);
   }
 
   PSOCK_END(&s->sout);
@@ -179,8 +200,21 @@ static unsigned short
 generate_net_stats(void *arg)
 {
   struct httpd_state *s = (struct httpd_state *)arg;
-  return snprintf((char *)uip_appdata, UIP_APPDATA_SIZE,
-		  "%5u\n", ((uip_stats_t *)&uip_stat)[s->count]);
+  char *buf = (char *)uip_appdata;
+  int len, row;
+  unsigned short i;
+
+  len = 0;
+  for(i = s->count; i < sizeof(uip_stat) / sizeof(uip_stats_t); ++i) {
+    row = snprintf(buf + len, uip_mss() - len,
+		   "%5u\n", ((uip_stats_t *)&uip_stat)[i]);
+    if(row >= uip_mss() - len) {
+      break;
+    }
+    len += row;
+  }
+  s->len = i;
+  return (unsigned short)len;
 }
 
 static
@@ -191,7 +225,7 @@ PT_THREAD(net_stats(struct httpd_state *s, char *ptr))
 #if UIP_STATISTICS
 
   for(s->count = 0; s->count < sizeof(uip_stat) / sizeof(uip_stats_t);
-      ++s->count) {
+      s->count = s->len) {
     PSOCK_GENERATOR_SEND(&s->sout, generate_net_stats, s);
   }
   
@@ -37,6 +37,8 @@
 #include "httpd-fs.h"
 #include "httpd-fsdata.h"
 
+#include <string.h>
+
 #ifndef NULL
 #define NULL 0
 #endif /* NULL */
@@ -49,53 +51,97 @@ static u16_t count[HTTPD_FS_NUMFILES];
 
 /*-----------------------------------------------------------------------------------*/
 static u8_t
-httpd_fs_strcmp(const char *str1, const char *str2)
+httpd_fs_endofname(char c)
 {
-  u8_t i;
-  i = 0;
- loop:
+  return c == 0 || c == ' ' || c == '?' || c == '\r' || c == '\n';
+}
+/*-----------------------------------------------------------------------------------*/
+/* Index of the file called name, or -1. The hash (FNV-1a from the seed
+   makefsdata chose) leads to the only file that may have that name. */
+static int
+httpd_fs_find(const char *name)
+{
+  const char *p;
+  unsigned long h;
+  u8_t slot;
+  const struct httpd_fsdata_file *f;
 
-  if(str2[i] == 0 ||
-     str1[i] == '\r' ||
-     str1[i] == '\n') {
-    return 0;
+  h = 2166136261UL ^ HTTPD_FS_HASH_SEED;
+  for(p = name; !httpd_fs_endofname(*p); ++p) {
+    h = ((h ^ (u8_t)*p) * 16777619UL) & 0xffffffffUL;
   }
 
-  if(str1[i] != str2[i]) {
-    return 1;
+  slot = httpd_fsdata_hash[h & (HTTPD_FS_HASH_SIZE - 1)];
+  if(slot == 0) {
+    return -1;
   }
-
-
-  ++i;
-  goto loop;
+  f = &httpd_fsdata_files[slot - 1];
+  if(strncmp(name, f->name, p - name) != 0 || f->name[p - name] != 0) {
+    return -1;
+  }
+  return slot - 1;
 }
 /*-----------------------------------------------------------------------------------*/
-int
-httpd_fs_open(const char *name, struct httpd_fs_file *file)
+static int
+httpd_fs_fill(const char *name, struct httpd_fs_file *file, u8_t gzip)
 {
-#if HTTPD_FS_STATISTICS
-  u16_t i = 0;
-#endif /* HTTPD_FS_STATISTICS */
-  struct httpd_fsdata_file_noconst *f;
+  int i;
+  const struct httpd_fsdata_file *f;
 
-  for(f = (struct httpd_fsdata_file_noconst *)HTTPD_FS_ROOT;
-      f != NULL;
-      f = (struct httpd_fsdata_file_noconst *)f->next) {
+  i = httpd_fs_find(name);
+  if(i < 0) {
+    return 0;
+  }
+  f = &httpd_fsdata_files[i];
 
-    if(httpd_fs_strcmp(name, f->name) == 0) {
-      file->data = f->data;
-      file->len = f->len;
-#if HTTPD_FS_STATISTICS
-      ++count[i];
-#endif /* HTTPD_FS_STATISTICS */
-      return 1;
-    }
+  file->etag = f->etag;
+  file->flags = (f->data != NULL && f->gzdata != NULL) ? HTTPD_FS_VARY : 0;
+  if(f->gzdata != NULL && (gzip || f->data == NULL)) {
+    file->data = (char *)f->gzdata;
+    file->len = f->gzlen;
+    file->flags |= HTTPD_FS_GZIP;
+  } else {
+    file->data = (char *)f->data;
+    file->len = f->len;
+  }
 #if HTTPD_FS_STATISTICS
-    ++i;
+  ++count[i];
 #endif /* HTTPD_FS_STATISTICS */
-
+  return 1;
+}
+/*-----------------------------------------------------------------------------------*/
+int
+httpd_fs_open(const char *name, struct httpd_fs_file *file)
+{
+  return httpd_fs_fill(name, file, 0);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+httpd_fs_open_gzip(const char *name, struct httpd_fs_file *file)
+{
+  return httpd_fs_fill(name, file, 1);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+httpd_fs_open_index(u8_t i, struct httpd_fs_file *file)
+{
+  if(i >= HTTPD_FS_NUMFILES || httpd_fsdata_files[i].data == NULL) {
+    return 0;
   }
-  return 0;
+  file->data = (char *)httpd_fsdata_files[i].data;
+  file->len = httpd_fsdata_files[i].len;
+  file->etag = httpd_fsdata_files[i].etag;
+  file->flags = 0;
+  return 1;
+}
+/*-----------------------------------------------------------------------------------*/
+const char *
+httpd_fs_etag(const char *name)
+{
+  int i;
+
+  i = httpd_fs_find(name);
+  return (i < 0) ? NULL : httpd_fsdata_files[i].etag;
 }
 /*-----------------------------------------------------------------------------------*/
 void
@@ -113,20 +159,10 @@ httpd_fs_init(void)
 u16_t httpd_fs_count
 (char *name)
 {
-  struct httpd_fsdata_file_noconst *f;
-  u16_t i;
+  int i;
 
-  i = 0;
-  for(f = (struct httpd_fsdata_file_noconst *)HTTPD_FS_ROOT;
-      f != NULL;
-      f = (struct httpd_fsdata_file_noconst *)f->next) {
-
-    if(httpd_fs_strcmp(name, f->name) == 0) {
-      return count[i];
-    }
-    ++i;
-  }
-  return 0;
+  i = httpd_fs_find(name);
+  return (i < 0) ? 0 : count[i];
 }
 #endif /* HTTPD_FS_STATISTICS */
 /*-----------------------------------------------------------------------------------*/
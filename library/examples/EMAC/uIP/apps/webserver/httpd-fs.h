@@ -40,12 +40,30 @@
 struct httpd_fs_file {
   char *data;
   int len;
+  const char *etag;
+  u8_t flags;
 };
 
+#define HTTPD_FS_GZIP 1 /* data is gzip compressed */
+#define HTTPD_FS_VARY 2 /* the file is stored both raw and compressed */
+
 /* file must be allocated by caller and will be filled in
-   by the function. */
+   by the function. name ends at a 0, space, '?', CR or LF. The raw
+   copy is returned unless the image only has the gzip one. */
 int httpd_fs_open(const char *name, struct httpd_fs_file *file);
 
+/* Same, but the gzip copy is returned when there is one. */
+int httpd_fs_open_gzip(const char *name, struct httpd_fs_file *file);
+
+/* Raw copy of the file at index i of the image, as named by the
+   HTTPD_FS_OP_INCLUDE opcodes of a .shtml. Not counted by
+   httpd_fs_count(). */
+int httpd_fs_open_index(u8_t i, struct httpd_fs_file *file);
+
+/* The quoted ETag of a file, NULL if it has none or does not exist.
+   Not counted by httpd_fs_count(). */
+const char *httpd_fs_etag(const char *name);
+
 #ifdef HTTPD_FS_STATISTICS
 #if HTTPD_FS_STATISTICS == 1
 u16_t httpd_fs_count(char *name);
@@ -37,28 +37,20 @@
 
 #include "uip.h"
 
+/* One file of the image built by makefsdata. The files are sorted by
+   name and found through the perfect hash in httpd-fsdata.c. */
 struct httpd_fsdata_file {
-  const struct httpd_fsdata_file *next;
   const char *name;
-  const char *data;
+  const char *data;   /* NULL when only the gzip copy was kept */
   const int len;
-#ifdef HTTPD_FS_STATISTICS
-#if HTTPD_FS_STATISTICS == 1
-  u16_t count;
-#endif /* HTTPD_FS_STATISTICS */
-#endif /* HTTPD_FS_STATISTICS */
+  const char *gzdata; /* NULL when gzip does not make the file smaller */
+  const int gzlen;
+  const char *etag;   /* quoted; NULL for .shtml, whose output changes */
 };
 
-struct httpd_fsdata_file_noconst {
-  struct httpd_fsdata_file *next;
-  char *name;
-  char *data;
-  int len;
-#ifdef HTTPD_FS_STATISTICS
-#if HTTPD_FS_STATISTICS == 1
-  u16_t count;
-#endif /* HTTPD_FS_STATISTICS */
-#endif /* HTTPD_FS_STATISTICS */
-};
+/* .shtml files are stored as a stream of these, see makefsdata */
+#define HTTPD_FS_OP_TEXT    1 /* u16 length (MSB first), then the text */
+#define HTTPD_FS_OP_INCLUDE 2 /* u8 index of the file to copy in */
+#define HTTPD_FS_OP_CGI     3 /* 0 terminated "name args" for httpd_cgi() */
 
 #endif /* __HTTPD_FSDATA_H__ */
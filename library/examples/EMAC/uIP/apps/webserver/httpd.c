@@ -59,8 +59,10 @@
  */
 
 #include "uip.h"
+#include "clock.h"
 #include "httpd.h"
 #include "httpd-fs.h"
+#include "httpd-fsdata.h"
 #include "httpd-cgi.h"
 #include "http-strings.h"
 
@@ -69,13 +71,15 @@
 #define STATE_WAITING 0
 #define STATE_OUTPUT  1
 
+/* Idle connections are aborted after this long, as after 20 polls of
+   uip_periodic() every 0.5 s */
+#define HTTPD_IDLE_TIMEOUT (CLOCK_SECOND * 10)
+
 #define ISO_nl      0x0a
+#define ISO_cr      0x0d
 #define ISO_space   0x20
-#define ISO_bang    0x21
-#define ISO_percent 0x25
 #define ISO_period  0x2e
 #define ISO_slash   0x2f
-#define ISO_colon   0x3a
 
 
 /*---------------------------------------------------------------------------*/
@@ -108,114 +112,189 @@ PT_THREAD(send_file(struct httpd_state *s))
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
-static
-PT_THREAD(send_part_of_file(struct httpd_state *s))
+/* Copies the text of the script from its current position into buf,
+   at most len bytes: the rest of the current span (s->file), then the
+   spans of the TEXT and INCLUDE opcodes that follow, up to a CGI call or
+   the end. With buf == NULL the position moves past those bytes instead,
+   once they have been acknowledged, and past any empty span after them. */
+static int
+script_text(struct httpd_state *s, char *buf, int len)
 {
-  PSOCK_BEGIN(&s->sout);
+  struct httpd_fs_file span;
+  char *op;
+  int oplen;
+  int n, chunk;
 
-  PSOCK_SEND(&s->sout, s->file.data, s->len);
+  span = s->file;
+  op = s->scriptptr;
+  oplen = s->scriptlen;
+  n = 0;
 
-  PSOCK_END(&s->sout);
+  while(1) {
+    if(span.len == 0) {
+      if(oplen == 0 || *op == HTTPD_FS_OP_CGI) {
+	break;
+      }
+      if(*op == HTTPD_FS_OP_TEXT) {
+	span.data = op + 3;
+	span.len = ((u8_t)op[1] << 8) | (u8_t)op[2];
+	op += 3 + span.len;
+	oplen -= 3 + span.len;
+      } else {
+	if(!httpd_fs_open_index((u8_t)op[1], &span)) {
+	  span.len = 0;
+	}
+	op += 2;
+	oplen -= 2;
+      }
+      continue;
+    }
+    if(n == len) {
+      break;
+    }
+    chunk = (span.len < len - n) ? span.len : len - n;
+    if(buf != NULL) {
+      memcpy(buf + n, span.data, chunk);
+    }
+    span.data += chunk;
+    span.len -= chunk;
+    n += chunk;
+  }
+
+  if(buf == NULL) {
+    s->file = span;
+    s->scriptptr = op;
+    s->scriptlen = oplen;
+  }
+  return n;
 }
 /*---------------------------------------------------------------------------*/
-static void
-next_scriptstate(struct httpd_state *s)
+static unsigned short
+generate_script_text(void *state)
 {
-  char *p;
-  p = strchr(s->scriptptr, ISO_nl) + 1;
-  s->scriptlen -= (unsigned short)(p - s->scriptptr);
-  s->scriptptr = p;
+  struct httpd_state *s = (struct httpd_state *)state;
+
+  s->len = script_text(s, (char *)uip_appdata, uip_mss());
+  return s->len;
 }
 /*---------------------------------------------------------------------------*/
 static
-PT_THREAD(handle_script(struct httpd_state *s))
+PT_THREAD(send_script_text(struct httpd_state *s))
 {
-  char *ptr;
-
-  PT_BEGIN(&s->scriptpt);
+  PSOCK_BEGIN(&s->sout);
 
+  PSOCK_GENERATOR_SEND(&s->sout, generate_script_text, s);
+  script_text(s, NULL, s->len);
 
-  while(s->file.len > 0) {
+  PSOCK_END(&s->sout);
+}
+/*---------------------------------------------------------------------------*/
+/* Runs a .shtml compiled by makefsdata: s->scriptptr walks the opcodes,
+   s->file is what is left of the text being sent. Text and included
+   files are packed into full segments; CGI calls send their own. */
+static
+PT_THREAD(handle_script(struct httpd_state *s))
+{
+  PT_BEGIN(&s->scriptpt);
 
-    /* Check if we should start executing a script. */
-    if(*s->file.data == ISO_percent &&
-       *(s->file.data + 1) == ISO_bang) {
-      s->scriptptr = s->file.data + 3;
-      s->scriptlen = s->file.len - 3;
-      if(*(s->scriptptr - 1) == ISO_colon) {
-	httpd_fs_open(s->scriptptr + 1, &s->file);
-	PT_WAIT_THREAD(&s->scriptpt, send_file(s));
-      } else {
-	PT_WAIT_THREAD(&s->scriptpt,
-		       httpd_cgi(s->scriptptr)(s, s->scriptptr));
-      }
-      next_scriptstate(s);
+  s->scriptptr = s->file.data;
+  s->scriptlen = s->file.len;
+  s->file.len = 0;
 
-      /* The script is over, so we reset the pointers and continue
-	 sending the rest of the file. */
-      s->file.data = s->scriptptr;
-      s->file.len = s->scriptlen;
+  while(1) {
+    script_text(s, NULL, 0);
+    if(s->file.len > 0) {
+      PT_WAIT_THREAD(&s->scriptpt, send_script_text(s));
+    } else if(s->scriptlen > 0) {
+      PT_WAIT_THREAD(&s->scriptpt,
+		     httpd_cgi(s->scriptptr + 1)(s, s->scriptptr + 1));
+      s->len = strlen(s->scriptptr + 1) + 2;
+      s->scriptptr += s->len;
+      s->scriptlen -= s->len;
     } else {
-      /* See if we find the start of script marker in the block of HTML
-	 to be sent. */
-
-      if(s->file.len > uip_mss()) {
-	s->len = uip_mss();
-      } else {
-	s->len = s->file.len;
-      }
-
-      if(*s->file.data == ISO_percent) {
-	ptr = strchr(s->file.data + 1, ISO_percent);
-      } else {
-	ptr = strchr(s->file.data, ISO_percent);
-      }
-      if(ptr != NULL &&
-	 ptr != s->file.data) {
-	s->len = (int)(ptr - s->file.data);
-	if(s->len >= uip_mss()) {
-	  s->len = uip_mss();
-	}
-      }
-      PT_WAIT_THREAD(&s->scriptpt, send_part_of_file(s));
-      s->file.data += s->len;
-      s->file.len -= s->len;
-
+      break;
     }
   }
 
   PT_END(&s->scriptpt);
 }
 /*---------------------------------------------------------------------------*/
-static
-PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
+static char *
+append(char *dst, const char *src)
+{
+  while(*src != 0) {
+    *dst++ = *src++;
+  }
+  return dst;
+}
+/*---------------------------------------------------------------------------*/
+static unsigned short
+generate_headers(void *state)
 {
+  struct httpd_state *s = (struct httpd_state *)state;
+  char *p = (char *)uip_appdata;
   char *ptr;
 
-  PSOCK_BEGIN(&s->sout);
+  p = append(p, s->statushdr);
+  if(s->file.flags & HTTPD_FS_GZIP) {
+    p = append(p, http_content_encoding_gzip);
+  }
+  if(s->file.flags & HTTPD_FS_VARY) {
+    p = append(p, http_vary);
+  }
+  if(s->file.etag != NULL && s->statushdr != http_header_404) {
+    p = append(p, (s->file.flags & HTTPD_FS_GZIP) ? http_etag_weak : http_etag);
+    p = append(p, s->file.etag);
+    p = append(p, http_crnl);
+  }
 
-  PSOCK_SEND_STR(&s->sout, statushdr);
+  if(s->statushdr == http_header_304) {
+    p = append(p, http_crnl);
+    return (unsigned short)(p - (char *)uip_appdata);
+  }
 
   ptr = strrchr(s->filename, ISO_period);
   if(ptr == NULL) {
-    PSOCK_SEND_STR(&s->sout, http_content_type_binary);
+    p = append(p, http_content_type_binary);
   } else if(strncmp(http_html, ptr, 5) == 0 ||
 	    strncmp(http_shtml, ptr, 6) == 0) {
-    PSOCK_SEND_STR(&s->sout, http_content_type_html);
+    p = append(p, http_content_type_html);
   } else if(strncmp(http_css, ptr, 4) == 0) {
-    PSOCK_SEND_STR(&s->sout, http_content_type_css);
+    p = append(p, http_content_type_css);
   } else if(strncmp(http_png, ptr, 4) == 0) {
-    PSOCK_SEND_STR(&s->sout, http_content_type_png);
+    p = append(p, http_content_type_png);
   } else if(strncmp(http_gif, ptr, 4) == 0) {
-    PSOCK_SEND_STR(&s->sout, http_content_type_gif);
+    p = append(p, http_content_type_gif);
   } else if(strncmp(http_jpg, ptr, 4) == 0) {
-    PSOCK_SEND_STR(&s->sout, http_content_type_jpg);
+    p = append(p, http_content_type_jpg);
   } else {
-    PSOCK_SEND_STR(&s->sout, http_content_type_plain);
+    p = append(p, http_content_type_plain);
   }
+  return (unsigned short)(p - (char *)uip_appdata);
+}
+/*---------------------------------------------------------------------------*/
+/* The whole header block goes out as a single segment. */
+static
+PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
+{
+  s->statushdr = statushdr;
+
+  PSOCK_BEGIN(&s->sout);
+
+  PSOCK_GENERATOR_SEND(&s->sout, generate_headers, s);
+
   PSOCK_END(&s->sout);
 }
 /*---------------------------------------------------------------------------*/
+static int
+open_file(struct httpd_state *s, const char *name)
+{
+  if(s->flags & HTTPD_GZIP_OK) {
+    return httpd_fs_open_gzip(name, &s->file);
+  }
+  return httpd_fs_open(name, &s->file);
+}
+/*---------------------------------------------------------------------------*/
 static
 PT_THREAD(handle_output(struct httpd_state *s))
 {
@@ -223,14 +302,18 @@ PT_THREAD(handle_output(struct httpd_state *s))
 
   PT_BEGIN(&s->outputpt);
 
-  if(!httpd_fs_open(s->filename, &s->file)) {
-    httpd_fs_open(http_404_html, &s->file);
+  if(!open_file(s, s->filename)) {
+    open_file(s, http_404_html);
     strcpy(s->filename, http_404_html);
     PT_WAIT_THREAD(&s->outputpt,
 		   send_headers(s,
 		   http_header_404));
     PT_WAIT_THREAD(&s->outputpt,
 		   send_file(s));
+  } else if(s->flags & HTTPD_NOT_MODIFIED) {
+    PT_WAIT_THREAD(&s->outputpt,
+		   send_headers(s,
+		   http_header_304));
   } else {
     PT_WAIT_THREAD(&s->outputpt,
 		   send_headers(s,
@@ -251,6 +334,8 @@ PT_THREAD(handle_output(struct httpd_state *s))
 static
 PT_THREAD(handle_input(struct httpd_state *s))
 {
+  const char *etag;
+
   PSOCK_BEGIN(&s->sin);
 
   PSOCK_READTO(&s->sin, ISO_space);
@@ -274,14 +359,27 @@ PT_THREAD(handle_input(struct httpd_state *s))
 
   /*  httpd_log_file(uip_conn->ripaddr, s->filename);*/
 
-  s->state = STATE_OUTPUT;
-
+  /* The answer depends on the headers, so it starts after the empty
+     line. Lines longer than inputbuf are cut short by PSOCK_READTO(). */
   while(1) {
     PSOCK_READTO(&s->sin, ISO_nl);
+    s->inputbuf[PSOCK_DATALEN(&s->sin)] = 0;
 
     if(strncmp(s->inputbuf, http_referer, 8) == 0) {
       s->inputbuf[PSOCK_DATALEN(&s->sin) - 2] = 0;
       /*      httpd_log(&s->inputbuf[9]);*/
+    } else if(strncmp(s->inputbuf, http_accept_encoding, 16) == 0) {
+      if(strstr(&s->inputbuf[16], http_gzip) != NULL) {
+	s->flags |= HTTPD_GZIP_OK;
+      }
+    } else if(strncmp(s->inputbuf, http_if_none_match, 14) == 0) {
+      /* The ETag is quoted, so a W/ prefix or a list still match */
+      etag = httpd_fs_etag(s->filename);
+      if(etag != NULL && strstr(&s->inputbuf[14], etag) != NULL) {
+	s->flags |= HTTPD_NOT_MODIFIED;
+      }
+    } else if(s->inputbuf[0] == ISO_cr || s->inputbuf[0] == ISO_nl) {
+      s->state = STATE_OUTPUT;
     }
   }
 
@@ -308,10 +406,27 @@ httpd_appcall(void)
     PSOCK_INIT(&s->sout, s->inputbuf, sizeof(s->inputbuf) - 1);
     PT_INIT(&s->outputpt);
     s->state = STATE_WAITING;
+    s->flags = 0;
     /*    timer_set(&s->timer, CLOCK_SECOND * 100);*/
     s->timer = 0;
+#ifdef uip_poll_request
+    s->idle = clock_time();
+    uip_poll_request(HTTPD_IDLE_TIMEOUT);
+#endif /* uip_poll_request */
     handle_connection(s);
   } else if(s != NULL) {
+#ifdef uip_poll_request
+    /* Polled by the driver to fill the send window, or by the request
+       below once the connection has been idle for HTTPD_IDLE_TIMEOUT */
+    if(uip_poll()) {
+      if(clock_time() - s->idle >= HTTPD_IDLE_TIMEOUT) {
+	uip_abort();
+      }
+    } else {
+      s->idle = clock_time();
+      uip_poll_request(HTTPD_IDLE_TIMEOUT);
+    }
+#else /* uip_poll_request */
     if(uip_poll()) {
       ++s->timer;
       if(s->timer >= 20) {
@@ -320,6 +435,7 @@ httpd_appcall(void)
     } else {
       s->timer = 0;
     }
+#endif /* uip_poll_request */
     handle_connection(s);
   } else {
     uip_abort();
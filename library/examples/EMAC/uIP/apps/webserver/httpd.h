@@ -36,10 +36,14 @@
 #define __HTTPD_H__
 
 #include "psock.h"
+#include "clock.h"
 #include "httpd-fs.h"
 
 struct httpd_state {
   unsigned char timer;
+#ifdef UIP_CONF_POLL_REQUEST
+  clock_time_t idle;            /* Last event, see uip_poll_request() */
+#endif /* UIP_CONF_POLL_REQUEST */
   struct psock sin, sout;
   struct pt outputpt, scriptpt;
   char inputbuf[50];
@@ -49,10 +53,16 @@ struct httpd_state {
   int len;
   char *scriptptr;
   int scriptlen;
+  const char *statushdr;
+  u8_t flags;
   
   unsigned short count;
 };
 
+/* httpd_state flags, from the request headers */
+#define HTTPD_GZIP_OK      1 /* Accept-Encoding lists gzip */
+#define HTTPD_NOT_MODIFIED 2 /* If-None-Match has the file's ETag */
+
 void httpd_init(void);
 void httpd_appcall(void);
 
@@ -0,0 +1,69 @@
+#include "chksum-arch.h"
+
+/* The core is little endian: summing the bytes as they lie in memory gives
+ * the network order sum with its two bytes swapped (RFC1071), unless data
+ * starts at an odd address, which puts every byte back in its lane.
+ * Halfwords are added into 32 bits and the carries folded once at the end:
+ * 64kB of data cannot overflow the accumulator. */
+uint16_t chksum_arch(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+	const uint32_t *wp;
+	uint32_t acc, w0, w1, w2, w3;
+	uint32_t swap;
+
+	if (len == 0) {
+		return sum;
+	}
+
+	acc = 0;
+	swap = 1;
+	if ((uint32_t)data & 1) {
+		/* High byte of the first word, then the rest is in lane */
+		acc = (uint32_t)*data++ << 8;
+		len--;
+		swap = 0;
+	}
+	if (((uint32_t)data & 2) && (len >= 2)) {
+		acc += *(const uint16_t *)data;
+		data += 2;
+		len -= 2;
+	}
+
+	wp = (const uint32_t *)data;
+	while (len >= 16) {
+		w0 = wp[0];
+		w1 = wp[1];
+		w2 = wp[2];
+		w3 = wp[3];
+		acc += (w0 & 0xFFFF) + (w0 >> 16) + (w1 & 0xFFFF) + (w1 >> 16)
+			+ (w2 & 0xFFFF) + (w2 >> 16) + (w3 & 0xFFFF) + (w3 >> 16);
+		wp += 4;
+		len -= 16;
+	}
+	while (len >= 4) {
+		w0 = *wp++;
+		acc += (w0 & 0xFFFF) + (w0 >> 16);
+		len -= 4;
+	}
+	data = (const uint8_t *)wp;
+	if (len >= 2) {
+		acc += *(const uint16_t *)data;
+		data += 2;
+		len -= 2;
+	}
+	if (len) {
+		/* Odd byte at the end, low byte in memory order */
+		acc += *data;
+	}
+
+	while (acc >> 16) {
+		acc = (acc & 0xFFFF) + (acc >> 16);
+	}
+	if (swap) {
+		acc = ((acc & 0xFF) << 8) | (acc >> 8);
+	}
+	acc += sum;
+	acc = (acc & 0xFFFF) + (acc >> 16);
+
+	return (uint16_t)acc;
+}
@@ -0,0 +1,10 @@
+#ifndef __CHKSUM_ARCH_H__
+#define __CHKSUM_ARCH_H__
+
+#include "lpc_types.h"
+
+/* One's complement sum of len bytes as big endian 16-bit words, added to
+ * sum. Same result as chksum() in uip.c, any alignment of data. */
+uint16_t chksum_arch(uint16_t sum, const uint8_t *data, uint16_t len);
+
+#endif /* __CHKSUM_ARCH_H__ */
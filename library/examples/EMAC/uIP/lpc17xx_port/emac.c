@@ -163,6 +163,33 @@ BOOL_8 tapdev_send(void *pPacket, UNS_32 size)
 	return(TRUE);
 }
 
+/* transmit an Ethernet frame made of a header, copied into the Tx buffer,
+ * and data the EMAC reads from where it is: word-aligned, in AHB SRAM and
+ * left unchanged until the frame is sent */
+BOOL_8 tapdev_send2(const void *pHeader, UNS_32 hlen, const void *pData, UNS_32 dlen)
+{
+	uint32_t *p;
+
+	if ((pData == NULL) || (dlen == 0)) {
+		return tapdev_send((void *)pHeader, hlen);
+	}
+
+	// The header fragment must be a multiple of 4 bytes
+	if ((hlen == 0) || (hlen & 3) || (hlen > EMAC_FRAG_SIZE) || ((uint32_t)pData & 3)
+			|| (hlen + dlen > EMAC_MAX_PACKET_SIZE)) {
+		return (FALSE);
+	}
+
+	p = EMAC_BorrowTxBuffer();
+	if (p == NULL) {
+		return (FALSE);
+	}
+	memcpy(p, pHeader, hlen);
+	EMAC_ReturnTxBuffer(hlen, FALSE);
+
+	return (EMAC_ReferTxBuffer((const uint32_t *)pData, dlen, TRUE) == SUCCESS) ? TRUE : FALSE;
+}
+
 /*
  * @}
  */
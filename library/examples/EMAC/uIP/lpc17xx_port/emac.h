@@ -45,5 +45,6 @@
 BOOL_8 tapdev_init(void);
 UNS_32 tapdev_read(void * pPacket);
 BOOL_8 tapdev_send (void *pPacket, UNS_32 size);
+BOOL_8 tapdev_send2(const void *pHeader, UNS_32 hlen, const void *pData, UNS_32 dlen);
 
 #endif
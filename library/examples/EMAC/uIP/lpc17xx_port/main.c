@@ -3,7 +3,7 @@
 
 #include "debug_frmwrk.h"
 #include "clock-arch.h"
-#include "timer.h"
+#include "ptsched.h"
 #include "uip-conf.h"
 #include "uipopt.h"
 #include "uip_arp.h"
@@ -13,6 +13,8 @@
 #include "lpc17xx_libcfg.h"
 #include "lpc17xx_pinsel.h"
 #include "lpc17xx_gpio.h"
+#include "lpc17xx_adc.h"
+#include "lpc17xx_gpdma.h"
 
 
 #define BUF ((struct uip_eth_hdr *)&uip_buf[0])
@@ -27,6 +29,201 @@
 #define DB	_DBG((uint8_t *)_db)
 char _db[64];
 
+#if UIP_UDP
+/* Telemetry: AD0.2 (P0.25, the potentiometer of the MCB1700) converted
+ * in burst mode and copied by the GPDMA into the two halves of adc_buf,
+ * one datagram per half to the router address, port TELEMETRY_PORT.
+ * The datagram is sent from adc_buf itself, so it is in AHB SRAM where
+ * the EMAC can read it: bank 0, next to the uIP send buffers, as bank 1
+ * is budgeted for the EMAC rings (EMAC_RAM_USED). The EMAC sends it long
+ * before the GPDMA comes back to the same half. */
+#define ADC_RATE		100000
+#define ADC_BLOCK		128		// ADGDR words per datagram
+#define TELEMETRY_PORT	5000
+
+#if defined(__GNUC__)
+static uint32_t adc_buf[2][ADC_BLOCK] __attribute__ ((section (".ahbram0")));
+#else
+static uint32_t adc_buf[2][ADC_BLOCK];
+#endif
+static GPDMA_LLI_Type adc_lli[2];
+/* Half being filled, halves full and not sent yet, halves overwritten
+ * before they were sent */
+static __IO uint32_t adc_cur, adc_ready, adc_lost;
+
+/* Half adc_cur is full, the GPDMA goes on with the other one */
+static void adc_dma_cbs(uint32_t ChannelNum, uint32_t Event, void *pArg)
+{
+	if (Event & GPDMA_EVT_TC) {
+		if (adc_ready & (1 << adc_cur)) {
+			adc_lost++;
+		}
+		adc_ready |= 1 << adc_cur;
+		adc_cur ^= 1;
+	}
+}
+
+void DMA_IRQHandler(void)
+{
+	GPDMA_IntHandler();
+}
+
+static void ADC_DMA_Init(void)
+{
+	PINSEL_CFG_Type PinCfg;
+	GPDMA_SEG_Type seg[2];
+	GPDMA_LLI_CFG_Type LLICfg;
+	int32_t ch;
+
+	PinCfg.Funcnum = 1;
+	PinCfg.OpenDrain = 0;
+	PinCfg.Pinmode = 0;
+	PinCfg.Portnum = 0;
+	PinCfg.Pinnum = 25;
+	PINSEL_ConfigPin(&PinCfg);
+
+	ADC_Init(LPC_ADC, ADC_RATE);
+	ADC_ChannelCmd(LPC_ADC, ADC_CHANNEL_2, ENABLE);
+	// The conversion done flag is the GPDMA request, the ADC IRQ stays off
+	ADC_IntConfig(LPC_ADC, ADC_ADINTEN2, SET);
+
+	GPDMA_Init();
+	ch = GPDMA_ChannelAlloc(GPDMA_CHPRIO_HIGH, adc_dma_cbs, NULL);
+	if (ch < 0) {
+		_DBG_("No GPDMA channel for the ADC");
+		return;
+	}
+
+	/* Circular chain half 0 -> half 1 -> half 0, one interrupt per half */
+	seg[0].SrcAddr = 0;
+	seg[0].DstAddr = (uint32_t)adc_buf[0];
+	seg[0].Count = ADC_BLOCK;
+	seg[1].SrcAddr = 0;
+	seg[1].DstAddr = (uint32_t)adc_buf[1];
+	seg[1].Count = ADC_BLOCK;
+	LLICfg.TransferType = GPDMA_TRANSFERTYPE_P2M;
+	LLICfg.TransferWidth = GPDMA_WIDTH_WORD;
+	LLICfg.SrcConn = GPDMA_CONN_ADC;
+	LLICfg.DstConn = 0;
+	LLICfg.pSeg = seg;
+	LLICfg.NumSeg = 2;
+	LLICfg.Options = GPDMA_LLI_OPT_CIRCULAR | GPDMA_LLI_OPT_INT_SEG;
+	if ((GPDMA_LLIBuild(adc_lli, 2, &LLICfg) != 2)
+			|| (GPDMA_SetupLLI(ch, &LLICfg, adc_lli) == ERROR)) {
+		_DBG_("GPDMA setup for the ADC failed");
+		GPDMA_ChannelFree(ch);
+		return;
+	}
+	NVIC_EnableIRQ(DMA_IRQn);
+	GPDMA_ChannelCmd(ch, ENABLE);
+	ADC_BurstCmd(LPC_ADC, ENABLE);
+}
+
+/* Frames of the telemetry application, see apps/telemetry */
+int telemetry_output(const void *hdr, u16_t hlen, const void *data, u16_t dlen)
+{
+	return tapdev_send2(hdr, hlen, data, dlen);
+}
+#endif /* UIP_UDP */
+
+/* A frame has come in: tapdev_read() takes it from the main loop, the
+ * interrupt only ends the __WFI() there */
+void ENET_IRQHandler(void)
+{
+	EMAC_IntGetStatus(EMAC_INT_RX_DONE);
+}
+
+/* uIP timers, as scheduler tasks. Each TCP connection has a task, posted
+ * by the main loop when a segment for it comes in, and two timers, armed
+ * only while the connection needs them: conn_timer for uip_periodic()
+ * every 0.5 s while it has data in flight or waits in TIME_WAIT or
+ * FIN_WAIT_2, poll_timer for the poll its application asks for with
+ * uip_poll_request(). An idle connection has neither and costs nothing
+ * until its next segment. uip_arp_timer() runs every 10 s.
+ *
+ * UDP connections have no timer: the telemetry datagrams are sent as
+ * soon as their data is ready, uip_udp_periodic() has nothing to do. */
+static struct ptsched_task conn_task[UIP_CONNS], arp_task;
+static struct ptsched_timer conn_timer[UIP_CONNS], poll_timer[UIP_CONNS];
+static struct ptsched_timer arp_timer;
+static unsigned char conn_armed[UIP_CONNS], poll_armed[UIP_CONNS];
+
+/* Called by the application of uip_conn, see UIP_CONF_POLL_REQUEST */
+void uip_port_poll_request(struct uip_conn *conn, clock_time_t ticks)
+{
+	UNS_32 i = conn - uip_conns;
+
+	ptsched_timer_set(&poll_timer[i], &conn_task[i], ticks);
+	poll_armed[i] = 1;
+}
+
+/* Runs to the end each time it is posted: by the main loop after a
+ * segment for the connection, or by one of its timers */
+static PT_THREAD(conn_thread(struct ptsched_task *t))
+{
+	UNS_32 i = t - conn_task;
+	struct uip_conn *conn = &uip_conns[i];
+
+	PT_BEGIN(&t->pt);
+	if (conn_armed[i] && ptsched_timer_expired(&conn_timer[i])) {
+		conn_armed[i] = 0;
+		if (uip_conn_active(i)) {
+			uip_periodic(i);
+			/* If the above function invocation resulted in data that
+			   should be sent out on the network, the global variable
+			   uip_len is set to a value > 0. */
+			if (uip_len > 0) {
+				uip_arp_out();
+				tapdev_send(uip_buf,uip_len);
+			}
+		}
+	}
+	if (poll_armed[i] && ptsched_timer_expired(&poll_timer[i])) {
+		poll_armed[i] = 0;
+		if (uip_conn_active(i)) {
+			uip_poll_conn(conn);
+			while (uip_len > 0) {
+				uip_arp_out();
+				tapdev_send(uip_buf,uip_len);
+				if (!uip_window_open(conn)) {
+					break;
+				}
+				uip_poll_conn(conn);
+			}
+		}
+	}
+
+	/* Retransmissions and the TIME_WAIT timeout need uip_periodic() */
+	if (uip_conn_active(i) && (uip_outstanding(conn)
+			|| conn->tcpstateflags == UIP_TIME_WAIT
+			|| conn->tcpstateflags == UIP_FIN_WAIT_2)) {
+		if (!conn_armed[i]) {
+			ptsched_timer_set(&conn_timer[i], t, CLOCK_SECOND / 2);
+			conn_armed[i] = 1;
+		}
+	} else if (conn_armed[i]) {
+		ptsched_timer_stop(&conn_timer[i]);
+		conn_armed[i] = 0;
+	}
+	if (!uip_conn_active(i) && poll_armed[i]) {
+		ptsched_timer_stop(&poll_timer[i]);
+		poll_armed[i] = 0;
+	}
+	PT_END(&t->pt);
+}
+
+static PT_THREAD(arp_thread(struct ptsched_task *t))
+{
+	PT_BEGIN(&t->pt);
+	ptsched_timer_set(&arp_timer, t, CLOCK_SECOND * 10);
+	while (1) {
+		PT_WAIT_UNTIL(&t->pt, ptsched_timer_expired(&arp_timer));
+		ptsched_timer_reset(&arp_timer);
+		uip_arp_timer();
+	}
+	PT_END(&t->pt);
+}
+
 void LED_Init (void)
 {
 	PINSEL_CFG_Type PinCfg;
@@ -90,8 +287,10 @@ void uip_log (char *m)
 int c_entry(void)
 {
 	UNS_32 i, delay;
+#if UIP_UDP
+	UNS_32 ready;
+#endif /* UIP_UDP */
 	uip_ipaddr_t ipaddr;
-	struct timer periodic_timer, arp_timer;
 
 	/* Initialize debug via UART0
 	 *  115200bps
@@ -113,9 +312,6 @@ int c_entry(void)
 	// Sys timer init 1/100 sec tick
 	clock_init();
 
-	timer_set(&periodic_timer, CLOCK_SECOND / 2); /*0.5s */
-	timer_set(&arp_timer, CLOCK_SECOND * 10);	/*10s */
-
 	_DBG_("Init EMAC");
 	// Initialize the ethernet device driver
 	while(!tapdev_init()){
@@ -123,6 +319,10 @@ int c_entry(void)
 		_DBG_("Error during initializing EMAC, restart after a while");
 		for (delay = 0x100000; delay; delay--);
 	}
+	// Keep the RX interrupt (EMAC_Init enables RX and TX done) only to
+	// wake the main loop from __WFI()
+	EMAC_IntCmd(EMAC_INT_TX_DONE, DISABLE);
+	NVIC_EnableIRQ(ENET_IRQn);
 
 
 #if 1
@@ -165,10 +365,41 @@ int c_entry(void)
 	// Initialize the HTTP server ----------------------------
 	_DBG_("Init HTTP");
 	httpd_init();
+
+#if UIP_UDP
+	// Telemetry to the router address ------------------------
+	_DBG_("Init telemetry");
+	uip_ipaddr(ipaddr, 192,168,0,1);
+	telemetry_init(ipaddr, HTONS(TELEMETRY_PORT));
+	ADC_DMA_Init();
+#endif /* UIP_UDP */
+
+	ptsched_init();
+	for (i = 0; i < UIP_CONNS; i++) {
+		ptsched_task_init(&conn_task[i], conn_thread, NULL);
+	}
+	ptsched_task_init(&arp_task, arp_thread, NULL);
+	ptsched_post(&arp_task);
 	_DBG_("Init complete!");
 
   while(1)
   {
+#if UIP_UDP
+    /* Send the half the GPDMA has just filled, where it is. The other
+       one, if still marked, is being overwritten already. */
+    ready = adc_ready;
+    if(ready)
+    {
+      i = adc_cur ^ 1;
+      if(ready & (1 << i))
+      {
+        telemetry_send(adc_buf[i], sizeof(adc_buf[i]));
+      }
+      __disable_irq();
+      adc_ready &= ~ready;
+      __enable_irq();
+    }
+#endif /* UIP_UDP */
     uip_len = tapdev_read(uip_buf);
     if(uip_len > 0)
     {
@@ -176,14 +407,26 @@ int c_entry(void)
       {
 	      uip_arp_ipin();
 	      uip_input();
+	      /* Its connection may need its timers set or stopped */
+	      if(uip_conn != NULL)
+	      {
+	        ptsched_post(&conn_task[uip_conn - uip_conns]);
+	      }
 	      /* If the above function invocation resulted in data that
 	         should be sent out on the network, the global variable
 	         uip_len is set to a value > 0. */
 
-	      if(uip_len > 0)
+	      while(uip_len > 0)
         {
 	        uip_arp_out();
 	        tapdev_send(uip_buf,uip_len);
+	        /* With UIP_TCP_WINDOW > 1 the connection may send more
+	           segments before the first one is acknowledged. */
+	        if(uip_conn == NULL || !uip_window_open(uip_conn))
+	        {
+	          break;
+	        }
+	        uip_poll_conn(uip_conn);
 	      }
       }
       else if(BUF->type == htons(UIP_ETHTYPE_ARP))
@@ -198,39 +441,21 @@ int c_entry(void)
 	      }
       }
     }
-    else if(timer_expired(&periodic_timer))
+    if(!ptsched_run() && uip_len == 0)
     {
-      timer_reset(&periodic_timer);
-      for(i = 0; i < UIP_CONNS; i++)
-      {
-      	uip_periodic(i);
-        /* If the above function invocation resulted in data that
-           should be sent out on the network, the global variable
-           uip_len is set to a value > 0. */
-        if(uip_len > 0)
-        {
-          uip_arp_out();
-          tapdev_send(uip_buf,uip_len);
-        }
-      }
+      /* Sleep until the next interrupt: SysTick, a frame (ENET_IRQHandler)
+         or a half of adc_buf (DMA_IRQHandler). WFI also returns for one
+         that has come in after the checks, while they are masked. */
+      __disable_irq();
 #if UIP_UDP
-      for(i = 0; i < UIP_UDP_CONNS; i++) {
-        uip_udp_periodic(i);
-        /* If the above function invocation resulted in data that
-           should be sent out on the network, the global variable
-           uip_len is set to a value > 0. */
-        if(uip_len > 0) {
-          uip_arp_out();
-          tapdev_send();
-        }
-      }
+      if(!EMAC_CheckReceiveIndex() && !adc_ready)
+#else /* UIP_UDP */
+      if(!EMAC_CheckReceiveIndex())
 #endif /* UIP_UDP */
-      /* Call the ARP timer function every 10 seconds. */
-      if(timer_expired(&arp_timer))
       {
-        timer_reset(&arp_timer);
-        uip_arp_timer();
+        __WFI();
       }
+      __enable_irq();
     }
   }
 #endif
@@ -0,0 +1,66 @@
+#include "uip.h"
+#include "uip_arch.h"
+#include "chksum-arch.h"
+
+#if UIP_ARCH_CHKSUM
+
+#define BUF ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* Checksums of uip_arch.h on top of chksum_arch(), in place of the
+ * byte pair loop of uip.c */
+u16_t uip_chksum(u16_t *data, u16_t len)
+{
+	return htons(chksum_arch(0, (u8_t *)data, len));
+}
+
+#ifndef UIP_ARCH_IPCHKSUM
+u16_t uip_ipchksum(void)
+{
+	u16_t sum;
+
+	sum = chksum_arch(0, &uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
+	return (sum == 0) ? 0xffff : htons(sum);
+}
+#endif
+
+static u16_t upper_layer_chksum(u8_t proto)
+{
+	u16_t upper_layer_len;
+	u16_t sum;
+
+#if UIP_CONF_IPV6
+	upper_layer_len = (((u16_t)(BUF->len[0]) << 8) + BUF->len[1]);
+#else /* UIP_CONF_IPV6 */
+	upper_layer_len = (((u16_t)(BUF->len[0]) << 8) + BUF->len[1]) - UIP_IPH_LEN;
+#endif /* UIP_CONF_IPV6 */
+
+	/* Pseudo header: protocol and length cannot carry, then the addresses */
+	sum = upper_layer_len + proto;
+	sum = chksum_arch(sum, (u8_t *)&BUF->srcipaddr[0], 2 * sizeof(uip_ipaddr_t));
+
+	/* TCP/UDP header and data */
+	sum = chksum_arch(sum, &uip_buf[UIP_IPH_LEN + UIP_LLH_LEN], upper_layer_len);
+
+	return (sum == 0) ? 0xffff : htons(sum);
+}
+
+#if UIP_CONF_IPV6
+u16_t uip_icmp6chksum(void)
+{
+	return upper_layer_chksum(UIP_PROTO_ICMP6);
+}
+#endif /* UIP_CONF_IPV6 */
+
+u16_t uip_tcpchksum(void)
+{
+	return upper_layer_chksum(UIP_PROTO_TCP);
+}
+
+#if UIP_UDP_CHECKSUMS
+u16_t uip_udpchksum(void)
+{
+	return upper_layer_chksum(UIP_PROTO_UDP);
+}
+#endif /* UIP_UDP_CHECKSUMS */
+
+#endif /* UIP_ARCH_CHKSUM */
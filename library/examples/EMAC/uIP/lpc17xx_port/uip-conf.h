@@ -56,6 +56,7 @@
 #define __UIP_CONF_H__
 
 #include <inttypes.h>
+#include "clock-arch.h"
 
 /**
  * 8 bit datatype
@@ -99,6 +100,49 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_CONF_MAX_LISTENPORTS 40
 
+/**
+ * Hash index for the connections and listening ports
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_CONN_HASH
+#define UIP_CONF_CONN_HASH       1
+#endif
+
+/**
+ * TCP segments in flight per connection, and their send buffers
+ * (UIP_TCP_MSS bytes each, in AHB SRAM bank 0)
+ * \hideinitializer
+ */
+#ifndef UIP_CONF_TCP_WINDOW
+#define UIP_CONF_TCP_WINDOW      4
+#endif
+#define UIP_CONF_TCP_SNDBUF      8
+#define UIP_CONF_TCP_SNDBUF_SECTION ".ahbram0"
+
+/**
+ * Connections are polled only when their application asks for it with
+ * uip_poll_request(): main.c sets a timer of the connection's task
+ * \hideinitializer
+ */
+struct uip_conn;
+void uip_port_poll_request(struct uip_conn *conn, clock_time_t ticks);
+#define UIP_CONF_POLL_REQUEST(conn, ticks) uip_port_poll_request(conn, ticks)
+
+/**
+ * ARP table for a flat LAN with dozens of hosts: hash index and LRU
+ * list, and two packets kept while their ARP request is outstanding
+ * (next to the send buffers, ~3 KB)
+ * \hideinitializer
+ */
+#define UIP_CONF_ARPTAB_SIZE     64
+#ifndef UIP_CONF_ARP_HASH
+#define UIP_CONF_ARP_HASH        1
+#endif
+#ifndef UIP_CONF_ARP_QUEUE
+#define UIP_CONF_ARP_QUEUE       2
+#endif
+#define UIP_CONF_ARP_QUEUE_SECTION ".ahbram0"
+
 /**
  * uIP buffer size.
  *
@@ -111,7 +155,7 @@ typedef unsigned short uip_stats_t;
  *
  * \hideinitializer
  */
-#define UIP_CONF_BYTE_ORDER      LITTLE_ENDIAN
+#define UIP_CONF_BYTE_ORDER      UIP_LITTLE_ENDIAN
 
 /**
  * Logging on or off
@@ -121,11 +165,13 @@ typedef unsigned short uip_stats_t;
 #define UIP_CONF_LOGGING         1  
 
 /**
- * UDP support on or off
+ * UDP support on or off, and the number of UDP connections: one for
+ * the telemetry application
  *
  * \hideinitializer
  */
-#define UIP_CONF_UDP             0	
+#define UIP_CONF_UDP             1
+#define UIP_CONF_UDP_CONNS       1
 
 /**
  * UDP checksums on or off
@@ -141,6 +187,13 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_CONF_STATISTICS      1
 
+/**
+ * Checksums from lpc17xx_port/uip-arch.c (word at a time) instead of
+ * the byte pair loop in uip.c
+ * \hideinitializer
+ */
+#define UIP_ARCH_CHKSUM          1
+
 /* Here we include the header file for the application(s) we use in
    our project. */
 /*#include "smtp.h"*/
@@ -149,6 +202,7 @@ typedef unsigned short uip_stats_t;
 #include "webserver.h"
 /*#include "dhcpc.h"*/
 /*#include "resolv.h"*/
+#include "telemetry.h"
 /*#include "webclient.h"*/
 
 #endif /* __UIP_CONF_H__ */
@@ -0,0 +1,259 @@
+/**
+ * \addtogroup ptsched
+ * @{
+ */
+
+/**
+ * \file
+ * Protothread scheduler and timer wheel.
+ */
+
+/*
+ * The wheel has LEVELS levels of SLOTS slots. A timer due within
+ * SLOTS ticks of the wheel is in slot (expires % SLOTS) of level 0;
+ * later ones are in the slot of level 1 or 2 for the corresponding
+ * bits of expires. Each time the level 0 index wraps around, the
+ * current slot of level 1 is emptied and its timers go down to level
+ * 0 (and likewise from level 2 when the level 1 index wraps around),
+ * as in the BSD and Linux kernels. A timer is moved at most twice
+ * before it expires.
+ *
+ * Timers further than the wheel covers (2^18 ticks, 43 minutes at 100
+ * ticks per second) wait in the last slot of level 2 that it covers
+ * and go back to level 2 until they are near enough.
+ */
+
+#include "ptsched.h"
+
+#define SLOT_BITS 6
+#define SLOTS     (1 << SLOT_BITS)
+#define SLOT_MASK (SLOTS - 1)
+#define LEVELS    3
+#define RANGE     ((clock_time_t)1 << (LEVELS * SLOT_BITS))
+
+#define INDEX(time, level) (((time) >> ((level) * SLOT_BITS)) & SLOT_MASK)
+
+static struct ptsched_timer *wheel[LEVELS][SLOTS];
+
+/* Next tick to expire, and number of timers in the wheel */
+static clock_time_t base;
+static unsigned int pending;
+
+static struct ptsched_task *runq_head, *runq_tail;
+/*---------------------------------------------------------------------------*/
+static void
+wheel_add(struct ptsched_timer *tm)
+{
+  struct ptsched_timer **slot;
+  clock_time_t expires, delta;
+
+  expires = tm->expires;
+  delta = expires - base;
+  if((int)delta < 0) {
+    /* Already due: expires on the next ptsched_run() */
+    slot = &wheel[0][INDEX(base, 0)];
+  } else if(delta < SLOTS) {
+    slot = &wheel[0][INDEX(expires, 0)];
+  } else if(delta < SLOTS * SLOTS) {
+    slot = &wheel[1][INDEX(expires, 1)];
+  } else {
+    if(delta >= RANGE) {
+      expires = base + RANGE - 1;
+    }
+    slot = &wheel[2][INDEX(expires, 2)];
+  }
+
+  tm->next = *slot;
+  if(tm->next != NULL) {
+    tm->next->pprev = &tm->next;
+  }
+  *slot = tm;
+  tm->pprev = slot;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_remove(struct ptsched_timer *tm)
+{
+  *tm->pprev = tm->next;
+  if(tm->next != NULL) {
+    tm->next->pprev = tm->pprev;
+  }
+  tm->pprev = NULL;
+}
+/*---------------------------------------------------------------------------*/
+/* Move the timers of a slot of level 1 or 2 down, return the index */
+static unsigned int
+cascade(unsigned int level, unsigned int index)
+{
+  struct ptsched_timer *tm, *next;
+
+  tm = wheel[level][index];
+  wheel[level][index] = NULL;
+  for(; tm != NULL; tm = next) {
+    next = tm->next;
+    wheel_add(tm);
+  }
+  return index;
+}
+/*---------------------------------------------------------------------------*/
+static void
+wheel_advance(clock_time_t now)
+{
+  struct ptsched_timer *tm;
+  unsigned int index;
+
+  if(pending == 0) {
+    /* Nothing to expire: skip the idle ticks */
+    base = now + 1;
+    return;
+  }
+
+  while((int)(now - base) >= 0) {
+    index = INDEX(base, 0);
+    if(index == 0 && cascade(1, INDEX(base, 1)) == 0) {
+      cascade(2, INDEX(base, 2));
+    }
+    ++base;
+    while((tm = wheel[0][index]) != NULL) {
+      wheel_remove(tm);
+      --pending;
+      ptsched_post(tm->task);
+    }
+  }
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Initialize the scheduler, before any task is posted.
+ */
+void
+ptsched_init(void)
+{
+  base = clock_time();
+  pending = 0;
+  runq_head = runq_tail = NULL;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Initialize a task. It runs for the first time when it is posted.
+ *
+ * \param t The task.
+ * \param thread The protothread function of the task.
+ * \param data Free for the thread, in t->data.
+ */
+void
+ptsched_task_init(struct ptsched_task *t,
+		  char (* thread)(struct ptsched_task *t), void *data)
+{
+  PT_INIT(&t->pt);
+  t->thread = thread;
+  t->next = NULL;
+  t->queued = 0;
+  t->data = data;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Have a task run by the next ptsched_run(). Posting a task already
+ * in the run queue does nothing.
+ *
+ * \param t The task.
+ */
+void
+ptsched_post(struct ptsched_task *t)
+{
+  if(t->queued) {
+    return;
+  }
+  t->queued = 1;
+  t->next = NULL;
+  if(runq_tail == NULL) {
+    runq_head = t;
+  } else {
+    runq_tail->next = t;
+  }
+  runq_tail = t;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Expire the timers due by clock_time() and run the tasks in the run
+ * queue. Tasks posted meanwhile, also by themselves, wait for the
+ * next call, so a task that keeps posting itself cannot starve the
+ * main loop.
+ *
+ * \return Non-zero if tasks are waiting in the run queue already.
+ */
+int
+ptsched_run(void)
+{
+  struct ptsched_task *t, *last;
+
+  wheel_advance(clock_time());
+
+  last = runq_tail;
+  if(last == NULL) {
+    return 0;
+  }
+  do {
+    t = runq_head;
+    runq_head = t->next;
+    if(runq_head == NULL) {
+      runq_tail = NULL;
+    }
+    t->queued = 0;
+    t->thread(t);
+  } while(t != last);
+
+  return runq_head != NULL;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Set a timer to post a task interval ticks from now. A timer set
+ * again before it expires is moved.
+ *
+ * \param tm The timer.
+ * \param t The task to post when the timer expires.
+ * \param interval The number of clock ticks.
+ */
+void
+ptsched_timer_set(struct ptsched_timer *tm, struct ptsched_task *t,
+		  clock_time_t interval)
+{
+  ptsched_timer_stop(tm);
+  tm->task = t;
+  tm->interval = interval;
+  tm->expires = clock_time() + interval;
+  wheel_add(tm);
+  ++pending;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Set a timer again, for the same interval from when it expired
+ * rather than from now, as timer_reset() does. Periodic tasks do not
+ * drift this way.
+ *
+ * \param tm The timer.
+ */
+void
+ptsched_timer_reset(struct ptsched_timer *tm)
+{
+  ptsched_timer_stop(tm);
+  tm->expires += tm->interval;
+  wheel_add(tm);
+  ++pending;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Stop a timer. Its task is not posted.
+ *
+ * \param tm The timer.
+ */
+void
+ptsched_timer_stop(struct ptsched_timer *tm)
+{
+  if(tm->pprev != NULL) {
+    wheel_remove(tm);
+    --pending;
+  }
+}
+/*---------------------------------------------------------------------------*/
+
+/** @} */
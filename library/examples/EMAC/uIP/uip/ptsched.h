@@ -0,0 +1,102 @@
+/** @addtogroup EMAC_uIP
+ * @{
+ */
+
+/**
+ * \defgroup ptsched Protothread scheduler
+ * @{
+ *
+ * The protothread scheduler runs \ref pt protothreads only when
+ * something they wait for has happened: one of their timers has
+ * expired, or some other code has posted them with ptsched_post(),
+ * e.g. the main loop when a frame comes in. A task that waits for
+ * nothing is not run at all, so idle applications take no CPU time
+ * and the main loop can sleep while ptsched_run() has nothing to do.
+ *
+ * Timers live in a hierarchical timer wheel: starting, stopping and
+ * expiring a timer take constant time however many timers there are,
+ * instead of one timer_expired() per timer and per pass of the main
+ * loop. The wheel advances with clock_time(), one slot per tick.
+ *
+ * The scheduler is not reentrant: tasks are posted and timers set
+ * from the main loop and from tasks, not from interrupt handlers.
+ */
+
+/**
+ * \file
+ * Protothread scheduler and timer wheel.
+ */
+
+#ifndef __PTSCHED_H__
+#define __PTSCHED_H__
+
+#include "pt.h"
+#include "clock.h"
+
+struct ptsched_task;
+
+/**
+ * A task: a protothread and its place in the run queue.
+ *
+ * The thread is called with the task. When it ends (PT_END() or
+ * PT_EXIT()), a later ptsched_post() starts it again from the top.
+ */
+struct ptsched_task {
+  struct pt pt;
+  char (* thread)(struct ptsched_task *t);
+  struct ptsched_task *next;
+  unsigned char queued;
+  void *data;                   /**< Free for the thread. */
+};
+
+/**
+ * A timer of the wheel. Timers must be zeroed (static, or memset)
+ * before their first ptsched_timer_set().
+ */
+struct ptsched_timer {
+  struct ptsched_timer *next, **pprev;
+  clock_time_t expires;
+  clock_time_t interval;
+  struct ptsched_task *task;
+};
+
+void ptsched_init(void);
+void ptsched_task_init(struct ptsched_task *t,
+		       char (* thread)(struct ptsched_task *t), void *data);
+void ptsched_post(struct ptsched_task *t);
+int ptsched_run(void);
+
+void ptsched_timer_set(struct ptsched_timer *tm, struct ptsched_task *t,
+		       clock_time_t interval);
+void ptsched_timer_reset(struct ptsched_timer *tm);
+void ptsched_timer_stop(struct ptsched_timer *tm);
+
+/**
+ * Check if a timer has expired (or was stopped, or never set).
+ *
+ * \hideinitializer
+ */
+#define ptsched_timer_expired(tm) ((tm)->pprev == NULL)
+
+/**
+ * Block a task for a number of ticks.
+ *
+ * The task is posted when the timer expires. Posts before that run the
+ * thread, which only checks the timer and yields again.
+ *
+ * \param t (struct ptsched_task *) The task.
+ * \param tm (struct ptsched_timer *) A timer of the task.
+ * \param ticks (clock_time_t) The number of clock ticks.
+ *
+ * \hideinitializer
+ */
+#define PTSCHED_WAIT_TICKS(t, tm, ticks)			\
+  do {								\
+    ptsched_timer_set(tm, t, ticks);				\
+    PT_WAIT_UNTIL(&(t)->pt, ptsched_timer_expired(tm));	\
+  } while(0)
+
+#endif /* __PTSCHED_H__ */
+
+/** @} */
+/** @} */
@@ -195,10 +195,70 @@ static u16_t ipid;           /* Ths ipid variable is an increasing
 				field. */
 
 void uip_setipid(u16_t id) { ipid = id; }
+u16_t uip_nextipid(void) { return ++ipid; }
 
 static u8_t iss[4];          /* The iss variable is used for the TCP
 				initial sequence number. */
 
+#if UIP_CONN_HASH
+/* Connection index: open addressed, linear probing. Each slot holds the
+   number of a connection plus one, 0 is free. A connection keeps its
+   slot while it is closed, lookups skip it, and only loses it when it
+   is taken for a new connection; so there are never more than UIP_CONNS
+   slots in use and probing always ends at a free one. */
+#if UIP_CONNS < 8
+#define CONN_HASH_BITS 4
+#elif UIP_CONNS < 16
+#define CONN_HASH_BITS 5
+#elif UIP_CONNS < 32
+#define CONN_HASH_BITS 6
+#elif UIP_CONNS < 64
+#define CONN_HASH_BITS 7
+#elif UIP_CONNS < 255
+#define CONN_HASH_BITS 8
+#else
+#error "UIP_CONN_HASH supports up to 254 connections"
+#endif
+#define CONN_HASH_SIZE (1 << CONN_HASH_BITS)
+#define CONN_HASH_MASK (CONN_HASH_SIZE - 1)
+
+static u8_t conn_hash[CONN_HASH_SIZE];
+
+/* One bit per listening port hash; a SYN whose bit is clear is for a
+   port nobody listens on. */
+static u8_t listen_map[32];
+#define LISTEN_BIT(port) ((u8_t)((port) ^ ((port) >> 8)))
+#endif /* UIP_CONN_HASH */
+
+#if UIP_TCP_WINDOW > 1
+#if UIP_TCP_WINDOW > 255 || UIP_TCP_SNDBUF > 255
+#error "UIP_TCP_WINDOW and UIP_TCP_SNDBUF must be at most 255"
+#endif
+#if UIP_TCP_WINDOW * UIP_TCP_MSS > 65535
+#error "The data in flight (UIP_TCP_WINDOW * UIP_TCP_MSS) must fit in 16 bits"
+#endif
+#if defined(UIP_TCP_SNDBUF_SECTION) && defined(__GNUC__)
+#define SNDBUF_RAM __attribute__ ((section (UIP_TCP_SNDBUF_SECTION)))
+#else
+#define SNDBUF_RAM
+#endif
+/* Send buffers of the segments in flight, shared by all connections.
+   The free ones are kept as a stack of their numbers. */
+struct uip_sndbuf {
+  u16_t len;
+  u8_t data[UIP_TCP_MSS];
+};
+static SNDBUF_RAM struct uip_sndbuf sndbuf[UIP_TCP_SNDBUF];
+static u8_t sndbuf_free[UIP_TCP_SNDBUF];
+static u8_t sndbuf_nfree;
+
+/* Data in flight from the start of the segment being sent on. A
+   segment goes out at snd_nxt plus the data in flight minus this, so
+   that new segments and ACKs carry the next new sequence number and a
+   retransmission the oldest one. */
+static u16_t win_back;
+#endif /* UIP_TCP_WINDOW > 1 */
+
 #if UIP_ACTIVE_OPEN
 static u16_t lastport;       /* Keeps track of the last port used for
 				a new connection. */
@@ -391,6 +451,195 @@ uip_udpchksum(void)
 #endif /* UIP_UDP_CHECKSUMS */
 #endif /* UIP_ARCH_CHKSUM */
 /*---------------------------------------------------------------------------*/
+#if UIP_CONN_HASH
+static u8_t
+conn_hash_slot(u16_t lport, u16_t rport, u16_t *ripaddr)
+{
+  u16_t h;
+  u8_t i;
+
+  h = lport * 31 + rport;
+  for(i = 0; i < sizeof(uip_ipaddr_t) / 2; ++i) {
+    h = h * 31 + ripaddr[i];
+  }
+  /* Fibonacci hashing: the top bits of the product are the well mixed
+     ones. */
+  return (u16_t)(h * 0x9e37u) >> (16 - CONN_HASH_BITS);
+}
+/*---------------------------------------------------------------------------*/
+static void
+conn_hash_add(struct uip_conn *conn)
+{
+  u8_t i;
+
+  i = conn_hash_slot(conn->lport, conn->rport, conn->ripaddr);
+  while(conn_hash[i] != 0) {
+    i = (i + 1) & CONN_HASH_MASK;
+  }
+  conn_hash[i] = (u8_t)(conn - uip_conns) + 1;
+}
+/*---------------------------------------------------------------------------*/
+static void
+conn_hash_remove(struct uip_conn *conn)
+{
+  u8_t i, j, k, n;
+
+  n = (u8_t)(conn - uip_conns) + 1;
+  i = conn_hash_slot(conn->lport, conn->rport, conn->ripaddr);
+  while(conn_hash[i] != n) {
+    if(conn_hash[i] == 0) {
+      return;
+    }
+    i = (i + 1) & CONN_HASH_MASK;
+  }
+
+  /* Backward shift: move up the entries that probed past the freed
+     slot, so that no probe sequence is cut short. */
+  for(j = (i + 1) & CONN_HASH_MASK; conn_hash[j] != 0;
+      j = (j + 1) & CONN_HASH_MASK) {
+    conn = &uip_conns[conn_hash[j] - 1];
+    k = conn_hash_slot(conn->lport, conn->rport, conn->ripaddr);
+    if(((j - k) & CONN_HASH_MASK) >= ((j - i) & CONN_HASH_MASK)) {
+      conn_hash[i] = conn_hash[j];
+      i = j;
+    }
+  }
+  conn_hash[i] = 0;
+}
+/*---------------------------------------------------------------------------*/
+static void
+listen_map_update(void)
+{
+  memset(listen_map, 0, sizeof(listen_map));
+  for(c = 0; c < UIP_LISTENPORTS; ++c) {
+    if(uip_listenports[c] != 0) {
+      listen_map[LISTEN_BIT(uip_listenports[c]) >> 3] |=
+	1 << (LISTEN_BIT(uip_listenports[c]) & 7);
+    }
+  }
+}
+#endif /* UIP_CONN_HASH */
+/*---------------------------------------------------------------------------*/
+static void
+rtt_update(struct uip_conn *conn)
+{
+  signed char m;
+  m = conn->rto - conn->timer;
+  /* This is taken directly from VJs original code in his paper */
+  m = m - (conn->sa >> 3);
+  conn->sa += m;
+  if(m < 0) {
+    m = -m;
+  }
+  m = m - (conn->sv >> 2);
+  conn->sv += m;
+  conn->rto = (conn->sa >> 3) + conn->sv;
+}
+/*---------------------------------------------------------------------------*/
+#if UIP_TCP_WINDOW > 1
+static void
+win_free(struct uip_conn *conn)
+{
+  while(conn->nseg > 0) {
+    sndbuf_free[sndbuf_nfree++] = conn->seg[--conn->nseg];
+  }
+  conn->wflags = 0;
+}
+/*---------------------------------------------------------------------------*/
+/* Frees the segments that the incoming ACK acknowledges in full and
+   moves snd_nxt past them. Returns how many were freed. */
+static u8_t
+win_ack(struct uip_conn *conn)
+{
+  unsigned long acked;
+  u16_t len;
+  u8_t n, i;
+
+  acked = (((unsigned long)BUF->ackno[0] << 24) |
+	   ((unsigned long)BUF->ackno[1] << 16) |
+	   ((unsigned long)BUF->ackno[2] << 8) | BUF->ackno[3]) -
+    (((unsigned long)conn->snd_nxt[0] << 24) |
+     ((unsigned long)conn->snd_nxt[1] << 16) |
+     ((unsigned long)conn->snd_nxt[2] << 8) | conn->snd_nxt[3]);
+  acked &= 0xffffffffUL;
+  if(acked > conn->len) {
+    /* An old ACK, or one for data we never sent. */
+    return 0;
+  }
+
+  for(n = 0; n < conn->nseg; ++n) {
+    len = sndbuf[conn->seg[n]].len;
+    if(len > acked) {
+      break;
+    }
+    acked -= len;
+    conn->len -= len;
+    uip_add32(conn->snd_nxt, len);
+    conn->snd_nxt[0] = uip_acc32[0];
+    conn->snd_nxt[1] = uip_acc32[1];
+    conn->snd_nxt[2] = uip_acc32[2];
+    conn->snd_nxt[3] = uip_acc32[3];
+    sndbuf_free[sndbuf_nfree++] = conn->seg[n];
+  }
+  if(n > 0) {
+    conn->nseg -= n;
+    for(i = 0; i < conn->nseg; ++i) {
+      conn->seg[i] = conn->seg[i + n];
+    }
+  }
+  return n;
+}
+/*---------------------------------------------------------------------------*/
+/* Returns 1 if the application may send another segment. After a
+   retransmission timeout nothing new is sent until the segments in
+   flight have been acknowledged. */
+static u8_t
+win_room(struct uip_conn *conn)
+{
+  return conn->nseg < UIP_TCP_WINDOW && sndbuf_nfree > 0 &&
+    conn->nrtx == 0 && !(conn->wflags & UIP_WIN_CLOSE);
+}
+/*---------------------------------------------------------------------------*/
+/* Copies the uip_slen bytes the application sent to a send buffer at
+   the end of the window. Returns 0 if the window is full. */
+static u8_t
+win_push(struct uip_conn *conn)
+{
+  u8_t i;
+
+  if(!win_room(conn) ||
+     (conn->len > 0 && conn->len + uip_slen > conn->snd_wnd)) {
+    return 0;
+  }
+  i = sndbuf_free[--sndbuf_nfree];
+  memcpy(sndbuf[i].data, uip_sappdata, uip_slen);
+  sndbuf[i].len = uip_slen;
+  conn->seg[conn->nseg++] = i;
+  conn->len += uip_slen;
+  conn->wflags |= UIP_WIN_ACKED;
+  win_back = uip_slen;
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+/* The uip_flags that tell the application what happened to the data
+   it sent since its last call. */
+static u8_t
+win_pending(struct uip_conn *conn)
+{
+  u8_t flags;
+
+  flags = 0;
+  if(conn->wflags & UIP_WIN_ACKED) {
+    flags |= UIP_ACKDATA;
+  }
+  if(conn->wflags & UIP_WIN_BLOCKED) {
+    flags |= UIP_REXMIT;
+  }
+  conn->wflags &= ~(UIP_WIN_ACKED | UIP_WIN_BLOCKED);
+  return flags;
+}
+#endif /* UIP_TCP_WINDOW > 1 */
+/*---------------------------------------------------------------------------*/
 void
 uip_init(void)
 {
@@ -399,7 +648,21 @@ uip_init(void)
   }
   for(c = 0; c < UIP_CONNS; ++c) {
     uip_conns[c].tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_WINDOW > 1
+    uip_conns[c].nseg = 0;
+    uip_conns[c].wflags = 0;
+#endif /* UIP_TCP_WINDOW > 1 */
   }
+#if UIP_TCP_WINDOW > 1
+  for(c = 0; c < UIP_TCP_SNDBUF; ++c) {
+    sndbuf_free[c] = c;
+  }
+  sndbuf_nfree = UIP_TCP_SNDBUF;
+#endif /* UIP_TCP_WINDOW > 1 */
+#if UIP_CONN_HASH
+  memset(conn_hash, 0, sizeof(conn_hash));
+  memset(listen_map, 0, sizeof(listen_map));
+#endif /* UIP_CONN_HASH */
 #if UIP_ACTIVE_OPEN
   lastport = 1024;
 #endif /* UIP_ACTIVE_OPEN */
@@ -460,6 +723,9 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
   if(conn == 0) {
     return 0;
   }
+#if UIP_CONN_HASH
+  conn_hash_remove(conn);
+#endif /* UIP_CONN_HASH */
 
   conn->tcpstateflags = UIP_SYN_SENT;
 
@@ -476,9 +742,16 @@ uip_connect(uip_ipaddr_t *ripaddr, u16_t rport)
   conn->rto = UIP_RTO;
   conn->sa = 0;
   conn->sv = 16;   /* Initial value of the RTT variance. */
+#if UIP_TCP_WINDOW > 1
+  win_free(conn);
+  conn->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_WINDOW > 1 */
   conn->lport = htons(lastport);
   conn->rport = rport;
   uip_ipaddr_copy(&conn->ripaddr, ripaddr);
+#if UIP_CONN_HASH
+  conn_hash_add(conn);
+#endif /* UIP_CONN_HASH */
 
   return conn;
 }
@@ -536,6 +809,9 @@ uip_unlisten(u16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == port) {
       uip_listenports[c] = 0;
+#if UIP_CONN_HASH
+      listen_map_update();
+#endif /* UIP_CONN_HASH */
       return;
     }
   }
@@ -547,6 +823,9 @@ uip_listen(u16_t port)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == 0) {
       uip_listenports[c] = port;
+#if UIP_CONN_HASH
+      listen_map_update();
+#endif /* UIP_CONN_HASH */
       return;
     }
   }
@@ -710,12 +989,28 @@ uip_process(u8_t flag)
   /* Check if we were invoked because of a poll request for a
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
+#if UIP_TCP_WINDOW > 1
+    /* With a send window the application is polled while the window
+       has room. If the data it sent last has been buffered since its
+       last call, it gets UIP_ACKDATA instead of UIP_POLL. */
+    if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+       win_room(uip_connr)) {
+	uip_flags = win_pending(uip_connr);
+	if(uip_flags == 0) {
+	  uip_flags = UIP_POLL;
+	}
+	uip_slen = 0;
+	UIP_APPCALL();
+	goto appsend;
+    }
+#else /* UIP_TCP_WINDOW > 1 */
     if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
        !uip_outstanding(uip_connr)) {
 	uip_flags = UIP_POLL;
 	UIP_APPCALL();
 	goto appsend;
     }
+#endif /* UIP_TCP_WINDOW > 1 */
     goto drop;
 
     /* Check if we were invoked because of the perodic timer fireing. */
@@ -760,6 +1055,9 @@ uip_process(u8_t flag)
 	       uip_connr->tcpstateflags == UIP_SYN_RCVD) &&
 	      uip_connr->nrtx == UIP_MAXSYNRTX)) {
 	    uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_WINDOW > 1
+	    win_free(uip_connr);
+#endif /* UIP_TCP_WINDOW > 1 */
 
 	    /* We call UIP_APPCALL() with uip_flags set to
 	       UIP_TIMEDOUT to inform the application that the
@@ -799,6 +1097,17 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
 
 	  case UIP_ESTABLISHED:
+#if UIP_TCP_WINDOW > 1
+	    /* With a send window we resend the oldest segment from
+	       its send buffer, the application is not involved. */
+	  win_rexmit:
+	    c = uip_connr->seg[0];
+	    memcpy(uip_appdata, sndbuf[c].data, sndbuf[c].len);
+	    uip_len = sndbuf[c].len + UIP_TCPIP_HLEN;
+	    win_back = uip_connr->len;
+	    BUF->flags = TCP_ACK | TCP_PSH;
+	    goto tcp_send_noopts;
+#else /* UIP_TCP_WINDOW > 1 */
 	    /* In the ESTABLISHED state, we call upon the application
                to do the actual retransmit after which we jump into
                the code for sending out the packet (the apprexmit
@@ -806,6 +1115,7 @@ uip_process(u8_t flag)
 	    uip_flags = UIP_REXMIT;
 	    UIP_APPCALL();
 	    goto apprexmit;
+#endif /* UIP_TCP_WINDOW > 1 */
 
 	  case UIP_FIN_WAIT_1:
 	  case UIP_CLOSING:
@@ -815,10 +1125,22 @@ uip_process(u8_t flag)
 
 	  }
 	}
+#if UIP_TCP_WINDOW > 1
+      }
+      /* With a send window the application is also polled while
+	 segments are in flight, if the window has room for more. */
+      if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED &&
+	 win_room(uip_connr)) {
+	uip_flags = win_pending(uip_connr);
+	if(uip_flags == 0) {
+	  uip_flags = UIP_POLL;
+	}
+#else /* UIP_TCP_WINDOW > 1 */
       } else if((uip_connr->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED) {
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
 	uip_flags = UIP_POLL;
+#endif /* UIP_TCP_WINDOW > 1 */
 	UIP_APPCALL();
 	goto appsend;
       }
@@ -1204,6 +1526,18 @@ uip_process(u8_t flag)
 
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_CONN_HASH
+  for(c = conn_hash_slot(BUF->destport, BUF->srcport, BUF->srcipaddr);
+      conn_hash[c] != 0; c = (c + 1) & CONN_HASH_MASK) {
+    uip_connr = &uip_conns[conn_hash[c] - 1];
+    if(uip_connr->tcpstateflags != UIP_CLOSED &&
+       BUF->destport == uip_connr->lport &&
+       BUF->srcport == uip_connr->rport &&
+       uip_ipaddr_cmp(BUF->srcipaddr, uip_connr->ripaddr)) {
+      goto found;
+    }
+  }
+#else /* UIP_CONN_HASH */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
     if(uip_connr->tcpstateflags != UIP_CLOSED &&
@@ -1213,6 +1547,7 @@ uip_process(u8_t flag)
       goto found;
     }
   }
+#endif /* UIP_CONN_HASH */
 
   /* If we didn't find and active connection that expected the packet,
      either this packet is an old duplicate, or this is a SYN packet
@@ -1224,6 +1559,12 @@ uip_process(u8_t flag)
 
   tmp16 = BUF->destport;
   /* Next, check listening connections. */
+#if UIP_CONN_HASH
+  if(!(listen_map[LISTEN_BIT(tmp16) >> 3] & (1 << (LISTEN_BIT(tmp16) & 7)))) {
+    UIP_STAT(++uip_stat.tcp.synrst);
+    goto reset;
+  }
+#endif /* UIP_CONN_HASH */
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(tmp16 == uip_listenports[c])
       goto found_listen;
@@ -1317,15 +1658,25 @@ uip_process(u8_t flag)
     goto drop;
   }
   uip_conn = uip_connr;
+#if UIP_CONN_HASH
+  conn_hash_remove(uip_connr);
+#endif /* UIP_CONN_HASH */
 
   /* Fill in the necessary fields for the new connection. */
   uip_connr->rto = uip_connr->timer = UIP_RTO;
   uip_connr->sa = 0;
   uip_connr->sv = 4;
   uip_connr->nrtx = 0;
+#if UIP_TCP_WINDOW > 1
+  win_free(uip_connr);
+  uip_connr->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_WINDOW > 1 */
   uip_connr->lport = BUF->destport;
   uip_connr->rport = BUF->srcport;
   uip_ipaddr_copy(uip_connr->ripaddr, BUF->srcipaddr);
+#if UIP_CONN_HASH
+  conn_hash_add(uip_connr);
+#endif /* UIP_CONN_HASH */
   uip_connr->tcpstateflags = UIP_SYN_RCVD;
 
   uip_connr->snd_nxt[0] = iss[0];
@@ -1406,6 +1757,9 @@ uip_process(u8_t flag)
      before we accept the reset. */
   if(BUF->flags & TCP_RST) {
     uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_WINDOW > 1
+    win_free(uip_connr);
+#endif /* UIP_TCP_WINDOW > 1 */
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1437,6 +1791,34 @@ uip_process(u8_t flag)
      data. If so, we update the sequence number, reset the length of
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
+#if UIP_TCP_WINDOW > 1
+  /* Segments of the send window are acknowledged one by one. The
+     application was told about them when they were buffered, so
+     UIP_ACKDATA is not set. */
+  if((BUF->flags & TCP_ACK) && uip_connr->nseg > 0) {
+    if(win_ack(uip_connr) > 0) {
+      uip_connr->timer = uip_connr->rto;
+      if(uip_connr->nrtx == 0) {
+	rtt_update(uip_connr);
+      } else if(uip_connr->nseg > 0) {
+	/* The segments sent after the one that timed out may have
+	   been lost with it: resend them one per ACK until all are
+	   acknowledged. */
+	UIP_STAT(++uip_stat.tcp.rexmit);
+	goto win_rexmit;
+      }
+      uip_connr->nrtx = 0;
+      if(uip_connr->nseg == 0 && (uip_connr->wflags & UIP_WIN_CLOSE)) {
+	/* The application closed the connection and all its data is
+	   acknowledged: send the FIN now. */
+	uip_connr->wflags = 0;
+	uip_connr->len = 1;
+	uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
+	goto tcp_send_finack;
+      }
+    }
+  } else
+#endif /* UIP_TCP_WINDOW > 1 */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
@@ -1453,18 +1835,7 @@ uip_process(u8_t flag)
 
       /* Do RTT estimation, unless we have done retransmissions. */
       if(uip_connr->nrtx == 0) {
-	signed char m;
-	m = uip_connr->rto - uip_connr->timer;
-	/* This is taken directly from VJs original code in his paper */
-	m = m - (uip_connr->sa >> 3);
-	uip_connr->sa += m;
-	if(m < 0) {
-	  m = -m;
-	}
-	m = m - (uip_connr->sv >> 2);
-	uip_connr->sv += m;
-	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
-
+	rtt_update(uip_connr);
       }
       /* Set the acknowledged flag. */
       uip_flags = UIP_ACKDATA;
@@ -1477,6 +1848,13 @@ uip_process(u8_t flag)
 
   }
 
+#if UIP_TCP_WINDOW > 1
+  /* The send window is limited by the window of the remote host too. */
+  if(BUF->flags & TCP_ACK) {
+    uip_connr->snd_wnd = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+  }
+#endif /* UIP_TCP_WINDOW > 1 */
+
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & UIP_TS_MASK) {
     /* CLOSED and LISTEN are not handled here. CLOSE_WAIT is not
@@ -1659,7 +2037,25 @@ uip_process(u8_t flag)
        put into the uip_appdata and the length of the data should be
        put into uip_len. If the application don't have any data to
        send, uip_len must be set to 0. */
+#if UIP_TCP_WINDOW > 1
+    /* With a send window, the application is also called when the
+       data it sent before is buffered or had to be refused and the
+       window has room again. Once it has closed the connection, new
+       data is only acknowledged. */
+    if(uip_connr->wflags & UIP_WIN_CLOSE) {
+      if(uip_flags & UIP_NEWDATA) {
+	goto tcp_send_ack;
+      }
+      goto drop;
+    }
+    if((uip_connr->wflags & (UIP_WIN_ACKED | UIP_WIN_BLOCKED)) &&
+       win_room(uip_connr)) {
+      uip_flags |= win_pending(uip_connr);
+    }
+    if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA | UIP_REXMIT)) {
+#else /* UIP_TCP_WINDOW > 1 */
     if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA)) {
+#endif /* UIP_TCP_WINDOW > 1 */
       uip_slen = 0;
       UIP_APPCALL();
 
@@ -1668,12 +2064,25 @@ uip_process(u8_t flag)
       if(uip_flags & UIP_ABORT) {
 	uip_slen = 0;
 	uip_connr->tcpstateflags = UIP_CLOSED;
+#if UIP_TCP_WINDOW > 1
+	win_free(uip_connr);
+#endif /* UIP_TCP_WINDOW > 1 */
 	BUF->flags = TCP_RST | TCP_ACK;
 	goto tcp_send_nodata;
       }
 
       if(uip_flags & UIP_CLOSE) {
 	uip_slen = 0;
+#if UIP_TCP_WINDOW > 1
+	if(uip_connr->nseg > 0) {
+	  /* The FIN goes out when the data in flight has been
+	     acknowledged. uip_close() cleared UIP_NEWDATA, so the ACK
+	     is sent anyway. */
+	  uip_connr->wflags |= UIP_WIN_CLOSE;
+	  goto tcp_send_ack;
+	}
+	uip_connr->wflags = 0;
+#endif /* UIP_TCP_WINDOW > 1 */
 	uip_connr->len = 1;
 	uip_connr->tcpstateflags = UIP_FIN_WAIT_1;
 	uip_connr->nrtx = 0;
@@ -1681,6 +2090,27 @@ uip_process(u8_t flag)
 	goto tcp_send_nodata;
       }
 
+#if UIP_TCP_WINDOW > 1
+      if(uip_connr->nseg == 0) {
+	uip_connr->nrtx = 0;
+      }
+      if(uip_slen > 0) {
+	if(uip_slen > uip_connr->mss) {
+	  uip_slen = uip_connr->mss;
+	}
+	/* The data goes to a send buffer and out at the end of the
+	   window. */
+	if(win_push(uip_connr)) {
+	  uip_len = uip_slen + UIP_TCPIP_HLEN;
+	  BUF->flags = TCP_ACK | TCP_PSH;
+	  goto tcp_send_noopts;
+	}
+	/* The window is full. The application is asked to send the
+	   same data again (UIP_REXMIT) when there is room. */
+	uip_connr->wflags |= UIP_WIN_BLOCKED;
+	uip_slen = 0;
+      }
+#else /* UIP_TCP_WINDOW > 1 */
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
 
@@ -1715,6 +2145,7 @@ uip_process(u8_t flag)
       }
       uip_connr->nrtx = 0;
     apprexmit:
+#endif /* UIP_TCP_WINDOW > 1 */
       uip_appdata = uip_sappdata;
 
       /* If the application has data to be sent, or if the incoming
@@ -1826,6 +2257,16 @@ uip_process(u8_t flag)
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#if UIP_TCP_WINDOW > 1
+  if(uip_connr->nseg > 0) {
+    uip_add32(BUF->seqno, uip_connr->len - win_back);
+    BUF->seqno[0] = uip_acc32[0];
+    BUF->seqno[1] = uip_acc32[1];
+    BUF->seqno[2] = uip_acc32[2];
+    BUF->seqno[3] = uip_acc32[3];
+  }
+  win_back = 0;
+#endif /* UIP_TCP_WINDOW > 1 */
 
   BUF->proto = UIP_PROTO_TCP;
 
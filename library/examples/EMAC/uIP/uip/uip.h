@@ -194,6 +194,14 @@ void uip_init(void);
  */
 void uip_setipid(u16_t id);
 
+/**
+ * Take the next IP ID.
+ *
+ * For datagrams that an application builds and sends without
+ * uip_process(), so that their IP IDs do not repeat those of uIP.
+ */
+u16_t uip_nextipid(void);
+
 /** @} */
 
 /**
@@ -337,6 +345,38 @@ void uip_setipid(u16_t id);
 #define uip_poll_conn(conn) do { uip_conn = conn; \
                                  uip_process(UIP_POLL_REQUEST); } while (0)
 
+/**
+ * Check if the application of a connection can send another segment
+ * right away.
+ *
+ * With UIP_TCP_WINDOW more than 1, this is true while the last data
+ * sent by the application is buffered but not yet reported as
+ * acknowledged and the send window has room for more. The device
+ * driver should then poll the connection with uip_poll_conn() and
+ * send the packet it produces.
+ \code
+ uip_input();
+ while(uip_len > 0) {
+   devicedriver_send();
+   if(uip_conn == NULL || !uip_window_open(uip_conn)) {
+     break;
+   }
+   uip_poll_conn(uip_conn);
+ }
+ \endcode
+ *
+ * \param conn A pointer to the uip_conn struct for the connection.
+ *
+ * \hideinitializer
+ */
+#if UIP_TCP_WINDOW > 1
+#define uip_window_open(conn) (((conn)->tcpstateflags & UIP_TS_MASK) == UIP_ESTABLISHED && \
+                               ((conn)->wflags & (UIP_WIN_ACKED | UIP_WIN_CLOSE)) == UIP_WIN_ACKED && \
+                               (conn)->nseg < UIP_TCP_WINDOW)
+#else /* UIP_TCP_WINDOW > 1 */
+#define uip_window_open(conn) 0
+#endif /* UIP_TCP_WINDOW > 1 */
+
 
 #if UIP_UDP
 /**
@@ -719,6 +759,23 @@ void uip_send(const void *data, int len);
  */
 #define uip_poll()       (uip_flags & UIP_POLL)
 
+/**
+ * Ask for a poll of the current connection in a number of clock ticks.
+ *
+ * Only defined when the port polls connections on request
+ * (UIP_CONF_POLL_REQUEST) instead of from every uip_periodic() call.
+ * A later request replaces an earlier one. The application then gets
+ * uip_poll() when the time is up, and also whenever the device driver
+ * polls the connection with uip_poll_conn() to fill the send window.
+ *
+ * \param ticks (clock_time_t) The number of clock ticks.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_POLL_REQUEST
+#define uip_poll_request(ticks) UIP_CONF_POLL_REQUEST(uip_conn, ticks)
+#endif /* UIP_CONF_POLL_REQUEST */
+
 /**
  * Get the initial maxium segment size (MSS) of the current
  * connection.
@@ -1179,6 +1236,12 @@ struct uip_conn {
   u8_t timer;         /**< The retransmission timer. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_WINDOW > 1
+  u16_t snd_wnd;      /**< The window advertised by the remote host. */
+  u8_t nseg;          /**< The number of segments in flight. */
+  u8_t seg[UIP_TCP_WINDOW]; /**< Their send buffers, oldest first. */
+  u8_t wflags;        /**< Send window state. */
+#endif /* UIP_TCP_WINDOW > 1 */
 
   /** The application state. */
   uip_tcp_appstate_t appstate;
@@ -1386,6 +1449,15 @@ void uip_process(u8_t flag);
 
 #define UIP_STOPPED      16
 
+#if UIP_TCP_WINDOW > 1
+/* The send window state in uip_conn->wflags. */
+#define UIP_WIN_ACKED    1  /* Buffered data not yet reported to the
+			       application as acknowledged. */
+#define UIP_WIN_BLOCKED  2  /* Data refused because the window was
+			       full, the application must resend it. */
+#define UIP_WIN_CLOSE    4  /* Send a FIN once the window drains. */
+#endif /* UIP_TCP_WINDOW > 1 */
+
 /* The TCP and IP headers. */
 
 #ifdef __ICCARM__
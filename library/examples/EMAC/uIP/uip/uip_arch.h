@@ -16,6 +16,11 @@
  * module is to let the checksum functions to be implemented in
  * architecture specific assembler.
  *
+ * uip.c leaves out its own uip_chksum(), uip_ipchksum(),
+ * uip_tcpchksum() and uip_udpchksum() when UIP_ARCH_CHKSUM is set to 1
+ * in uip-conf.h, and uip_add32() when UIP_ARCH_ADD32 is. The LPC17xx
+ * port has the checksums in lpc17xx_port/uip-arch.c.
+ *
  */
 
 /**
@@ -126,6 +126,9 @@ struct arp_entry {
   u16_t ipaddr[2];
   struct uip_eth_addr ethaddr;
   u8_t time;
+#if UIP_ARP_HASH
+  u8_t newer, older;  /* LRU list neighbours, numbers plus one. */
+#endif /* UIP_ARP_HASH */
 };
 
 static const struct uip_eth_addr broadcast_ethaddr =
@@ -134,14 +137,248 @@ static const u16_t broadcast_ipaddr[2] = {0xffff,0xffff};
 
 static struct arp_entry arp_table[UIP_ARPTAB_SIZE];
 static u16_t ipaddr[2];
-static u8_t i, c;
+static u8_t i;
 
 static u8_t arptime;
-static u8_t tmpage;
+#if !UIP_ARP_HASH
+static u8_t c, tmpage;
+#endif /* !UIP_ARP_HASH */
+
+#if UIP_ARP_HASH
+/* ARP table index: open addressed, linear probing. Each slot holds
+   the number of an entry in use plus one, 0 is free. The entries
+   taken so far (the first arp_used ones) are also kept in a list from
+   the most recently used, arp_newest, to the least, arp_oldest; the
+   ones that timed out are moved to its end, so a new mapping simply
+   takes arp_oldest once the table is full. All of it starts out
+   zeroed, so uip_arp_init() is still optional. */
+#if UIP_ARPTAB_SIZE < 8
+#define ARP_HASH_BITS 4
+#elif UIP_ARPTAB_SIZE < 16
+#define ARP_HASH_BITS 5
+#elif UIP_ARPTAB_SIZE < 32
+#define ARP_HASH_BITS 6
+#elif UIP_ARPTAB_SIZE < 64
+#define ARP_HASH_BITS 7
+#elif UIP_ARPTAB_SIZE < 255
+#define ARP_HASH_BITS 8
+#else
+#error "UIP_ARP_HASH supports up to 254 ARP table entries"
+#endif
+#define ARP_HASH_SIZE (1 << ARP_HASH_BITS)
+#define ARP_HASH_MASK (ARP_HASH_SIZE - 1)
+
+static u8_t arp_hash[ARP_HASH_SIZE];
+static u8_t arp_used, arp_newest, arp_oldest;
+#endif /* UIP_ARP_HASH */
+
+#if UIP_ARP_QUEUE > 0
+#if defined(UIP_ARP_QUEUE_SECTION) && defined(__GNUC__)
+#define ARP_QUEUE_RAM __attribute__ ((section (UIP_ARP_QUEUE_SECTION)))
+#else
+#define ARP_QUEUE_RAM
+#endif
+/* Outgoing IP packets, without their Ethernet header, waiting for the
+   ARP reply from ipaddr (their next hop). len is 0 for a free one. */
+struct arp_pending {
+  u16_t ipaddr[2];
+  u16_t len;
+  u8_t time;
+  u8_t data[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+static ARP_QUEUE_RAM struct arp_pending arp_queue[UIP_ARP_QUEUE];
+#endif /* UIP_ARP_QUEUE > 0 */
+
+#if UIP_STATISTICS == 1
+struct uip_arp_stats uip_arp_stat;
+#define ARP_STAT(s) s
+#else
+#define ARP_STAT(s)
+#endif /* UIP_STATISTICS == 1 */
 
 #define BUF   ((struct arp_hdr *)&uip_buf[0])
 #define IPBUF ((struct ethip_hdr *)&uip_buf[0])
 /*-----------------------------------------------------------------------------------*/
+#if UIP_ARP_HASH
+static u8_t
+arp_hash_slot(u16_t *ipaddr)
+{
+  /* Fibonacci hashing, as for the connections in uip.c: the top bits
+     of the product are the well mixed ones. */
+  return (u16_t)((ipaddr[0] ^ ipaddr[1]) * 0x9e37u) >> (16 - ARP_HASH_BITS);
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+arp_hash_add(struct arp_entry *tabptr)
+{
+  u8_t j;
+
+  j = arp_hash_slot(tabptr->ipaddr);
+  while(arp_hash[j] != 0) {
+    j = (j + 1) & ARP_HASH_MASK;
+  }
+  arp_hash[j] = (u8_t)(tabptr - arp_table) + 1;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+arp_hash_remove(struct arp_entry *tabptr)
+{
+  u8_t j, k, l, n;
+
+  n = (u8_t)(tabptr - arp_table) + 1;
+  j = arp_hash_slot(tabptr->ipaddr);
+  while(arp_hash[j] != n) {
+    if(arp_hash[j] == 0) {
+      return;
+    }
+    j = (j + 1) & ARP_HASH_MASK;
+  }
+
+  /* Backward shift: move up the entries that probed past the freed
+     slot, so that no probe sequence is cut short. */
+  for(k = (j + 1) & ARP_HASH_MASK; arp_hash[k] != 0;
+      k = (k + 1) & ARP_HASH_MASK) {
+    l = arp_hash_slot(arp_table[arp_hash[k] - 1].ipaddr);
+    if(((k - l) & ARP_HASH_MASK) >= ((k - j) & ARP_HASH_MASK)) {
+      arp_hash[j] = arp_hash[k];
+      j = k;
+    }
+  }
+  arp_hash[j] = 0;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+arp_lru_unlink(struct arp_entry *tabptr)
+{
+  if(tabptr->newer != 0) {
+    arp_table[tabptr->newer - 1].older = tabptr->older;
+  } else {
+    arp_newest = tabptr->older;
+  }
+  if(tabptr->older != 0) {
+    arp_table[tabptr->older - 1].newer = tabptr->newer;
+  } else {
+    arp_oldest = tabptr->newer;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+arp_lru_newest(struct arp_entry *tabptr)
+{
+  u8_t n;
+
+  n = (u8_t)(tabptr - arp_table) + 1;
+  tabptr->newer = 0;
+  tabptr->older = arp_newest;
+  if(arp_newest != 0) {
+    arp_table[arp_newest - 1].newer = n;
+  } else {
+    arp_oldest = n;
+  }
+  arp_newest = n;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+arp_lru_oldest(struct arp_entry *tabptr)
+{
+  u8_t n;
+
+  n = (u8_t)(tabptr - arp_table) + 1;
+  tabptr->older = 0;
+  tabptr->newer = arp_oldest;
+  if(arp_oldest != 0) {
+    arp_table[arp_oldest - 1].older = n;
+  } else {
+    arp_newest = n;
+  }
+  arp_oldest = n;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+arp_lru_use(struct arp_entry *tabptr)
+{
+  if(tabptr->newer != 0) {
+    arp_lru_unlink(tabptr);
+    arp_lru_newest(tabptr);
+  }
+}
+#endif /* UIP_ARP_HASH */
+/*-----------------------------------------------------------------------------------*/
+static struct arp_entry *
+arp_find(u16_t *ipaddr)
+{
+#if UIP_ARP_HASH
+  u8_t j;
+
+  for(j = arp_hash_slot(ipaddr); arp_hash[j] != 0;
+      j = (j + 1) & ARP_HASH_MASK) {
+    if(uip_ipaddr_cmp(arp_table[arp_hash[j] - 1].ipaddr, ipaddr)) {
+      return &arp_table[arp_hash[j] - 1];
+    }
+  }
+#else /* UIP_ARP_HASH */
+  for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
+    if(uip_ipaddr_cmp(arp_table[i].ipaddr, ipaddr)) {
+      return &arp_table[i];
+    }
+  }
+#endif /* UIP_ARP_HASH */
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+#if UIP_ARP_QUEUE > 0
+/* Keep the IP packet in uip_buf until ipaddr answers the ARP request,
+   in place of an older packet for the same address or, if all are
+   taken, of the one kept longest. */
+static void
+arp_queue_add(u16_t *ipaddr)
+{
+  struct arp_pending *q, *p;
+
+  p = NULL;
+  for(q = arp_queue; q < &arp_queue[UIP_ARP_QUEUE]; ++q) {
+    if(q->len != 0 && uip_ipaddr_cmp(q->ipaddr, ipaddr)) {
+      p = q;
+      break;
+    }
+    if(p == NULL || (p->len != 0 &&
+		     (q->len == 0 ||
+		      (u8_t)(arptime - q->time) > (u8_t)(arptime - p->time)))) {
+      p = q;
+    }
+  }
+  if(p->len != 0) {
+    ARP_STAT(++uip_arp_stat.drop);
+  }
+  ARP_STAT(++uip_arp_stat.queued);
+
+  uip_ipaddr_copy(p->ipaddr, ipaddr);
+  p->time = arptime;
+  p->len = uip_len;
+  memcpy(p->data, &uip_buf[UIP_LLH_LEN], uip_len);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Put the packet kept for ipaddr, if any, in uip_buf with an Ethernet
+   header for ethaddr. Both may point into the ARP reply in uip_buf. */
+static void
+arp_queue_send(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
+{
+  struct arp_pending *q;
+
+  for(q = arp_queue; q < &arp_queue[UIP_ARP_QUEUE]; ++q) {
+    if(q->len != 0 && uip_ipaddr_cmp(q->ipaddr, ipaddr)) {
+      memcpy(IPBUF->ethhdr.dest.addr, ethaddr->addr, 6);
+      memcpy(IPBUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
+      IPBUF->ethhdr.type = HTONS(UIP_ETHTYPE_IP);
+      memcpy(&uip_buf[UIP_LLH_LEN], q->data, q->len);
+      uip_len = q->len + sizeof(struct uip_eth_hdr);
+      q->len = 0;
+      return;
+    }
+  }
+}
+#endif /* UIP_ARP_QUEUE > 0 */
+/*-----------------------------------------------------------------------------------*/
 /**
  * Initialize the ARP module.
  *
@@ -153,6 +390,15 @@ uip_arp_init(void)
   for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
     memset(arp_table[i].ipaddr, 0, 4);
   }
+#if UIP_ARP_HASH
+  memset(arp_hash, 0, sizeof(arp_hash));
+  arp_used = arp_newest = arp_oldest = 0;
+#endif /* UIP_ARP_HASH */
+#if UIP_ARP_QUEUE > 0
+  for(i = 0; i < UIP_ARP_QUEUE; ++i) {
+    arp_queue[i].len = 0;
+  }
+#endif /* UIP_ARP_QUEUE > 0 */
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -174,43 +420,69 @@ uip_arp_timer(void)
     tabptr = &arp_table[i];
     if((tabptr->ipaddr[0] | tabptr->ipaddr[1]) != 0 &&
        arptime - tabptr->time >= UIP_ARP_MAXAGE) {
+#if UIP_ARP_HASH
+      arp_hash_remove(tabptr);
+      arp_lru_unlink(tabptr);
+      arp_lru_oldest(tabptr);
+#endif /* UIP_ARP_HASH */
       memset(tabptr->ipaddr, 0, 4);
     }
   }
 
+#if UIP_ARP_QUEUE > 0
+  /* Nobody answered the ARP request of a packet kept since before the
+     previous call. */
+  for(i = 0; i < UIP_ARP_QUEUE; ++i) {
+    if(arp_queue[i].len != 0 &&
+       (u8_t)(arptime - arp_queue[i].time) >= 2) {
+      arp_queue[i].len = 0;
+      ARP_STAT(++uip_arp_stat.drop);
+    }
+  }
+#endif /* UIP_ARP_QUEUE > 0 */
 }
 /*-----------------------------------------------------------------------------------*/
 static void
 uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
 {
   register struct arp_entry *tabptr;
-  /* Walk through the ARP mapping table and try to find an entry to
-     update. If none is found, the IP -> MAC address mapping is
-     inserted in the ARP table. */
-  for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
-
-    tabptr = &arp_table[i];
-    /* Only check those entries that are actually in use. */
-    if(tabptr->ipaddr[0] != 0 &&
-       tabptr->ipaddr[1] != 0) {
 
-      /* Check if the source IP address of the incoming packet matches
-         the IP address in this ARP table entry. */
-      if(ipaddr[0] == tabptr->ipaddr[0] &&
-	 ipaddr[1] == tabptr->ipaddr[1]) {
-
-	/* An old entry found, update this and return. */
-	memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
-	tabptr->time = arptime;
+  /* 0.0.0.0 marks the unused entries; it comes from hosts probing
+     for an address, and there is nothing to send it. */
+  if((ipaddr[0] | ipaddr[1]) == 0) {
+    return;
+  }
 
-	return;
-      }
-    }
+  /* Look for an entry to update. If none is found, the IP -> MAC
+     address mapping is inserted in the ARP table. */
+  tabptr = arp_find(ipaddr);
+  if(tabptr != NULL) {
+    /* An old entry found, update this and return. */
+    memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
+    tabptr->time = arptime;
+#if UIP_ARP_HASH
+    arp_lru_use(tabptr);
+#endif /* UIP_ARP_HASH */
+    return;
   }
 
   /* If we get here, no existing ARP table entry was found, so we
      create one. */
-
+#if UIP_ARP_HASH
+  /* A never used entry while there are some, then the least recently
+     used one, which is an unused one if any timed out. */
+  if(arp_used < UIP_ARPTAB_SIZE) {
+    tabptr = &arp_table[arp_used++];
+  } else {
+    tabptr = &arp_table[arp_oldest - 1];
+    arp_lru_unlink(tabptr);
+    if((tabptr->ipaddr[0] | tabptr->ipaddr[1]) != 0) {
+      arp_hash_remove(tabptr);
+      ARP_STAT(++uip_arp_stat.evict);
+    }
+  }
+  arp_lru_newest(tabptr);
+#else /* UIP_ARP_HASH */
   /* First, we try to find an unused entry in the ARP table. */
   for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
     tabptr = &arp_table[i];
@@ -234,13 +506,18 @@ uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
     }
     i = c;
     tabptr = &arp_table[i];
+    ARP_STAT(++uip_arp_stat.evict);
   }
+#endif /* UIP_ARP_HASH */
 
-  /* Now, i is the ARP table entry which we will fill with the new
-     information. */
+  /* Now, tabptr is the ARP table entry which we will fill with the
+     new information. */
   memcpy(tabptr->ipaddr, ipaddr, 4);
   memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
   tabptr->time = arptime;
+#if UIP_ARP_HASH
+  arp_hash_add(tabptr);
+#endif /* UIP_ARP_HASH */
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -342,6 +619,10 @@ uip_arp_arpin(void)
        for us. */
     if(uip_ipaddr_cmp(BUF->dipaddr, uip_hostaddr)) {
       uip_arp_update(BUF->sipaddr, &BUF->shwaddr);
+#if UIP_ARP_QUEUE > 0
+      /* And send the packet that waited for it. */
+      arp_queue_send(BUF->sipaddr, &BUF->shwaddr);
+#endif /* UIP_ARP_QUEUE > 0 */
     }
     break;
   }
@@ -403,16 +684,15 @@ uip_arp_out(void)
       uip_ipaddr_copy(ipaddr, IPBUF->destipaddr);
     }
 
-    for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
-      tabptr = &arp_table[i];
-      if(uip_ipaddr_cmp(ipaddr, tabptr->ipaddr)) {
-	break;
-      }
-    }
-
-    if(i == UIP_ARPTAB_SIZE) {
+    tabptr = arp_find(ipaddr);
+    if(tabptr == NULL) {
       /* The destination address was not in our ARP table, so we
-	 overwrite the IP packet with an ARP request. */
+	 overwrite the IP packet with an ARP request (after keeping a
+	 copy, with UIP_ARP_QUEUE). */
+      ARP_STAT(++uip_arp_stat.miss);
+#if UIP_ARP_QUEUE > 0
+      arp_queue_add(ipaddr);
+#endif /* UIP_ARP_QUEUE > 0 */
 
       memset(BUF->ethhdr.dest.addr, 0xff, 6);
       memset(BUF->dhwaddr.addr, 0x00, 6);
@@ -434,6 +714,11 @@ uip_arp_out(void)
       return;
     }
 
+    ARP_STAT(++uip_arp_stat.hit);
+#if UIP_ARP_HASH
+    arp_lru_use(tabptr);
+#endif /* UIP_ARP_HASH */
+
     /* Build an ethernet header. */
     memcpy(IPBUF->ethhdr.dest.addr, tabptr->ethaddr.addr, 6);
   }
@@ -444,6 +729,46 @@ uip_arp_out(void)
   uip_len += sizeof(struct uip_eth_hdr);
 }
 /*-----------------------------------------------------------------------------------*/
+/**
+ * Find the Ethernet MAC address that IP packets to an IP address go
+ * to, for a sender that builds its own Ethernet header instead of
+ * calling uip_arp_out() on uip_buf[].
+ *
+ * Like uip_arp_out(), this is the address of the default router when
+ * the IP address is not on the local network, and the broadcast
+ * address for the local broadcast IP address.
+ *
+ * \param addr The destination IP address.
+ *
+ * \return The MAC address, or NULL if it is not in the ARP table. The
+ * sender should then pass the packet to uip_arp_out(), which sends
+ * the ARP request in its place.
+ */
+/*-----------------------------------------------------------------------------------*/
+const struct uip_eth_addr *
+uip_arp_lookup(u16_t *addr)
+{
+  struct arp_entry *tabptr;
+
+  if(uip_ipaddr_cmp(addr, broadcast_ipaddr)) {
+    return &broadcast_ethaddr;
+  }
+  if(!uip_ipaddr_maskcmp(addr, uip_hostaddr, uip_netmask)) {
+    addr = (u16_t *)uip_draddr;
+  }
+
+  tabptr = arp_find(addr);
+  if(tabptr == NULL) {
+    return NULL;
+  }
+
+  ARP_STAT(++uip_arp_stat.hit);
+#if UIP_ARP_HASH
+  arp_lru_use(tabptr);
+#endif /* UIP_ARP_HASH */
+  return &tabptr->ethaddr;
+}
+/*-----------------------------------------------------------------------------------*/
 
 /** @} */
 /** @} */
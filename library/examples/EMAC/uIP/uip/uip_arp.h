@@ -101,7 +101,8 @@ void uip_arp_ipin(void);
    Ethernet frame is present in the uip_buf buffer. When the
    uip_arp_arpin() function returns, the contents of the uip_buf
    buffer should be sent out on the Ethernet if the uip_len variable
-   is > 0. */
+   is > 0: either the reply to an ARP request, or, with UIP_ARP_QUEUE,
+   the IP packet kept for the host whose ARP reply this was. */
 void uip_arp_arpin(void);
 
 /* The uip_arp_out() function should be called when an IP packet
@@ -112,14 +113,42 @@ void uip_arp_arpin(void);
    address (or the IP address of the default router) is present. If no
    such table entry is found, the IP packet is overwritten with an ARP
    request and we rely on TCP to retransmit the packet that was
-   overwritten. In any case, the uip_len variable holds the length of
-   the Ethernet frame that should be transmitted. */
+   overwritten, unless UIP_ARP_QUEUE keeps it for uip_arp_arpin(). In
+   any case, the uip_len variable holds the length of the Ethernet
+   frame that should be transmitted. */
 void uip_arp_out(void);
 
+/* The uip_arp_lookup() function returns the Ethernet address that
+   uip_arp_out() would put in front of an IP packet to the given
+   address, or NULL if that needs an ARP request first. It is for
+   senders that build the Ethernet header themselves, such as frames
+   sent without copying them into uip_buf. */
+const struct uip_eth_addr *uip_arp_lookup(u16_t *addr);
+
 /* The uip_arp_timer() function should be called every ten seconds. It
    is responsible for flushing old entries in the ARP table. */
 void uip_arp_timer(void);
 
+#if UIP_STATISTICS == 1
+/**
+ * The ARP statistics that are gathered if UIP_STATISTICS is set to 1.
+ */
+struct uip_arp_stats {
+  uip_stats_t hit;      /**< Number of outgoing IP packets whose
+			   destination was in the ARP table. */
+  uip_stats_t miss;     /**< Number of outgoing IP packets replaced
+			   by an ARP request. */
+  uip_stats_t evict;    /**< Number of ARP table entries in use taken
+			   for another address. */
+  uip_stats_t queued;   /**< Number of outgoing IP packets kept until
+			   the ARP reply (UIP_ARP_QUEUE). */
+  uip_stats_t drop;     /**< Number of kept packets replaced by a
+			   later one or dropped for lack of a reply. */
+};
+
+extern struct uip_arp_stats uip_arp_stat;
+#endif /* UIP_STATISTICS == 1 */
+
 /** @} */
 
 /**
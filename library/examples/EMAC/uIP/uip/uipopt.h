@@ -265,6 +265,24 @@
 #define UIP_LISTENPORTS UIP_CONF_MAX_LISTENPORTS
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * Determines if incoming TCP segments are matched to their connection
+ * through a hash index instead of a scan of all connections.
+ *
+ * The index is an open addressed table of at least twice UIP_CONNS
+ * bytes, keyed on the remote address and both ports, plus a 32 byte
+ * bitmap of the listening ports that rejects most SYNs to closed
+ * ports without looking at uip_listenports[]. Worth it with tens of
+ * connections.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONN_HASH
+#define UIP_CONN_HASH UIP_CONF_CONN_HASH
+#else /* UIP_CONF_CONN_HASH */
+#define UIP_CONN_HASH 0
+#endif /* UIP_CONF_CONN_HASH */
+
 /**
  * Determines if support for TCP urgent data notification should be
  * compiled in.
@@ -323,6 +341,54 @@
 #define UIP_RECEIVE_WINDOW UIP_CONF_RECEIVE_WINDOW
 #endif
 
+/**
+ * The number of TCP segments a connection may have in flight.
+ *
+ * With the default of 1 uIP waits for every segment to be
+ * acknowledged before the application may send the next one, which
+ * against a peer that delays its ACKs costs a delayed ACK timeout per
+ * segment. With more than 1 the data sent by the application is
+ * copied to a send buffer (see UIP_TCP_SNDBUF) and reported to the
+ * application as acknowledged right away, so that it produces the
+ * next segment; uIP retransmits from the buffer. The application
+ * gets UIP_ACKDATA on its next call, from uip_poll_conn(), the
+ * periodic timer or incoming data, so the device driver should keep
+ * calling uip_poll_conn() after a packet has been sent for as long
+ * as uip_window_open() is true.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_WINDOW
+#define UIP_TCP_WINDOW UIP_CONF_TCP_WINDOW
+#else /* UIP_CONF_TCP_WINDOW */
+#define UIP_TCP_WINDOW 1
+#endif /* UIP_CONF_TCP_WINDOW */
+
+/**
+ * The number of send buffers, shared by all TCP connections, when
+ * UIP_TCP_WINDOW is more than 1.
+ *
+ * Each buffer takes UIP_TCP_MSS + 2 bytes of memory and holds one
+ * segment until it is acknowledged.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SNDBUF
+#define UIP_TCP_SNDBUF UIP_CONF_TCP_SNDBUF
+#else /* UIP_CONF_TCP_SNDBUF */
+#define UIP_TCP_SNDBUF (2 * UIP_TCP_WINDOW)
+#endif /* UIP_CONF_TCP_SNDBUF */
+
+/**
+ * Linker section of the send buffers, if they should not go with the
+ * rest of the data.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SNDBUF_SECTION
+#define UIP_TCP_SNDBUF_SECTION UIP_CONF_TCP_SNDBUF_SECTION
+#endif /* UIP_CONF_TCP_SNDBUF_SECTION */
+
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
@@ -353,6 +419,55 @@
 #define UIP_ARPTAB_SIZE 8
 #endif
 
+/**
+ * Hash index and LRU list for the ARP table.
+ *
+ * Without it every outgoing packet, and every incoming one from the
+ * local network, walks the whole table, and a new mapping takes the
+ * entry refreshed longest ago after one more walk. With it a lookup
+ * is a hash probe and a new mapping takes the least recently used
+ * entry, looked up or refreshed. Costs two bytes per entry and an
+ * index of twice as many bytes as entries, rounded up to a power of
+ * two; UIP_ARPTAB_SIZE may be at most 254.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_HASH
+#define UIP_ARP_HASH UIP_CONF_ARP_HASH
+#else /* UIP_CONF_ARP_HASH */
+#define UIP_ARP_HASH 0
+#endif /* UIP_CONF_ARP_HASH */
+
+/**
+ * The number of outgoing IP packets kept while their ARP request is
+ * outstanding.
+ *
+ * With 0 a packet to an address not in the ARP table is overwritten
+ * by the ARP request, and is lost until TCP retransmits it (a UDP
+ * datagram is lost for good). Otherwise it is copied aside, at a cost
+ * of UIP_BUFSIZE bytes per packet, and uip_arp_arpin() puts it back
+ * in uip_buf when the reply arrives. One packet is kept per address,
+ * the latest; kept packets that get no reply are dropped by the next
+ * but one call to uip_arp_timer().
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_QUEUE
+#define UIP_ARP_QUEUE UIP_CONF_ARP_QUEUE
+#else /* UIP_CONF_ARP_QUEUE */
+#define UIP_ARP_QUEUE 0
+#endif /* UIP_CONF_ARP_QUEUE */
+
+/**
+ * Linker section of the packets kept by UIP_ARP_QUEUE, if they should
+ * not go with the rest of the data.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_QUEUE_SECTION
+#define UIP_ARP_QUEUE_SECTION UIP_CONF_ARP_QUEUE_SECTION
+#endif /* UIP_CONF_ARP_QUEUE_SECTION */
+
 /**
  * The maxium age of ARP table entries measured in 10ths of seconds.
  *
@@ -0,0 +1,27 @@
+#include "clock-arch.h"
+#include "tapdev.h"
+
+#include <time.h>
+
+static struct timespec start;
+
+/* Timer init */
+void clock_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &start);
+}
+
+/* returned The current clock time, measured in system ticks. When a pcap
+ * file is replayed the time is the one of the frames, not the host's. */
+clock_time_t clock_time(void)
+{
+	struct timespec now;
+
+	if (tapdev_replaying()) {
+		return (clock_time_t)(tapdev_replay_time() / (1000000 / CLOCK_CONF_SECOND));
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (clock_time_t)((now.tv_sec - start.tv_sec) * CLOCK_CONF_SECOND +
+			(now.tv_nsec - start.tv_nsec) / (1000000000 / CLOCK_CONF_SECOND));
+}
@@ -0,0 +1,10 @@
+#ifndef __CLOCK_ARCH_H__
+#define __CLOCK_ARCH_H__
+
+#include "lpc_types.h"
+
+typedef unsigned int clock_time_t;
+
+#define CLOCK_CONF_SECOND 100	// tick number every second, as on the board
+
+#endif /* __CLOCK_ARCH_H__ */
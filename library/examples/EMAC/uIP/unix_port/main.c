@@ -0,0 +1,326 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include "clock-arch.h"
+#include "ptsched.h"
+#include "uip-conf.h"
+#include "uipopt.h"
+#include "uip_arp.h"
+#include "uip.h"
+#include "tapdev.h"
+#include "lpc_types.h"
+
+
+#define BUF ((struct uip_eth_hdr *)&uip_buf[0])
+
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig)
+{
+	stop = 1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t ifname | -r in.pcap] [-w out.pcap] [-u port]\n"
+		"  -t ifname   use the TAP interface ifname (default tap0)\n"
+		"  -r in.pcap  replay the frames of a capture instead, then exit\n"
+		"  -w out.pcap also write every frame received and sent\n"
+		"  -u port     send telemetry datagrams (a ramp of samples) to\n"
+		"              192.168.0.1:port every 0.5 s\n", prog);
+	exit(2);
+}
+
+/*************************************************************************
+ * Function Name: uip_log
+ * Parameters: none
+ *
+ * Return: none
+ *
+ * Description: Events logging
+ *
+ *************************************************************************/
+void uip_log (char *m)
+{
+	fprintf(stderr, "uIP log message: %s\n", m);
+}
+
+#if UIP_UDP
+/* Frames of the telemetry application, see apps/telemetry */
+int telemetry_output(const void *hdr, u16_t hlen, const void *data, u16_t dlen)
+{
+	return tapdev_send2(hdr, hlen, data, dlen);
+}
+#endif /* UIP_UDP */
+
+/* uIP timers, as scheduler tasks. Each TCP connection has a task, posted
+ * by the main loop when a segment for it comes in, and two timers, armed
+ * only while the connection needs them: conn_timer for uip_periodic()
+ * every 0.5 s while it has data in flight or waits in TIME_WAIT or
+ * FIN_WAIT_2, poll_timer for the poll its application asks for with
+ * uip_poll_request(). An idle connection has neither and costs nothing
+ * until its next segment. uip_arp_timer() runs every 10 s, and with -u
+ * the telemetry ramp every 0.5 s.
+ *
+ * UDP connections have no timer: the telemetry ramp is sent by its own
+ * task, uip_udp_periodic() has nothing to do. */
+static struct ptsched_task conn_task[UIP_CONNS], arp_task;
+static struct ptsched_timer conn_timer[UIP_CONNS], poll_timer[UIP_CONNS];
+static struct ptsched_timer arp_timer;
+static unsigned char conn_armed[UIP_CONNS], poll_armed[UIP_CONNS];
+
+/* Called by the application of uip_conn, see UIP_CONF_POLL_REQUEST */
+void uip_port_poll_request(struct uip_conn *conn, clock_time_t ticks)
+{
+	UNS_32 i = conn - uip_conns;
+
+	ptsched_timer_set(&poll_timer[i], &conn_task[i], ticks);
+	poll_armed[i] = 1;
+}
+
+/* Runs to the end each time it is posted: by the main loop after a
+ * segment for the connection, or by one of its timers */
+static PT_THREAD(conn_thread(struct ptsched_task *t))
+{
+	UNS_32 i = t - conn_task;
+	struct uip_conn *conn = &uip_conns[i];
+
+	PT_BEGIN(&t->pt);
+	if (conn_armed[i] && ptsched_timer_expired(&conn_timer[i])) {
+		conn_armed[i] = 0;
+		if (uip_conn_active(i)) {
+			uip_periodic(i);
+			/* If the above function invocation resulted in data that
+			   should be sent out on the network, the global variable
+			   uip_len is set to a value > 0. */
+			if (uip_len > 0) {
+				uip_arp_out();
+				tapdev_send(uip_buf,uip_len);
+			}
+		}
+	}
+	if (poll_armed[i] && ptsched_timer_expired(&poll_timer[i])) {
+		poll_armed[i] = 0;
+		if (uip_conn_active(i)) {
+			uip_poll_conn(conn);
+			while (uip_len > 0) {
+				uip_arp_out();
+				tapdev_send(uip_buf,uip_len);
+				if (!uip_window_open(conn)) {
+					break;
+				}
+				uip_poll_conn(conn);
+			}
+		}
+	}
+
+	/* Retransmissions and the TIME_WAIT timeout need uip_periodic() */
+	if (uip_conn_active(i) && (uip_outstanding(conn)
+			|| conn->tcpstateflags == UIP_TIME_WAIT
+			|| conn->tcpstateflags == UIP_FIN_WAIT_2)) {
+		if (!conn_armed[i]) {
+			ptsched_timer_set(&conn_timer[i], t, CLOCK_SECOND / 2);
+			conn_armed[i] = 1;
+		}
+	} else if (conn_armed[i]) {
+		ptsched_timer_stop(&conn_timer[i]);
+		conn_armed[i] = 0;
+	}
+	if (!uip_conn_active(i) && poll_armed[i]) {
+		ptsched_timer_stop(&poll_timer[i]);
+		poll_armed[i] = 0;
+	}
+	PT_END(&t->pt);
+}
+
+static PT_THREAD(arp_thread(struct ptsched_task *t))
+{
+	PT_BEGIN(&t->pt);
+	ptsched_timer_set(&arp_timer, t, CLOCK_SECOND * 10);
+	while (1) {
+		PT_WAIT_UNTIL(&t->pt, ptsched_timer_expired(&arp_timer));
+		ptsched_timer_reset(&arp_timer);
+		uip_arp_timer();
+	}
+	PT_END(&t->pt);
+}
+
+#if UIP_UDP
+static struct ptsched_task telemetry_task;
+static struct ptsched_timer telemetry_timer;
+
+static PT_THREAD(telemetry_thread(struct ptsched_task *t))
+{
+	static u16_t samples[256];
+	UNS_32 i;
+
+	PT_BEGIN(&t->pt);
+	ptsched_timer_set(&telemetry_timer, t, CLOCK_SECOND / 2);
+	while (1) {
+		PT_WAIT_UNTIL(&t->pt, ptsched_timer_expired(&telemetry_timer));
+		ptsched_timer_reset(&telemetry_timer);
+		for (i = 0; i < sizeof(samples) / sizeof(samples[0]); i++) {
+			samples[i]++;
+		}
+		telemetry_send(samples, sizeof(samples));
+	}
+	PT_END(&t->pt);
+}
+#endif /* UIP_UDP */
+
+/* Print the uIP counters, the host has no debug UART to watch them on */
+static void print_stats(void)
+{
+#if UIP_STATISTICS
+	fprintf(stderr, "ip   recv %u sent %u drop %u chkerr %u\n",
+			uip_stat.ip.recv, uip_stat.ip.sent, uip_stat.ip.drop, uip_stat.ip.chkerr);
+	fprintf(stderr, "icmp recv %u sent %u drop %u\n",
+			uip_stat.icmp.recv, uip_stat.icmp.sent, uip_stat.icmp.drop);
+#if UIP_UDP
+	fprintf(stderr, "udp  recv %u sent %u drop %u chkerr %u\n",
+			uip_stat.udp.recv, uip_stat.udp.sent, uip_stat.udp.drop, uip_stat.udp.chkerr);
+#endif /* UIP_UDP */
+	fprintf(stderr, "tcp  recv %u sent %u drop %u rexmit %u rst %u syndrop %u\n",
+			uip_stat.tcp.recv, uip_stat.tcp.sent, uip_stat.tcp.drop,
+			uip_stat.tcp.rexmit, uip_stat.tcp.rst, uip_stat.tcp.syndrop);
+	fprintf(stderr, "arp  hit %u miss %u evict %u queued %u drop %u\n",
+			uip_arp_stat.hit, uip_arp_stat.miss, uip_arp_stat.evict,
+			uip_arp_stat.queued, uip_arp_stat.drop);
+#endif /* UIP_STATISTICS */
+}
+
+/*************************************************************************
+ * Function Name: main
+ * Parameters: none
+ *
+ * Return: none
+ *
+ * Description: main, the loop of lpc17xx_port/main.c on a TAP or a
+ *              replayed capture
+ *
+ *************************************************************************/
+int main(int argc, char **argv)
+{
+	uip_ipaddr_t ipaddr;
+	const char *ifname = "tap0", *replay = NULL, *capture = NULL;
+	int i, opt, telemetry_port = 0;
+
+	while ((opt = getopt(argc, argv, "t:r:w:u:")) != -1) {
+		switch (opt) {
+		case 't': ifname = optarg; break;
+		case 'r': replay = optarg; break;
+		case 'w': capture = optarg; break;
+		case 'u': telemetry_port = atoi(optarg); break;
+		default: usage(argv[0]);
+		}
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	clock_init();
+
+	// Initialize the network device: TAP or capture file
+	if (capture != NULL && !tapdev_open_capture(capture)) {
+		return 1;
+	}
+	if (replay != NULL ? !tapdev_open_replay(replay) : !tapdev_open_tap(ifname)) {
+		return 1;
+	}
+
+	// Initialize the uIP TCP/IP stack.
+	uip_init();
+
+	uip_ethaddr.addr[0] = EMAC_ADDR0;
+	uip_ethaddr.addr[1] = EMAC_ADDR1;
+	uip_ethaddr.addr[2] = EMAC_ADDR2;
+	uip_ethaddr.addr[3] = EMAC_ADDR3;
+	uip_ethaddr.addr[4] = EMAC_ADDR4;
+	uip_ethaddr.addr[5] = EMAC_ADDR5;
+	uip_setethaddr(uip_ethaddr);
+
+	// Same addresses as the board
+	uip_ipaddr(ipaddr, 192,168,0,100);
+	uip_sethostaddr(ipaddr);
+	uip_ipaddr(ipaddr, 192,168,0,1);
+	uip_setdraddr(ipaddr);
+	uip_ipaddr(ipaddr, 255,255,255,0);
+	uip_setnetmask(ipaddr);
+
+	// Initialize the HTTP server ----------------------------
+	httpd_init();
+#if UIP_UDP
+	if (telemetry_port > 0) {
+		uip_ipaddr(ipaddr, 192,168,0,1);
+		telemetry_init(ipaddr, htons(telemetry_port));
+	}
+#endif /* UIP_UDP */
+
+	ptsched_init();
+	for (i = 0; i < UIP_CONNS; i++) {
+		ptsched_task_init(&conn_task[i], conn_thread, NULL);
+	}
+	ptsched_task_init(&arp_task, arp_thread, NULL);
+	ptsched_post(&arp_task);
+#if UIP_UDP
+	if (telemetry_port > 0) {
+		ptsched_task_init(&telemetry_task, telemetry_thread, NULL);
+		ptsched_post(&telemetry_task);
+	}
+#endif /* UIP_UDP */
+
+  while(!stop && !tapdev_done())
+  {
+    uip_len = tapdev_read(uip_buf);
+    if(uip_len > 0)
+    {
+      if(BUF->type == htons(UIP_ETHTYPE_IP))
+      {
+	      uip_arp_ipin();
+	      uip_input();
+	      /* Its connection may need its timers set or stopped */
+	      if(uip_conn != NULL)
+	      {
+	        ptsched_post(&conn_task[uip_conn - uip_conns]);
+	      }
+	      /* If the above function invocation resulted in data that
+	         should be sent out on the network, the global variable
+	         uip_len is set to a value > 0. */
+
+	      while(uip_len > 0)
+        {
+	        uip_arp_out();
+	        tapdev_send(uip_buf,uip_len);
+	        /* With UIP_TCP_WINDOW > 1 the connection may send more
+	           segments before the first one is acknowledged. */
+	        if(uip_conn == NULL || !uip_window_open(uip_conn))
+	        {
+	          break;
+	        }
+	        uip_poll_conn(uip_conn);
+	      }
+      }
+      else if(BUF->type == htons(UIP_ETHTYPE_ARP))
+      {
+        uip_arp_arpin();
+	      /* If the above function invocation resulted in data that
+	         should be sent out on the network, the global variable
+	         uip_len is set to a value > 0. */
+	      if(uip_len > 0)
+        {
+	        tapdev_send(uip_buf,uip_len);
+	      }
+      }
+    }
+    /* tapdev_read() has waited for a frame already, up to
+       TAPDEV_POLL_US, or has moved the replay clock to the next one */
+    ptsched_run();
+  }
+
+	print_stats();
+	return 0;
+}
@@ -0,0 +1,290 @@
+#include "tapdev.h"
+#include "clock-arch.h"
+#include "uip-conf.h"
+#include "uipopt.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/select.h>
+#include <sys/time.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+
+/* How long tapdev_read() waits for a frame before handing control back
+ * to the main loop, i.e. one clock tick */
+#define TAPDEV_POLL_US		(1000000 / CLOCK_CONF_SECOND)
+
+#define PCAP_MAGIC			0xa1b2c3d4	// microsecond timestamps
+#define PCAP_MAGIC_NS		0xa1b23c4d	// nanosecond timestamps
+#define PCAP_LINKTYPE_ETH	1
+
+/* Timestamps before this (one year, in us) are time since the firmware
+ * started, as written by tapdev_open_capture(); later ones are wall
+ * clock time, as written by tcpdump */
+#define PCAP_WALLCLOCK_US	(365ULL * 24 * 3600 * 1000000)
+
+struct pcap_file_hdr {
+	uint32_t magic;
+	uint16_t version_major;
+	uint16_t version_minor;
+	int32_t  thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t network;
+};
+
+struct pcap_rec_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_frac;
+	uint32_t incl_len;
+	uint32_t orig_len;
+};
+
+static int tap_fd = -1;
+static FILE *replay_file;
+static FILE *capture_file;
+
+/* Replay state: the next frame is read ahead so its time is known
+ * before it is due */
+static BOOL_8 replay_swap, replay_ns, replay_eof, replay_started;
+static UNS_64 replay_base, replay_now, replay_next;
+static UNS_64 capture_start;
+static UNS_32 replay_len;
+static uint8_t replay_frame[UIP_CONF_BUFFER_SIZE];
+
+static const uint8_t own_mac[6] = {
+	EMAC_ADDR0, EMAC_ADDR1, EMAC_ADDR2, EMAC_ADDR3, EMAC_ADDR4, EMAC_ADDR5
+};
+
+static uint32_t pcap32(uint32_t v)
+{
+	if (replay_swap) {
+		v = (v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24);
+	}
+	return v;
+}
+
+/* Read ahead the next frame not sent by the firmware itself */
+static void replay_fetch(void)
+{
+	struct pcap_rec_hdr rec;
+	UNS_64 t;
+	UNS_32 len;
+
+	while (fread(&rec, sizeof(rec), 1, replay_file) == 1) {
+		len = pcap32(rec.incl_len);
+		t = (UNS_64)pcap32(rec.ts_sec) * 1000000 +
+			(replay_ns ? pcap32(rec.ts_frac) / 1000 : pcap32(rec.ts_frac));
+		if (len > sizeof(replay_frame)) {
+			fprintf(stderr, "tapdev: %u byte frame in replay file, skipped\n", len);
+			fseek(replay_file, len, SEEK_CUR);
+			continue;
+		}
+		if (fread(replay_frame, 1, len, replay_file) != len) {
+			break;
+		}
+		if (len < 14 || memcmp(&replay_frame[6], own_mac, 6) == 0) {
+			continue;
+		}
+		if (!replay_started) {
+			replay_started = TRUE;
+			replay_base = (t >= PCAP_WALLCLOCK_US) ? t : 0;
+		}
+		replay_next = t - replay_base;
+		replay_len = len;
+		return;
+	}
+	replay_eof = TRUE;
+}
+
+static void capture_write(const void *pPacket, UNS_32 size)
+{
+	struct pcap_rec_hdr rec;
+	struct timeval tv;
+	UNS_64 t;
+
+	if (replay_file != NULL) {
+		t = replay_now;
+	} else {
+		gettimeofday(&tv, NULL);
+		t = (UNS_64)tv.tv_sec * 1000000 + tv.tv_usec - capture_start;
+	}
+	rec.ts_sec = (uint32_t)(t / 1000000);
+	rec.ts_frac = (uint32_t)(t % 1000000);
+	rec.incl_len = size;
+	rec.orig_len = size;
+	fwrite(&rec, sizeof(rec), 1, capture_file);
+	fwrite(pPacket, 1, size, capture_file);
+}
+
+BOOL_8 tapdev_open_tap(const char *ifname)
+{
+	struct ifreq ifr;
+
+	tap_fd = open("/dev/net/tun", O_RDWR);
+	if (tap_fd < 0) {
+		perror("tapdev: /dev/net/tun");
+		return FALSE;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	if (ioctl(tap_fd, TUNSETIFF, &ifr) < 0) {
+		perror("tapdev: TUNSETIFF");
+		close(tap_fd);
+		tap_fd = -1;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+BOOL_8 tapdev_open_replay(const char *path)
+{
+	struct pcap_file_hdr hdr;
+
+	replay_file = fopen(path, "rb");
+	if (replay_file == NULL) {
+		perror(path);
+		return FALSE;
+	}
+	if (fread(&hdr, sizeof(hdr), 1, replay_file) != 1) {
+		fprintf(stderr, "tapdev: %s: not a pcap file\n", path);
+		return FALSE;
+	}
+
+	replay_swap = FALSE;
+	if (hdr.magic != PCAP_MAGIC && hdr.magic != PCAP_MAGIC_NS) {
+		replay_swap = TRUE;
+	}
+	replay_ns = (pcap32(hdr.magic) == PCAP_MAGIC_NS);
+	if (pcap32(hdr.magic) != PCAP_MAGIC && !replay_ns) {
+		fprintf(stderr, "tapdev: %s: not a pcap file (pcapng is not supported)\n", path);
+		return FALSE;
+	}
+	if (pcap32(hdr.network) != PCAP_LINKTYPE_ETH) {
+		fprintf(stderr, "tapdev: %s: link type %u, only Ethernet can be replayed\n",
+				path, pcap32(hdr.network));
+		return FALSE;
+	}
+
+	replay_fetch();
+	return TRUE;
+}
+
+BOOL_8 tapdev_open_capture(const char *path)
+{
+	struct pcap_file_hdr hdr;
+	struct timeval tv;
+
+	capture_file = fopen(path, "wb");
+	if (capture_file == NULL) {
+		perror(path);
+		return FALSE;
+	}
+
+	hdr.magic = PCAP_MAGIC;
+	hdr.version_major = 2;
+	hdr.version_minor = 4;
+	hdr.thiszone = 0;
+	hdr.sigfigs = 0;
+	hdr.snaplen = UIP_CONF_BUFFER_SIZE;
+	hdr.network = PCAP_LINKTYPE_ETH;
+	fwrite(&hdr, sizeof(hdr), 1, capture_file);
+
+	/* Frames are stamped with the time since now, so that a replay of the
+	 * file runs the periodic timers (and the TCP initial sequence numbers
+	 * they advance) in step with this session */
+	gettimeofday(&tv, NULL);
+	capture_start = (UNS_64)tv.tv_sec * 1000000 + tv.tv_usec;
+	return TRUE;
+}
+
+/* Returns the length of the frame copied to pPacket, or 0 if none arrived
+ * within one clock tick. When replaying, a frame is delivered once the
+ * replay clock reaches its timestamp; otherwise the clock advances one
+ * tick, so the periodic timers run as they did in the captured session. */
+UNS_32 tapdev_read(void * pPacket)
+{
+	fd_set fdset;
+	struct timeval tv;
+	ssize_t n;
+
+	if (replay_file != NULL) {
+		if (replay_eof) {
+			return 0;
+		}
+		if (replay_next > replay_now) {
+			replay_now += TAPDEV_POLL_US;
+			if (replay_now > replay_next) {
+				replay_now = replay_next;
+			}
+			return 0;
+		}
+		n = replay_len;
+		memcpy(pPacket, replay_frame, n);
+		replay_fetch();
+	} else {
+		FD_ZERO(&fdset);
+		FD_SET(tap_fd, &fdset);
+		tv.tv_sec = 0;
+		tv.tv_usec = TAPDEV_POLL_US;
+		if (select(tap_fd + 1, &fdset, NULL, NULL, &tv) <= 0) {
+			return 0;
+		}
+		n = read(tap_fd, pPacket, UIP_CONF_BUFFER_SIZE);
+		if (n <= 0) {
+			return 0;
+		}
+	}
+
+	if (capture_file != NULL) {
+		capture_write(pPacket, n);
+	}
+	return n;
+}
+
+BOOL_8 tapdev_send(void *pPacket, UNS_32 size)
+{
+	if (capture_file != NULL) {
+		capture_write(pPacket, size);
+	}
+	if (tap_fd >= 0 && write(tap_fd, pPacket, size) != (ssize_t)size) {
+		perror("tapdev: write");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* The TAP takes one buffer per frame: the two pieces are joined here */
+BOOL_8 tapdev_send2(const void *pHeader, UNS_32 hlen, const void *pData, UNS_32 dlen)
+{
+	static uint8_t frame[UIP_CONF_BUFFER_SIZE];
+
+	if (hlen + dlen > sizeof(frame)) {
+		return FALSE;
+	}
+	memcpy(frame, pHeader, hlen);
+	if (dlen) {
+		memcpy(frame + hlen, pData, dlen);
+	}
+	return tapdev_send(frame, hlen + dlen);
+}
+
+BOOL_8 tapdev_done(void)
+{
+	return replay_file != NULL && replay_eof;
+}
+
+BOOL_8 tapdev_replaying(void)
+{
+	return replay_file != NULL;
+}
+
+UNS_64 tapdev_replay_time(void)
+{
+	return replay_now;
+}
@@ -0,0 +1,40 @@
+#ifndef __TAPDEV_H
+#define __TAPDEV_H
+
+#include "lpc_types.h"
+
+/* Same calls as emac.h on the board, so main.c keeps the loop of
+ * lpc17xx_port/main.c. Frames come either from a Linux TAP interface or
+ * from a pcap file replayed in its own time base (see clock-arch.c). */
+
+/* This is the MAC address of the firmware on the host (locally administered) */
+#define EMAC_ADDR0		0x02
+#define EMAC_ADDR1		0x00
+#define EMAC_ADDR2		0x4C
+#define EMAC_ADDR3		0x50
+#define EMAC_ADDR4		0x43
+#define EMAC_ADDR5		0x17
+
+/* Open the TAP interface ifname (e.g. "tap0"), created if it does not
+ * exist yet. Its host side must be brought up by the user. */
+BOOL_8 tapdev_open_tap(const char *ifname);
+/* Replay the frames of a pcap file (Ethernet link type) instead of a TAP.
+ * Frames sent by the firmware itself (source MAC EMAC_ADDR) are skipped,
+ * so a capture of a live session on the TAP can be fed back as is. */
+BOOL_8 tapdev_open_replay(const char *path);
+/* Also write every frame read and sent to a pcap file */
+BOOL_8 tapdev_open_capture(const char *path);
+
+UNS_32 tapdev_read(void * pPacket);
+BOOL_8 tapdev_send (void *pPacket, UNS_32 size);
+/* A frame in two pieces, as sent by the telemetry application */
+BOOL_8 tapdev_send2(const void *pHeader, UNS_32 hlen, const void *pData, UNS_32 dlen);
+/* TRUE once a replay has delivered its last frame */
+BOOL_8 tapdev_done(void);
+
+/* Replay clock in microseconds: time since the firmware started for files
+ * written by tapdev_open_capture(), since the first frame for others */
+UNS_64 tapdev_replay_time(void);
+BOOL_8 tapdev_replaying(void);
+
+#endif
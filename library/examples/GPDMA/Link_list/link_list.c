@@ -179,7 +179,8 @@ void Error_Loop(void)
  **********************************************************************/
 int c_entry(void)
 {
-	GPDMA_Channel_CFG_Type GPDMACfg;
+	GPDMA_LLI_CFG_Type LLICfg;
+	GPDMA_SEG_Type DMA_Seg[2];
 	GPDMA_LLI_Type DMA_LLI_Struct[2];
 
 	/* Initialize debug via UART0
@@ -203,47 +204,28 @@ int c_entry(void)
     /* Initialize GPDMA controller */
 	GPDMA_Init();
 
-	/* Init GPDMA link list */
-	DMA_LLI_Struct[0].SrcAddr = (uint32_t)&DMASrc_Buffer1;
-	DMA_LLI_Struct[0].DstAddr = (uint32_t)&DMADest_Buffer;
-	DMA_LLI_Struct[0].NextLLI = (uint32_t)&DMA_LLI_Struct[1];
-	DMA_LLI_Struct[0].Control = (DMA_SIZE/2)
-								| (2<<18) //source width 32 bit
-								| (2<<21) //dest. width 32 bit
-								| (1<<26) //source increment
-								| (1<<27)
-								;
-	DMA_LLI_Struct[1].SrcAddr = (uint32_t)&DMASrc_Buffer2;
-	DMA_LLI_Struct[1].DstAddr = ((uint32_t)&DMADest_Buffer) + (DMA_SIZE/2)*4;
-	DMA_LLI_Struct[1].NextLLI = 0;
-	DMA_LLI_Struct[1].Control = (DMA_SIZE/2)
-								| (2<<18) //source width 32 bit
-								| (2<<21) //dest. width 32 bit
-								| (1<<26) //source increment
-								| (1<<27)
-								;
-
-	// Setup GPDMA channel --------------------------------
-	// channel 0
-	GPDMACfg.ChannelNum = 0;
-	// Source memory
-	GPDMACfg.SrcMemAddr = (uint32_t)DMASrc_Buffer1;
-	// Destination memory
-	GPDMACfg.DstMemAddr = (uint32_t)DMADest_Buffer;
-	// Transfer size
-	GPDMACfg.TransferSize = DMA_SIZE;
-	// Transfer width
-	GPDMACfg.TransferWidth = GPDMA_WIDTH_WORD;
-	// Transfer type
-	GPDMACfg.TransferType = GPDMA_TRANSFERTYPE_M2M;
-	// Source connection - unused
-	GPDMACfg.SrcConn = 0;
-	// Destination connection - unused
-	GPDMACfg.DstConn = 0;
-	// Linker List Item
-	GPDMACfg.DMALLI = (uint32_t)&DMA_LLI_Struct[0];
-	// Setup channel with given parameter
-	GPDMA_Setup(&GPDMACfg);
+	/* Init GPDMA link list: gather both source buffers into the destination.
+	 * Only the last item raises the terminal count interrupt */
+	DMA_Seg[0].SrcAddr = (uint32_t)DMASrc_Buffer1;
+	DMA_Seg[0].DstAddr = (uint32_t)DMADest_Buffer;
+	DMA_Seg[0].Count = DMA_SIZE/2;
+	DMA_Seg[1].SrcAddr = (uint32_t)DMASrc_Buffer2;
+	DMA_Seg[1].DstAddr = ((uint32_t)DMADest_Buffer) + (DMA_SIZE/2)*4;
+	DMA_Seg[1].Count = DMA_SIZE/2;
+
+	LLICfg.TransferType = GPDMA_TRANSFERTYPE_M2M;
+	LLICfg.TransferWidth = GPDMA_WIDTH_WORD;
+	LLICfg.SrcConn = 0;
+	LLICfg.DstConn = 0;
+	LLICfg.pSeg = DMA_Seg;
+	LLICfg.NumSeg = 2;
+	LLICfg.Options = 0;
+	if (GPDMA_LLIBuild(DMA_LLI_Struct, 2, &LLICfg) < 0) {
+		Error_Loop();
+	}
+
+	// Setup GPDMA channel 0 with the chain, item 0 is run first
+	GPDMA_SetupLLI(0, &LLICfg, DMA_LLI_Struct);
 
 	/* Reset terminal counter */
 	Channel0_TC = 0;
@@ -0,0 +1,1144 @@
+/**********************************************************************
+* $Id$		sdspi.c					2026-10-17
+*//**
+* @file		sdspi.c
+* @brief	SD/SDHC card block driver in SPI mode over SSP0 or SSP1
+* @version	1.0
+* @date		17. October. 2026
+* @author
+*
+***********************************************************************
+* Software that is described herein is for illustrative purposes only
+* which provides customers with programming information regarding the
+* products. This software is supplied "AS IS" without any warranties.
+* NXP Semiconductors assumes no responsibility or liability for the
+* use of the software, conveys no license or title under any patent,
+* copyright, or mask work right to the product. NXP Semiconductors
+* reserves the right to make changes in the software without
+* notification. NXP Semiconductors also make no representation or
+* warranty that such application will be suitable for the specified
+* use without further testing or modification.
+**********************************************************************/
+/*
+ * The card is identified at SDSPI_CLK_INIT (CMD0, CMD8, ACMD41, CMD58),
+ * CRC checking is turned on with CMD59 and the clock goes up to the
+ * configured rate. From then on every command carries its CRC7 and every
+ * data block its CRC16, both from 256-entry tables.
+ *
+ * Commands and tokens go by polling. The 512 bytes of a data block go by
+ * two GPDMA channels, one feeding the Tx FIFO and one draining the Rx
+ * FIFO, while the CPU computes the CRC16 of the block before (read) or
+ * after (write) the one on the bus. Several blocks are read with one
+ * CMD18 and written with one ACMD23 + CMD25. SDSPI_WriteBlocks() returns
+ * while the card programs the last block: the next command, or
+ * SDSPI_Sync(), waits for it.
+ *
+ * The same commands can be streamed a block at a time, for callers that
+ * do not have all the blocks at once: SDSPI_ReadStart()/SDSPI_WriteStart()
+ * send the command, each SDSPI_ReadNext()/SDSPI_WriteNext() moves one
+ * block, and SDSPI_ReadStop()/SDSPI_WriteStop() end it (early too). The
+ * card stays selected in between.
+ */
+#include "lpc17xx_ssp.h"
+#include "lpc17xx_gpdma.h"
+#include "lpc17xx_gpio.h"
+#include "lpc17xx_pinsel.h"
+#include "lpc17xx_clkpwr.h"
+#include "lpc17xx_libcfg.h"
+#include "sdspi.h"
+
+/************************** PRIVATE DEFINTIONS *********************/
+/* SD commands */
+#define SDSPI_CMD0		0		/* GO_IDLE_STATE */
+#define SDSPI_CMD8		8		/* SEND_IF_COND */
+#define SDSPI_CMD9		9		/* SEND_CSD */
+#define SDSPI_CMD10		10		/* SEND_CID */
+#define SDSPI_CMD12		12		/* STOP_TRANSMISSION */
+#define SDSPI_CMD16		16		/* SET_BLOCKLEN */
+#define SDSPI_CMD17		17		/* READ_SINGLE_BLOCK */
+#define SDSPI_CMD18		18		/* READ_MULTIPLE_BLOCK */
+#define SDSPI_CMD24		24		/* WRITE_BLOCK */
+#define SDSPI_CMD25		25		/* WRITE_MULTIPLE_BLOCK */
+#define SDSPI_CMD55		55		/* APP_CMD */
+#define SDSPI_CMD58		58		/* READ_OCR */
+#define SDSPI_CMD59		59		/* CRC_ON_OFF */
+/* Application commands, sent after CMD55 */
+#define SDSPI_ACMD		0x80
+#define SDSPI_ACMD23	(SDSPI_ACMD | 23)	/* SET_WR_BLK_ERASE_COUNT */
+#define SDSPI_ACMD41	(SDSPI_ACMD | 41)	/* SD_SEND_OP_COND */
+
+/* R1 response */
+#define SDSPI_R1_IDLE		0x01
+#define SDSPI_R1_ILLEGAL	0x04
+#define SDSPI_R1_CRC_ERR	0x08
+#define SDSPI_R1_NONE		0xFF
+
+/* OCR */
+#define SDSPI_OCR_CCS		0x40	/* first byte: card capacity status */
+#define SDSPI_ACMD41_HCS	(1UL << 30)
+
+/* Data tokens */
+#define SDSPI_TOKEN_START	0xFE	/* Read, and single block write */
+#define SDSPI_TOKEN_MULTI	0xFC	/* Multiple block write */
+#define SDSPI_TOKEN_STOP	0xFD	/* Stop multiple block write */
+#define SDSPI_DATA_RESP_MSK	0x1F
+#define SDSPI_DATA_ACCEPTED	0x05
+#define SDSPI_DATA_CRC_ERR	0x0B
+
+/* Timeouts, in bytes polled: CMD0, 1 s of ACMD41 at 400 kHz, the response
+ * of a command (NCR), 100 ms for a read token and 500 ms of busy at 25 MHz */
+#define SDSPI_CMD0_TRIES	10
+#define SDSPI_INIT_TRIES	3000
+#define SDSPI_R1_TRIES		10
+#define SDSPI_TOKEN_TRIES	320000
+#define SDSPI_BUSY_TRIES	1600000
+
+#define SDSPI_SSP_FIFO		8
+
+/** Channel registers of a GPDMA channel */
+#define SDSPI_DMA_CH(n)		((LPC_GPDMACH_TypeDef *)(LPC_GPDMACH0_BASE + ((n) * 0x20)))
+
+/************************** PRIVATE VARIABLES *************************/
+/** CRC7 (x^7 + x^3 + 1) of one byte, in bits 7..1: crc = tab[crc ^ byte] */
+static const uint8_t sdspi_crc7_tab[256] = {
+	0x00, 0x12, 0x24, 0x36, 0x48, 0x5A, 0x6C, 0x7E, 0x90, 0x82, 0xB4, 0xA6, 0xD8, 0xCA, 0xFC, 0xEE,
+	0x32, 0x20, 0x16, 0x04, 0x7A, 0x68, 0x5E, 0x4C, 0xA2, 0xB0, 0x86, 0x94, 0xEA, 0xF8, 0xCE, 0xDC,
+	0x64, 0x76, 0x40, 0x52, 0x2C, 0x3E, 0x08, 0x1A, 0xF4, 0xE6, 0xD0, 0xC2, 0xBC, 0xAE, 0x98, 0x8A,
+	0x56, 0x44, 0x72, 0x60, 0x1E, 0x0C, 0x3A, 0x28, 0xC6, 0xD4, 0xE2, 0xF0, 0x8E, 0x9C, 0xAA, 0xB8,
+	0xC8, 0xDA, 0xEC, 0xFE, 0x80, 0x92, 0xA4, 0xB6, 0x58, 0x4A, 0x7C, 0x6E, 0x10, 0x02, 0x34, 0x26,
+	0xFA, 0xE8, 0xDE, 0xCC, 0xB2, 0xA0, 0x96, 0x84, 0x6A, 0x78, 0x4E, 0x5C, 0x22, 0x30, 0x06, 0x14,
+	0xAC, 0xBE, 0x88, 0x9A, 0xE4, 0xF6, 0xC0, 0xD2, 0x3C, 0x2E, 0x18, 0x0A, 0x74, 0x66, 0x50, 0x42,
+	0x9E, 0x8C, 0xBA, 0xA8, 0xD6, 0xC4, 0xF2, 0xE0, 0x0E, 0x1C, 0x2A, 0x38, 0x46, 0x54, 0x62, 0x70,
+	0x82, 0x90, 0xA6, 0xB4, 0xCA, 0xD8, 0xEE, 0xFC, 0x12, 0x00, 0x36, 0x24, 0x5A, 0x48, 0x7E, 0x6C,
+	0xB0, 0xA2, 0x94, 0x86, 0xF8, 0xEA, 0xDC, 0xCE, 0x20, 0x32, 0x04, 0x16, 0x68, 0x7A, 0x4C, 0x5E,
+	0xE6, 0xF4, 0xC2, 0xD0, 0xAE, 0xBC, 0x8A, 0x98, 0x76, 0x64, 0x52, 0x40, 0x3E, 0x2C, 0x1A, 0x08,
+	0xD4, 0xC6, 0xF0, 0xE2, 0x9C, 0x8E, 0xB8, 0xAA, 0x44, 0x56, 0x60, 0x72, 0x0C, 0x1E, 0x28, 0x3A,
+	0x4A, 0x58, 0x6E, 0x7C, 0x02, 0x10, 0x26, 0x34, 0xDA, 0xC8, 0xFE, 0xEC, 0x92, 0x80, 0xB6, 0xA4,
+	0x78, 0x6A, 0x5C, 0x4E, 0x30, 0x22, 0x14, 0x06, 0xE8, 0xFA, 0xCC, 0xDE, 0xA0, 0xB2, 0x84, 0x96,
+	0x2E, 0x3C, 0x0A, 0x18, 0x66, 0x74, 0x42, 0x50, 0xBE, 0xAC, 0x9A, 0x88, 0xF6, 0xE4, 0xD2, 0xC0,
+	0x1C, 0x0E, 0x38, 0x2A, 0x54, 0x46, 0x70, 0x62, 0x8C, 0x9E, 0xA8, 0xBA, 0xC4, 0xD6, 0xE0, 0xF2
+};
+
+/** CRC16-CCITT (x^16 + x^12 + x^5 + 1) of one byte:
+ * crc = (crc << 8) ^ tab[(crc >> 8) ^ byte] */
+static const uint16_t sdspi_crc16_tab[256] = {
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+	0x1231, 0x0210, 0x3273, 0x2252, 0x52B5, 0x4294, 0x72F7, 0x62D6,
+	0x9339, 0x8318, 0xB37B, 0xA35A, 0xD3BD, 0xC39C, 0xF3FF, 0xE3DE,
+	0x2462, 0x3443, 0x0420, 0x1401, 0x64E6, 0x74C7, 0x44A4, 0x5485,
+	0xA56A, 0xB54B, 0x8528, 0x9509, 0xE5EE, 0xF5CF, 0xC5AC, 0xD58D,
+	0x3653, 0x2672, 0x1611, 0x0630, 0x76D7, 0x66F6, 0x5695, 0x46B4,
+	0xB75B, 0xA77A, 0x9719, 0x8738, 0xF7DF, 0xE7FE, 0xD79D, 0xC7BC,
+	0x48C4, 0x58E5, 0x6886, 0x78A7, 0x0840, 0x1861, 0x2802, 0x3823,
+	0xC9CC, 0xD9ED, 0xE98E, 0xF9AF, 0x8948, 0x9969, 0xA90A, 0xB92B,
+	0x5AF5, 0x4AD4, 0x7AB7, 0x6A96, 0x1A71, 0x0A50, 0x3A33, 0x2A12,
+	0xDBFD, 0xCBDC, 0xFBBF, 0xEB9E, 0x9B79, 0x8B58, 0xBB3B, 0xAB1A,
+	0x6CA6, 0x7C87, 0x4CE4, 0x5CC5, 0x2C22, 0x3C03, 0x0C60, 0x1C41,
+	0xEDAE, 0xFD8F, 0xCDEC, 0xDDCD, 0xAD2A, 0xBD0B, 0x8D68, 0x9D49,
+	0x7E97, 0x6EB6, 0x5ED5, 0x4EF4, 0x3E13, 0x2E32, 0x1E51, 0x0E70,
+	0xFF9F, 0xEFBE, 0xDFDD, 0xCFFC, 0xBF1B, 0xAF3A, 0x9F59, 0x8F78,
+	0x9188, 0x81A9, 0xB1CA, 0xA1EB, 0xD10C, 0xC12D, 0xF14E, 0xE16F,
+	0x1080, 0x00A1, 0x30C2, 0x20E3, 0x5004, 0x4025, 0x7046, 0x6067,
+	0x83B9, 0x9398, 0xA3FB, 0xB3DA, 0xC33D, 0xD31C, 0xE37F, 0xF35E,
+	0x02B1, 0x1290, 0x22F3, 0x32D2, 0x4235, 0x5214, 0x6277, 0x7256,
+	0xB5EA, 0xA5CB, 0x95A8, 0x8589, 0xF56E, 0xE54F, 0xD52C, 0xC50D,
+	0x34E2, 0x24C3, 0x14A0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+	0xA7DB, 0xB7FA, 0x8799, 0x97B8, 0xE75F, 0xF77E, 0xC71D, 0xD73C,
+	0x26D3, 0x36F2, 0x0691, 0x16B0, 0x6657, 0x7676, 0x4615, 0x5634,
+	0xD94C, 0xC96D, 0xF90E, 0xE92F, 0x99C8, 0x89E9, 0xB98A, 0xA9AB,
+	0x5844, 0x4865, 0x7806, 0x6827, 0x18C0, 0x08E1, 0x3882, 0x28A3,
+	0xCB7D, 0xDB5C, 0xEB3F, 0xFB1E, 0x8BF9, 0x9BD8, 0xABBB, 0xBB9A,
+	0x4A75, 0x5A54, 0x6A37, 0x7A16, 0x0AF1, 0x1AD0, 0x2AB3, 0x3A92,
+	0xFD2E, 0xED0F, 0xDD6C, 0xCD4D, 0xBDAA, 0xAD8B, 0x9DE8, 0x8DC9,
+	0x7C26, 0x6C07, 0x5C64, 0x4C45, 0x3CA2, 0x2C83, 0x1CE0, 0x0CC1,
+	0xEF1F, 0xFF3E, 0xCF5D, 0xDF7C, 0xAF9B, 0xBFBA, 0x8FD9, 0x9FF8,
+	0x6E17, 0x7E36, 0x4E55, 0x5E74, 0x2E93, 0x3EB2, 0x0ED1, 0x1EF0
+};
+
+/** What the Tx DMA channel sends while a block is read, and where the Rx
+ * DMA channel drops what comes back while one is written */
+static const uint8_t sdspi_dma_ones = 0xFF;
+static uint8_t sdspi_dma_sink;
+
+/************************** PRIVATE FUNCTIONS *************************/
+/*********************************************************************//**
+ * @brief		CRC7 of a command
+ * @param[in]	pData	Command bytes
+ * @param[in]	Len		Number of bytes
+ * @return		Last byte of the command: CRC7 and end bit
+ **********************************************************************/
+static uint8_t sdspi_crc7(const uint8_t *pData, uint32_t Len)
+{
+	uint8_t crc = 0;
+
+	while (Len--) {
+		crc = sdspi_crc7_tab[crc ^ *pData++];
+	}
+	return (crc | 0x01);
+}
+
+/*********************************************************************//**
+ * @brief		CRC16 of a data block
+ * @param[in]	pData	Data
+ * @param[in]	Len		Number of bytes
+ * @return		CRC16
+ **********************************************************************/
+static uint16_t sdspi_crc16(const uint8_t *pData, uint32_t Len)
+{
+	uint16_t crc = 0;
+
+	while (Len--) {
+		crc = (uint16_t)((crc << 8) ^ sdspi_crc16_tab[(crc >> 8) ^ *pData++]);
+	}
+	return crc;
+}
+
+/*********************************************************************//**
+ * @brief		Send a byte and receive one
+ * @param[in]	SSPx	SSP peripheral
+ * @param[in]	Out		Byte to send
+ * @return		Byte received
+ **********************************************************************/
+static uint8_t sdspi_xfer(LPC_SSP_TypeDef *SSPx, uint8_t Out)
+{
+	SSPx->DR = Out;
+	while (!(SSPx->SR & SSP_SR_RNE));
+	return ((uint8_t)SSPx->DR);
+}
+
+/*********************************************************************//**
+ * @brief		Receive bytes, sending 0xFF. Up to SDSPI_SSP_FIFO frames
+ * 				are on the way, so the bus does not stop between bytes
+ * 				and the Rx FIFO never overruns
+ * @param[in]	SSPx	SSP peripheral
+ * @param[out]	pBuf	Received bytes
+ * @param[in]	Len		Number of bytes
+ * @return		None
+ **********************************************************************/
+static void sdspi_recv(LPC_SSP_TypeDef *SSPx, uint8_t *pBuf, uint32_t Len)
+{
+	uint32_t tx = 0, rx = 0;
+
+	while (rx < Len) {
+		while ((tx < Len) && ((tx - rx) < SDSPI_SSP_FIFO)) {
+			SSPx->DR = 0xFF;
+			tx++;
+		}
+		if (SSPx->SR & SSP_SR_RNE) {
+			pBuf[rx++] = (uint8_t)SSPx->DR;
+		}
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Send bytes, dropping what comes back
+ * @param[in]	SSPx	SSP peripheral
+ * @param[in]	pBuf	Bytes to send
+ * @param[in]	Len		Number of bytes
+ * @return		None
+ **********************************************************************/
+static void sdspi_send(LPC_SSP_TypeDef *SSPx, const uint8_t *pBuf, uint32_t Len)
+{
+	uint32_t tx = 0, rx = 0;
+
+	while (rx < Len) {
+		while ((tx < Len) && ((tx - rx) < SDSPI_SSP_FIFO)) {
+			SSPx->DR = pBuf[tx++];
+		}
+		if (SSPx->SR & SSP_SR_RNE) {
+			(void)SSPx->DR;
+			rx++;
+		}
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Set the SPI clock. The SSP is stopped meanwhile, with the
+ * 				card not selected
+ * @param[in]	pCard	Card
+ * @param[in]	Rate	Clock, in Hz
+ * @return		None
+ **********************************************************************/
+static void sdspi_set_clock(SDSPI_CARD_Type *pCard, uint32_t Rate)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	SSP_CFG_Type SSP_ConfigStruct;
+
+	SSP_Cmd(SSPx, DISABLE);
+	SSP_ConfigStructInit(&SSP_ConfigStruct);	/* 8 bit, SPI mode 0, master */
+	SSP_ConfigStruct.ClockRate = Rate;
+	SSP_Init(SSPx, &SSP_ConfigStruct);
+	SSP_Cmd(SSPx, ENABLE);
+	while (SSPx->SR & SSP_SR_RNE) {
+		(void)SSPx->DR;
+	}
+}
+
+/*********************************************************************//**
+ * @brief		Wait while the card is busy (holds MISO low)
+ * @param[in]	SSPx	SSP peripheral
+ * @return		TRUE if ready, FALSE on timeout
+ **********************************************************************/
+static Bool sdspi_wait_ready(LPC_SSP_TypeDef *SSPx)
+{
+	uint32_t n;
+
+	for (n = 0; n < SDSPI_BUSY_TRIES; n++) {
+		if (sdspi_xfer(SSPx, 0xFF) == 0xFF) {
+			return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+/*********************************************************************//**
+ * @brief		Select the card and wait until it is ready: a block
+ * 				written before may still be programming
+ * @param[in]	pCard	Card
+ * @return		TRUE if ready, FALSE on timeout
+ **********************************************************************/
+static Bool sdspi_select(SDSPI_CARD_Type *pCard)
+{
+	GPIO_ClearValue(pCard->Cfg.CSPortNum, (1UL << pCard->Cfg.CSPinNum));
+	return sdspi_wait_ready(pCard->Cfg.SSPx);
+}
+
+/*********************************************************************//**
+ * @brief		Deselect the card
+ * @param[in]	pCard	Card
+ * @return		None
+ **********************************************************************/
+static void sdspi_deselect(SDSPI_CARD_Type *pCard)
+{
+	GPIO_SetValue(pCard->Cfg.CSPortNum, (1UL << pCard->Cfg.CSPinNum));
+	sdspi_xfer(pCard->Cfg.SSPx, 0xFF);	/* the card releases MISO */
+}
+
+/*********************************************************************//**
+ * @brief		Send a command, the card selected
+ * @param[in]	pCard	Card
+ * @param[in]	Cmd		Command index, SDSPI_ACMD for application commands
+ * @param[in]	Arg		Argument
+ * @return		R1 response, SDSPI_R1_NONE if none
+ **********************************************************************/
+static uint8_t sdspi_command(SDSPI_CARD_Type *pCard, uint8_t Cmd, uint32_t Arg)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	uint8_t buf[6];
+	uint8_t r1;
+	uint32_t n;
+
+	if (Cmd & SDSPI_ACMD) {
+		r1 = sdspi_command(pCard, SDSPI_CMD55, 0);
+		if (r1 > SDSPI_R1_IDLE) {
+			return r1;
+		}
+		Cmd &= ~SDSPI_ACMD;
+	}
+
+	buf[0] = 0x40 | Cmd;
+	buf[1] = (uint8_t)(Arg >> 24);
+	buf[2] = (uint8_t)(Arg >> 16);
+	buf[3] = (uint8_t)(Arg >> 8);
+	buf[4] = (uint8_t)Arg;
+	buf[5] = sdspi_crc7(buf, 5);
+	sdspi_send(SSPx, buf, 6);
+
+	if (Cmd == SDSPI_CMD12) {
+		sdspi_xfer(SSPx, 0xFF);			/* stuff byte */
+	}
+	for (n = 0; n < SDSPI_R1_TRIES; n++) {
+		r1 = sdspi_xfer(SSPx, 0xFF);
+		if ((r1 & 0x80) == 0) {
+			return r1;
+		}
+	}
+	return SDSPI_R1_NONE;
+}
+
+/*********************************************************************//**
+ * @brief		Status of a rejected command
+ * @param[in]	R1		R1 response
+ * @return		SDSPI_ERROR_TIMEOUT, SDSPI_ERROR_CRC or SDSPI_ERROR_CMD
+ **********************************************************************/
+static SDSPI_Status sdspi_r1_status(uint8_t R1)
+{
+	if (R1 == SDSPI_R1_NONE) {
+		return SDSPI_ERROR_TIMEOUT;
+	}
+	return ((R1 & SDSPI_R1_CRC_ERR) ? SDSPI_ERROR_CRC : SDSPI_ERROR_CMD);
+}
+
+/*********************************************************************//**
+ * @brief		Wait for the start token of a data block
+ * @param[in]	SSPx	SSP peripheral
+ * @return		SDSPI_OK, SDSPI_ERROR_TOKEN or SDSPI_ERROR_TIMEOUT
+ **********************************************************************/
+static SDSPI_Status sdspi_wait_token(LPC_SSP_TypeDef *SSPx)
+{
+	uint32_t n;
+	uint8_t tok;
+
+	for (n = 0; n < SDSPI_TOKEN_TRIES; n++) {
+		tok = sdspi_xfer(SSPx, 0xFF);
+		if (tok != 0xFF) {
+			return ((tok == SDSPI_TOKEN_START) ? SDSPI_OK : SDSPI_ERROR_TOKEN);
+		}
+	}
+	return SDSPI_ERROR_TIMEOUT;
+}
+
+/*********************************************************************//**
+ * @brief		Receive a short data block (CSD, CID) by polling
+ * @param[in]	pCard	Card
+ * @param[out]	pBuf	Data
+ * @param[in]	Len		Number of bytes, without the CRC16
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+static SDSPI_Status sdspi_read_data(SDSPI_CARD_Type *pCard, uint8_t *pBuf, uint32_t Len)
+{
+	uint8_t crc[2];
+	SDSPI_Status ret;
+
+	ret = sdspi_wait_token(pCard->Cfg.SSPx);
+	if (ret != SDSPI_OK) {
+		return ret;
+	}
+	sdspi_recv(pCard->Cfg.SSPx, pBuf, Len);
+	sdspi_recv(pCard->Cfg.SSPx, crc, 2);
+	if (sdspi_crc16(pBuf, Len) != (uint16_t)((crc[0] << 8) | crc[1])) {
+		return SDSPI_ERROR_CRC;
+	}
+	return SDSPI_OK;
+}
+
+/*********************************************************************//**
+ * @brief		Start moving a data block by DMA. Reading, the Tx channel
+ * 				sends 0xFF without incrementing; writing, the Rx channel
+ * 				drops what comes back the same way
+ * @param[in]	pCard	Card
+ * @param[out]	pRx		Block to read into, or NULL when writing
+ * @param[in]	pTx		Block to write, or NULL when reading
+ * @return		None
+ **********************************************************************/
+static void sdspi_dma_start(SDSPI_CARD_Type *pCard, uint8_t *pRx, const uint8_t *pTx)
+{
+	GPDMA_Channel_CFG_Type GPDMACfg;
+	uint32_t conn;
+
+	conn = (pCard->Cfg.SSPx == LPC_SSP0) ? GPDMA_CONN_SSP0_Tx : GPDMA_CONN_SSP1_Tx;
+
+	GPDMACfg.ChannelNum = pCard->RxChannel;
+	GPDMACfg.TransferSize = SDSPI_BLOCK_SIZE;
+	GPDMACfg.TransferWidth = 0;
+	GPDMACfg.SrcMemAddr = 0;
+	GPDMACfg.DstMemAddr = (uint32_t)((pRx != NULL) ? pRx : &sdspi_dma_sink);
+	GPDMACfg.TransferType = GPDMA_TRANSFERTYPE_P2M;
+	GPDMACfg.SrcConn = conn + 1;		/* SSPn Rx follows SSPn Tx */
+	GPDMACfg.DstConn = 0;
+	GPDMACfg.DMALLI = 0;
+	GPDMA_Setup(&GPDMACfg);
+	if (pRx == NULL) {
+		SDSPI_DMA_CH(pCard->RxChannel)->DMACCControl &= ~GPDMA_DMACCxControl_DI;
+	}
+
+	GPDMACfg.ChannelNum = pCard->TxChannel;
+	GPDMACfg.SrcMemAddr = (uint32_t)((pTx != NULL) ? pTx : &sdspi_dma_ones);
+	GPDMACfg.DstMemAddr = 0;
+	GPDMACfg.TransferType = GPDMA_TRANSFERTYPE_M2P;
+	GPDMACfg.SrcConn = 0;
+	GPDMACfg.DstConn = conn;
+	GPDMA_Setup(&GPDMACfg);
+	if (pTx == NULL) {
+		SDSPI_DMA_CH(pCard->TxChannel)->DMACCControl &= ~GPDMA_DMACCxControl_SI;
+	}
+
+	/* Rx first, on the higher priority channel: it must keep up with Tx */
+	GPDMA_ChannelCmd(pCard->RxChannel, ENABLE);
+	GPDMA_ChannelCmd(pCard->TxChannel, ENABLE);
+	pCard->Cfg.SSPx->DMACR = SSP_DMA_RXDMA_EN | SSP_DMA_TXDMA_EN;
+}
+
+/*********************************************************************//**
+ * @brief		Wait for the end of a DMA block. The Rx channel ends
+ * 				last, with the last byte received
+ * @param[in]	pCard	Card
+ * @return		None
+ **********************************************************************/
+static void sdspi_dma_wait(SDSPI_CARD_Type *pCard)
+{
+	while (LPC_GPDMA->DMACEnbldChns & GPDMA_DMACEnbldChns_Ch(pCard->RxChannel));
+	pCard->Cfg.SSPx->DMACR = 0;
+}
+
+/*********************************************************************//**
+ * @brief		Check the blocks of a read or write
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[in]	Count	Number of blocks
+ * @return		SDSPI_OK, or SDSPI_ERROR_PARAM (also with a stream open)
+ **********************************************************************/
+static SDSPI_Status sdspi_check_range(const SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count)
+{
+	if ((pCard->Type == SDSPI_TYPE_NONE) || (pCard->Stream != 0) || (Block >= pCard->BlockCount) \
+			|| (Count > (pCard->BlockCount - Block))) {
+		return SDSPI_ERROR_PARAM;
+	}
+	return SDSPI_OK;
+}
+
+/*********************************************************************//**
+ * @brief		Command argument of a block: block number on SDHC cards,
+ * 				byte address on the others
+ * @param[in]	pCard	Card
+ * @param[in]	Block	Block
+ * @return		Argument
+ **********************************************************************/
+static uint32_t sdspi_address(const SDSPI_CARD_Type *pCard, uint32_t Block)
+{
+	return ((pCard->Type == SDSPI_TYPE_SDHC) ? Block : (Block * SDSPI_BLOCK_SIZE));
+}
+
+/*********************************************************************//**
+ * @brief		Select the card and send the read command of Count blocks
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[in]	Count	Number of blocks, not 0
+ * @return		SDSPI_OK with the card selected, or the error
+ **********************************************************************/
+static SDSPI_Status sdspi_read_start(SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count)
+{
+	SDSPI_Status ret;
+	uint8_t r1;
+
+	ret = sdspi_check_range(pCard, Block, Count);
+	if (ret != SDSPI_OK) {
+		return ret;
+	}
+	if (sdspi_select(pCard) == FALSE) {
+		sdspi_deselect(pCard);
+		return SDSPI_ERROR_TIMEOUT;
+	}
+	r1 = sdspi_command(pCard, (Count == 1) ? SDSPI_CMD17 : SDSPI_CMD18, sdspi_address(pCard, Block));
+	if (r1 != 0) {
+		sdspi_deselect(pCard);
+		return sdspi_r1_status(r1);
+	}
+	return SDSPI_OK;
+}
+
+/*********************************************************************//**
+ * @brief		End a read and deselect the card
+ * @param[in]	pCard	Card
+ * @param[in]	Multi	TRUE after CMD18: CMD12 stops it
+ * @param[in]	Ret		Status of the read
+ * @return		Ret, or SDSPI_ERROR_TIMEOUT if the card stays busy
+ **********************************************************************/
+static SDSPI_Status sdspi_read_stop(SDSPI_CARD_Type *pCard, Bool Multi, SDSPI_Status Ret)
+{
+	if (Multi == TRUE) {
+		sdspi_command(pCard, SDSPI_CMD12, 0);
+		if ((sdspi_wait_ready(pCard->Cfg.SSPx) == FALSE) && (Ret == SDSPI_OK)) {
+			Ret = SDSPI_ERROR_TIMEOUT;
+		}
+	}
+	sdspi_deselect(pCard);
+	return Ret;
+}
+
+/*********************************************************************//**
+ * @brief		Select the card and send the write command of Count blocks
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[in]	Count	Number of blocks, not 0
+ * @return		SDSPI_OK with the card selected, or the error
+ **********************************************************************/
+static SDSPI_Status sdspi_write_start(SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count)
+{
+	SDSPI_Status ret;
+	uint8_t r1;
+
+	ret = sdspi_check_range(pCard, Block, Count);
+	if (ret != SDSPI_OK) {
+		return ret;
+	}
+	if (sdspi_select(pCard) == FALSE) {
+		sdspi_deselect(pCard);
+		return SDSPI_ERROR_TIMEOUT;
+	}
+	if (Count == 1) {
+		r1 = sdspi_command(pCard, SDSPI_CMD24, sdspi_address(pCard, Block));
+	} else {
+		/* Pre-erasing the blocks speeds up the multiple block write */
+		r1 = sdspi_command(pCard, SDSPI_ACMD23, Count);
+		if (r1 == 0) {
+			r1 = sdspi_command(pCard, SDSPI_CMD25, sdspi_address(pCard, Block));
+		}
+	}
+	if (r1 != 0) {
+		sdspi_deselect(pCard);
+		return sdspi_r1_status(r1);
+	}
+	return SDSPI_OK;
+}
+
+/*********************************************************************//**
+ * @brief		Data response of a block written
+ * @param[in]	SSPx	SSP peripheral
+ * @return		SDSPI_OK, SDSPI_ERROR_CRC or SDSPI_ERROR_WRITE
+ **********************************************************************/
+static SDSPI_Status sdspi_data_response(LPC_SSP_TypeDef *SSPx)
+{
+	uint8_t resp = 0xFF;
+	uint32_t n;
+
+	for (n = 0; (n < SDSPI_R1_TRIES) && (resp == 0xFF); n++) {
+		resp = sdspi_xfer(SSPx, 0xFF);
+	}
+	if ((resp & SDSPI_DATA_RESP_MSK) != SDSPI_DATA_ACCEPTED) {
+		return (((resp & SDSPI_DATA_RESP_MSK) == SDSPI_DATA_CRC_ERR) ? SDSPI_ERROR_CRC : SDSPI_ERROR_WRITE);
+	}
+	return SDSPI_OK;
+}
+
+/*********************************************************************//**
+ * @brief		End a write and deselect the card, which may still be
+ * 				programming the last block
+ * @param[in]	pCard	Card
+ * @param[in]	Multi	TRUE after CMD25: the stop token ends it, also
+ * 						after a failed block
+ * @param[in]	Ret		Status of the write
+ * @return		Ret, or SDSPI_ERROR_TIMEOUT if the card stays busy
+ **********************************************************************/
+static SDSPI_Status sdspi_write_stop(SDSPI_CARD_Type *pCard, Bool Multi, SDSPI_Status Ret)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+
+	if (Multi == TRUE) {
+		if (sdspi_wait_ready(SSPx) == FALSE) {
+			Ret = SDSPI_ERROR_TIMEOUT;
+		} else {
+			sdspi_xfer(SSPx, SDSPI_TOKEN_STOP);
+			sdspi_xfer(SSPx, 0xFF);			/* busy starts one byte later */
+		}
+	}
+	sdspi_deselect(pCard);
+	return Ret;
+}
+
+/*********************************************************************//**
+ * @brief		Card size from the CSD register
+ * @param[in]	pCSD	16 bytes of the CSD
+ * @return		Number of SDSPI_BLOCK_SIZE blocks
+ **********************************************************************/
+static uint32_t sdspi_csd_blocks(const uint8_t *pCSD)
+{
+	uint32_t c_size, mult;
+
+	if ((pCSD[0] >> 6) == 1) {
+		/* CSD version 2.0: (C_SIZE + 1) * 512 KB */
+		c_size = ((uint32_t)(pCSD[7] & 0x3F) << 16) | ((uint32_t)pCSD[8] << 8) | pCSD[9];
+		return ((c_size + 1) << 10);
+	}
+	/* CSD version 1.0: (C_SIZE + 1) * 2^(C_SIZE_MULT + 2) * 2^READ_BL_LEN */
+	c_size = ((uint32_t)(pCSD[6] & 0x03) << 10) | ((uint32_t)pCSD[7] << 2) | (pCSD[8] >> 6);
+	mult = ((pCSD[9] & 0x03) << 1) | (pCSD[10] >> 7);
+	return ((c_size + 1) << (mult + 2 + (pCSD[5] & 0x0F) - 9));
+}
+
+/*********************************************************************//**
+ * @brief		Identify the card, the card selected, at SDSPI_CLK_INIT
+ * @param[in]	pCard	Card
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+static SDSPI_Status sdspi_identify(SDSPI_CARD_Type *pCard)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	SDSPI_CardType type;
+	SDSPI_Status ret;
+	uint8_t ocr[4];
+	uint8_t r1;
+	uint32_t n;
+
+	/* CMD0 with the card selected puts it in SPI mode */
+	for (n = 0; n < SDSPI_CMD0_TRIES; n++) {
+		if (sdspi_command(pCard, SDSPI_CMD0, 0) == SDSPI_R1_IDLE) {
+			break;
+		}
+	}
+	if (n == SDSPI_CMD0_TRIES) {
+		return SDSPI_ERROR_NOCARD;
+	}
+
+	/* CMD8 tells version 2.0 cards (that can be SDHC) from older ones */
+	r1 = sdspi_command(pCard, SDSPI_CMD8, 0x1AA);
+	if (r1 == SDSPI_R1_IDLE) {
+		sdspi_recv(SSPx, ocr, 4);
+		if (((ocr[2] & 0x0F) != 0x01) || (ocr[3] != 0xAA)) {
+			return SDSPI_ERROR_VOLTAGE;
+		}
+		type = SDSPI_TYPE_SDV2;
+	} else if (r1 & SDSPI_R1_ILLEGAL) {
+		type = SDSPI_TYPE_SDV1;
+	} else {
+		return sdspi_r1_status(r1);
+	}
+
+	/* Until the card leaves the idle state, offering SDHC support (HCS) */
+	for (n = 0; n < SDSPI_INIT_TRIES; n++) {
+		r1 = sdspi_command(pCard, SDSPI_ACMD41, (type == SDSPI_TYPE_SDV2) ? SDSPI_ACMD41_HCS : 0);
+		if (r1 == 0) {
+			break;
+		}
+		if (r1 != SDSPI_R1_IDLE) {
+			return sdspi_r1_status(r1);
+		}
+	}
+	if (n == SDSPI_INIT_TRIES) {
+		return SDSPI_ERROR_INIT;
+	}
+
+	if (type == SDSPI_TYPE_SDV2) {
+		r1 = sdspi_command(pCard, SDSPI_CMD58, 0);
+		if (r1 != 0) {
+			return sdspi_r1_status(r1);
+		}
+		sdspi_recv(SSPx, ocr, 4);
+		if (ocr[0] & SDSPI_OCR_CCS) {
+			type = SDSPI_TYPE_SDHC;
+		}
+	}
+	pCard->Type = type;
+
+	/* From here on the card checks the CRC of every command and block */
+	r1 = sdspi_command(pCard, SDSPI_CMD59, 1);
+	if (r1 != 0) {
+		return sdspi_r1_status(r1);
+	}
+	if (type != SDSPI_TYPE_SDHC) {
+		r1 = sdspi_command(pCard, SDSPI_CMD16, SDSPI_BLOCK_SIZE);
+		if (r1 != 0) {
+			return sdspi_r1_status(r1);
+		}
+	}
+
+	r1 = sdspi_command(pCard, SDSPI_CMD9, 0);
+	if (r1 != 0) {
+		return sdspi_r1_status(r1);
+	}
+	ret = sdspi_read_data(pCard, pCard->CSD, 16);
+	if (ret != SDSPI_OK) {
+		return ret;
+	}
+	pCard->BlockCount = sdspi_csd_blocks(pCard->CSD);
+
+	r1 = sdspi_command(pCard, SDSPI_CMD10, 0);
+	if (r1 != 0) {
+		return sdspi_r1_status(r1);
+	}
+	return sdspi_read_data(pCard, pCard->CID, 16);
+}
+
+/************************** PUBLIC FUNCTIONS *************************/
+/*********************************************************************//**
+ * @brief		Initialize the SSP, its pins and the card: identify it,
+ * 				turn CRC checking on, read its CSD and CID and switch to
+ * 				the data clock
+ * @param[out]	pCard	Card structure, filled in
+ * @param[in]	pCfg	Configuration
+ * @return		SDSPI_OK, or the error (pCard->Type is SDSPI_TYPE_NONE)
+ **********************************************************************/
+SDSPI_Status SDSPI_Init(SDSPI_CARD_Type *pCard, const SDSPI_CFG_Type *pCfg)
+{
+	PINSEL_CFG_Type PinCfg;
+	SDSPI_Status ret;
+	uint32_t n;
+
+	CHECK_PARAM(PARAM_SSPx(pCfg->SSPx));
+
+	pCard->Cfg = *pCfg;
+	if ((pCard->Cfg.ClockRate == 0) || (pCard->Cfg.ClockRate > SDSPI_CLK_MAX)) {
+		pCard->Cfg.ClockRate = SDSPI_CLK_MAX;
+	}
+	pCard->Type = SDSPI_TYPE_NONE;
+	pCard->BlockCount = 0;
+	pCard->RxChannel = -1;
+	pCard->TxChannel = -1;
+	pCard->Stream = 0;
+	pCard->StreamLeft = 0;
+
+	/* SCK, MISO and MOSI of the SSP, and the chip select as a GPIO, high */
+	PinCfg.Funcnum = 2;
+	PinCfg.OpenDrain = 0;
+	PinCfg.Pinmode = 0;
+	PinCfg.Portnum = 0;
+	PinCfg.Pinnum = (pCfg->SSPx == LPC_SSP0) ? 15 : 7;
+	PINSEL_ConfigPin(&PinCfg);
+	PinCfg.Pinnum = (pCfg->SSPx == LPC_SSP0) ? 17 : 8;
+	PINSEL_ConfigPin(&PinCfg);
+	PinCfg.Pinnum = (pCfg->SSPx == LPC_SSP0) ? 18 : 9;
+	PINSEL_ConfigPin(&PinCfg);
+	PinCfg.Funcnum = 0;
+	PinCfg.Portnum = pCfg->CSPortNum;
+	PinCfg.Pinnum = pCfg->CSPinNum;
+	PINSEL_ConfigPin(&PinCfg);
+	GPIO_SetValue(pCfg->CSPortNum, (1UL << pCfg->CSPinNum));
+	GPIO_SetDir(pCfg->CSPortNum, (1UL << pCfg->CSPinNum), 1);
+
+	/* PCLK = CCLK: the SSP clock can reach PCLK / 2 */
+	CLKPWR_SetPCLKDiv((pCfg->SSPx == LPC_SSP0) ? CLKPWR_PCLKSEL_SSP0 : CLKPWR_PCLKSEL_SSP1, \
+			CLKPWR_PCLKSEL_CCLK_DIV_1);
+	sdspi_set_clock(pCard, SDSPI_CLK_INIT);
+
+	/* At least 74 clocks with the card not selected to wake it up */
+	for (n = 0; n < 10; n++) {
+		sdspi_xfer(pCfg->SSPx, 0xFF);
+	}
+
+	if (sdspi_select(pCard) == FALSE) {
+		ret = SDSPI_ERROR_TIMEOUT;
+	} else {
+		ret = sdspi_identify(pCard);
+	}
+	sdspi_deselect(pCard);
+
+	if ((ret == SDSPI_OK) && (pCfg->DMA == ENABLE)) {
+		pCard->RxChannel = GPDMA_ChannelAlloc(GPDMA_CHPRIO_HIGH, NULL, NULL);
+		pCard->TxChannel = GPDMA_ChannelAlloc(GPDMA_CHPRIO_LOW, NULL, NULL);
+		if ((pCard->RxChannel < 0) || (pCard->TxChannel < 0)) {
+			ret = SDSPI_ERROR_DMA;
+		}
+	}
+	if (ret != SDSPI_OK) {
+		SDSPI_DeInit(pCard);
+		return ret;
+	}
+
+	sdspi_set_clock(pCard, pCard->Cfg.ClockRate);
+	return SDSPI_OK;
+}
+
+/*********************************************************************//**
+ * @brief		Release the GPDMA channels of a card and stop its SSP.
+ * 				Call SDSPI_Sync() first if the last write has to be on
+ * 				the card
+ * @param[in]	pCard	Card
+ * @return		None
+ **********************************************************************/
+void SDSPI_DeInit(SDSPI_CARD_Type *pCard)
+{
+	if (pCard->RxChannel >= 0) {
+		GPDMA_ChannelFree(pCard->RxChannel);
+		pCard->RxChannel = -1;
+	}
+	if (pCard->TxChannel >= 0) {
+		GPDMA_ChannelFree(pCard->TxChannel);
+		pCard->TxChannel = -1;
+	}
+	pCard->Type = SDSPI_TYPE_NONE;
+	pCard->BlockCount = 0;
+	pCard->Stream = 0;
+	pCard->StreamLeft = 0;
+	SSP_Cmd(pCard->Cfg.SSPx, DISABLE);
+}
+
+/*********************************************************************//**
+ * @brief		Card size
+ * @param[in]	pCard	Card
+ * @return		Number of SDSPI_BLOCK_SIZE blocks, 0 if not initialized
+ **********************************************************************/
+uint32_t SDSPI_GetBlockCount(const SDSPI_CARD_Type *pCard)
+{
+	return pCard->BlockCount;
+}
+
+/*********************************************************************//**
+ * @brief		Read blocks: CMD17 for one, CMD18 and CMD12 for more. The
+ * 				CRC16 of each block is checked while the next one comes
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[out]	pBuf	Count * SDSPI_BLOCK_SIZE bytes
+ * @param[in]	Count	Number of blocks
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+SDSPI_Status SDSPI_ReadBlocks(SDSPI_CARD_Type *pCard, uint32_t Block, uint8_t *pBuf, uint32_t Count)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	SDSPI_Status ret;
+	uint8_t *pPrev = NULL;
+	uint16_t prev_crc = 0;
+	uint8_t crc[2];
+	uint32_t n;
+
+	if (Count == 0) {
+		return sdspi_check_range(pCard, Block, Count);
+	}
+	ret = sdspi_read_start(pCard, Block, Count);
+	if (ret != SDSPI_OK) {
+		return ret;
+	}
+
+	for (n = 0; n < Count; n++) {
+		ret = sdspi_wait_token(SSPx);
+		if (ret != SDSPI_OK) {
+			break;
+		}
+		if (pCard->RxChannel >= 0) {
+			sdspi_dma_start(pCard, pBuf, NULL);
+		}
+		/* The block before is checked while this one is on the bus */
+		if ((pPrev != NULL) && (sdspi_crc16(pPrev, SDSPI_BLOCK_SIZE) != prev_crc)) {
+			ret = SDSPI_ERROR_CRC;
+		}
+		if (pCard->RxChannel >= 0) {
+			sdspi_dma_wait(pCard);
+		} else {
+			sdspi_recv(SSPx, pBuf, SDSPI_BLOCK_SIZE);
+		}
+		sdspi_recv(SSPx, crc, 2);
+		if (ret != SDSPI_OK) {
+			break;
+		}
+		pPrev = pBuf;
+		prev_crc = (uint16_t)((crc[0] << 8) | crc[1]);
+		pBuf += SDSPI_BLOCK_SIZE;
+	}
+	if ((ret == SDSPI_OK) && (sdspi_crc16(pPrev, SDSPI_BLOCK_SIZE) != prev_crc)) {
+		ret = SDSPI_ERROR_CRC;
+	}
+	return sdspi_read_stop(pCard, (Count > 1) ? TRUE : FALSE, ret);
+}
+
+/*********************************************************************//**
+ * @brief		Write blocks: CMD24 for one, ACMD23 and CMD25 for more. The
+ * 				CRC16 of each block is computed while the one before is on
+ * 				the bus. Returns while the card programs the last block
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[in]	pBuf	Count * SDSPI_BLOCK_SIZE bytes
+ * @param[in]	Count	Number of blocks
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+SDSPI_Status SDSPI_WriteBlocks(SDSPI_CARD_Type *pCard, uint32_t Block, const uint8_t *pBuf, uint32_t Count)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	SDSPI_Status ret;
+	uint16_t crc, next_crc;
+	uint32_t n;
+
+	if (Count == 0) {
+		return sdspi_check_range(pCard, Block, Count);
+	}
+	ret = sdspi_write_start(pCard, Block, Count);
+	if (ret != SDSPI_OK) {
+		return ret;
+	}
+
+	crc = sdspi_crc16(pBuf, SDSPI_BLOCK_SIZE);
+	for (n = 0; n < Count; n++) {
+		if ((n > 0) && (sdspi_wait_ready(SSPx) == FALSE)) {
+			ret = SDSPI_ERROR_TIMEOUT;
+			break;
+		}
+		sdspi_xfer(SSPx, (Count == 1) ? SDSPI_TOKEN_START : SDSPI_TOKEN_MULTI);
+		if (pCard->TxChannel >= 0) {
+			sdspi_dma_start(pCard, NULL, pBuf);
+		} else {
+			sdspi_send(SSPx, pBuf, SDSPI_BLOCK_SIZE);
+		}
+		/* The next block is prepared while this one is on the bus */
+		next_crc = (n + 1 < Count) ? sdspi_crc16(pBuf + SDSPI_BLOCK_SIZE, SDSPI_BLOCK_SIZE) : 0;
+		if (pCard->TxChannel >= 0) {
+			sdspi_dma_wait(pCard);
+		}
+		sdspi_xfer(SSPx, (uint8_t)(crc >> 8));
+		sdspi_xfer(SSPx, (uint8_t)crc);
+
+		ret = sdspi_data_response(SSPx);
+		if (ret != SDSPI_OK) {
+			break;
+		}
+		crc = next_crc;
+		pBuf += SDSPI_BLOCK_SIZE;
+	}
+	return sdspi_write_stop(pCard, (Count > 1) ? TRUE : FALSE, ret);
+}
+
+/*********************************************************************//**
+ * @brief		Wait until the card has programmed the last block written
+ * @param[in]	pCard	Card
+ * @return		SDSPI_OK, SDSPI_ERROR_TIMEOUT, or SDSPI_ERROR_PARAM with
+ * 				a stream open
+ **********************************************************************/
+SDSPI_Status SDSPI_Sync(SDSPI_CARD_Type *pCard)
+{
+	Bool ready;
+
+	if ((pCard->Type == SDSPI_TYPE_NONE) || (pCard->Stream != 0)) {
+		return SDSPI_ERROR_PARAM;
+	}
+	ready = sdspi_select(pCard);
+	sdspi_deselect(pCard);
+	return ((ready == TRUE) ? SDSPI_OK : SDSPI_ERROR_TIMEOUT);
+}
+
+/*********************************************************************//**
+ * @brief		Open a read stream: CMD17 for one block, CMD18 for more.
+ * 				The card stays selected until SDSPI_ReadStop(), and no
+ * 				other function can use it meanwhile
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[in]	Count	Most blocks that SDSPI_ReadNext() will read
+ * @return		SDSPI_OK, or the error (no stream open)
+ **********************************************************************/
+SDSPI_Status SDSPI_ReadStart(SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count)
+{
+	SDSPI_Status ret;
+
+	if (Count == 0) {
+		return SDSPI_ERROR_PARAM;
+	}
+	ret = sdspi_read_start(pCard, Block, Count);
+	if (ret == SDSPI_OK) {
+		pCard->Stream = (Count == 1) ? SDSPI_CMD17 : SDSPI_CMD18;
+		pCard->StreamLeft = Count;
+	}
+	return ret;
+}
+
+/*********************************************************************//**
+ * @brief		Read the next block of the stream and check its CRC16.
+ * 				After an error the stream only takes SDSPI_ReadStop()
+ * @param[in]	pCard	Card
+ * @param[out]	pBuf	SDSPI_BLOCK_SIZE bytes
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+SDSPI_Status SDSPI_ReadNext(SDSPI_CARD_Type *pCard, uint8_t *pBuf)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	SDSPI_Status ret;
+	uint8_t crc[2];
+
+	if (((pCard->Stream != SDSPI_CMD17) && (pCard->Stream != SDSPI_CMD18)) \
+			|| (pCard->StreamLeft == 0)) {
+		return SDSPI_ERROR_PARAM;
+	}
+	ret = sdspi_wait_token(SSPx);
+	if (ret == SDSPI_OK) {
+		if (pCard->RxChannel >= 0) {
+			sdspi_dma_start(pCard, pBuf, NULL);
+			sdspi_dma_wait(pCard);
+		} else {
+			sdspi_recv(SSPx, pBuf, SDSPI_BLOCK_SIZE);
+		}
+		sdspi_recv(SSPx, crc, 2);
+		if (sdspi_crc16(pBuf, SDSPI_BLOCK_SIZE) != (uint16_t)((crc[0] << 8) | crc[1])) {
+			ret = SDSPI_ERROR_CRC;
+		}
+	}
+	pCard->StreamLeft = (ret == SDSPI_OK) ? (pCard->StreamLeft - 1) : 0;
+	return ret;
+}
+
+/*********************************************************************//**
+ * @brief		Close a read stream, after its last block or before: CMD12
+ * 				after a CMD18
+ * @param[in]	pCard	Card
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+SDSPI_Status SDSPI_ReadStop(SDSPI_CARD_Type *pCard)
+{
+	Bool multi;
+
+	if ((pCard->Stream != SDSPI_CMD17) && (pCard->Stream != SDSPI_CMD18)) {
+		return SDSPI_ERROR_PARAM;
+	}
+	multi = (pCard->Stream == SDSPI_CMD18) ? TRUE : FALSE;
+	pCard->Stream = 0;
+	pCard->StreamLeft = 0;
+	return sdspi_read_stop(pCard, multi, SDSPI_OK);
+}
+
+/*********************************************************************//**
+ * @brief		Open a write stream: CMD24 for one block, ACMD23 and CMD25
+ * 				for more. The card stays selected until SDSPI_WriteStop(),
+ * 				and no other function can use it meanwhile
+ * @param[in]	pCard	Card
+ * @param[in]	Block	First block
+ * @param[in]	Count	Most blocks that SDSPI_WriteNext() will write
+ * @return		SDSPI_OK, or the error (no stream open)
+ **********************************************************************/
+SDSPI_Status SDSPI_WriteStart(SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count)
+{
+	SDSPI_Status ret;
+
+	if (Count == 0) {
+		return SDSPI_ERROR_PARAM;
+	}
+	ret = sdspi_write_start(pCard, Block, Count);
+	if (ret == SDSPI_OK) {
+		pCard->Stream = (Count == 1) ? SDSPI_CMD24 : SDSPI_CMD25;
+		pCard->StreamLeft = Count;
+	}
+	return ret;
+}
+
+/*********************************************************************//**
+ * @brief		Write the next block of the stream. With DMA its CRC16 is
+ * 				computed while it is on the bus. Returns while the card
+ * 				programs it: the next block, or SDSPI_WriteStop(), waits.
+ * 				After an error the stream only takes SDSPI_WriteStop()
+ * @param[in]	pCard	Card
+ * @param[in]	pBuf	SDSPI_BLOCK_SIZE bytes
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+SDSPI_Status SDSPI_WriteNext(SDSPI_CARD_Type *pCard, const uint8_t *pBuf)
+{
+	LPC_SSP_TypeDef *SSPx = pCard->Cfg.SSPx;
+	SDSPI_Status ret;
+	uint16_t crc;
+
+	if (((pCard->Stream != SDSPI_CMD24) && (pCard->Stream != SDSPI_CMD25)) \
+			|| (pCard->StreamLeft == 0)) {
+		return SDSPI_ERROR_PARAM;
+	}
+	if (sdspi_wait_ready(SSPx) == FALSE) {
+		ret = SDSPI_ERROR_TIMEOUT;
+	} else {
+		sdspi_xfer(SSPx, (pCard->Stream == SDSPI_CMD24) ? SDSPI_TOKEN_START : SDSPI_TOKEN_MULTI);
+		if (pCard->TxChannel >= 0) {
+			sdspi_dma_start(pCard, NULL, pBuf);
+			crc = sdspi_crc16(pBuf, SDSPI_BLOCK_SIZE);
+			sdspi_dma_wait(pCard);
+		} else {
+			crc = sdspi_crc16(pBuf, SDSPI_BLOCK_SIZE);
+			sdspi_send(SSPx, pBuf, SDSPI_BLOCK_SIZE);
+		}
+		sdspi_xfer(SSPx, (uint8_t)(crc >> 8));
+		sdspi_xfer(SSPx, (uint8_t)crc);
+		ret = sdspi_data_response(SSPx);
+	}
+	pCard->StreamLeft = (ret == SDSPI_OK) ? (pCard->StreamLeft - 1) : 0;
+	return ret;
+}
+
+/*********************************************************************//**
+ * @brief		Close a write stream, after its last block or before: stop
+ * 				token after a CMD25. Returns while the card programs the
+ * 				last block
+ * @param[in]	pCard	Card
+ * @return		SDSPI_OK, or the error
+ **********************************************************************/
+SDSPI_Status SDSPI_WriteStop(SDSPI_CARD_Type *pCard)
+{
+	Bool multi;
+
+	if ((pCard->Stream != SDSPI_CMD24) && (pCard->Stream != SDSPI_CMD25)) {
+		return SDSPI_ERROR_PARAM;
+	}
+	multi = (pCard->Stream == SDSPI_CMD25) ? TRUE : FALSE;
+	pCard->Stream = 0;
+	pCard->StreamLeft = 0;
+	return sdspi_write_stop(pCard, multi, SDSPI_OK);
+}
@@ -0,0 +1,125 @@
+/**********************************************************************
+* $Id$		sdspi.h					2026-10-17
+*//**
+* @file		sdspi.h
+* @brief	SD/SDHC card block driver in SPI mode over SSP0 or SSP1
+* @version	1.0
+* @date		17. October. 2026
+* @author
+*
+***********************************************************************
+* Software that is described herein is for illustrative purposes only
+* which provides customers with programming information regarding the
+* products. This software is supplied "AS IS" without any warranties.
+* NXP Semiconductors assumes no responsibility or liability for the
+* use of the software, conveys no license or title under any patent,
+* copyright, or mask work right to the product. NXP Semiconductors
+* reserves the right to make changes in the software without
+* notification. NXP Semiconductors also make no representation or
+* warranty that such application will be suitable for the specified
+* use without further testing or modification.
+**********************************************************************/
+#ifndef __SDSPI_H
+#define __SDSPI_H
+
+#include "LPC17xx.h"
+#include "lpc_types.h"
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/** Size of a data block, the unit of SDSPI_ReadBlocks()/SDSPI_WriteBlocks() */
+#define SDSPI_BLOCK_SIZE		512
+
+/** SPI clock while the card is identified, and the highest data clock */
+#define SDSPI_CLK_INIT			400000
+#define SDSPI_CLK_MAX			25000000
+
+/**
+ * @brief SD card driver status
+ */
+typedef enum
+{
+	SDSPI_OK = 0,			/**< Success */
+	SDSPI_ERROR_NOCARD,		/**< No answer to CMD0 */
+	SDSPI_ERROR_VOLTAGE,	/**< CMD8: the card does not take 2.7-3.6 V */
+	SDSPI_ERROR_INIT,		/**< ACMD41: the card did not leave the idle state */
+	SDSPI_ERROR_CMD,		/**< Command rejected (R1 error bits) */
+	SDSPI_ERROR_CRC,		/**< Command, or data block CRC error */
+	SDSPI_ERROR_TOKEN,		/**< Read: data error token instead of a block */
+	SDSPI_ERROR_WRITE,		/**< Write: block not accepted by the card */
+	SDSPI_ERROR_TIMEOUT,	/**< Card busy or silent for too long */
+	SDSPI_ERROR_PARAM,		/**< Blocks out of the card, or card not initialized */
+	SDSPI_ERROR_DMA			/**< No free GPDMA channel */
+} SDSPI_Status;
+
+/**
+ * @brief SD card type, found by SDSPI_Init()
+ */
+typedef enum
+{
+	SDSPI_TYPE_NONE = 0,	/**< Not initialized */
+	SDSPI_TYPE_SDV1,		/**< SD version 1.x, byte addresses */
+	SDSPI_TYPE_SDV2,		/**< SD version 2.0 standard capacity, byte addresses */
+	SDSPI_TYPE_SDHC			/**< SD version 2.0 high capacity (SDHC/SDXC), block addresses */
+} SDSPI_CardType;
+
+/**
+ * @brief SD card configuration structure
+ */
+typedef struct
+{
+	LPC_SSP_TypeDef *SSPx;	/**< SSP the card hangs on, should be:
+								- LPC_SSP0: SCK0 P0.15, MISO0 P0.17, MOSI0 P0.18
+								- LPC_SSP1: SCK1 P0.7, MISO1 P0.8, MOSI1 P0.9 */
+	uint8_t CSPortNum;		/**< Port of the chip select pin, driven as a GPIO */
+	uint8_t CSPinNum;		/**< Pin of the chip select pin */
+	uint32_t ClockRate;		/**< SPI clock after the card is identified, in Hz.
+								0 or above SDSPI_CLK_MAX: SDSPI_CLK_MAX */
+	FunctionalState DMA;	/**< ENABLE: data blocks are moved by two GPDMA
+								channels taken at SDSPI_Init(). GPDMA_Init()
+								must have been called before */
+} SDSPI_CFG_Type;
+
+/**
+ * @brief SD card structure, owned by the caller and filled by SDSPI_Init()
+ */
+typedef struct
+{
+	SDSPI_CFG_Type Cfg;		/**< Configuration */
+	SDSPI_CardType Type;	/**< Card type */
+	uint32_t BlockCount;	/**< Card size in blocks of SDSPI_BLOCK_SIZE */
+	uint8_t CID[16];		/**< Card identification register */
+	uint8_t CSD[16];		/**< Card specific data register */
+	int32_t RxChannel;		/**< GPDMA channels, -1 without DMA */
+	int32_t TxChannel;
+	uint8_t Stream;			/**< Command of the read or write open between
+								SDSPI_ReadStart()/SDSPI_WriteStart() and their
+								Stop, 0 if none */
+	uint32_t StreamLeft;	/**< Blocks that stream can still move */
+} SDSPI_CARD_Type;
+
+SDSPI_Status SDSPI_Init(SDSPI_CARD_Type *pCard, const SDSPI_CFG_Type *pCfg);
+void SDSPI_DeInit(SDSPI_CARD_Type *pCard);
+
+/* Block device interface */
+uint32_t SDSPI_GetBlockCount(const SDSPI_CARD_Type *pCard);
+SDSPI_Status SDSPI_ReadBlocks(SDSPI_CARD_Type *pCard, uint32_t Block, uint8_t *pBuf, uint32_t Count);
+SDSPI_Status SDSPI_WriteBlocks(SDSPI_CARD_Type *pCard, uint32_t Block, const uint8_t *pBuf, uint32_t Count);
+SDSPI_Status SDSPI_Sync(SDSPI_CARD_Type *pCard);
+
+/* Streams: one read or write command fed one block at a time */
+SDSPI_Status SDSPI_ReadStart(SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count);
+SDSPI_Status SDSPI_ReadNext(SDSPI_CARD_Type *pCard, uint8_t *pBuf);
+SDSPI_Status SDSPI_ReadStop(SDSPI_CARD_Type *pCard);
+SDSPI_Status SDSPI_WriteStart(SDSPI_CARD_Type *pCard, uint32_t Block, uint32_t Count);
+SDSPI_Status SDSPI_WriteNext(SDSPI_CARD_Type *pCard, const uint8_t *pBuf);
+SDSPI_Status SDSPI_WriteStop(SDSPI_CARD_Type *pCard);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SDSPI_H */
@@ -0,0 +1,204 @@
+/**********************************************************************
+* $Id$		uart_ring_buffer.c
+*//**
+* @file		uart_ring_buffer.c
+* @brief	This example describes how to use the UART driver ring
+* 			buffer (interrupt driven) API
+* @version	1.0
+* @date
+* @author
+*
+***********************************************************************
+* Software that is described herein is for illustrative purposes only
+* which provides customers with programming information regarding the
+* products. This software is supplied "AS IS" without any warranties.
+* NXP Semiconductors assumes no responsibility or liability for the
+* use of the software, conveys no license or title under any patent,
+* copyright, or mask work right to the product. NXP Semiconductors
+* reserves the right to make changes in the software without
+* notification. NXP Semiconductors also make no representation or
+* warranty that such application will be suitable for the specified
+* use without further testing or modification.
+**********************************************************************/
+#include "lpc17xx_uart.h"
+#include "lpc17xx_libcfg.h"
+#include "lpc17xx_pinsel.h"
+
+/* Example group ----------------------------------------------------------- */
+/** @defgroup UART_RingBuffer	RingBuffer
+ * @ingroup UART_Examples
+ * @{
+ */
+
+/************************** PRIVATE DEFINTIONS *************************/
+/* Ring sizes, must be powers of two */
+#define TX_RING_SIZE	1024
+#define RX_RING_SIZE	256
+
+/************************** PRIVATE VARIABLES *************************/
+uint8_t menu1[] =
+"UART ring buffer demo \n\r\t "
+"MCU LPC17xx - ARM Cortex-M3 \n\r\t "
+"UART0 - 115200bps \n\r"
+"Type something: it is echoed back, ESC to exit \n\r";
+uint8_t menu2[] = "\n\rUART demo terminated!\n\r";
+
+/* Ring storage, owned by the application */
+uint8_t tx_ring[TX_RING_SIZE];
+uint8_t rx_ring[RX_RING_SIZE];
+
+/* Events reported by the ring callback */
+__IO uint32_t ring_events;
+
+/************************** PRIVATE FUNCTIONS *************************/
+void UART0_IRQHandler(void);
+void ring_callback(LPC_UART_TypeDef *UARTx, uint32_t Event);
+
+/*----------------- INTERRUPT SERVICE ROUTINES --------------------------*/
+/*********************************************************************//**
+ * @brief		UART0 interrupt handler sub-routine
+ * @param[in]	None
+ * @return 		None
+ **********************************************************************/
+void UART0_IRQHandler(void)
+{
+	UART_RingIntHandler((LPC_UART_TypeDef *)LPC_UART0);
+}
+
+/*********************************************************************//**
+ * @brief		Ring buffer event callback, runs in interrupt context
+ * @param[in]	UARTx	UART that raised the events
+ * @param[in]	Event	UART_RING_EVT_xxx flags
+ * @return 		None
+ **********************************************************************/
+void ring_callback(LPC_UART_TypeDef *UARTx, uint32_t Event)
+{
+	ring_events |= Event;
+}
+
+/*-------------------------MAIN FUNCTION------------------------------*/
+/*********************************************************************//**
+ * @brief		c_entry: Main UART program body
+ * @param[in]	None
+ * @return 		int
+ **********************************************************************/
+int c_entry(void)
+{
+	UART_CFG_Type UARTConfigStruct;
+	UART_FIFO_CFG_Type UARTFIFOConfigStruct;
+	UART_RING_CFG_Type RingConfigStruct;
+	PINSEL_CFG_Type PinCfg;
+
+	uint32_t idx, len;
+	__IO FlagStatus exitflag;
+	uint8_t buffer[16];
+
+	/*
+	 * Initialize UART0 pin connect
+	 */
+	PinCfg.Funcnum = 1;
+	PinCfg.OpenDrain = 0;
+	PinCfg.Pinmode = 0;
+	PinCfg.Pinnum = 2;
+	PinCfg.Portnum = 0;
+	PINSEL_ConfigPin(&PinCfg);
+	PinCfg.Pinnum = 3;
+	PINSEL_ConfigPin(&PinCfg);
+
+	/* UART0 at 115200bps, 8 data bit, 1 stop bit, no parity */
+	UART_ConfigStructInit(&UARTConfigStruct);
+	UARTConfigStruct.Baud_rate = 115200;
+	UART_Init((LPC_UART_TypeDef *)LPC_UART0, &UARTConfigStruct);
+
+	/* FIFO enabled, Rx trigger at 8 characters: the RDA interrupt fires
+	 * every 8 bytes and the character time-out catches the tail */
+	UART_FIFOConfigStructInit(&UARTFIFOConfigStruct);
+	UARTFIFOConfigStruct.FIFO_Level = UART_FIFO_TRGLEV2;
+	UART_FIFOConfig((LPC_UART_TypeDef *)LPC_UART0, &UARTFIFOConfigStruct);
+
+	UART_TxCmd((LPC_UART_TypeDef *)LPC_UART0, ENABLE);
+
+	/* Attach the rings. From here on UART_Send() only queues data */
+	UART_RingConfigStructInit(&RingConfigStruct);
+	RingConfigStruct.TxBuf = tx_ring;
+	RingConfigStruct.TxSize = sizeof(tx_ring);
+	RingConfigStruct.RxBuf = rx_ring;
+	RingConfigStruct.RxSize = sizeof(rx_ring);
+	RingConfigStruct.TxLowWater = TX_RING_SIZE / 4;
+	RingConfigStruct.RxHighWater = (RX_RING_SIZE * 3) / 4;
+	RingConfigStruct.pfnCallback = ring_callback;
+	UART_RingInit((LPC_UART_TypeDef *)LPC_UART0, &RingConfigStruct);
+
+	/* preemption = 1, sub-priority = 1 */
+	NVIC_SetPriority(UART0_IRQn, ((0x01<<3)|0x01));
+	NVIC_EnableIRQ(UART0_IRQn);
+
+	/* Returns as soon as the menu is in the Tx ring */
+	UART_Send((LPC_UART_TypeDef *)LPC_UART0, menu1, sizeof(menu1), BLOCKING);
+
+	exitflag = RESET;
+	while (exitflag == RESET)
+	{
+		len = UART_Receive((LPC_UART_TypeDef *)LPC_UART0, buffer, sizeof(buffer), NONE_BLOCKING);
+
+		for (idx = 0; idx < len; idx++)
+		{
+			if (buffer[idx] == 27)
+			{
+				/* ESC key, set exit flag */
+				exitflag = SET;
+				break;
+			}
+		}
+		/* Echo back what was received */
+		UART_Send((LPC_UART_TypeDef *)LPC_UART0, buffer, idx, BLOCKING);
+
+		/* Other work goes here: the CPU is free while the UART runs */
+	}
+
+	ring_events = 0;
+	UART_Send((LPC_UART_TypeDef *)LPC_UART0, menu2, sizeof(menu2), BLOCKING);
+
+	/* Wait for the ring to drain and the transmitter to go idle */
+	while (!(ring_events & UART_RING_EVT_TXDONE));
+	while (UART_CheckBusy((LPC_UART_TypeDef *)LPC_UART0));
+
+	UART_DeInit((LPC_UART_TypeDef *)LPC_UART0);
+
+	/* Loop forever */
+	while(1);
+	return 1;
+}
+
+/* With ARM and GHS toolsets, the entry point is main() - this will
+   allow the linker to generate wrapper code to setup stacks, allocate
+   heap area, and initialize and copy code and data segments. For GNU
+   toolsets, the entry point is through __start() in the crt0_gnu.asm
+   file, and that startup code will setup stacks and data */
+int main(void)
+{
+    return c_entry();
+}
+
+
+#ifdef  DEBUG
+/*******************************************************************************
+* @brief		Reports the name of the source file and the source line number
+* 				where the CHECK_PARAM error has occurred.
+* @param[in]	file Pointer to the source file name
+* @param[in]    line assert_param error line source number
+* @return		None
+*******************************************************************************/
+void check_failed(uint8_t *file, uint32_t line)
+{
+	/* User can add his own implementation to report the source file name and line number,
+	 ex: printf("Wrong parameters value: file %s on line %d\r\n", file, line) */
+
+	/* Infinite loop */
+	while(1);
+}
+#endif
+
+/*
+ * @}
+ */
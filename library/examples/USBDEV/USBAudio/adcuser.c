@@ -21,16 +21,53 @@
 #include "usb.h"
 #include "audio.h"
 #include "usbcfg.h"
+#include "usbhw.h"
 #include "usbcore.h"
+#include "usbuser.h"
 #include "adcuser.h"
 
 #include "usbaudio.h"
+#include "speaker.h"
+
+#if USB_DMA == 0
+#error "The Audio Stream is moved by the USB DMA: set USB_DMA to 1"
+#endif
+
+#define ADC_PKT_VALID  (1UL << 16)  /* Packet Info: Packet Valid */
 
       uint16_t VolCur = 0x0100;     /* Volume Current Value */
 const uint16_t VolMin = 0x0000;     /* Volume Minimum Value */
 const uint16_t VolMax = 0x0100;     /* Volume Maximum Value */
 const uint16_t VolRes = 0x0004;     /* Volume Resolution */
 
+/* What the USB DMA moves: the Iso OUT Packets, P_C Frames in each of two
+   buffers (one is filled while the other is played), and the Feedback */
+typedef struct __ADC_BUF_T {
+  short    Data[2][P_C*P_MAX];      /* Packets back to back */
+  uint32_t Info[2][P_C];            /* Packet Info of each Frame */
+  uint32_t Feedback;                /* Samples per Frame, 10.14 format */
+  uint32_t FbInfo;                  /* its Packet Info (length 3) */
+} ADC_BUF_T;
+
+#if defined (  __CC_ARM  )
+#pragma arm section zidata = "USB_RAM"
+ADC_BUF_T ADC_Buf;                  /* USB DMA Buffers */
+#pragma arm section zidata
+#endif
+#if defined (  __IAR_SYSTEMS_ICC__  )
+#pragma location = "USB_RAM"
+ADC_BUF_T ADC_Buf;                  /* USB DMA Buffers */
+#endif
+#if defined (  __GNUC__  )
+ADC_BUF_T ADC_Buf __attribute__((section("USB_RAM")));
+#endif
+
+uint8_t  DataRun;                   /* Data Stream Run State */
+volatile uint32_t Tick;             /* Frame Counter */
+static uint8_t  ADC_OutIdx;         /* buffer the Iso OUT DMA fills */
+static uint32_t ADC_FbAcc;          /* Samples played this Feedback Period */
+static uint32_t ADC_FbVal = (DATA_FREQ << 14) / 1000;  /* Feedback to send */
+
 /*
  *  Audio Device Class Interface Get Request Callback
  *   Called automatically on ADC Interface Get Request
@@ -63,16 +100,16 @@ uint32_t ADC_IF_GetRequest (void) {
         case AUDIO_VOLUME_CONTROL:
           switch (SetupPacket.bRequest) {
             case AUDIO_REQUEST_GET_CUR:
-              *((__packed uint16_t *)EP0Buf) = VolCur;
+              UNALIGNED16(EP0Buf) = VolCur;
               return (TRUE);
             case AUDIO_REQUEST_GET_MIN:
-              *((__packed uint16_t *)EP0Buf) = VolMin;
+              UNALIGNED16(EP0Buf) = VolMin;
               return (TRUE);
             case AUDIO_REQUEST_GET_MAX:
-              *((__packed uint16_t *)EP0Buf) = VolMax;
+              UNALIGNED16(EP0Buf) = VolMax;
               return (TRUE);
             case AUDIO_REQUEST_GET_RES:
-              *((__packed uint16_t *)EP0Buf) = VolRes;
+              UNALIGNED16(EP0Buf) = VolRes;
               return (TRUE);
           }
           break;
@@ -115,7 +152,7 @@ uint32_t ADC_IF_SetRequest (void) {
         case AUDIO_VOLUME_CONTROL:
           switch (SetupPacket.bRequest) {
             case AUDIO_REQUEST_SET_CUR:
-              VolCur = *((__packed uint16_t *)EP0Buf);
+              VolCur = UNALIGNED16(EP0Buf);
               return (TRUE);
           }
           break;
@@ -162,3 +199,141 @@ uint32_t ADC_EP_SetRequest (void) {
 */
   return (FALSE);  /* Not Supported */
 }
+
+
+/*
+ *  Start the Iso OUT DMA: P_C Frames into the next buffer
+ */
+
+static void ADC_OutStart (void) {
+  USB_DMA_DESCRIPTOR DD;
+
+  DD.BufAdr  = (uint32_t)ADC_Buf.Data[ADC_OutIdx];  /* DMA Buffer Address */
+  DD.BufLen  = P_C;                         /* DMA Packet Count */
+  DD.MaxSize = 0;                           /* Must be 0 for Iso Transfer */
+  DD.InfoAdr = (uint32_t)ADC_Buf.Info[ADC_OutIdx];  /* Packet Info Buffer Address */
+  DD.Cfg.Val = 0;                           /* Initial DMA Configuration */
+  DD.Cfg.Type.IsoEP = 1;                    /* Iso Endpoint */
+  USB_DMA_Setup (0x03, &DD);                /* Setup DMA */
+  USB_DMA_Enable(0x03);                     /* Enable DMA */
+}
+
+
+/*
+ *  Start the Feedback DMA: one 3 byte Packet with the last value
+ */
+
+static void ADC_FbStart (void) {
+  USB_DMA_DESCRIPTOR DD;
+
+  ADC_Buf.Feedback = ADC_FbVal;
+  ADC_Buf.FbInfo   = 3;                     /* Packet Length */
+  DD.BufAdr  = (uint32_t)&ADC_Buf.Feedback;
+  DD.BufLen  = 1;
+  DD.MaxSize = 0;
+  DD.InfoAdr = (uint32_t)&ADC_Buf.FbInfo;
+  DD.Cfg.Val = 0;
+  DD.Cfg.Type.IsoEP = 1;
+  USB_DMA_Setup (0x83, &DD);
+  USB_DMA_Enable(0x83);
+}
+
+
+/*
+ *  Audio Device Class Set Interface Callback
+ *   Alternate Setting 1 of the Streaming Interface starts both DMAs,
+ *   Alternate Setting 0 stops them
+ */
+
+void ADC_SetInterface (void) {
+
+  if (USB_AltSetting[USB_ADC_SIF1_NUM]) {
+    ADC_OutStart();
+    ADC_FbStart();
+  } else {
+    USB_DMA_Disable(0x03);
+    USB_DMA_Disable(0x83);
+    DataRun = 0;                            /* Data Stream not running */
+  }
+}
+
+
+/*
+ *  Audio Device Class Iso OUT DMA Callback
+ *   The DMA goes on with the other buffer; at the End of Transfer the
+ *   P_C Frames just received go to the speaker
+ *    Parameters:      event: USB_EVT_OUT_DMA_EOT or USB_EVT_OUT_DMA_NDR
+ */
+
+void ADC_IsoOutDMA (uint32_t event) {
+  uint32_t buf, n, cnt, run;
+  short *pData;
+
+  if (USB_AltSetting[USB_ADC_SIF1_NUM] == 0) return;
+
+  buf = ADC_OutIdx;
+  ADC_OutIdx ^= 1;
+  ADC_OutStart();
+  if (event != USB_EVT_OUT_DMA_EOT) return;
+
+  pData = ADC_Buf.Data[buf];
+  run = 0;
+  for (n = 0; n < P_C; n++) {
+    if (ADC_Buf.Info[buf][n] & ADC_PKT_VALID) {
+      cnt = (ADC_Buf.Info[buf][n] & 0xFFFF) / 2;
+      if (!DataRun) {
+        spk_Start();                        /* Data Stream starts */
+        DataRun = 1;
+      }
+      spk_Put(pData, cnt);
+      pData += cnt;
+      run = 1;
+    }
+  }
+  if (!run) {
+    DataRun = 0;                            /* No Data: not running */
+  }
+}
+
+
+/*
+ *  Audio Device Class Feedback DMA Callback
+ *   The last Packet went to the Endpoint: prepare the next one
+ */
+
+void ADC_FeedbackDMA (void) {
+
+  if (USB_AltSetting[USB_ADC_SIF1_NUM]) {
+    ADC_FbStart();
+  }
+}
+
+
+/*
+ *  Audio Device Class Start of Frame Callback
+ *   Counts the Samples the DAC played. Every 2^FB_REFRESH Frames they
+ *   give the Feedback: the Samples per Frame the DAC really plays, plus
+ *   a small part of how far the fill is from half of the buffer, so the
+ *   Host keeps it there. A buffer that ran dry stops the Stream until
+ *   the next Packet.
+ */
+
+void ADC_SOF (void) {
+  int32_t fb;
+
+  Tick++;
+  ADC_FbAcc += spk_Played();
+  if ((Tick & ((1 << FB_REFRESH) - 1)) == 0) {
+    fb = ADC_FbAcc << (14 - FB_REFRESH);
+    if (DataRun) {
+      fb += ((int32_t)(B_S/2) - (int32_t)spk_Fill()) * (1 << (14 - FB_GAIN));
+    }
+    if (fb < ((P_S - 1) << 14)) fb = (P_S - 1) << 14;
+    if (fb > (P_MAX << 14))     fb = P_MAX << 14;
+    ADC_FbVal = fb;
+    ADC_FbAcc = 0;
+  }
+  if (DataRun && (spk_Fill() == 0)) {
+    DataRun = 0;                            /* Underrun */
+  }
+}
@@ -26,5 +26,11 @@ extern uint32_t ADC_IF_SetRequest (void);
 extern uint32_t ADC_EP_GetRequest (void);
 extern uint32_t ADC_EP_SetRequest (void);
 
+/* Audio Streaming Callback Functions */
+extern void ADC_SetInterface (void);
+extern void ADC_IsoOutDMA    (uint32_t event);
+extern void ADC_FeedbackDMA  (void);
+extern void ADC_SOF          (void);
+
 
 #endif  /* __ADCUSER_H__ */
@@ -0,0 +1,189 @@
+/*----------------------------------------------------------------------------
+ *      Name:    speaker.c
+ *      Purpose: DAC output fed by the GPDMA from a circular sample buffer
+ *      Version: V1.00
+ *----------------------------------------------------------------------------
+ *      DataBuf holds B_S samples as DACR words. DataOut is where the DMA
+ *      was at the last spk_Played, DataIn where the next sample goes; the
+ *      samples in between are still to be played. Samples the DMA has
+ *      taken are set back to the middle point, so if it ever catches up
+ *      with DataIn the speaker gets silence, not old sound.
+ *---------------------------------------------------------------------------*/
+
+#include "LPC17xx.h"                        /* LPC17xx definitions */
+#include "lpc_types.h"
+
+#include "usbaudio.h"
+#include "speaker.h"
+
+/* DAC Control Register */
+#define DAC_DBLBUF_ENA      (1UL << 1)      /* DACR goes out at the timeout */
+#define DAC_CNT_ENA         (1UL << 2)      /* Timeout Counter */
+#define DAC_DMA_ENA         (1UL << 3)      /* DMA Request at the timeout */
+
+/* GPDMA Channel Control and Configuration */
+#define DMA_CTRL_SW_WORD    (2UL << 18)     /* Source Width 32 bit */
+#define DMA_CTRL_DW_WORD    (2UL << 21)     /* Destination Width 32 bit */
+#define DMA_CTRL_SI         (1UL << 26)     /* Source Increment */
+#define DMA_CFG_E           (1UL <<  0)     /* Channel Enable */
+#define DMA_CFG_DST(conn)   ((conn) << 6)   /* Destination Peripheral */
+#define DMA_CFG_M2P         (1UL << 11)     /* Memory to Peripheral */
+#define DMA_CONN_DAC        7               /* DAC Request Line */
+
+#define SPK_DMA     ((LPC_GPDMACH_TypeDef *)(LPC_GPDMACH0_BASE + (SPK_DMA_CH * 0x20)))
+#define SPK_BLK     (B_S / SPK_LLI_CNT)     /* Samples per Linked List */
+#define SPK_MID     0x8000                  /* DAC Middle Point */
+
+/* GPDMA Linked List Item */
+typedef struct {
+  uint32_t SrcAddr;
+  uint32_t DstAddr;
+  uint32_t NextLLI;
+  uint32_t Control;
+} SPK_LLI_T;
+
+uint8_t  Mute;                              /* Mute State */
+uint32_t Volume;                            /* Volume Level */
+uint32_t VUM;                               /* VU Meter */
+
+uint32_t DataBuf[B_S];                      /* Data Buffer (DACR values) */
+uint16_t DataOut;                           /* Data Out Index */
+uint16_t DataIn;                            /* Data In Index */
+static uint32_t  DataCnt;                   /* Samples from DataOut to DataIn */
+static SPK_LLI_T spk_Lli[SPK_LLI_CNT];      /* the ring over DataBuf */
+
+
+/*
+ *  Speaker Initialize Function
+ *   Silence in DataBuf, the GPDMA ring going round it and the DAC asking
+ *   for one sample every 1/DATA_FREQ s (the nearest rate the DAC timer
+ *   gets to: the rate feedback tells the host the exact one)
+ *    Return Value:    None
+ */
+
+void spk_Init (void) {
+  LPC_GPDMACH_TypeDef *ch = SPK_DMA;
+  uint32_t n, pclk;
+
+  LPC_PINCON->PINSEL1 &= ~(0x03 << 20);
+  LPC_PINCON->PINSEL1 |=  (0x02 << 20);     /* P0.26 AOUT, function 10 */
+  LPC_DAC->DACR = SPK_MID;                  /* DAC Output set to Middle Point */
+
+  for (n = 0; n < B_S; n++) {
+    DataBuf[n] = SPK_MID;
+  }
+  DataOut = 0;
+  DataIn  = 0;
+  DataCnt = 0;
+
+  for (n = 0; n < SPK_LLI_CNT; n++) {
+    spk_Lli[n].SrcAddr = (uint32_t)&DataBuf[n * SPK_BLK];
+    spk_Lli[n].DstAddr = (uint32_t)&LPC_DAC->DACR;
+    spk_Lli[n].NextLLI = (uint32_t)&spk_Lli[(n + 1) % SPK_LLI_CNT];
+    spk_Lli[n].Control = SPK_BLK | DMA_CTRL_SW_WORD | DMA_CTRL_DW_WORD | DMA_CTRL_SI;
+  }
+
+  LPC_SC->PCONP |= (1UL << 29);             /* power up the GPDMA */
+  LPC_GPDMA->DMACConfig = 0x01;             /* enable, little endian */
+  LPC_GPDMA->DMACIntTCClear = (1UL << SPK_DMA_CH);
+  LPC_GPDMA->DMACIntErrClr  = (1UL << SPK_DMA_CH);
+  ch->DMACCSrcAddr  = spk_Lli[0].SrcAddr;
+  ch->DMACCDestAddr = spk_Lli[0].DstAddr;
+  ch->DMACCLLI      = spk_Lli[0].NextLLI;
+  ch->DMACCControl  = spk_Lli[0].Control;
+  ch->DMACCConfig   = DMA_CFG_E | DMA_CFG_DST(DMA_CONN_DAC) | DMA_CFG_M2P;
+
+  /* Bit 22~23 is for the DAC */
+  switch ((LPC_SC->PCLKSEL0 >> 22) & 0x03) {
+    case 0x01: pclk = SystemCoreClock;     break;
+    case 0x02: pclk = SystemCoreClock / 2; break;
+    case 0x03: pclk = SystemCoreClock / 8; break;
+    default:   pclk = SystemCoreClock / 4; break;
+  }
+  LPC_DAC->DACCNTVAL = (pclk + DATA_FREQ / 2) / DATA_FREQ - 1;
+  LPC_DAC->DACCTRL   = DAC_DBLBUF_ENA | DAC_CNT_ENA | DAC_DMA_ENA;
+}
+
+
+/*
+ *  Put Samples behind the ones still to be played
+ *   Applies Volume and Mute and accumulates the VU Meter
+ *    Parameters:      pData: 16 bit signed Samples
+ *                     cnt:   Number of Samples
+ *    Return Value:    Number of Samples put (less if DataBuf is full)
+ */
+
+uint32_t spk_Put (short *pData, uint32_t cnt) {
+  long val;
+  uint32_t n;
+
+  if (cnt > (B_S - 1) - DataCnt) {
+    cnt = (B_S - 1) - DataCnt;              /* Overrun: drop the rest */
+  }
+  for (n = 0; n < cnt; n++) {
+    val = *pData++;                         /* Get Audio Sample */
+    if (val < 0) VUM -= val;                /* Accumulate Neg Value */
+    else         VUM += val;                /* Accumulate Pos Value */
+    val  *= Volume;                         /* Apply Volume Level */
+    val >>= 16;                             /* Adjust Value */
+    val  += 0x8000;                         /* Add Bias */
+    val  &= 0xFFFF;                         /* Mask Value */
+    if (Mute) {
+      val = SPK_MID;                        /* DAC Middle Point */
+    }
+    DataBuf[DataIn] = val & 0xFFC0;
+    DataIn = (DataIn + 1) & (B_S - 1);
+  }
+  DataCnt += cnt;
+  return (cnt);
+}
+
+
+/*
+ *  Samples played since the last call
+ *   Their places go back to the Middle Point. If the DMA got past DataIn
+ *   (Underrun) nothing is left to play and DataIn follows the DMA.
+ *    Return Value:    Number of Samples the DMA took
+ */
+
+uint32_t spk_Played (void) {
+  uint32_t pos, cnt;
+
+  pos = ((SPK_DMA->DMACCSrcAddr - (uint32_t)DataBuf) / 4) & (B_S - 1);
+  cnt = (pos - DataOut) & (B_S - 1);
+  while (DataOut != pos) {
+    DataBuf[DataOut] = SPK_MID;
+    DataOut = (DataOut + 1) & (B_S - 1);
+  }
+  if (cnt >= DataCnt) {
+    DataIn  = DataOut;                      /* Underrun (or just empty) */
+    DataCnt = 0;
+  } else {
+    DataCnt -= cnt;
+  }
+  return (cnt);
+}
+
+
+/*
+ *  Start a Stream: half of DataBuf of silence in front of its first Sample
+ *    Return Value:    None
+ */
+
+void spk_Start (void) {
+
+  if (DataCnt < B_S/2) {
+    DataIn  = (DataOut + B_S/2) & (B_S - 1);
+    DataCnt = B_S/2;
+  }
+}
+
+
+/*
+ *  Samples still to be played
+ *    Return Value:    from DataOut to DataIn
+ */
+
+uint32_t spk_Fill (void) {
+  return (DataCnt);
+}
@@ -0,0 +1,25 @@
+/*----------------------------------------------------------------------------
+ *      Name:    speaker.h
+ *      Purpose: DAC output fed by the GPDMA from a circular sample buffer
+ *      Version: V1.00
+ *----------------------------------------------------------------------------
+ *      The GPDMA channel walks a ring of SPK_LLI_CNT linked lists over the
+ *      B_S samples of the buffer, one DACR word per DAC timeout, forever.
+ *      Nothing interrupts per sample: the USB side writes whole packets
+ *      ahead of the DMA and reads back how far it got.
+ *---------------------------------------------------------------------------*/
+
+#ifndef __SPEAKER_H__
+#define __SPEAKER_H__
+
+#define SPK_DMA_CH      0                   /* GPDMA channel buffer -> DAC */
+#define SPK_LLI_CNT     4                   /* Linked Lists in the ring */
+
+/* Speaker Functions */
+extern void     spk_Init   (void);
+extern uint32_t spk_Put    (short *pData, uint32_t cnt);
+extern uint32_t spk_Played (void);
+extern void     spk_Start  (void);
+extern uint32_t spk_Fill   (void);
+
+#endif  /* __SPEAKER_H__ */
@@ -16,14 +16,16 @@
 
 /* Audio Definitions */
 #define DATA_FREQ 32000                 /* Audio Data Frequency */
-#define P_S       32                    /* Packet Size */
-#if USB_DMA
-#define P_C       4                     /* Packet Count */
-#else
-#define P_C       1                     /* Packet Count */
-#endif
+#define P_S       32                    /* Packet Size (Samples per Frame) */
+#define P_MAX     (P_S + 1)             /* Max Packet Size (Samples), with the feedback */
+#define P_C       4                     /* Packet Count (Frames per DMA Descriptor) */
 #define B_S       (8*P_C*P_S)           /* Buffer Size */
 
+/* Rate Feedback: Samples per Frame in 10.14 format, sent every
+   2^FB_REFRESH Frames (bRefresh of the Feedback Endpoint) */
+#define FB_REFRESH 5
+#define FB_GAIN    8                    /* Fill error / 2^FB_GAIN added per Frame */
+
 /* Push Button Definitions */
 // #define PBINT     0x00004000            /* P0.14 */
 
@@ -34,13 +36,9 @@
 extern uint8_t  Mute;                      /* Mute State */
 extern uint32_t Volume;                    /* Volume Level */
 extern uint16_t  VolCur;                    /* Volume Current Value */
-#if !USB_DMA
-extern uint32_t InfoBuf[P_C];              /* Packet Info Buffer */
-extern short DataBuf[B_S];              /* Data Buffer */
-#else
-extern uint32_t *InfoBuf;
-extern short *DataBuf;
-#endif
+extern uint32_t VUM;                       /* VU Meter */
+extern uint32_t DataBuf[B_S];              /* Data Buffer (DACR values) */
 extern uint16_t  DataOut;                   /* Data Out Index */
 extern uint16_t  DataIn;                    /* Data In Index */
 extern uint8_t   DataRun;                   /* Data Stream Run State */
+extern volatile uint32_t Tick;             /* Frame Counter */
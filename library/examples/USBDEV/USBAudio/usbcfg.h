@@ -79,8 +79,8 @@
 #define USB_IF_NUM          4
 #define USB_EP_NUM          32
 #define USB_MAX_PACKET0     64
-#define USB_DMA             0
-#define USB_DMA_EP          0x00000040
+#define USB_DMA             1
+#define USB_DMA_EP          0x000000C0
 
 
 /*
@@ -129,7 +129,7 @@
 #define USB_ERROR_EVENT     0
 #define USB_EP_EVENT        0x0009
 #define USB_CONFIGURE_EVENT 0
-#define USB_INTERFACE_EVENT 0
+#define USB_INTERFACE_EVENT 1
 #define USB_FEATURE_EVENT   0
 
 
@@ -60,7 +60,7 @@ extern MSC_CSW CSW;
 #include "vendor.h"
 #endif
 
-#if defined (  __CC_ARM__  )
+#if defined   (  __CC_ARM  )
 #pragma diag_suppress 111,177,1441
 #endif
 
@@ -190,7 +190,7 @@ __inline uint32_t USB_ReqGetStatus (void) {
       break;
     case REQUEST_TO_INTERFACE:
       if ((USB_Configuration != 0) && (SetupPacket.wIndex.WB.L < USB_NumInterfaces)) {
-        *((__packed uint16_t *)EP0Buf) = 0;
+        UNALIGNED16(EP0Buf) = 0;
         EP0Data.pData = EP0Buf;
       } else {
         return (FALSE);
@@ -200,7 +200,7 @@ __inline uint32_t USB_ReqGetStatus (void) {
       n = SetupPacket.wIndex.WB.L & 0x8F;
       m = (n & 0x80) ? ((1 << 16) << (n & 0x0F)) : (1 << n);
       if (((USB_Configuration != 0) || ((n & 0x0F) == 0)) && (USB_EndPointMask & m)) {
-        *((__packed uint16_t *)EP0Buf) = (USB_EndPointHalt & m) ? 1 : 0;
+        UNALIGNED16(EP0Buf) = (USB_EndPointHalt & m) ? 1 : 0;
         EP0Data.pData = EP0Buf;
       } else {
         return (FALSE);
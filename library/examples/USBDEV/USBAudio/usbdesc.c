@@ -25,6 +25,7 @@
 #include "audio.h"
 #include "usbcfg.h"
 #include "usbdesc.h"
+#include "usbaudio.h"
 
 
 /* USB Standard Device Descriptor */
@@ -63,7 +64,8 @@ const uint8_t USB_ConfigDescriptor[] = {
     AUDIO_STREAMING_INTERFACE_DESC_SIZE +
     AUDIO_FORMAT_TYPE_I_DESC_SZ(1)      +
     AUDIO_STANDARD_ENDPOINT_DESC_SIZE   +
-    AUDIO_STREAMING_ENDPOINT_DESC_SIZE
+    AUDIO_STREAMING_ENDPOINT_DESC_SIZE  +
+    AUDIO_STANDARD_ENDPOINT_DESC_SIZE
   ),
   0x02,                                 /* bNumInterfaces */
   0x01,                                 /* bConfigurationValue */
@@ -139,7 +141,7 @@ const uint8_t USB_ConfigDescriptor[] = {
   USB_INTERFACE_DESCRIPTOR_TYPE,        /* bDescriptorType */
   0x01,                                 /* bInterfaceNumber */
   0x01,                                 /* bAlternateSetting */
-  0x01,                                 /* bNumEndpoints */
+  0x02,                                 /* bNumEndpoints */
   USB_DEVICE_CLASS_AUDIO,               /* bInterfaceClass */
   AUDIO_SUBCLASS_AUDIOSTREAMING,        /* bInterfaceSubClass */
   AUDIO_PROTOCOL_UNDEFINED,             /* bInterfaceProtocol */
@@ -165,11 +167,12 @@ const uint8_t USB_ConfigDescriptor[] = {
   AUDIO_STANDARD_ENDPOINT_DESC_SIZE,    /* bLength */
   USB_ENDPOINT_DESCRIPTOR_TYPE,         /* bDescriptorType */
   USB_ENDPOINT_OUT(3),                  /* bEndpointAddress */
-  USB_ENDPOINT_TYPE_ISOCHRONOUS,        /* bmAttributes */
-  WBVAL(64),                            /* wMaxPacketSize */
+  USB_ENDPOINT_TYPE_ISOCHRONOUS |
+  USB_ENDPOINT_SYNC_ASYNCHRONOUS,       /* bmAttributes */
+  WBVAL(P_MAX*2),                       /* wMaxPacketSize */
   0x01,                                 /* bInterval */
   0x00,                                 /* bRefresh */
-  0x00,                                 /* bSynchAddress */
+  USB_ENDPOINT_IN(3),                   /* bSynchAddress */
 /* Endpoint - Audio Streaming */
   AUDIO_STREAMING_ENDPOINT_DESC_SIZE,   /* bLength */
   AUDIO_ENDPOINT_DESCRIPTOR_TYPE,       /* bDescriptorType */
@@ -177,6 +180,16 @@ const uint8_t USB_ConfigDescriptor[] = {
   0x00,                                 /* bmAttributes */
   0x00,                                 /* bLockDelayUnits */
   WBVAL(0x0000),                        /* wLockDelay */
+/* Endpoint - Standard Descriptor, Rate Feedback */
+  AUDIO_STANDARD_ENDPOINT_DESC_SIZE,    /* bLength */
+  USB_ENDPOINT_DESCRIPTOR_TYPE,         /* bDescriptorType */
+  USB_ENDPOINT_IN(3),                   /* bEndpointAddress */
+  USB_ENDPOINT_TYPE_ISOCHRONOUS |
+  USB_ENDPOINT_USAGE_FEEDBACK,          /* bmAttributes */
+  WBVAL(3),                             /* wMaxPacketSize */
+  0x01,                                 /* bInterval */
+  FB_REFRESH,                           /* bRefresh */
+  0x00,                                 /* bSynchAddress */
 /* Terminator */
   0                                     /* bLength */
 };
@@ -29,7 +29,7 @@
 #include "usbcore.h"
 #include "usbuser.h"
 
-#if defined  (  __CC_ARM__  )
+#if defined   (  __CC_ARM  )
 #pragma diag_suppress 1441
 #endif
 
@@ -42,15 +42,36 @@
 
 #if USB_DMA
 
+#if defined (  __CC_ARM  )
 #pragma arm section zidata = "USB_RAM"
-uint32_t UDCA[USB_EP_NUM];                     /* UDCA in USB RAM */
-
+__align(128) uint32_t UDCA[USB_EP_NUM];        /* UDCA in USB RAM */
 uint32_t DD_NISO_Mem[4*DD_NISO_CNT];           /* Non-Iso DMA Descriptor Memory */
 uint32_t DD_ISO_Mem [5*DD_ISO_CNT];            /* Iso DMA Descriptor Memory */
 #pragma arm section zidata
 uint32_t udca[USB_EP_NUM];                     /* UDCA saved values */
+uint32_t DDMemMap[2];                          /* DMA Descriptor Memory Usage */
+#endif
+
+#if defined (  __IAR_SYSTEMS_ICC__  )
+#pragma location = "USB_RAM"
+#pragma data_alignment = 128
+uint32_t UDCA[USB_EP_NUM];                     /* UDCA in USB RAM */
+#pragma location = "USB_RAM"
+uint32_t DD_NISO_Mem[4*DD_NISO_CNT];           /* Non-Iso DMA Descriptor Memory */
+#pragma location = "USB_RAM"
+uint32_t DD_ISO_Mem [5*DD_ISO_CNT];            /* Iso DMA Descriptor Memory */
 
+uint32_t udca[USB_EP_NUM];                     /* UDCA saved values */
 uint32_t DDMemMap[2];                          /* DMA Descriptor Memory Usage */
+#endif
+
+#if defined (  __GNUC__  )
+uint32_t UDCA[USB_EP_NUM] __attribute__((section("USB_RAM"), aligned(128))); /* UDCA in USB RAM */
+uint32_t DD_NISO_Mem[4*DD_NISO_CNT] __attribute__((section("USB_RAM")));    /* Non-Iso DMA Descriptor Memory */
+uint32_t DD_ISO_Mem [5*DD_ISO_CNT] __attribute__((section("USB_RAM")));     /* Iso DMA Descriptor Memory */
+uint32_t udca[USB_EP_NUM];                     /* UDCA saved values */
+uint32_t DDMemMap[2];                          /* DMA Descriptor Memory Usage */
+#endif
 
 #endif
 
@@ -205,7 +226,7 @@ void USB_Reset (void) {
                (USB_ERROR_EVENT ? ERR_INT   : 0);
 
 #if USB_DMA
-  LPC_USB->USBUDCAH   = USB_RAM_ADR;
+  LPC_USB->USBUDCAH   = (uint32_t)UDCA;
   LPC_USB->USBDMARClr = 0xFFFFFFFF;
   LPC_USB->USBEpDMADis  = 0xFFFFFFFF;
   LPC_USB->USBEpDMAEn   = USB_DMA_EP;
@@ -425,7 +446,7 @@ uint32_t USB_ReadEP (uint32_t EPNum, uint8_t *pData) {
   cnt &= PKT_LNGTH_MASK;
 
   for (n = 0; n < (cnt + 3) / 4; n++) {
-    *((__packed uint32_t *)pData) = LPC_USB->USBRxData;
+    UNALIGNED32(pData) = LPC_USB->USBRxData;
     pData += 4;
   }
   LPC_USB->USBCtrl = 0;
@@ -455,7 +476,7 @@ uint32_t USB_WriteEP (uint32_t EPNum, uint8_t *pData, uint32_t cnt) {
   LPC_USB->USBTxPLen = cnt;
 
   for (n = 0; n < (cnt + 3) / 4; n++) {
-    LPC_USB->USBTxData = *((__packed uint32_t *)pData);
+    LPC_USB->USBTxData = UNALIGNED32(pData);
     pData += 4;
   }
   LPC_USB->USBCtrl = 0;
@@ -466,8 +487,9 @@ uint32_t USB_WriteEP (uint32_t EPNum, uint8_t *pData, uint32_t cnt) {
 #if USB_DMA
 
 /* DMA Descriptor Memory Layout */
-const uint32_t DDAdr[2] = { DD_NISO_ADR, DD_ISO_ADR };
+#define DDAdr(iso)  ((iso) ? (uint32_t)DD_ISO_Mem : (uint32_t)DD_NISO_Mem)
 const uint32_t DDSz [2] = { 16,          20         };
+const uint32_t DDCnt[2] = { DD_NISO_CNT, DD_ISO_CNT };
 
 
 /*
@@ -479,7 +501,7 @@ const uint32_t DDSz [2] = { 16,          20         };
 
 uint32_t USB_DMA_Setup(uint32_t EPNum, USB_DMA_DESCRIPTOR *pDD) {
   uint32_t num, ptr, nxt, iso, n;
-  uint32_t *t;
+  uint32_t *tmp;
 
   iso = pDD->Cfg.Type.IsoEP;                /* Iso or Non-Iso Descriptor */
   num = EPAdr(EPNum);                       /* Endpoint's Physical Address */
@@ -489,21 +511,21 @@ uint32_t USB_DMA_Setup(uint32_t EPNum, USB_DMA_DESCRIPTOR *pDD) {
   while (nxt) {                             /* Go through Descriptor List */
     ptr = nxt;                              /* Current Descriptor */
     if (!pDD->Cfg.Type.Link) {              /* Check for Linked Descriptors */
-      n = (ptr - DDAdr[iso]) / DDSz[iso];   /* Descriptor Index */
+      n = (ptr - DDAdr(iso)) / DDSz[iso];   /* Descriptor Index */
       DDMemMap[iso] &= ~(1 << n);           /* Unmark Memory Usage */
     }
     nxt = *((uint32_t *)ptr);                  /* Next Descriptor */
   }
 
-  for (n = 0; n < 32; n++) {                /* Search for available Memory */
+  for (n = 0; n < DDCnt[iso]; n++) {       /* Search for available Memory */
     if ((DDMemMap[iso] & (1 << n)) == 0) {
       break;                                /* Memory found */
     }
   }
-  if (n == 32) return (FALSE);              /* Memory not available */
+  if (n == DDCnt[iso]) return (FALSE);      /* Memory not available */
 
   DDMemMap[iso] |= 1 << n;                  /* Mark Memory Usage */
-  nxt = DDAdr[iso] + n * DDSz[iso];         /* Next Descriptor */
+  nxt = DDAdr(iso) + n * DDSz[iso];         /* Next Descriptor */
 
   if (ptr && pDD->Cfg.Type.Link) {
     *((uint32_t *)(ptr + 0))  = nxt;           /* Link in new Descriptor */
@@ -514,16 +536,16 @@ uint32_t USB_DMA_Setup(uint32_t EPNum, USB_DMA_DESCRIPTOR *pDD) {
   }
 
   /* Fill in DMA Descriptor */
-  *(((uint32_t *)nxt)++) =  0;                 /* Next DD Pointer */
-  *(((uint32_t *)nxt)++) =  pDD->Cfg.Type.ATLE |
+  tmp = (uint32_t *)nxt;
+  *tmp++ =  0;                              /* Next DD Pointer */
+  *tmp++ =  pDD->Cfg.Type.ATLE |
                        (pDD->Cfg.Type.IsoEP << 4) |
                        (pDD->MaxSize <<  5) |
                        (pDD->BufLen  << 16);
-  *(((uint32_t *)nxt)++) =  pDD->BufAdr;
-  *(((uint32_t *)nxt)++) =  pDD->Cfg.Type.LenPos << 8;
-
+  *tmp++ =  pDD->BufAdr;
+  *tmp++ =  pDD->Cfg.Type.LenPos << 8;
   if (iso) {
-    *((uint32_t *)nxt) =  pDD->InfoAdr;
+    *tmp =  pDD->InfoAdr;
   }
 
   return (TRUE); /* Success */
@@ -700,6 +722,7 @@ void USB_IRQHandler (void) {
 #if USB_SOF_EVENT
   /* Start of Frame Interrupt */
   if (disr & FRAME_INT) {
+    LPC_USB->USBDevIntClr = FRAME_INT;
     USB_SOF_Event();
   }
 #endif
@@ -753,6 +776,7 @@ void USB_IRQHandler (void) {
 
   if (LPC_USB->USBDMAIntSt & 0x00000001) {          /* End of Transfer Interrupt */
     val = LPC_USB->USBEoTIntSt;
+    LPC_USB->USBEoTIntClr = val;            /* before a new Transfer starts */
     for (n = 2; n < USB_EP_NUM; n++) {      /* Check All Endpoints */
       if (val & (1 << n)) {
         m = n >> 1;
@@ -767,7 +791,6 @@ void USB_IRQHandler (void) {
         }
       }
     }
-    LPC_USB->USBEoTIntClr = val;
   }
 
   if (LPC_USB->USBDMAIntSt & 0x00000002) {          /* New DD Request Interrupt */
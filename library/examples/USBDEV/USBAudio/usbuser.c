@@ -23,6 +23,7 @@
 #include "usbhw.h"
 #include "usbcore.h"
 #include "usbuser.h"
+#include "adcuser.h"
 
 #include "usbaudio.h"
 
@@ -91,20 +92,7 @@ void USB_WakeUp_Event (void) {
 
 #if USB_SOF_EVENT
 void USB_SOF_Event (void) {
-#if USB_DMA == 0
-  if (USB_ReadEP(0x03, (uint8_t *)&DataBuf[DataIn])) {
-    /* Data Available */
-    DataIn += P_S;                          /* Update Data In Index */
-    DataIn &= B_S - 1;                      /* Adjust Data In Index */
-    if (((DataIn - DataOut) & (B_S - 1)) == (B_S/2)) {
-      DataRun = 1;                          /* Data Stream running */
-    }
-  } else {
-    /* No Data */
-    DataRun  = 0;                           /* Data Stream not running */
-    DataOut  = DataIn;                      /* Initialize Data Indexes */
-  }
-#endif
+  ADC_SOF();
 }
 #endif
 
@@ -143,6 +131,7 @@ void USB_Configure_Event (void) {
 
 #if USB_INTERFACE_EVENT
 void USB_Interface_Event (void) {
+  ADC_SetInterface();
 }
 #endif
 
@@ -207,38 +196,17 @@ void USB_EndPoint2 (uint32_t event) {
  */
 
 void USB_EndPoint3 (uint32_t event) {
-#if USB_DMA
-  USB_DMA_DESCRIPTOR DD;
-
-  if (event & USB_EVT_OUT_DMA_EOT) {
-    /* End of Transfer */
-    if (USB_DMA_BufAdr(0x03) != ((uint32_t)DataBuf + 2*DataIn)) {
-      /* Data Available */
-      DataIn += P_C*P_S;                    /* Update Data In Index */
-      DataIn &= B_S - 1;                    /* Adjust Data In Index */
-      if (((DataIn - DataOut) & (B_S - 1)) == (B_S/2)) {
-        DataRun = 1;                        /* Data Stream running */
-      }
-    } else {
-      /* No Data */
-      DataRun = 0;                          /* Data Stream not running */
-      DataOut = DataIn;                     /* Initialize Data Indexes */
-    }
-  }
-  if (event & (USB_EVT_OUT_DMA_EOT) | (USB_EVT_OUT_DMA_NDR)) {
-    /* End of Transfer or New Descriptor Request */
-    DD.BufAdr  = (uint32_t)DataBuf + 2*DataIn; /* DMA Buffer Address */
-    DD.BufLen  = P_C;                       /* DMA Packet Count */
-    DD.MaxSize = 0;                         /* Must be 0 for Iso Transfer */
-    DD.InfoAdr = (uint32_t)InfoBuf;            /* Packet Info Buffer Address */
-    DD.Cfg.Val = 0;                         /* Initial DMA Configuration */
-    DD.Cfg.Type.IsoEP = 1;                  /* Iso Endpoint */
-    USB_DMA_Setup (0x03, &DD);              /* Setup DMA */
-    USB_DMA_Enable(0x03);                   /* Enable DMA */
+
+  switch (event) {
+    case USB_EVT_OUT_DMA_EOT:               /* Iso OUT: Audio Data */
+    case USB_EVT_OUT_DMA_NDR:
+      ADC_IsoOutDMA(event);
+      break;
+    case USB_EVT_IN_DMA_EOT:                /* Iso IN: Rate Feedback */
+    case USB_EVT_IN_DMA_NDR:
+      ADC_FeedbackDMA();
+      break;
   }
-#else
-  event = event;
-#endif
 }
 
 
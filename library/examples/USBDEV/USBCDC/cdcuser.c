@@ -16,6 +16,8 @@
  * Copyright (c) 2009 Keil - An ARM Company. All rights reserved.
  *---------------------------------------------------------------------------*/
 
+#include <string.h>
+#include "LPC17xx.h"
 #include "lpc_types.h"
 
 #include "usb.h"
@@ -27,90 +29,180 @@
 #include "serial.h"
 
 
-unsigned char BulkBufIn  [USB_CDC_BUFSIZE];            // Buffer to store USB IN  packet
-unsigned char BulkBufOut [USB_CDC_BUFSIZE];            // Buffer to store USB OUT packet
-unsigned char NotificationBuf [10];
+/*----------------------------------------------------------------------------
+  The data does not go through the CPU: each direction is a ring of whole
+  USB packets in USB RAM, filled by one DMA and emptied by the other.
 
-CDC_LINE_CODING CDC_LineCoding  = {9600, 0, 0, 8};
-unsigned short  CDC_SerialState = 0x0000;
-unsigned short  CDC_DepInEmpty  = 1;                   // Data IN EP is empty
+  Host -> UART (CDC_OutBuf): the Data OUT endpoint writes each packet into
+  the next free slot (USB DMA, or USB_ReadEP without it) and the GPDMA sends
+  the oldest one to the UART. While the ring is full the packets stay in
+  the endpoint and the host gets NAK.
 
-/*----------------------------------------------------------------------------
-  We need a buffer for incomming data on USB port because USB receives
-  much faster than  UART transmits
+  UART -> Host (CDC_InBuf): the GPDMA fills the slots one after the other
+  from the Rx FIFO. A full slot goes to the Data IN endpoint as it is; the
+  one being filled goes on the next SOF with what it has. While the ring is
+  full the GPDMA stops, and on UART1 auto-RTS holds the other side.
+
+  All this runs in the USB and the GPDMA interrupts, which have the same
+  priority: one never interrupts the other.
  *---------------------------------------------------------------------------*/
-/* Buffer masks */
-#define CDC_BUF_SIZE               (64)               // Output buffer in bytes (power 2)
-                                                       // large enough for file transfer
-#define CDC_BUF_MASK               (CDC_BUF_SIZE-1ul)
+#define CDC_OUT_MASK               (CDC_OUT_PKTS-1ul)
+#define CDC_IN_MASK                (CDC_IN_PKTS-1ul)
 
-/* Buffer read / write macros */
+/* Buffer macros */
 #define CDC_BUF_RESET(cdcBuf)      (cdcBuf.rdIdx = cdcBuf.wrIdx = 0)
-#define CDC_BUF_WR(cdcBuf, dataIn) (cdcBuf.data[CDC_BUF_MASK & cdcBuf.wrIdx++] = (dataIn))
-#define CDC_BUF_RD(cdcBuf)         (cdcBuf.data[CDC_BUF_MASK & cdcBuf.rdIdx++])
-#define CDC_BUF_EMPTY(cdcBuf)      (cdcBuf.rdIdx == cdcBuf.wrIdx)
-#define CDC_BUF_FULL(cdcBuf)       (cdcBuf.rdIdx == cdcBuf.wrIdx+1)
-#define CDC_BUF_COUNT(cdcBuf)      (CDC_BUF_MASK & (cdcBuf.wrIdx - cdcBuf.rdIdx))
-
+#define CDC_BUF_COUNT(cdcBuf)      (cdcBuf.wrIdx - cdcBuf.rdIdx)
+
+
+// CDC output buffer (Host -> UART)
+typedef struct __CDC_OUTBUF_T {
+  unsigned char data[CDC_OUT_PKTS][USB_CDC_BUFSIZE];
+  unsigned int len[CDC_OUT_PKTS];                      // bytes in each packet
+  unsigned int wrIdx;                                  // packets from the Host
+  unsigned int rdIdx;                                  // packets sent to the UART
+} CDC_OUTBUF_T;
+
+// CDC input buffer (UART -> Host)
+typedef struct __CDC_INBUF_T {
+  unsigned char data[CDC_IN_PKTS][USB_CDC_BUFSIZE];
+  unsigned int wrIdx;                                  // packets filled by the UART
+  unsigned int rdIdx;                                  // packets sent to the Host
+  unsigned int rdPos;                                  // bytes of packet rdIdx sent
+} CDC_INBUF_T;
+
+#if USB_DMA
+// the DMAs move the packets from and to these: keep them in USB RAM
+#if defined (  __CC_ARM  )
+#pragma arm section zidata = "USB_RAM"
+CDC_OUTBUF_T  CDC_OutBuf;                              // buffer for all CDC Out data
+CDC_INBUF_T   CDC_InBuf;                               // buffer for all CDC In data
+#pragma arm section zidata
+#endif
+#if defined (  __IAR_SYSTEMS_ICC__  )
+#pragma location = "USB_RAM"
+CDC_OUTBUF_T  CDC_OutBuf;                              // buffer for all CDC Out data
+#pragma location = "USB_RAM"
+CDC_INBUF_T   CDC_InBuf;                               // buffer for all CDC In data
+#endif
+#if defined (  __GNUC__  )
+CDC_OUTBUF_T  CDC_OutBuf __attribute__((section("USB_RAM")));
+CDC_INBUF_T   CDC_InBuf  __attribute__((section("USB_RAM")));
+#endif
+unsigned char CDC_OutDMA;                              // Data OUT DMA started
+unsigned int  CDC_InLen;                               // bytes of the Data IN DMA
+#else
+CDC_OUTBUF_T  CDC_OutBuf;                              // buffer for all CDC Out data
+CDC_INBUF_T   CDC_InBuf;                               // buffer for all CDC In data
+unsigned int  CDC_OutPending;                          // packets waiting in the Data OUT EP
+#endif
+unsigned char CDC_SerTx;                               // GPDMA sending packet rdIdx of CDC_OutBuf
+unsigned char CDC_SerRx;                               // GPDMA filling packet wrIdx of CDC_InBuf
+unsigned char NotificationBuf [10];
 
-// CDC output buffer
-typedef struct __CDC_BUF_T {
-  unsigned char data[CDC_BUF_SIZE];
-  unsigned int wrIdx;
-  unsigned int rdIdx;
-} CDC_BUF_T;
+CDC_LINE_CODING CDC_LineCoding  = {9600, 0, 0, 8};
+unsigned short  CDC_SerialState = 0x0000;
+unsigned short  CDC_DepInEmpty  = 1;                   // Data IN EP takes a packet
 
-CDC_BUF_T  CDC_OutBuf;                                 // buffer for all CDC Out data
 
 /*----------------------------------------------------------------------------
-  read data from CDC_OutBuf
+  let the Data OUT endpoint bring packets into the free slots of CDC_OutBuf
  *---------------------------------------------------------------------------*/
-int CDC_RdOutBuf (char *buffer, const int *length) {
-  int bytesToRead, bytesRead;
-
-  /* Read *length bytes, block if *bytes are not avaialable	*/
-  bytesToRead = *length;
-  bytesToRead = (bytesToRead < (*length)) ? bytesToRead : (*length);
-  bytesRead = bytesToRead;
+static void CDC_OutStart (void) {
+#if USB_DMA
 
+  if (!CDC_OutDMA && (CDC_BUF_COUNT(CDC_OutBuf) < CDC_OUT_PKTS)) {
+    CDC_OutDMA = USB_DMA_Start (CDC_DEP_OUT, CDC_OutBuf.data[CDC_OUT_MASK & CDC_OutBuf.wrIdx],
+                                USB_CDC_BUFSIZE);
+  }
+#else
+  unsigned int idx, len;
+
+  while (CDC_OutPending && (CDC_BUF_COUNT(CDC_OutBuf) < CDC_OUT_PKTS)) {
+    CDC_OutPending--;
+    idx = CDC_OUT_MASK & CDC_OutBuf.wrIdx;
+    len = USB_ReadEP (CDC_DEP_OUT, CDC_OutBuf.data[idx]);
+    if (len > 0) {                                     // zero length packets are dropped
+      CDC_OutBuf.len[idx] = len;
+      CDC_OutBuf.wrIdx++;
+    }
+  }
+#endif
+}
 
-  // ... add code to check for underrun
+/*----------------------------------------------------------------------------
+  send the oldest packet of CDC_OutBuf to the UART
+ *---------------------------------------------------------------------------*/
+static void CDC_SerTxStart (void) {
+  unsigned int idx;
 
-  while (bytesToRead--) {
-    *buffer++ = CDC_BUF_RD(CDC_OutBuf);
+  if (!CDC_SerTx && (CDC_BUF_COUNT(CDC_OutBuf) > 0)) {
+    CDC_SerTx = 1;
+    idx = CDC_OUT_MASK & CDC_OutBuf.rdIdx;
+    ser_DmaTx (CDC_OutBuf.data[idx], CDC_OutBuf.len[idx]);
   }
-  return (bytesRead);
 }
 
 /*----------------------------------------------------------------------------
-  write data to CDC_OutBuf
+  receive from the UART into the next free slot of CDC_InBuf
  *---------------------------------------------------------------------------*/
-int CDC_WrOutBuf (const char *buffer, int *length) {
-  int bytesToWrite, bytesWritten;
-
-  // Write *length bytes
-  bytesToWrite = *length;
-  bytesWritten = bytesToWrite;
+static void CDC_SerRxStart (void) {
 
+  if (!CDC_SerRx && (CDC_BUF_COUNT(CDC_InBuf) < CDC_IN_PKTS)) {
+    CDC_SerRx = 1;
+    ser_DmaRx (CDC_InBuf.data[CDC_IN_MASK & CDC_InBuf.wrIdx], USB_CDC_BUFSIZE);
+  }
+}
 
-  // ... add code to check for overwrite
+/*----------------------------------------------------------------------------
+  n bytes of packet rdIdx of CDC_InBuf left: the slot is free after the last
+ *---------------------------------------------------------------------------*/
+static void CDC_InSent (unsigned int n) {
 
-  while (bytesToWrite) {
-      CDC_BUF_WR(CDC_OutBuf, *buffer++);           // Copy Data to buffer
-      bytesToWrite--;
+  CDC_InBuf.rdPos += n;
+  if (CDC_InBuf.rdPos == USB_CDC_BUFSIZE) {
+    CDC_InBuf.rdPos = 0;
+    CDC_InBuf.rdIdx++;
+    CDC_SerRxStart();                                  // if it stopped on a full buffer
   }
-
-  return (bytesWritten);
 }
 
 /*----------------------------------------------------------------------------
-  check if character(s) are available at CDC_OutBuf
+  send from CDC_InBuf to the Data IN endpoint, if it takes a packet: the rest
+  of a full packet, or with flush what came so far into the one being filled
  *---------------------------------------------------------------------------*/
-int CDC_OutBufAvailChar (int *availChar) {
+static void CDC_InStart (unsigned int flush) {
+  unsigned int n;
+  unsigned char *p;
 
-  *availChar = CDC_BUF_COUNT(CDC_OutBuf);
+  if (!CDC_DepInEmpty) {
+    return;
+  }
+  if (CDC_BUF_COUNT(CDC_InBuf) > 0) {
+    n = USB_CDC_BUFSIZE - CDC_InBuf.rdPos;
+  }
+  else if (flush && CDC_SerRx) {
+    n = ser_DmaRxCount();
+    if (n >= USB_CDC_BUFSIZE) {                        // full: CDC_SerialRxDMA sends it
+      return;
+    }
+    n -= CDC_InBuf.rdPos;
+  }
+  else {
+    n = 0;
+  }
+  if (n == 0) {
+    return;
+  }
 
-  return (0);
+  p = &CDC_InBuf.data[CDC_IN_MASK & CDC_InBuf.rdIdx][CDC_InBuf.rdPos];
+  CDC_DepInEmpty = 0;
+#if USB_DMA
+  CDC_InLen = n;
+  USB_DMA_Start (CDC_DEP_IN, p, n);
+#else
+  USB_WriteEP (CDC_DEP_IN, p, n);
+  CDC_InSent (n);
+#endif
 }
 /* end Buffer handling */
 
@@ -143,6 +235,31 @@ void CDC_Init (char portNum ) {
   CDC_SerialState = CDC_GetSerialState();
 
   CDC_BUF_RESET(CDC_OutBuf);
+  CDC_BUF_RESET(CDC_InBuf);
+  CDC_InBuf.rdPos = 0;
+  CDC_SerTx = 0;
+  CDC_SerRx = 0;
+  CDC_SerRxStart();                                    // UART data from now on
+}
+
+
+/*----------------------------------------------------------------------------
+  CDC Configure
+  Called when the device is configured: the data endpoints start empty
+  (USB_Reset has stopped their DMA), and take packets again
+  Parameters:   None
+  Return Value: None
+ *---------------------------------------------------------------------------*/
+void CDC_Configure (void) {
+
+#if USB_DMA
+  CDC_OutDMA = 0;
+#else
+  CDC_OutPending = 0;
+#endif
+  CDC_DepInEmpty = 1;
+  CDC_OutStart();
+  CDC_InStart (0);
 }
 
 
@@ -295,44 +412,110 @@ uint32_t CDC_SendBreak (unsigned short wDurationOfBreak) {
 
 /*----------------------------------------------------------------------------
   CDC_BulkIn call on DataIn Request
+  The Data IN endpoint takes a packet: send the next one of CDC_InBuf
   Parameters:   none
   Return Value: none
  *---------------------------------------------------------------------------*/
 void CDC_BulkIn(void) {
-  int numBytesRead, numBytesAvail;
 
-  ser_AvailChar (&numBytesAvail);
+  CDC_DepInEmpty = 1;
+  CDC_InStart (0);
+}
 
-  // ... add code to check for overwrite
 
-  numBytesRead = ser_Read ((char *)&BulkBufIn[0], &numBytesAvail);
+/*----------------------------------------------------------------------------
+  CDC_BulkOut call on DataOut Request
+  A packet is in the Data OUT endpoint: take it if CDC_OutBuf has room
+  (without USB DMA only)
+  Parameters:   none
+  Return Value: none
+ *---------------------------------------------------------------------------*/
+void CDC_BulkOut(void) {
 
-  // send over USB
-  if (numBytesRead > 0) {
-	USB_WriteEP (CDC_DEP_IN, &BulkBufIn[0], numBytesRead);
-  }
-  else {
-    CDC_DepInEmpty = 1;
+#if !USB_DMA
+  CDC_OutPending++;
+  CDC_OutStart();
+  CDC_SerTxStart();
+#endif
+}
+
+
+#if USB_DMA
+/*----------------------------------------------------------------------------
+  CDC_BulkInDMA call on DataIn DMA End of Transfer
+  The packet is in the endpoint and its slot of CDC_InBuf is done with.
+  Back in slave mode the endpoint raises its DataIn event (CDC_BulkIn)
+  when it takes the next one
+  Parameters:   none
+  Return Value: none
+ *---------------------------------------------------------------------------*/
+void CDC_BulkInDMA(void) {
+
+  USB_DMA_Stop (CDC_DEP_IN);
+  CDC_InSent (CDC_InLen);
+}
+
+
+/*----------------------------------------------------------------------------
+  CDC_BulkOutDMA call on DataOut DMA End of Transfer
+  A packet is in CDC_OutBuf: keep it, and go on with the next free one
+  Parameters:   none
+  Return Value: none
+ *---------------------------------------------------------------------------*/
+void CDC_BulkOutDMA(void) {
+  unsigned int numBytesRead;
+
+  numBytesRead = USB_DMA_Count (CDC_DEP_OUT);
+  if (numBytesRead > 0) {                              // zero length packets are dropped
+    CDC_OutBuf.len[CDC_OUT_MASK & CDC_OutBuf.wrIdx] = numBytesRead;
+    CDC_OutBuf.wrIdx++;
   }
+  CDC_OutDMA = 0;
+  CDC_OutStart();
+  CDC_SerTxStart();
 }
+#endif
 
 
 /*----------------------------------------------------------------------------
-  CDC_BulkOut call on DataOut Request
+  CDC_SerialTxDMA call on GPDMA end of block to the UART
+  The oldest packet of CDC_OutBuf is in the UART: its slot is free
   Parameters:   none
   Return Value: none
  *---------------------------------------------------------------------------*/
-void CDC_BulkOut(void) {
-  int numBytesRead;
+void CDC_SerialTxDMA(void) {
+
+  CDC_OutBuf.rdIdx++;
+  CDC_SerTx = 0;
+  CDC_SerTxStart();
+  CDC_OutStart();                                      // if it stopped on a full buffer
+}
 
-  // get data from USB into intermediate buffer
-  numBytesRead = USB_ReadEP(CDC_DEP_OUT, &BulkBufOut[0]);
 
-  // ... add code to check for overwrite
+/*----------------------------------------------------------------------------
+  CDC_SerialRxDMA call on GPDMA end of block from the UART
+  A packet of CDC_InBuf is full: it goes to the Host as it is
+  Parameters:   none
+  Return Value: none
+ *---------------------------------------------------------------------------*/
+void CDC_SerialRxDMA(void) {
+
+  CDC_InBuf.wrIdx++;
+  CDC_SerRx = 0;
+  CDC_SerRxStart();
+  CDC_InStart (0);
+}
 
-  // store data in a buffer to transmit it over serial interface
-  CDC_WrOutBuf ((char *)&BulkBufOut[0], &numBytesRead);
 
+/*----------------------------------------------------------------------------
+  CDC_SOF call on USB Start of Frame, every ms
+  The packet being filled from the UART goes with what it has
+  Parameters:   none
+  Return Value: none
+ *---------------------------------------------------------------------------*/
+void CDC_SOF(void) {
+
+  CDC_InStart (1);
 }
 
 
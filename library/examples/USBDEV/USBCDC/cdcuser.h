@@ -19,10 +19,13 @@
 #ifndef __CDCUSER_H__
 #define __CDCUSER_H__
 
-/* CDC buffer handling */
-extern int CDC_RdOutBuf        (char *buffer, const int *length);
-extern int CDC_WrOutBuf        (const char *buffer, int *length);
-extern int CDC_OutBufAvailChar (int *availChar);
+/* CDC buffers: rings of whole packets in USB RAM (power of 2) */
+#ifndef CDC_OUT_PKTS
+#define CDC_OUT_PKTS     32              /* Host -> UART, 2 kB */
+#endif
+#ifndef CDC_IN_PKTS
+#define CDC_IN_PKTS      32              /* UART -> Host, 2 kB */
+#endif
 
 
 /* CDC Data In/Out Endpoint Address */
@@ -46,12 +49,22 @@ extern uint32_t CDC_SendBreak                (unsigned short wDurationOfBreak);
 /* CDC Bulk Callback Functions */
 extern void CDC_BulkIn                   (void);
 extern void CDC_BulkOut                  (void);
+extern void CDC_BulkInDMA                (void);
+extern void CDC_BulkOutDMA               (void);
+
+/* CDC Serial Callback Functions (GPDMA end of block) */
+extern void CDC_SerialTxDMA              (void);
+extern void CDC_SerialRxDMA              (void);
+
+/* CDC Start of Frame Callback Function */
+extern void CDC_SOF                      (void);
 
 /* CDC Notification Callback Function */
 extern void CDC_NotificationIn           (void);
 
 /* CDC Initializtion Function */
 extern void CDC_Init (char portNum);
+extern void CDC_Configure (void);
 
 /* CDC prepare the SERAIAL_STATE */
 extern unsigned short CDC_GetSerialState (void);
@@ -16,33 +16,32 @@
 #include "LPC17xx.h"                                   // LPC17xx definitions
 #include "lpc_types.h"
 #include "serial.h"
+#include "cdcuser.h"
 
 
 /*----------------------------------------------------------------------------
-  Defines for ring buffers
+  Defines for the GPDMA
  *---------------------------------------------------------------------------*/
-#define SER_BUF_SIZE               (128)               // serial buffer in bytes (power 2)
-#define SER_BUF_MASK               (SER_BUF_SIZE-1ul)  // buffer size mask
-
-/* Buffer read / write macros */
-#define SER_BUF_RESET(serBuf)      (serBuf.rdIdx = serBuf.wrIdx = 0)
-#define SER_BUF_WR(serBuf, dataIn) (serBuf.data[SER_BUF_MASK & serBuf.wrIdx++] = (dataIn))
-#define SER_BUF_RD(serBuf)         (serBuf.data[SER_BUF_MASK & serBuf.rdIdx++])
-#define SER_BUF_EMPTY(serBuf)      (serBuf.rdIdx == serBuf.wrIdx)
-#define SER_BUF_FULL(serBuf)       (serBuf.rdIdx == serBuf.wrIdx+1)
-#define SER_BUF_COUNT(serBuf)      (SER_BUF_MASK & (serBuf.wrIdx - serBuf.rdIdx))
-
-// buffer type
-typedef struct __SER_BUF_T {
-  unsigned char data[SER_BUF_SIZE];
-  unsigned int wrIdx;
-  unsigned int rdIdx;
-} SER_BUF_T;
-
-unsigned long          ser_txRestart;                  // NZ if TX restart is required
+#define SER_DMA_CH(n)              ((LPC_GPDMACH_TypeDef *)(LPC_GPDMACH0_BASE + ((n) * 0x20)))
+
+#define DMA_CTRL_SI                (1UL << 26)         // source increment
+#define DMA_CTRL_DI                (1UL << 27)         // destination increment
+#define DMA_CTRL_I                 (1UL << 31)         // terminal count interrupt
+#define DMA_CFG_E                  (1UL <<  0)         // channel enable
+#define DMA_CFG_SRC(conn)          ((conn) <<  1)      // source peripheral
+#define DMA_CFG_DST(conn)          ((conn) <<  6)      // destination peripheral
+#define DMA_CFG_M2P                (1UL << 11)         // memory to peripheral
+#define DMA_CFG_P2M                (2UL << 11)         // peripheral to memory
+#define DMA_CFG_IE                 (1UL << 14)         // error interrupt
+#define DMA_CFG_ITC                (1UL << 15)         // terminal count interrupt
+
+#define DMA_CONN_TX(port)          (8 + 2 * (port))    // UARTn Tx request line
+#define DMA_CONN_RX(port)          (9 + 2 * (port))    // UARTn Rx request line
+
+
 unsigned short         ser_lineState;                  // ((msr << 8) | (lsr))
-SER_BUF_T              ser_out;                        // Serial data buffers
-SER_BUF_T              ser_in;
+static unsigned char   ser_portNum;                    // port of the DMA transfers
+static unsigned long   ser_rxStart;                    // where the Rx block began
 
 /*----------------------------------------------------------------------------
   open the serial port
@@ -62,7 +61,18 @@ void ser_OpenPort (char portNum) {
 	NVIC_DisableIRQ(UART1_IRQn);
 	LPC_PINCON->PINSEL4 &= ~0x0000000F;
 	LPC_PINCON->PINSEL4 |= 0x0000000A;    /* Enable RxD1 P2.1, TxD1 P2.0 */
+#if SER_AUTO_RTS
+	LPC_PINCON->PINSEL4 &= ~0x0000C000;
+	LPC_PINCON->PINSEL4 |= 0x00008000;    /* RTS1 P2.7 */
+#endif
   }
+
+  /* GPDMA: the UART request lines, not the timer matches */
+  ser_portNum = portNum;
+  LPC_SC->PCONP |= (1UL << 29);                       // power up the GPDMA
+  LPC_SC->DMAREQSEL &= ~(3UL << (2 * portNum));
+  LPC_GPDMA->DMACConfig = 0x01;                       // enable, little endian
+  NVIC_EnableIRQ(DMA_IRQn);
   return;
 }
 
@@ -82,6 +92,9 @@ void ser_ClosePort (char portNum ) {
   {
 	/* Port 1 */
 	LPC_PINCON->PINSEL4 &= ~0x0000000F;
+#if SER_AUTO_RTS
+	LPC_PINCON->PINSEL4 &= ~0x0000C000;
+#endif
 	/* Disable the interrupt in the VIC and UART controllers */
 	LPC_UART1->IER = 0;
 	NVIC_DisableIRQ(UART1_IRQn);
@@ -145,8 +158,7 @@ void ser_InitPort0 (unsigned long baudrate, unsigned int  databits,
     break;
   }
 
-  SER_BUF_RESET(ser_out);                              // reset out buffer
-  SER_BUF_RESET(ser_in);                               // reset in buffer
+  LPC_UART0->FCR = 0;                                 // no DMA requests while the divisor is changed
 
   /* Bit 6~7 is for UART0 */
   pclkdiv = (LPC_SC->PCLKSEL0 >> 6) & 0x03;
@@ -174,10 +186,9 @@ void ser_InitPort0 (unsigned long baudrate, unsigned int  databits,
   LPC_UART0->DLL = dll;                           // Baud Rate depending on PCLK
   LPC_UART0->DLM = (dll >> 8);                    // High divisor latch
   LPC_UART0->LCR = 0x00 | lcr_d | lcr_p | lcr_s;  // DLAB = 0
-  LPC_UART0->IER = 0x03;                          // Enable TX/RX interrupts
+  LPC_UART0->IER = 0x04;                          // Enable line status interrupt
 
-  LPC_UART0->FCR = 0x07;				/* Enable and reset TX and RX FIFO. */
-  ser_txRestart = 1;                                   // TX fifo is empty
+  LPC_UART0->FCR = 0x0F;				/* Enable and reset TX and RX FIFO, DMA mode. */
 
   /* Enable the UART Interrupt */
   NVIC_EnableIRQ(UART0_IRQn);
@@ -240,8 +251,7 @@ void ser_InitPort1 (unsigned long baudrate, unsigned int  databits,
     break;
   }
 
-  SER_BUF_RESET(ser_out);                              // reset out buffer
-  SER_BUF_RESET(ser_in);                               // reset in buffer
+  LPC_UART1->FCR = 0;                                 // no DMA requests while the divisor is changed
 
   /* Bit 8,9 are for UART1 */
   pclkdiv = (LPC_SC->PCLKSEL0 >> 8) & 0x03;
@@ -269,10 +279,12 @@ void ser_InitPort1 (unsigned long baudrate, unsigned int  databits,
   LPC_UART1->DLL = dll;                           // Baud Rate depending on PCLK
   LPC_UART1->DLM = (dll >> 8);                    // High divisor latch
   LPC_UART1->LCR = 0x00 | lcr_d | lcr_p | lcr_s;  // DLAB = 0
-  LPC_UART1->IER = 0x03;                          // Enable TX/RX interrupts
+  LPC_UART1->IER = 0x0C;                          // Enable line and modem status interrupts
+#if SER_AUTO_RTS
+  LPC_UART1->MCR = 0x40;                          // Auto-RTS
+#endif
 
-  LPC_UART1->FCR = 0x07;				/* Enable and reset TX and RX FIFO. */
-  ser_txRestart = 1;                                   // TX fifo is empty
+  LPC_UART1->FCR = 0x0F;				/* Enable and reset TX and RX FIFO, DMA mode. */
 
   /* Enable the UART Interrupt */
   NVIC_EnableIRQ(UART1_IRQn);
@@ -280,61 +292,48 @@ void ser_InitPort1 (unsigned long baudrate, unsigned int  databits,
 }
 
 /*----------------------------------------------------------------------------
-  read data from serial port
+  send a block: the GPDMA feeds it to the Tx FIFO, CDC_SerialTxDMA is
+  called when the last byte is in
  *---------------------------------------------------------------------------*/
-int ser_Read (char *buffer, const int *length) {
-  int bytesToRead, bytesRead;
-
-  /* Read *length bytes, block if *bytes are not avaialable	*/
-  bytesToRead = *length;
-  bytesToRead = (bytesToRead < (*length)) ? bytesToRead : (*length);
-  bytesRead = bytesToRead;
-
-  while (bytesToRead--) {
-    while (SER_BUF_EMPTY(ser_in));                     // Block until data is available if none
-    *buffer++ = SER_BUF_RD(ser_in);
-  }
-  return (bytesRead);
+void ser_DmaTx (const unsigned char *buffer, unsigned int length) {
+  LPC_GPDMACH_TypeDef *ch = SER_DMA_CH(SER_DMA_TX_CH);
+
+  LPC_GPDMA->DMACIntTCClear = (1UL << SER_DMA_TX_CH);
+  LPC_GPDMA->DMACIntErrClr  = (1UL << SER_DMA_TX_CH);
+  ch->DMACCSrcAddr  = (unsigned long)buffer;
+  ch->DMACCDestAddr = (ser_portNum == 0) ? (unsigned long)&LPC_UART0->THR
+                                         : (unsigned long)&LPC_UART1->THR;
+  ch->DMACCLLI      = 0;
+  ch->DMACCControl  = (length & 0xFFF) | DMA_CTRL_SI | DMA_CTRL_I;   // bytes, bursts of 1
+  ch->DMACCConfig   = DMA_CFG_E | DMA_CFG_DST(DMA_CONN_TX(ser_portNum)) |
+                      DMA_CFG_M2P | DMA_CFG_IE | DMA_CFG_ITC;
 }
 
 /*----------------------------------------------------------------------------
-  write data to the serial port
+  receive a block: the GPDMA empties the Rx FIFO into it as bytes come,
+  CDC_SerialRxDMA is called when it is full
  *---------------------------------------------------------------------------*/
-int ser_Write (char portNum, const char *buffer, int *length) {
-  int  bytesToWrite, bytesWritten;
-
-  // Write *length bytes
-  bytesToWrite = *length;
-  bytesWritten = bytesToWrite;
-
-  while (!SER_BUF_EMPTY(ser_out));               // Block until space is available if none
-  while (bytesToWrite) {
-      SER_BUF_WR(ser_out, *buffer++);            // Read Rx FIFO to buffer
-      bytesToWrite--;
-  }
-
-  if (ser_txRestart) {
-    ser_txRestart = 0;
-	if ( portNum == 0 )
-	{
-	  LPC_UART0->THR = SER_BUF_RD(ser_out);             // Write to the Tx Register
-    }
-	else
-	{
-      LPC_UART1->THR = SER_BUF_RD(ser_out);             // Write to the Tx Register
-	}
-  }
-
-  return (bytesWritten);
+void ser_DmaRx (unsigned char *buffer, unsigned int length) {
+  LPC_GPDMACH_TypeDef *ch = SER_DMA_CH(SER_DMA_RX_CH);
+
+  LPC_GPDMA->DMACIntTCClear = (1UL << SER_DMA_RX_CH);
+  LPC_GPDMA->DMACIntErrClr  = (1UL << SER_DMA_RX_CH);
+  ser_rxStart = (unsigned long)buffer;
+  ch->DMACCSrcAddr  = (ser_portNum == 0) ? (unsigned long)&LPC_UART0->RBR
+                                         : (unsigned long)&LPC_UART1->RBR;
+  ch->DMACCDestAddr = (unsigned long)buffer;
+  ch->DMACCLLI      = 0;
+  ch->DMACCControl  = (length & 0xFFF) | DMA_CTRL_DI | DMA_CTRL_I;
+  ch->DMACCConfig   = DMA_CFG_E | DMA_CFG_SRC(DMA_CONN_RX(ser_portNum)) |
+                      DMA_CFG_P2M | DMA_CFG_IE | DMA_CFG_ITC;
 }
 
 /*----------------------------------------------------------------------------
-  check if character(s) are available at the serial interface
+  bytes of the Rx block already in memory
  *---------------------------------------------------------------------------*/
-void ser_AvailChar (int *availChar) {
-
-  *availChar = SER_BUF_COUNT(ser_in);
+unsigned int ser_DmaRxCount (void) {
 
+  return (SER_DMA_CH(SER_DMA_RX_CH)->DMACCDestAddr - ser_rxStart);
 }
 
 /*----------------------------------------------------------------------------
@@ -348,57 +347,39 @@ void ser_LineState (unsigned short *lineState) {
 }
 
 /*----------------------------------------------------------------------------
-  serial port 0 interrupt
+  serial port 0 interrupt: line status only, the data goes by DMA
  *---------------------------------------------------------------------------*/
 void UART0_IRQHandler(void)
 {
-  volatile unsigned long iir;
-
-  iir = LPC_UART0->IIR;
-
-  if ((iir & 0x4) || (iir & 0xC)) {            // RDA or CTI pending
-    while (LPC_UART0->LSR & 0x01) {                 // Rx FIFO is not empty
-      SER_BUF_WR(ser_in, LPC_UART0->RBR);           // Read Rx FIFO to buffer
-    }
-  }
-  if ((iir & 0x2)) {                           // TXMIS pending
-	if (SER_BUF_COUNT(ser_out) != 0) {
-      LPC_UART0->THR = SER_BUF_RD(ser_out);         // Write to the Tx FIFO
-      ser_txRestart = 0;
-    }
-	else {
-      ser_txRestart = 1;
-	}
-  }
-  ser_lineState = LPC_UART0->LSR & 0x1E;            // update linestate
+  ser_lineState |= LPC_UART0->LSR & 0x1E;           // update linestate
   return;
 }
 
 /*----------------------------------------------------------------------------
-  serial port 1 interrupt
+  serial port 1 interrupt: line and modem status only
  *---------------------------------------------------------------------------*/
 void UART1_IRQHandler(void)
 {
-  volatile unsigned long iir;
+  ser_lineState |= ((LPC_UART1->MSR<<8)|LPC_UART1->LSR) & 0xE01E;    // update linestate
+  return;
+}
 
-  iir = LPC_UART1->IIR;
+/*----------------------------------------------------------------------------
+  GPDMA interrupt: end of a Tx or Rx block (or a bus error, which ends it too)
+ *---------------------------------------------------------------------------*/
+void DMA_IRQHandler(void)
+{
+  unsigned long done;
 
-  if ((iir & 0x4) || (iir & 0xC)) {            // RDA or CTI pending
-    while (LPC_UART1->LSR & 0x01) {                 // Rx FIFO is not empty
-      SER_BUF_WR(ser_in, LPC_UART1->RBR);           // Read Rx FIFO to buffer
-    }
+  done = LPC_GPDMA->DMACIntTCStat | LPC_GPDMA->DMACIntErrStat;
+  LPC_GPDMA->DMACIntTCClear = done;
+  LPC_GPDMA->DMACIntErrClr  = done;
+
+  if (done & (1UL << SER_DMA_RX_CH)) {
+    CDC_SerialRxDMA();
   }
-  if ((iir & 0x2)) {                           // TXMIS pending
-	if (SER_BUF_COUNT(ser_out) != 0) {
-      LPC_UART1->THR = SER_BUF_RD(ser_out);         // Write to the Tx FIFO
-      ser_txRestart = 0;
-    }
-	else {
-      ser_txRestart = 1;
-	}
+  if (done & (1UL << SER_DMA_TX_CH)) {
+    CDC_SerialTxDMA();
   }
-  ser_lineState = ((LPC_UART1->MSR<<8)|LPC_UART1->LSR) & 0xE01E;    // update linestate
   return;
 }
-
-
@@ -16,6 +16,20 @@
 
 #define PORT_NUM	1
 
+/*----------------------------------------------------------------------------
+ Serial data is moved by two GPDMA channels, straight between the UART and
+ the caller's buffers. Channel 0 has the higher priority: it is the one that
+ loses data if it is late.
+ *---------------------------------------------------------------------------*/
+#define SER_DMA_RX_CH   0                      // GPDMA channel UART -> memory
+#define SER_DMA_TX_CH   1                      // GPDMA channel memory -> UART
+
+/* UART1 only: RTS goes inactive while the Rx FIFO is at its trigger level,
+   so the other side stops sending when the receive buffers are full */
+#ifndef SER_AUTO_RTS
+#define SER_AUTO_RTS    1
+#endif
+
 /*----------------------------------------------------------------------------
  Serial interface related prototypes
  *---------------------------------------------------------------------------*/
@@ -23,8 +37,10 @@ extern void  ser_OpenPort  (char portNum);
 extern void  ser_ClosePort (char portNum);
 extern void  ser_InitPort0  (unsigned long baudrate, unsigned int databits, unsigned int parity, unsigned int stopbits);
 extern void  ser_InitPort1  (unsigned long baudrate, unsigned int databits, unsigned int parity, unsigned int stopbits);
-extern void  ser_AvailChar (int *availChar);
-extern int   ser_Write     (char portNum, const char *buffer, int *length);
-extern int   ser_Read      (char *buffer, const int *length);
 extern void  ser_LineState (unsigned short *lineState);
 
+/* DMA block transfers of the open port; the end of each block calls
+   CDC_SerialTxDMA / CDC_SerialRxDMA from the GPDMA interrupt */
+extern void          ser_DmaTx      (const unsigned char *buffer, unsigned int length);
+extern void          ser_DmaRx      (unsigned char *buffer, unsigned int length);
+extern unsigned int  ser_DmaRxCount (void);
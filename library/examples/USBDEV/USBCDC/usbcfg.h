@@ -79,7 +79,7 @@
 #define USB_IF_NUM          4
 #define USB_EP_NUM          32
 #define USB_MAX_PACKET0     8
-#define USB_DMA             0
+#define USB_DMA             1
 #define USB_DMA_EP          0x00000000
 
 
@@ -125,7 +125,7 @@
 #define USB_SUSPEND_EVENT   0
 #define USB_RESUME_EVENT    0
 #define USB_WAKEUP_EVENT    0
-#define USB_SOF_EVENT       0
+#define USB_SOF_EVENT       1
 #define USB_ERROR_EVENT     0
 #define USB_EP_EVENT        0x0007
 #define USB_CONFIGURE_EVENT 1
@@ -89,6 +89,8 @@ void USB_WakeUp_Event (void) {
 
 #if USB_SOF_EVENT
 void USB_SOF_Event (void) {
+
+  CDC_SOF();                                /* send what came from the UART */
 }
 #endif
 
@@ -114,7 +116,7 @@ void USB_Error_Event (uint32_t error) {
 void USB_Configure_Event (void) {
 
   if (USB_Configuration) {                  /* Check if USB is configured */
-    /* add your code here */
+    CDC_Configure();                        /* data endpoints start empty */
   }
 }
 #endif
@@ -202,6 +204,14 @@ void USB_EndPoint2 (uint32_t event) {
     case USB_EVT_IN:
       CDC_BulkIn ();                 /* data expected from Host */
       break;
+#if USB_DMA
+    case USB_EVT_OUT_DMA_EOT:
+      CDC_BulkOutDMA ();             /* packet received by DMA */
+      break;
+    case USB_EVT_IN_DMA_EOT:
+      CDC_BulkInDMA ();              /* packet written by DMA */
+      break;
+#endif
   }
 }
 
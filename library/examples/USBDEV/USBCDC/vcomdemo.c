@@ -45,46 +45,6 @@ void VCOM_Init(void) {
 }
 
 
-/*----------------------------------------------------------------------------
-  Reads character from serial port buffer and writes to USB buffer
- *---------------------------------------------------------------------------*/
-void VCOM_Serial2Usb(void) {
-  static char serBuf [USB_CDC_BUFSIZE];
-         int  numBytesRead, numAvailByte;
-
-  ser_AvailChar (&numAvailByte);
-  if (numAvailByte > 0) {
-    if (CDC_DepInEmpty) {
-      numBytesRead = ser_Read (&serBuf[0], &numAvailByte);
-
-      CDC_DepInEmpty = 0;
-	  USB_WriteEP (CDC_DEP_IN, (unsigned char *)&serBuf[0], numBytesRead);
-    }
-  }
-
-}
-
-/*----------------------------------------------------------------------------
-  Reads character from USB buffer and writes to serial port buffer
- *---------------------------------------------------------------------------*/
-void VCOM_Usb2Serial(void) {
-  static char serBuf [32];
-         int  numBytesToRead, numBytesRead, numAvailByte;
-
-  CDC_OutBufAvailChar (&numAvailByte);
-  if (numAvailByte > 0) {
-      numBytesToRead = numAvailByte > 32 ? 32 : numAvailByte;
-      numBytesRead = CDC_RdOutBuf (&serBuf[0], &numBytesToRead);
-#if PORT_NUM
-      ser_Write (1, &serBuf[0], &numBytesRead);
-#else
-      ser_Write (0, &serBuf[0], &numBytesRead);
-#endif
-  }
-
-}
-
-
 /*----------------------------------------------------------------------------
   checks the serial state and initiates notification
  *---------------------------------------------------------------------------*/
@@ -112,10 +72,9 @@ int main (void) {
   while (!USB_Configuration) ;              // wait until USB is configured
 
   while (1) {                               // Loop forever
-    VCOM_Serial2Usb();                      // read serial port and initiate USB event
     VCOM_CheckSerialState();
-	VCOM_Usb2Serial();
-  } // end while
+    __WFI();                                // the data moves in the USB and GPDMA
+  } // end while                            // interrupts; SOF wakes up every ms
 } // end main ()
 
 /*
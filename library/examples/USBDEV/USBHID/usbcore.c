@@ -55,7 +55,7 @@ extern MSC_CSW CSW;
 #include "vendor.h"
 #endif
 
-#ifndef __IAR_SYSTEMS_ICC__
+#if defined   (  __CC_ARM  )
 #pragma diag_suppress 111,1441
 #endif
 
@@ -27,7 +27,7 @@
 #include "usbcore.h"
 #include "usbuser.h"
 
-#ifndef __IAR_SYSTEMS_ICC__
+#if defined   (  __CC_ARM  )
 #pragma diag_suppress 1441
 #endif
 
@@ -411,7 +411,7 @@ uint32_t USB_ReadEP (uint32_t EPNum, uint8_t *pData) {
   cnt &= PKT_LNGTH_MASK;
 
   for (n = 0; n < (cnt + 3) / 4; n++) {
-    *((__packed uint32_t *)pData) = LPC_USB->USBRxData;
+    UNALIGNED32(pData) = LPC_USB->USBRxData;
     pData += 4;
   }
   LPC_USB->USBCtrl = 0;
@@ -442,7 +442,7 @@ uint32_t USB_WriteEP (uint32_t EPNum, uint8_t *pData, uint32_t cnt) {
   LPC_USB->USBTxPLen = cnt;
 
   for (n = 0; n < (cnt + 3) / 4; n++) {
-	  LPC_USB->USBTxData = *((__packed uint32_t *)pData);
+	  LPC_USB->USBTxData = UNALIGNED32(pData);
     pData += 4;
   }
   LPC_USB->USBCtrl = 0;
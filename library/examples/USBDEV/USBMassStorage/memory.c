@@ -42,6 +42,19 @@ extern uint8_t Memory[MSC_MemorySize];         /* MSC Memory in RAM */
 
 int main (void) {
 	uint32_t n;
+#if MSC_SDCARD
+	SDSPI_CFG_Type SDCfg;
+
+	SDCfg.SSPx = LPC_SSP0;                    /* SD Card on the SSP0,   */
+	SDCfg.CSPortNum = 0;                      /*   CS on P0.16          */
+	SDCfg.CSPinNum = 16;
+	SDCfg.ClockRate = 0;                      /* SDSPI_CLK_MAX          */
+	SDCfg.DMA = DISABLE;                      /* Blocks by polling      */
+	if (SDSPI_Init(&MSC_Card, &SDCfg) == SDSPI_OK) {
+		MSC_SDCard = TRUE;                      /* Card found: the Disk   */
+		MSC_BlockCount = SDSPI_GetBlockCount(&MSC_Card);
+	}
+#endif
 
 	for (n = 0; n < MSC_ImageSize; n++) {     /* Copy Initial Disk Image */
 		Memory[n] = DiskImage[n];               /*   from Flash to RAM     */
@@ -50,7 +63,18 @@ int main (void) {
 	USB_Init();                               /* USB Initialization */
 	USB_Connect(TRUE);                        /* USB Connect */
 
+#if MSC_SDCARD
+	while (1) {                               /* Card Blocks, and sleep */
+		__disable_irq();                        /*   while there are none */
+		if (!MSC_SDPending()) {
+			__WFI();                              /* USB Interrupt wakes up */
+		}
+		__enable_irq();
+		MSC_SDTask();
+	}
+#else
 	while (1);                                /* Loop forever */
+#endif
 }
 
 #ifdef  DEBUG
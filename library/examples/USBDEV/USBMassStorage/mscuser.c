@@ -29,11 +29,38 @@
 
 #include "memory.h"
 
-
+#if MSC_SDCARD
+#if !USB_DMA
+#error "MSC_SDCARD needs USB_DMA"
+#endif
+#if (MSC_BlockSize != SDSPI_BLOCK_SIZE)
+#error "MSC_SDCARD needs Blocks of SDSPI_BLOCK_SIZE"
+#endif
+#endif
+
+
+#if USB_DMA
+/* The DMA reads and writes the Memory straight: keep it in USB RAM */
+#if defined (  __CC_ARM  )
+#pragma arm section zidata = "USB_RAM"
+uint8_t  Memory[MSC_MemorySize];  /* MSC RAM */
+#pragma arm section zidata
+#endif
+#if defined (  __IAR_SYSTEMS_ICC__  )
+#pragma location = "USB_RAM"
+uint8_t  Memory[MSC_MemorySize];  /* MSC RAM */
+#endif
+#if defined (  __GNUC__  )
+uint8_t  Memory[MSC_MemorySize] __attribute__((section("USB_RAM")));  /* MSC RAM */
+#endif
+#else
 uint8_t  Memory[MSC_MemorySize];  /* MSC RAM */
+#endif
 
 uint32_t  MemOK;                   /* Memory OK */
 
+uint32_t MSC_BlockCount = MSC_MemorySize / MSC_BlockSize;   /* Disk Size */
+
 uint32_t Offset;                  /* R/W Offset */
 uint32_t Length;                  /* R/W Length */
 
@@ -46,6 +73,39 @@ MSC_CBW CBW;                   /* Command Block Wrapper */
 MSC_CSW CSW;                   /* Command Status Wrapper */
 
 
+#if MSC_SDCARD
+uint32_t MSC_SDCard;              /* Disk on the SD Card, not in the Memory */
+SDSPI_CARD_Type MSC_Card;         /* The Card (SDSPI_Init in main) */
+
+/* Block Buffers, filled and emptied by the USB DMA: Block n of a Command
+   is in SDBuf[n % MSC_SD_BUFS] */
+#if defined (  __CC_ARM  )
+#pragma arm section zidata = "USB_RAM"
+static uint8_t  SDBuf[MSC_SD_BUFS][MSC_BlockSize];
+#pragma arm section zidata
+#endif
+#if defined (  __IAR_SYSTEMS_ICC__  )
+#pragma location = "USB_RAM"
+static uint8_t  SDBuf[MSC_SD_BUFS][MSC_BlockSize];
+#endif
+#if defined (  __GNUC__  )
+static uint8_t  SDBuf[MSC_SD_BUFS][MSC_BlockSize] __attribute__((section("USB_RAM")));
+#endif
+static uint8_t  SDVerifyBuf[MSC_BlockSize];   /* VERIFY10: Block of the Card */
+
+/* Command for MSC_SDTask, from the USB Interrupt */
+static volatile uint8_t  SDCmd;   /* SCSI Operation Code, 0 - none */
+static volatile uint32_t SDSeq;   /* Changes with every Command and Reset */
+static volatile uint8_t  SDEvent; /* The USB Interrupt moved something */
+static uint32_t SDBlock;          /* First Block */
+static uint32_t SDBlocks;         /* Number of Blocks */
+
+static volatile uint32_t SDUsb;   /* Blocks sent or received by the USB */
+static volatile uint32_t SDCard;  /* Blocks read from or written to the Card */
+static volatile uint8_t  SDUsbBusy;   /* USB DMA on Block SDUsb */
+#endif
+
+
 /*
  *  MSC Mass Storage Reset Request Callback
  *   Called automatically on Mass Storage Reset Request
@@ -55,6 +115,17 @@ MSC_CSW CSW;                   /* Command Status Wrapper */
 
 uint32_t MSC_Reset (void) {
 
+#if USB_DMA
+  USB_DMA_Stop(MSC_EP_IN);
+  USB_DMA_Stop(MSC_EP_OUT);
+#endif
+#if MSC_SDCARD
+  SDSeq++;                     /* MSC_SDTask drops what it was doing */
+  SDCmd = 0;
+  SDBlocks = SDUsb = 0;
+  SDUsbBusy = 0;
+  SDEvent = 1;
+#endif
   BulkStage = MSC_BS_CBW;
   return (TRUE);
 }
@@ -84,6 +155,18 @@ uint32_t MSC_GetMaxLUN (void) {
 void MSC_MemoryRead (void) {
   uint32_t n;
 
+#if USB_DMA
+  /* All that is left (up to the end of the Memory) in one DMA Transfer,
+     MSC_BulkInDMA when done */
+  n = (Offset < MSC_MemorySize) ? (MSC_MemorySize - Offset) : 0;
+  if (n > Length) {
+    n = Length;
+  }
+  if ((n > MSC_MAX_PACKET) && USB_DMA_Start(MSC_EP_IN, &Memory[Offset], n)) {
+    return;
+  }
+#endif
+
   if (Length > MSC_MAX_PACKET) {
     n = MSC_MAX_PACKET;
   } else {
@@ -143,6 +226,385 @@ void MSC_MemoryWrite (void) {
 }
 
 
+#if MSC_SDCARD
+/*
+ *  MSC SD Card Next USB Transfer
+ *   Starts the USB DMA on the next Block when its Buffer is ready: read
+ *   from the Card (READ10), or free (WRITE10, VERIFY10)
+ *   Called in the USB Interrupt, or with interrupts disabled
+ *    Parameters:      None (global variables)
+ *    Return Value:    None
+ */
+
+static void MSC_SDUsbNext (void) {
+  uint8_t *p;
+
+  if (SDUsbBusy || (SDUsb == SDBlocks)) {
+    return;
+  }
+  p = SDBuf[SDUsb % MSC_SD_BUFS];
+  switch (BulkStage) {
+    case MSC_BS_DATA_IN:
+      if (SDUsb != SDCard) {
+        SDUsbBusy = USB_DMA_Start(MSC_EP_IN, p, MSC_BlockSize);
+      }
+      break;
+    case MSC_BS_DATA_OUT:
+      if ((SDUsb - SDCard) < MSC_SD_BUFS) {
+        SDUsbBusy = USB_DMA_Start(MSC_EP_OUT, p, MSC_BlockSize);
+      }
+      break;
+  }
+}
+
+
+/*
+ *  MSC SD Card Command Failed
+ *   Stalls the Data, sends the CSW and has MSC_SDTask drop the Command
+ *   Called in the USB Interrupt, or with interrupts disabled
+ *    Parameters:      status: CSW Status
+ *    Return Value:    None
+ */
+
+static void MSC_SDFail (uint8_t status) {
+
+  USB_DMA_Stop(MSC_EP_IN);
+  USB_DMA_Stop(MSC_EP_OUT);
+  SDUsbBusy = 0;
+  SDSeq++;
+  SDCmd = 0;
+  SDEvent = 1;
+  if (BulkStage == MSC_BS_DATA_IN) {
+    USB_SetStallEP(MSC_EP_IN);
+  } else {
+    USB_SetStallEP(MSC_EP_OUT);
+  }
+  CSW.bStatus = status;
+  MSC_SetCSW();
+}
+
+
+/*
+ *  MSC SD Card Read/Write Setup
+ *   Hands READ10, WRITE10 and VERIFY10 over to MSC_SDTask
+ *    Parameters:      None (global variables)
+ *    Return Value:    None
+ */
+
+static void MSC_SDSetup (void) {
+
+  /* Offset (32 bit) does not reach the end of big Cards: Blocks here */
+  SDBlock  = (CBW.CB[2] << 24) |
+             (CBW.CB[3] << 16) |
+             (CBW.CB[4] <<  8) |
+             (CBW.CB[5] <<  0);
+  SDBlocks = Length / MSC_BlockSize;
+
+  if ((SDBlock >= MSC_BlockCount) || (SDBlocks > (MSC_BlockCount - SDBlock))) {
+    SDBlocks = 0;
+    MSC_SDFail(CSW_CMD_FAILED);
+    return;
+  }
+  if (SDBlocks == 0) {
+    CSW.bStatus = CSW_CMD_PASSED;
+    MSC_SetCSW();
+    return;
+  }
+
+  SDUsb = SDCard = 0;
+  SDUsbBusy = 0;
+  MemOK = TRUE;
+  SDSeq++;
+  SDCmd = CBW.CB[0];
+  SDEvent = 1;
+  MSC_SDUsbNext();             /* WRITE10: the first Block can come now */
+}
+
+
+/*
+ *  MSC SD Card USB DMA Done
+ *   Called automatically on DMA End of Transfer of a Block
+ *    Parameters:      EPNum: Endpoint Number
+ *    Return Value:    None
+ */
+
+static void MSC_SDUsbDone (uint32_t EPNum) {
+  uint32_t n;
+
+  n = USB_DMA_Count(EPNum);
+  Length -= n;
+  CSW.dDataResidue -= n;
+  SDUsbBusy = 0;
+  SDEvent = 1;
+
+  if (n != MSC_BlockSize) {
+    /* Short Packet: the Host sent less than the CBW said */
+    MSC_SDFail(CSW_PHASE_ERROR);
+    return;
+  }
+  SDUsb++;
+
+  if ((EPNum & 0x80) && (Length == 0)) {
+    /* The Event of the last Packet sent goes to MSC_BulkIn */
+    BulkStage = MSC_BS_DATA_IN_LAST;
+    CSW.bStatus = CSW_CMD_PASSED;
+  }
+  USB_DMA_Stop(EPNum);
+  MSC_SDUsbNext();
+}
+
+
+/*
+ *  MSC SD Card Wait
+ *   Sleeps until the USB Interrupt moves something
+ *    Parameters:      None
+ *    Return Value:    None
+ */
+
+static void MSC_SDWait (void) {
+
+  __disable_irq();
+  if (!SDEvent) {
+    __WFI();                   /* wakes up on the pending interrupt */
+  }
+  SDEvent = 0;
+  __enable_irq();
+}
+
+
+/*
+ *  MSC SD Card Read: Blocks from the Card to the Buffers
+ *    Parameters:      seq: Command, blk: First Block, cnt: Number of Blocks
+ *    Return Value:    TRUE - Success, FALSE - Error
+ */
+
+static uint32_t MSC_SDRead (uint32_t seq, uint32_t blk, uint32_t cnt) {
+  uint32_t n, ok, stopped;
+
+  if (SDSPI_ReadStart(&MSC_Card, blk, cnt) != SDSPI_OK) {
+    return (FALSE);
+  }
+  ok = TRUE;
+  stopped = FALSE;
+  for (n = 0; (n < cnt) && ok; n++) {
+    while ((SDSeq == seq) && ((n - SDUsb) == MSC_SD_BUFS)) {
+      MSC_SDWait();            /* all Buffers still going to the Host */
+    }
+    if (SDSeq != seq) {
+      break;
+    }
+    ok = (SDSPI_ReadNext(&MSC_Card, SDBuf[n % MSC_SD_BUFS]) == SDSPI_OK);
+    if (ok && (n + 1 == cnt)) {
+      /* Card stopped before the last Block goes, and the CSW after it */
+      ok = (SDSPI_ReadStop(&MSC_Card) == SDSPI_OK);
+      stopped = TRUE;
+    }
+    if (ok) {
+      __disable_irq();
+      if (SDSeq == seq) {
+        SDCard = n + 1;
+        MSC_SDUsbNext();
+      }
+      __enable_irq();
+    }
+  }
+  if (!stopped) {
+    SDSPI_ReadStop(&MSC_Card);
+  }
+  return (ok);
+}
+
+
+/*
+ *  MSC SD Card Write and Verify: Blocks from the Buffers to the Card
+ *   One Multiple Block Write (or Read, to verify) for the whole Command.
+ *   SDSPI_WriteNext returns while the Card programs the Block, and the
+ *   Buffer goes back to the USB then. The last one is programmed before
+ *   the CSW
+ *    Parameters:      seq: Command, blk: First Block, cnt: Number of Blocks
+ *                     cmd: SCSI_WRITE10 or SCSI_VERIFY10
+ *    Return Value:    TRUE - Success, FALSE - Error
+ */
+
+static uint32_t MSC_SDWrite (uint32_t seq, uint32_t blk, uint32_t cnt, uint8_t cmd) {
+  uint32_t n, i, ok;
+  uint8_t *p;
+
+  if (cmd == SCSI_WRITE10) {
+    ok = (SDSPI_WriteStart(&MSC_Card, blk, cnt) == SDSPI_OK);
+  } else {
+    ok = (SDSPI_ReadStart(&MSC_Card, blk, cnt) == SDSPI_OK);
+  }
+  if (!ok) {
+    return (FALSE);
+  }
+  for (n = 0; (n < cnt) && ok; n++) {
+    while ((SDSeq == seq) && (SDUsb == n)) {
+      MSC_SDWait();            /* Block still coming from the Host */
+    }
+    if (SDSeq != seq) {
+      break;
+    }
+    p = SDBuf[n % MSC_SD_BUFS];
+    if (cmd == SCSI_WRITE10) {
+      ok = (SDSPI_WriteNext(&MSC_Card, p) == SDSPI_OK);
+    } else {
+      ok = (SDSPI_ReadNext(&MSC_Card, SDVerifyBuf) == SDSPI_OK);
+      for (i = 0; ok && (i < MSC_BlockSize); i++) {
+        if (SDVerifyBuf[i] != p[i]) {
+          MemOK = FALSE;
+          break;
+        }
+      }
+    }
+    __disable_irq();
+    if (SDSeq == seq) {
+      SDCard = n + 1;
+      MSC_SDUsbNext();
+    }
+    __enable_irq();
+  }
+  if (cmd == SCSI_WRITE10) {
+    ok = (SDSPI_WriteStop(&MSC_Card) == SDSPI_OK) && ok;
+    return ((SDSPI_Sync(&MSC_Card) == SDSPI_OK) && ok);
+  }
+  return ((SDSPI_ReadStop(&MSC_Card) == SDSPI_OK) && ok);
+}
+
+
+/*
+ *  MSC SD Card Task Pending
+ *   Called with interrupts disabled before sleeping: the main loop sleeps
+ *   only while MSC_SDTask has nothing to do
+ *    Parameters:      None
+ *    Return Value:    TRUE - Command for MSC_SDTask, FALSE - None
+ */
+
+uint32_t MSC_SDPending (void) {
+
+  return (SDCmd != 0);
+}
+
+
+/*
+ *  MSC SD Card Task
+ *   Moves the Blocks of READ10, WRITE10 and VERIFY10 between the Card and
+ *   the Buffers, while the USB DMA moves them between the Buffers and the
+ *   Host. Called from the main loop: returns at once without a Command
+ *    Parameters:      None
+ *    Return Value:    None
+ */
+
+void MSC_SDTask (void) {
+  uint32_t seq, blk, cnt, ok;
+  uint8_t  cmd;
+
+  __disable_irq();
+  SDEvent = 0;
+  cmd = SDCmd;
+  seq = SDSeq;
+  blk = SDBlock;
+  cnt = SDBlocks;
+  __enable_irq();
+
+  switch (cmd) {
+    case SCSI_READ10:
+      ok = MSC_SDRead(seq, blk, cnt);
+      break;
+    case SCSI_WRITE10:
+    case SCSI_VERIFY10:
+      ok = MSC_SDWrite(seq, blk, cnt, cmd);
+      break;
+    default:
+      return;
+  }
+
+  __disable_irq();
+  if (SDSeq == seq) {
+    SDCmd = 0;
+    if (!ok) {
+      MSC_SDFail(CSW_CMD_FAILED);
+    } else if (cmd != SCSI_READ10) {
+      /* All Blocks came: the IN Endpoint is free for the CSW */
+      CSW.bStatus = (MemOK) ? CSW_CMD_PASSED : CSW_CMD_FAILED;
+      MSC_SetCSW();
+    }
+    /* READ10: the CSW goes after the last Block (MSC_BulkIn) */
+  }
+  __enable_irq();
+}
+#endif
+
+
+#if USB_DMA
+/*
+ *  MSC Memory Read DMA Callback
+ *   Called automatically on DMA End of Transfer of MSC_MemoryRead
+ *    Parameters:      None (global variables)
+ *    Return Value:    None
+ */
+
+void MSC_BulkInDMA (void) {
+  uint32_t n;
+
+#if MSC_SDCARD
+  if (MSC_SDCard) {
+    MSC_SDUsbDone(MSC_EP_IN);
+    return;
+  }
+#endif
+
+  n = USB_DMA_Count(MSC_EP_IN);
+  Offset += n;
+  Length -= n;
+
+  CSW.dDataResidue -= n;
+
+  if (Length == 0) {
+    BulkStage = MSC_BS_DATA_IN_LAST;
+  } else {
+    BulkStage = MSC_BS_DATA_IN_LAST_STALL;
+  }
+  CSW.bStatus = CSW_CMD_PASSED;
+
+  /* The Event of the last Packet sent goes to MSC_BulkIn */
+  USB_DMA_Stop(MSC_EP_IN);
+}
+
+
+/*
+ *  MSC Memory Write DMA Callback
+ *   Called automatically on DMA End of Transfer of WRITE10
+ *    Parameters:      None (global variables)
+ *    Return Value:    None
+ */
+
+void MSC_BulkOutDMA (void) {
+  uint32_t n;
+
+#if MSC_SDCARD
+  if (MSC_SDCard) {
+    MSC_SDUsbDone(MSC_EP_OUT);
+    return;
+  }
+#endif
+
+  n = USB_DMA_Count(MSC_EP_OUT);
+  USB_DMA_Stop(MSC_EP_OUT);
+  Offset += n;
+  Length -= n;
+
+  CSW.dDataResidue -= n;
+
+  /* Ended by a short Packet: the rest comes through MSC_MemoryWrite */
+  if (Length == 0) {
+    CSW.bStatus = CSW_CMD_PASSED;
+    MSC_SetCSW();
+  }
+}
+#endif
+
+
 /*
  *  MSC Memory Verify Callback
  *   Called automatically on Memory Verify Event
@@ -526,6 +988,12 @@ fail: CSW.bStatus = CSW_CMD_FAILED;
           if (MSC_RWSetup()) {
             if ((CBW.bmFlags & 0x80) != 0) {
               BulkStage = MSC_BS_DATA_IN;
+#if MSC_SDCARD
+              if (MSC_SDCard) {
+                MSC_SDSetup();
+                break;
+              }
+#endif
               MSC_MemoryRead();
             } else {
               USB_SetStallEP(MSC_EP_OUT);
@@ -538,6 +1006,19 @@ fail: CSW.bStatus = CSW_CMD_FAILED;
           if (MSC_RWSetup()) {
             if ((CBW.bmFlags & 0x80) == 0) {
               BulkStage = MSC_BS_DATA_OUT;
+#if MSC_SDCARD
+              if (MSC_SDCard) {
+                MSC_SDSetup();
+                break;
+              }
+#endif
+#if USB_DMA
+              /* Straight into the Memory, MSC_BulkOutDMA when done */
+              if ((Length > MSC_MAX_PACKET) &&
+                  ((Offset + Length) <= MSC_MemorySize)) {
+                USB_DMA_Start(MSC_EP_OUT, &Memory[Offset], Length);
+              }
+#endif
             } else {
               USB_SetStallEP(MSC_EP_IN);
               CSW.bStatus = CSW_PHASE_ERROR;
@@ -550,6 +1031,11 @@ fail: CSW.bStatus = CSW_CMD_FAILED;
             if ((CBW.bmFlags & 0x80) == 0) {
               BulkStage = MSC_BS_DATA_OUT;
               MemOK = TRUE;
+#if MSC_SDCARD
+              if (MSC_SDCard) {
+                MSC_SDSetup();
+              }
+#endif
             } else {
               USB_SetStallEP(MSC_EP_IN);
               CSW.bStatus = CSW_PHASE_ERROR;
@@ -596,6 +1082,12 @@ void MSC_BulkIn (void) {
     case MSC_BS_DATA_IN:
       switch (CBW.CB[0]) {
         case SCSI_READ10:
+#if MSC_SDCARD
+          if (MSC_SDCard) {
+            MSC_SDUsbNext();
+            break;
+          }
+#endif
           MSC_MemoryRead();
           break;
       }
@@ -622,6 +1114,12 @@ void MSC_BulkIn (void) {
 
 void MSC_BulkOut (void) {
 
+#if MSC_SDCARD
+  if (MSC_SDCard && (BulkStage == MSC_BS_DATA_OUT)) {
+    MSC_SDUsbNext();           /* the Packet waits in the Endpoint for the DMA */
+    return;
+  }
+#endif
   BulkLen = USB_ReadEP(MSC_EP_OUT, BulkBuf);
   switch (BulkStage) {
     case MSC_BS_CBW:
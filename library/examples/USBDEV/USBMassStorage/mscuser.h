@@ -28,7 +28,17 @@
 #define MSC_MemorySize  8192
 #endif
 #define MSC_BlockSize   512
-#define MSC_BlockCount  (MSC_MemorySize / MSC_BlockSize)
+
+/* Disk on an SD Card (sdspi.c of the SPI/SDCard example) when one answers
+   at startup, else in the Memory. The SD Card needs the USB DMA (USB_DMA
+   in usbcfg.h) */
+#define MSC_SDCARD      1
+
+/* Blocks between the USB and the SD Card: one on the USB while the other
+   goes to or from the Card */
+#define MSC_SD_BUFS     2
+
+extern uint32_t MSC_BlockCount;       /* Disk Size in Blocks */
 
 
 /* Max In/Out Packet Size */
@@ -47,6 +57,18 @@ extern void MSC_GetCBW (void);
 extern void MSC_SetCSW (void);
 extern void MSC_BulkIn (void);
 extern void MSC_BulkOut(void);
+extern void MSC_BulkInDMA (void);
+extern void MSC_BulkOutDMA(void);
+
+#if MSC_SDCARD
+/* SD Card Disk */
+#include "sdspi.h"
+
+extern uint32_t MSC_SDCard;
+extern SDSPI_CARD_Type MSC_Card;
+extern uint32_t MSC_SDPending (void);
+extern void MSC_SDTask (void);
+#endif
 
 
 #endif  /* __MSCUSER_H__ */
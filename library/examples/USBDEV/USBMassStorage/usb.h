@@ -24,6 +24,19 @@
 #define __packed __attribute__((__packed__))
 #endif
 
+/* 16 and 32-bit accesses to a byte buffer that may be unaligned: through
+   a __packed pointer with the ARM and IAR compilers, through a packed
+   struct with GCC, which ignores the attribute on a pointer */
+#if defined   (  __GNUC__  )
+typedef struct __packed { uint16_t V; } UNALIGNED16_T;
+typedef struct __packed { uint32_t V; } UNALIGNED32_T;
+#define UNALIGNED16(p) (((UNALIGNED16_T *)(p))->V)
+#define UNALIGNED32(p) (((UNALIGNED32_T *)(p))->V)
+#else
+#define UNALIGNED16(p) (*((__packed uint16_t *)(p)))
+#define UNALIGNED32(p) (*((__packed uint32_t *)(p)))
+#endif
+
 
 #if defined     (  __CC_ARM  )
 typedef __packed union {
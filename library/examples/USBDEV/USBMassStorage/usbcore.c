@@ -54,7 +54,7 @@ extern MSC_CSW CSW;
 #include "vendor.h"
 #endif
 
-#ifndef __IAR_SYSTEMS_ICC__
+#if defined   (  __CC_ARM  )
 #pragma diag_suppress 111,1441
 #endif
 
@@ -178,7 +178,7 @@ __inline uint32_t USB_GetStatus (void) {
       break;
     case REQUEST_TO_INTERFACE:
       if ((USB_Configuration != 0) && (SetupPacket.wIndex.WB.L < USB_NumInterfaces)) {
-        *((__packed uint16_t *)EP0Buf) = 0;
+        UNALIGNED16(EP0Buf) = 0;
         EP0Data.pData = EP0Buf;
         USB_DataInStage();
       } else {
@@ -189,7 +189,7 @@ __inline uint32_t USB_GetStatus (void) {
       n = SetupPacket.wIndex.WB.L & 0x8F;
       m = (n & 0x80) ? ((1 << 16) << (n & 0x0F)) : (1 << n);
       if (((USB_Configuration != 0) || ((n & 0x0F) == 0)) && (USB_EndPointMask & m)) {
-        *((__packed uint16_t *)EP0Buf) = (USB_EndPointHalt & m) ? 1 : 0;
+        UNALIGNED16(EP0Buf) = (USB_EndPointHalt & m) ? 1 : 0;
         EP0Data.pData = EP0Buf;
         USB_DataInStage();
       } else {
@@ -349,7 +349,7 @@ inline uint32_t USB_SetConfiguration (void) {
 __inline uint32_t USB_SetConfiguration (void) {
 #endif
   USB_COMMON_DESCRIPTOR *pD;
-	uint32_t  alt, n, m;
+	uint32_t  alt = 0, n, m;
 	uint32_t tmp;
 
   if (SetupPacket.wValue.WB.L) {
@@ -442,7 +442,7 @@ inline uint32_t USB_SetInterface (void) {
 __inline uint32_t USB_SetInterface (void) {
 #endif
   USB_COMMON_DESCRIPTOR *pD;
-  uint32_t                  ifn, alt, old, msk, n, m;
+  uint32_t                  ifn = 0, alt = 0, old = 0, msk = 0, n, m;
   uint32_t                   set;
   uint32_t tmp;
 
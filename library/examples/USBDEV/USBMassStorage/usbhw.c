@@ -27,7 +27,7 @@
 #include "usbcore.h"
 #include "usbuser.h"
 
-#ifndef __IAR_SYSTEMS_ICC__
+#if defined   (  __CC_ARM  )
 #pragma diag_suppress 1441
 #endif
 
@@ -41,7 +41,7 @@
 
 #if defined (  __CC_ARM  )
 #pragma arm section zidata = "USB_RAM"
-uint32_t UDCA[USB_EP_NUM];                     /* UDCA in USB RAM */
+__align(128) uint32_t UDCA[USB_EP_NUM];        /* UDCA in USB RAM */
 uint32_t DD_NISO_Mem[4*DD_NISO_CNT];           /* Non-Iso DMA Descriptor Memory */
 uint32_t DD_ISO_Mem [5*DD_ISO_CNT];            /* Iso DMA Descriptor Memory */
 #pragma arm section zidata
@@ -51,6 +51,7 @@ uint32_t DDMemMap[2];                          /* DMA Descriptor Memory Usage */
 
 #if defined (  __IAR_SYSTEMS_ICC__  )
 #pragma location = "USB_RAM"
+#pragma data_alignment = 128
 uint32_t UDCA[USB_EP_NUM];                     /* UDCA in USB RAM */
 #pragma location = "USB_RAM"
 uint32_t DD_NISO_Mem[4*DD_NISO_CNT];           /* Non-Iso DMA Descriptor Memory */
@@ -62,12 +63,15 @@ uint32_t DDMemMap[2];                          /* DMA Descriptor Memory Usage */
 #endif
 
 #if defined (  __GNUC__  )
-uint32_t UDCA[USB_EP_NUM] __attribute__((section("USB_RAM"))); 				/* UDCA in USB RAM */
+uint32_t UDCA[USB_EP_NUM] __attribute__((section("USB_RAM"), aligned(128))); /* UDCA in USB RAM */
 uint32_t DD_NISO_Mem[4*DD_NISO_CNT] __attribute__((section("USB_RAM")));    /* Non-Iso DMA Descriptor Memory */
 uint32_t DD_ISO_Mem [5*DD_ISO_CNT] __attribute__((section("USB_RAM")));     /* Iso DMA Descriptor Memory */
 uint32_t udca[USB_EP_NUM];                     								/* UDCA saved values */
 uint32_t DDMemMap[2];                          								/* DMA Descriptor Memory Usage */
 #endif
+
+uint16_t EPMaxSize[USB_EP_NUM];                /* Max Packet Size per Endpoint */
+uint32_t DMAXfer;                              /* Endpoints in USB_DMA_Start */
 #endif
 
 
@@ -203,7 +207,7 @@ void USB_Reset (void) {
                (USB_ERROR_EVENT ? ERR_INT   : 0);
 
 #if USB_DMA
-  LPC_USB->USBUDCAH   = USB_RAM_ADR;
+  LPC_USB->USBUDCAH   = (uint32_t)UDCA;
   LPC_USB->USBDMARClr = 0xFFFFFFFF;
   LPC_USB->USBEpDMADis  = 0xFFFFFFFF;
   LPC_USB->USBEpDMAEn   = USB_DMA_EP;
@@ -213,10 +217,14 @@ void USB_Reset (void) {
   LPC_USB->USBDMAIntEn  = 0x00000007;
   DDMemMap[0] = 0x00000000;
   DDMemMap[1] = 0x00000000;
+  DMAXfer = 0;
   for (n = 0; n < USB_EP_NUM; n++) {
     udca[n] = 0;
     UDCA[n] = 0;
+    EPMaxSize[n] = 0;
   }
+  EPMaxSize[0] = USB_MAX_PACKET0;
+  EPMaxSize[1] = USB_MAX_PACKET0;
 #endif
 }
 
@@ -311,6 +319,9 @@ void USB_ConfigEP (USB_ENDPOINT_DESCRIPTOR *pEPD) {
   LPC_USB->USBMaxPSize = pEPD->wMaxPacketSize;
   while ((LPC_USB->USBDevIntSt & EP_RLZED_INT) == 0);
   LPC_USB->USBDevIntClr = EP_RLZED_INT;
+#if USB_DMA
+  EPMaxSize[num] = pEPD->wMaxPacketSize;
+#endif
 }
 
 
@@ -410,7 +421,7 @@ uint32_t USB_ReadEP (uint32_t EPNum, uint8_t *pData) {
   cnt &= PKT_LNGTH_MASK;
 
   for (n = 0; n < (cnt + 3) / 4; n++) {
-    *((__packed uint32_t *)pData) = LPC_USB->USBRxData;
+    UNALIGNED32(pData) = LPC_USB->USBRxData;
     pData += 4;
   }
   LPC_USB->USBCtrl = 0;
@@ -441,7 +452,7 @@ uint32_t USB_WriteEP (uint32_t EPNum, uint8_t *pData, uint32_t cnt) {
   LPC_USB->USBTxPLen = cnt;
 
   for (n = 0; n < (cnt + 3) / 4; n++) {
-	  LPC_USB->USBTxData = *((__packed uint32_t *)pData);
+	  LPC_USB->USBTxData = UNALIGNED32(pData);
     pData += 4;
   }
   LPC_USB->USBCtrl = 0;
@@ -456,8 +467,12 @@ uint32_t USB_WriteEP (uint32_t EPNum, uint8_t *pData, uint32_t cnt) {
 
 
 /* DMA Descriptor Memory Layout */
-const uint32_t DDAdr[2] = { DD_NISO_ADR, DD_ISO_ADR };
+#define DDAdr(iso)  ((iso) ? (uint32_t)DD_ISO_Mem : (uint32_t)DD_NISO_Mem)
 const uint32_t DDSz [2] = { 16,          20         };
+const uint32_t DDCnt[2] = { DD_NISO_CNT, DD_ISO_CNT };
+
+/* Bytes per Descriptor in USB_DMA_Start: whole packets up to BufLen max. */
+#define DMA_CHUNK(max)  ((0xFFFF / (max)) * (max))
 
 
 /*
@@ -479,21 +494,21 @@ uint32_t USB_DMA_Setup(uint32_t EPNum, USB_DMA_DESCRIPTOR *pDD) {
   while (nxt) {                             /* Go through Descriptor List */
     ptr = nxt;                              /* Current Descriptor */
     if (!pDD->Cfg.Type.Link) {              /* Check for Linked Descriptors */
-      n = (ptr - DDAdr[iso]) / DDSz[iso];   /* Descriptor Index */
+      n = (ptr - DDAdr(iso)) / DDSz[iso];   /* Descriptor Index */
       DDMemMap[iso] &= ~(1 << n);           /* Unmark Memory Usage */
     }
     nxt = *((uint32_t *)ptr);                  /* Next Descriptor */
   }
 
-  for (n = 0; n < 32; n++) {                /* Search for available Memory */
+  for (n = 0; n < DDCnt[iso]; n++) {       /* Search for available Memory */
     if ((DDMemMap[iso] & (1 << n)) == 0) {
       break;                                /* Memory found */
     }
   }
-  if (n == 32) return (FALSE);              /* Memory not available */
+  if (n == DDCnt[iso]) return (FALSE);      /* Memory not available */
 
   DDMemMap[iso] |= 1 << n;                  /* Mark Memory Usage */
-  nxt = DDAdr[iso] + n * DDSz[iso];         /* Next Descriptor */
+  nxt = DDAdr(iso) + n * DDSz[iso];         /* Next Descriptor */
 
   if (ptr && pDD->Cfg.Type.Link) {
     *((uint32_t *)(ptr + 0))  = nxt;           /* Link in new Descriptor */
@@ -632,6 +647,155 @@ uint32_t USB_DMA_BufCnt (uint32_t EPNum) {
 }
 
 
+/*
+ *  Start USB DMA Transfer
+ *   Moves cnt bytes between the Endpoint and pData with a chain of
+ *   Non-Iso DMA Descriptors. USB_EVT_OUT_DMA_EOT / USB_EVT_IN_DMA_EOT
+ *   comes once, when the whole chain is done (or an OUT Transfer ends
+ *   with a short Packet). Until USB_DMA_Stop the Endpoint gives no
+ *   USB_EVT_OUT / USB_EVT_IN Events.
+ *    Parameters:      EPNum: Endpoint Number
+ *                       EPNum.0..3: Address
+ *                       EPNum.7:    Dir
+ *                     pData: Pointer to Data Buffer (in USB RAM)
+ *                     cnt:   Number of bytes to transfer
+ *    Return Value:    TRUE - Success, FALSE - Error (not enough Descriptors)
+ */
+
+uint32_t USB_DMA_Start (uint32_t EPNum, uint8_t *pData, uint32_t cnt) {
+  USB_DMA_DESCRIPTOR DD;
+  uint32_t num, max, len, ptr, n, free;
+
+  num = EPAdr(EPNum);
+  max = EPMaxSize[num];
+  if ((cnt == 0) || (max == 0)) return (FALSE);
+
+  LPC_USB->USBEpDMADis = 1 << num;          /* Stop previous Transfer */
+  LPC_USB->USBDMARClr  = 1 << num;
+  ptr = udca[num];                          /* Free its Descriptors */
+  while (ptr) {
+    n = (ptr - DDAdr(0)) / DDSz[0];
+    DDMemMap[0] &= ~(1 << n);
+    ptr = *((uint32_t *)ptr);
+  }
+  udca[num] = 0;
+  UDCA[num] = 0;
+
+  free = 0;
+  for (n = 0; n < DD_NISO_CNT; n++) {
+    if ((DDMemMap[0] & (1 << n)) == 0) free++;
+  }
+  if (free < (cnt + DMA_CHUNK(max) - 1) / DMA_CHUNK(max)) {
+    return (FALSE);                         /* Memory not available */
+  }
+
+  DD.Cfg.Val = 0;
+  DD.MaxSize = max;
+  DD.InfoAdr = 0;
+  while (cnt) {                             /* Chain of Descriptors */
+    len = (cnt > DMA_CHUNK(max)) ? DMA_CHUNK(max) : cnt;
+    DD.BufAdr = (uint32_t)pData;
+    DD.BufLen = len;
+    USB_DMA_Setup(EPNum, &DD);
+    DD.Cfg.Type.Link = 1;
+    pData += len;
+    cnt   -= len;
+  }
+
+  LPC_USB->USBEpIntEn &= ~(1 << num);       /* Endpoint Events to DMA */
+  while (LPC_USB->USBEpIntSt & (1 << num)) {  /* Drop pending Slave Events */
+    LPC_USB->USBDevIntClr = CDFULL_INT;     /* Not set by an earlier Command */
+    LPC_USB->USBEpIntClr = 1 << num;
+    while ((LPC_USB->USBDevIntSt & CDFULL_INT) == 0);
+  }
+  DMAXfer |= 1 << num;
+  LPC_USB->USBEpDMAEn = 1 << num;
+
+  /* A Packet already waiting (OUT) or a free Buffer (IN) raised its
+     Event before: request the DMA for it */
+  WrCmd(CMD_SEL_EP(num));
+  n = RdCmdDat(DAT_SEL_EP(num));
+  if (((num & 1) == 0) == ((n & EP_SEL_F) != 0)) {
+    LPC_USB->USBDMARSet = 1 << num;
+  }
+  return (TRUE);
+}
+
+
+/*
+ *  Get USB DMA Transfer Count
+ *   Bytes moved so far by the Transfer of USB_DMA_Start
+ *    Parameters:      EPNum: Endpoint Number
+ *                       EPNum.0..3: Address
+ *                       EPNum.7:    Dir
+ *    Return Value:    Number of bytes transferred
+ */
+
+uint32_t USB_DMA_Count (uint32_t EPNum) {
+  uint32_t ptr, val, cnt;
+
+  cnt = 0;
+  ptr = udca[EPAdr(EPNum)];                 /* First Descriptor */
+  while (ptr) {
+    val = *((uint32_t *)(ptr + 3*4));       /* Status Information */
+    cnt += val >> 16;
+    if (((val >> 1) & 0x0F) != 0x02) break; /* Not done: the rest is empty */
+    if ((*((uint32_t *)(ptr + 4)) & 0x04) == 0) break;  /* Last Descriptor */
+    ptr = *((uint32_t *)ptr);               /* Next Descriptor */
+  }
+  return (cnt);
+}
+
+
+/*
+ *  Stop USB DMA Transfer
+ *   Gives the Endpoint back to USB_ReadEP / USB_WriteEP: a Packet the
+ *   DMA did not take (OUT) or a free Buffer (IN) gives its Event again.
+ *    Parameters:      EPNum: Endpoint Number
+ *                       EPNum.0..3: Address
+ *                       EPNum.7:    Dir
+ *    Return Value:    None
+ */
+
+void USB_DMA_Stop (uint32_t EPNum) {
+  uint32_t num, val;
+
+  num = EPAdr(EPNum);
+  LPC_USB->USBEpDMADis = 1 << num;
+  LPC_USB->USBDMARClr  = 1 << num;
+  DMAXfer &= ~(1 << num);
+  LPC_USB->USBEpIntEn |= 1 << num;          /* Endpoint Events to Slave Mode */
+
+  WrCmd(CMD_SEL_EP(num));
+  val = RdCmdDat(DAT_SEL_EP(num));
+  if ((((num & 1) == 0) == ((val & EP_SEL_F) != 0)) &&
+      ((LPC_USB->USBEpIntSt & (1 << num)) == 0)) {
+    LPC_USB->USBEpIntSet = 1 << num;
+  }
+}
+
+
+/*
+ *  Check USB DMA Transfer of USB_DMA_Start
+ *    Parameters:      num:   Endpoint Physical Address
+ *    Return Value:    TRUE - Done, FALSE - Descriptors left
+ */
+
+static uint32_t USB_DMA_Done (uint32_t num) {
+  uint32_t ptr, val;
+
+  ptr = udca[num];                          /* First Descriptor */
+  while (ptr) {
+    val = *((uint32_t *)(ptr + 3*4));       /* Status Information */
+    if ((val & 0x01) == 0) return (FALSE);  /* Not retired yet */
+    if (((val >> 1) & 0x0F) != 0x02) return (TRUE);     /* Short or Error */
+    if ((*((uint32_t *)(ptr + 4)) & 0x04) == 0) return (TRUE);  /* Last */
+    ptr = *((uint32_t *)ptr);               /* Next Descriptor */
+  }
+  return (TRUE);
+}
+
+
 #endif /* USB_DMA */
 
 
@@ -746,8 +910,12 @@ void USB_IRQHandler (void) {
 
   if (LPC_USB->USBDMAIntSt & 0x00000001) {          /* End of Transfer Interrupt */
     val = LPC_USB->USBEoTIntSt;
+    LPC_USB->USBEoTIntClr = val;            /* before a new Transfer starts */
     for (n = 2; n < USB_EP_NUM; n++) {      /* Check All Endpoints */
       if (val & (1 << n)) {
+        if ((DMAXfer & (1 << n)) && !USB_DMA_Done(n)) {
+          continue;                         /* More Descriptors to go */
+        }
         m = n >> 1;
         if ((n & 1) == 0) {                 /* OUT Endpoint */
           if (USB_P_EP[m]) {
@@ -760,7 +928,6 @@ void USB_IRQHandler (void) {
         }
       }
     }
-    LPC_USB->USBEoTIntClr = val;
   }
 
   if (LPC_USB->USBDMAIntSt & 0x00000002) {          /* New DD Request Interrupt */
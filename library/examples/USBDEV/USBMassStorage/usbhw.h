@@ -100,6 +100,9 @@ extern void  USB_DMA_Disable(uint32_t EPNum);
 extern uint32_t USB_DMA_Status (uint32_t EPNum);
 extern uint32_t USB_DMA_BufAdr (uint32_t EPNum);
 extern uint32_t USB_DMA_BufCnt (uint32_t EPNum);
+extern uint32_t USB_DMA_Start  (uint32_t EPNum, uint8_t *pData, uint32_t cnt);
+extern uint32_t USB_DMA_Count  (uint32_t EPNum);
+extern void  USB_DMA_Stop   (uint32_t EPNum);
 extern uint32_t USB_GetFrame   (void);
 extern void  USB_IRQHandler (void);
 
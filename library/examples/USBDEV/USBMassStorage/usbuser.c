@@ -194,6 +194,14 @@ void USB_EndPoint2 (uint32_t event) {
     case USB_EVT_IN:
       MSC_BulkIn();
       break;
+#if USB_DMA
+    case USB_EVT_OUT_DMA_EOT:
+      MSC_BulkOutDMA();
+      break;
+    case USB_EVT_IN_DMA_EOT:
+      MSC_BulkInDMA();
+      break;
+#endif
   }
 }
 
@@ -0,0 +1,238 @@
+/* ============================================================================
+ * bench_audio.c - El parlante USB Audio (USBDEV/USBAudio) contra la deriva
+ * ============================================================================
+ *
+ * El tercer binario de "make bench": el ejemplo USBAudio trae su propio
+ * stack USB, asi que va aparte como el de USBCDC. Mide igual que bench.c
+ * (ver ahi) y deja su reporte en BENCH_OUT.
+ *
+ * El host del simulador manda el audio por el endpoint iso 3 (OUT): en cada
+ * frame suma el feedback (muestras por frame, en 10.14) que lee del endpoint
+ * iso 3 (IN) cada 2^FB_REFRESH frames y manda la parte entera de lo que
+ * lleva acumulado. Las muestras son un diente de sierra: la k-esima sale del
+ * DAC (a volumen 1) como k % 1024, asi que lo que toca el DAC tiene que
+ * subir de a 1, sin saltearse ni repetir nada (un "salto"). La ocupacion es
+ * lo que el device tiene en DataBuf al empezar cada frame.
+ *
+ *   usb_audio          1000 frames con los relojes del host y del CCLK
+ *                      iguales (el DAC igual corre a 32010 Hz: 25 MHz / 781)
+ *   usb_audio_deriva   antes de medir, el reloj del host corre AUDIO_PPM
+ *                      mas rapido y mas lento, de a AUDIO_TRAMO frames, sin
+ *                      contar instrucciones; despues 1000 frames medidos
+ *   usb_audio_deriva_lenta
+ *                      lo mismo con el host AUDIO_PPM_LENTO mas rapido
+ *                      durante AUDIO_TRAMO_LENTO frames
+ *
+ * Sin el feedback, AUDIO_PPM durante un tramo son AUDIO_PPM * AUDIO_TRAMO
+ * / 1e6 frames de audio de diferencia: con 1000 ppm y 60 s, 60 ms (casi
+ * 2000 muestras, mas que todo DataBuf). La deriva lenta es la de dos
+ * cristales comunes, 20 ppm: ahi el lazo corrige de a fracciones de
+ * muestra por segundo (0,64 a 32 kHz), cerca de la resolucion del 10.14,
+ * y sin feedback se saldria de la ventana (B_S/4 = 256 muestras) a los
+ * 400 s. Una hora simulada tarda ~22 minutos (~0,36 ms por frame sin
+ * contar: los ~17 accesos a registros de cada frame son signals), asi que
+ * corre 8 minutos, ~3 de reloj, un 20% mas de lo que haria falta para
+ * salirse. Las tres verifican que no haya saltos, que la ocupacion quede
+ * entre B_S/4 y 3*B_S/4 y que el host no haya perdido paquetes. La USB la
+ * atiende el hilo principal, dormido en __WFI con PRIMASK en 1, para que se
+ * cuenten sus instrucciones; el DAC y el GPDMA no interrumpen.
+ * ========================================================================= */
+
+#include "LPC17xx.h"
+#include "bench.h"
+#include "sim.h"
+#include "usb.h"
+#include "usbcfg.h"
+#include "usbhw.h"
+#include "usbcore.h"
+#include "usbaudio.h"
+#include "speaker.h"
+
+#define AUDIO_EP        3
+#define AUDIO_FRAMES    1000
+#define AUDIO_PREVIO    2000            /* frames hasta que el lazo se asienta */
+#define AUDIO_PPM       1000
+#define AUDIO_TRAMO     60000u          /* frames (60 s) con cada deriva */
+#define AUDIO_PPM_LENTO 20
+#define AUDIO_TRAMO_LENTO 480000u       /* frames (8 min) a AUDIO_PPM_LENTO */
+#define FB_NOMINAL      ((uint32_t)(DATA_FREQ << 14) / 1000)
+
+/* El handler del ejemplo */
+void USB_IRQHandler(void);
+
+static struct {
+    int conectado;
+    uint32_t frames;                /* SOF que vio el host */
+    uint32_t ff;                    /* feedback, 10.14 */
+    uint32_t resto;                 /* fraccion de muestra acumulada */
+    uint32_t enviadas;
+    uint32_t feedbacks;
+    int tocando;                    /* ya salio la primera muestra */
+    uint32_t esperado;
+    uint32_t tocadas;
+    uint32_t saltos;
+    int midiendo;
+    uint32_t ocup_min, ocup_max;
+} audio;
+
+static void atender(IRQn_Type irq, void (*handler)(void))
+{
+    if (NVIC_GetPendingIRQ(irq)) {
+        NVIC_ClearPendingIRQ(irq);
+        handler();
+    }
+}
+
+static void audio_dormir(void)
+{
+    __WFI();
+    atender(USB_IRQn, USB_IRQHandler);
+}
+
+static void audio_esperar(uint32_t frames)
+{
+    uint32_t fin = audio.frames + frames;
+
+    while ((int32_t)(audio.frames - fin) < 0) {
+        audio_dormir();
+    }
+}
+
+/* El paquete OUT de cada frame: lo que va acumulando el feedback */
+static uint32_t audio_out(uint8_t *paquete, uint32_t max)
+{
+    uint32_t n, i;
+
+    audio.frames++;
+    if (audio.midiendo) {
+        uint32_t ocup = spk_Fill();
+
+        if (ocup < audio.ocup_min) {
+            audio.ocup_min = ocup;
+        }
+        if (ocup > audio.ocup_max) {
+            audio.ocup_max = ocup;
+        }
+    }
+    audio.resto += audio.ff;
+    n = audio.resto >> 14;
+    audio.resto &= 0x3FFF;
+    if (2 * n > max) {
+        n = max / 2;
+    }
+    for (i = 0; i < n; i++) {
+        int16_t s = (int16_t)((int32_t)(audio.enviadas++ & 0x3FF) - 512) * 64;
+
+        paquete[2 * i] = (uint8_t)s;
+        paquete[2 * i + 1] = (uint8_t)((uint16_t)s >> 8);
+    }
+    return 2 * n;
+}
+
+static void audio_feedback(const uint8_t *paquete, uint32_t len)
+{
+    if (len == 3) {
+        audio.ff = paquete[0] | (uint32_t)paquete[1] << 8 | (uint32_t)paquete[2] << 16;
+        audio.feedbacks++;
+    }
+}
+
+/* Hasta la primera muestra el DAC esta en el punto medio (512) */
+static void audio_dac(uint32_t valor)
+{
+    if (!audio.tocando) {
+        if (valor == 512) {
+            return;
+        }
+        audio.tocando = 1;
+    }
+    if (valor != audio.esperado) {
+        audio.saltos++;
+    }
+    audio.esperado = (valor + 1) & 0x3FF;
+    audio.tocadas++;
+}
+
+/* Conecta el device, elige la alternativa 1 de la interfaz de streaming y
+ * deja el lazo asentado */
+static void audio_conectar(void)
+{
+    static const uint8_t set_config[8] = { 0x00, 0x09, 0x01, 0x00, 0, 0, 0, 0 };
+    static const uint8_t set_interface[8] = { 0x01, 0x0B, 0x01, 0x00, 0x01, 0x00, 0, 0 };
+
+    Volume = 0x10000;
+    spk_Init();
+    sim_dac_salida(audio_dac);
+    USB_Init();
+    USB_Connect(TRUE);
+    sim_usb_reset();
+    sim_usb_setup(set_config);
+    sim_usb_in(0, NULL, 0, NULL);
+    sim_usb_setup(set_interface);
+    sim_usb_in(0, NULL, 0, NULL);
+    while (!sim_usb_listo()) {
+        audio_dormir();
+    }
+    audio.ff = FB_NOMINAL;
+    sim_usb_iso_in(AUDIO_EP, 1u << FB_REFRESH, audio_feedback);
+    sim_usb_iso_out(AUDIO_EP, audio_out);
+    audio_esperar(AUDIO_PREVIO);
+    audio.conectado = 1;
+}
+
+static void audio_preparar(void)
+{
+    __disable_irq();
+    if (!audio.conectado) {
+        audio_conectar();
+    }
+    sim_usb_deriva(0);
+    audio_esperar(AUDIO_PREVIO);
+    audio.midiendo = 1;
+    audio.ocup_min = B_S;
+    audio.ocup_max = 0;
+}
+
+static void audio_deriva_preparar(void)
+{
+    audio_preparar();
+    sim_usb_deriva(AUDIO_PPM);
+    audio_esperar(AUDIO_TRAMO);
+    sim_usb_deriva(-AUDIO_PPM);
+    audio_esperar(AUDIO_TRAMO);
+}
+
+static void audio_lenta_preparar(void)
+{
+    audio_preparar();
+    sim_usb_deriva(AUDIO_PPM_LENTO);
+    audio_esperar(AUDIO_TRAMO_LENTO);
+}
+
+static void audio_correr(void)
+{
+    audio_esperar(AUDIO_FRAMES);
+}
+
+static int audio_verificar(void)
+{
+    int error = sim_usb_stalls() != 0 || sim_usb_iso_perdidos() != 0
+                || audio.saltos != 0 || audio.feedbacks == 0
+                || audio.ocup_min < B_S / 4 || audio.ocup_max > 3 * B_S / 4;
+
+    audio.midiendo = 0;
+    __enable_irq();
+    return error;
+}
+
+static const bench_t benchs[] = {
+    { "usb_audio",        "frame", AUDIO_FRAMES, audio_preparar, audio_correr, audio_verificar },
+    { "usb_audio_deriva", "frame", AUDIO_FRAMES, audio_deriva_preparar, audio_correr, audio_verificar },
+    { "usb_audio_deriva_lenta", "frame", AUDIO_FRAMES, audio_lenta_preparar, audio_correr, audio_verificar },
+};
+#define NUM_BENCHS      (sizeof(benchs) / sizeof(benchs[0]))
+
+int main(void)
+{
+    return bench_correr(benchs, NUM_BENCHS);
+}
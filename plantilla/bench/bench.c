@@ -0,0 +1,2194 @@
+/* ============================================================================
+ * bench.c - Throughput de los drivers CMSIS de NXP, contra el simulador
+ * ============================================================================
+ *
+ * "make bench" compila esto para la PC (como "make host", con USE_CMSIS=1)
+ * y lo corre. Cada benchmark llama al camino caliente de un driver tal cual
+ * lo usaria el firmware y mide, con el reloj del simulador:
+ *
+ *   ciclos         ciclos de CCLK simulados (accesos a registros, esperas
+ *                  del periferico y 1 por cada instruccion que no toca
+ *                  registros)
+ *   instrucciones  instrucciones ejecutadas, contadas paso a paso (son de
+ *                  la PC, no del Cortex-M3: sirven para comparar, no como
+ *                  numero absoluto)
+ *   accesos        lecturas/escrituras de registros de perifericos
+ *
+ * y los divide por la unidad del benchmark (byte, llamada, segmento...). Todo sale del
+ * simulador, no del reloj de la PC: dos corridas del mismo codigo dan los
+ * mismos numeros, asi que el reporte se puede comparar entre commits
+ * (tools/bench_compare.py).
+ *
+ * El reporte va en JSON a BENCH_OUT (o a stdout si no esta) y una tabla
+ * legible a stdout. Sale con 1 si algun driver devolvio datos incorrectos.
+ * La medicion y el reporte estan en medicion.c, que comparte con los otros
+ * binarios de "make bench" (bench/cdc/).
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LPC17xx.h"
+#include "bench.h"
+#include "chksum-arch.h"
+#include "emac.h"
+#include "lpc17xx_clkpwr.h"
+#include "lpc17xx_emac.h"
+#include "lpc17xx_gpdma.h"
+#include "lpc17xx_gpio.h"
+#include "lpc17xx_i2c.h"
+#include "lpc17xx_ssp.h"
+#include "lpc17xx_uart.h"
+#include "msc.h"
+#include "mscuser.h"
+#include "ptsched.h"
+#include "sdspi.h"
+#include "sim.h"
+#include "tcpip.h"
+#include "timer.h"
+#include "uip.h"
+#include "uip_arp.h"
+#include "usb.h"
+#include "usbhw.h"
+
+#define N_GPIO          1024
+#define N_UART          1024
+#define N_SSP           1024
+#define N_I2C           256
+#define N_TRAMAS        3           /* entran juntas en los 4 descriptores */
+#define LEN_TRAMA       1514
+#define TRAMA_ALINEADA  1516
+
+#define DIR_MEMORIA_I2C 0x50
+
+static uint8_t tx[2048] __attribute__((aligned(4)));
+static uint8_t rx[N_TRAMAS * TRAMA_ALINEADA] __attribute__((aligned(4)));
+
+/* Lo que devolvio el driver en la ultima corrida */
+static uint32_t resultado;
+
+static void patron(uint8_t *p, uint32_t n, uint8_t semilla)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        p[i] = (uint8_t)(semilla + i * 7u);
+    }
+}
+
+/* ============================================================================
+ * Benchmarks
+ * ========================================================================= */
+
+/* --- GPIO_SetValue --------------------------------------------------------- */
+
+static void gpio_preparar(void)
+{
+    GPIO_SetDir(0, 0xFFFFFFFFu, 1);
+}
+
+static void gpio_correr(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < N_GPIO; i++) {
+        GPIO_SetValue(0, 1u << (i & 31));
+    }
+}
+
+static int gpio_verificar(void)
+{
+    return sim_gpio_pines(0) == 0xFFFFFFFFu ? 0 : 1;
+}
+
+/* --- UART_Send, bloqueante ------------------------------------------------- */
+
+static void uart_preparar(void)
+{
+    UART_CFG_Type cfg;
+    UART_FIFO_CFG_Type fifo;
+
+    CLKPWR_SetPCLKDiv(CLKPWR_PCLKSEL_UART0, CLKPWR_PCLKSEL_CCLK_DIV_1);
+    UART_ConfigStructInit(&cfg);
+    cfg.Baud_rate = 1000000;
+    UART_Init((LPC_UART_TypeDef *)LPC_UART0, &cfg);
+    UART_FIFOConfigStructInit(&fifo);
+    UART_FIFOConfig((LPC_UART_TypeDef *)LPC_UART0, &fifo);
+    UART_TxCmd((LPC_UART_TypeDef *)LPC_UART0, ENABLE);
+    sim_uart_salida(0, -1);
+    patron(tx, N_UART, 1);
+}
+
+static void uart_correr(void)
+{
+    resultado = UART_Send((LPC_UART_TypeDef *)LPC_UART0, tx, N_UART, BLOCKING);
+}
+
+static int uart_verificar(void)
+{
+    /* Los ultimos pueden estar todavia en la FIFO y el shift register */
+    return (resultado == N_UART && sim_uart_enviados(0) + 17 >= N_UART) ? 0 : 1;
+}
+
+/* --- UART_RingSend, por interrupciones ------------------------------------ */
+
+/* 1 MB por el ring de Tx de la UART0, a 1 Mbaud como uart_send. El firmware
+ * lo va metiendo de a pedazos mientras haya lugar y duerme en __WFI; la
+ * interrupcion (THRE, cada 16 bytes) la atiende el hilo principal con
+ * PRIMASK en 1, para que se cuenten sus instrucciones. Los ciclos son los
+ * de la linea en los dos: lo que se compara con uart_send (bloqueante, por
+ * polling) son las instrucciones y los accesos por byte, o sea cuanto CPU
+ * queda libre. Los bytes salen a un archivo y se comparan enteros. */
+#define N_UART_RING     (1024 * 1024)
+#define UART_RING_TX    1024
+#define UART_RING_PEDAZO 256            /* el patron se repite cada 256 */
+
+static struct {
+    int fd;
+    uint32_t enviados0;
+    volatile int listo;
+    uint8_t tx[UART_RING_TX];
+    uint8_t rx[16];
+} uring = { .fd = -1 };
+
+static void uring_evento(LPC_UART_TypeDef *UARTx, uint32_t evento)
+{
+    (void)UARTx;
+    if (evento & UART_RING_EVT_TXDONE) {
+        uring.listo = 1;
+    }
+}
+
+static void uring_preparar(void)
+{
+    UART_RING_CFG_Type ring;
+
+    uart_preparar();
+    if (uring.fd < 0) {
+        char nombre[] = "/tmp/bench_uart_XXXXXX";
+
+        uring.fd = mkstemp(nombre);
+        if (uring.fd < 0) {
+            perror("salida de la UART0");
+            exit(2);
+        }
+        unlink(nombre);
+    }
+    if (ftruncate(uring.fd, 0) != 0 || lseek(uring.fd, 0, SEEK_SET) != 0) {
+        perror("salida de la UART0");
+        exit(2);
+    }
+    sim_esperar(20000);                 /* que termine lo de uart_send */
+    sim_uart_salida(0, uring.fd);
+    uring.enviados0 = sim_uart_enviados(0);
+
+    UART_RingConfigStructInit(&ring);
+    ring.TxBuf = uring.tx;
+    ring.TxSize = sizeof(uring.tx);
+    ring.RxBuf = uring.rx;
+    ring.RxSize = sizeof(uring.rx);
+    ring.pfnCallback = uring_evento;
+    UART_RingInit((LPC_UART_TypeDef *)LPC_UART0, &ring);
+    uring.listo = 0;
+    patron(tx, UART_RING_PEDAZO, 3);
+    __disable_irq();
+    NVIC_EnableIRQ(UART0_IRQn);
+}
+
+static void uring_atender(void)
+{
+    __WFI();
+    NVIC_ClearPendingIRQ(UART0_IRQn);
+    UART_RingIntHandler((LPC_UART_TypeDef *)LPC_UART0);
+}
+
+static void uring_correr(void)
+{
+    uint32_t hecho = 0;
+
+    while (hecho < N_UART_RING) {
+        while (UART_RingGetTxCount((LPC_UART_TypeDef *)LPC_UART0)
+               > UART_RING_TX - UART_RING_PEDAZO) {
+            uring_atender();
+        }
+        hecho += UART_RingSend((LPC_UART_TypeDef *)LPC_UART0, tx, UART_RING_PEDAZO);
+    }
+    while (!uring.listo) {
+        uring_atender();
+    }
+}
+
+/* Todos los bytes en el archivo, en orden */
+static int uring_verificar(void)
+{
+    static uint8_t salida[N_UART_RING];
+    uint32_t i;
+    int error;
+
+    sim_esperar(20000);                 /* el ultimo en el shift register */
+    NVIC_DisableIRQ(UART0_IRQn);
+    UART_RingDeInit((LPC_UART_TypeDef *)LPC_UART0);
+    __enable_irq();
+    sim_uart_salida(0, -1);
+    error = sim_uart_enviados(0) - uring.enviados0 != N_UART_RING
+            || pread(uring.fd, salida, N_UART_RING, 0) != N_UART_RING;
+    for (i = 0; !error && i < N_UART_RING; i++) {
+        error = salida[i] != tx[i % UART_RING_PEDAZO];
+    }
+    return error;
+}
+
+/* --- SSP_ReadWrite, polling ------------------------------------------------ */
+
+static void ssp_preparar(void)
+{
+    SSP_CFG_Type cfg;
+
+    CLKPWR_SetPCLKDiv(CLKPWR_PCLKSEL_SSP0, CLKPWR_PCLKSEL_CCLK_DIV_1);
+    SSP_ConfigStructInit(&cfg);
+    cfg.ClockRate = 25000000;
+    SSP_Init(LPC_SSP0, &cfg);
+    SSP_Cmd(LPC_SSP0, ENABLE);
+    patron(tx, N_SSP, 3);
+    memset(rx, 0, N_SSP);
+}
+
+static void ssp_correr(void)
+{
+    SSP_DATA_SETUP_Type d;
+
+    memset(&d, 0, sizeof(d));
+    d.tx_data = tx;
+    d.rx_data = rx;
+    d.length = N_SSP;
+    resultado = (uint32_t)SSP_ReadWrite(LPC_SSP0, &d, SSP_TRANSFER_POLLING);
+}
+
+static int ssp_verificar(void)
+{
+    /* Sin esclavo, MISO devuelve lo que salio por MOSI */
+    return resultado != N_SSP || memcmp(tx, rx, N_SSP) != 0;
+}
+
+/* --- I2C_MasterTransferData, polling: puntero + lectura de la memoria ------ */
+
+static void i2c_preparar(void)
+{
+    I2C_Init(LPC_I2C0, 400000);
+    I2C_Cmd(LPC_I2C0, ENABLE);
+    patron(sim_i2c_memoria(0), 256, 5);
+    memset(rx, 0, N_I2C);
+}
+
+static void i2c_correr(void)
+{
+    I2C_M_SETUP_Type t;
+    uint8_t puntero = 0;
+
+    memset(&t, 0, sizeof(t));
+    t.sl_addr7bit = DIR_MEMORIA_I2C;
+    t.tx_data = &puntero;
+    t.tx_length = 1;
+    t.rx_data = rx;
+    t.rx_length = N_I2C;
+    t.retransmissions_max = 3;
+    resultado = I2C_MasterTransferData(LPC_I2C0, &t, I2C_TRANSFER_POLLING);
+}
+
+static int i2c_verificar(void)
+{
+    return resultado != SUCCESS || memcmp(rx, sim_i2c_memoria(0), N_I2C) != 0;
+}
+
+/* --- EMAC_ReadPacketBuffer: vaciar las tramas que ya estan en RAM ---------- */
+
+static void emac_preparar(void)
+{
+    static uint8_t mac[6] = { 0x00, 0x60, 0x37, 0x12, 0x34, 0x56 };
+    EMAC_CFG_Type cfg;
+    uint32_t antes = sim_emac_recibidas();
+    int i;
+
+    cfg.Mode = EMAC_MODE_AUTO;
+    cfg.pbEMAC_Addr = mac;
+    if (EMAC_Init(&cfg) != SUCCESS) {
+        return;
+    }
+    patron(tx, LEN_TRAMA, 9);
+    for (i = 0; i < N_TRAMAS; i++) {
+        sim_emac_recibir(tx, LEN_TRAMA);
+    }
+    /* Que terminen de llegar (a 100 Mbit, ~125 us cada una) */
+    while (sim_emac_recibidas() - antes < N_TRAMAS) {
+        sim_esperar(10000);
+    }
+}
+
+/* Cada trama va a su lugar de rx[], para poder verificarlas despues */
+static void emac_correr(void)
+{
+    EMAC_PACKETBUF_Type buf;
+    int i;
+
+    resultado = 0;
+    for (i = 0; i < N_TRAMAS && EMAC_CheckReceiveIndex() == TRUE; i++) {
+        /* El tamano incluye los 4 bytes del FCS */
+        buf.ulDataLen = EMAC_GetReceiveDataSize() + 1 - 4;
+        buf.pbDataBuf = (uint32_t *)(rx + i * TRAMA_ALINEADA);
+        EMAC_ReadPacketBuffer(&buf);
+        EMAC_UpdateRxConsumeIndex();
+        resultado += buf.ulDataLen;
+    }
+}
+
+static int emac_verificar(void)
+{
+    int i;
+
+    if (resultado != N_TRAMAS * LEN_TRAMA) {
+        return 1;
+    }
+    for (i = 0; i < N_TRAMAS; i++) {
+        if (memcmp(rx + i * TRAMA_ALINEADA, tx, LEN_TRAMA) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* --- EMAC_BorrowRxBuffer: las mismas tramas, sin copiarlas ---------------- */
+
+static uint32_t *prestadas[N_TRAMAS];
+
+/* Se devuelven enseguida: como no llegan tramas nuevas, los buffers siguen
+ * intactos para verificarlos despues */
+static void emac_prestada_correr(void)
+{
+    uint32_t len;
+    int i;
+
+    resultado = 0;
+    for (i = 0; i < N_TRAMAS; i++) {
+        prestadas[i] = EMAC_BorrowRxBuffer(&len, NULL);
+        if (prestadas[i] == NULL) {
+            return;
+        }
+        resultado += len - 4;
+    }
+    for (i = 0; i < N_TRAMAS; i++) {
+        EMAC_ReturnRxBuffer();
+    }
+}
+
+static int emac_prestada_verificar(void)
+{
+    int i;
+
+    if (resultado != N_TRAMAS * LEN_TRAMA) {
+        return 1;
+    }
+    for (i = 0; i < N_TRAMAS; i++) {
+        if (memcmp(prestadas[i], tx, LEN_TRAMA) != 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* --- EMAC_CRC32: el FCS de una trama, contra el calculo bit a bit --------- */
+
+/* Copia del emac_CRCCalc() que usaba EMAC_SetHashFilter() antes de las
+ * tablas: nibble a nibble, registro sin reflejar y sin invertir al final */
+static uint32_t crc_bit_a_bit(const uint8_t *p, uint32_t n)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    uint32_t i, j, q;
+    uint8_t byte;
+
+    for (i = 0; i < n; i++) {
+        byte = p[i];
+        for (j = 0; j < 2; j++) {
+            q = 0;
+            if (((crc >> 28) ^ (byte >> 3)) & 1) {
+                q ^= 0x04C11DB7u;
+            }
+            if (((crc >> 29) ^ (byte >> 2)) & 1) {
+                q ^= 0x09823B6Eu;
+            }
+            if (((crc >> 30) ^ (byte >> 1)) & 1) {
+                q ^= 0x130476DCu;
+            }
+            if (((crc >> 31) ^ (byte >> 0)) & 1) {
+                q ^= 0x2608EDB8u;
+            }
+            crc = (crc << 4) ^ q;
+            byte >>= 4;
+        }
+    }
+    return crc;
+}
+
+static uint32_t invertir_bits(uint32_t v)
+{
+    uint32_t r = 0;
+    int i;
+
+    for (i = 0; i < 32; i++) {
+        r = (r << 1) | ((v >> i) & 1);
+    }
+    return r;
+}
+
+static void crc_preparar(void)
+{
+    patron(tx, LEN_TRAMA, 3);
+}
+
+static void crc_bit_a_bit_correr(void)
+{
+    resultado = crc_bit_a_bit(tx, LEN_TRAMA);
+}
+
+static void crc_correr(void)
+{
+    resultado = EMAC_CRC32(tx, LEN_TRAMA);
+}
+
+static int crc_bit_a_bit_verificar(void)
+{
+    return resultado != invertir_bits(~EMAC_CRC32(tx, LEN_TRAMA));
+}
+
+/* Mismo resultado que el bit a bit con cualquier largo y alineacion, y el
+ * valor de control del CRC-32 ("123456789") */
+static int crc_verificar(void)
+{
+    uint32_t off, n;
+
+    if (resultado != ~invertir_bits(crc_bit_a_bit(tx, LEN_TRAMA))) {
+        return 1;
+    }
+    if (EMAC_CRC32((const uint8_t *)"123456789", 9) != 0xCBF43926u) {
+        return 1;
+    }
+    for (off = 0; off < 4; off++) {
+        for (n = 0; n <= 70; n++) {
+            if (EMAC_CRC32Update(EMAC_CRC32_INIT, tx + off, n)
+                    != invertir_bits(crc_bit_a_bit(tx + off, n))) {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* --- chksum_arch: el checksum de uIP sobre paquetes de tamanos reales ------ */
+
+/* Largos de lo que suma uIP: cabecera IP, pseudo cabecera, segmentos TCP
+ * de 1 byte (telnet), 536 (MSS por defecto) y 1460, y un UDP impar */
+static const uint16_t largos_ip[] = { 20, 8, 21, 40 + 536, 40 + 1460, 8 + 73 };
+#define N_LARGOS_IP     (sizeof(largos_ip) / sizeof(largos_ip[0]))
+#define N_IP            (20 + 8 + 21 + 40 + 536 + 40 + 1460 + 8 + 73)
+/* En uip_buf la cabecera IP empieza en el byte 14, despues de Ethernet */
+#define OFF_IP          14
+
+/* Copia del chksum() de uip.c: de a dos bytes, acarreo en cada suma */
+static uint16_t chksum_uip(uint16_t sum, const uint8_t *data, uint16_t len)
+{
+    uint16_t t;
+    const uint8_t *dataptr = data;
+    const uint8_t *last_byte = data + len - 1;
+
+    while (dataptr < last_byte) {
+        t = (dataptr[0] << 8) + dataptr[1];
+        sum += t;
+        if (sum < t) {
+            sum++;
+        }
+        dataptr += 2;
+    }
+    if (dataptr == last_byte) {
+        t = (dataptr[0] << 8) + 0;
+        sum += t;
+        if (sum < t) {
+            sum++;
+        }
+    }
+    return sum;
+}
+
+static void ip_preparar(void)
+{
+    patron(tx, sizeof(tx), 5);
+}
+
+static void chksum_uip_correr(void)
+{
+    uint32_t i;
+
+    resultado = 0;
+    for (i = 0; i < N_LARGOS_IP; i++) {
+        resultado += chksum_uip(0, tx + OFF_IP, largos_ip[i]);
+    }
+}
+
+static void chksum_arch_correr(void)
+{
+    uint32_t i;
+
+    resultado = 0;
+    for (i = 0; i < N_LARGOS_IP; i++) {
+        resultado += chksum_arch(0, tx + OFF_IP, largos_ip[i]);
+    }
+}
+
+static int chksum_uip_verificar(void)
+{
+    uint32_t i, r = 0;
+
+    for (i = 0; i < N_LARGOS_IP; i++) {
+        r += chksum_arch(0, tx + OFF_IP, largos_ip[i]);
+    }
+    return resultado != r;
+}
+
+/* Igual que el de uip.c con cualquier largo, alineacion y suma de entrada,
+ * incluidos los datos en cero y en 0xFF (el cero de complemento a uno) */
+static int chksum_arch_verificar(void)
+{
+    static const uint16_t sumas[] = { 0, 1, 0x1234, 0xFFFE, 0xFFFF };
+    uint8_t ceros[8] = { 0 };
+    uint8_t unos[8];
+    uint32_t off, n, s;
+
+    memset(unos, 0xFF, sizeof(unos));
+    if (chksum_uip_verificar()) {
+        return 1;
+    }
+    for (s = 0; s < sizeof(sumas) / sizeof(sumas[0]); s++) {
+        for (off = 0; off < 4; off++) {
+            for (n = 0; n <= 70; n++) {
+                if (chksum_arch(sumas[s], tx + off, n) != chksum_uip(sumas[s], tx + off, n)) {
+                    return 1;
+                }
+            }
+            for (n = 0; n + off <= sizeof(ceros); n++) {
+                if (chksum_arch(sumas[s], ceros + off, n) != chksum_uip(sumas[s], ceros + off, n)
+                    || chksum_arch(sumas[s], unos + off, n) != chksum_uip(sumas[s], unos + off, n)) {
+                    return 1;
+                }
+            }
+        }
+    }
+    n = 40 + 1460;
+    return chksum_arch(0, tx + 1, n) != chksum_uip(0, tx + 1, n);
+}
+
+/* --- uip_input: segmentos TCP repartidos entre 40 conexiones abiertas ----- */
+
+#define N_CONEXIONES    40
+#define N_SEGMENTOS     2000
+#define LEN_SEGMENTO    (UIP_LLH_LEN + UIP_TCPIP_HLEN)
+#define TCPBUF          ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define FLAG_FIN        0x01
+#define FLAG_SYN        0x02
+#define FLAG_ACK        0x10
+#define PUERTO_ARCHIVO  8080
+
+/* El ACK que sigue al handshake de cada conexion, listo para reinyectar */
+static u8_t acks[N_CONEXIONES][LEN_SEGMENTO];
+
+static void archivo_appcall(void);
+
+/* Los llama uip.c; en el bench no hay consola y la unica aplicacion es la
+ * de tcp_archivo */
+void httpd_appcall(void)
+{
+    if (uip_conn->lport == HTONS(PUERTO_ARCHIVO)) {
+        archivo_appcall();
+    }
+}
+
+void uip_log(char *msg)
+{
+    (void)msg;
+}
+
+/* Arma en uip_buf un segmento sin datos del cliente n al puerto dado, con
+ * una ventana de 64 KB */
+static void armar_segmento(int n, u16_t puerto, u8_t flags, const u8_t *seqno,
+                           const u8_t *ackno)
+{
+    struct uip_tcpip_hdr *b = TCPBUF;
+
+    memset(uip_buf, 0, LEN_SEGMENTO);
+    b->vhl = 0x45;
+    b->len[1] = UIP_TCPIP_HLEN;
+    b->ttl = 64;
+    b->proto = UIP_PROTO_TCP;
+    uip_ipaddr(b->srcipaddr, 192, 168, 0, 10 + n % 8);
+    uip_ipaddr_copy(b->destipaddr, uip_hostaddr);
+    b->srcport = HTONS(1024 + n);
+    b->destport = HTONS(puerto);
+    memcpy(b->seqno, seqno, 4);
+    memcpy(b->ackno, ackno, 4);
+    b->tcpoffset = 5 << 4;
+    b->flags = flags;
+    b->wnd[0] = 0xFF;
+    b->wnd[1] = 0xFF;
+    b->ipchksum = ~(uip_ipchksum());
+    b->tcpchksum = ~(uip_tcpchksum());
+    uip_len = LEN_SEGMENTO;
+}
+
+/* El numero de 32 bits en orden de red mas uno */
+static void mas_uno(u8_t *n)
+{
+    int i;
+
+    for (i = 3; i >= 0 && ++n[i] == 0; i--) {
+    }
+}
+
+/* Handshake de las 40 conexiones: SYN, el SYNACK que contesta uIP, ACK */
+static void uip_preparar(void)
+{
+    uip_ipaddr_t ip;
+    u8_t seq[4] = { 0x10, 0x00, 0x00, 0x00 };
+    u8_t ack[4] = { 0 };
+    int n;
+
+    uip_init();
+    uip_ipaddr(ip, 192, 168, 0, 100);
+    uip_sethostaddr(ip);
+    uip_ipaddr(ip, 255, 255, 255, 0);
+    uip_setnetmask(ip);
+    uip_listen(HTONS(80));
+
+    for (n = 0; n < N_CONEXIONES; n++) {
+        seq[3] = 0;
+        armar_segmento(n, 80, FLAG_SYN, seq, ack);
+        uip_input();
+        memcpy(ack, TCPBUF->seqno, 4);
+        mas_uno(ack);
+        seq[3] = 1;
+        armar_segmento(n, 80, FLAG_ACK, seq, ack);
+        memcpy(acks[n], uip_buf, LEN_SEGMENTO);
+        uip_input();
+    }
+}
+
+/* Sin datos nuevos ni nada pendiente, uIP no contesta: el costo es el de
+ * validar el segmento y encontrar su conexion */
+static void uip_correr(void)
+{
+    int i, n;
+
+    resultado = 0;
+    for (i = 0; i < N_SEGMENTOS; i++) {
+        n = (i * 7) % N_CONEXIONES;
+        memcpy(uip_buf, acks[n], LEN_SEGMENTO);
+        uip_len = LEN_SEGMENTO;
+        uip_input();
+        resultado += (uip_len != 0) + (uip_conn != &uip_conns[n]);
+    }
+}
+
+static int uip_verificar(void)
+{
+    int n;
+
+    for (n = 0; n < N_CONEXIONES; n++) {
+        if ((uip_conns[n].tcpstateflags & UIP_TS_MASK) != UIP_ESTABLISHED) {
+            return 1;
+        }
+    }
+    return resultado != 0;
+}
+
+/* --- uip_arp_out: paquetes a 48 vecinos de la LAN ------------------------- */
+
+/* Una red plana con decenas de equipos: la tabla ARP del port los tiene a
+ * todos y cada paquete que sale busca el suyo. Sin UIP_CONF_ARP_HASH la
+ * busqueda recorre la tabla, con el indice es una prueba de hash. */
+#define N_VECINOS       48
+#define N_PAQUETES      2000
+#define ARPBUF          ((struct uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+/* La respuesta ARP del vecino n, que uip_arp_arpin() anota en la tabla */
+static void arp_respuesta(int n)
+{
+    struct {
+        struct uip_eth_hdr eth;
+        u16_t hwtype, protocol;
+        u8_t hwlen, protolen;
+        u16_t opcode;
+        struct uip_eth_addr shwaddr;
+        u16_t sipaddr[2];
+        struct uip_eth_addr dhwaddr;
+        u16_t dipaddr[2];
+    } __attribute__((packed)) *arp = (void *)uip_buf;
+
+    memset(uip_buf, 0, sizeof(*arp));
+    arp->eth.type = HTONS(UIP_ETHTYPE_ARP);
+    arp->hwtype = HTONS(1);
+    arp->protocol = HTONS(UIP_ETHTYPE_IP);
+    arp->hwlen = 6;
+    arp->protolen = 4;
+    arp->opcode = HTONS(2);
+    arp->shwaddr.addr[0] = 0x02;
+    arp->shwaddr.addr[5] = 10 + n;
+    uip_ipaddr(arp->sipaddr, 192, 168, 0, 10 + n);
+    uip_ipaddr_copy(arp->dipaddr, uip_hostaddr);
+    uip_len = sizeof(*arp);
+    uip_arp_arpin();
+}
+
+static void arp_preparar(void)
+{
+    uip_ipaddr_t ip;
+    int n;
+
+    uip_init();
+    uip_arp_init();
+    uip_ipaddr(ip, 192, 168, 0, 100);
+    uip_sethostaddr(ip);
+    uip_ipaddr(ip, 255, 255, 255, 0);
+    uip_setnetmask(ip);
+    for (n = 0; n < N_VECINOS; n++) {
+        arp_respuesta(n);
+    }
+    memset(&uip_arp_stat, 0, sizeof(uip_arp_stat));
+}
+
+/* Cada paquete sale a otro vecino, salteando como uip_correr */
+static void arp_correr(void)
+{
+    int i, n;
+
+    resultado = 0;
+    for (i = 0; i < N_PAQUETES; i++) {
+        n = (i * 7) % N_VECINOS;
+        uip_ipaddr(ARPBUF->destipaddr, 192, 168, 0, 10 + n);
+        uip_len = UIP_TCPIP_HLEN;
+        uip_arp_out();
+        resultado += (uip_buf[5] != 10 + n) + (uip_len != LEN_SEGMENTO);
+    }
+}
+
+static int arp_verificar(void)
+{
+    return resultado != 0 || uip_arp_stat.hit != N_PAQUETES || uip_arp_stat.miss != 0;
+}
+
+/* --- tcp_archivo: 64 KB a un cliente que demora los ACK ------------------- */
+
+/* El cliente es una PC en la misma LAN de 100 Mbit/s, con el ACK demorado
+ * de Linux: contesta cada dos segmentos, o a los 40 ms si llego uno solo.
+ * uIP con UIP_TCP_WINDOW en 1 manda un segmento y espera su ACK, asi que
+ * cada segmento cuesta los 40 ms. Los ciclos cuentan el tiempo de espera:
+ * ciclos/byte es la inversa del throughput (a 100 MHz, 100 ciclos/byte
+ * son 1 MB/s). Las instrucciones son las del stack y la aplicacion.
+ *
+ * tcp_archivo_perdida es lo mismo, pero el cliente pierde una vez el
+ * segmento que empieza en PERDIDA_OFFSET, con otros de la ventana ya en
+ * camino detras: esos le llegan fuera de orden y los descarta. uIP lo
+ * reenvia cuando vence el RTO (en uip_periodic()) y despues reenvia el
+ * resto de la ventana de a uno por ACK (go-back-N). */
+#define N_ARCHIVO       (64 * 1024)
+#define PERDIDA_OFFSET  (20 * 1460)    /* el segmento 21, con el MSS de Linux */
+#define LATENCIA_US     100         /* de ida, sin contar el cable */
+#define ACK_DEMORADO_US 40000
+#define PERIODICO_US    500000      /* el timer de uip_periodic() del port */
+#define MBIT_S          100
+#define BYTES_CABLE     (UIP_LLH_LEN + 24)  /* Ethernet, preambulo, FCS, IFG */
+#define N_ACKS          16
+#define NUNCA           UINT64_MAX
+
+static uint8_t archivo[N_ARCHIVO];
+static uint32_t archivo_enviado;    /* lo que uIP ya dio por recibido */
+static uint16_t archivo_ultimo;     /* largo del ultimo uip_send() */
+
+/* El servidor: manda el archivo de a un segmento, como httpd */
+static void archivo_appcall(void)
+{
+    if (uip_acked()) {
+        archivo_enviado += archivo_ultimo;
+        archivo_ultimo = 0;
+    }
+    if (uip_rexmit() && archivo_ultimo > 0) {
+        uip_send(archivo + archivo_enviado, archivo_ultimo);
+    } else if (archivo_ultimo == 0 && (uip_connected() || uip_acked() || uip_poll())) {
+        if (archivo_enviado == N_ARCHIVO) {
+            uip_close();
+            return;
+        }
+        archivo_ultimo = uip_mss();
+        if (archivo_ultimo > N_ARCHIVO - archivo_enviado) {
+            archivo_ultimo = (uint16_t)(N_ARCHIVO - archivo_enviado);
+        }
+        uip_send(archivo + archivo_enviado, archivo_ultimo);
+    }
+}
+
+/* El cliente */
+static struct {
+    struct uip_conn *conn;
+    u8_t seq[4];                /* no manda datos: queda fijo */
+    uint32_t isn;               /* numero de secuencia del primer byte */
+    uint32_t rcv_nxt;
+    uint64_t cable;             /* cuando se libera el cable hacia el */
+    uint64_t demorado;          /* cuando sale el ACK demorado, o NUNCA */
+    int sin_ack;                /* segmentos que llegaron sin ACK */
+    int fin, error;
+    int perder;                 /* todavia tiene que perder un segmento */
+    int perdidos;               /* segmentos que no llegaron */
+    int fuera;                  /* llegados despues del perdido, descartados */
+    uint64_t llega[N_ACKS];     /* ACKs en viaje hacia uIP */
+    uint32_t ack[N_ACKS];
+    int ack_cab, ack_n;
+} cli;
+
+static uint64_t ciclos_us(uint64_t us)
+{
+    return us * (sim_frecuencia() / 1000000u);
+}
+
+static uint32_t leer32(const u8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static void escribir32(u8_t *p, uint32_t v)
+{
+    p[0] = (u8_t)(v >> 24);
+    p[1] = (u8_t)(v >> 16);
+    p[2] = (u8_t)(v >> 8);
+    p[3] = (u8_t)v;
+}
+
+/* El cliente manda un ACK al recibir en t lo que llego hasta rcv_nxt */
+static void cliente_ack(uint64_t t)
+{
+    if (cli.ack_n == N_ACKS) {
+        cli.error = 1;
+        return;
+    }
+    cli.llega[(cli.ack_cab + cli.ack_n) % N_ACKS] = t + ciclos_us(LATENCIA_US);
+    cli.ack[(cli.ack_cab + cli.ack_n) % N_ACKS] = cli.rcv_nxt;
+    cli.ack_n++;
+    cli.sin_ack = 0;
+    cli.demorado = NUNCA;
+}
+
+/* El segmento que uIP dejo en uip_buf llega al cliente */
+static void cliente_recibir(void)
+{
+    struct uip_tcpip_hdr *b = TCPBUF;
+    uint32_t seq = leer32(b->seqno);
+    uint32_t len = uip_len - UIP_TCPIP_HLEN;
+    uint64_t t = sim_ciclos();
+
+    /* Espera a que se libere el cable y viaja */
+    if (cli.cable > t) {
+        t = cli.cable;
+    }
+    t += (uint64_t)(uip_len + BYTES_CABLE) * 8u * (sim_frecuencia() / 1000000u) / MBIT_S;
+    cli.cable = t;
+    t += ciclos_us(LATENCIA_US);
+
+    if (len > 0 && cli.perder && seq - cli.isn == PERDIDA_OFFSET) {
+        cli.perder = 0;
+        cli.perdidos++;
+        return;
+    }
+    if (len > 0 && cli.perdidos > 0 && (int32_t)(seq - cli.rcv_nxt) > 0) {
+        cli.fuera++;
+    }
+    if (len > 0 && seq == cli.rcv_nxt) {
+        if (cli.rcv_nxt - cli.isn + len > N_ARCHIVO
+            || memcmp(&uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN],
+                      archivo + (cli.rcv_nxt - cli.isn), len) != 0) {
+            cli.error = 1;
+        }
+        cli.rcv_nxt += len;
+        if (++cli.sin_ack >= 2) {
+            cliente_ack(t);
+        } else if (cli.demorado == NUNCA) {
+            cli.demorado = t + ciclos_us(ACK_DEMORADO_US);
+        }
+    } else if (len > 0) {
+        /* Repetido o fuera de orden: ACK inmediato */
+        cliente_ack(t);
+    }
+    if ((b->flags & FLAG_FIN) && seq + len == cli.rcv_nxt) {
+        cli.rcv_nxt++;
+        cli.fin = 1;
+        cliente_ack(t);
+    }
+}
+
+/* Lo que hace el driver del port despues de uip_input() o uip_periodic() */
+static void servidor_enviar(void)
+{
+    while (uip_len > 0) {
+        cliente_recibir();
+        if (uip_conn == NULL || !uip_window_open(uip_conn)) {
+            break;
+        }
+        uip_poll_conn(uip_conn);
+    }
+}
+
+static void cliente_segmento(uint32_t ack)
+{
+    u8_t ackno[4];
+
+    escribir32(ackno, ack);
+    armar_segmento(0, PUERTO_ARCHIVO, FLAG_ACK, cli.seq, ackno);
+}
+
+/* SYN del cliente y SYNACK de uIP; el ACK que completa el handshake va
+ * en la medicion, porque uIP contesta con el primer segmento */
+static void tcp_preparar(void)
+{
+    static const u8_t mss[4] = { 2, 4, 1460 >> 8, 1460 & 0xFF };
+    uip_ipaddr_t ip;
+    u8_t ack[4] = { 0 };
+    uint32_t i;
+
+    for (i = 0; i < N_ARCHIVO; i += 1024) {
+        patron(archivo + i, 1024, (uint8_t)(i >> 10) * 31u);
+    }
+    archivo_enviado = 0;
+    archivo_ultimo = 0;
+    memset(&cli, 0, sizeof(cli));
+    cli.demorado = NUNCA;
+    escribir32(cli.seq, 0x20000000u);
+
+    uip_init();
+    uip_ipaddr(ip, 192, 168, 0, 100);
+    uip_sethostaddr(ip);
+    uip_ipaddr(ip, 255, 255, 255, 0);
+    uip_setnetmask(ip);
+    uip_listen(HTONS(PUERTO_ARCHIVO));
+
+    /* Con la opcion MSS de Linux (uIP no tiene un MSS por defecto) */
+    armar_segmento(0, PUERTO_ARCHIVO, FLAG_SYN, cli.seq, ack);
+    memcpy(&uip_buf[LEN_SEGMENTO], mss, sizeof(mss));
+    TCPBUF->len[1] += sizeof(mss);
+    TCPBUF->tcpoffset = 6 << 4;
+    uip_len += sizeof(mss);
+    TCPBUF->ipchksum = 0;
+    TCPBUF->ipchksum = ~(uip_ipchksum());
+    TCPBUF->tcpchksum = 0;
+    TCPBUF->tcpchksum = ~(uip_tcpchksum());
+    uip_input();
+    cli.conn = uip_conn;
+    cli.isn = leer32(TCPBUF->seqno) + 1;
+    cli.rcv_nxt = cli.isn;
+    mas_uno(cli.seq);
+}
+
+static void tcp_correr(void)
+{
+    uint64_t periodico = sim_ciclos() + ciclos_us(PERIODICO_US);
+    uint64_t limite = sim_ciclos() + ciclos_us(60000000u);
+    uint64_t t;
+
+    cliente_segmento(cli.rcv_nxt);
+    uip_input();
+    servidor_enviar();
+
+    while (!cli.fin && !cli.error && sim_ciclos() < limite) {
+        t = periodico;
+        if (cli.demorado < t) {
+            t = cli.demorado;
+        }
+        if (cli.ack_n > 0 && cli.llega[cli.ack_cab] <= t) {
+            t = cli.llega[cli.ack_cab];
+        }
+        if (t > sim_ciclos()) {
+            sim_esperar(t - sim_ciclos());
+        }
+
+        if (cli.ack_n > 0 && cli.llega[cli.ack_cab] == t) {
+            cliente_segmento(cli.ack[cli.ack_cab]);
+            cli.ack_cab = (cli.ack_cab + 1) % N_ACKS;
+            cli.ack_n--;
+            uip_input();
+        } else if (cli.demorado == t) {
+            cliente_ack(t);
+            continue;
+        } else {
+            periodico += ciclos_us(PERIODICO_US);
+            uip_periodic_conn(cli.conn);
+        }
+        servidor_enviar();
+    }
+    resultado = cli.rcv_nxt - cli.isn - (uint32_t)cli.fin;
+}
+
+static int tcp_verificar(void)
+{
+    return cli.error || !cli.fin || resultado != N_ARCHIVO;
+}
+
+static void tcp_perdida_preparar(void)
+{
+    tcp_preparar();
+    cli.perder = 1;
+}
+
+/* Ademas, que se haya perdido el segmento y que detras vinieran otros */
+static int tcp_perdida_verificar(void)
+{
+    return tcp_verificar() || cli.perdidos != 1 || cli.fuera == 0;
+}
+
+/* --- Easy_Web: los ACK y las retransmisiones que arma tcpip.c ------------- */
+
+/* Un socket de Easy_Web conectado a un navegador de la LAN. ew_ack manda
+ * un ACK por cada segmento que llega (Easy_Web no demora los ACK);
+ * ew_rexmit retransmite el segmento de datos lleno, con otro numero de ACK
+ * cada vez porque el navegador siguio mandando. El ACK arranca cerca de
+ * 2^32 para que de la vuelta en la corrida. ew_cambios mezcla segmentos de
+ * datos de largo impar, sus retransmisiones y segmentos sin datos con PSH,
+ * FIN o solo ACK, con el SEQ avanzando de a un largo impar: cada trama
+ * cambia otras palabras de las que UpdateChecksum() tiene que corregir.
+ *
+ * Antes de cada trama pasa el tiempo de cable de la anterior, como si el
+ * CPU estuviera en otra cosa: Rdy4Tx() no espera y las instrucciones son
+ * las de armar la trama, mas las ~90 de llamar a sim_esperar() (los ciclos
+ * si incluyen la espera). Las tramas salen del EMAC durante esa espera y
+ * ahi se cuenta lo que corre, asi que ew_salida() solo guarda las cabeceras
+ * y el largo; los checksums IP y TCP, el SEQ, el ACK y los flags de cada una
+ * se verifican al final. */
+#define N_EW_ACKS       2000
+#define N_EW_REXMIT     500
+#define N_EW_CAMBIOS    500
+#define EW_SOCK         0
+#define EW_AVANCE       MAX_TCP_RX_DATA_SIZE    /* lo que llega entre trama y trama */
+#define EW_CABLE_ACK    1000                    /* ciclos: 54 bytes a 100 Mbit, holgado */
+#define EW_CABLE_DATOS  6000                    /* 54 + 512 bytes */
+#define EW_CABECERA     (OFF_IP + 40)           /* Ethernet, IP y TCP */
+
+/* Lo que se espera de cada trama de ew_cambios */
+typedef struct {
+    uint32_t ack;
+    uint16_t datos;
+    uint16_t code;              /* TCP_CODE_xxx; con datos, el segmento nuevo */
+    int rexmit;                 /* reenvia el segmento de datos anterior */
+} ew_cambio_t;
+
+static struct {
+    uint32_t tramas;
+    uint32_t malas;             /* de mas */
+    uint32_t seq;               /* el SEQ de las tramas de easyweb_ack y _rexmit */
+    uint32_t ack;               /* el de la primera trama */
+    uint16_t datos;             /* bytes de datos de cada una */
+    uint8_t cab[N_EW_ACKS][EW_CABECERA];
+    uint32_t largo[N_EW_ACKS];
+    ew_cambio_t cambios[N_EW_CAMBIOS];
+} ew;
+
+static uint8_t ew_datos[MAX_TCP_TX_DATA_SIZE];
+
+static void ew_salida(const uint8_t *trama, uint32_t len)
+{
+    if (ew.tramas == N_EW_ACKS || len < EW_CABECERA) {
+        ew.malas++;
+        return;
+    }
+    ew.largo[ew.tramas] = len;
+    memcpy(ew.cab[ew.tramas++], trama, EW_CABECERA);
+}
+
+/* Hasta que el EMAC termine de mandar lo que tiene */
+static void ew_esperar(uint32_t tramas)
+{
+    int i;
+
+    for (i = 0; i < 100 && ew.tramas < tramas; i++) {
+        sim_esperar(10000);
+    }
+}
+
+/* La trama i que salio: largo, checksums IP y TCP (los datos son los
+ * primeros de ew_datos), SEQ, ACK y flags */
+static int ew_trama_mal(uint32_t i, uint16_t datos, uint32_t seq, uint32_t ack,
+                        uint16_t code)
+{
+    const uint8_t *t = ew.cab[i];
+    uint16_t largo_tcp = (uint16_t)(20 + datos);
+    uint16_t sum;
+
+    sum = chksum_uip((uint16_t)(largo_tcp + PROT_TCP), t + OFF_IP + 12, 8);
+    sum = chksum_uip(sum, t + OFF_IP + 20, 20);
+    sum = chksum_uip(sum, ew_datos, datos);
+    return ew.largo[i] != (uint32_t)(EW_CABECERA + datos)
+           || chksum_uip(0, t + OFF_IP, 20) != 0xFFFF || sum != 0xFFFF
+           || ((t[OFF_IP + 2] << 8) | t[OFF_IP + 3]) != 20 + largo_tcp
+           || leer32(t + OFF_IP + 24) != seq
+           || leer32(t + OFF_IP + 28) != ack
+           || (t[OFF_IP + 33] & 0x3F) != code;
+}
+
+/* Las "tramas" que esperaba, cada una con el ACK siguiente */
+static int ew_verificar(uint32_t tramas)
+{
+    uint32_t i;
+
+    ew_esperar(tramas);
+    sim_emac_salida(NULL);
+    if (ew.tramas != tramas || ew.malas != 0) {
+        return 1;
+    }
+    for (i = 0; i < tramas; i++) {
+        if (ew_trama_mal(i, ew.datos, ew.seq, ew.ack + i * EW_AVANCE, TCP_CODE_ACK)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void ew_preparar(void)
+{
+    EMAC_CFG_Type cfg;
+    TTCPSocket *s = &TCPSocket[EW_SOCK];
+
+    cfg.Mode = EMAC_MODE_AUTO;
+    cfg.pbEMAC_Addr = (uint8_t *)MyMAC;
+    if (EMAC_Init(&cfg) != SUCCESS) {
+        return;
+    }
+    sim_emac_salida(ew_salida);
+
+    memset(s, 0, sizeof(*s));
+    s->TxFrame = TxFrame1(EW_SOCK);
+    s->RxBuffer = RxTCPBuffer(EW_SOCK);
+    s->StateMachine = ESTABLISHED;
+    s->Status = SOCK_ACTIVE | SOCK_CONNECTED | SOCK_TX_BUF_RELEASED;
+    s->LocalPort = TCP_PORT_HTTP;
+    s->RemotePort = 50000;
+    s->RemoteIP[0] = 192 + (168 << 8);          /* 192.168.0.1, como MyIP */
+    s->RemoteIP[1] = 0 + (1 << 8);
+    s->RemoteMAC[0] = 0x0002;
+    s->RemoteMAC[2] = 0x0100;
+    s->SeqNr = 0x12345678u;
+    s->UNASeqNr = s->SeqNr;
+    s->AckNr = 0xFFFFF000u;
+    memset(&ew, 0, sizeof(ew));
+    ew.seq = s->SeqNr;
+    ew.ack = s->AckNr + EW_AVANCE;
+}
+
+static void ew_ack_correr(void)
+{
+    TTCPSocket *s = &TCPSocket[EW_SOCK];
+    int i;
+
+    for (i = 0; i < N_EW_ACKS; i++) {
+        sim_esperar(EW_CABLE_ACK);
+        s->AckNr += EW_AVANCE;
+        PrepareTCP_FRAME(s, TCP_CODE_ACK);
+    }
+}
+
+static int ew_ack_verificar(void)
+{
+    return ew_verificar(N_EW_ACKS);
+}
+
+/* El segmento sale una vez antes de medir, como lo manda HTTPServer() */
+static void ew_rexmit_preparar(void)
+{
+    TTCPSocket *s = &TCPSocket[EW_SOCK];
+
+    ew_preparar();
+    patron(ew_datos, MAX_TCP_TX_DATA_SIZE, 3);
+    memcpy(TCP_TX_BUF(EW_SOCK), ew_datos, MAX_TCP_TX_DATA_SIZE);
+    s->TxDataCount = MAX_TCP_TX_DATA_SIZE;
+    ew.datos = MAX_TCP_TX_DATA_SIZE;
+    TCPTransmitTxBuffer(EW_SOCK);
+    ew_esperar(1);
+    ew.tramas = 0;
+}
+
+static void ew_rexmit_correr(void)
+{
+    TTCPSocket *s = &TCPSocket[EW_SOCK];
+    int i;
+
+    for (i = 0; i < N_EW_REXMIT; i++) {
+        sim_esperar(EW_CABLE_DATOS);
+        s->AckNr += EW_AVANCE;
+        TCPHandleRetransmission(s);
+    }
+}
+
+static int ew_rexmit_verificar(void)
+{
+    return ew_verificar(N_EW_REXMIT);
+}
+
+/* De a cinco: un segmento de datos de largo impar, su retransmision y tres
+ * sin datos (ACK con PSH, FIN y ACK solo). El ACK avanza algo impar en
+ * cada trama. Los datos nuevos salen cuando el navegador ya reconocio los
+ * anteriores (SEQ = UNA), como en HTTPServer(). */
+static void ew_cambios_preparar(void)
+{
+    static const uint16_t codes[5] = {
+        TCP_CODE_ACK, TCP_CODE_ACK, TCP_CODE_ACK | TCP_CODE_PSH,
+        TCP_CODE_FIN | TCP_CODE_ACK, TCP_CODE_ACK
+    };
+    TTCPSocket *s = &TCPSocket[EW_SOCK];
+    uint32_t ack, i;
+
+    ew_preparar();
+    patron(ew_datos, MAX_TCP_TX_DATA_SIZE, 5);
+    memcpy(TCP_TX_BUF(EW_SOCK), ew_datos, MAX_TCP_TX_DATA_SIZE);
+    ack = s->AckNr;
+    for (i = 0; i < N_EW_CAMBIOS; i++) {
+        ew_cambio_t *c = &ew.cambios[i];
+
+        ack += 1 + 2 * ((i * 37) % 300);
+        c->ack = ack;
+        c->code = codes[i % 5];
+        c->rexmit = (i % 5 == 1);
+        c->datos = 0;
+        if (i % 5 < 2) {
+            c->datos = (uint16_t)(1 + 2 * ((i * 53) % (MAX_TCP_TX_DATA_SIZE / 2)));
+        }
+        if (c->rexmit) {
+            c->datos = ew.cambios[i - 1].datos;
+        }
+    }
+}
+
+static void ew_cambios_correr(void)
+{
+    TTCPSocket *s = &TCPSocket[EW_SOCK];
+    int i;
+
+    for (i = 0; i < N_EW_CAMBIOS; i++) {
+        const ew_cambio_t *c = &ew.cambios[i];
+
+        sim_esperar(EW_CABLE_DATOS);
+        s->AckNr = c->ack;
+        if (c->rexmit) {
+            TCPHandleRetransmission(s);
+        } else if (c->datos > 0) {
+            s->SeqNr = s->UNASeqNr;
+            s->Status |= SOCK_TX_BUF_RELEASED;
+            s->TxDataCount = c->datos;
+            TCPTransmitTxBuffer(EW_SOCK);
+        } else {
+            PrepareTCP_FRAME(s, c->code);
+        }
+    }
+}
+
+static int ew_cambios_verificar(void)
+{
+    uint32_t seq = ew.seq, i;
+
+    ew_esperar(N_EW_CAMBIOS);
+    sim_emac_salida(NULL);
+    if (ew.tramas != N_EW_CAMBIOS || ew.malas != 0) {
+        return 1;
+    }
+    for (i = 0; i < N_EW_CAMBIOS; i++) {
+        const ew_cambio_t *c = &ew.cambios[i];
+
+        if (c->datos > 0 && !c->rexmit && i > 0) {
+            seq += ew.cambios[i - 5].datos;
+        }
+        if (ew_trama_mal(i, c->datos, seq, c->ack, c->code)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* --- Telemetria: bloques del ADC por UDP (apps/telemetry de uIP) ---------- */
+
+/* Un bloque de 128 muestras del ADC (512 bytes) por datagrama a un equipo
+ * de la LAN que ya esta en la tabla ARP. telemetria_uip lo manda como
+ * cualquier aplicacion de uIP: copiado a uip_buf, checksums enteros en
+ * uip_process() y copiado otra vez al buffer del EMAC. telemetria_directa
+ * completa la plantilla de cabeceras de telemetry.c a partir de las sumas
+ * ya hechas y el EMAC lee el bloque de donde esta (EMAC_ReferTxBuffer()).
+ *
+ * Como en easyweb_*, antes de cada datagrama pasa su tiempo de cable: las
+ * instrucciones son las del CPU por paquete y los ciclos, menos TEL_CABLE,
+ * lo que tarda en armarlo (a 100 MHz, 10^8 / esos ciclos es el maximo de
+ * paquetes por segundo). tel_salida() solo guarda las cabeceras y compara
+ * las muestras de la primera trama; el resto se verifica al final. */
+#define N_TEL           500
+#define TEL_BLOQUE      512
+#define TEL_CABLE       6000        /* ciclos: 44 + 512 bytes a 100 Mbit, holgado */
+#define TEL_PUERTO      5000
+#define TEL_VECINO      0           /* 192.168.0.10, de arp_respuesta() */
+
+static struct {
+    uint32_t tramas;
+    uint32_t malas;             /* de otro largo o con otras muestras */
+    uint8_t cab[N_TEL][TELEMETRY_HDR_LEN];
+} tel;
+
+static uint32_t tel_bloque[TEL_BLOQUE / 4];
+
+/* Los manda la aplicacion: lo mismo que en lpc17xx_port/main.c */
+int telemetry_output(const void *hdr, u16_t hlen, const void *data, u16_t dlen)
+{
+    return tapdev_send2(hdr, hlen, data, dlen);
+}
+
+static void tel_salida(const uint8_t *trama, uint32_t len)
+{
+    if (tel.tramas == N_TEL || len != TELEMETRY_HDR_LEN + TEL_BLOQUE
+        || (tel.tramas == 0
+            && memcmp(trama + TELEMETRY_HDR_LEN, tel_bloque, TEL_BLOQUE) != 0)) {
+        tel.malas++;
+        return;
+    }
+    memcpy(tel.cab[tel.tramas++], trama, TELEMETRY_HDR_LEN);
+}
+
+static void tel_preparar(void)
+{
+    EMAC_CFG_Type cfg;
+    uip_ipaddr_t ip;
+
+    cfg.Mode = EMAC_MODE_AUTO;
+    cfg.pbEMAC_Addr = (uint8_t *)MyMAC;
+    if (EMAC_Init(&cfg) != SUCCESS) {
+        return;
+    }
+    sim_emac_salida(tel_salida);
+
+    uip_init();
+    uip_arp_init();
+    memcpy(uip_ethaddr.addr, MyMAC, sizeof(uip_ethaddr.addr));
+    uip_ipaddr(ip, 192, 168, 0, 100);
+    uip_sethostaddr(ip);
+    uip_ipaddr(ip, 255, 255, 255, 0);
+    uip_setnetmask(ip);
+    arp_respuesta(TEL_VECINO);
+    uip_ipaddr(ip, 192, 168, 0, 10 + TEL_VECINO);
+    telemetry_init(ip, HTONS(TEL_PUERTO));
+
+    patron((uint8_t *)tel_bloque, TEL_BLOQUE, 5);
+    memset(&tel, 0, sizeof(tel));
+    resultado = 0;
+}
+
+static void tel_uip_correr(void)
+{
+    int i;
+
+    for (i = 0; i < N_TEL; i++) {
+        sim_esperar(TEL_CABLE);
+        resultado += !telemetry_send_uip(tel_bloque, TEL_BLOQUE);
+    }
+}
+
+static void tel_directa_correr(void)
+{
+    int i;
+
+    for (i = 0; i < N_TEL; i++) {
+        sim_esperar(TEL_CABLE);
+        resultado += !telemetry_send(tel_bloque, TEL_BLOQUE);
+    }
+}
+
+/* Todas al vecino, con checksums buenos, numeros de secuencia seguidos y
+ * los IP ID de uIP: el siguiente que da uip_nextipid() va despues del ultimo */
+static int tel_verificar(void)
+{
+    uint16_t largo_udp = 8 + 2 + TEL_BLOQUE;
+    uint16_t sum, seq0, ipid0;
+    uint32_t i;
+    int j;
+
+    for (j = 0; j < 100 && tel.tramas < N_TEL; j++) {
+        sim_esperar(10000);
+    }
+    sim_emac_salida(NULL);
+    if (resultado != 0 || tel.tramas != N_TEL || tel.malas != 0) {
+        return 1;
+    }
+    seq0 = (uint16_t)((tel.cab[0][42] << 8) | tel.cab[0][43]);
+    ipid0 = (uint16_t)(uip_nextipid() - 1 - (N_TEL - 1));
+    for (i = 0; i < N_TEL; i++) {
+        const uint8_t *t = tel.cab[i];
+
+        sum = chksum_uip((uint16_t)(largo_udp + UIP_PROTO_UDP), t + OFF_IP + 12, 8);
+        sum = chksum_uip(sum, t + OFF_IP + 20, 10);
+        sum = chksum_uip(sum, (const uint8_t *)tel_bloque, TEL_BLOQUE);
+        if (t[0] != 0x02 || t[5] != 10 + TEL_VECINO
+            || chksum_uip(0, t + OFF_IP, 20) != 0xFFFF || sum != 0xFFFF
+            || ((t[OFF_IP + 2] << 8) | t[OFF_IP + 3]) != 20 + largo_udp
+            || ((t[OFF_IP + 24] << 8) | t[OFF_IP + 25]) != largo_udp
+            || ((t[OFF_IP + 4] << 8) | t[OFF_IP + 5]) != (uint16_t)(ipid0 + i)
+            || ((t[42] << 8) | t[43]) != (uint16_t)(seq0 + i)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* --- Temporizadores de las aplicaciones uIP ------------------------------ */
+
+/* N_TEMP temporizadores periodicos, de 10 a 451 ticks, durante N_TICKS
+ * ticks. temporizadores_lineal los revisa como lo hacia el loop de
+ * lpc17xx_port/main.c con timer.c: timer_expired() de cada uno en cada
+ * pasada (aca una por tick; el loop real da muchas mas). temporizadores_rueda
+ * usa uip/ptsched.c: cada uno es una tarea con su temporizador en la rueda,
+ * y por tick solo se avanza la rueda y corren las tareas que vencieron.
+ * Cada disparo se anota con su tick, que tiene que ser justo el del
+ * vencimiento. */
+#define N_TEMP          64
+#define N_TICKS         2000
+#define TEMP_INTERVALO(i)   (10 + 7 * (i))
+
+static clock_time_t reloj;
+static uint32_t disparos, temp_malos;
+static uint32_t temp_n[N_TEMP];
+
+static struct timer temp[N_TEMP];
+static struct ptsched_task tareas[N_TEMP];
+static struct ptsched_timer temp_rueda[N_TEMP];
+
+/* El reloj de uIP (clock-arch.c con el SysTick en la placa) */
+clock_time_t clock_time(void)
+{
+    return reloj;
+}
+
+/* El temporizador i vencio en el tick reloj: el de su disparo numero n */
+static void temp_disparo(int i)
+{
+    disparos++;
+    if (reloj != ++temp_n[i] * TEMP_INTERVALO(i)) {
+        temp_malos++;
+    }
+}
+
+static PT_THREAD(tarea_temp(struct ptsched_task *t))
+{
+    struct ptsched_timer *tm = t->data;
+
+    PT_BEGIN(&t->pt);
+    ptsched_timer_set(tm, t, TEMP_INTERVALO(tm - temp_rueda));
+    while (1) {
+        PT_WAIT_UNTIL(&t->pt, ptsched_timer_expired(tm));
+        ptsched_timer_reset(tm);
+        temp_disparo(tm - temp_rueda);
+    }
+    PT_END(&t->pt);
+}
+
+static void temp_lineal_preparar(void)
+{
+    int i;
+
+    reloj = 0;
+    disparos = 0;
+    temp_malos = 0;
+    memset(temp_n, 0, sizeof(temp_n));
+    for (i = 0; i < N_TEMP; i++) {
+        timer_set(&temp[i], TEMP_INTERVALO(i));
+    }
+}
+
+static void temp_lineal_correr(void)
+{
+    int i, j;
+
+    for (j = 0; j < N_TICKS; j++) {
+        reloj++;
+        for (i = 0; i < N_TEMP; i++) {
+            if (timer_expired(&temp[i])) {
+                timer_reset(&temp[i]);
+                temp_disparo(i);
+            }
+        }
+    }
+}
+
+static void temp_rueda_preparar(void)
+{
+    int i;
+
+    reloj = 0;
+    disparos = 0;
+    temp_malos = 0;
+    memset(temp_n, 0, sizeof(temp_n));
+    memset(temp_rueda, 0, sizeof(temp_rueda));
+    ptsched_init();
+    for (i = 0; i < N_TEMP; i++) {
+        ptsched_task_init(&tareas[i], tarea_temp, &temp_rueda[i]);
+        ptsched_post(&tareas[i]);
+    }
+    ptsched_run();
+}
+
+static void temp_rueda_correr(void)
+{
+    int j;
+
+    for (j = 0; j < N_TICKS; j++) {
+        reloj++;
+        ptsched_run();
+    }
+}
+
+/* Casos de la rueda que el periodico no toca, fuera de la medicion: cada
+ * temporizador se arma una vez y tiene que vencer una sola vez, justo en
+ * su tick (caso_vence), con el reloj avanzando de a un tick */
+#define N_CASO          8
+#define CASO_RANGO      ((clock_time_t)1 << 18)     /* RANGE de ptsched.c */
+
+static struct ptsched_task caso_tarea[N_CASO];
+static struct ptsched_timer caso_temp[N_CASO];
+static clock_time_t caso_vence[N_CASO], caso_tick[N_CASO];
+static uint32_t caso_disparos[N_CASO];
+
+static PT_THREAD(tarea_caso(struct ptsched_task *t))
+{
+    int i = t - caso_tarea;
+
+    PT_BEGIN(&t->pt);
+    caso_disparos[i]++;
+    caso_tick[i] = reloj;
+    PT_END(&t->pt);
+}
+
+static void caso_armar(int i, clock_time_t intervalo)
+{
+    ptsched_timer_set(&caso_temp[i], &caso_tarea[i], intervalo);
+    caso_vence[i] = reloj + intervalo;
+    caso_disparos[i] = 0;
+}
+
+static void caso_avanzar(clock_time_t ticks)
+{
+    while (ticks--) {
+        reloj++;
+        ptsched_run();
+    }
+}
+
+/* Temporizadores [desde, hasta) que vencieron una vez y en su tick */
+static int caso_malos(int desde, int hasta)
+{
+    int i, malos = 0;
+
+    for (i = desde; i < hasta; i++) {
+        malos += caso_disparos[i] != 1 || caso_tick[i] != caso_vence[i];
+    }
+    return malos;
+}
+
+static int temp_casos(void)
+{
+    static const clock_time_t intervalos[N_CASO] = {
+        63, 64, 4095,                       /* bordes de los niveles 0 y 1 */
+        4096, 70000,                        /* nivel 2, bajan dos veces */
+        CASO_RANGO - 1, CASO_RANGO + 1000,  /* al borde y mas alla de la */
+        3 * CASO_RANGO,                     /* rueda: esperan en el tope */
+    };
+    int i, malos = 0;
+
+    /* Los del periodico siguen en la rueda */
+    for (i = 0; i < N_TEMP; i++) {
+        ptsched_timer_stop(&temp_rueda[i]);
+    }
+    memset(caso_temp, 0, sizeof(caso_temp));
+    for (i = 0; i < N_CASO; i++) {
+        ptsched_task_init(&caso_tarea[i], tarea_caso, NULL);
+    }
+
+    /* Intervalos de todos los niveles y mas largos que la rueda, desde un
+     * tick que no cae en el borde de ningun casillero */
+    reloj = 12345;
+    ptsched_init();
+    for (i = 0; i < N_CASO; i++) {
+        caso_armar(i, intervalos[i]);
+    }
+    caso_avanzar(3 * CASO_RANGO + 1);
+    malos += caso_malos(0, N_CASO);
+
+    /* Parar temporizadores pendientes, en los niveles 0 y 2: sus tareas no
+     * corren y el otro vence igual */
+    caso_armar(0, 100);
+    caso_armar(1, 100);
+    caso_armar(2, 5000);
+    caso_avanzar(50);
+    ptsched_timer_stop(&caso_temp[1]);
+    ptsched_timer_stop(&caso_temp[2]);
+    caso_avanzar(6000);
+    malos += caso_malos(0, 1) + (caso_disparos[1] != 0) + (caso_disparos[2] != 0);
+
+    /* Con la rueda vacia ptsched_run() saltea los ticks sin recorrerlos:
+     * despues de un millon de ticks de una vez los nuevos vencen bien */
+    reloj += 1000000;
+    ptsched_run();
+    caso_armar(0, 1);
+    caso_armar(1, 64);
+    caso_armar(2, 5000);
+    caso_avanzar(5000);
+    malos += caso_malos(0, 3);
+
+    /* La vuelta del reloj: vencimientos antes, justo en y despues del 0 */
+    reloj = (clock_time_t)-3000;
+    ptsched_run();
+    caso_armar(0, 50);
+    caso_armar(1, 3000);
+    caso_armar(2, 3001);
+    caso_armar(3, 5000);
+    caso_armar(4, 70000);
+    caso_avanzar(70000);
+    malos += caso_malos(0, 5);
+
+    return malos;
+}
+
+/* Cada uno vencio tantas veces como entra su intervalo en N_TICKS, y cada
+ * vez en su tick */
+static int temp_verificar(void)
+{
+    uint32_t esperados = 0;
+    int i;
+
+    for (i = 0; i < N_TEMP; i++) {
+        esperados += N_TICKS / TEMP_INTERVALO(i);
+    }
+    return disparos != esperados || temp_malos != 0 || temp_casos() != 0;
+}
+
+/* --- USB Mass Storage --------------------------------------------------- */
+
+/* El ejemplo USBDEV/USBMassStorage con su disco de 8 KB en RAM, y el host del
+ * simulador del otro lado: un READ(10) y un WRITE(10) del disco entero, con
+ * su CBW y su CSW, a full speed. El firmware atiende la interrupcion USB en
+ * el hilo principal (dormido en __WFI con PRIMASK en 1) para que se cuenten
+ * sus instrucciones: las de un handler que despacha el simulador no se
+ * cuentan. Los ciclos son los del bus; lo que cambia con el DMA son las
+ * instrucciones y los accesos por byte. */
+#define N_MSC           MSC_MemorySize
+#define MSC_EP          2
+#define CBW_LEN         31
+#define CSW_LEN         13
+#define SCSI_READ10     0x28
+#define SCSI_WRITE10    0x2A
+
+extern uint8_t Memory[MSC_MemorySize];
+
+static struct {
+    int conectado;
+    uint32_t tag;
+    uint8_t cbw[CBW_LEN];
+    uint8_t csw[CSW_LEN];
+    uint8_t datos[N_MSC];
+    uint32_t movidos, csw_len;
+} msc;
+
+static void le32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t rd_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void usb_atender(void)
+{
+    while (!sim_usb_listo()) {
+        __WFI();
+        NVIC_ClearPendingIRQ(USB_IRQn);
+        USB_IRQHandler();
+    }
+}
+
+/* Conecta y configura el device la primera vez, como lo haria el host */
+static void msc_preparar(void)
+{
+    static const uint8_t set_config[8] = { 0x00, 0x09, 0x01, 0x00, 0, 0, 0, 0 };
+
+    __disable_irq();
+    if (!msc.conectado) {
+        USB_Init();
+        USB_Connect(TRUE);
+        sim_usb_reset();
+        sim_usb_setup(set_config);
+        sim_usb_in(0, NULL, 0, NULL);
+        usb_atender();
+        msc.conectado = 1;
+    }
+    msc.movidos = 0;
+    msc.csw_len = 0;
+    memset(msc.csw, 0, sizeof(msc.csw));
+}
+
+static void msc_cbw(uint8_t op, uint8_t flags)
+{
+    uint8_t *cb = msc.cbw + 15;
+
+    memset(msc.cbw, 0, sizeof(msc.cbw));
+    le32(msc.cbw, MSC_CBW_Signature);
+    le32(msc.cbw + 4, ++msc.tag);
+    le32(msc.cbw + 8, N_MSC);
+    msc.cbw[12] = flags;
+    msc.cbw[14] = 10;
+    cb[0] = op;
+    cb[7] = (N_MSC / MSC_BlockSize) >> 8;
+    cb[8] = (N_MSC / MSC_BlockSize) & 0xFF;
+}
+
+static void msc_read_preparar(void)
+{
+    msc_preparar();
+    patron(Memory, N_MSC, 9);
+    memset(msc.datos, 0, sizeof(msc.datos));
+    msc_cbw(SCSI_READ10, 0x80);
+}
+
+static void msc_write_preparar(void)
+{
+    msc_preparar();
+    memset(Memory, 0, N_MSC);
+    patron(msc.datos, N_MSC, 11);
+    msc_cbw(SCSI_WRITE10, 0x00);
+}
+
+static void msc_read_correr(void)
+{
+    sim_usb_out(MSC_EP, msc.cbw, CBW_LEN, NULL);
+    sim_usb_in(MSC_EP, msc.datos, N_MSC, &msc.movidos);
+    sim_usb_in(MSC_EP, msc.csw, CSW_LEN, &msc.csw_len);
+    usb_atender();
+}
+
+static void msc_write_correr(void)
+{
+    sim_usb_out(MSC_EP, msc.cbw, CBW_LEN, NULL);
+    sim_usb_out(MSC_EP, msc.datos, N_MSC, &msc.movidos);
+    sim_usb_in(MSC_EP, msc.csw, CSW_LEN, &msc.csw_len);
+    usb_atender();
+}
+
+/* Los datos enteros en los dos lados y un CSW de comando bien terminado */
+static int msc_verificar(void)
+{
+    int error = msc.movidos != N_MSC || memcmp(Memory, msc.datos, N_MSC) != 0
+                || msc.csw_len != CSW_LEN
+                || rd_le32(msc.csw) != MSC_CSW_Signature
+                || rd_le32(msc.csw + 4) != msc.tag
+                || rd_le32(msc.csw + 8) != 0 || msc.csw[12] != 0
+                || sim_usb_stalls() != 0;
+
+    __enable_irq();
+    return error;
+}
+
+/* --- USB Mass Storage sobre una tarjeta SD ------------------------------- */
+
+/* El mismo device con el disco en una tarjeta SD de 64 MB (sim/sim_sd.c,
+ * SDHC, en un archivo temporal) colgada de la SSP0, con el driver sdspi.c
+ * del ejemplo SPI/SDCard (un CMD18, o ACMD23 y CMD25, por comando SCSI,
+ * alimentado de a un bloque con SDSPI_ReadNext/WriteNext, con CRC). Aca la
+ * interrupcion USB es de verdad y el hilo principal corre MSC_SDTask, como
+ * el main del ejemplo: se mide de punta a punta, asi que los ciclos por
+ * byte son el throughput (MB/s = MHz / ciclos por byte) y las
+ * instrucciones son las del hilo principal, que espera la tarjeta por
+ * polling. Secuencial: un READ(10) o WRITE(10) de 32 KB. Al azar: 8
+ * comandos de 4 KB seguidos, en lugares al azar del disco. */
+#define SD_BLOQUES      131072u
+#define N_SD            32768
+#define N_SD_CMDS       8
+#define N_SD_4K         4096
+
+static struct {
+    int fd;
+    uint32_t cmds, len;             /* comandos y bytes por comando */
+    uint32_t lba[N_SD_CMDS];
+    uint32_t tag[N_SD_CMDS];
+    uint8_t cbw[N_SD_CMDS][CBW_LEN];
+    uint8_t csw[N_SD_CMDS][CSW_LEN];
+    uint32_t movidos[N_SD_CMDS], csw_len[N_SD_CMDS];
+    uint8_t datos[N_SD];
+    uint8_t disco[N_SD];            /* lo que quedo en el archivo */
+} msd = { .fd = -1 };
+
+/* La tarjeta y el device, la primera vez; despues cada comando */
+static void msd_preparar(uint8_t op, uint32_t cmds, uint32_t len)
+{
+    static uint32_t azar = 12345;
+    SDSPI_CFG_Type cfg;
+    uint32_t i;
+
+    msc_preparar();
+    if (msd.fd < 0) {
+        char nombre[] = "/tmp/bench_sd_XXXXXX";
+
+        msd.fd = mkstemp(nombre);
+        if (msd.fd < 0 || sim_sd_tarjeta(0, 0, 16, nombre, SD_BLOQUES, 1) != 0) {
+            perror("tarjeta SD");
+            exit(2);
+        }
+        unlink(nombre);
+        cfg.SSPx = LPC_SSP0;
+        cfg.CSPortNum = 0;
+        cfg.CSPinNum = 16;
+        cfg.ClockRate = 0;
+        cfg.DMA = DISABLE;
+        if (SDSPI_Init(&MSC_Card, &cfg) != SDSPI_OK
+            || SDSPI_GetBlockCount(&MSC_Card) != SD_BLOQUES) {
+            fprintf(stderr, "SDSPI_Init no reconocio la tarjeta\n");
+            exit(2);
+        }
+        MSC_SDCard = TRUE;
+        MSC_BlockCount = SDSPI_GetBlockCount(&MSC_Card);
+    }
+
+    msd.cmds = cmds;
+    msd.len = len;
+    for (i = 0; i < cmds; i++) {
+        uint8_t *cbw = msd.cbw[i];
+        uint32_t bloques = len / MSC_BlockSize;
+
+        if (cmds == 1) {
+            msd.lba[i] = 2048;
+        } else {
+            azar = azar * 1103515245u + 12345u;
+            msd.lba[i] = ((azar >> 8) % (SD_BLOQUES / bloques)) * bloques;
+        }
+        msd.tag[i] = ++msc.tag;
+        memset(cbw, 0, CBW_LEN);
+        le32(cbw, MSC_CBW_Signature);
+        le32(cbw + 4, msd.tag[i]);
+        le32(cbw + 8, len);
+        cbw[12] = op == SCSI_READ10 ? 0x80 : 0x00;
+        cbw[14] = 10;
+        cbw[15] = op;
+        cbw[17] = (uint8_t)(msd.lba[i] >> 24);
+        cbw[18] = (uint8_t)(msd.lba[i] >> 16);
+        cbw[19] = (uint8_t)(msd.lba[i] >> 8);
+        cbw[20] = (uint8_t)msd.lba[i];
+        cbw[22] = (uint8_t)(bloques >> 8);
+        cbw[23] = (uint8_t)bloques;
+        msd.movidos[i] = 0;
+        msd.csw_len[i] = 0;
+        memset(msd.csw[i], 0, CSW_LEN);
+
+        /* Lo que hay en la tarjeta antes: el patron para leer, 0 para escribir */
+        if (op == SCSI_READ10) {
+            patron(msd.disco + i * len, len, (uint8_t)(13 + i));
+        } else {
+            memset(msd.disco + i * len, 0, len);
+        }
+        if (pwrite(msd.fd, msd.disco + i * len, len,
+                   (off_t)msd.lba[i] * MSC_BlockSize) != (ssize_t)len) {
+            perror("tarjeta SD");
+            exit(2);
+        }
+    }
+    if (op == SCSI_READ10) {
+        memset(msd.datos, 0, sizeof(msd.datos));
+    } else {
+        patron(msd.datos, cmds * len, 17);
+    }
+    __enable_irq();
+}
+
+static void msd_read_preparar(void)
+{
+    msd_preparar(SCSI_READ10, 1, N_SD);
+}
+
+static void msd_write_preparar(void)
+{
+    msd_preparar(SCSI_WRITE10, 1, N_SD);
+}
+
+static void msd_read4k_preparar(void)
+{
+    msd_preparar(SCSI_READ10, N_SD_CMDS, N_SD_4K);
+}
+
+static void msd_write4k_preparar(void)
+{
+    msd_preparar(SCSI_WRITE10, N_SD_CMDS, N_SD_4K);
+}
+
+static void msd_correr(int leer)
+{
+    uint32_t i;
+
+    for (i = 0; i < msd.cmds; i++) {
+        uint8_t *datos = msd.datos + i * msd.len;
+
+        sim_usb_out(MSC_EP, msd.cbw[i], CBW_LEN, NULL);
+        if (leer) {
+            sim_usb_in(MSC_EP, datos, msd.len, &msd.movidos[i]);
+        } else {
+            sim_usb_out(MSC_EP, datos, msd.len, &msd.movidos[i]);
+        }
+        sim_usb_in(MSC_EP, msd.csw[i], CSW_LEN, &msd.csw_len[i]);
+    }
+    /* El lazo del main del ejemplo, que ademas termina cuando el host
+     * termino: las dos cosas se miran con PRIMASK en 1 antes de dormir */
+    for (;;) {
+        __disable_irq();
+        if (sim_usb_listo()) {
+            break;
+        }
+        if (!MSC_SDPending()) {
+            __WFI();
+        }
+        __enable_irq();
+        MSC_SDTask();
+    }
+    __enable_irq();
+}
+
+static void msd_read_correr(void)
+{
+    msd_correr(1);
+}
+
+static void msd_write_correr(void)
+{
+    msd_correr(0);
+}
+
+/* Cada comando con sus datos enteros y su CSW, y el archivo igual a lo que
+ * paso por el USB */
+static int msd_verificar(void)
+{
+    int error = sim_usb_stalls() != 0 || sim_sd_errores_crc() != 0;
+    uint32_t i;
+
+    for (i = 0; i < msd.cmds; i++) {
+        const uint8_t *csw = msd.csw[i];
+
+        if (pread(msd.fd, msd.disco + i * msd.len, msd.len,
+                  (off_t)msd.lba[i] * MSC_BlockSize) != (ssize_t)msd.len) {
+            error = 1;
+        }
+        error |= msd.movidos[i] != msd.len || msd.csw_len[i] != CSW_LEN
+                 || rd_le32(csw) != MSC_CSW_Signature
+                 || rd_le32(csw + 4) != msd.tag[i]
+                 || rd_le32(csw + 8) != 0 || csw[12] != 0;
+    }
+    error |= memcmp(msd.disco, msd.datos, msd.cmds * msd.len) != 0;
+    return error;
+}
+
+/* --- Driver de bloques SD/SDHC del ejemplo SPI/SDCard ------------------- */
+
+/* sdspi.c contra otra tarjeta del modelo: SDSC de 32 MB (direcciones en
+ * bytes) en la SSP1, con el chip select en P0.6. El driver la identifica a
+ * 400 kHz, prende el CRC (CMD59) y sube a 25 MHz. Se leen 32 KB con un
+ * CMD18 y se escriben con ACMD23 + CMD25 (mas la espera de la ultima
+ * programacion), con los bloques por GPDMA y por polling. A 25 MHz el bus
+ * da 32 ciclos por byte: con DMA la lectura queda cerca, porque el CRC16
+ * de cada bloque se calcula mientras llega el siguiente, y la escritura la
+ * limita la tarjeta (SD_PROGRAMAR_US por bloque). Las instrucciones de la
+ * version con DMA son las de la espera por polling del fin del bloque. */
+#define SDSPI_BLOQUES   65536u
+#define SDSPI_LBA       1000u
+#define N_SDSPI         32768
+
+static struct {
+    int fd;
+    SDSPI_CARD_Type tarjeta;
+    SDSPI_Status ret;
+    uint8_t datos[N_SDSPI];
+    uint8_t disco[N_SDSPI];         /* lo que hay en el archivo */
+} sds = { .fd = -1 };
+
+/* Un patron distinto en cada bloque, para ver tambien que no se mezclen */
+static void sds_patron(uint8_t *p, uint8_t semilla)
+{
+    uint32_t i;
+
+    patron(p, N_SDSPI, semilla);
+    for (i = 0; i < N_SDSPI / SDSPI_BLOCK_SIZE; i++) {
+        p[i * SDSPI_BLOCK_SIZE] = (uint8_t)i;
+    }
+}
+
+/* La tarjeta la primera vez y el driver en cada benchmark, con o sin DMA */
+static void sds_preparar(FunctionalState dma, int leer)
+{
+    SDSPI_CFG_Type cfg;
+
+    if (sds.fd < 0) {
+        char nombre[] = "/tmp/bench_sdspi_XXXXXX";
+
+        sds.fd = mkstemp(nombre);
+        if (sds.fd < 0 || sim_sd_tarjeta(1, 0, 6, nombre, SDSPI_BLOQUES, 0) != 0) {
+            perror("tarjeta SD");
+            exit(2);
+        }
+        unlink(nombre);
+        GPDMA_Init();
+    }
+    if (sds.tarjeta.Type != SDSPI_TYPE_NONE) {
+        SDSPI_DeInit(&sds.tarjeta);
+    }
+    cfg.SSPx = LPC_SSP1;
+    cfg.CSPortNum = 0;
+    cfg.CSPinNum = 6;
+    cfg.ClockRate = 0;
+    cfg.DMA = dma;
+    if (SDSPI_Init(&sds.tarjeta, &cfg) != SDSPI_OK
+        || sds.tarjeta.Type != SDSPI_TYPE_SDV2
+        || SDSPI_GetBlockCount(&sds.tarjeta) != SDSPI_BLOQUES) {
+        fprintf(stderr, "SDSPI_Init no reconocio la tarjeta\n");
+        exit(2);
+    }
+
+    /* Lo que hay en la tarjeta antes: el patron para leer, 0 para escribir */
+    if (leer) {
+        sds_patron(sds.disco, 31);
+        memset(sds.datos, 0, sizeof(sds.datos));
+    } else {
+        memset(sds.disco, 0, sizeof(sds.disco));
+        sds_patron(sds.datos, 37);
+    }
+    if (pwrite(sds.fd, sds.disco, N_SDSPI,
+               (off_t)SDSPI_LBA * SDSPI_BLOCK_SIZE) != N_SDSPI) {
+        perror("tarjeta SD");
+        exit(2);
+    }
+    sds.ret = SDSPI_ERROR_PARAM;
+}
+
+static void sds_read_dma_preparar(void)
+{
+    sds_preparar(ENABLE, 1);
+}
+
+static void sds_write_dma_preparar(void)
+{
+    sds_preparar(ENABLE, 0);
+}
+
+static void sds_read_polling_preparar(void)
+{
+    sds_preparar(DISABLE, 1);
+}
+
+static void sds_write_polling_preparar(void)
+{
+    sds_preparar(DISABLE, 0);
+}
+
+static void sds_read_correr(void)
+{
+    sds.ret = SDSPI_ReadBlocks(&sds.tarjeta, SDSPI_LBA, sds.datos,
+                               N_SDSPI / SDSPI_BLOCK_SIZE);
+}
+
+static void sds_write_correr(void)
+{
+    sds.ret = SDSPI_WriteBlocks(&sds.tarjeta, SDSPI_LBA, sds.datos,
+                                N_SDSPI / SDSPI_BLOCK_SIZE);
+    if (sds.ret == SDSPI_OK) {
+        sds.ret = SDSPI_Sync(&sds.tarjeta);
+    }
+}
+
+/* Sin errores, ni de CRC en la tarjeta, y el archivo igual a los datos */
+static int sds_verificar(void)
+{
+    int error = sds.ret != SDSPI_OK || sim_sd_errores_crc() != 0;
+
+    if (pread(sds.fd, sds.disco, N_SDSPI,
+              (off_t)SDSPI_LBA * SDSPI_BLOCK_SIZE) != N_SDSPI) {
+        error = 1;
+    }
+    return error || memcmp(sds.disco, sds.datos, N_SDSPI) != 0;
+}
+
+static const bench_t benchs[] = {
+    { "gpio_setvalue",   "llamada", N_GPIO,    gpio_preparar, gpio_correr, gpio_verificar },
+    { "uart_send",       "byte",    N_UART,    uart_preparar, uart_correr, uart_verificar },
+    { "uart_ring",       "byte",    N_UART_RING,
+      uring_preparar, uring_correr, uring_verificar },
+    { "ssp_readwrite",   "byte",    N_SSP,     ssp_preparar,  ssp_correr,  ssp_verificar },
+    { "i2c_master",      "byte",    1 + N_I2C, i2c_preparar,  i2c_correr,  i2c_verificar },
+    { "emac_readpacket", "byte",    N_TRAMAS * LEN_TRAMA,
+      emac_preparar, emac_correr, emac_verificar },
+    { "emac_borrowrx",   "byte",    N_TRAMAS * LEN_TRAMA,
+      emac_preparar, emac_prestada_correr, emac_prestada_verificar },
+    { "crc32_bit_a_bit", "byte",    LEN_TRAMA,
+      crc_preparar, crc_bit_a_bit_correr, crc_bit_a_bit_verificar },
+    { "emac_crc32",      "byte",    LEN_TRAMA,
+      crc_preparar, crc_correr, crc_verificar },
+    { "chksum_uip",      "byte",    N_IP,
+      ip_preparar, chksum_uip_correr, chksum_uip_verificar },
+    { "chksum_arch",     "byte",    N_IP,
+      ip_preparar, chksum_arch_correr, chksum_arch_verificar },
+    { "uip_input_40",    "segmento", N_SEGMENTOS,
+      uip_preparar, uip_correr, uip_verificar },
+    { "arp_out_48",      "paquete", N_PAQUETES,
+      arp_preparar, arp_correr, arp_verificar },
+    { "tcp_archivo",     "byte",    N_ARCHIVO,
+      tcp_preparar, tcp_correr, tcp_verificar },
+    { "tcp_archivo_perdida", "byte", N_ARCHIVO,
+      tcp_perdida_preparar, tcp_correr, tcp_perdida_verificar },
+    { "easyweb_ack",     "segmento", N_EW_ACKS,
+      ew_preparar, ew_ack_correr, ew_ack_verificar },
+    { "easyweb_rexmit",  "segmento", N_EW_REXMIT,
+      ew_rexmit_preparar, ew_rexmit_correr, ew_rexmit_verificar },
+    { "easyweb_cambios", "segmento", N_EW_CAMBIOS,
+      ew_cambios_preparar, ew_cambios_correr, ew_cambios_verificar },
+    { "telemetria_uip",  "paquete", N_TEL,
+      tel_preparar, tel_uip_correr, tel_verificar },
+    { "telemetria_directa", "paquete", N_TEL,
+      tel_preparar, tel_directa_correr, tel_verificar },
+    { "temporizadores_lineal", "tick", N_TICKS,
+      temp_lineal_preparar, temp_lineal_correr, temp_verificar },
+    { "temporizadores_rueda", "tick", N_TICKS,
+      temp_rueda_preparar, temp_rueda_correr, temp_verificar },
+    { "usb_msc_read10",  "byte",    N_MSC,
+      msc_read_preparar, msc_read_correr, msc_verificar },
+    { "usb_msc_write10", "byte",    N_MSC,
+      msc_write_preparar, msc_write_correr, msc_verificar },
+    { "usb_msc_sd_read",  "byte",   N_SD,
+      msd_read_preparar, msd_read_correr, msd_verificar },
+    { "usb_msc_sd_write", "byte",   N_SD,
+      msd_write_preparar, msd_write_correr, msd_verificar },
+    { "usb_msc_sd_read4k", "byte",  N_SD_CMDS * N_SD_4K,
+      msd_read4k_preparar, msd_read_correr, msd_verificar },
+    { "usb_msc_sd_write4k", "byte", N_SD_CMDS * N_SD_4K,
+      msd_write4k_preparar, msd_write_correr, msd_verificar },
+    { "sdspi_read_dma",  "byte",    N_SDSPI,
+      sds_read_dma_preparar, sds_read_correr, sds_verificar },
+    { "sdspi_write_dma", "byte",    N_SDSPI,
+      sds_write_dma_preparar, sds_write_correr, sds_verificar },
+    { "sdspi_read_polling", "byte", N_SDSPI,
+      sds_read_polling_preparar, sds_read_correr, sds_verificar },
+    { "sdspi_write_polling", "byte", N_SDSPI,
+      sds_write_polling_preparar, sds_write_correr, sds_verificar },
+};
+#define NUM_BENCHS      (sizeof(benchs) / sizeof(benchs[0]))
+
+int main(void)
+{
+    return bench_correr(benchs, NUM_BENCHS);
+}
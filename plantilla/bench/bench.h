@@ -0,0 +1,31 @@
+/* ============================================================================
+ * bench.h - Lo que comparten los binarios de "make bench"
+ * ============================================================================
+ *
+ * Cada binario (bench/bench.c, bench/cdc/bench_cdc.c y
+ * bench/audio/bench_audio.c) arma su tabla de benchmarks y se la pasa a
+ * bench_correr(), de bench/medicion.c, que los mide uno por uno y escribe
+ * el reporte. Hay mas de un binario porque los
+ * ejemplos USB traen cada uno su propio stack, con las mismas funciones.
+ * ========================================================================= */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+
+typedef struct {
+    const char *nombre;
+    const char *unidad;
+    uint32_t n;                 /* unidades por corrida */
+    void (*preparar)(void);
+    void (*correr)(void);       /* lo que se mide */
+    int (*verificar)(void);     /* 0 si los datos salieron bien */
+} bench_t;
+
+/* Corre los "n" benchmarks en orden y escribe el reporte en JSON a
+ * BENCH_OUT (o a stdout si no esta) y la tabla a stdout. Devuelve lo que
+ * tiene que devolver main: 1 si alguno no verifico, 2 si no pudo escribir */
+int bench_correr(const bench_t *benchs, unsigned n);
+
+#endif /* BENCH_H */
@@ -0,0 +1,222 @@
+/* ============================================================================
+ * bench_cdc.c - Throughput del ejemplo USB Virtual COM (USBDEV/USBCDC)
+ * ============================================================================
+ *
+ * El segundo binario de "make bench": el ejemplo USBCDC trae su propio stack
+ * USB (las mismas funciones que el de Mass Storage), asi que va aparte. Mide
+ * igual que bench.c (ver ahi) y deja su reporte en BENCH_OUT.
+ *
+ * El device con el puerto serie en la UART1 a 1.5625 Mbaud 8N1 (el divisor
+ * mas chico con PCLK = CCLK/4: 640 ciclos por byte) y el host del simulador
+ * del otro lado del USB, a full speed. La UART es el cuello de botella, asi
+ * que los ciclos por byte son cerca de 640 en las dos direcciones; lo que se
+ * compara son las instrucciones y los accesos por byte. Las interrupciones
+ * (USB, GPDMA y UART1) las atiende el hilo principal, dormido en __WFI con
+ * PRIMASK en 1, para que se cuenten sus instrucciones:
+ *
+ *   usb_cdc_out     16 KB del host a la UART1
+ *   usb_cdc_in      16 KB de la UART1 al host
+ *   usb_cdc_in_rts  lo mismo, pero el host empieza a leer cuando los
+ *                   buffers ya se llenaron y auto-RTS esta frenando al otro
+ *                   lado: no se tiene que perder nada
+ *
+ * El host no hace OUT e IN a la vez (su cola es en orden), asi que no hay
+ * una corrida full duplex.
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "LPC17xx.h"
+#include "bench.h"
+#include "sim.h"
+#include "usb.h"
+#include "usbcfg.h"
+#include "usbhw.h"
+#include "usbcore.h"
+#include "cdc.h"
+#include "cdcuser.h"
+#include "serial.h"
+
+#define N_CDC           16384
+#define CDC_EP          2
+#define CDC_UART        1
+#define CDC_BAUD        1562500u
+
+/* Los handlers del ejemplo */
+void USB_IRQHandler(void);
+void DMA_IRQHandler(void);
+void UART1_IRQHandler(void);
+
+static struct {
+    int conectado;
+    int fd;                         /* lo que sale por la UART1 */
+    uint32_t enviados0;             /* sim_uart_enviados() al empezar */
+    uint32_t recibidos;
+    uint8_t datos[N_CDC];
+    uint8_t salida[N_CDC];
+} cdc = { .fd = -1 };
+
+static void patron(uint8_t *p, uint32_t n, uint8_t semilla)
+{
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+        p[i] = (uint8_t)(semilla + i * 7u);
+    }
+}
+
+static void atender(IRQn_Type irq, void (*handler)(void))
+{
+    if (NVIC_GetPendingIRQ(irq)) {
+        NVIC_ClearPendingIRQ(irq);
+        handler();
+    }
+}
+
+/* Duerme hasta la proxima interrupcion y la atiende en el hilo principal */
+static void cdc_dormir(void)
+{
+    __WFI();
+    atender(DMA_IRQn, DMA_IRQHandler);
+    atender(USB_IRQn, USB_IRQHandler);
+    atender(UART1_IRQn, UART1_IRQHandler);
+}
+
+static void cdc_host(void)
+{
+    while (!sim_usb_listo()) {
+        cdc_dormir();
+    }
+}
+
+/* Conecta y configura el device la primera vez, y le pone el baudrate con
+ * SET_LINE_CODING, como lo haria el host */
+static void cdc_preparar(void)
+{
+    static const uint8_t set_config[8] = { 0x00, 0x09, 0x01, 0x00, 0, 0, 0, 0 };
+    static const uint8_t set_line_coding[8] = { 0x21, 0x20, 0, 0, 0, 0, 7, 0 };
+    static const uint8_t coding[7] = {
+        (uint8_t)CDC_BAUD, (uint8_t)(CDC_BAUD >> 8), (uint8_t)(CDC_BAUD >> 16),
+        (uint8_t)(CDC_BAUD >> 24), 0, 0, 8
+    };
+
+    __disable_irq();
+    if (!cdc.conectado) {
+        char nombre[] = "/tmp/bench_cdc_XXXXXX";
+
+        cdc.fd = mkstemp(nombre);
+        if (cdc.fd < 0) {
+            perror("salida de la UART1");
+            exit(2);
+        }
+        unlink(nombre);
+        sim_uart_salida(CDC_UART, cdc.fd);
+
+        CDC_Init(CDC_UART);
+        USB_Init();
+        USB_Connect(TRUE);
+        sim_usb_reset();
+        sim_usb_setup(set_config);
+        sim_usb_in(0, NULL, 0, NULL);
+        sim_usb_setup(set_line_coding);
+        sim_usb_out(0, coding, sizeof(coding), NULL);
+        sim_usb_in(0, NULL, 0, NULL);
+        cdc_host();
+        cdc.conectado = 1;
+    }
+    if (ftruncate(cdc.fd, 0) != 0 || lseek(cdc.fd, 0, SEEK_SET) != 0) {
+        perror("salida de la UART1");
+        exit(2);
+    }
+    cdc.enviados0 = sim_uart_enviados(CDC_UART);
+    cdc.recibidos = 0;
+    memset(cdc.salida, 0, sizeof(cdc.salida));
+}
+
+static void cdc_out_preparar(void)
+{
+    cdc_preparar();
+    patron(cdc.datos, N_CDC, 21);
+}
+
+static void cdc_in_preparar(void)
+{
+    cdc_preparar();
+    patron(cdc.datos, N_CDC, 23);
+}
+
+/* Los bytes llegan a la UART1 mientras nadie los lee del lado USB: los
+ * buffers se llenan y auto-RTS frena al otro lado */
+static void cdc_in_rts_preparar(void)
+{
+    uint64_t fin;
+
+    cdc_in_preparar();
+    sim_uart_inyectar(CDC_UART, cdc.datos, N_CDC);
+    fin = sim_ciclos() + (uint64_t)(CDC_IN_PKTS + 8) * USB_CDC_BUFSIZE * 640u;
+    while (sim_ciclos() < fin) {
+        cdc_dormir();
+    }
+}
+
+static void cdc_out_correr(void)
+{
+    sim_usb_out(CDC_EP, cdc.datos, N_CDC, NULL);
+    while (!sim_usb_listo() || sim_uart_enviados(CDC_UART) - cdc.enviados0 < N_CDC) {
+        cdc_dormir();
+    }
+}
+
+/* El host lee hasta tener todo: cada paquete corto (lo que mando un SOF)
+ * termina una lectura y empieza otra */
+static void cdc_in_leer(void)
+{
+    while (cdc.recibidos < N_CDC) {
+        uint32_t movidos = 0;
+
+        sim_usb_in(CDC_EP, cdc.salida + cdc.recibidos, N_CDC - cdc.recibidos, &movidos);
+        cdc_host();
+        cdc.recibidos += movidos;
+    }
+}
+
+static void cdc_in_correr(void)
+{
+    sim_uart_inyectar(CDC_UART, cdc.datos, N_CDC);
+    cdc_in_leer();
+}
+
+static int cdc_out_verificar(void)
+{
+    int error = sim_usb_stalls() != 0
+                || pread(cdc.fd, cdc.salida, N_CDC, 0) != N_CDC
+                || memcmp(cdc.salida, cdc.datos, N_CDC) != 0;
+
+    __enable_irq();
+    return error;
+}
+
+static int cdc_in_verificar(void)
+{
+    int error = sim_usb_stalls() != 0 || sim_uart_perdidos(CDC_UART) != 0
+                || cdc.recibidos != N_CDC
+                || memcmp(cdc.salida, cdc.datos, N_CDC) != 0;
+
+    __enable_irq();
+    return error;
+}
+
+static const bench_t benchs[] = {
+    { "usb_cdc_out",    "byte", N_CDC, cdc_out_preparar, cdc_out_correr, cdc_out_verificar },
+    { "usb_cdc_in",     "byte", N_CDC, cdc_in_preparar, cdc_in_correr, cdc_in_verificar },
+    { "usb_cdc_in_rts", "byte", N_CDC, cdc_in_rts_preparar, cdc_in_leer, cdc_in_verificar },
+};
+#define NUM_BENCHS      (sizeof(benchs) / sizeof(benchs[0]))
+
+int main(void)
+{
+    return bench_correr(benchs, NUM_BENCHS);
+}
@@ -0,0 +1,11 @@
+/* ============================================================================
+ * easyweb_globales.c - Las variables del stack de Easy_Web, para el bench
+ * ============================================================================
+ *
+ * tcpip.h solo las declara. En el ejemplo las define easyweb.c haciendo
+ * "#define extern" antes de incluirlo; aca se hace lo mismo, sin el
+ * servidor HTTP.
+ * ========================================================================= */
+
+#define extern
+#include "tcpip.h"
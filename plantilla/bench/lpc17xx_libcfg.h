@@ -0,0 +1,10 @@
+/* ============================================================================
+ * lpc17xx_libcfg.h - La configuracion de los drivers que trae cada ejemplo
+ * ============================================================================
+ *
+ * Los ejemplos de library/examples (Easy_Web) incluyen este header, que el
+ * proyecto de Keil o IAR pone en su carpeta. Para el bench alcanza con los
+ * valores por defecto de los drivers.
+ * ========================================================================= */
+
+#include "lpc17xx_libcfg_default.h"
@@ -0,0 +1,136 @@
+/* ============================================================================
+ * medicion.c - Medicion y reporte de "make bench"
+ * ============================================================================
+ *
+ * Ver bench.c: que se mide y como se lee el reporte.
+ * ========================================================================= */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "sim.h"
+
+typedef struct {
+    uint64_t ciclos;
+    uint64_t instrucciones;
+    uint64_t accesos;
+    int error;
+} medida_t;
+
+static void nada(void)
+{
+}
+
+static medida_t medir(void (*fn)(void))
+{
+    medida_t m;
+    uint64_t c0 = sim_ciclos();
+    uint64_t i0 = sim_instrucciones();
+    uint64_t a0 = sim_accesos();
+
+    sim_contar_instrucciones(1);
+    fn();
+    sim_contar_instrucciones(0);
+
+    m.ciclos = sim_ciclos() - c0;
+    m.instrucciones = sim_instrucciones() - i0;
+    m.accesos = sim_accesos() - a0;
+    m.error = 0;
+    return m;
+}
+
+/* Lo que cuesta medir (prender y apagar el conteo, llamar a la funcion) */
+static void descontar(medida_t *m, const medida_t *vacio)
+{
+    m->ciclos -= m->ciclos > vacio->ciclos ? vacio->ciclos : m->ciclos;
+    m->instrucciones -= m->instrucciones > vacio->instrucciones ? vacio->instrucciones
+                                                                : m->instrucciones;
+    m->accesos -= m->accesos > vacio->accesos ? vacio->accesos : m->accesos;
+}
+
+static void reporte_json(FILE *f, const bench_t *benchs, unsigned n, const medida_t *m)
+{
+    unsigned i;
+
+    fprintf(f, "{\n");
+    fprintf(f, "  \"formato\": 1,\n");
+    fprintf(f, "  \"cclk_hz\": %u,\n", (unsigned)sim_frecuencia());
+    fprintf(f, "  \"ciclos_por_acceso\": %u,\n", (unsigned)SIM_CICLOS_ACCESO);
+    fprintf(f, "  \"benchmarks\": [\n");
+    for (i = 0; i < n; i++) {
+        const bench_t *b = &benchs[i];
+
+        fprintf(f, "    {\"nombre\": \"%s\", \"unidad\": \"%s\", \"n\": %u, "
+                   "\"ciclos\": %llu, \"instrucciones\": %llu, \"accesos\": %llu, "
+                   "\"ciclos_por_unidad\": %.2f, \"instrucciones_por_unidad\": %.2f, "
+                   "\"accesos_por_unidad\": %.2f, \"ok\": %s}%s\n",
+                b->nombre, b->unidad, (unsigned)b->n,
+                (unsigned long long)m[i].ciclos,
+                (unsigned long long)m[i].instrucciones,
+                (unsigned long long)m[i].accesos,
+                (double)m[i].ciclos / b->n,
+                (double)m[i].instrucciones / b->n,
+                (double)m[i].accesos / b->n,
+                m[i].error ? "false" : "true",
+                i + 1 < n ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static void reporte_tabla(const bench_t *benchs, unsigned n, const medida_t *m)
+{
+    unsigned i;
+
+    printf("%-18s %-8s %6s %12s %12s %10s\n",
+           "benchmark", "unidad", "n", "ciclos/u", "instr/u", "accesos/u");
+    for (i = 0; i < n; i++) {
+        const bench_t *b = &benchs[i];
+
+        printf("%-18s %-8s %6u %12.2f %12.2f %10.2f%s\n",
+               b->nombre, b->unidad, (unsigned)b->n,
+               (double)m[i].ciclos / b->n,
+               (double)m[i].instrucciones / b->n,
+               (double)m[i].accesos / b->n,
+               m[i].error ? "  ERROR" : "");
+    }
+}
+
+int bench_correr(const bench_t *benchs, unsigned n)
+{
+    medida_t *m = calloc(n, sizeof(*m));
+    medida_t vacio;
+    const char *salida = getenv("BENCH_OUT");
+    FILE *f = stdout;
+    int errores = 0;
+    unsigned i;
+
+    if (m == NULL) {
+        perror("bench");
+        return 2;
+    }
+    vacio = medir(nada);
+    for (i = 0; i < n; i++) {
+        benchs[i].preparar();
+        m[i] = medir(benchs[i].correr);
+        m[i].error = benchs[i].verificar();
+        descontar(&m[i], &vacio);
+        errores += m[i].error;
+    }
+
+    if (salida != NULL && *salida != '\0') {
+        f = fopen(salida, "w");
+        if (f == NULL) {
+            perror(salida);
+            free(m);
+            return 2;
+        }
+    }
+    reporte_json(f, benchs, n, m);
+    if (f != stdout) {
+        fclose(f);
+        reporte_tabla(benchs, n, m);
+    }
+    free(m);
+    return errores ? 1 : 0;
+}
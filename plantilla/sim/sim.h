@@ -0,0 +1,227 @@
+/* ============================================================================
+ * sim.h - Lo que el firmware (o un test) puede pedirle al simulador
+ * ============================================================================
+ *
+ * Con "make host" el firmware se compila para la PC y corre contra el
+ * simulador de sim/. Los registros siguen estando en las mismas direcciones
+ * que en el chip (0x4000C000 es la UART0, 0x2009C000 el GPIO...): el
+ * simulador mapea esas paginas sin permisos, atrapa cada acceso y se lo pasa
+ * al modelo del periferico. El firmware no se entera.
+ *
+ * Este header es solo para codigo que SABE que corre en la PC (tests,
+ * benchmarks): meter bytes en una UART, mover un pin de entrada, leer el
+ * reloj simulado. El firmware normal no lo necesita.
+ *
+ * El reloj es aproximado a ciclos: cada acceso a un registro cuesta
+ * SIM_CICLOS_ACCESO ciclos, entrar y salir de una interrupcion cuesta lo que
+ * en un Cortex-M3, y los perifericos (baudrate, timers, ADC) se mueven con
+ * ese reloj. El codigo C que no toca registros no consume ciclos, salvo que
+ * se pida con la variable de entorno SIM_ESCALA_HOST (ver README) o que se
+ * esten contando instrucciones (sim_contar_instrucciones).
+ * ========================================================================= */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Ciclos de CCLK que cuesta cada acceso del CPU a un registro */
+#ifndef SIM_CICLOS_ACCESO
+#define SIM_CICLOS_ACCESO   2
+#endif
+
+/* --- Reloj ----------------------------------------------------------------- */
+
+/* Ciclos de CPU simulados desde el arranque */
+uint64_t sim_ciclos(void);
+
+/* Accesos del CPU a registros de perifericos desde el arranque: cuantas
+ * veces el firmware toco el hardware (lo que no cambia con el host) */
+uint64_t sim_accesos(void);
+
+/* Cuenta, paso a paso, las instrucciones que ejecuta el firmware entre
+ * sim_contar_instrucciones(1) y (0). Son instrucciones de la PC (x86), no
+ * del Cortex-M3, pero siguen al codigo: si un driver hace el doble de
+ * trabajo por byte, el numero se duplica, y no depende de lo cargada que
+ * este la maquina. Mientras se cuenta, cada instruccion que no toca
+ * registros cuesta 1 ciclo. Lo que corre dentro de un handler de
+ * interrupcion no se cuenta, ni el tiempo dormido en __WFI. Es lento:
+ * ~1 us de la PC por instruccion. */
+void sim_contar_instrucciones(int activo);
+uint64_t sim_instrucciones(void);
+
+/* Frecuencia actual del core en Hz (la que dejo SystemInit) */
+uint32_t sim_frecuencia(void);
+
+/* Deja pasar tiempo simulado: los perifericos avanzan y las interrupciones
+ * se atienden, como si el CPU estuviera ocupado en otra cosa */
+void sim_esperar(uint64_t ciclos);
+
+/* --- UART ------------------------------------------------------------------ */
+
+/* Bytes que "llegan por el cable" a la UART n (0..3). Entran a la FIFO de
+ * recepcion al ritmo del baudrate configurado, uno por tiempo de caracter.
+ * En la UART1 con auto-RTS esperan mientras la FIFO esta en el nivel de
+ * disparo. */
+void sim_uart_inyectar(int n, const void *datos, uint32_t len);
+
+/* A donde van los bytes que transmite la UART n: un file descriptor abierto
+ * o -1 para descartarlos. Por defecto la UART0 va a stdout y las demas se
+ * descartan (o a SIM_UARTn_OUT, ver README). */
+void sim_uart_salida(int n, int fd);
+
+/* Bytes que termino de transmitir la UART n */
+uint32_t sim_uart_enviados(int n);
+
+/* Bytes que se perdieron porque la FIFO de recepcion estaba llena */
+uint32_t sim_uart_perdidos(int n);
+
+/* --- SSP ------------------------------------------------------------------- */
+
+/* Lo que contesta el dispositivo colgado de la SSP n (0..1): recibe la trama
+ * que salio por MOSI y devuelve la que vuelve por MISO. NULL (el default)
+ * devuelve lo mismo que salio. */
+typedef uint16_t (*sim_ssp_esclavo_t)(int n, uint16_t mosi);
+
+void sim_ssp_esclavo(int n, sim_ssp_esclavo_t fn);
+
+/* Tramas que termino de transferir la SSP n */
+uint32_t sim_ssp_tramas(int n);
+
+/* Una tarjeta SD en modo SPI (ver sim_sd.c) colgada de la SSP n, con el
+ * chip select en el pin "pin_cs" del puerto "puerto_cs" (activo en 0). Los
+ * bloques de 512 bytes estan en "archivo", que se crea o se agranda hasta
+ * "bloques" (0: el tamano que tiene); con NULL, en un archivo temporal.
+ * sdhc elige SDHC (direcciones en bloques) o SDSC (en bytes, hasta 2 GB).
+ * Devuelve 0, o -1 si no pudo abrir el archivo. */
+int sim_sd_tarjeta(int ssp, int puerto_cs, int pin_cs, const char *archivo,
+                   uint32_t bloques, int sdhc);
+
+/* Bloques que la tarjeta leyo y escribio en el archivo, y comandos o
+ * bloques que rechazo por CRC */
+uint32_t sim_sd_leidos(void);
+uint32_t sim_sd_escritos(void);
+uint32_t sim_sd_errores_crc(void);
+
+/* --- I2C ------------------------------------------------------------------- */
+
+/* Los 256 bytes de la memoria tipo 24xx (direccion 0x50) del bus n (0..2) */
+uint8_t *sim_i2c_memoria(int bus);
+
+/* Bytes (con su ACK/NACK) que paso el maestro del bus n, sin contar SLA */
+uint32_t sim_i2c_bytes(int bus);
+
+/* --- EMAC ------------------------------------------------------------------ */
+
+/* Una trama (sin preambulo ni FCS) que llega por el cable. Las tramas entran
+ * a los descriptores de recepcion de a una, en su tiempo de cable. */
+void sim_emac_recibir(const void *trama, uint32_t len);
+
+/* A donde van las tramas que transmite el EMAC (sin FCS); NULL las descarta */
+typedef void (*sim_emac_salida_t)(const uint8_t *trama, uint32_t len);
+
+void sim_emac_salida(sim_emac_salida_t fn);
+
+/* Tramas recibidas, perdidas (sin descriptores) y transmitidas */
+uint32_t sim_emac_recibidas(void);
+uint32_t sim_emac_perdidas(void);
+uint32_t sim_emac_enviadas(void);
+
+/* --- USB (device) ---------------------------------------------------------- */
+
+/* El host del otro lado del cable, a full speed. Lo que se le pide se encola
+ * y lo hace en orden y en tiempo simulado, paquete por paquete, reintentando
+ * si el dispositivo contesta NAK. Los buffers que se pasan tienen que seguir
+ * vivos hasta que sim_usb_listo() de 1; "movidos" (puede ser NULL) recibe
+ * los bytes que pasaron al terminar el pedido. */
+
+/* Reset del bus (10 ms): el firmware ve DEV_RST en el estado del device */
+void sim_usb_reset(void);
+
+/* Paquete SETUP de 8 bytes al endpoint 0 (se copia al encolarlo) */
+void sim_usb_setup(const void *paquete);
+
+/* Transferencia OUT al endpoint logico "ep": len bytes en paquetes del tamano
+ * maximo del endpoint, sin paquete vacio al final; len 0 manda uno vacio */
+void sim_usb_out(int ep, const void *datos, uint32_t len, uint32_t *movidos);
+
+/* Transferencia IN: hasta "max" bytes o hasta el primer paquete corto */
+void sim_usb_in(int ep, void *datos, uint32_t max, uint32_t *movidos);
+
+/* 1 cuando el host termino todo lo encolado */
+int sim_usb_listo(void);
+
+/* Paquetes de datos que pasaron, NAKs y STALLs que contesto el dispositivo */
+uint32_t sim_usb_paquetes(void);
+uint32_t sim_usb_naks(void);
+uint32_t sim_usb_stalls(void);
+
+/* Streams isocronos del host. En cada frame, despues del SOF, el host le
+ * pide a "fn" el paquete OUT para el endpoint logico "ep" (hasta "max"
+ * bytes; devuelve el largo, 0 si no manda nada en ese frame). NULL apaga el
+ * stream. */
+typedef uint32_t (*sim_usb_iso_out_t)(uint8_t *paquete, uint32_t max);
+
+void sim_usb_iso_out(int ep, sim_usb_iso_out_t fn);
+
+/* Lee el endpoint iso IN "ep" cada "cada" frames y le pasa a "fn" lo que
+ * vino (len 0 si el dispositivo no tenia nada). NULL apaga la lectura. */
+typedef void (*sim_usb_iso_in_t)(const uint8_t *paquete, uint32_t len);
+
+void sim_usb_iso_in(int ep, uint32_t cada, sim_usb_iso_in_t fn);
+
+/* Deriva del reloj del host en ppm: cada frame dura 1 ms * (1 + ppm / 1e6)
+ * de CCLK (0 al arrancar) */
+void sim_usb_deriva(int32_t ppm);
+
+/* Paquetes iso OUT que se perdieron porque el endpoint no tenia lugar */
+uint32_t sim_usb_iso_perdidos(void);
+
+/* --- GPIO, ADC, DAC -------------------------------------------------------- */
+
+/* Nivel externo de un pin (el que se lee si el pin es entrada). Genera las
+ * interrupciones de GPIO de P0 y P2 si estan habilitadas. */
+void sim_gpio_entrada(int puerto, int pin, int nivel);
+
+/* Estado de los pines de un puerto, como se ve desde afuera */
+uint32_t sim_gpio_pines(int puerto);
+
+/* Tension de un canal del ADC, como resultado de 12 bits (0..4095) */
+void sim_adc_entrada(int canal, uint32_t valor);
+
+/* Ultimo valor escrito en el DAC (10 bits) y cuantas escrituras hubo */
+uint32_t sim_dac_valor(void);
+uint32_t sim_dac_escrituras(void);
+
+/* Cada valor (10 bits) que pasa a la salida del DAC, cuando pasa; NULL no
+ * avisa */
+typedef void (*sim_dac_salida_t)(uint32_t valor);
+
+void sim_dac_salida(sim_dac_salida_t fn);
+
+/* --- Interrupciones -------------------------------------------------------- */
+
+/* Latencia de una IRQ (numero del NVIC, 0..34; -1 para SysTick): ciclos
+ * entre que la linea se levanto y el primer ciclo del handler */
+typedef struct {
+    uint32_t atendidas;
+    uint32_t latencia_max;
+    uint64_t latencia_total;
+} sim_irq_stats_t;
+
+void sim_irq_stats(int irq, sim_irq_stats_t *st);
+
+/* --- Fin ------------------------------------------------------------------- */
+
+/* Termina la simulacion con ese codigo de salida (para tests) */
+void sim_terminar(int codigo) __attribute__((noreturn));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_H */
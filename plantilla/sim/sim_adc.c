@@ -0,0 +1,316 @@
+/* ============================================================================
+ * sim_adc.c - Modelos del ADC (8 canales, 12 bits) y del DAC (10 bits)
+ * ============================================================================
+ *
+ * ADC: cada conversion tarda 65 clocks de ADC (PCLK / (CLKDIV + 1)).
+ * Convierte el valor que se haya puesto con sim_adc_entrada(). Modos START
+ * = 001 (una conversion del canal seleccionado) y BURST (todos los canales
+ * de SEL, en orden, sin parar). Los otros START (por flanco de MAT/EINT) no
+ * estan modelados.
+ *
+ * DAC: con CNT_ENA el contador baja desde DACCNTVAL a ritmo de PCLK; al
+ * llegar a 0 pide DMA (si DMA_ENA) y, con doble buffer, pasa el valor
+ * escrito a la salida.
+ * ========================================================================= */
+
+#include <stddef.h>
+
+#include "sim_int.h"
+
+#define IRQ_ADC         22
+#define CICLOS_ADC      65
+
+#define ADCR_BURST      (1u << 16)
+#define ADCR_PDN        (1u << 21)
+#define ADC_DONE        (1u << 31)
+#define ADC_OVERRUN     (1u << 30)
+
+#define DAC_INT_DMA_REQ (1u << 0)
+#define DAC_DBLBUF_ENA  (1u << 1)
+#define DAC_CNT_ENA     (1u << 2)
+#define DAC_DMA_ENA     (1u << 3)
+
+/* ============================================================================
+ * ADC
+ * ========================================================================= */
+
+typedef struct {
+    uint32_t adcr;
+    uint32_t inten;
+    uint32_t gdr;
+    uint32_t dr[8];
+    uint32_t entrada[8];
+    int canal;              /* el que se esta convirtiendo, -1 si ninguno */
+    uint64_t fin;
+} adc_t;
+
+static adc_t adc = { .inten = 0x100, .canal = -1, .fin = SIM_NUNCA };
+
+static uint64_t ciclos_conversion(void)
+{
+    return (uint64_t)CICLOS_ADC * (((adc.adcr >> 8) & 0xFF) + 1) *
+           sim_pclk_div(SIM_PCLK_ADC);
+}
+
+/* Primer canal de SEL a partir de "desde" (dando la vuelta) */
+static int siguiente_canal(int desde)
+{
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        int c = (desde + i) % 8;
+        if (adc.adcr & (1u << c)) {
+            return c;
+        }
+    }
+    return -1;
+}
+
+static void adc_arrancar(int canal, uint64_t ahora)
+{
+    adc.canal = canal;
+    adc.fin = (canal >= 0) ? ahora + ciclos_conversion() : SIM_NUNCA;
+}
+
+static void adc_irq(void)
+{
+    int activa = 0;
+    int i;
+
+    for (i = 0; i < 8; i++) {
+        if ((adc.inten & (1u << i)) && (adc.dr[i] & ADC_DONE)) {
+            activa = 1;
+        }
+    }
+    if ((adc.inten & 0x100) && (adc.gdr & ADC_DONE)) {
+        activa = 1;
+    }
+    sim_irq_nivel(IRQ_ADC, activa);
+}
+
+static uint64_t adc_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    uint32_t r;
+    int c = adc.canal;
+
+    (void)m;
+    if (c < 0 || adc.fin > ahora) {
+        return adc.fin;
+    }
+    r = ((adc.entrada[c] & 0xFFF) << 4) | ADC_DONE;
+    adc.dr[c] = r | ((adc.dr[c] & ADC_DONE) ? ADC_OVERRUN : 0);
+    adc.gdr = r | ((uint32_t)c << 24) | ((adc.gdr & ADC_DONE) ? ADC_OVERRUN : 0);
+    adc_irq();
+    sim_gpdma_despertar();
+
+    if ((adc.adcr & ADCR_BURST) && (adc.adcr & ADCR_PDN)) {
+        adc_arrancar(siguiente_canal(c + 1), adc.fin);
+    } else {
+        adc_arrancar(-1, 0);
+    }
+    return adc.fin;
+}
+
+static uint32_t adc_mirar(sim_modelo_t *m, uint32_t off)
+{
+    uint32_t v = 0;
+    int i;
+
+    (void)m;
+    switch (off) {
+    case 0x00: return adc.adcr;
+    case 0x04: return adc.gdr;
+    case 0x0C: return adc.inten;
+    case 0x30:
+        for (i = 0; i < 8; i++) {
+            if (adc.dr[i] & ADC_DONE) {
+                v |= 1u << i;
+            }
+            if (adc.dr[i] & ADC_OVERRUN) {
+                v |= 1u << (8 + i);
+            }
+        }
+        return v;
+    }
+    if (off >= 0x10 && off < 0x30) {
+        return adc.dr[(off - 0x10) / 4];
+    }
+    return 0;
+}
+
+static uint32_t adc_leer(sim_modelo_t *m, uint32_t off)
+{
+    uint32_t v = adc_mirar(m, off);
+
+    if (off == 0x04) {
+        adc.gdr &= ~(ADC_DONE | ADC_OVERRUN);
+    } else if (off >= 0x10 && off < 0x30) {
+        adc.dr[(off - 0x10) / 4] &= ~(ADC_DONE | ADC_OVERRUN);
+    }
+    adc_irq();
+    return v;
+}
+
+static void adc_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    (void)lanes;
+    switch (off) {
+    case 0x00:
+        adc.adcr = val;
+        if (!(val & ADCR_PDN)) {
+            adc_arrancar(-1, 0);
+        } else if (val & ADCR_BURST) {
+            if (adc.canal < 0) {
+                adc_arrancar(siguiente_canal(0), sim_t);
+            }
+        } else if (((val >> 24) & 7) == 1) {
+            adc_arrancar(siguiente_canal(0), sim_t);
+        }
+        break;
+    case 0x0C:
+        adc.inten = val & 0x1FF;
+        adc_irq();
+        break;
+    }
+    m->proximo = adc.fin;
+    sim_replanificar();
+}
+
+sim_modelo_t sim_modelo_adc = {
+    "ADC", 0x40034000u, 0x4000, adc_leer, adc_mirar, adc_escribir,
+    adc_avanzar, &adc, SIM_NUNCA
+};
+
+int sim_adc_dma_pide(void)
+{
+    return (adc.gdr & ADC_DONE) != 0;
+}
+
+void sim_adc_entrada(int canal, uint32_t valor)
+{
+    if (canal >= 0 && canal < 8) {
+        adc.entrada[canal] = valor & 0xFFF;
+    }
+}
+
+/* ============================================================================
+ * DAC
+ * ========================================================================= */
+
+typedef struct {
+    uint32_t dacr;          /* lo que escribio el firmware */
+    uint32_t salida;        /* lo que esta en el pin */
+    uint32_t ctrl;
+    uint32_t cntval;
+    uint64_t cero;          /* cuando el contador llega a 0 */
+    uint32_t escrituras;
+    sim_dac_salida_t fn;
+} dac_t;
+
+static dac_t dac = { .cero = SIM_NUNCA };
+
+static void dac_actualizar_salida(uint32_t v)
+{
+    dac.salida = v;
+    dac.escrituras++;
+    if (dac.fn != NULL) {
+        dac.fn((v >> 6) & 0x3FF);
+    }
+}
+
+static uint64_t periodo_dac(void)
+{
+    return ((uint64_t)(dac.cntval & 0xFFFF) + 1) * sim_pclk_div(SIM_PCLK_DAC);
+}
+
+static void dac_contador(uint64_t ahora)
+{
+    dac.cero = (dac.ctrl & DAC_CNT_ENA) ? ahora + periodo_dac() : SIM_NUNCA;
+}
+
+static uint64_t dac_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    if (dac.cero <= ahora) {
+        dac.ctrl |= DAC_INT_DMA_REQ;
+        if (dac.ctrl & DAC_DBLBUF_ENA) {
+            dac_actualizar_salida(dac.dacr);
+        }
+        if (dac.ctrl & DAC_DMA_ENA) {
+            sim_gpdma_despertar();
+        }
+        dac.cero += periodo_dac();
+    }
+    return dac.cero;
+}
+
+static uint32_t dac_mirar(sim_modelo_t *m, uint32_t off)
+{
+    (void)m;
+    switch (off) {
+    case 0x00: return dac.dacr;
+    case 0x04: return dac.ctrl;
+    case 0x08: return dac.cntval;
+    }
+    return 0;
+}
+
+static void dac_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    (void)lanes;
+    switch (off) {
+    case 0x00:
+        dac.dacr = val & 0x1FFC0;
+        dac.ctrl &= ~DAC_INT_DMA_REQ;
+        if (!((dac.ctrl & DAC_DBLBUF_ENA) && (dac.ctrl & DAC_CNT_ENA))) {
+            dac_actualizar_salida(dac.dacr);
+        }
+        break;
+    case 0x04:
+        if ((val & DAC_CNT_ENA) && !(dac.ctrl & DAC_CNT_ENA)) {
+            dac.ctrl = (dac.ctrl & DAC_INT_DMA_REQ) | (val & 0xE);
+            dac_contador(sim_t);
+        } else {
+            dac.ctrl = (dac.ctrl & DAC_INT_DMA_REQ) | (val & 0xE);
+            if (!(val & DAC_CNT_ENA)) {
+                dac.cero = SIM_NUNCA;
+            }
+        }
+        break;
+    case 0x08:
+        dac.cntval = val & 0xFFFF;
+        break;
+    }
+    m->proximo = dac.cero;
+    sim_replanificar();
+}
+
+sim_modelo_t sim_modelo_dac = {
+    "DAC", 0x4008C000u, 0x4000, dac_mirar, dac_mirar, dac_escribir,
+    dac_avanzar, &dac, SIM_NUNCA
+};
+
+int sim_dac_dma_pide(void)
+{
+    return (dac.ctrl & DAC_DMA_ENA) && (dac.ctrl & DAC_INT_DMA_REQ);
+}
+
+void sim_dac_dma_atendido(void)
+{
+    dac.ctrl &= ~DAC_INT_DMA_REQ;
+}
+
+uint32_t sim_dac_valor(void)
+{
+    return (dac.salida >> 6) & 0x3FF;
+}
+
+uint32_t sim_dac_escrituras(void)
+{
+    return dac.escrituras;
+}
+
+void sim_dac_salida(sim_dac_salida_t fn)
+{
+    dac.fn = fn;
+}
@@ -0,0 +1,105 @@
+/* ============================================================================
+ * sim_cmsis.h - Las instrucciones del Cortex-M3, en version PC
+ * ============================================================================
+ *
+ * "make host" incluye este header ANTES que cualquier otro en cada archivo
+ * (gcc -include). Hace dos cosas:
+ *
+ *   1. Reemplaza core_cmFunc.h y core_cmInstr.h de CMSIS. Esos headers son
+ *      assembler de ARM (cpsid i, wfi, mrs primask...) que un compilador de
+ *      PC no puede ensamblar. Definiendo sus guardas aca, core_cm3.h los
+ *      saltea, y las funciones con el mismo nombre las dan estas versiones,
+ *      que le avisan al simulador.
+ *
+ *   2. Ajusta las comprobaciones de direcciones de los drivers: en la PC los
+ *      buffers no estan en la RAM del LPC sino en la del proceso (siempre
+ *      debajo de 4 GB, ver sim_core.c).
+ *
+ * El firmware no tiene que incluirlo ni saber que existe.
+ * ========================================================================= */
+
+#ifndef SIM_CMSIS_H
+#define SIM_CMSIS_H
+
+#include <stdint.h>
+
+/* Saltear los headers de ARM */
+#define __CORE_CMFUNC_H__
+#define __CORE_CMINSTR_H__
+
+/* Estado del core que mantiene el simulador */
+extern volatile uint32_t sim_primask;
+extern volatile uint32_t sim_basepri;
+extern volatile uint32_t sim_faultmask;
+uint32_t sim_ipsr(void);
+void sim_primask_escribir(uint32_t valor);
+void sim_wfi(void);
+
+/* --- core_cmFunc.h ------------------------------------------------------- */
+
+static inline void __enable_irq(void)           { sim_primask_escribir(0); }
+static inline void __disable_irq(void)          { sim_primask_escribir(1); }
+static inline uint32_t __get_PRIMASK(void)      { return sim_primask; }
+static inline void __set_PRIMASK(uint32_t v)    { sim_primask_escribir(v & 1); }
+static inline void __enable_fault_irq(void)     { sim_faultmask = 0; }
+static inline void __disable_fault_irq(void)    { sim_faultmask = 1; }
+static inline uint32_t __get_FAULTMASK(void)    { return sim_faultmask; }
+static inline void __set_FAULTMASK(uint32_t v)  { sim_faultmask = v & 1; }
+static inline uint32_t __get_BASEPRI(void)      { return sim_basepri; }
+static inline void __set_BASEPRI(uint32_t v)    { sim_basepri = v & 0xFF; }
+static inline uint32_t __get_CONTROL(void)      { return 0; }
+static inline void __set_CONTROL(uint32_t v)    { (void)v; }
+static inline uint32_t __get_IPSR(void)         { return sim_ipsr(); }
+static inline uint32_t __get_APSR(void)         { return 0; }
+static inline uint32_t __get_xPSR(void)         { return sim_ipsr(); }
+static inline uint32_t __get_PSP(void)          { return 0; }
+static inline void __set_PSP(uint32_t v)        { (void)v; }
+static inline uint32_t __get_MSP(void)          { return 0; }
+static inline void __set_MSP(uint32_t v)        { (void)v; }
+
+/* --- core_cmInstr.h ------------------------------------------------------ */
+
+static inline void __NOP(void)                  { }
+static inline void __WFI(void)                  { sim_wfi(); }
+static inline void __WFE(void)                  { sim_wfi(); }
+static inline void __SEV(void)                  { }
+static inline void __ISB(void)                  { __sync_synchronize(); }
+static inline void __DSB(void)                  { __sync_synchronize(); }
+static inline void __DMB(void)                  { __sync_synchronize(); }
+static inline uint32_t __REV(uint32_t v)        { return __builtin_bswap32(v); }
+static inline uint32_t __REV16(uint32_t v)
+{
+    return ((v & 0xFF00FF00u) >> 8) | ((v & 0x00FF00FFu) << 8);
+}
+static inline int32_t __REVSH(int32_t v)
+{
+    return (int16_t)__builtin_bswap16((uint16_t)v);
+}
+static inline uint32_t __RBIT(uint32_t v)
+{
+    uint32_t r = 0;
+    int i;
+
+    for (i = 0; i < 32; i++) {
+        r = (r << 1) | ((v >> i) & 1u);
+    }
+    return r;
+}
+static inline uint8_t __CLZ(uint32_t v)         { return v ? (uint8_t)__builtin_clz(v) : 32; }
+
+/* Exclusivos: en la PC no hay otro master, el store siempre "gana" */
+static inline uint8_t __LDREXB(volatile uint8_t *p)     { return *p; }
+static inline uint16_t __LDREXH(volatile uint16_t *p)   { return *p; }
+static inline uint32_t __LDREXW(volatile uint32_t *p)   { return *p; }
+static inline uint32_t __STREXB(uint8_t v, volatile uint8_t *p)   { *p = v; return 0; }
+static inline uint32_t __STREXH(uint16_t v, volatile uint16_t *p) { *p = v; return 0; }
+static inline uint32_t __STREXW(uint32_t v, volatile uint32_t *p) { *p = v; return 0; }
+static inline void __CLREX(void)                { }
+
+/* --- Drivers ------------------------------------------------------------- */
+
+/* lpc17xx_gpdma.c: en la PC los buffers estan en la memoria del proceso */
+#define GPDMA_IS_RAM(a, n)      ((void)(n), (a) != 0)
+#define GPDMA_IS_FLASH(a, n)    ((void)(a), (void)(n), 0)
+
+#endif /* SIM_CMSIS_H */
@@ -0,0 +1,1293 @@
+/* ============================================================================
+ * sim_core.c - Nucleo del simulador: memoria, reloj, NVIC y arranque
+ * ============================================================================
+ *
+ * Como se atrapan los accesos a registros
+ * ---------------------------------------
+ *
+ * Las regiones de perifericos del LPC1769 (APB, AHB, GPIO y el PPB del
+ * Cortex-M3) se mapean en el proceso EN LAS MISMAS DIRECCIONES que en el
+ * chip, pero sin permisos. Cuando el firmware hace LPC_UART0->THR = 'A':
+ *
+ *   1. El acceso falla con SIGSEGV. El handler busca el modelo de esa
+ *      direccion. Si es una lectura, le pide el valor (con efectos) y lo
+ *      deja en la pagina; si es una escritura, deja el valor actual (sin
+ *      efectos) por si la instruccion tambien lee. Despues habilita la
+ *      pagina y prende el flag TF del x86 para ejecutar UNA instruccion.
+ *
+ *   2. La instruccion se ejecuta sobre la pagina y el CPU genera SIGTRAP.
+ *      Si fue una escritura, se lee lo que quedo en la pagina y se le pasa
+ *      al modelo (con los bytes que escribio de verdad, segun el tamano de
+ *      la instruccion). Se vuelve a proteger la pagina, avanza el reloj y se
+ *      atienden las interrupciones que hayan quedado pendientes.
+ *
+ * Las direcciones que ningun modelo atiende guardan lo ultimo que se
+ * escribio (memoria "sombra"), asi que los registros de configuracion que no
+ * tienen comportamiento (PINSEL, PCONP...) funcionan igual.
+ *
+ * El reloj
+ * --------
+ *
+ * sim_ahora cuenta ciclos de CCLK. Avanza SIM_CICLOS_ACCESO por cada acceso
+ * a un registro, 12 al entrar y 10 al salir de una interrupcion. El codigo
+ * que no toca registros no consume tiempo, salvo con SIM_ESCALA_HOST (ciclos
+ * del TSC de la PC por ciclo simulado) o mientras se cuentan instrucciones:
+ * ahi el firmware corre paso a paso (flag TF, un SIGTRAP por instruccion) y
+ * cada una cuesta un ciclo. Si el firmware se queda esperando sin tocar
+ * registros (un while sobre una variable que cambia una IRQ), una alarma de
+ * 1 ms del host salta el reloj al proximo evento.
+ *
+ * Solo funciona en Linux x86-64.
+ * ========================================================================= */
+
+/* _GNU_SOURCE (REG_RIP, MAP_32BIT...) lo pone el Makefile: sim_cmsis.h ya
+ * incluyo <stdint.h> antes de llegar aca */
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <x86intrin.h>
+
+#include "sim_int.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+#error "El simulador solo funciona en Linux x86-64"
+#endif
+
+/* ============================================================================
+ * 1. Regiones y modelos
+ * ========================================================================= */
+
+typedef struct {
+    uint32_t base;
+    uint32_t tam;
+    uint8_t *sombra;
+} region_t;
+
+static region_t regiones[] = {
+    { 0x2009C000u, 0x00004000u, NULL },     /* GPIO (AHB rapido) */
+    { 0x40000000u, 0x00100000u, NULL },     /* APB0 y APB1 */
+    { 0x50000000u, 0x00200000u, NULL },     /* AHB: GPDMA, EMAC, USB */
+    { 0xE0000000u, 0x00100000u, NULL },     /* PPB: NVIC, SysTick, SCB, DWT */
+};
+#define NUM_REGIONES    (sizeof(regiones) / sizeof(regiones[0]))
+
+/* RAM de los perifericos AHB (buffers de DMA, Ethernet, USB): memoria comun */
+#define RAM_AHB_BASE    0x2007C000u
+#define RAM_AHB_TAM     0x00008000u
+
+static sim_modelo_t modelo_scs;
+static sim_modelo_t modelo_dwt;
+
+static sim_modelo_t *modelos[] = {
+    &sim_modelo_sc,
+    &sim_modelo_uart[0], &sim_modelo_uart[1],
+    &sim_modelo_uart[2], &sim_modelo_uart[3],
+    &sim_modelo_timer[0], &sim_modelo_timer[1],
+    &sim_modelo_timer[2], &sim_modelo_timer[3],
+    &sim_modelo_gpio, &sim_modelo_gpioint,
+    &sim_modelo_gpdma, &sim_modelo_adc, &sim_modelo_dac,
+    &sim_modelo_ssp[0], &sim_modelo_ssp[1],
+    &sim_modelo_i2c[0], &sim_modelo_i2c[1], &sim_modelo_i2c[2],
+    &sim_modelo_emac, &sim_modelo_usb,
+    &modelo_scs, &modelo_dwt,
+};
+#define NUM_MODELOS     (sizeof(modelos) / sizeof(modelos[0]))
+
+static region_t *region_de(uintptr_t dir)
+{
+    unsigned i;
+
+    for (i = 0; i < NUM_REGIONES; i++) {
+        if (dir >= regiones[i].base && dir - regiones[i].base < regiones[i].tam) {
+            return &regiones[i];
+        }
+    }
+    return NULL;
+}
+
+static sim_modelo_t *modelo_de(uint32_t dir)
+{
+    unsigned i;
+
+    for (i = 0; i < NUM_MODELOS; i++) {
+        if (dir >= modelos[i]->base && dir - modelos[i]->base < modelos[i]->tam) {
+            return modelos[i];
+        }
+    }
+    return NULL;
+}
+
+static uint32_t *sombra_de(uint32_t dir)
+{
+    region_t *r = region_de(dir);
+
+    return (uint32_t *)(r->sombra + ((dir - r->base) & ~3u));
+}
+
+/* Acceso a un word alineado de la region de perifericos.
+ * efectos = 0 para mirar sin cambiar nada. */
+static uint32_t acceso_leer(uint32_t dir, int efectos)
+{
+    sim_modelo_t *m = modelo_de(dir);
+
+    dir &= ~3u;
+    if (m == NULL) {
+        return *sombra_de(dir);
+    }
+    if (!efectos && m->mirar != NULL) {
+        return m->mirar(m, dir - m->base);
+    }
+    if (!efectos) {
+        return *sombra_de(dir);
+    }
+    return m->leer(m, dir - m->base);
+}
+
+static void acceso_escribir(uint32_t dir, uint32_t val, uint32_t lanes)
+{
+    sim_modelo_t *m = modelo_de(dir);
+    uint32_t *s;
+    uint32_t mascara = 0;
+    int i;
+
+    dir &= ~3u;
+    for (i = 0; i < 4; i++) {
+        if (lanes & (1u << i)) {
+            mascara |= 0xFFu << (8 * i);
+        }
+    }
+
+    /* La sombra siempre guarda lo escrito: la usan los modelos sin mirar() */
+    s = sombra_de(dir);
+    *s = (*s & ~mascara) | (val & mascara);
+
+    if (m != NULL && m->escribir != NULL) {
+        m->escribir(m, dir - m->base, val, lanes);
+    }
+}
+
+/* ============================================================================
+ * 2. Reloj y eventos
+ * ========================================================================= */
+
+uint64_t sim_ahora;
+uint64_t sim_t;
+
+static uint64_t proximo = SIM_NUNCA;    /* minimo de los "proximo" */
+static uint64_t limite = SIM_NUNCA;     /* SIM_MAX_CICLOS */
+static uint64_t accesos;                /* instrucciones que tocaron registros */
+static volatile int contando;           /* sim_contar_instrucciones(1) */
+static uint64_t instrucciones;
+static volatile int ocupado;            /* el simulador esta en medio de algo */
+
+/* Escala opcional: tiempo de CPU del host -> ciclos simulados. Al tiempo
+ * entre dos accesos se le descuenta lo que tarda el kernel en entregar las
+ * signals de un acceso (se mide al arrancar, ver calibrar_host). */
+static double escala_host;
+static uint64_t tsc_marca;
+static uint64_t tsc_costo_trap;
+static uint64_t tsc_ultimo;
+
+static void host_contar(void)
+{
+    uint64_t ahora;
+
+    if (escala_host > 0 && !contando) {
+        ahora = __rdtsc();
+        tsc_ultimo = ahora - tsc_marca;
+        if (tsc_ultimo > tsc_costo_trap) {
+            sim_ahora += (uint64_t)((double)(tsc_ultimo - tsc_costo_trap) / escala_host);
+        }
+        tsc_marca = ahora;
+    }
+    sim_t = sim_ahora;
+}
+
+static void host_marcar(void)
+{
+    if (escala_host > 0) {
+        tsc_marca = __rdtsc();
+    }
+}
+
+void sim_replanificar(void)
+{
+    uint64_t min = SIM_NUNCA;
+    unsigned i;
+
+    for (i = 0; i < NUM_MODELOS; i++) {
+        if (modelos[i]->proximo < min) {
+            min = modelos[i]->proximo;
+        }
+    }
+    proximo = min;
+}
+
+void sim_programar(sim_modelo_t *m, uint64_t cuando)
+{
+    if (cuando < m->proximo) {
+        m->proximo = cuando;
+    }
+    if (cuando < proximo) {
+        proximo = cuando;
+    }
+}
+
+void sim_bloquear(void)
+{
+    ocupado++;
+}
+
+void sim_desbloquear(void)
+{
+    ocupado--;
+}
+
+/* Procesa en orden todos los eventos que vencieron hasta sim_ahora */
+static void actualizar(void)
+{
+    static int dentro;
+    unsigned i;
+
+    if (dentro) {
+        return;
+    }
+    dentro = 1;
+    while (proximo <= sim_ahora) {
+        uint64_t t = proximo;
+
+        sim_t = t;
+        for (i = 0; i < NUM_MODELOS; i++) {
+            if (modelos[i]->proximo <= t) {
+                modelos[i]->proximo = modelos[i]->avanzar(modelos[i], t);
+            }
+        }
+        sim_replanificar();
+    }
+    sim_t = sim_ahora;
+    dentro = 0;
+
+    if (sim_ahora >= limite) {
+        sim_terminar(0);
+    }
+}
+
+/* ============================================================================
+ * 3. Interrupciones (NVIC)
+ * ========================================================================= */
+
+#define NUM_IRQ         35
+#define EXC_SYSTICK     40              /* bit de SysTick en las mascaras */
+#define NUM_STATS       (NUM_IRQ + 1)
+
+#define CICLOS_ENTRADA  12
+#define CICLOS_SALIDA   10
+
+volatile uint32_t sim_primask;
+volatile uint32_t sim_basepri;
+volatile uint32_t sim_faultmask;
+
+static uint64_t irq_nivel;              /* lineas levantadas */
+static uint64_t irq_pend;               /* pendientes latcheadas */
+static uint64_t irq_activa;             /* handlers en curso */
+static uint64_t irq_habil = 1ull << EXC_SYSTICK;
+static uint8_t irq_prio[NUM_IRQ];       /* NVIC->IP */
+static uint8_t shp[12];                 /* SCB->SHP */
+static uint64_t irq_desde[EXC_SYSTICK + 1];
+static sim_irq_stats_t stats[NUM_STATS];
+static int prio_actual = 256;           /* 256 = modo thread */
+static uint32_t ipsr_actual;
+
+/* Handlers del firmware. Son weak con el mismo nombre que en
+ * startup_lpc1769.c: si el firmware no define uno, queda el de defecto. */
+static void sim_irq_sin_handler(void);
+
+#define HANDLER_DEFECTO(nombre) \
+    void nombre(void) __attribute__((weak, alias("sim_irq_sin_handler")))
+
+HANDLER_DEFECTO(WDT_IRQHandler);
+HANDLER_DEFECTO(TIMER0_IRQHandler);
+HANDLER_DEFECTO(TIMER1_IRQHandler);
+HANDLER_DEFECTO(TIMER2_IRQHandler);
+HANDLER_DEFECTO(TIMER3_IRQHandler);
+HANDLER_DEFECTO(UART0_IRQHandler);
+HANDLER_DEFECTO(UART1_IRQHandler);
+HANDLER_DEFECTO(UART2_IRQHandler);
+HANDLER_DEFECTO(UART3_IRQHandler);
+HANDLER_DEFECTO(PWM1_IRQHandler);
+HANDLER_DEFECTO(I2C0_IRQHandler);
+HANDLER_DEFECTO(I2C1_IRQHandler);
+HANDLER_DEFECTO(I2C2_IRQHandler);
+HANDLER_DEFECTO(SPI_IRQHandler);
+HANDLER_DEFECTO(SSP0_IRQHandler);
+HANDLER_DEFECTO(SSP1_IRQHandler);
+HANDLER_DEFECTO(PLL0_IRQHandler);
+HANDLER_DEFECTO(RTC_IRQHandler);
+HANDLER_DEFECTO(EINT0_IRQHandler);
+HANDLER_DEFECTO(EINT1_IRQHandler);
+HANDLER_DEFECTO(EINT2_IRQHandler);
+HANDLER_DEFECTO(EINT3_IRQHandler);
+HANDLER_DEFECTO(ADC_IRQHandler);
+HANDLER_DEFECTO(BOD_IRQHandler);
+HANDLER_DEFECTO(USB_IRQHandler);
+HANDLER_DEFECTO(CAN_IRQHandler);
+HANDLER_DEFECTO(DMA_IRQHandler);
+HANDLER_DEFECTO(I2S_IRQHandler);
+HANDLER_DEFECTO(ENET_IRQHandler);
+HANDLER_DEFECTO(RIT_IRQHandler);
+HANDLER_DEFECTO(MCPWM_IRQHandler);
+HANDLER_DEFECTO(QEI_IRQHandler);
+HANDLER_DEFECTO(PLL1_IRQHandler);
+HANDLER_DEFECTO(USBActivity_IRQHandler);
+HANDLER_DEFECTO(CANActivity_IRQHandler);
+HANDLER_DEFECTO(SysTick_Handler);
+
+static void (*const handlers[NUM_IRQ])(void) = {
+    WDT_IRQHandler, TIMER0_IRQHandler, TIMER1_IRQHandler, TIMER2_IRQHandler,
+    TIMER3_IRQHandler, UART0_IRQHandler, UART1_IRQHandler, UART2_IRQHandler,
+    UART3_IRQHandler, PWM1_IRQHandler, I2C0_IRQHandler, I2C1_IRQHandler,
+    I2C2_IRQHandler, SPI_IRQHandler, SSP0_IRQHandler, SSP1_IRQHandler,
+    PLL0_IRQHandler, RTC_IRQHandler, EINT0_IRQHandler, EINT1_IRQHandler,
+    EINT2_IRQHandler, EINT3_IRQHandler, ADC_IRQHandler, BOD_IRQHandler,
+    USB_IRQHandler, CAN_IRQHandler, DMA_IRQHandler, I2S_IRQHandler,
+    ENET_IRQHandler, RIT_IRQHandler, MCPWM_IRQHandler, QEI_IRQHandler,
+    PLL1_IRQHandler, USBActivity_IRQHandler, CANActivity_IRQHandler,
+};
+
+static void sim_irq_sin_handler(void)
+{
+    sim_fatal("interrupcion %u sin handler (el firmware la habilito en el "
+              "NVIC pero no definio su IRQHandler)", ipsr_actual);
+}
+
+/* El LPC17xx implementa 5 bits de prioridad (los altos del byte) */
+static int prioridad(int exc)
+{
+    if (exc == EXC_SYSTICK) {
+        return shp[11] >> 3;
+    }
+    return irq_prio[exc] >> 3;
+}
+
+static void marcar_pendiente(int exc)
+{
+    uint64_t bit = 1ull << exc;
+
+    if (!((irq_pend | irq_activa) & bit)) {
+        irq_desde[exc] = sim_t;
+    }
+    irq_pend |= bit;
+}
+
+void sim_irq_nivel(int irq, int nivel)
+{
+    uint64_t bit = 1ull << irq;
+
+    if (nivel) {
+        if (!(irq_nivel & bit)) {
+            irq_nivel |= bit;
+            marcar_pendiente(irq);
+        }
+    } else {
+        irq_nivel &= ~bit;
+    }
+}
+
+/* Excepciones que podrian entrar (sin mirar PRIMASK ni prioridades) */
+static uint64_t candidatas(void)
+{
+    return irq_pend & irq_habil & ~irq_activa;
+}
+
+static void entrar(int exc)
+{
+    uint64_t bit = 1ull << exc;
+    int prio_previa = prio_actual;
+    uint32_t ipsr_previo = ipsr_actual;
+    uint64_t latencia;
+    sim_irq_stats_t *st;
+    sigset_t alarma;
+    sigset_t mascara_previa;
+
+    irq_pend &= ~bit;
+    irq_activa |= bit;
+    prio_actual = prioridad(exc);
+    ipsr_actual = (exc == EXC_SYSTICK) ? 15 : 16 + (uint32_t)exc;
+
+    sim_ahora += CICLOS_ENTRADA;
+    latencia = sim_ahora - irq_desde[exc];
+    st = &stats[exc == EXC_SYSTICK ? 0 : exc + 1];
+    st->atendidas++;
+    st->latencia_total += latencia;
+    if (latencia > st->latencia_max) {
+        st->latencia_max = (uint32_t)latencia;
+    }
+
+    /* El handler corre como firmware: puede acceder a registros (SIGSEGV
+     * anidado) y la alarma tiene que poder adelantar el reloj si espera */
+    sigemptyset(&alarma);
+    sigaddset(&alarma, SIGALRM);
+    sigprocmask(SIG_UNBLOCK, &alarma, &mascara_previa);
+    ocupado--;
+    host_marcar();
+    if (exc == EXC_SYSTICK) {
+        SysTick_Handler();
+    } else {
+        handlers[exc]();
+    }
+    host_contar();
+    ocupado++;
+    sigprocmask(SIG_SETMASK, &mascara_previa, NULL);
+
+    sim_ahora += CICLOS_SALIDA;
+    irq_activa &= ~bit;
+    prio_actual = prio_previa;
+    ipsr_actual = ipsr_previo;
+
+    /* Linea por nivel todavia arriba: el NVIC la vuelve a pender */
+    if (irq_nivel & bit) {
+        irq_pend |= bit;
+        irq_desde[exc] = sim_ahora;
+    }
+    actualizar();
+}
+
+/* Entra a todas las interrupciones que corresponda, en orden de prioridad */
+static void despachar(void)
+{
+    for (;;) {
+        uint64_t c;
+        int mejor = -1;
+        int mejor_prio = 256;
+        int exc;
+
+        if (sim_primask || sim_faultmask) {
+            return;
+        }
+        c = candidatas();
+        for (exc = 0; c != 0; exc++, c >>= 1) {
+            if ((c & 1) && prioridad(exc) < mejor_prio) {
+                mejor = exc;
+                mejor_prio = prioridad(exc);
+            }
+        }
+        if (mejor < 0 || mejor_prio >= prio_actual) {
+            return;
+        }
+        if (sim_basepri != 0 && mejor_prio >= (int)(sim_basepri >> 3)) {
+            return;
+        }
+        entrar(mejor);
+    }
+}
+
+uint32_t sim_ipsr(void)
+{
+    return ipsr_actual;
+}
+
+/* Actualiza el reloj y atiende lo pendiente. Para llamar desde contexto de
+ * firmware (no desde un handler de signal). */
+static void sincronizar(void)
+{
+    ocupado++;
+    host_contar();
+    actualizar();
+    despachar();
+    host_marcar();
+    ocupado--;
+}
+
+void sim_primask_escribir(uint32_t valor)
+{
+    sim_primask = valor;
+    if (!valor) {
+        sincronizar();
+    }
+}
+
+/* Dormido no se ejecuta nada del firmware: si se estaban contando
+ * instrucciones, los pasos de este lazo no cuentan */
+void sim_wfi(void)
+{
+    int cuenta = contando;
+
+    if (cuenta) {
+        contando = 0;
+        __asm__ volatile("pushfq; andq $~0x100, (%%rsp); popfq" ::: "memory", "cc");
+    }
+    ocupado++;
+    host_contar();
+    actualizar();
+    /* Dormir hasta que haya algo pendiente, aunque PRIMASK lo tape */
+    while (!candidatas()) {
+        if (proximo == SIM_NUNCA) {
+            sim_fatal("WFI sin ningun evento programado: el firmware no "
+                      "se despertaria nunca");
+        }
+        if (proximo > sim_ahora) {
+            sim_ahora = proximo;
+        }
+        actualizar();
+    }
+    despachar();
+    host_marcar();
+    ocupado--;
+    if (cuenta) {
+        contando = 1;
+        __asm__ volatile("pushfq; orq $0x100, (%%rsp); popfq" ::: "memory", "cc");
+    }
+}
+
+/* ============================================================================
+ * 4. Perifericos del core: SysTick, NVIC, SCB, DWT
+ * ========================================================================= */
+
+typedef struct {
+    uint32_t ctrl;
+    uint32_t load;
+    uint32_t val;           /* valor cuando esta parado */
+    uint64_t cero;          /* cuando llega a 0 (si esta andando) */
+} systick_t;
+
+static systick_t systick;
+
+static uint32_t systick_val(void)
+{
+    uint64_t falta;
+
+    if (!(systick.ctrl & 1)) {
+        return systick.val;
+    }
+    falta = systick.cero - sim_ahora;
+    return falta > systick.load ? systick.load : (uint32_t)falta;
+}
+
+static void systick_programar(uint32_t desde)
+{
+    if ((systick.ctrl & 1) && systick.load != 0) {
+        systick.cero = sim_ahora + (desde ? desde : systick.load + 1u);
+        modelo_scs.proximo = SIM_NUNCA;
+        sim_programar(&modelo_scs, systick.cero);
+    } else {
+        modelo_scs.proximo = SIM_NUNCA;
+        sim_replanificar();
+    }
+}
+
+static uint64_t scs_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    while ((systick.ctrl & 1) && systick.load != 0 && systick.cero <= ahora) {
+        systick.ctrl |= 1u << 16;                   /* COUNTFLAG */
+        if (systick.ctrl & 2) {                     /* TICKINT */
+            marcar_pendiente(EXC_SYSTICK);
+        }
+        systick.cero += systick.load + 1u;
+    }
+    if ((systick.ctrl & 1) && systick.load != 0) {
+        return systick.cero;
+    }
+    return SIM_NUNCA;
+}
+
+static uint32_t bits_irq(int palabra, uint64_t mascara)
+{
+    return (uint32_t)(mascara >> (32 * palabra)) &
+           (palabra == 0 ? 0xFFFFFFFFu : ((1u << (NUM_IRQ - 32)) - 1u));
+}
+
+static uint64_t irq_de_bits(int palabra, uint32_t val)
+{
+    return (uint64_t)bits_irq(palabra, (uint64_t)val << (32 * palabra)) << (32 * palabra);
+}
+
+static uint32_t scs_mirar(sim_modelo_t *m, uint32_t off)
+{
+    uint32_t v;
+    int i;
+
+    (void)m;
+    switch (off) {
+    case 0x010: return systick.ctrl;
+    case 0x014: return systick.load;
+    case 0x018: return systick_val();
+    case 0x01C: return 0;                           /* CALIB */
+    case 0xD04:                                     /* ICSR */
+        return ipsr_actual | ((irq_pend >> EXC_SYSTICK) & 1 ? 1u << 26 : 0);
+    }
+    if (off >= 0x100 && off < 0x108) {
+        return bits_irq((off - 0x100) / 4, irq_habil);
+    }
+    if (off >= 0x180 && off < 0x188) {
+        return bits_irq((off - 0x180) / 4, irq_habil);
+    }
+    if (off >= 0x200 && off < 0x208) {
+        return bits_irq((off - 0x200) / 4, irq_pend);
+    }
+    if (off >= 0x280 && off < 0x288) {
+        return bits_irq((off - 0x280) / 4, irq_pend);
+    }
+    if (off >= 0x300 && off < 0x308) {
+        return bits_irq((off - 0x300) / 4, irq_activa);
+    }
+    if (off >= 0x400 && off < 0x400 + NUM_IRQ + 1) {
+        v = 0;
+        for (i = 0; i < 4; i++) {
+            uint32_t n = off - 0x400 + (uint32_t)i;
+            if (n < NUM_IRQ) {
+                v |= (uint32_t)irq_prio[n] << (8 * i);
+            }
+        }
+        return v;
+    }
+    if (off >= 0xD18 && off < 0xD24) {
+        v = 0;
+        for (i = 0; i < 4; i++) {
+            v |= (uint32_t)shp[off - 0xD18 + (uint32_t)i] << (8 * i);
+        }
+        return v;
+    }
+    return *sombra_de(m->base + off);
+}
+
+static uint32_t scs_leer(sim_modelo_t *m, uint32_t off)
+{
+    uint32_t v = scs_mirar(m, off);
+
+    if (off == 0x010) {
+        systick.ctrl &= ~(1u << 16);                /* leer CTRL borra COUNTFLAG */
+    }
+    return v;
+}
+
+static void scs_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    int i;
+
+    (void)m;
+    if (off >= 0x400 && off < 0x400 + NUM_IRQ + 1) {
+        for (i = 0; i < 4; i++) {
+            uint32_t n = off - 0x400 + (uint32_t)i;
+            if ((lanes & (1u << i)) && n < NUM_IRQ) {
+                irq_prio[n] = (uint8_t)(val >> (8 * i)) & 0xF8;
+            }
+        }
+        return;
+    }
+    if (off >= 0xD18 && off < 0xD24) {
+        for (i = 0; i < 4; i++) {
+            if (lanes & (1u << i)) {
+                shp[off - 0xD18 + (uint32_t)i] = (uint8_t)(val >> (8 * i)) & 0xF8;
+            }
+        }
+        return;
+    }
+    if (off >= 0x100 && off < 0x108) {
+        irq_habil |= irq_de_bits((off - 0x100) / 4, val);
+        return;
+    }
+    if (off >= 0x180 && off < 0x188) {
+        irq_habil &= ~irq_de_bits((off - 0x180) / 4, val);
+        return;
+    }
+    if (off >= 0x200 && off < 0x208) {
+        uint64_t nuevas = irq_de_bits((off - 0x200) / 4, val);
+        for (i = 0; i < NUM_IRQ; i++) {
+            if (nuevas & (1ull << i)) {
+                marcar_pendiente(i);
+            }
+        }
+        return;
+    }
+    if (off >= 0x280 && off < 0x288) {
+        /* Una linea por nivel que sigue arriba vuelve a quedar pendiente */
+        irq_pend &= ~(irq_de_bits((off - 0x280) / 4, val) & ~irq_nivel);
+        return;
+    }
+
+    switch (off) {
+    case 0x010:                                     /* SysTick CTRL */
+        val &= 0x7;
+        if ((val & 1) && !(systick.ctrl & 1)) {
+            systick.ctrl = val;
+            systick_programar(systick.val);
+        } else if (!(val & 1) && (systick.ctrl & 1)) {
+            systick.val = systick_val();
+            systick.ctrl = val;
+            systick_programar(0);
+        } else {
+            systick.ctrl = (systick.ctrl & (1u << 16)) | val;
+        }
+        break;
+    case 0x014:                                     /* LOAD */
+        systick.load = val & 0x00FFFFFFu;
+        break;
+    case 0x018:                                     /* VAL: cualquier escritura lo borra */
+        systick.val = 0;
+        systick.ctrl &= ~(1u << 16);
+        systick_programar(0);
+        break;
+    case 0xD04:                                     /* ICSR */
+        if (val & (1u << 26)) {
+            marcar_pendiente(EXC_SYSTICK);
+        }
+        if (val & (1u << 25)) {
+            irq_pend &= ~(1ull << EXC_SYSTICK);
+        }
+        break;
+    case 0xF00:                                     /* STIR */
+        if ((val & 0x1FF) < NUM_IRQ) {
+            marcar_pendiente((int)(val & 0x1FF));
+        }
+        break;
+    }
+}
+
+static sim_modelo_t modelo_scs = {
+    "SCS", 0xE000E000u, 0x1000, scs_leer, scs_mirar, scs_escribir,
+    scs_avanzar, NULL, SIM_NUNCA
+};
+
+/* DWT: solo el contador de ciclos */
+static uint32_t dwt_ctrl;
+static uint32_t dwt_base;
+static uint64_t dwt_desde;
+
+static uint32_t dwt_leer(sim_modelo_t *m, uint32_t off)
+{
+    switch (off) {
+    case 0x000: return dwt_ctrl;
+    case 0x004:
+        if (dwt_ctrl & 1) {
+            return dwt_base + (uint32_t)(sim_ahora - dwt_desde);
+        }
+        return dwt_base;
+    }
+    return *sombra_de(m->base + off);
+}
+
+static void dwt_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    (void)m;
+    (void)lanes;
+    switch (off) {
+    case 0x000:
+        dwt_base = dwt_leer(m, 0x004);
+        dwt_desde = sim_ahora;
+        dwt_ctrl = val;
+        break;
+    case 0x004:
+        dwt_base = val;
+        dwt_desde = sim_ahora;
+        break;
+    }
+}
+
+static uint64_t sin_eventos(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    (void)ahora;
+    return SIM_NUNCA;
+}
+
+static sim_modelo_t modelo_dwt = {
+    "DWT", 0xE0001000u, 0x1000, dwt_leer, dwt_leer, dwt_escribir,
+    sin_eventos, NULL, SIM_NUNCA
+};
+
+/* ============================================================================
+ * 5. Signals: SIGSEGV, SIGTRAP y la alarma
+ * ========================================================================= */
+
+#define EFLAGS_TF       0x100
+
+static struct {
+    int activo;
+    int escritura;
+    uint32_t dir;
+    int ancho;
+    uint8_t *pagina;
+    int alarma_bloqueada;
+} pendiente;
+
+/* Tamano del operando de memoria de la instruccion x86 en "p". Alcanza con
+ * lo que genera gcc para acceder a registros: mov, or/and/add con memoria,
+ * setcc, instrucciones de bytes (opcode par) y prefijos 66/REX.W. */
+static int ancho_instruccion(const uint8_t *p)
+{
+    int op16 = 0;
+    int rexw = 0;
+    int completo;
+    uint8_t op;
+
+    for (;;) {
+        if (*p == 0x66) {
+            op16 = 1;
+        } else if (*p != 0x67 && *p != 0xF0 && *p != 0xF2 && *p != 0xF3 &&
+                   *p != 0x2E && *p != 0x36 && *p != 0x3E && *p != 0x26 &&
+                   *p != 0x64 && *p != 0x65) {
+            break;
+        }
+        p++;
+    }
+    if ((*p & 0xF0) == 0x40) {
+        rexw = (*p & 0x08) != 0;
+        p++;
+    }
+    completo = rexw ? 8 : (op16 ? 2 : 4);
+    op = *p;
+
+    if (op == 0x0F) {
+        op = p[1];
+        if ((op & 0xF0) == 0x90 || op == 0xB0 || op == 0xC0) {
+            return 1;                               /* setcc, cmpxchg8, xadd8 */
+        }
+        if (op == 0xD6) {
+            return 8;                               /* movq xmm */
+        }
+        if (op == 0x11 || op == 0x29 || op == 0x2B || op == 0x7F || op == 0xE7) {
+            return 16;                              /* stores SSE */
+        }
+        return completo;
+    }
+    if (op < 0x40 || (op >= 0x84 && op <= 0x8B) ||
+        op == 0x80 || op == 0x81 || op == 0x83 ||
+        op == 0xC0 || op == 0xC1 || op == 0xC6 || op == 0xC7 ||
+        (op >= 0xD0 && op <= 0xD3) ||
+        op == 0xF6 || op == 0xF7 || op == 0xFE || op == 0xFF ||
+        (op >= 0xA0 && op <= 0xA3) || op == 0xAA || op == 0xAB) {
+        return (op & 1) ? completo : 1;             /* bit 0 = "w" */
+    }
+    return completo;
+}
+
+static void fallo_real(int sig, void *dir, void *rip)
+{
+    char msg[160];
+    int n;
+
+    n = snprintf(msg, sizeof(msg), "sim: %s en %p (instruccion en %p)\n",
+                 sig == SIGSEGV ? "acceso invalido" : "trap inesperado", dir, rip);
+    if (write(2, msg, (size_t)n) < 0) {
+        /* nada que hacer */
+    }
+    signal(sig, SIG_DFL);
+    raise(sig);
+    _exit(128 + sig);
+}
+
+static void en_sigsegv(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uintptr_t dir = (uintptr_t)si->si_addr;
+    uint8_t *rip = (uint8_t *)uc->uc_mcontext.gregs[REG_RIP];
+    uint32_t w;
+
+    if (pendiente.activo || region_de(dir) == NULL) {
+        fallo_real(sig, si->si_addr, rip);
+    }
+    host_contar();
+    ocupado++;
+
+    w = (uint32_t)dir & ~3u;
+    pendiente.activo = 1;
+    pendiente.dir = (uint32_t)dir;
+    pendiente.escritura = (uc->uc_mcontext.gregs[REG_ERR] & 2) != 0;
+    pendiente.ancho = ancho_instruccion(rip);
+    pendiente.pagina = (uint8_t *)(dir & ~(uintptr_t)0xFFF);
+
+    mprotect(pendiente.pagina, 0x1000, PROT_READ | PROT_WRITE);
+
+    /* El word accedido (y el siguiente si la instruccion lo alcanza) */
+    *(volatile uint32_t *)(uintptr_t)w = acceso_leer(w, !pendiente.escritura);
+    if ((dir & 3) + (uintptr_t)pendiente.ancho > 4 && ((w + 4) & 0xFFF) != 0) {
+        *(volatile uint32_t *)(uintptr_t)(w + 4) = acceso_leer(w + 4, !pendiente.escritura);
+    }
+
+    /* Una instruccion y volver a SIGTRAP, sin que la alarma se meta en el medio */
+    pendiente.alarma_bloqueada = sigismember(&uc->uc_sigmask, SIGALRM);
+    sigaddset(&uc->uc_sigmask, SIGALRM);
+    uc->uc_mcontext.gregs[REG_EFL] |= EFLAGS_TF;
+    ocupado--;
+}
+
+/* Paso a paso de sim_contar_instrucciones(): una instruccion del firmware
+ * que no toco registros. Cuesta un ciclo; si ya no se cuenta, apagar TF. */
+static void contar_paso(ucontext_t *uc)
+{
+    if (!contando) {
+        uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+        return;
+    }
+    instrucciones++;
+    sim_ahora++;
+    if (proximo <= sim_ahora && !ocupado) {
+        ocupado++;
+        sim_t = sim_ahora;
+        actualizar();
+        despachar();
+        ocupado--;
+    }
+}
+
+static void en_sigtrap(int sig, siginfo_t *si, void *ctx)
+{
+    ucontext_t *uc = ctx;
+    uint32_t w;
+    uint32_t lanes;
+
+    if (!pendiente.activo && si->si_code == TRAP_TRACE) {
+        contar_paso(uc);
+        return;
+    }
+    if (!pendiente.activo) {
+        fallo_real(sig, si->si_addr, (void *)uc->uc_mcontext.gregs[REG_RIP]);
+    }
+    ocupado++;
+    sim_t = sim_ahora;
+    if (contando) {
+        instrucciones++;
+    } else {
+        uc->uc_mcontext.gregs[REG_EFL] &= ~EFLAGS_TF;
+    }
+    if (!pendiente.alarma_bloqueada) {
+        sigdelset(&uc->uc_sigmask, SIGALRM);
+    }
+
+    if (pendiente.escritura) {
+        w = pendiente.dir & ~3u;
+        lanes = (pendiente.ancho >= 16) ? 0xFFFFu : ((1u << pendiente.ancho) - 1u);
+        lanes <<= pendiente.dir & 3;
+        acceso_escribir(w, *(volatile uint32_t *)(uintptr_t)w, lanes & 0xF);
+        if ((lanes >> 4) & 0xF && ((w + 4) & 0xFFF) != 0) {
+            acceso_escribir(w + 4, *(volatile uint32_t *)(uintptr_t)(w + 4), (lanes >> 4) & 0xF);
+        }
+    }
+    mprotect(pendiente.pagina, 0x1000, PROT_NONE);
+    pendiente.activo = 0;
+
+    sim_ahora += SIM_CICLOS_ACCESO;
+    accesos++;
+    actualizar();
+    despachar();
+    ocupado--;
+    host_marcar();
+}
+
+/* Cada 1 ms de la PC (0,1 ms con escala): si el firmware no toco ningun
+ * registro desde la alarma anterior, esta esperando algo; saltar al
+ * proximo evento */
+static void en_sigalrm(int sig)
+{
+    static uint64_t visto = SIM_NUNCA;
+
+    (void)sig;
+    if (ocupado || pendiente.activo) {
+        return;
+    }
+    ocupado++;
+    host_contar();
+    if (sim_ahora == visto && proximo != SIM_NUNCA && proximo > sim_ahora) {
+        sim_ahora = proximo;
+    }
+    actualizar();
+    despachar();
+    visto = sim_ahora;
+    host_marcar();
+    ocupado--;
+}
+
+/* ============================================================================
+ * 6. Acceso de bus para el GPDMA
+ * ========================================================================= */
+
+uint32_t sim_bus_leer(uint32_t dir, int ancho)
+{
+    uint32_t v;
+
+    if (region_de(dir) == NULL) {
+        switch (ancho) {
+        case 1:  return *(volatile uint8_t *)(uintptr_t)dir;
+        case 2:  return *(volatile uint16_t *)(uintptr_t)dir;
+        default: return *(volatile uint32_t *)(uintptr_t)dir;
+        }
+    }
+    v = acceso_leer(dir, 1) >> (8 * (dir & 3));
+    return ancho == 1 ? (v & 0xFF) : ancho == 2 ? (v & 0xFFFF) : v;
+}
+
+void sim_bus_escribir(uint32_t dir, uint32_t val, int ancho)
+{
+    uint32_t lanes;
+
+    if (region_de(dir) == NULL) {
+        switch (ancho) {
+        case 1:  *(volatile uint8_t *)(uintptr_t)dir = (uint8_t)val; break;
+        case 2:  *(volatile uint16_t *)(uintptr_t)dir = (uint16_t)val; break;
+        default: *(volatile uint32_t *)(uintptr_t)dir = val; break;
+        }
+        return;
+    }
+    lanes = ((1u << ancho) - 1u) << (dir & 3);
+    acceso_escribir(dir, val << (8 * (dir & 3)), lanes & 0xF);
+}
+
+/* ============================================================================
+ * 7. API publica (sim.h)
+ * ========================================================================= */
+
+uint64_t sim_ciclos(void)
+{
+    host_contar();
+    host_marcar();
+    return sim_ahora;
+}
+
+uint64_t sim_accesos(void)
+{
+    return accesos;
+}
+
+/* Mientras se cuenta la alarma queda bloqueada: cada paso ya avanza el
+ * reloj, y una signal entregada con TF prendido mete pasos de mas */
+void sim_contar_instrucciones(int activo)
+{
+    sigset_t alarma;
+
+    sigemptyset(&alarma);
+    sigaddset(&alarma, SIGALRM);
+    if (activo) {
+        sigprocmask(SIG_BLOCK, &alarma, NULL);
+        contando = 1;
+        __asm__ volatile("pushfq; orq $0x100, (%%rsp); popfq" ::: "memory", "cc");
+    } else {
+        contando = 0;
+        __asm__ volatile("pushfq; andq $~0x100, (%%rsp); popfq" ::: "memory", "cc");
+        sigprocmask(SIG_UNBLOCK, &alarma, NULL);
+    }
+}
+
+uint64_t sim_instrucciones(void)
+{
+    return instrucciones;
+}
+
+uint32_t sim_frecuencia(void)
+{
+    return sim_cclk();
+}
+
+void sim_esperar(uint64_t ciclos)
+{
+    uint64_t fin;
+
+    ocupado++;
+    host_contar();
+    fin = sim_ahora + ciclos;
+    while (proximo <= fin) {
+        if (proximo > sim_ahora) {
+            sim_ahora = proximo;
+        }
+        actualizar();
+        despachar();
+    }
+    sim_ahora = fin;
+    actualizar();
+    despachar();
+    host_marcar();
+    ocupado--;
+}
+
+void sim_irq_stats(int irq, sim_irq_stats_t *st)
+{
+    if (irq >= -1 && irq < NUM_IRQ) {
+        *st = stats[irq + 1];
+    } else {
+        memset(st, 0, sizeof(*st));
+    }
+}
+
+void sim_fatal(const char *fmt, ...)
+{
+    va_list ap;
+
+    fprintf(stderr, "sim: ");
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, " (ciclo %llu)\n", (unsigned long long)sim_ahora);
+    _exit(99);
+}
+
+static int resumen;
+
+void sim_terminar(int codigo)
+{
+    int i;
+
+    if (resumen) {
+        uint32_t hz = sim_cclk();
+
+        fprintf(stderr, "sim: %llu ciclos (%.3f ms a %u MHz)\n",
+                (unsigned long long)sim_ahora,
+                hz ? (double)sim_ahora * 1000.0 / hz : 0.0, hz / 1000000u);
+        for (i = 0; i < NUM_STATS; i++) {
+            if (stats[i].atendidas) {
+                fprintf(stderr, "sim:   %s %-3d %8u veces, latencia media %.1f max %u ciclos\n",
+                        i == 0 ? "SysTick" : "IRQ", i - 1, stats[i].atendidas,
+                        (double)stats[i].latencia_total / stats[i].atendidas,
+                        stats[i].latencia_max);
+            }
+        }
+    }
+    fflush(stdout);
+    fflush(stderr);
+    _exit(codigo);
+}
+
+/* ============================================================================
+ * 8. Arranque
+ * ========================================================================= */
+
+#define PILA_TAM        (1024 * 1024)
+
+/* El main() del firmware, renombrado por el Makefile (-Dmain=firmware_main) */
+int firmware_main(void);
+
+/* SystemInit de CMSIS, si el firmware la linkea */
+extern void SystemInit(void) __attribute__((weak));
+
+/* Estado de reset de los modelos que lo necesitan */
+void sim_uart_iniciar(void);
+void sim_emac_iniciar(void);
+void sim_usb_iniciar(void);
+
+static ucontext_t ctx_sim;
+static ucontext_t ctx_fw;
+static int codigo_fw;
+
+static void arrancar_firmware(void)
+{
+    if (SystemInit != NULL) {
+        SystemInit();
+    }
+    codigo_fw = firmware_main();
+}
+
+static void mapear(uint32_t base, uint32_t tam, int prot)
+{
+    void *p = mmap((void *)(uintptr_t)base, tam, prot,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+
+    if (p != (void *)(uintptr_t)base) {
+        sim_fatal("no se pudo mapear 0x%08X (ya usado?): compilar con -no-pie", base);
+    }
+}
+
+/* Lo minimo que tarda un acceso que no hace nada (CPUID del SCB) */
+static void calibrar_host(void)
+{
+    uint64_t min = UINT64_MAX;
+    int i;
+
+    for (i = 0; i < 256; i++) {
+        (void)*(volatile uint32_t *)0xE000ED00u;
+        if (i > 0 && tsc_ultimo < min) {
+            min = tsc_ultimo;
+        }
+    }
+    tsc_costo_trap = min;
+    sim_ahora = 0;
+    accesos = 0;
+    sim_t = 0;
+}
+
+static void iniciar(void)
+{
+    struct sigaction sa;
+    struct itimerval alarma;
+    const char *env;
+    unsigned i;
+
+    for (i = 0; i < NUM_REGIONES; i++) {
+        mapear(regiones[i].base, regiones[i].tam, PROT_NONE);
+        regiones[i].sombra = calloc(1, regiones[i].tam);
+        if (regiones[i].sombra == NULL) {
+            sim_fatal("sin memoria");
+        }
+    }
+    mapear(RAM_AHB_BASE, RAM_AHB_TAM, PROT_READ | PROT_WRITE);
+
+    env = getenv("SIM_MAX_CICLOS");
+    if (env != NULL && *env != '\0') {
+        limite = strtoull(env, NULL, 0);
+    }
+    env = getenv("SIM_ESCALA_HOST");
+    if (env != NULL && *env != '\0') {
+        escala_host = strtod(env, NULL);
+    }
+    env = getenv("SIM_RESUMEN");
+    resumen = (env != NULL && *env != '\0' && *env != '0');
+
+    sim_uart_iniciar();
+    sim_emac_iniciar();
+    sim_usb_iniciar();
+    sim_replanificar();
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+    sigemptyset(&sa.sa_mask);
+    sigaddset(&sa.sa_mask, SIGALRM);
+    sa.sa_sigaction = en_sigsegv;
+    sigaction(SIGSEGV, &sa, NULL);
+    sa.sa_sigaction = en_sigtrap;
+    sigaction(SIGTRAP, &sa, NULL);
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = en_sigalrm;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGALRM, &sa, NULL);
+
+    /* Con escala, la alarma es tambien la que interrumpe al firmware en
+     * medio de un calculo largo: mas seguido, para no agregar latencia */
+    alarma.it_interval.tv_sec = 0;
+    alarma.it_interval.tv_usec = (escala_host > 0) ? 100 : 1000;
+    alarma.it_value = alarma.it_interval;
+    setitimer(ITIMER_REAL, &alarma, NULL);
+
+    host_marcar();
+    if (escala_host > 0) {
+        calibrar_host();
+    }
+}
+
+int main(void)
+{
+    void *pila;
+
+    iniciar();
+
+    /* La pila del firmware va debajo de 4 GB: los punteros a variables
+     * locales tienen que entrar en los registros de 32 bits del GPDMA */
+    pila = mmap(NULL, PILA_TAM, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+    if (pila == MAP_FAILED) {
+        sim_fatal("no se pudo reservar la pila del firmware");
+    }
+    getcontext(&ctx_fw);
+    ctx_fw.uc_stack.ss_sp = pila;
+    ctx_fw.uc_stack.ss_size = PILA_TAM;
+    ctx_fw.uc_link = &ctx_sim;
+    makecontext(&ctx_fw, arrancar_firmware, 0);
+    swapcontext(&ctx_sim, &ctx_fw);
+
+    sim_terminar(codigo_fw);
+}
@@ -0,0 +1,497 @@
+/* ============================================================================
+ * sim_emac.c - Modelo del EMAC (Ethernet) con un PHY DP83848C
+ * ============================================================================
+ *
+ * El PHY contesta por MII como el de la placa: ID 0x20005C90, el reset de
+ * BMCR termina enseguida y el enlace esta arriba a 100 Mbit full duplex,
+ * con la autonegociacion ya completa.
+ *
+ * Recepcion: las tramas que entran con sim_emac_recibir() llegan una detras
+ * de otra, cada una en su tiempo de cable (preambulo + trama + FCS + IFG a
+ * 10 o 100 Mbit segun SUPP). Al llegar se copian a los descriptores desde
+ * RxProduceIndex, repartidas en fragmentos si no entran en uno, con los 4
+ * bytes del FCS al final como en el chip. Si no hay descriptores libres para
+ * la trama entera se pierde y se levanta RxOverrun.
+ *
+ * Transmision: al mover TxProduceIndex, las tramas entre TxConsumeIndex y
+ * TxProduceIndex salen de a una (juntando fragmentos hasta el que tiene
+ * LAST), cada una en su tiempo de cable, y se entregan a la funcion puesta
+ * con sim_emac_salida().
+ *
+ * Los filtros de recepcion, el control de flujo y Wake-on-LAN no estan
+ * modelados: se acepta todo.
+ * ========================================================================= */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_int.h"
+
+#define IRQ_ENET        28
+#define MAX_PENDIENTES  64
+#define MAX_TRAMA       2048
+
+#define PHY_DIR         1
+#define PHY_ID1         0x2000
+#define PHY_ID2         0x5C90
+
+#define MAC1_REC_EN     (1u << 0)
+#define SUPP_SPEED      (1u << 8)
+#define CMD_RX_EN       (1u << 0)
+#define CMD_TX_EN       (1u << 1)
+#define CMD_REG_RES     (1u << 3)
+#define CMD_TX_RES      (1u << 4)
+#define CMD_RX_RES      (1u << 5)
+#define MCMD_READ       (1u << 0)
+
+#define INT_RX_OVERRUN  (1u << 0)
+#define INT_RX_FIN      (1u << 2)
+#define INT_RX_DONE     (1u << 3)
+#define INT_TX_DONE     (1u << 7)
+
+#define CTRL_SIZE       0x7FFu
+#define CTRL_LAST       (1u << 30)
+#define CTRL_INT        (1u << 31)
+#define RINFO_LAST      (1u << 30)
+
+typedef struct {
+    uint8_t *datos;
+    uint32_t len;
+} pendiente_t;
+
+typedef struct {
+    /* MAC */
+    uint32_t mac1, mac2, ipgt, ipgr, clrt, maxf, supp, test, mcfg, mcmd, madr, mrdd;
+    uint32_t sa[3];
+    uint32_t command;
+    uint32_t rx_desc, rx_stat, rx_num, rx_prod, rx_cons;
+    uint32_t tx_desc, tx_stat, tx_num, tx_prod, tx_cons;
+    uint32_t rx_filter, hash_l, hash_h;
+    uint32_t int_status, int_enable, power_down;
+
+    /* PHY */
+    uint16_t phy[32];
+
+    /* Lo que esta llegando por el cable */
+    pendiente_t cola[MAX_PENDIENTES];
+    int cola_cab, cola_n;
+    uint64_t rx_fin;            /* cuando termina de llegar la primera */
+
+    /* Lo que esta saliendo */
+    uint64_t tx_fin;
+    uint32_t tx_frags;          /* descriptores de la trama que sale */
+    uint8_t tx_trama[MAX_TRAMA];
+    uint32_t tx_len;
+
+    sim_emac_salida_t salida;
+    uint32_t recibidas, perdidas, enviadas;
+} emac_t;
+
+static emac_t emac;
+
+static void *memoria(uint32_t dir)
+{
+    return (void *)(uintptr_t)dir;
+}
+
+/* --- Tiempos --------------------------------------------------------------- */
+
+/* Ciclos de CCLK que ocupa en el cable una trama de "len" bytes sin FCS */
+static uint64_t ciclos_cable(uint32_t len)
+{
+    uint64_t mbit = (emac.supp & SUPP_SPEED) ? 100 : 10;
+    uint64_t bytes = 8 + (len < 60 ? 60 : len) + 4 + 12;
+
+    return (bytes * 8 * sim_cclk()) / (mbit * 1000000u);
+}
+
+/* --- Interrupciones -------------------------------------------------------- */
+
+static void actualizar_irq(void)
+{
+    sim_irq_nivel(IRQ_ENET, (emac.int_status & emac.int_enable) != 0);
+}
+
+/* --- PHY ------------------------------------------------------------------- */
+
+static void phy_reset(void)
+{
+    memset(emac.phy, 0, sizeof(emac.phy));
+    emac.phy[0x00] = 0x3100;            /* BMCR: autoneg, 100, full */
+    emac.phy[0x01] = 0x7869 | (1u << 2);/* BMSR: capacidades, AN hecha, link */
+    emac.phy[0x02] = PHY_ID1;
+    emac.phy[0x03] = PHY_ID2;
+    emac.phy[0x04] = 0x01E1;
+    emac.phy[0x05] = 0x45E1;
+    emac.phy[0x10] = 0x0015;            /* STS: link, full duplex, AN hecha */
+}
+
+static uint16_t phy_leer(uint32_t reg)
+{
+    return emac.phy[reg & 0x1F];
+}
+
+static void phy_escribir(uint32_t reg, uint16_t val)
+{
+    reg &= 0x1F;
+    if (reg == 0x00) {
+        if (val & 0x8000) {
+            phy_reset();
+            return;
+        }
+        emac.phy[0x00] = val & ~0x0200;     /* Restart AN termina enseguida */
+        /* Velocidad y duplex forzados se reflejan en STS */
+        if (!(val & 0x1000)) {
+            emac.phy[0x10] = (uint16_t)(0x0001 | ((val & 0x2000) ? 0 : 0x0002) |
+                                        ((val & 0x0100) ? 0x0004 : 0));
+        } else {
+            emac.phy[0x10] = 0x0015;
+        }
+        return;
+    }
+    if (reg >= 0x04) {
+        emac.phy[reg] = val;
+    }
+}
+
+/* --- Recepcion ------------------------------------------------------------- */
+
+static uint32_t rx_libres(void)
+{
+    uint32_t n = emac.rx_num + 1;
+
+    return (emac.rx_cons + n - emac.rx_prod - 1) % n;
+}
+
+/* CRC-32 de Ethernet, para el FCS que se deja al final de la trama */
+static uint32_t crc32(const uint8_t *p, uint32_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    int i;
+
+    while (len--) {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static void rx_entregar(const uint8_t *datos, uint32_t len)
+{
+    uint8_t trama[MAX_TRAMA + 4];
+    uint32_t total = len + 4;
+    uint32_t crc = crc32(datos, len);
+    uint32_t hecho = 0;
+    uint32_t idx = emac.rx_prod;
+    uint32_t necesarios = 0;
+    uint32_t libres = rx_libres();
+    uint32_t i;
+
+    if (!(emac.command & CMD_RX_EN) || !(emac.mac1 & MAC1_REC_EN)) {
+        return;
+    }
+    memcpy(trama, datos, len);
+    for (i = 0; i < 4; i++) {
+        trama[len + i] = (uint8_t)(crc >> (8 * i));
+    }
+
+    /* Cuantos descriptores hacen falta, con el tamano de cada uno */
+    for (i = idx; hecho < total; i = (i + 1) % (emac.rx_num + 1)) {
+        uint32_t *d = memoria(emac.rx_desc + 8 * i);
+
+        hecho += (d[1] & CTRL_SIZE) + 1;
+        if (++necesarios > libres) {
+            emac.perdidas++;
+            emac.int_status |= INT_RX_OVERRUN;
+            actualizar_irq();
+            return;
+        }
+    }
+
+    for (hecho = 0; hecho < total; ) {
+        uint32_t *d = memoria(emac.rx_desc + 8 * idx);
+        uint32_t *st = memoria(emac.rx_stat + 8 * idx);
+        uint32_t cabe = (d[1] & CTRL_SIZE) + 1;
+        uint32_t n = total - hecho < cabe ? total - hecho : cabe;
+        int ultimo = hecho + n == total;
+
+        memcpy(memoria(d[0]), trama + hecho, n);
+        st[0] = (n - 1) | (ultimo ? RINFO_LAST : 0);
+        st[1] = 0;
+        hecho += n;
+        idx = (idx + 1) % (emac.rx_num + 1);
+        if (ultimo && (d[1] & CTRL_INT)) {
+            emac.int_status |= INT_RX_DONE;
+        }
+    }
+    emac.rx_prod = idx;
+    if (rx_libres() == 0) {
+        emac.int_status |= INT_RX_FIN;
+    }
+    emac.recibidas++;
+    actualizar_irq();
+}
+
+static void rx_proxima(uint64_t desde)
+{
+    emac.rx_fin = emac.cola_n ? desde + ciclos_cable(emac.cola[emac.cola_cab].len)
+                              : SIM_NUNCA;
+}
+
+/* --- Transmision ----------------------------------------------------------- */
+
+/* Junta los fragmentos de la trama en TxConsumeIndex; 0 si no esta entera */
+static int tx_juntar(void)
+{
+    uint32_t idx = emac.tx_cons;
+
+    emac.tx_len = 0;
+    emac.tx_frags = 0;
+    while (idx != emac.tx_prod) {
+        uint32_t *d = memoria(emac.tx_desc + 8 * idx);
+        uint32_t n = (d[1] & CTRL_SIZE) + 1;
+
+        if (emac.tx_len + n <= MAX_TRAMA) {
+            memcpy(emac.tx_trama + emac.tx_len, memoria(d[0]), n);
+            emac.tx_len += n;
+        }
+        emac.tx_frags++;
+        if (d[1] & CTRL_LAST) {
+            return 1;
+        }
+        idx = (idx + 1) % (emac.tx_num + 1);
+    }
+    return 0;
+}
+
+static void tx_arrancar(uint64_t ahora)
+{
+    if (emac.tx_fin != SIM_NUNCA || !(emac.command & CMD_TX_EN)) {
+        return;
+    }
+    if (tx_juntar()) {
+        emac.tx_fin = ahora + ciclos_cable(emac.tx_len);
+    }
+}
+
+static void tx_terminar(void)
+{
+    uint32_t ctrl = 0;
+    uint32_t i;
+
+    for (i = 0; i < emac.tx_frags; i++) {
+        uint32_t *d = memoria(emac.tx_desc + 8 * emac.tx_cons);
+        uint32_t *st = memoria(emac.tx_stat + 4 * emac.tx_cons);
+
+        ctrl = d[1];
+        st[0] = 0;
+        emac.tx_cons = (emac.tx_cons + 1) % (emac.tx_num + 1);
+    }
+    if (ctrl & CTRL_INT) {
+        emac.int_status |= INT_TX_DONE;
+    }
+    if (emac.salida != NULL) {
+        emac.salida(emac.tx_trama, emac.tx_len);
+    }
+    emac.enviadas++;
+    emac.tx_fin = SIM_NUNCA;
+    actualizar_irq();
+}
+
+/* --- Eventos --------------------------------------------------------------- */
+
+static uint64_t planificar(void)
+{
+    return emac.rx_fin < emac.tx_fin ? emac.rx_fin : emac.tx_fin;
+}
+
+static uint64_t emac_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    while (emac.rx_fin <= ahora) {
+        pendiente_t *p = &emac.cola[emac.cola_cab];
+        uint64_t fin = emac.rx_fin;
+
+        rx_entregar(p->datos, p->len);
+        free(p->datos);
+        emac.cola_cab = (emac.cola_cab + 1) % MAX_PENDIENTES;
+        emac.cola_n--;
+        rx_proxima(fin);
+    }
+    while (emac.tx_fin <= ahora) {
+        uint64_t fin = emac.tx_fin;
+
+        tx_terminar();
+        tx_arrancar(fin);
+    }
+    return planificar();
+}
+
+/* --- Registros ------------------------------------------------------------- */
+
+static uint32_t emac_mirar(sim_modelo_t *m, uint32_t off)
+{
+    (void)m;
+    switch (off) {
+    case 0x000: return emac.mac1;
+    case 0x004: return emac.mac2;
+    case 0x008: return emac.ipgt;
+    case 0x00C: return emac.ipgr;
+    case 0x010: return emac.clrt;
+    case 0x014: return emac.maxf;
+    case 0x018: return emac.supp;
+    case 0x01C: return emac.test;
+    case 0x020: return emac.mcfg;
+    case 0x024: return emac.mcmd;
+    case 0x028: return emac.madr;
+    case 0x030: return emac.mrdd;
+    case 0x034: return 0;                   /* MIND: nunca ocupado */
+    case 0x040: return emac.sa[0];
+    case 0x044: return emac.sa[1];
+    case 0x048: return emac.sa[2];
+    case 0x100: return emac.command;
+    case 0x104:
+        return ((emac.command & CMD_RX_EN) ? 1u : 0) |
+               (emac.tx_fin != SIM_NUNCA ? 2u : 0);
+    case 0x108: return emac.rx_desc;
+    case 0x10C: return emac.rx_stat;
+    case 0x110: return emac.rx_num;
+    case 0x114: return emac.rx_prod;
+    case 0x118: return emac.rx_cons;
+    case 0x11C: return emac.tx_desc;
+    case 0x120: return emac.tx_stat;
+    case 0x124: return emac.tx_num;
+    case 0x128: return emac.tx_prod;
+    case 0x12C: return emac.tx_cons;
+    case 0x200: return emac.rx_filter;
+    case 0x210: return emac.hash_l;
+    case 0x214: return emac.hash_h;
+    case 0xFE0: return emac.int_status;
+    case 0xFE4: return emac.int_enable;
+    case 0xFF4: return emac.power_down;
+    case 0xFFC: return 0x39022001u;         /* Module_ID */
+    }
+    return 0;
+}
+
+static void emac_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    (void)lanes;
+    switch (off) {
+    case 0x000: emac.mac1 = val & 0xCF1F; break;
+    case 0x004: emac.mac2 = val & 0x73FF; break;
+    case 0x008: emac.ipgt = val & 0x7F; break;
+    case 0x00C: emac.ipgr = val & 0x7F7F; break;
+    case 0x010: emac.clrt = val & 0x3F0F; break;
+    case 0x014: emac.maxf = val & 0xFFFF; break;
+    case 0x018: emac.supp = val & 0x900; break;
+    case 0x01C: emac.test = val & 7; break;
+    case 0x020: emac.mcfg = val & 0x803D; break;
+    case 0x024:
+        emac.mcmd = val & 3;
+        if ((val & MCMD_READ) && ((emac.madr >> 8) & 0x1F) == PHY_DIR) {
+            emac.mrdd = phy_leer(emac.madr);
+        } else if (val & MCMD_READ) {
+            emac.mrdd = 0xFFFF;
+        }
+        break;
+    case 0x028: emac.madr = val & 0x1F1F; break;
+    case 0x02C:
+        if (((emac.madr >> 8) & 0x1F) == PHY_DIR) {
+            phy_escribir(emac.madr, (uint16_t)val);
+        }
+        break;
+    case 0x040: case 0x044: case 0x048:
+        emac.sa[(off - 0x040) / 4] = val & 0xFFFF;
+        break;
+    case 0x100:
+        emac.command = val & 0x7E3;
+        if (val & (CMD_REG_RES | CMD_RX_RES)) {
+            emac.rx_prod = emac.rx_cons = 0;
+        }
+        if (val & (CMD_REG_RES | CMD_TX_RES)) {
+            emac.tx_prod = emac.tx_cons = 0;
+            emac.tx_fin = SIM_NUNCA;
+        }
+        break;
+    case 0x108: emac.rx_desc = val & ~3u; break;
+    case 0x10C: emac.rx_stat = val & ~7u; break;
+    case 0x110: emac.rx_num = val & 0xFFFF; break;
+    case 0x118: emac.rx_cons = (val & 0xFFFF) % (emac.rx_num + 1); break;
+    case 0x11C: emac.tx_desc = val & ~3u; break;
+    case 0x120: emac.tx_stat = val & ~3u; break;
+    case 0x124: emac.tx_num = val & 0xFFFF; break;
+    case 0x128: emac.tx_prod = (val & 0xFFFF) % (emac.tx_num + 1); break;
+    case 0x200: emac.rx_filter = val & 0x303F; break;
+    case 0x210: emac.hash_l = val; break;
+    case 0x214: emac.hash_h = val; break;
+    case 0xFE4: emac.int_enable = val & 0x30FF; break;
+    case 0xFE8: emac.int_status &= ~val; break;
+    case 0xFEC: emac.int_status |= val & 0x30FF; break;
+    case 0xFF4: emac.power_down = val & 0x80000000u; break;
+    }
+    tx_arrancar(sim_t);
+    actualizar_irq();
+    m->proximo = planificar();
+    sim_replanificar();
+}
+
+sim_modelo_t sim_modelo_emac = {
+    "EMAC", 0x50000000u, 0x1000, emac_mirar, emac_mirar, emac_escribir,
+    emac_avanzar, &emac, SIM_NUNCA
+};
+
+/* --- API publica ----------------------------------------------------------- */
+
+void sim_emac_recibir(const void *trama, uint32_t len)
+{
+    pendiente_t *p;
+
+    sim_bloquear();
+    if (len > MAX_TRAMA || emac.cola_n == MAX_PENDIENTES) {
+        emac.perdidas++;
+        sim_desbloquear();
+        return;
+    }
+    p = &emac.cola[(emac.cola_cab + emac.cola_n) % MAX_PENDIENTES];
+    p->datos = malloc(len ? len : 1);
+    if (p->datos == NULL) {
+        sim_fatal("sin memoria");
+    }
+    memcpy(p->datos, trama, len);
+    p->len = len;
+    if (emac.cola_n++ == 0) {
+        rx_proxima(sim_t);
+        sim_programar(&sim_modelo_emac, emac.rx_fin);
+    }
+    sim_desbloquear();
+}
+
+void sim_emac_salida(sim_emac_salida_t fn)
+{
+    emac.salida = fn;
+}
+
+uint32_t sim_emac_recibidas(void)
+{
+    return emac.recibidas;
+}
+
+uint32_t sim_emac_perdidas(void)
+{
+    return emac.perdidas;
+}
+
+uint32_t sim_emac_enviadas(void)
+{
+    return emac.enviadas;
+}
+
+void sim_emac_iniciar(void)
+{
+    phy_reset();
+    emac.rx_fin = SIM_NUNCA;
+    emac.tx_fin = SIM_NUNCA;
+}
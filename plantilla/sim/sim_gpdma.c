@@ -0,0 +1,268 @@
+/* ============================================================================
+ * sim_gpdma.c - Modelo del GPDMA (8 canales, listas enlazadas)
+ * ============================================================================
+ *
+ * Mueve un dato por evento, del canal listo de mayor prioridad (el 0 gana),
+ * y tarda CICLOS_POR_DATO ciclos en cada uno. Un canal esta listo si es
+ * memoria a memoria o si el periferico de su conexion pide DMA (FIFO de la
+ * UART o de la SSP con lugar o con datos, match del timer, DAC o ADC). Los
+ * perifericos sin modelo (I2S) nunca piden.
+ *
+ * Al terminar el TransferSize levanta el TC (si Control.I esta en 1) y
+ * carga el siguiente LLI de memoria; sin LLI el canal se apaga. Los datos
+ * pasan por sim_bus_leer/escribir, asi que un registro de periferico como
+ * destino tiene los mismos efectos que si lo escribiera el CPU.
+ * ========================================================================= */
+
+#include "sim_int.h"
+
+#define NUM_CANALES     8
+#define IRQ_DMA         26
+#define CICLOS_POR_DATO 3
+
+#define CFG_E           (1u << 0)
+#define CFG_IE          (1u << 14)
+#define CFG_ITC         (1u << 15)
+#define CFG_H           (1u << 18)
+#define CTRL_SI         (1u << 26)
+#define CTRL_DI         (1u << 27)
+#define CTRL_I          (1u << 31)
+
+#define DMAREQSEL       0x400FC1C4u
+
+typedef struct {
+    uint32_t src, dst, lli, control, config;
+} canal_t;
+
+typedef struct {
+    canal_t canal[NUM_CANALES];
+    uint32_t raw_tc;
+    uint32_t raw_err;
+    uint32_t config;
+    uint32_t sync;
+} gpdma_t;
+
+static gpdma_t dma;
+
+static uint32_t int_tc(void)
+{
+    uint32_t v = 0;
+    int i;
+
+    for (i = 0; i < NUM_CANALES; i++) {
+        if ((dma.raw_tc & (1u << i)) && (dma.canal[i].config & CFG_ITC)) {
+            v |= 1u << i;
+        }
+    }
+    return v;
+}
+
+static uint32_t int_err(void)
+{
+    uint32_t v = 0;
+    int i;
+
+    for (i = 0; i < NUM_CANALES; i++) {
+        if ((dma.raw_err & (1u << i)) && (dma.canal[i].config & CFG_IE)) {
+            v |= 1u << i;
+        }
+    }
+    return v;
+}
+
+static void actualizar_irq(void)
+{
+    sim_irq_nivel(IRQ_DMA, (int_tc() | int_err()) != 0);
+}
+
+/* --- Pedidos de los perifericos ------------------------------------------- */
+
+/* Conexion 8..15: UART (DMAREQSEL = 0) o match de timer (DMAREQSEL = 1) */
+static int es_match(int conexion)
+{
+    return conexion >= 8 && ((sim_bus_leer(DMAREQSEL, 4) >> (conexion - 8)) & 1);
+}
+
+static int pide(int conexion)
+{
+    if (conexion >= 8) {
+        if (es_match(conexion)) {
+            return sim_timer_dma_pide((conexion - 8) / 2, conexion & 1);
+        }
+        return sim_uart_dma_pide((conexion - 8) / 2, conexion & 1);
+    }
+    switch (conexion) {
+    case 0: case 1: case 2: case 3:
+        return sim_ssp_dma_pide(conexion / 2, conexion & 1);
+    case 4: return sim_adc_dma_pide();
+    case 7: return sim_dac_dma_pide();
+    }
+    return 0;
+}
+
+static void atendido(int conexion)
+{
+    if (es_match(conexion)) {
+        sim_timer_dma_atendido((conexion - 8) / 2, conexion & 1);
+    } else if (conexion == 7) {
+        sim_dac_dma_atendido();
+    }
+}
+
+static int listo(canal_t *c)
+{
+    uint32_t flujo = (c->config >> 11) & 7;
+
+    if (!(c->config & CFG_E) || (c->config & CFG_H)) {
+        return 0;
+    }
+    switch (flujo) {
+    case 0: return 1;                                   /* M2M */
+    case 1: return pide((c->config >> 6) & 0x1F);       /* M2P */
+    case 2: return pide((c->config >> 1) & 0x1F);       /* P2M */
+    default:
+        return pide((c->config >> 1) & 0x1F) && pide((c->config >> 6) & 0x1F);
+    }
+}
+
+/* --- Transferencia --------------------------------------------------------- */
+
+static void cargar_lli(canal_t *c)
+{
+    uint32_t lli = c->lli & ~3u;
+
+    c->src = sim_bus_leer(lli, 4);
+    c->dst = sim_bus_leer(lli + 4, 4);
+    c->lli = sim_bus_leer(lli + 8, 4);
+    c->control = sim_bus_leer(lli + 12, 4);
+}
+
+static void mover_dato(int n)
+{
+    canal_t *c = &dma.canal[n];
+    int sw = 1 << ((c->control >> 18) & 3);
+    int dw = 1 << ((c->control >> 21) & 3);
+    uint32_t flujo = (c->config >> 11) & 7;
+    uint32_t v;
+
+    if ((c->control & 0xFFF) != 0) {
+        v = sim_bus_leer(c->src, sw);
+        sim_bus_escribir(c->dst, v, dw);
+        if (c->control & CTRL_SI) {
+            c->src += (uint32_t)sw;
+        }
+        if (c->control & CTRL_DI) {
+            c->dst += (uint32_t)dw;
+        }
+        c->control--;
+        if (flujo == 1 || flujo == 3) {
+            atendido((c->config >> 6) & 0x1F);
+        }
+        if (flujo == 2 || flujo == 3) {
+            atendido((c->config >> 1) & 0x1F);
+        }
+    }
+
+    if ((c->control & 0xFFF) == 0) {
+        if (c->control & CTRL_I) {
+            dma.raw_tc |= 1u << n;
+        }
+        if (c->lli != 0) {
+            cargar_lli(c);
+        } else {
+            c->config &= ~CFG_E;
+        }
+        actualizar_irq();
+    }
+}
+
+static uint64_t gpdma_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    int i;
+
+    (void)m;
+    if (!(dma.config & 1)) {
+        return SIM_NUNCA;
+    }
+    for (i = 0; i < NUM_CANALES; i++) {
+        if (listo(&dma.canal[i])) {
+            mover_dato(i);
+            return ahora + CICLOS_POR_DATO;
+        }
+    }
+    return SIM_NUNCA;
+}
+
+/* --- Registros ------------------------------------------------------------- */
+
+static uint32_t gpdma_mirar(sim_modelo_t *m, uint32_t off)
+{
+    uint32_t v = 0;
+    int i;
+
+    (void)m;
+    if (off >= 0x100 && off < 0x100 + NUM_CANALES * 0x20) {
+        canal_t *c = &dma.canal[(off - 0x100) / 0x20];
+
+        switch (off % 0x20) {
+        case 0x00: return c->src;
+        case 0x04: return c->dst;
+        case 0x08: return c->lli;
+        case 0x0C: return c->control;
+        case 0x10: return c->config;
+        }
+        return 0;
+    }
+    switch (off) {
+    case 0x00: return int_tc() | int_err();
+    case 0x04: return int_tc();
+    case 0x0C: return int_err();
+    case 0x14: return dma.raw_tc;
+    case 0x18: return dma.raw_err;
+    case 0x1C:
+        for (i = 0; i < NUM_CANALES; i++) {
+            if (dma.canal[i].config & CFG_E) {
+                v |= 1u << i;
+            }
+        }
+        return v;
+    case 0x30: return dma.config;
+    case 0x34: return dma.sync;
+    }
+    return 0;
+}
+
+static void gpdma_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    (void)lanes;
+    if (off >= 0x100 && off < 0x100 + NUM_CANALES * 0x20) {
+        canal_t *c = &dma.canal[(off - 0x100) / 0x20];
+
+        switch (off % 0x20) {
+        case 0x00: c->src = val; break;
+        case 0x04: c->dst = val; break;
+        case 0x08: c->lli = val; break;
+        case 0x0C: c->control = val; break;
+        case 0x10: c->config = val & 0x7FFFF; break;
+        }
+    } else {
+        switch (off) {
+        case 0x08: dma.raw_tc &= ~(val & 0xFF); break;
+        case 0x10: dma.raw_err &= ~(val & 0xFF); break;
+        case 0x30: dma.config = val & 3; break;
+        case 0x34: dma.sync = val & 0xFFFF; break;
+        }
+        actualizar_irq();
+    }
+    sim_programar(m, sim_t);
+}
+
+sim_modelo_t sim_modelo_gpdma = {
+    "GPDMA", 0x50004000u, 0x200, gpdma_mirar, gpdma_mirar, gpdma_escribir,
+    gpdma_avanzar, &dma, SIM_NUNCA
+};
+
+void sim_gpdma_despertar(void)
+{
+    sim_programar(&sim_modelo_gpdma, sim_t);
+}
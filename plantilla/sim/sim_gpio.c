@@ -0,0 +1,222 @@
+/* ============================================================================
+ * sim_gpio.c - Modelo del GPIO rapido (P0..P4) y sus interrupciones
+ * ============================================================================
+ *
+ * Cada pin tiene un latch de salida (lo que escribe el firmware) y un nivel
+ * externo (lo que pone sim_gpio_entrada). FIOPIN lee el latch en los pines
+ * de salida y el nivel externo en los de entrada, respetando FIOMASK.
+ *
+ * Las interrupciones por flanco de P0 y P2 (IO0Int*, IO2Int*) salen por la
+ * linea de EINT3, como en el chip.
+ * ========================================================================= */
+
+#include "sim_int.h"
+
+#define NUM_PUERTOS     5
+#define IRQ_EINT3       21
+
+typedef struct {
+    uint32_t dir;
+    uint32_t mask;
+    uint32_t latch;
+    uint32_t externo;
+} puerto_t;
+
+typedef struct {
+    uint32_t en_r, en_f;
+    uint32_t stat_r, stat_f;
+} gpioint_t;
+
+static puerto_t puertos[NUM_PUERTOS];
+static gpioint_t gpioint[2];                /* P0 y P2 */
+
+static uint32_t pines(puerto_t *p)
+{
+    return (p->latch & p->dir) | (p->externo & ~p->dir);
+}
+
+/* --- Interrupciones ------------------------------------------------------- */
+
+static void gpioint_irq(void)
+{
+    int activa = 0;
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        activa |= (gpioint[i].stat_r | gpioint[i].stat_f) != 0;
+    }
+    sim_irq_nivel(IRQ_EINT3, activa);
+}
+
+/* Los pines de un puerto pasaron de "antes" a lo que hay ahora */
+static void flancos(int n, uint32_t antes)
+{
+    gpioint_t *g;
+    uint32_t ahora;
+
+    if (n != 0 && n != 2) {
+        return;
+    }
+    g = &gpioint[n / 2];
+    ahora = pines(&puertos[n]);
+    g->stat_r |= ~antes & ahora & g->en_r;
+    g->stat_f |= antes & ~ahora & g->en_f;
+    gpioint_irq();
+}
+
+/* --- GPIO ------------------------------------------------------------------ */
+
+static uint32_t mascara_lanes(uint32_t lanes)
+{
+    uint32_t m = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (lanes & (1u << i)) {
+            m |= 0xFFu << (8 * i);
+        }
+    }
+    return m;
+}
+
+static uint32_t gpio_mirar(sim_modelo_t *m, uint32_t off)
+{
+    puerto_t *p;
+
+    (void)m;
+    if (off / 0x20 >= NUM_PUERTOS) {
+        return 0;
+    }
+    p = &puertos[off / 0x20];
+    switch (off % 0x20) {
+    case 0x00: return p->dir;
+    case 0x10: return p->mask;
+    case 0x14: return pines(p) & ~p->mask;
+    case 0x18: return p->latch;
+    }
+    return 0;
+}
+
+static void gpio_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    uint32_t bytes = mascara_lanes(lanes);
+    uint32_t antes;
+    puerto_t *p;
+    int n = (int)(off / 0x20);
+
+    (void)m;
+    if (n >= NUM_PUERTOS) {
+        return;
+    }
+    p = &puertos[n];
+    antes = pines(p);
+    switch (off % 0x20) {
+    case 0x00:
+        p->dir = (p->dir & ~bytes) | (val & bytes);
+        break;
+    case 0x10:
+        p->mask = (p->mask & ~bytes) | (val & bytes);
+        break;
+    case 0x14:
+        bytes &= ~p->mask;
+        p->latch = (p->latch & ~bytes) | (val & bytes);
+        break;
+    case 0x18:
+        p->latch |= val & bytes & ~p->mask;
+        break;
+    case 0x1C:
+        p->latch &= ~(val & bytes & ~p->mask);
+        break;
+    }
+    flancos(n, antes);
+}
+
+static uint64_t sin_eventos(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    (void)ahora;
+    return SIM_NUNCA;
+}
+
+sim_modelo_t sim_modelo_gpio = {
+    "GPIO", 0x2009C000u, 0x4000, gpio_mirar, gpio_mirar, gpio_escribir,
+    sin_eventos, puertos, SIM_NUNCA
+};
+
+/* --- GPIOINT (desde 0x40028080) -------------------------------------------- */
+
+static uint32_t gpioint_mirar(sim_modelo_t *m, uint32_t off)
+{
+    gpioint_t *g;
+
+    (void)m;
+    if (off == 0x00) {
+        return (gpioint[0].stat_r | gpioint[0].stat_f ? 1u : 0) |
+               (gpioint[1].stat_r | gpioint[1].stat_f ? 4u : 0);
+    }
+    if (off < 0x04 || off >= 0x38) {
+        return 0;
+    }
+    g = &gpioint[off >= 0x24];
+    switch ((off - 0x04) % 0x20) {
+    case 0x00: return g->stat_r;
+    case 0x04: return g->stat_f;
+    case 0x0C: return g->en_r;
+    case 0x10: return g->en_f;
+    }
+    return 0;
+}
+
+static void gpioint_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    gpioint_t *g;
+
+    (void)m;
+    val &= mascara_lanes(lanes);
+    if (off < 0x04 || off >= 0x38) {
+        return;
+    }
+    g = &gpioint[off >= 0x24];
+    switch ((off - 0x04) % 0x20) {
+    case 0x08:                                      /* IOxIntClr */
+        g->stat_r &= ~val;
+        g->stat_f &= ~val;
+        break;
+    case 0x0C: g->en_r = val; break;
+    case 0x10: g->en_f = val; break;
+    }
+    gpioint_irq();
+}
+
+sim_modelo_t sim_modelo_gpioint = {
+    "GPIOINT", 0x40028080u, 0x40, gpioint_mirar, gpioint_mirar, gpioint_escribir,
+    sin_eventos, gpioint, SIM_NUNCA
+};
+
+/* --- API publica ----------------------------------------------------------- */
+
+void sim_gpio_entrada(int puerto, int pin, int nivel)
+{
+    puerto_t *p;
+    uint32_t antes;
+
+    if (puerto < 0 || puerto >= NUM_PUERTOS || pin < 0 || pin > 31) {
+        return;
+    }
+    p = &puertos[puerto];
+    antes = pines(p);
+    if (nivel) {
+        p->externo |= 1u << pin;
+    } else {
+        p->externo &= ~(1u << pin);
+    }
+    flancos(puerto, antes);
+}
+
+uint32_t sim_gpio_pines(int puerto)
+{
+    if (puerto < 0 || puerto >= NUM_PUERTOS) {
+        return 0;
+    }
+    return pines(&puertos[puerto]);
+}
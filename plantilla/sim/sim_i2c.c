@@ -0,0 +1,266 @@
+/* ============================================================================
+ * sim_i2c.c - Modelo de las I2C0..2 (modo maestro)
+ * ============================================================================
+ *
+ * La maquina de estados del maestro, con los mismos codigos de I2STAT que
+ * el chip (0x08 START, 0x18 SLA+W con ACK, 0x50 dato recibido con ACK...).
+ * Cuando el firmware baja SI el controlador mira CONSET recien al terminar
+ * el semiciclo bajo de SCL (SCLL ciclos de PCLK), asi que un STA o STO
+ * escrito justo despues de bajar SI todavia cuenta, como en el chip. Cada
+ * paso tarda lo que tarda en el bus: 9 bits para un byte con su ACK, 1 bit
+ * para START/STOP, con un bit de (SCLH + SCLL) ciclos de PCLK.
+ *
+ * En cada bus hay colgada una memoria tipo 24xx de 256 bytes en la
+ * direccion 0x50: el primer byte despues de SLA+W fija el puntero, los
+ * siguientes se escriben ahi; las lecturas devuelven desde el puntero, que
+ * avanza solo. Cualquier otra direccion no contesta (NACK).
+ *
+ * El modo esclavo y el monitor no estan modelados.
+ * ========================================================================= */
+
+#include <stddef.h>
+
+#include "sim_int.h"
+
+#define DIR_MEMORIA     0x50
+
+#define CON_AA          (1u << 2)
+#define CON_SI          (1u << 3)
+#define CON_STO         (1u << 4)
+#define CON_STA         (1u << 5)
+#define CON_I2EN        (1u << 6)
+
+typedef struct {
+    int irq;
+    int campo_pclk;
+
+    uint32_t conset, stat, dat, adr, sclh, scll;
+
+    /* Paso del bus en curso: en "fin" queda I2STAT = prox_stat, o, si
+     * "decidir", se mira CONSET para ver cual es el paso siguiente */
+    uint64_t fin;
+    uint32_t prox_stat;
+    int prox_si;
+    int decidir;
+
+    /* La memoria del bus */
+    uint8_t mem[256];
+    uint8_t puntero;
+    int esperando_puntero;
+    int seleccionada;
+
+    uint32_t bytes;
+} i2c_t;
+
+#define I2C(i, p) \
+    { .irq = 10 + (i), .campo_pclk = (p), .stat = 0xF8, .sclh = 4, .scll = 4, \
+      .fin = SIM_NUNCA }
+
+static i2c_t i2cs[3] = {
+    I2C(0, SIM_PCLK_I2C0),
+    I2C(1, SIM_PCLK_I2C1),
+    I2C(2, SIM_PCLK_I2C2),
+};
+
+#undef I2C
+
+static uint64_t ciclos_scl_bajo(i2c_t *c)
+{
+    return (uint64_t)(c->scll < 4 ? 4 : c->scll) * sim_pclk_div(c->campo_pclk);
+}
+
+static uint64_t ciclos_por_bit(i2c_t *c)
+{
+    uint32_t h = c->sclh < 4 ? 4 : c->sclh;
+
+    return (uint64_t)h * sim_pclk_div(c->campo_pclk) + ciclos_scl_bajo(c);
+}
+
+static void actualizar_irq(i2c_t *c)
+{
+    sim_irq_nivel(c->irq, (c->conset & (CON_I2EN | CON_SI)) == (CON_I2EN | CON_SI));
+}
+
+/* --- El esclavo ------------------------------------------------------------ */
+
+static int esclavo_direccion(i2c_t *c, uint32_t sla)
+{
+    c->seleccionada = (sla >> 1) == DIR_MEMORIA;
+    c->esperando_puntero = c->seleccionada && !(sla & 1);
+    return c->seleccionada;
+}
+
+static int esclavo_recibe(i2c_t *c, uint8_t b)
+{
+    if (!c->seleccionada) {
+        return 0;
+    }
+    if (c->esperando_puntero) {
+        c->puntero = b;
+        c->esperando_puntero = 0;
+    } else {
+        c->mem[c->puntero++] = b;
+    }
+    return 1;
+}
+
+static uint8_t esclavo_envia(i2c_t *c)
+{
+    return c->seleccionada ? c->mem[c->puntero++] : 0xFF;
+}
+
+/* --- Maestro --------------------------------------------------------------- */
+
+static void programar_paso(i2c_t *c, uint64_t ahora, int bits, uint32_t stat, int si)
+{
+    c->fin = ahora + (uint64_t)bits * ciclos_por_bit(c);
+    c->prox_stat = stat;
+    c->prox_si = si;
+}
+
+/* SI esta abajo: ver que pidio el firmware y arrancar el paso siguiente */
+static void paso(i2c_t *c, uint64_t ahora)
+{
+    int en_bus = c->stat != 0xF8;
+    int ack;
+
+    if ((c->conset & CON_SI) || !(c->conset & CON_I2EN)) {
+        return;
+    }
+    if (c->conset & CON_STO) {
+        c->conset &= ~CON_STO;
+        c->seleccionada = 0;
+        if (en_bus) {
+            programar_paso(c, ahora, 1, 0xF8, 0);
+            return;
+        }
+    }
+    if (c->conset & CON_STA) {
+        programar_paso(c, ahora, 1, en_bus ? 0x10 : 0x08, 1);
+        return;
+    }
+
+    switch (c->stat) {
+    case 0x08:
+    case 0x10:
+        ack = esclavo_direccion(c, c->dat);
+        if (c->dat & 1) {
+            programar_paso(c, ahora, 9, ack ? 0x40 : 0x48, 1);
+        } else {
+            programar_paso(c, ahora, 9, ack ? 0x18 : 0x20, 1);
+        }
+        break;
+    case 0x18:
+    case 0x28:
+        ack = esclavo_recibe(c, (uint8_t)c->dat);
+        programar_paso(c, ahora, 9, ack ? 0x28 : 0x30, 1);
+        c->bytes++;
+        break;
+    case 0x40:
+    case 0x50:
+        c->dat = esclavo_envia(c);
+        programar_paso(c, ahora, 9, (c->conset & CON_AA) ? 0x50 : 0x58, 1);
+        c->bytes++;
+        break;
+    }
+}
+
+/* Con SI abajo y el bus libre, decidir al final del semiciclo bajo de SCL */
+static void soltar(i2c_t *c, uint64_t ahora)
+{
+    if (c->fin != SIM_NUNCA || (c->conset & CON_SI) || !(c->conset & CON_I2EN)) {
+        return;
+    }
+    c->fin = ahora + ciclos_scl_bajo(c);
+    c->decidir = 1;
+}
+
+static uint64_t i2c_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    i2c_t *c = m->estado;
+
+    while (c->fin <= ahora) {
+        uint64_t fin = c->fin;
+
+        c->fin = SIM_NUNCA;
+        if (c->decidir) {
+            c->decidir = 0;
+            paso(c, fin);
+            continue;
+        }
+        c->stat = c->prox_stat;
+        if (c->prox_si) {
+            c->conset |= CON_SI;
+        }
+        soltar(c, fin);
+    }
+    actualizar_irq(c);
+    return c->fin;
+}
+
+/* --- Registros ------------------------------------------------------------- */
+
+static uint32_t i2c_mirar(sim_modelo_t *m, uint32_t off)
+{
+    i2c_t *c = m->estado;
+
+    switch (off) {
+    case 0x00: return c->conset;
+    case 0x04: return c->stat;
+    case 0x08: return c->dat;
+    case 0x0C: return c->adr;
+    case 0x10: return c->sclh;
+    case 0x14: return c->scll;
+    }
+    return 0;
+}
+
+static void i2c_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    i2c_t *c = m->estado;
+
+    (void)lanes;
+    switch (off) {
+    case 0x00:
+        c->conset |= val & (CON_AA | CON_SI | CON_STO | CON_STA | CON_I2EN);
+        break;
+    case 0x08: c->dat = val & 0xFF; break;
+    case 0x0C: c->adr = val & 0xFF; break;
+    case 0x10: c->sclh = val & 0xFFFF; break;
+    case 0x14: c->scll = val & 0xFFFF; break;
+    case 0x18:
+        c->conset &= ~(val & (CON_AA | CON_SI | CON_STA | CON_I2EN));
+        if (!(c->conset & CON_I2EN)) {
+            c->stat = 0xF8;
+            c->fin = SIM_NUNCA;
+            c->decidir = 0;
+        }
+        break;
+    }
+    soltar(c, sim_t);
+    m->proximo = c->fin;
+    sim_replanificar();
+    actualizar_irq(c);
+}
+
+#define I2C(i, b) \
+    { "I2C" #i, b, 0x4000, i2c_mirar, i2c_mirar, i2c_escribir, \
+      i2c_avanzar, &i2cs[i], SIM_NUNCA }
+
+sim_modelo_t sim_modelo_i2c[3] = {
+    I2C(0, 0x4001C000u),
+    I2C(1, 0x4005C000u),
+    I2C(2, 0x400A0000u),
+};
+
+/* --- API publica ----------------------------------------------------------- */
+
+uint8_t *sim_i2c_memoria(int bus)
+{
+    return (bus >= 0 && bus < 3) ? i2cs[bus].mem : NULL;
+}
+
+uint32_t sim_i2c_bytes(int bus)
+{
+    return (bus >= 0 && bus < 3) ? i2cs[bus].bytes : 0;
+}
@@ -0,0 +1,135 @@
+/* ============================================================================
+ * sim_int.h - Lo que comparten entre si los modelos del simulador
+ * ============================================================================
+ *
+ * No lo incluye el firmware: es la interfaz entre el nucleo (sim_core.c) y
+ * cada modelo de periferico (sim_uart.c, sim_timer.c, ...).
+ *
+ * Un modelo es una ventana de direcciones con cuatro funciones:
+ *
+ *   leer      el CPU leyo un registro. Puede tener efectos (leer RBR saca un
+ *             byte de la FIFO, leer IIR baja la interrupcion de THRE...)
+ *   mirar     el mismo valor pero SIN efectos. Se usa cuando la instruccion
+ *             lee y escribe a la vez (por ejemplo REG |= x en una sola
+ *             instruccion x86) y para que el GPDMA pueda consultar estado.
+ *   escribir  el CPU escribio. "lanes" dice que bytes del word escribio de
+ *             verdad (0x1 = solo el byte 0, 0xF = el word entero), para que
+ *             los registros "escribir 1 para borrar" no borren de mas.
+ *   avanzar   el reloj llego a "ahora": procesar lo que haya vencido (un byte
+ *             que termino de salir, un match del timer...) y devolver cuando
+ *             es el proximo evento (SIM_NUNCA si no hay ninguno).
+ *
+ * Las direcciones que recibe cada funcion son offsets desde la base del
+ * modelo, alineados a 4.
+ * ========================================================================= */
+
+#ifndef SIM_INT_H
+#define SIM_INT_H
+
+#include <stdint.h>
+#include "sim.h"
+
+#define SIM_NUNCA       UINT64_MAX
+
+typedef struct sim_modelo {
+    const char *nombre;
+    uint32_t base;
+    uint32_t tam;
+    uint32_t (*leer)(struct sim_modelo *m, uint32_t off);
+    uint32_t (*mirar)(struct sim_modelo *m, uint32_t off);
+    void     (*escribir)(struct sim_modelo *m, uint32_t off, uint32_t val, uint32_t lanes);
+    uint64_t (*avanzar)(struct sim_modelo *m, uint64_t ahora);
+    void *estado;
+    uint64_t proximo;       /* proximo evento del modelo, SIM_NUNCA si no hay */
+} sim_modelo_t;
+
+/* --- Nucleo (sim_core.c) -------------------------------------------------- */
+
+/* Reloj del CPU, en ciclos de CCLK desde el arranque */
+extern uint64_t sim_ahora;
+
+/* Momento de lo que esta pasando: sim_ahora para un acceso del CPU, o el
+ * instante del evento que se esta procesando dentro de avanzar(). Los
+ * modelos lo usan para fechar lo que disparan desde otros modelos. */
+extern uint64_t sim_t;
+
+/* Nivel de una linea de interrupcion (numero de IRQ del NVIC, 0..34).
+ * Las lineas de los perifericos son por nivel: mientras esten arriba, el
+ * NVIC vuelve a pender la IRQ al salir del handler. */
+void sim_irq_nivel(int irq, int nivel);
+
+/* Un modelo cambio su campo "proximo": recalcular el minimo */
+void sim_replanificar(void);
+
+/* Programa el proximo evento de un modelo (si es antes que el que tenia) */
+void sim_programar(sim_modelo_t *m, uint64_t cuando);
+
+/* Entre las dos, la API publica de un modelo cambia su estado sin que la
+ * alarma o el conteo de instrucciones (signals que llegan en cualquier
+ * instruccion del host) corran un avanzar() a medio cambio */
+void sim_bloquear(void);
+void sim_desbloquear(void);
+
+/* Acceso de bus para el GPDMA: periferico simulado o memoria del host */
+uint32_t sim_bus_leer(uint32_t dir, int ancho);
+void sim_bus_escribir(uint32_t dir, uint32_t val, int ancho);
+
+/* Error fatal del simulador (no del firmware) */
+void sim_fatal(const char *fmt, ...) __attribute__((noreturn, format(printf, 1, 2)));
+
+/* --- Relojes (sim_sc.c) --------------------------------------------------- */
+
+/* Frecuencia del core segun los registros de clock */
+uint32_t sim_cclk(void);
+
+/* Divisor de PCLK de un periferico: su campo de 2 bits en PCLKSEL0/1.
+ * "campo" es el numero de bit del campo en PCLKSEL0 (0..30) o 32 + el bit
+ * en PCLKSEL1. Devuelve 1, 2, 4 u 8. */
+uint32_t sim_pclk_div(int campo);
+
+#define SIM_PCLK_TIMER0     2
+#define SIM_PCLK_TIMER1     4
+#define SIM_PCLK_UART0      6
+#define SIM_PCLK_UART1      8
+#define SIM_PCLK_ADC        24
+#define SIM_PCLK_DAC        22
+#define SIM_PCLK_TIMER2     (32 + 12)
+#define SIM_PCLK_TIMER3     (32 + 14)
+#define SIM_PCLK_UART2      (32 + 16)
+#define SIM_PCLK_UART3      (32 + 18)
+#define SIM_PCLK_SSP0       (32 + 10)
+#define SIM_PCLK_SSP1       20
+#define SIM_PCLK_I2C0       14
+#define SIM_PCLK_I2C1       (32 + 6)
+#define SIM_PCLK_I2C2       (32 + 20)
+
+/* --- Pedidos de DMA (los consulta sim_gpdma.c) ---------------------------- */
+
+/* Conexion GPDMA (0..15, con DMAREQSEL ya resuelto a UART/MAT) lista para
+ * una transferencia. Devuelve 1 si el periferico pide DMA. */
+int sim_uart_dma_pide(int uart, int rx);
+int sim_ssp_dma_pide(int ssp, int rx);
+int sim_timer_dma_pide(int timer, int mr);
+void sim_timer_dma_atendido(int timer, int mr);
+int sim_adc_dma_pide(void);
+int sim_dac_dma_pide(void);
+void sim_dac_dma_atendido(void);
+
+/* El GPDMA escribio o leyo algo y quizas hay que moverse */
+void sim_gpdma_despertar(void);
+
+/* Modelos */
+extern sim_modelo_t sim_modelo_sc;
+extern sim_modelo_t sim_modelo_uart[4];
+extern sim_modelo_t sim_modelo_timer[4];
+extern sim_modelo_t sim_modelo_gpio;
+extern sim_modelo_t sim_modelo_gpioint;
+extern sim_modelo_t sim_modelo_gpdma;
+extern sim_modelo_t sim_modelo_adc;
+extern sim_modelo_t sim_modelo_dac;
+extern sim_modelo_t sim_modelo_ssp[2];
+extern sim_modelo_t sim_modelo_i2c[3];
+extern sim_modelo_t sim_modelo_emac;
+extern sim_modelo_t sim_modelo_usb;
+
+#endif /* SIM_INT_H */
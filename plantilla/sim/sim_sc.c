@@ -0,0 +1,134 @@
+/* ============================================================================
+ * sim_sc.c - Modelo del System Control: PLLs, oscilador y divisores de PCLK
+ * ============================================================================
+ *
+ * Lo justo para que SystemInit() de CMSIS termine (espera OSCSTAT, PLOCK,
+ * PLLE/PLLC) y para saber a cuanto anda el core y cada periferico.
+ *
+ * Como en el chip, PLL0CON/PLL0CFG no tienen efecto hasta la secuencia de
+ * feed (0xAA, 0x55). Los PLL enganchan al instante.
+ * ========================================================================= */
+
+#include <stddef.h>
+
+#include "LPC17xx.h"
+#include "sim_int.h"
+
+#define IRC_HZ          4000000u
+#define OSC_HZ          12000000u       /* cristal de la LPCXpresso */
+#define RTC_HZ          32000u
+
+#define OFF(reg)        offsetof(LPC_SC_TypeDef, reg)
+#define NUM_REGS        ((OFF(CLKOUTCFG) / 4) + 1)
+
+typedef struct {
+    uint32_t reg[NUM_REGS];
+    uint32_t pll0_con;      /* valores ya "alimentados" */
+    uint32_t pll0_cfg;
+    uint32_t pll1_con;
+    uint32_t pll1_cfg;
+    uint32_t feed0;         /* ultimo byte de feed */
+    uint32_t feed1;
+} sc_t;
+
+static sc_t sc = {
+    .reg = {
+        [OFF(CCLKCFG) / 4] = 0,
+        [OFF(PCONP) / 4] = 0x042887DEu,
+    },
+};
+
+static uint32_t sc_mirar(sim_modelo_t *m, uint32_t off)
+{
+    (void)m;
+    switch (off) {
+    case OFF(PLL0STAT):
+        return (sc.pll0_cfg & 0x00FF7FFFu) |
+               ((sc.pll0_con & 3u) << 24) |
+               ((sc.pll0_con & 1u) << 26);
+    case OFF(PLL1STAT):
+        return (sc.pll1_cfg & 0x7Fu) |
+               ((sc.pll1_con & 3u) << 8) |
+               ((sc.pll1_con & 1u) << 10);
+    case OFF(SCS):
+        /* OSCSTAT (bit 6) sigue a OSCEN (bit 5) */
+        return (sc.reg[off / 4] & ~(1u << 6)) | ((sc.reg[off / 4] & (1u << 5)) << 1);
+    }
+    if (off / 4 < NUM_REGS) {
+        return sc.reg[off / 4];
+    }
+    return 0;
+}
+
+static void feed(uint32_t val, uint32_t *anterior, uint32_t *con, uint32_t *cfg,
+                 uint32_t off_con, uint32_t off_cfg)
+{
+    if (*anterior == 0xAA && (val & 0xFF) == 0x55) {
+        *con = sc.reg[off_con / 4];
+        *cfg = sc.reg[off_cfg / 4];
+    }
+    *anterior = val & 0xFF;
+}
+
+static void sc_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    (void)m;
+    (void)lanes;
+    switch (off) {
+    case OFF(PLL0FEED):
+        feed(val, &sc.feed0, &sc.pll0_con, &sc.pll0_cfg, OFF(PLL0CON), OFF(PLL0CFG));
+        return;
+    case OFF(PLL1FEED):
+        feed(val, &sc.feed1, &sc.pll1_con, &sc.pll1_cfg, OFF(PLL1CON), OFF(PLL1CFG));
+        return;
+    case OFF(EXTINT):
+        sc.reg[off / 4] &= ~val;                    /* escribir 1 borra */
+        return;
+    }
+    if (off / 4 < NUM_REGS) {
+        sc.reg[off / 4] = val;
+    }
+}
+
+static uint64_t sc_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    (void)ahora;
+    return SIM_NUNCA;
+}
+
+sim_modelo_t sim_modelo_sc = {
+    "SC", 0x400FC000u, 0x4000, sc_mirar, sc_mirar, sc_escribir,
+    sc_avanzar, &sc, SIM_NUNCA
+};
+
+/* La misma cuenta que SystemCoreClockUpdate() */
+uint32_t sim_cclk(void)
+{
+    uint64_t fuente;
+    uint32_t div = (sc.reg[OFF(CCLKCFG) / 4] & 0xFF) + 1;
+
+    switch (sc.reg[OFF(CLKSRCSEL) / 4] & 3) {
+    case 1:  fuente = OSC_HZ; break;
+    case 2:  fuente = RTC_HZ; break;
+    default: fuente = IRC_HZ; break;
+    }
+    if ((sc.pll0_con & 3) == 3) {
+        uint32_t msel = (sc.pll0_cfg & 0x7FFF) + 1;
+        uint32_t nsel = ((sc.pll0_cfg >> 16) & 0xFF) + 1;
+        fuente = 2 * msel * fuente / nsel;
+    }
+    return (uint32_t)(fuente / div);
+}
+
+uint32_t sim_pclk_div(int campo)
+{
+    uint32_t sel = (campo < 32) ? sc.reg[OFF(PCLKSEL0) / 4] : sc.reg[OFF(PCLKSEL1) / 4];
+
+    switch ((sel >> (campo & 31)) & 3) {
+    case 1:  return 1;
+    case 2:  return 2;
+    case 3:  return 8;
+    default: return 4;
+    }
+}
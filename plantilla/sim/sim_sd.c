@@ -0,0 +1,542 @@
+/* ============================================================================
+ * sim_sd.c - Tarjeta SD en modo SPI, colgada de una SSP
+ * ============================================================================
+ *
+ * No es un periferico del chip sino lo que hay del otro lado del cable: se
+ * engancha como esclavo de la SSP (sim_ssp_esclavo) y contesta byte por
+ * byte, con el chip select en un pin de GPIO (activo en 0). Los bloques
+ * estan en un archivo de la PC, asi que se puede montar una imagen de disco
+ * de verdad.
+ *
+ * Lo que entiende: CMD0, CMD8, CMD9 (CSD), CMD10 (CID), CMD12, CMD13,
+ * CMD16, CMD17, CMD18, CMD24, CMD25, CMD55, CMD58, CMD59, ACMD23 y ACMD41.
+ * La tarjeta es SD version 2, SDSC (direcciones en bytes) o SDHC (en
+ * bloques, y solo sale del estado idle si ACMD41 trae HCS). Las respuestas
+ * salen un byte despues del comando (NCR = 1) y los bloques llevan siempre
+ * su CRC16. El CRC7 de los comandos se verifica en CMD0 y CMD8, y en
+ * todos despues de CMD59 con el bit en 1; el CRC16 de los bloques
+ * escritos, tambien despues de CMD59.
+ *
+ * Los tiempos son supuestos, no medidos en una tarjeta: del orden de los
+ * de una tarjeta comun y con la misma forma, que escribir de a un bloque
+ * cuesta mucho mas que seguido. En tiempo simulado: el primer bloque de
+ * una lectura tarda SD_ACCESO_US en estar, los siguientes de una lectura
+ * multiple SD_ENTRE_US despues de terminado el anterior. El primer bloque
+ * de cada escritura deja la tarjeta ocupada (MISO en 0) SD_ABRIR_US de
+ * mas, lo que tarda en preparar la escritura. Despues cada bloque de un
+ * CMD25 la ocupa SD_PROGRAMAR_US y el token de stop otros SD_STOP_US; el
+ * bloque de un CMD24, que la tarjeta graba solo, SD_PROGRAMAR_UNICO_US.
+ * ACMD41 contesta idle durante SD_INIT_US desde el primero.
+ * ========================================================================= */
+
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sim_int.h"
+
+#define BLOQUE          512
+
+#define SD_ACCESO_US    100
+#define SD_ENTRE_US     20
+#define SD_ABRIR_US     300
+#define SD_PROGRAMAR_US 250
+#define SD_PROGRAMAR_UNICO_US 700
+#define SD_STOP_US      500
+#define SD_INIT_US      10000
+
+#define R1_IDLE         0x01
+#define R1_ILEGAL       0x04
+#define R1_CRC          0x08
+#define R1_DIRECCION    0x20
+#define R1_PARAMETRO    0x40
+
+#define TOKEN_BLOQUE    0xFE
+#define TOKEN_MULTIPLE  0xFC
+#define TOKEN_STOP      0xFD
+
+typedef enum {
+    COMANDOS,           /* esperando un comando */
+    LEYENDO,            /* CMD17/CMD18: mandando bloques */
+    ESCRIBIENDO,        /* CMD24/CMD25: esperando el token de un bloque */
+    RECIBIENDO,         /* recibiendo los datos de un bloque */
+} modo_t;
+
+typedef struct {
+    int ssp;
+    int puerto_cs, pin_cs;
+    int fd;
+    uint32_t bloques;
+    int sdhc;
+
+    /* Estado de la tarjeta */
+    int lista;              /* paso ACMD41: fuera del estado idle */
+    uint64_t lista_en;      /* cuando termina la inicializacion (0: no empezo) */
+    int app;                /* el comando anterior fue CMD55 */
+    int crc;                /* CMD59 */
+
+    /* Comando que esta entrando por MOSI */
+    uint8_t cmd[6];
+    int cmd_n;
+
+    /* Lo que sale por MISO: respuestas y bloques */
+    uint8_t sale[2 * BLOQUE];
+    int sale_n, sale_pos;
+    uint64_t ocupada_hasta; /* MISO en 0 hasta entonces (sin nada que mandar) */
+
+    modo_t modo;
+    int multiple;
+    int abrir;              /* ESCRIBIENDO: el primer bloque del comando */
+    uint32_t bloque;        /* proximo bloque a leer o escribir */
+    uint64_t listo;         /* LEYENDO: cuando esta el proximo bloque (0: sin fijar) */
+
+    uint8_t datos[BLOQUE + 2];
+    int datos_n;
+
+    uint32_t leidos, escritos, errores_crc;
+} sd_t;
+
+static sd_t sd = { .fd = -1 };
+
+static uint64_t us(uint32_t n)
+{
+    return (uint64_t)n * sim_cclk() / 1000000u;
+}
+
+/* --- CRCs ------------------------------------------------------------------ */
+
+static uint8_t crc7(const uint8_t *p, int n)
+{
+    uint8_t crc = 0;
+    int i, b;
+
+    for (i = 0; i < n; i++) {
+        for (b = 7; b >= 0; b--) {
+            int bit = ((p[i] >> b) & 1) ^ ((crc >> 6) & 1);
+
+            crc = (uint8_t)((crc << 1) & 0x7F);
+            if (bit) {
+                crc ^= 0x09;
+            }
+        }
+    }
+    return crc;
+}
+
+static uint16_t crc16(const uint8_t *p, int n)
+{
+    uint16_t crc = 0;
+    int i, b;
+
+    for (i = 0; i < n; i++) {
+        crc ^= (uint16_t)(p[i] << 8);
+        for (b = 0; b < 8; b++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+/* --- Respuestas ------------------------------------------------------------ */
+
+static void mandar(const uint8_t *p, int n)
+{
+    if (sd.sale_pos == sd.sale_n) {
+        sd.sale_pos = sd.sale_n = 0;
+    }
+    if (sd.sale_n + n > (int)sizeof(sd.sale)) {
+        sim_fatal("SD: el firmware no leyo las respuestas de la tarjeta");
+    }
+    memcpy(sd.sale + sd.sale_n, p, (size_t)n);
+    sd.sale_n += n;
+}
+
+static void mandar_byte(uint8_t b)
+{
+    mandar(&b, 1);
+}
+
+static uint8_t r1(uint8_t error)
+{
+    return (uint8_t)((sd.lista ? 0 : R1_IDLE) | error);
+}
+
+/* Token, datos y CRC16 de un bloque de datos */
+static void mandar_bloque(const uint8_t *p, int n)
+{
+    uint16_t crc = crc16(p, n);
+
+    mandar_byte(TOKEN_BLOQUE);
+    mandar(p, n);
+    mandar_byte((uint8_t)(crc >> 8));
+    mandar_byte((uint8_t)crc);
+}
+
+static void cid(uint8_t *c)
+{
+    static const uint8_t fijo[15] = {
+        0x03, 'S', 'M', 'S', 'I', 'M', 'S', 'D',    /* MID, OID, PNM */
+        0x10, 0x12, 0x34, 0x56, 0x78,               /* PRV 1.0, PSN */
+        0x01, 0x4A,                                 /* MDT: 2020/10 */
+    };
+
+    memcpy(c, fijo, 15);
+    c[15] = (uint8_t)((crc7(c, 15) << 1) | 1);
+}
+
+static void csd(uint8_t *c)
+{
+    memset(c, 0, 16);
+    c[1] = 0x0E;                /* TAAC */
+    c[3] = 0x32;                /* TRAN_SPEED: 25 MHz */
+    c[4] = 0x5B;                /* CCC */
+    c[5] = 0x59;                /* CCC, READ_BL_LEN = 9 */
+    if (sd.sdhc) {
+        uint32_t c_size = sd.bloques / 1024 - 1;
+
+        c[0] = 0x40;            /* CSD version 2.0 */
+        c[7] = (uint8_t)((c_size >> 16) & 0x3F);
+        c[8] = (uint8_t)(c_size >> 8);
+        c[9] = (uint8_t)c_size;
+    } else {
+        /* bloques = (C_SIZE + 1) * 2^(C_SIZE_MULT + 2), con C_SIZE_MULT = 7 */
+        uint32_t c_size = sd.bloques / 512 - 1;
+
+        c[6] = (uint8_t)((c_size >> 10) & 0x03);
+        c[7] = (uint8_t)(c_size >> 2);
+        c[8] = (uint8_t)((c_size & 0x03) << 6);
+        c[9] = 0x03;            /* C_SIZE_MULT, bits altos */
+        c[10] = 0x80;           /* C_SIZE_MULT, bit bajo */
+    }
+    c[15] = (uint8_t)((crc7(c, 15) << 1) | 1);
+}
+
+/* --- El archivo ------------------------------------------------------------ */
+
+static void leer_bloque(uint32_t n, uint8_t *p)
+{
+    if (pread(sd.fd, p, BLOQUE, (off_t)n * BLOQUE) != BLOQUE) {
+        memset(p, 0, BLOQUE);
+    }
+    sd.leidos++;
+}
+
+static void escribir_bloque(uint32_t n, const uint8_t *p)
+{
+    if (pwrite(sd.fd, p, BLOQUE, (off_t)n * BLOQUE) != BLOQUE) {
+        sim_fatal("SD: no se pudo escribir el bloque %u del archivo", (unsigned)n);
+    }
+    sd.escritos++;
+}
+
+/* --- Comandos -------------------------------------------------------------- */
+
+/* Direccion de un comando de datos en bloques, o -1 si no sirve */
+static int64_t direccion(uint32_t arg)
+{
+    uint32_t n = arg;
+
+    if (!sd.sdhc) {
+        if (arg % BLOQUE) {
+            return -1;
+        }
+        n = arg / BLOQUE;
+    }
+    return n < sd.bloques ? (int64_t)n : -1;
+}
+
+static void comando(void)
+{
+    uint8_t indice = sd.cmd[0] & 0x3F;
+    uint32_t arg = ((uint32_t)sd.cmd[1] << 24) | ((uint32_t)sd.cmd[2] << 16) |
+                   ((uint32_t)sd.cmd[3] << 8) | sd.cmd[4];
+    int app = sd.app;
+    uint8_t r[16];
+    int64_t dir;
+
+    sd.app = 0;
+    mandar_byte(0xFF);          /* NCR */
+
+    if ((sd.crc || indice == 0 || indice == 8) &&
+        sd.cmd[5] != (uint8_t)((crc7(sd.cmd, 5) << 1) | 1)) {
+        sd.errores_crc++;
+        mandar_byte(r1(R1_CRC));
+        return;
+    }
+
+    if (app) {
+        switch (indice) {
+        case 41:
+            if (sd.lista_en == 0) {
+                sd.lista_en = sim_t + us(SD_INIT_US);
+            }
+            if (sim_t >= sd.lista_en && (!sd.sdhc || (arg & (1u << 30)))) {
+                sd.lista = 1;
+            }
+            mandar_byte(r1(0));
+            return;
+        case 23:
+            mandar_byte(r1(0));
+            return;
+        }
+        /* Los demas son comandos comunes */
+    }
+
+    switch (indice) {
+    case 0:
+        sd.lista = 0;
+        sd.lista_en = 0;
+        sd.crc = 0;
+        mandar_byte(R1_IDLE);
+        return;
+    case 8:
+        r[0] = r1(0);
+        r[1] = 0;
+        r[2] = 0;
+        r[3] = (uint8_t)((arg >> 8) & 0x0F);
+        r[4] = (uint8_t)arg;
+        mandar(r, 5);
+        return;
+    case 55:
+        sd.app = 1;
+        mandar_byte(r1(0));
+        return;
+    case 58:
+        r[0] = r1(0);
+        r[1] = (uint8_t)((sd.lista ? 0x80 : 0) | (sd.lista && sd.sdhc ? 0x40 : 0));
+        r[2] = 0xFF;
+        r[3] = 0x80;
+        r[4] = 0x00;
+        mandar(r, 5);
+        return;
+    case 59:
+        sd.crc = arg & 1;
+        mandar_byte(r1(0));
+        return;
+    case 12:
+        if (sd.modo == LEYENDO) {
+            /* Se corta el bloque que estaba saliendo */
+            sd.sale_pos = sd.sale_n = 0;
+            sd.modo = COMANDOS;
+        }
+        mandar_byte(0xFF);      /* byte de relleno */
+        mandar_byte(r1(0));
+        return;
+    }
+
+    if (!sd.lista) {
+        mandar_byte(r1(R1_ILEGAL));
+        return;
+    }
+
+    switch (indice) {
+    case 9:
+        mandar_byte(r1(0));
+        mandar_byte(0xFF);
+        csd(r);
+        mandar_bloque(r, 16);
+        return;
+    case 10:
+        mandar_byte(r1(0));
+        mandar_byte(0xFF);
+        cid(r);
+        mandar_bloque(r, 16);
+        return;
+    case 13:
+        mandar_byte(r1(0));
+        mandar_byte(0x00);
+        return;
+    case 16:
+        mandar_byte(r1(arg == BLOQUE ? 0 : R1_PARAMETRO));
+        return;
+    case 17:
+    case 18:
+    case 24:
+    case 25:
+        dir = direccion(arg);
+        if (dir < 0) {
+            mandar_byte(r1(sd.sdhc ? R1_PARAMETRO : R1_DIRECCION));
+            return;
+        }
+        mandar_byte(r1(0));
+        sd.bloque = (uint32_t)dir;
+        sd.multiple = indice == 18 || indice == 25;
+        if (indice == 17 || indice == 18) {
+            sd.modo = LEYENDO;
+            sd.listo = sim_t + us(SD_ACCESO_US);
+        } else {
+            sd.modo = ESCRIBIENDO;
+            sd.abrir = 1;
+        }
+        return;
+    }
+    mandar_byte(r1(R1_ILEGAL));
+}
+
+/* --- Bytes por el cable ---------------------------------------------------- */
+
+static void recibir(uint8_t mosi)
+{
+    if (sd.modo == ESCRIBIENDO) {
+        if (sim_t < sd.ocupada_hasta) {
+            return;
+        }
+        if (mosi == (sd.multiple ? TOKEN_MULTIPLE : TOKEN_BLOQUE)) {
+            sd.modo = RECIBIENDO;
+            sd.datos_n = 0;
+        } else if (mosi == TOKEN_STOP && sd.multiple) {
+            mandar_byte(0xFF);
+            sd.ocupada_hasta = sim_t + us(SD_STOP_US);
+            sd.modo = COMANDOS;
+        }
+        return;
+    }
+
+    if (sd.modo == RECIBIENDO) {
+        sd.datos[sd.datos_n++] = mosi;
+        if (sd.datos_n < BLOQUE + 2) {
+            return;
+        }
+        if (sd.crc && crc16(sd.datos, BLOQUE) !=
+                      (uint16_t)((sd.datos[BLOQUE] << 8) | sd.datos[BLOQUE + 1])) {
+            sd.errores_crc++;
+            mandar_byte(0x0B);
+            sd.modo = sd.multiple ? ESCRIBIENDO : COMANDOS;
+            return;
+        }
+        escribir_bloque(sd.bloque, sd.datos);
+        mandar_byte(0x05);
+        sd.ocupada_hasta = sim_t + us((sd.multiple ? SD_PROGRAMAR_US : SD_PROGRAMAR_UNICO_US)
+                                      + (sd.abrir ? SD_ABRIR_US : 0));
+        sd.abrir = 0;
+        sd.bloque++;
+        sd.modo = (sd.multiple && sd.bloque < sd.bloques) ? ESCRIBIENDO : COMANDOS;
+        return;
+    }
+
+    /* Los comandos empiezan con 01 y entran tambien durante una lectura */
+    if (sd.cmd_n == 0 && (mosi & 0xC0) != 0x40) {
+        return;
+    }
+    sd.cmd[sd.cmd_n++] = mosi;
+    if (sd.cmd_n == 6) {
+        sd.cmd_n = 0;
+        comando();
+    }
+}
+
+static uint8_t salir(void)
+{
+    if (sd.sale_pos < sd.sale_n) {
+        return sd.sale[sd.sale_pos++];
+    }
+    if (sim_t < sd.ocupada_hasta) {
+        return 0x00;
+    }
+    if (sd.modo == LEYENDO) {
+        if (sd.listo == 0) {
+            sd.listo = sim_t + us(SD_ENTRE_US);
+        }
+        if (sim_t >= sd.listo) {
+            uint8_t bloque[BLOQUE];
+
+            leer_bloque(sd.bloque, bloque);
+            mandar_bloque(bloque, BLOQUE);
+            sd.bloque++;
+            sd.listo = 0;
+            if (!sd.multiple || sd.bloque == sd.bloques) {
+                sd.modo = COMANDOS;
+            }
+        }
+    }
+    return 0xFF;
+}
+
+static uint16_t sd_esclavo(int n, uint16_t mosi)
+{
+    uint8_t miso;
+
+    (void)n;
+    if (sim_gpio_pines(sd.puerto_cs) & (1u << sd.pin_cs)) {
+        /* Sin chip select la tarjeta no mira el bus ni lo maneja */
+        sd.cmd_n = 0;
+        return 0xFF;
+    }
+    miso = salir();
+    recibir((uint8_t)mosi);
+    return miso;
+}
+
+/* --- API publica ----------------------------------------------------------- */
+
+int sim_sd_tarjeta(int ssp, int puerto_cs, int pin_cs, const char *archivo,
+                   uint32_t bloques, int sdhc)
+{
+    struct stat st;
+    int fd;
+
+    if (archivo != NULL) {
+        fd = open(archivo, O_RDWR | O_CREAT, 0644);
+    } else {
+        char nombre[] = "/tmp/sim_sd_XXXXXX";
+
+        fd = mkstemp(nombre);
+        if (fd >= 0) {
+            unlink(nombre);
+        }
+    }
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        perror(archivo != NULL ? archivo : "sim_sd_tarjeta");
+        return -1;
+    }
+    if (bloques == 0) {
+        bloques = (uint32_t)(st.st_size / BLOQUE);
+    }
+    /* SDHC va en unidades de 512 KB, SDSC en 256 KB (C_SIZE_MULT = 7) */
+    bloques &= sdhc ? ~1023u : ~511u;
+    if (bloques == 0 || (!sdhc && bloques > 4096u * 512u)) {
+        fprintf(stderr, "sim_sd_tarjeta: tamano de tarjeta invalido\n");
+        close(fd);
+        return -1;
+    }
+    if (st.st_size < (off_t)bloques * BLOQUE &&
+        ftruncate(fd, (off_t)bloques * BLOQUE) != 0) {
+        perror("ftruncate");
+        close(fd);
+        return -1;
+    }
+
+    if (sd.fd >= 0) {
+        /* La tarjeta anterior se saca de su SSP */
+        sim_ssp_esclavo(sd.ssp, NULL);
+        close(sd.fd);
+    }
+    memset(&sd, 0, sizeof(sd));
+    sd.ssp = ssp;
+    sd.puerto_cs = puerto_cs;
+    sd.pin_cs = pin_cs;
+    sd.fd = fd;
+    sd.bloques = bloques;
+    sd.sdhc = sdhc;
+    sim_ssp_esclavo(ssp, sd_esclavo);
+    return 0;
+}
+
+uint32_t sim_sd_leidos(void)
+{
+    return sd.leidos;
+}
+
+uint32_t sim_sd_escritos(void)
+{
+    return sd.escritos;
+}
+
+uint32_t sim_sd_errores_crc(void)
+{
+    return sd.errores_crc;
+}
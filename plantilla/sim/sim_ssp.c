@@ -0,0 +1,284 @@
+/* ============================================================================
+ * sim_ssp.c - Modelo de las SSP0/SSP1 (SPI maestro, FIFOs de 8 tramas)
+ * ============================================================================
+ *
+ * Solo modo maestro. Cada trama tarda
+ *
+ *   (DSS + 1) * CPSDVSR * (SCR + 1)   ciclos de PCLK
+ *
+ * y sale de la FIFO de transmision en cuanto el shift register se libera,
+ * como en el chip: con la FIFO llena el bus no para entre tramas.
+ *
+ * Lo que vuelve por MISO lo decide el "esclavo" conectado con
+ * sim_ssp_esclavo(); sin esclavo vuelve lo mismo que salio (MOSI unido a
+ * MISO), igual que con LBM. Si la FIFO de recepcion esta llena la trama se
+ * pierde y se levanta ROR.
+ *
+ * Interrupciones: ROR, RX (FIFO de recepcion por la mitad o mas) y TX (FIFO
+ * de transmision por la mitad o menos). El timeout de recepcion (RT) no esta
+ * modelado. Pide DMA por las conexiones 0..3 del GPDMA.
+ * ========================================================================= */
+
+#include <stddef.h>
+
+#include "sim_int.h"
+
+#define FIFO_TAM        8
+
+#define CR1_LBM         (1u << 0)
+#define CR1_SSE         (1u << 1)
+#define CR1_MS          (1u << 2)
+#define SR_TFE          (1u << 0)
+#define SR_TNF          (1u << 1)
+#define SR_RNE          (1u << 2)
+#define SR_RFF          (1u << 3)
+#define SR_BSY          (1u << 4)
+#define INT_ROR         (1u << 0)
+#define INT_RT          (1u << 1)
+#define INT_RX          (1u << 2)
+#define INT_TX          (1u << 3)
+#define DMACR_RX        (1u << 0)
+#define DMACR_TX        (1u << 1)
+
+typedef struct {
+    int n;
+    int irq;
+    int campo_pclk;
+
+    uint32_t cr0, cr1, cpsr, imsc, dmacr;
+    uint32_t ris_ror;
+
+    uint16_t tx[FIFO_TAM];
+    int tx_cab, tx_n;
+    uint16_t rx[FIFO_TAM];
+    int rx_cab, rx_n;
+
+    int enviando;           /* hay una trama en el shift register */
+    uint16_t trama;
+    uint64_t fin;
+
+    sim_ssp_esclavo_t esclavo;
+    uint32_t tramas;
+} ssp_t;
+
+static ssp_t ssps[2] = {
+    { .n = 0, .irq = 14, .campo_pclk = SIM_PCLK_SSP0, .fin = SIM_NUNCA },
+    { .n = 1, .irq = 15, .campo_pclk = SIM_PCLK_SSP1, .fin = SIM_NUNCA },
+};
+
+static uint64_t ciclos_por_trama(ssp_t *s)
+{
+    uint64_t bits = (s->cr0 & 0xF) + 1;
+    uint64_t scr = ((s->cr0 >> 8) & 0xFF) + 1;
+    uint64_t cpsdvsr = s->cpsr & 0xFE;
+
+    if (cpsdvsr < 2) {
+        cpsdvsr = 2;
+    }
+    return bits * cpsdvsr * scr * sim_pclk_div(s->campo_pclk);
+}
+
+static uint32_t mascara_trama(ssp_t *s)
+{
+    return (1u << ((s->cr0 & 0xF) + 1)) - 1u;
+}
+
+/* --- Interrupciones -------------------------------------------------------- */
+
+static uint32_t ris(ssp_t *s)
+{
+    uint32_t v = s->ris_ror;
+
+    if (s->rx_n >= FIFO_TAM / 2) {
+        v |= INT_RX;
+    }
+    if (s->tx_n <= FIFO_TAM / 2) {
+        v |= INT_TX;
+    }
+    return v;
+}
+
+static void actualizar_irq(ssp_t *s)
+{
+    sim_irq_nivel(s->irq, (ris(s) & s->imsc) != 0);
+}
+
+/* --- Transferencia --------------------------------------------------------- */
+
+static int activa(ssp_t *s)
+{
+    return (s->cr1 & (CR1_SSE | CR1_MS)) == CR1_SSE;
+}
+
+static void arrancar(ssp_t *s, uint64_t ahora)
+{
+    if (s->enviando || s->tx_n == 0 || !activa(s)) {
+        return;
+    }
+    s->trama = s->tx[s->tx_cab];
+    s->tx_cab = (s->tx_cab + 1) % FIFO_TAM;
+    s->tx_n--;
+    s->enviando = 1;
+    s->fin = ahora + ciclos_por_trama(s);
+}
+
+static void terminar(ssp_t *s)
+{
+    uint16_t miso = s->trama;
+
+    if (s->esclavo != NULL && !(s->cr1 & CR1_LBM)) {
+        miso = s->esclavo(s->n, s->trama);
+    }
+    if (s->rx_n < FIFO_TAM) {
+        s->rx[(s->rx_cab + s->rx_n) % FIFO_TAM] = miso & mascara_trama(s);
+        s->rx_n++;
+    } else {
+        s->ris_ror = INT_ROR;
+    }
+    s->enviando = 0;
+    s->fin = SIM_NUNCA;
+    s->tramas++;
+}
+
+static uint64_t ssp_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    ssp_t *s = m->estado;
+
+    while (s->enviando && s->fin <= ahora) {
+        uint64_t fin = s->fin;
+
+        terminar(s);
+        arrancar(s, fin);
+    }
+    actualizar_irq(s);
+    if (s->dmacr) {
+        sim_gpdma_despertar();
+    }
+    return s->fin;
+}
+
+static void reprogramar(sim_modelo_t *m, ssp_t *s)
+{
+    m->proximo = s->fin;
+    sim_replanificar();
+    actualizar_irq(s);
+}
+
+/* --- Registros ------------------------------------------------------------- */
+
+static uint32_t sr(ssp_t *s)
+{
+    uint32_t v = 0;
+
+    if (s->tx_n == 0) {
+        v |= SR_TFE;
+    }
+    if (s->tx_n < FIFO_TAM) {
+        v |= SR_TNF;
+    }
+    if (s->rx_n > 0) {
+        v |= SR_RNE;
+    }
+    if (s->rx_n == FIFO_TAM) {
+        v |= SR_RFF;
+    }
+    if (s->enviando || s->tx_n > 0) {
+        v |= SR_BSY;
+    }
+    return v;
+}
+
+static uint32_t ssp_mirar(sim_modelo_t *m, uint32_t off)
+{
+    ssp_t *s = m->estado;
+
+    switch (off) {
+    case 0x00: return s->cr0;
+    case 0x04: return s->cr1;
+    case 0x08: return s->rx_n ? s->rx[s->rx_cab] : 0;
+    case 0x0C: return sr(s);
+    case 0x10: return s->cpsr;
+    case 0x14: return s->imsc;
+    case 0x18: return ris(s);
+    case 0x1C: return ris(s) & s->imsc;
+    case 0x24: return s->dmacr;
+    }
+    return 0;
+}
+
+static uint32_t ssp_leer(sim_modelo_t *m, uint32_t off)
+{
+    ssp_t *s = m->estado;
+    uint32_t v = ssp_mirar(m, off);
+
+    if (off == 0x08 && s->rx_n > 0) {
+        s->rx_cab = (s->rx_cab + 1) % FIFO_TAM;
+        s->rx_n--;
+        actualizar_irq(s);
+    }
+    return v;
+}
+
+static void ssp_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    ssp_t *s = m->estado;
+
+    (void)lanes;
+    switch (off) {
+    case 0x00: s->cr0 = val & 0xFFFF; break;
+    case 0x04: s->cr1 = val & 0xF; break;
+    case 0x08:
+        if (s->tx_n < FIFO_TAM) {
+            s->tx[(s->tx_cab + s->tx_n) % FIFO_TAM] = (uint16_t)(val & mascara_trama(s));
+            s->tx_n++;
+        }
+        break;
+    case 0x10: s->cpsr = val & 0xFF; break;
+    case 0x14: s->imsc = val & 0xF; break;
+    case 0x20:
+        if (val & INT_ROR) {
+            s->ris_ror = 0;
+        }
+        break;
+    case 0x24: s->dmacr = val & 3; break;
+    }
+    arrancar(s, sim_t);
+    reprogramar(m, s);
+    if (s->dmacr) {
+        sim_gpdma_despertar();
+    }
+}
+
+#define SSP(i, b) \
+    { "SSP" #i, b, 0x4000, ssp_leer, ssp_mirar, ssp_escribir, \
+      ssp_avanzar, &ssps[i], SIM_NUNCA }
+
+sim_modelo_t sim_modelo_ssp[2] = {
+    SSP(0, 0x40088000u),
+    SSP(1, 0x40030000u),
+};
+
+/* Conexiones 0..3 del GPDMA: SSP0 Tx, SSP0 Rx, SSP1 Tx, SSP1 Rx */
+int sim_ssp_dma_pide(int n, int rx)
+{
+    ssp_t *s = &ssps[n];
+
+    if (rx) {
+        return (s->dmacr & DMACR_RX) && s->rx_n > 0;
+    }
+    return (s->dmacr & DMACR_TX) && s->tx_n < FIFO_TAM;
+}
+
+/* --- API publica ----------------------------------------------------------- */
+
+void sim_ssp_esclavo(int n, sim_ssp_esclavo_t fn)
+{
+    if (n >= 0 && n < 2) {
+        ssps[n].esclavo = fn;
+    }
+}
+
+uint32_t sim_ssp_tramas(int n)
+{
+    return (n >= 0 && n < 2) ? ssps[n].tramas : 0;
+}
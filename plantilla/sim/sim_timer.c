@@ -0,0 +1,273 @@
+/* ============================================================================
+ * sim_timer.c - Modelo de los TIMER0..3
+ * ============================================================================
+ *
+ * El TC no se cuenta de a uno: se guarda una referencia (en tal ciclo el
+ * prescaler llevaba tantas cuentas) y el valor se calcula cuando alguien lo
+ * lee. Los eventos son solo los matches que hacen algo (interrumpir,
+ * resetear, parar, mover un pin de EMR o pedir DMA).
+ *
+ * Modo contador (CTCR != 0) y captura no estan modelados: en esos modos el
+ * TC queda quieto.
+ * ========================================================================= */
+
+#include "sim_int.h"
+
+#define TCR_ENABLE      (1u << 0)
+#define TCR_RESET       (1u << 1)
+
+typedef struct {
+    int irq;
+    int campo_pclk;
+
+    uint32_t ir, tcr, pr, mcr, mr[4], ccr, emr, ctcr;
+
+    /* Posicion: en el ciclo t0 el prescaler llevaba p0 cuentas en total
+     * (TC * (PR + 1) + PC). Antes de t0 el TC se lee como "retenido". */
+    uint64_t t0;
+    uint64_t p0;
+    uint32_t retenido;
+
+    int dma[4];             /* match pendiente de atender por el GPDMA */
+} tmr_t;
+
+static tmr_t timers[4] = {
+    { .irq = 1, .campo_pclk = SIM_PCLK_TIMER0 },
+    { .irq = 2, .campo_pclk = SIM_PCLK_TIMER1 },
+    { .irq = 3, .campo_pclk = SIM_PCLK_TIMER2 },
+    { .irq = 4, .campo_pclk = SIM_PCLK_TIMER3 },
+};
+
+static int contando(tmr_t *t)
+{
+    return (t->tcr & (TCR_ENABLE | TCR_RESET)) == TCR_ENABLE && t->ctcr == 0;
+}
+
+/* Cuentas del prescaler en el ciclo "ahora" */
+static uint64_t posicion(tmr_t *t, uint64_t ahora)
+{
+    if (!contando(t) || ahora < t->t0) {
+        return t->p0;
+    }
+    return t->p0 + (ahora - t->t0) / sim_pclk_div(t->campo_pclk);
+}
+
+static uint32_t tc(tmr_t *t, uint64_t ahora)
+{
+    if (contando(t) && ahora < t->t0) {
+        return t->retenido;
+    }
+    return (uint32_t)(posicion(t, ahora) / ((uint64_t)t->pr + 1));
+}
+
+static uint32_t pc(tmr_t *t, uint64_t ahora)
+{
+    if (contando(t) && ahora < t->t0) {
+        return t->pr;
+    }
+    return (uint32_t)(posicion(t, ahora) % ((uint64_t)t->pr + 1));
+}
+
+/* Fijar la posicion actual como nueva referencia */
+static void rebasar(tmr_t *t, uint64_t ahora, uint64_t p)
+{
+    t->t0 = ahora;
+    t->p0 = p;
+}
+
+/* Un match "hace algo" si interrumpe, resetea, para, mueve EMR o pide DMA */
+static int match_util(tmr_t *t, int i)
+{
+    return ((t->mcr >> (3 * i)) & 7) != 0 || ((t->emr >> (4 + 2 * i)) & 3) != 0;
+}
+
+/* Ciclo del proximo match y cuales MR coinciden ahi */
+static uint64_t proximo_match(tmr_t *t, uint32_t *cuales)
+{
+    uint64_t mejor = SIM_NUNCA;
+    uint64_t div = sim_pclk_div(t->campo_pclk);
+    uint64_t escala = (uint64_t)t->pr + 1;
+    uint64_t desde = t->p0;
+    int i;
+
+    *cuales = 0;
+    if (!contando(t)) {
+        return SIM_NUNCA;
+    }
+    for (i = 0; i < 4; i++) {
+        uint64_t objetivo = (uint64_t)t->mr[i] * escala;
+        uint64_t cuando;
+
+        if (!match_util(t, i) || objetivo <= desde) {
+            continue;
+        }
+        cuando = t->t0 + (objetivo - desde) * div;
+        if (cuando < mejor) {
+            mejor = cuando;
+            *cuales = 1u << i;
+        } else if (cuando == mejor) {
+            *cuales |= 1u << i;
+        }
+    }
+    return mejor;
+}
+
+static void aplicar_match(tmr_t *t, uint32_t cuales, uint64_t cuando)
+{
+    uint64_t div = sim_pclk_div(t->campo_pclk);
+    uint64_t escala = (uint64_t)t->pr + 1;
+    uint32_t valor = 0;
+    int reset = 0;
+    int parar = 0;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        uint32_t ctrl = (t->mcr >> (3 * i)) & 7;
+
+        if (!(cuales & (1u << i))) {
+            continue;
+        }
+        valor = t->mr[i];
+        if (ctrl & 1) {
+            t->ir |= 1u << i;
+        }
+        reset |= (ctrl & 2) != 0;
+        parar |= (ctrl & 4) != 0;
+        switch ((t->emr >> (4 + 2 * i)) & 3) {
+        case 1: t->emr &= ~(1u << i); break;
+        case 2: t->emr |= 1u << i; break;
+        case 3: t->emr ^= 1u << i; break;
+        }
+        t->dma[i] = 1;
+    }
+
+    if (parar) {
+        t->tcr &= ~TCR_ENABLE;
+    }
+    if (reset) {
+        /* El TC vuelve a 0 en la siguiente cuenta, no en la del match */
+        t->retenido = valor;
+        rebasar(t, cuando + escala * div, 0);
+        if (parar) {
+            t->t0 = cuando;
+        }
+    } else {
+        rebasar(t, cuando, (uint64_t)valor * escala);
+    }
+    if (cuales) {
+        sim_gpdma_despertar();
+    }
+}
+
+static uint64_t timer_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    tmr_t *t = m->estado;
+    uint32_t cuales;
+    uint64_t cuando;
+
+    while ((cuando = proximo_match(t, &cuales)) <= ahora) {
+        aplicar_match(t, cuales, cuando);
+    }
+    sim_irq_nivel(t->irq, (t->ir & 0x3F) != 0);
+    return cuando;
+}
+
+static void reprogramar(sim_modelo_t *m)
+{
+    tmr_t *t = m->estado;
+    uint32_t cuales;
+
+    m->proximo = proximo_match(t, &cuales);
+    sim_replanificar();
+    sim_irq_nivel(t->irq, (t->ir & 0x3F) != 0);
+}
+
+static uint32_t timer_mirar(sim_modelo_t *m, uint32_t off)
+{
+    tmr_t *t = m->estado;
+
+    switch (off) {
+    case 0x00: return t->ir;
+    case 0x04: return t->tcr;
+    case 0x08: return tc(t, sim_t);
+    case 0x0C: return t->pr;
+    case 0x10: return pc(t, sim_t);
+    case 0x14: return t->mcr;
+    case 0x18: case 0x1C: case 0x20: case 0x24:
+        return t->mr[(off - 0x18) / 4];
+    case 0x28: return t->ccr;
+    case 0x3C: return t->emr;
+    case 0x70: return t->ctcr;
+    }
+    return 0;
+}
+
+static void timer_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    tmr_t *t = m->estado;
+    uint64_t escala = (uint64_t)t->pr + 1;
+    uint64_t p = posicion(t, sim_t);
+
+    /* Congelar la posicion antes de cambiar cualquier cosa que la afecte */
+    if (contando(t) && sim_t < t->t0) {
+        p = (uint64_t)t->retenido * escala + t->pr;
+    }
+
+    switch (off) {
+    case 0x00:
+        if (lanes & 1) {
+            t->ir &= ~(val & 0x3F);                 /* escribir 1 borra */
+        }
+        break;
+    case 0x04:
+        if (val & TCR_RESET) {
+            p = 0;
+        }
+        t->tcr = val & 3;
+        rebasar(t, sim_t, p);
+        break;
+    case 0x08:
+        rebasar(t, sim_t, (uint64_t)val * escala + p % escala);
+        break;
+    case 0x0C:
+        t->pr = val;
+        rebasar(t, sim_t, (p / escala) * ((uint64_t)val + 1));
+        break;
+    case 0x10:
+        rebasar(t, sim_t, (p / escala) * escala + (val % escala));
+        break;
+    case 0x14: t->mcr = val & 0xFFF; break;
+    case 0x18: case 0x1C: case 0x20: case 0x24:
+        t->mr[(off - 0x18) / 4] = val;
+        break;
+    case 0x28: t->ccr = val & 0x3F; break;
+    case 0x3C: t->emr = val & 0xFFF; break;
+    case 0x70:
+        t->ctcr = val & 0xF;
+        rebasar(t, sim_t, p);
+        break;
+    }
+    reprogramar(m);
+}
+
+#define TIMER(i, b) \
+    { "TIMER" #i, b, 0x4000, timer_mirar, timer_mirar, timer_escribir, \
+      timer_avanzar, &timers[i], SIM_NUNCA }
+
+sim_modelo_t sim_modelo_timer[4] = {
+    TIMER(0, 0x40004000u),
+    TIMER(1, 0x40008000u),
+    TIMER(2, 0x40090000u),
+    TIMER(3, 0x40094000u),
+};
+
+/* Pedidos de DMA por match (MAT0.0, MAT0.1, ..., MAT3.1) */
+int sim_timer_dma_pide(int n, int mr)
+{
+    return timers[n].dma[mr];
+}
+
+void sim_timer_dma_atendido(int n, int mr)
+{
+    timers[n].dma[mr] = 0;
+}
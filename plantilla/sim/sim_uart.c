@@ -0,0 +1,496 @@
+/* ============================================================================
+ * sim_uart.c - Modelo de las UART0..3 (16550 con FIFOs de 16 bytes)
+ * ============================================================================
+ *
+ * Cada byte tarda un tiempo de caracter en salir o en llegar:
+ *
+ *   16 * (DLM:DLL) * (1 + DivAddVal/MulVal) * bits_por_trama   ciclos de PCLK
+ *
+ * Lo que se transmite va a un file descriptor (stdout para la UART0). Lo que
+ * se recibe sale de sim_uart_inyectar() o del archivo SIM_UARTn_IN, a un
+ * byte por tiempo de caracter; si la FIFO esta llena se pierde (OE). La
+ * UART1 con auto-RTS (MCR[6]) desactiva RTS mientras la FIFO de recepcion
+ * esta en el nivel de disparo, y el otro lado espera: no llega nada hasta
+ * que el firmware (o el DMA) saca un byte.
+ *
+ * Interrupciones, por prioridad como en el 16550: RLS (overrun), RDA (FIFO
+ * sobre el nivel de disparo), CTI (quedan bytes y no llego nada en 4
+ * tiempos de caracter) y THRE (la FIFO de transmision se vacio; se baja
+ * leyendo IIR o escribiendo THR).
+ * ========================================================================= */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "sim_int.h"
+
+#define FIFO_TAM        16
+
+#define LCR_DLAB        (1u << 7)
+#define IER_RBR         (1u << 0)
+#define IER_THRE        (1u << 1)
+#define IER_RLS         (1u << 2)
+#define FCR_FIFO        (1u << 0)
+#define FCR_RX_RESET    (1u << 1)
+#define FCR_TX_RESET    (1u << 2)
+#define FCR_DMA         (1u << 3)
+#define LSR_RDR         (1u << 0)
+#define LSR_OE          (1u << 1)
+#define LSR_THRE        (1u << 5)
+#define LSR_TEMT        (1u << 6)
+#define TER_TXEN        (1u << 7)
+#define MCR_RTSEN       (1u << 6)
+
+typedef struct {
+    int n;
+    int irq;
+    int campo_pclk;
+
+    /* Registros */
+    uint32_t dll, dlm, ier, fcr, lcr, mcr, scr, acr, icr, fdr, ter;
+
+    /* Recepcion */
+    uint8_t rx[FIFO_TAM];
+    int rx_cab, rx_n;
+    int oe;
+    uint64_t rx_actividad;      /* ultimo byte que llego o se leyo */
+
+    /* Transmision */
+    uint8_t tx[FIFO_TAM + 1];  /* FIFO + el byte del shift register */
+    int tx_cab, tx_n;
+    int enviando;               /* hay un byte en el shift register */
+    uint64_t tx_fin;
+    int thre_int;
+
+    /* Lo que "llega por el cable" */
+    uint8_t *entrada;
+    uint32_t entrada_cab, entrada_n, entrada_cap;
+    uint64_t rx_prox;
+
+    int fd;
+    uint32_t enviados;
+    uint32_t perdidos;
+} uart_t;
+
+static uart_t uarts[4];
+
+/* --- Tiempos --------------------------------------------------------------- */
+
+static uint64_t ciclos_por_caracter(uart_t *u)
+{
+    uint32_t div = ((u->dlm & 0xFF) << 8) | (u->dll & 0xFF);
+    uint32_t mul = (u->fdr >> 4) & 0xF;
+    uint32_t add = u->fdr & 0xF;
+    uint32_t bits;
+    uint64_t c;
+
+    if (div == 0) {
+        div = 1;
+    }
+    if (mul == 0) {
+        mul = 1;
+    }
+    bits = 1 + 5 + (u->lcr & 3) + ((u->lcr >> 2) & 1 ? 2 : 1) + ((u->lcr >> 3) & 1);
+    c = 16ull * div * bits * sim_pclk_div(u->campo_pclk);
+    return (c * (mul + add)) / mul;
+}
+
+/* --- Interrupciones -------------------------------------------------------- */
+
+static int nivel_disparo(uart_t *u)
+{
+    static const int niveles[4] = { 1, 4, 8, 14 };
+
+    return (u->fcr & FCR_FIFO) ? niveles[(u->fcr >> 6) & 3] : 1;
+}
+
+/* UART1 con auto-RTS: RTS inactivo, el otro lado no manda */
+static int rts_parado(uart_t *u)
+{
+    return u->n == 1 && (u->mcr & MCR_RTSEN) && u->rx_n >= nivel_disparo(u);
+}
+
+static int cti_vencido(uart_t *u, uint64_t ahora)
+{
+    return u->rx_n > 0 && ahora >= u->rx_actividad + 4 * ciclos_por_caracter(u);
+}
+
+/* IIR[3:0] de la fuente de mayor prioridad; 1 = ninguna */
+static uint32_t fuente(uart_t *u, uint64_t ahora)
+{
+    if ((u->ier & IER_RLS) && u->oe) {
+        return 0x6;
+    }
+    if ((u->ier & IER_RBR) && u->rx_n >= nivel_disparo(u)) {
+        return 0x4;
+    }
+    if ((u->ier & IER_RBR) && cti_vencido(u, ahora)) {
+        return 0xC;
+    }
+    if ((u->ier & IER_THRE) && u->thre_int) {
+        return 0x2;
+    }
+    return 0x1;
+}
+
+static void actualizar_irq(uart_t *u, uint64_t ahora)
+{
+    sim_irq_nivel(u->irq, fuente(u, ahora) != 0x1);
+}
+
+/* Proximo evento: fin del byte que sale, llegada del proximo, o timeout */
+static uint64_t planificar(uart_t *u)
+{
+    uint64_t p = SIM_NUNCA;
+
+    if (u->enviando) {
+        p = u->tx_fin;
+    }
+    if (u->entrada_n > 0 && !rts_parado(u) && u->rx_prox < p) {
+        p = u->rx_prox;
+    }
+    if (u->rx_n > 0 && (u->ier & IER_RBR) && !cti_vencido(u, sim_t)) {
+        uint64_t cti = u->rx_actividad + 4 * ciclos_por_caracter(u);
+        if (cti < p) {
+            p = cti;
+        }
+    }
+    return p;
+}
+
+static void reprogramar(sim_modelo_t *m, uart_t *u)
+{
+    m->proximo = planificar(u);
+    sim_replanificar();
+}
+
+/* --- Transmision ----------------------------------------------------------- */
+
+static void tx_arrancar(uart_t *u, uint64_t ahora)
+{
+    if (u->enviando || u->tx_n == 0 || !(u->ter & TER_TXEN)) {
+        return;
+    }
+    u->enviando = 1;
+    u->tx_fin = ahora + ciclos_por_caracter(u);
+    if (--u->tx_n == 0) {
+        u->thre_int = 1;
+    }
+    if (u->fcr & FCR_DMA) {
+        sim_gpdma_despertar();
+    }
+}
+
+static void tx_terminar(uart_t *u)
+{
+    uint8_t b = u->tx[u->tx_cab];
+
+    u->tx_cab = (u->tx_cab + 1) % (FIFO_TAM + 1);
+    u->enviando = 0;
+    u->enviados++;
+    if (u->fd >= 0 && write(u->fd, &b, 1) < 0) {
+        u->fd = -1;
+    }
+}
+
+static void tx_escribir(uart_t *u, uint8_t b)
+{
+    if (u->tx_n >= FIFO_TAM) {
+        return;                                     /* FIFO llena: se pierde */
+    }
+    u->tx[(u->tx_cab + u->enviando + u->tx_n) % (FIFO_TAM + 1)] = b;
+    u->tx_n++;
+    u->thre_int = 0;
+    tx_arrancar(u, sim_t);
+}
+
+/* --- Recepcion ------------------------------------------------------------- */
+
+static void rx_llega(uart_t *u, uint64_t ahora)
+{
+    uint8_t b = u->entrada[u->entrada_cab++];
+
+    u->entrada_n--;
+    if (u->rx_n < FIFO_TAM) {
+        u->rx[(u->rx_cab + u->rx_n) % FIFO_TAM] = b;
+        u->rx_n++;
+    } else {
+        u->oe = 1;
+        u->perdidos++;
+    }
+    u->rx_actividad = ahora;
+    u->rx_prox = ahora + ciclos_por_caracter(u);
+    if (u->fcr & FCR_DMA) {
+        sim_gpdma_despertar();
+    }
+}
+
+static uint8_t rx_sacar(uart_t *u)
+{
+    uint8_t b = 0;
+
+    if (u->rx_n > 0) {
+        b = u->rx[u->rx_cab];
+        u->rx_cab = (u->rx_cab + 1) % FIFO_TAM;
+        u->rx_n--;
+        u->rx_actividad = sim_t;
+        if (u->rx_prox < sim_t) {
+            /* RTS vuelve: el proximo byte empieza ahora */
+            u->rx_prox = sim_t + ciclos_por_caracter(u);
+        }
+    }
+    return b;
+}
+
+/* --- Registros ------------------------------------------------------------- */
+
+static uint32_t lsr(uart_t *u)
+{
+    uint32_t v = 0;
+
+    if (u->rx_n > 0) {
+        v |= LSR_RDR;
+    }
+    if (u->oe) {
+        v |= LSR_OE;
+    }
+    if (u->tx_n == 0) {
+        v |= LSR_THRE;
+        if (!u->enviando) {
+            v |= LSR_TEMT;
+        }
+    }
+    return v;
+}
+
+static uint32_t uart_mirar(sim_modelo_t *m, uint32_t off)
+{
+    uart_t *u = m->estado;
+
+    switch (off) {
+    case 0x00: return (u->lcr & LCR_DLAB) ? u->dll : (u->rx_n ? u->rx[u->rx_cab] : 0);
+    case 0x04: return (u->lcr & LCR_DLAB) ? u->dlm : u->ier;
+    case 0x08: return fuente(u, sim_t) | ((u->fcr & FCR_FIFO) ? 0xC0 : 0);
+    case 0x0C: return u->lcr;
+    case 0x10: return u->mcr;
+    case 0x14: return lsr(u);
+    case 0x18: return 0x30;                         /* MSR: CTS y DSR activos */
+    case 0x1C: return u->scr;
+    case 0x20: return u->acr;
+    case 0x24: return u->icr;
+    case 0x28: return u->fdr;
+    case 0x30: return u->ter;
+    }
+    return 0;
+}
+
+static uint32_t uart_leer(sim_modelo_t *m, uint32_t off)
+{
+    uart_t *u = m->estado;
+    uint32_t v = uart_mirar(m, off);
+
+    switch (off) {
+    case 0x00:
+        if (!(u->lcr & LCR_DLAB)) {
+            rx_sacar(u);
+        }
+        break;
+    case 0x08:
+        if ((v & 0xF) == 0x2) {
+            u->thre_int = 0;                        /* leer IIR baja THRE */
+        }
+        break;
+    case 0x14:
+        u->oe = 0;                                  /* leer LSR baja OE */
+        break;
+    }
+    actualizar_irq(u, sim_t);
+    reprogramar(m, u);
+    return v;
+}
+
+static void uart_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    uart_t *u = m->estado;
+
+    (void)lanes;
+    switch (off) {
+    case 0x00:
+        if (u->lcr & LCR_DLAB) {
+            u->dll = val & 0xFF;
+        } else {
+            tx_escribir(u, (uint8_t)val);
+        }
+        break;
+    case 0x04:
+        if (u->lcr & LCR_DLAB) {
+            u->dlm = val & 0xFF;
+        } else {
+            /* Habilitar THRE con la FIFO vacia interrumpe enseguida */
+            if ((val & IER_THRE) && !(u->ier & IER_THRE) && u->tx_n == 0) {
+                u->thre_int = 1;
+            }
+            u->ier = val & 0x387;
+        }
+        break;
+    case 0x08:
+        if (val & FCR_RX_RESET) {
+            u->rx_n = 0;
+        }
+        if (val & FCR_TX_RESET) {
+            u->tx_n = 0;
+            u->thre_int = 1;
+        }
+        u->fcr = val & 0xC9;
+        if (u->fcr & FCR_DMA) {
+            sim_gpdma_despertar();
+        }
+        break;
+    case 0x0C: u->lcr = val & 0xFF; break;
+    case 0x10: u->mcr = val & 0xFF; break;
+    case 0x1C: u->scr = val & 0xFF; break;
+    case 0x20: u->acr = val & 0x307; break;
+    case 0x24: u->icr = val & 0x3F; break;
+    case 0x28: u->fdr = val & 0xFF; break;
+    case 0x30:
+        u->ter = val & TER_TXEN;
+        tx_arrancar(u, sim_t);
+        break;
+    }
+    actualizar_irq(u, sim_t);
+    reprogramar(m, u);
+}
+
+static uint64_t uart_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    uart_t *u = m->estado;
+
+    if (u->enviando && u->tx_fin <= ahora) {
+        tx_terminar(u);
+        tx_arrancar(u, u->tx_fin);
+    }
+    if (u->entrada_n > 0 && u->rx_prox <= ahora && !rts_parado(u)) {
+        rx_llega(u, ahora);
+    }
+    actualizar_irq(u, ahora);
+    return planificar(u);
+}
+
+#define UART(i, b) \
+    { "UART" #i, b, 0x4000, uart_leer, uart_mirar, uart_escribir, \
+      uart_avanzar, &uarts[i], SIM_NUNCA }
+
+sim_modelo_t sim_modelo_uart[4] = {
+    UART(0, 0x4000C000u),
+    UART(1, 0x40010000u),
+    UART(2, 0x40098000u),
+    UART(3, 0x4009C000u),
+};
+
+/* --- Pedidos de DMA -------------------------------------------------------- */
+
+int sim_uart_dma_pide(int n, int rx)
+{
+    uart_t *u = &uarts[n];
+
+    if (!(u->fcr & FCR_DMA) || !(u->fcr & FCR_FIFO)) {
+        return 0;
+    }
+    return rx ? (u->rx_n > 0) : (u->tx_n < FIFO_TAM);
+}
+
+/* --- API publica ----------------------------------------------------------- */
+
+void sim_uart_inyectar(int n, const void *datos, uint32_t len)
+{
+    uart_t *u = &uarts[n & 3];
+
+    sim_bloquear();
+    /* Compactar y agrandar el buffer de entrada */
+    if (u->entrada_cab > 0) {
+        memmove(u->entrada, u->entrada + u->entrada_cab, u->entrada_n);
+        u->entrada_cab = 0;
+    }
+    if (u->entrada_n + len > u->entrada_cap) {
+        u->entrada_cap = (u->entrada_n + len) * 2;
+        u->entrada = realloc(u->entrada, u->entrada_cap);
+        if (u->entrada == NULL) {
+            sim_fatal("sin memoria para la entrada de la UART%d", n);
+        }
+    }
+    if (u->entrada_n == 0) {
+        u->rx_prox = sim_t + ciclos_por_caracter(u);
+    }
+    memcpy(u->entrada + u->entrada_n, datos, len);
+    u->entrada_n += len;
+    reprogramar(&sim_modelo_uart[n & 3], u);
+    sim_desbloquear();
+}
+
+void sim_uart_salida(int n, int fd)
+{
+    uarts[n & 3].fd = fd;
+}
+
+uint32_t sim_uart_enviados(int n)
+{
+    return uarts[n & 3].enviados;
+}
+
+uint32_t sim_uart_perdidos(int n)
+{
+    return uarts[n & 3].perdidos;
+}
+
+/* Estado de reset y archivos de SIM_UARTn_IN / SIM_UARTn_OUT */
+void sim_uart_iniciar(void)
+{
+    static const int irqs[4] = { 5, 6, 7, 8 };
+    static const int campos[4] = {
+        SIM_PCLK_UART0, SIM_PCLK_UART1, SIM_PCLK_UART2, SIM_PCLK_UART3
+    };
+    char nombre[32];
+    const char *env;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        uart_t *u = &uarts[i];
+
+        u->n = i;
+        u->irq = irqs[i];
+        u->campo_pclk = campos[i];
+        u->dll = 1;
+        u->fdr = 0x10;
+        u->ter = TER_TXEN;
+        u->fd = (i == 0) ? 1 : -1;
+
+        snprintf(nombre, sizeof(nombre), "SIM_UART%d_OUT", i);
+        env = getenv(nombre);
+        if (env != NULL && *env != '\0') {
+            u->fd = (env[0] == '-' && env[1] == '\0') ? 1 :
+                    open(env, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+            if (u->fd < 0) {
+                sim_fatal("no se pudo abrir %s", env);
+            }
+        }
+
+        snprintf(nombre, sizeof(nombre), "SIM_UART%d_IN", i);
+        env = getenv(nombre);
+        if (env != NULL && *env != '\0') {
+            uint8_t buf[4096];
+            ssize_t r;
+            int fd = open(env, O_RDONLY);
+
+            if (fd < 0) {
+                sim_fatal("no se pudo abrir %s", env);
+            }
+            while ((r = read(fd, buf, sizeof(buf))) > 0) {
+                sim_uart_inyectar(i, buf, (uint32_t)r);
+            }
+            close(fd);
+        }
+    }
+}
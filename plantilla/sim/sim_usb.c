@@ -0,0 +1,1253 @@
+/* ============================================================================
+ * sim_usb.c - Modelo del controlador USB device, con el host del otro lado
+ * ============================================================================
+ *
+ * El controlador: el SIE contesta los comandos por USBCmdCode/USBCmdData
+ * enseguida (CCEMTY y CDFULL se levantan en el mismo acceso). Hay 32
+ * endpoints fisicos; los bulk e iso tienen dos buffers y los demas uno,
+ * como en el chip. En modo esclavo el firmware lee y escribe los buffers
+ * por USBRxData/USBTxData y cada paquete que entra o sale levanta el bit
+ * del endpoint en USBEpIntSt (y EP_SLOW en USBDevIntSt). Si dos paquetes
+ * quedan sin atender, el bit vuelve a levantarse despues de limpiarlo, y
+ * EP_SLOW no se deja limpiar mientras quede algun bit levantado.
+ *
+ * Con el bit del endpoint apagado en USBEpIntEn, esos mismos eventos son
+ * pedidos de DMA (USBDMARSt). Si el endpoint tiene el DMA habilitado, el
+ * motor sigue los descriptores desde la UDCA: en OUT copia cada paquete del
+ * buffer del endpoint a memoria, en IN llena los buffers libres; retira el
+ * descriptor (estado y cuenta en la palabra 3) al completar BufLen o con un
+ * paquete corto, levanta EoT, y pasa al siguiente si tiene "next valid".
+ * Sin descriptor valido levanta NDDR una vez y espera. El DMA copia sin
+ * costo de tiempo: el AHB es mucho mas rapido que el bus USB.
+ *
+ * El host (sim_usb_reset, sim_usb_setup, sim_usb_out, sim_usb_in) hace lo
+ * que se le encola en orden, a full speed: cada paquete ocupa su tiempo de
+ * bus (token, datos y handshake, sin bit stuffing) y su efecto se ve al
+ * terminar. Si el endpoint contesta NAK, el host reintenta cuando el
+ * firmware mueve algo en ese endpoint, un NAK despues.
+ *
+ * Mientras el device esta conectado (CON) el host manda un SOF al principio
+ * de cada ms: levanta FRAME en USBDevIntSt si el firmware lo habilito en
+ * USBDevIntEn o si hay algun stream iso (sin eso no hay evento, para no
+ * despertar al simulador cada ms). El SOF no ocupa tiempo de bus. Con
+ * sim_usb_deriva() el reloj del host corre distinto que el CCLK y los
+ * frames duran un poco mas o un poco menos de 1 ms.
+ *
+ * Los endpoints iso (3, 6, 9 y 12) no levantan interrupciones de endpoint:
+ * todo pasa en el SOF. El paquete IN que el host no leyo en el frame
+ * anterior se pierde. Despues el DMA, si el endpoint lo tiene: en OUT lleva
+ * a memoria el paquete del frame anterior (o uno vacio, sin PacketValid, si
+ * no llego nada), en IN carga el de este frame. El descriptor iso cuenta
+ * paquetes (BufLen) y anota cada uno en la palabra de informacion (largo,
+ * PacketValid y numero de frame); la direccion del buffer (palabra 2) y la
+ * de la informacion (palabra 4) avanzan con cada paquete. Al final el host
+ * hace lo de sus streams: manda el paquete OUT de ese frame y lee los IN que
+ * le tocan. Los paquetes iso no ocupan tiempo de la cola del host. En modo
+ * esclavo el firmware los lee y escribe en su evento de FRAME.
+ *
+ * No estan modelados: suspend, los errores del bus ni ATLE.
+ * ========================================================================= */
+
+#include <string.h>
+
+#include "sim_int.h"
+
+#define IRQ_USB         24
+#define NUM_EP          32
+#define MAX_PAQUETE     1023
+#define MAX_PENDIENTES  64
+
+/* USBDevIntSt */
+#define INT_FRAME       (1u << 0)
+#define INT_EP_FAST     (1u << 1)
+#define INT_EP_SLOW     (1u << 2)
+#define INT_DEV_STAT    (1u << 3)
+#define INT_CCEMTY      (1u << 4)
+#define INT_CDFULL      (1u << 5)
+#define INT_EP_RLZED    (1u << 8)
+
+/* USBRxPLen y USBCtrl */
+#define RX_DV           (1u << 10)
+#define RX_PKT_RDY      (1u << 11)
+#define CTRL_RD_EN      (1u << 0)
+#define CTRL_WR_EN      (1u << 1)
+
+/* Fases de USBCmdCode */
+#define FASE_COMANDO    0x05
+#define FASE_ESCRIBIR   0x01
+#define FASE_LEER       0x02
+
+/* Comandos del SIE */
+#define CMD_SET_ADDR    0xD0
+#define CMD_CFG_DEV     0xD8
+#define CMD_SET_MODE    0xF3
+#define CMD_RD_FRAME    0xF5
+#define CMD_RD_TEST     0xFD
+#define CMD_DEV_STAT    0xFE
+#define CMD_ERR_CODE    0xFF
+#define CMD_ERR_STAT    0xFB
+#define CMD_CLR_BUF     0xF2
+#define CMD_VALID_BUF   0xFA
+
+#define DEV_CON         (1u << 0)
+#define DEV_CON_CH      (1u << 1)
+#define DEV_SUS_CH      (1u << 3)
+#define DEV_RST         (1u << 4)
+
+/* Respuesta de Select Endpoint y bits de Set Endpoint Status */
+#define SEL_F           (1u << 0)
+#define SEL_ST          (1u << 1)
+#define SEL_STP         (1u << 2)
+#define SEL_B1          (1u << 5)
+#define SEL_B2          (1u << 6)
+#define EST_ST          (1u << 0)
+#define EST_DA          (1u << 5)
+
+/* Descriptores de DMA (no iso) */
+#define DD_NEXT_VALID   (1u << 2)
+#define DD_ISO          (1u << 4)
+#define DD_RETIRADO     (1u << 0)
+#define DD_NORMAL       2u
+#define DD_CORTO        3u
+#define DD_OVERRUN      8u
+#define DMA_EOT         (1u << 0)
+#define DMA_NDDR        (1u << 1)
+#define DMA_SYSERR      (1u << 2)
+
+/* Palabra de informacion de los paquetes iso */
+#define ISO_VALIDO      (1u << 16)
+#define ISO_FRAME(f)    ((uint32_t)(f) << 17)
+
+/* Endpoints logicos con dos buffers (bulk e iso) y los iso */
+#define EP_ISO          0x1248u
+#define EP_DOBLES       (0xC924u | EP_ISO)
+#define NUM_EP_LOG      16
+
+typedef struct {
+    uint8_t datos[MAX_PAQUETE + 1];
+    uint32_t len;
+} paquete_t;
+
+typedef struct {
+    uint32_t max;           /* USBMaxPSize */
+    uint32_t estado;        /* EST_ST, EST_DA */
+    int setup;              /* el paquete del buffer es un SETUP */
+    paquete_t buf[2];
+    int nbuf, cab, llenos;
+    uint32_t eventos;       /* paquetes que levantaron el bit y no se atendieron */
+    int sin_dd;             /* ya levanto NDDR */
+} ep_t;
+
+enum { H_RESET, H_SETUP, H_OUT, H_IN };
+
+typedef struct {
+    int tipo;
+    int ep;                 /* logico */
+    uint8_t setup[8];
+    const uint8_t *sale;
+    uint8_t *entra;
+    uint32_t len;           /* OUT: a mandar; IN: maximo */
+    uint32_t hecho;
+    uint32_t *movidos;
+} pedido_t;
+
+typedef struct {
+    /* Registros */
+    uint32_t dev_st, dev_en, dev_pri;
+    uint32_t cmd_data;
+    uint32_t ctrl, rx_pos, tx_len, tx_pos;
+    uint8_t tx_datos[MAX_PAQUETE + 1];
+    uint32_t ep_en, ep_pri, re_ep, ep_ind;
+    uint32_t dmar_st, udcah, dma_st, dma_en;
+    uint32_t eot_st, nddr_st, syserr_st;
+    uint32_t clk_ctrl;
+
+    /* SIE */
+    uint32_t comando;       /* ultimo de la fase de comando */
+    int sel;                /* endpoint seleccionado */
+    uint32_t lectura[2];
+    int leidos;
+    uint32_t dir, config, modo, estado_dev;
+
+    ep_t ep[NUM_EP];
+
+    /* El host */
+    pedido_t cola[MAX_PENDIENTES];
+    int cola_cab, cola_n;
+    uint64_t host_prox;     /* proximo intento, o fin del paquete en curso */
+    int en_curso;           /* host_prox es el fin de un paquete */
+    int esperando;          /* NAK: se reintenta cuando el firmware mueva algo */
+    uint32_t paquetes, naks, stalls;
+    uint64_t sof_prox;      /* proximo SOF, si FRAME esta habilitada */
+    uint32_t frame;         /* SOFs desde el arranque */
+    int32_t ppm;            /* deriva del reloj del host */
+    int64_t sof_resto;      /* fraccion de ciclo acumulada por la deriva */
+
+    /* Streams iso del host, por endpoint logico */
+    sim_usb_iso_out_t iso_out[NUM_EP_LOG];
+    sim_usb_iso_in_t iso_in[NUM_EP_LOG];
+    uint32_t iso_cada[NUM_EP_LOG];
+    uint32_t iso_perdidos;
+} usb_t;
+
+static usb_t usb;
+
+static void *memoria(uint32_t dir)
+{
+    return (void *)(uintptr_t)dir;
+}
+
+/* --- Tiempos --------------------------------------------------------------- */
+
+/* Ciclos de CCLK de una transaccion con "len" bytes de datos a 12 Mbit/s:
+ * token, paquete de datos, handshake y separaciones, unos 13 bytes */
+static uint64_t ciclos_bus(uint32_t len)
+{
+    return ((uint64_t)(len + 13) * 8 * sim_cclk()) / 12000000u;
+}
+
+/* Un frame: 1 ms */
+static uint64_t ciclos_frame(void)
+{
+    return sim_cclk() / 1000u;
+}
+
+/* Un intento que contesto NAK: token y handshake */
+static uint64_t ciclos_nak(void)
+{
+    return ciclos_bus(0);
+}
+
+/* --- Interrupciones -------------------------------------------------------- */
+
+static uint32_t dma_int_st(void)
+{
+    return (usb.eot_st ? DMA_EOT : 0) | (usb.nddr_st ? DMA_NDDR : 0) |
+           (usb.syserr_st ? DMA_SYSERR : 0);
+}
+
+static uint32_t ep_int_st(void)
+{
+    uint32_t st = 0;
+    int i;
+
+    for (i = 0; i < NUM_EP; i++) {
+        if (usb.ep[i].eventos) {
+            st |= 1u << i;
+        }
+    }
+    return st;
+}
+
+static void actualizar_irq(void)
+{
+    sim_irq_nivel(IRQ_USB, (usb.dev_st & usb.dev_en) != 0 ||
+                           (dma_int_st() & usb.dma_en) != 0);
+}
+
+/* El host espera que el firmware mueva algo: reintentar un NAK despues */
+static void despertar(void)
+{
+    if (usb.esperando) {
+        usb.esperando = 0;
+        usb.host_prox = sim_t + ciclos_nak();
+        sim_programar(&sim_modelo_usb, usb.host_prox);
+    }
+}
+
+/* --- Endpoints ------------------------------------------------------------- */
+
+static void ep_vaciar(ep_t *e)
+{
+    e->cab = 0;
+    e->llenos = 0;
+    e->setup = 0;
+    e->eventos = 0;
+    e->sin_dd = 0;
+}
+
+static void ep_realizar(int n, uint32_t max)
+{
+    ep_t *e = &usb.ep[n];
+
+    e->max = max;
+    e->nbuf = ((EP_DOBLES >> (n >> 1)) & 1) ? 2 : 1;
+    ep_vaciar(e);
+    usb.dev_st |= INT_EP_RLZED;
+}
+
+static int ep_realizado(int n)
+{
+    return (usb.re_ep >> n) & 1;
+}
+
+static int ep_es_iso(int n)
+{
+    return (EP_ISO >> (n >> 1)) & 1;
+}
+
+/* Hay algo para el DMA: un paquete para llevar (OUT) o un buffer libre (IN) */
+static int ep_listo(int n)
+{
+    ep_t *e = &usb.ep[n];
+
+    return (n & 1) ? e->llenos < e->nbuf : e->llenos > 0;
+}
+
+static uint32_t ep_seleccionar(int n)
+{
+    ep_t *e = &usb.ep[n];
+    uint32_t st = 0;
+
+    if ((n & 1) ? e->llenos == e->nbuf : e->llenos > 0) {
+        st |= SEL_F;
+    }
+    if (e->estado & EST_ST) {
+        st |= SEL_ST;
+    }
+    if (e->setup) {
+        st |= SEL_STP;
+    }
+    if (e->llenos >= 1) {
+        st |= SEL_B1;
+    }
+    if (e->llenos >= 2) {
+        st |= SEL_B2;
+    }
+    return st;
+}
+
+static void dma_servir(void);
+
+/* Un paquete entro (OUT) o salio (IN) del endpoint n */
+static void ep_evento(int n)
+{
+    if (usb.ep_en & (1u << n)) {
+        usb.ep[n].eventos++;
+        usb.dev_st |= (usb.ep_pri & (1u << n)) ? INT_EP_FAST : INT_EP_SLOW;
+    } else {
+        usb.dmar_st |= 1u << n;
+        dma_servir();
+    }
+}
+
+/* Select Endpoint/Clear Interrupt */
+static uint32_t ep_limpiar(int n)
+{
+    ep_t *e = &usb.ep[n];
+    uint32_t st = ep_seleccionar(n);
+
+    if (e->eventos) {
+        e->eventos--;
+    }
+    if (n == 0) {
+        e->setup = 0;
+    }
+    return st;
+}
+
+/* Un buffer lleno del endpoint OUT vuelve a estar libre (Clear Buffer) */
+static void ep_liberar(ep_t *e)
+{
+    if (e->llenos) {
+        e->cab = (e->cab + 1) % e->nbuf;
+        e->llenos--;
+    }
+    despertar();
+}
+
+/* --- DMA ------------------------------------------------------------------- */
+
+static void dma_retirar(int n, uint32_t *dd, uint32_t estado, uint32_t cuenta)
+{
+    uint32_t *udca = memoria(usb.udcah + 4 * n);
+
+    dd[3] = (dd[3] & 0xFF00u) | (cuenta << 16) | (estado << 1) | DD_RETIRADO;
+    usb.eot_st |= 1u << n;
+    if (dd[1] & DD_NEXT_VALID) {
+        *udca = dd[0];
+    }
+}
+
+/* El descriptor que atiende el endpoint n, o NULL (y NDDR) si no hay o
+ * si es de otro tipo (iso o no) que el endpoint */
+static uint32_t *dma_descriptor(int n)
+{
+    uint32_t dir = *(uint32_t *)memoria(usb.udcah + 4 * n);
+    uint32_t *dd = dir ? memoria(dir) : NULL;
+
+    if (dd != NULL && !(dd[3] & DD_RETIRADO) &&
+        !(dd[1] & DD_ISO) == !ep_es_iso(n)) {
+        return dd;
+    }
+    if (!usb.ep[n].sin_dd) {
+        usb.ep[n].sin_dd = 1;
+        usb.nddr_st |= 1u << n;
+    }
+    return NULL;
+}
+
+static void dma_out(int n)
+{
+    ep_t *e = &usb.ep[n];
+
+    while (e->llenos) {
+        paquete_t *p = &e->buf[e->cab];
+        uint32_t *dd = dma_descriptor(n);
+        uint32_t max, largo, cuenta, n_copia;
+
+        if (dd == NULL) {
+            return;
+        }
+        max = (dd[1] >> 5) & 0x7FF;
+        largo = dd[1] >> 16;
+        cuenta = dd[3] >> 16;
+        n_copia = p->len;
+        if (cuenta + n_copia > largo) {
+            n_copia = largo - cuenta;
+        }
+        memcpy((uint8_t *)memoria(dd[2]) + cuenta, p->datos, n_copia);
+        cuenta += n_copia;
+        ep_liberar(e);
+        if (n_copia < p->len) {
+            dma_retirar(n, dd, DD_OVERRUN, cuenta);
+        } else if (p->len < max) {
+            dma_retirar(n, dd, DD_CORTO, cuenta);
+        } else if (cuenta == largo) {
+            dma_retirar(n, dd, DD_NORMAL, cuenta);
+        } else {
+            dd[3] = (dd[3] & 0xFF00u) | (cuenta << 16) | (1u << 1);
+        }
+    }
+}
+
+static void dma_in(int n)
+{
+    ep_t *e = &usb.ep[n];
+
+    while (e->llenos < e->nbuf) {
+        paquete_t *p = &e->buf[(e->cab + e->llenos) % e->nbuf];
+        uint32_t *dd = dma_descriptor(n);
+        uint32_t max, largo, cuenta;
+
+        if (dd == NULL) {
+            return;
+        }
+        max = (dd[1] >> 5) & 0x7FF;
+        largo = dd[1] >> 16;
+        cuenta = dd[3] >> 16;
+        p->len = largo - cuenta;
+        if (p->len > max) {
+            p->len = max;
+        }
+        memcpy(p->datos, (uint8_t *)memoria(dd[2]) + cuenta, p->len);
+        cuenta += p->len;
+        e->llenos++;
+        despertar();
+        if (cuenta == largo) {
+            dma_retirar(n, dd, DD_NORMAL, cuenta);
+        } else {
+            dd[3] = (dd[3] & 0xFF00u) | (cuenta << 16) | (1u << 1);
+        }
+    }
+}
+
+/* Un paquete iso por frame: OUT lleva el del frame anterior (o uno vacio),
+ * IN carga el siguiente si hay un buffer libre */
+static void dma_iso(int n)
+{
+    ep_t *e = &usb.ep[n];
+    uint32_t *dd, *info, paquetes, cuenta, len;
+    paquete_t *p;
+
+    if ((n & 1) && e->llenos == e->nbuf) {
+        return;
+    }
+    dd = dma_descriptor(n);
+    if (dd == NULL) {
+        return;
+    }
+    paquetes = dd[1] >> 16;
+    cuenta = dd[3] >> 16;
+    info = memoria(dd[4]);
+    if (n & 1) {
+        p = &e->buf[(e->cab + e->llenos) % e->nbuf];
+        len = *info & 0xFFFF;
+        if (len > e->max) {
+            len = e->max;
+        }
+        memcpy(p->datos, memoria(dd[2]), len);
+        p->len = len;
+        e->llenos++;
+        *info = len | ISO_VALIDO | ISO_FRAME(usb.frame);
+    } else if (e->llenos) {
+        p = &e->buf[e->cab];
+        len = p->len;
+        memcpy(memoria(dd[2]), p->datos, len);
+        *info = len | ISO_VALIDO | ISO_FRAME(usb.frame);
+        ep_liberar(e);
+    } else {
+        len = 0;
+        *info = ISO_FRAME(usb.frame);
+    }
+    dd[2] += len;
+    dd[4] += 4;
+    if (++cuenta == paquetes) {
+        dma_retirar(n, dd, DD_NORMAL, cuenta);
+    } else {
+        dd[3] = (dd[3] & 0xFF00u) | (cuenta << 16) | (1u << 1);
+    }
+}
+
+/* Atiende los pedidos de DMA de los endpoints con el DMA habilitado; el
+ * pedido se baja cuando ya no hay nada que mover */
+static void dma_servir(void)
+{
+    int n;
+
+    for (n = 2; n < NUM_EP; n++) {
+        uint32_t bit = 1u << n;
+
+        if (!(usb.dmar_st & bit) || !(usb.dma_st & bit) || (usb.ep_en & bit) ||
+            ep_es_iso(n)) {
+            continue;
+        }
+        if (n & 1) {
+            dma_in(n);
+        } else {
+            dma_out(n);
+        }
+        if (!ep_listo(n)) {
+            usb.dmar_st &= ~bit;
+        }
+    }
+    actualizar_irq();
+}
+
+/* --- SIE ------------------------------------------------------------------- */
+
+static void bus_reset(void)
+{
+    int i;
+
+    usb.dir = 0;
+    usb.config = 0;
+    usb.re_ep = 3;
+    for (i = 0; i < NUM_EP; i++) {
+        ep_vaciar(&usb.ep[i]);
+        usb.ep[i].estado = 0;
+    }
+    ep_realizar(0, usb.ep[0].max ? usb.ep[0].max : 8);
+    ep_realizar(1, usb.ep[1].max ? usb.ep[1].max : 8);
+    usb.dev_st &= ~INT_EP_RLZED;
+    usb.estado_dev |= DEV_RST;
+    usb.dev_st |= INT_DEV_STAT;
+}
+
+static void sie_comando(uint32_t codigo)
+{
+    usb.comando = codigo;
+    usb.leidos = 0;
+    if (codigo < NUM_EP) {
+        usb.sel = (int)codigo;
+        usb.lectura[0] = ep_seleccionar(usb.sel);
+    } else if (codigo >= 0x40 && codigo < 0x40 + NUM_EP) {
+        /* Select Endpoint/Clear Interrupt, o Set Endpoint Status si sigue
+         * una escritura: se decide en la fase siguiente */
+        usb.sel = (int)codigo - 0x40;
+    } else {
+        switch (codigo) {
+        case CMD_CLR_BUF:
+            usb.lectura[0] = 0;
+            ep_liberar(&usb.ep[usb.sel]);
+            usb.ep[usb.sel].setup = 0;
+            break;
+        case CMD_VALID_BUF: {
+            ep_t *e = &usb.ep[usb.sel];
+
+            if (!(usb.sel & 1)) {
+                break;
+            }
+            if (e->llenos == e->nbuf) {
+                sim_fatal("USB: Validate Buffer del endpoint %d sin buffer libre",
+                          usb.sel);
+            }
+            memcpy(e->buf[(e->cab + e->llenos) % e->nbuf].datos, usb.tx_datos,
+                   usb.tx_len);
+            e->buf[(e->cab + e->llenos) % e->nbuf].len = usb.tx_len;
+            e->llenos++;
+            usb.tx_len = 0;
+            despertar();
+            break;
+        }
+        case CMD_RD_FRAME: {
+            uint32_t frame = (uint32_t)(sim_t / ciclos_frame()) & 0x7FF;
+
+            usb.lectura[0] = frame & 0xFF;
+            usb.lectura[1] = frame >> 8;
+            break;
+        }
+        case CMD_RD_TEST:
+            usb.lectura[0] = 0x0F;
+            usb.lectura[1] = 0xA5;
+            break;
+        case CMD_DEV_STAT:
+            usb.lectura[0] = usb.estado_dev;
+            break;
+        case CMD_ERR_CODE:
+        case CMD_ERR_STAT:
+            usb.lectura[0] = 0;
+            break;
+        }
+    }
+}
+
+static void sie_escribir(uint32_t dato)
+{
+    uint32_t codigo = usb.comando;
+
+    if (codigo >= 0x40 && codigo < 0x40 + NUM_EP) {
+        ep_t *e = &usb.ep[codigo - 0x40];
+
+        e->estado = dato & (EST_ST | EST_DA);
+        despertar();
+        return;
+    }
+    switch (codigo) {
+    case CMD_SET_ADDR: usb.dir = dato & 0xFF; break;
+    case CMD_CFG_DEV:  usb.config = dato & 1; break;
+    case CMD_SET_MODE: usb.modo = dato & 0xFF; break;
+    case CMD_DEV_STAT:
+        usb.estado_dev = (usb.estado_dev & ~DEV_CON) | (dato & DEV_CON);
+        break;
+    }
+}
+
+static uint32_t sie_leer(void)
+{
+    uint32_t codigo = usb.comando;
+    uint32_t v;
+
+    if (codigo >= 0x40 && codigo < 0x40 + NUM_EP) {
+        return ep_limpiar((int)codigo - 0x40);
+    }
+    v = usb.lectura[usb.leidos & 1];
+    usb.leidos++;
+    if (codigo == CMD_DEV_STAT) {
+        /* Leer el estado baja los bits de cambio */
+        usb.estado_dev &= ~(DEV_CON_CH | DEV_SUS_CH | DEV_RST);
+    }
+    return v;
+}
+
+/* --- El host --------------------------------------------------------------- */
+
+static void host_terminar(pedido_t *p)
+{
+    if (p->movidos != NULL) {
+        *p->movidos = p->hecho;
+    }
+    usb.cola_cab = (usb.cola_cab + 1) % MAX_PENDIENTES;
+    usb.cola_n--;
+}
+
+/* Termina el paquete en curso del primer pedido */
+static void host_completar(void)
+{
+    pedido_t *p = &usb.cola[usb.cola_cab];
+    ep_t *e;
+    paquete_t *b;
+    uint32_t n;
+
+    switch (p->tipo) {
+    case H_RESET:
+        host_terminar(p);
+        break;
+    case H_SETUP:
+        e = &usb.ep[0];
+        e->cab = 0;
+        e->llenos = 1;
+        e->setup = 1;
+        memcpy(e->buf[0].datos, p->setup, 8);
+        e->buf[0].len = 8;
+        e->estado &= ~EST_ST;
+        usb.ep[1].estado &= ~EST_ST;
+        usb.paquetes++;
+        host_terminar(p);
+        ep_evento(0);
+        break;
+    case H_OUT:
+        e = &usb.ep[2 * p->ep];
+        b = &e->buf[(e->cab + e->llenos) % e->nbuf];
+        n = p->len - p->hecho;
+        if (n > e->max) {
+            n = e->max;
+        }
+        memcpy(b->datos, p->sale + p->hecho, n);
+        b->len = n;
+        e->llenos++;
+        p->hecho += n;
+        usb.paquetes++;
+        if (p->hecho >= p->len) {
+            host_terminar(p);
+        }
+        ep_evento(2 * p->ep);
+        break;
+    case H_IN:
+        e = &usb.ep[2 * p->ep + 1];
+        b = &e->buf[e->cab];
+        n = b->len;
+        if (n > p->len - p->hecho) {
+            n = p->len - p->hecho;
+        }
+        if (p->entra != NULL) {
+            memcpy(p->entra + p->hecho, b->datos, n);
+        }
+        p->hecho += n;
+        e->cab = (e->cab + 1) % e->nbuf;
+        e->llenos--;
+        usb.paquetes++;
+        if (b->len < e->max || p->hecho >= p->len) {
+            host_terminar(p);
+        }
+        ep_evento(2 * p->ep + 1);
+        break;
+    }
+}
+
+static void host_no_realizado(int n)
+{
+    sim_fatal("USB: el host usa el endpoint %d, que el firmware no realizo", n);
+}
+
+static void host_es_iso(int n)
+{
+    sim_fatal("USB: el endpoint %d es iso: va con sim_usb_iso_out/in", n);
+}
+
+/* Empieza el paquete siguiente en "ahora": lo que dura, o NAK */
+static void host_empezar(uint64_t ahora)
+{
+    pedido_t *p = &usb.cola[usb.cola_cab];
+    ep_t *e;
+    uint32_t n;
+
+    usb.host_prox = SIM_NUNCA;
+    usb.en_curso = 0;
+    if (usb.cola_n == 0) {
+        return;
+    }
+    switch (p->tipo) {
+    case H_RESET:
+        bus_reset();
+        usb.host_prox = ahora + sim_cclk() / 100u;          /* 10 ms */
+        break;
+    case H_SETUP:
+        usb.host_prox = ahora + ciclos_bus(8);
+        break;
+    case H_OUT:
+        n = 2 * p->ep;
+        e = &usb.ep[n];
+        if (!ep_realizado(n)) {
+            host_no_realizado(n);
+        }
+        if (ep_es_iso(n)) {
+            host_es_iso(n);
+        }
+        if (e->estado & EST_ST) {
+            usb.stalls++;
+            host_terminar(p);
+            host_empezar(ahora + ciclos_nak());
+            return;
+        }
+        if ((e->estado & EST_DA) || e->llenos == e->nbuf) {
+            usb.naks++;
+            usb.esperando = 1;
+            return;
+        }
+        n = p->len - p->hecho;
+        usb.host_prox = ahora + ciclos_bus(n > e->max ? e->max : n);
+        break;
+    case H_IN:
+        n = 2 * p->ep + 1;
+        e = &usb.ep[n];
+        if (!ep_realizado(n)) {
+            host_no_realizado(n);
+        }
+        if (ep_es_iso(n)) {
+            host_es_iso(n);
+        }
+        if (e->estado & EST_ST) {
+            usb.stalls++;
+            host_terminar(p);
+            host_empezar(ahora + ciclos_nak());
+            return;
+        }
+        if ((e->estado & EST_DA) || e->llenos == 0) {
+            usb.naks++;
+            usb.esperando = 1;
+            return;
+        }
+        usb.host_prox = ahora + ciclos_bus(e->buf[e->cab].len);
+        break;
+    }
+    usb.en_curso = 1;
+}
+
+/* --- Frames --------------------------------------------------------------- */
+
+static int hay_iso(void)
+{
+    int i;
+
+    for (i = 0; i < NUM_EP_LOG; i++) {
+        if (usb.iso_out[i] != NULL || usb.iso_in[i] != NULL) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Los SOF corren mientras el device esta conectado y FRAME habilitada, o
+ * mientras haya streams iso */
+static void sof_planificar(void)
+{
+    if (!((usb.dev_en & INT_FRAME) || hay_iso()) || !(usb.estado_dev & DEV_CON)) {
+        usb.sof_prox = SIM_NUNCA;
+    } else if (usb.sof_prox == SIM_NUNCA) {
+        usb.sof_prox = (sim_t / ciclos_frame() + 1) * ciclos_frame();
+    }
+}
+
+/* Lo que dura este frame con la deriva del host; la fraccion de ciclo que
+ * sobra se acumula para el siguiente */
+static uint64_t sof_periodo(void)
+{
+    int64_t base = (int64_t)ciclos_frame();
+    int64_t x = base * usb.ppm + usb.sof_resto;
+    int64_t extra = x / 1000000;
+
+    usb.sof_resto = x - extra * 1000000;
+    return (uint64_t)(base + extra);
+}
+
+/* El endpoint iso n puede mover datos en este frame */
+static int iso_activo(int n)
+{
+    return ep_realizado(n) && !(usb.ep[n].estado & EST_DA);
+}
+
+/* El host en el frame: un paquete OUT por stream y las lecturas IN */
+static void iso_host(void)
+{
+    uint8_t datos[MAX_PAQUETE + 1];
+    int ep;
+
+    for (ep = 1; ep < NUM_EP_LOG; ep++) {
+        int n = 2 * ep;
+        ep_t *e = &usb.ep[n];
+
+        if (usb.iso_out[ep] != NULL && iso_activo(n)) {
+            uint32_t len = usb.iso_out[ep](datos, e->max);
+
+            if (len > e->max) {
+                sim_fatal("USB: paquete iso de %u bytes al endpoint %d (maximo %u)",
+                          (unsigned)len, n, (unsigned)e->max);
+            }
+            if (len == 0) {
+                /* nada en este frame */
+            } else if (e->llenos == e->nbuf) {
+                usb.iso_perdidos++;
+            } else {
+                paquete_t *b = &e->buf[(e->cab + e->llenos) % e->nbuf];
+
+                memcpy(b->datos, datos, len);
+                b->len = len;
+                e->llenos++;
+                usb.paquetes++;
+            }
+        }
+        n = 2 * ep + 1;
+        e = &usb.ep[n];
+        if (usb.iso_in[ep] != NULL && usb.frame % usb.iso_cada[ep] == 0) {
+            if (iso_activo(n) && e->llenos) {
+                paquete_t *b = &e->buf[e->cab];
+
+                e->cab = (e->cab + 1) % e->nbuf;
+                e->llenos--;
+                usb.paquetes++;
+                usb.iso_in[ep](b->datos, b->len);
+            } else {
+                usb.iso_in[ep](datos, 0);
+            }
+        }
+    }
+}
+
+static void sof(void)
+{
+    int n;
+
+    usb.frame++;
+    usb.dev_st |= INT_FRAME;
+    for (n = 2; n < NUM_EP; n++) {
+        uint32_t bit = 1u << n;
+
+        if (!ep_es_iso(n)) {
+            continue;
+        }
+        if (n & 1) {
+            usb.ep[n].cab = 0;                  /* su frame ya paso */
+            usb.ep[n].llenos = 0;
+        }
+        if (iso_activo(n) && (usb.dma_st & bit) && !(usb.ep_en & bit)) {
+            dma_iso(n);
+        }
+    }
+    iso_host();
+    actualizar_irq();
+}
+
+static uint64_t usb_proximo(void)
+{
+    return usb.host_prox < usb.sof_prox ? usb.host_prox : usb.sof_prox;
+}
+
+/* --- Eventos --------------------------------------------------------------- */
+
+static uint64_t usb_avanzar(sim_modelo_t *m, uint64_t ahora)
+{
+    (void)m;
+    while (usb.host_prox <= ahora) {
+        uint64_t t = usb.host_prox;
+
+        if (usb.en_curso) {
+            host_completar();
+        }
+        host_empezar(t);
+        actualizar_irq();
+    }
+    /* Los frames sin atender se pierden: FRAME queda levantada */
+    while (usb.sof_prox <= ahora) {
+        usb.sof_prox += sof_periodo();
+        sof();
+    }
+    return usb_proximo();
+}
+
+/* --- Registros ------------------------------------------------------------- */
+
+static uint32_t usb_mirar(sim_modelo_t *m, uint32_t off)
+{
+    ep_t *e;
+
+    (void)m;
+    switch (off) {
+    case 0x200: return usb.dev_st;
+    case 0x204: return usb.dev_en;
+    case 0x214: return usb.cmd_data;
+    case 0x218:
+        e = &usb.ep[((usb.ctrl >> 2) & 0xF) * 2];
+        if (!(usb.ctrl & CTRL_RD_EN) || e->llenos == 0) {
+            return 0;
+        }
+        {
+            uint32_t v = 0;
+            int i;
+
+            for (i = 0; i < 4 && usb.rx_pos + i < e->buf[e->cab].len; i++) {
+                v |= (uint32_t)e->buf[e->cab].datos[usb.rx_pos + i] << (8 * i);
+            }
+            return v;
+        }
+    case 0x220:
+        e = &usb.ep[((usb.ctrl >> 2) & 0xF) * 2];
+        if (!(usb.ctrl & CTRL_RD_EN) || e->llenos == 0) {
+            return 0;
+        }
+        return e->buf[e->cab].len | RX_DV | RX_PKT_RDY;
+    case 0x228: return usb.ctrl;
+    case 0x22C: return usb.dev_pri;
+    case 0x230: return ep_int_st();
+    case 0x234: return usb.ep_en;
+    case 0x240: return usb.ep_pri;
+    case 0x244: return usb.re_ep;
+    case 0x248: return usb.ep_ind;
+    case 0x24C: return usb.ep[usb.ep_ind].max;
+    case 0x250: return usb.dmar_st;
+    case 0x280: return usb.udcah;
+    case 0x284: return usb.dma_st;
+    case 0x290: return dma_int_st();
+    case 0x294: return usb.dma_en;
+    case 0x2A0: return usb.eot_st;
+    case 0x2AC: return usb.nddr_st;
+    case 0x2B8: return usb.syserr_st;
+    case 0xFF4: return usb.clk_ctrl;
+    case 0xFF8: return usb.clk_ctrl;
+    }
+    return 0;
+}
+
+static uint32_t usb_leer(sim_modelo_t *m, uint32_t off)
+{
+    uint32_t v = usb_mirar(m, off);
+    ep_t *e;
+
+    if (off == 0x218 && (usb.ctrl & CTRL_RD_EN)) {
+        e = &usb.ep[((usb.ctrl >> 2) & 0xF) * 2];
+        usb.rx_pos += 4;
+        if (e->llenos == 0 || usb.rx_pos >= e->buf[e->cab].len) {
+            usb.ctrl &= ~CTRL_RD_EN;
+        }
+    }
+    return v;
+}
+
+static void usb_escribir(sim_modelo_t *m, uint32_t off, uint32_t val, uint32_t lanes)
+{
+    uint32_t fase, codigo;
+    int n;
+
+    (void)lanes;
+    switch (off) {
+    case 0x204: usb.dev_en = val & 0x3FF; break;
+    case 0x208:
+        usb.dev_st &= ~val;
+        /* EP_SLOW vuelve si quedan eventos sin atender */
+        if (ep_int_st() & ~usb.ep_pri) {
+            usb.dev_st |= (val & INT_EP_SLOW);
+        }
+        if (ep_int_st() & usb.ep_pri) {
+            usb.dev_st |= (val & INT_EP_FAST);
+        }
+        break;
+    case 0x20C: usb.dev_st |= val & 0x3FF; break;
+    case 0x210:
+        fase = (val >> 8) & 0xFF;
+        codigo = (val >> 16) & 0xFF;
+        if (fase == FASE_COMANDO) {
+            sie_comando(codigo);
+        } else if (fase == FASE_ESCRIBIR) {
+            sie_escribir(codigo);
+        } else if (fase == FASE_LEER) {
+            usb.cmd_data = sie_leer();
+            usb.dev_st |= INT_CDFULL;
+        }
+        usb.dev_st |= INT_CCEMTY;
+        break;
+    case 0x224:
+        usb.tx_len = val & 0x3FF;
+        usb.tx_pos = 0;
+        break;
+    case 0x21C:
+        if (usb.ctrl & CTRL_WR_EN) {
+            int i;
+
+            for (i = 0; i < 4 && usb.tx_pos < usb.tx_len; i++) {
+                usb.tx_datos[usb.tx_pos++] = (uint8_t)(val >> (8 * i));
+            }
+            if (usb.tx_pos >= usb.tx_len) {
+                usb.ctrl &= ~CTRL_WR_EN;
+            }
+        }
+        break;
+    case 0x228:
+        usb.ctrl = val & 0x3F;
+        usb.rx_pos = 0;
+        break;
+    case 0x22C: usb.dev_pri = val & 1; break;
+    case 0x234: usb.ep_en = val; break;
+    case 0x238:
+        for (n = 0; n < NUM_EP; n++) {
+            if (val & (1u << n)) {
+                usb.cmd_data = ep_limpiar(n);
+                usb.dev_st |= INT_CDFULL;
+            }
+        }
+        break;
+    case 0x23C:
+        for (n = 0; n < NUM_EP; n++) {
+            if ((val & (1u << n)) && usb.ep[n].eventos == 0) {
+                usb.ep[n].eventos = 1;
+                usb.dev_st |= (usb.ep_pri & (1u << n)) ? INT_EP_FAST : INT_EP_SLOW;
+            }
+        }
+        break;
+    case 0x240: usb.ep_pri = val; break;
+    case 0x244:
+        for (n = 0; n < NUM_EP; n++) {
+            if ((val & ~usb.re_ep) & (1u << n)) {
+                ep_realizar(n, usb.ep[n].max);
+            }
+        }
+        usb.re_ep = val;
+        usb.dev_st |= INT_EP_RLZED;
+        break;
+    case 0x248: usb.ep_ind = val & 0x1F; break;
+    case 0x24C:
+        ep_realizar((int)usb.ep_ind, val & 0x3FF);
+        break;
+    case 0x254: usb.dmar_st &= ~val; break;
+    case 0x258:
+        usb.dmar_st |= val;
+        for (n = 0; n < NUM_EP; n++) {
+            if (val & (1u << n)) {
+                usb.ep[n].sin_dd = 0;
+            }
+        }
+        break;
+    case 0x280: usb.udcah = val & ~0x7Fu; break;
+    case 0x288:
+        usb.dma_st |= val;
+        for (n = 0; n < NUM_EP; n++) {
+            if (val & (1u << n)) {
+                usb.ep[n].sin_dd = 0;
+            }
+        }
+        break;
+    case 0x28C: usb.dma_st &= ~val; break;
+    case 0x294: usb.dma_en = val & 7; break;
+    case 0x2A4: usb.eot_st &= ~val; break;
+    case 0x2A8: usb.eot_st |= val; break;
+    case 0x2B0: usb.nddr_st &= ~val; break;
+    case 0x2B4: usb.nddr_st |= val; break;
+    case 0x2BC: usb.syserr_st &= ~val; break;
+    case 0x2C0: usb.syserr_st |= val; break;
+    case 0xFF4: usb.clk_ctrl = val & 0x1F; break;
+    }
+    dma_servir();
+    sof_planificar();
+    actualizar_irq();
+    m->proximo = usb_proximo();
+    sim_replanificar();
+}
+
+sim_modelo_t sim_modelo_usb = {
+    "USB", 0x5000C000u, 0x1000, usb_leer, usb_mirar, usb_escribir,
+    usb_avanzar, &usb, SIM_NUNCA
+};
+
+/* --- API publica ----------------------------------------------------------- */
+
+static pedido_t *encolar(int tipo, int ep)
+{
+    pedido_t *p;
+
+    if (usb.cola_n == MAX_PENDIENTES) {
+        sim_fatal("USB: mas de %d pedidos del host encolados", MAX_PENDIENTES);
+    }
+    p = &usb.cola[(usb.cola_cab + usb.cola_n) % MAX_PENDIENTES];
+    memset(p, 0, sizeof(*p));
+    p->tipo = tipo;
+    p->ep = ep & 0xF;
+    if (usb.cola_n++ == 0 && !usb.en_curso) {
+        usb.esperando = 0;
+        usb.host_prox = sim_t;
+        sim_programar(&sim_modelo_usb, sim_t);
+    }
+    return p;
+}
+
+void sim_usb_reset(void)
+{
+    sim_bloquear();
+    encolar(H_RESET, 0);
+    sim_desbloquear();
+}
+
+void sim_usb_setup(const void *paquete)
+{
+    sim_bloquear();
+    memcpy(encolar(H_SETUP, 0)->setup, paquete, 8);
+    sim_desbloquear();
+}
+
+void sim_usb_out(int ep, const void *datos, uint32_t len, uint32_t *movidos)
+{
+    pedido_t *p;
+
+    sim_bloquear();
+    p = encolar(H_OUT, ep);
+    p->sale = datos;
+    p->len = len;
+    p->movidos = movidos;
+    sim_desbloquear();
+}
+
+void sim_usb_in(int ep, void *datos, uint32_t max, uint32_t *movidos)
+{
+    pedido_t *p;
+
+    sim_bloquear();
+    p = encolar(H_IN, ep);
+    p->entra = datos;
+    p->len = max;
+    p->movidos = movidos;
+    sim_desbloquear();
+}
+
+int sim_usb_listo(void)
+{
+    return usb.cola_n == 0;
+}
+
+uint32_t sim_usb_paquetes(void)
+{
+    return usb.paquetes;
+}
+
+uint32_t sim_usb_naks(void)
+{
+    return usb.naks;
+}
+
+uint32_t sim_usb_stalls(void)
+{
+    return usb.stalls;
+}
+
+/* Los streams iso y la deriva cambian cuando corren los SOF */
+static void iso_cambio(void)
+{
+    sof_planificar();
+    sim_modelo_usb.proximo = usb_proximo();
+    sim_replanificar();
+}
+
+void sim_usb_iso_out(int ep, sim_usb_iso_out_t fn)
+{
+    sim_bloquear();
+    usb.iso_out[ep & 0xF] = fn;
+    iso_cambio();
+    sim_desbloquear();
+}
+
+void sim_usb_iso_in(int ep, uint32_t cada, sim_usb_iso_in_t fn)
+{
+    sim_bloquear();
+    usb.iso_in[ep & 0xF] = fn;
+    usb.iso_cada[ep & 0xF] = cada ? cada : 1;
+    iso_cambio();
+    sim_desbloquear();
+}
+
+void sim_usb_deriva(int32_t ppm)
+{
+    sim_bloquear();
+    usb.ppm = ppm;
+    sim_desbloquear();
+}
+
+uint32_t sim_usb_iso_perdidos(void)
+{
+    return usb.iso_perdidos;
+}
+
+void sim_usb_iniciar(void)
+{
+    usb.host_prox = SIM_NUNCA;
+    usb.sof_prox = SIM_NUNCA;
+    usb.re_ep = 3;
+    usb.ep[0].nbuf = usb.ep[1].nbuf = 1;
+    usb.ep[0].max = usb.ep[1].max = 8;
+}
@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+"""
+bench_compare.py - Compara dos reportes de "make bench".
+
+PARA QUE SIRVE
+--------------
+"make bench" corre el camino caliente de cada driver (SSP_ReadWrite,
+UART_Send, I2C_MasterTransferData, EMAC_ReadPacketBuffer, EMAC_CRC32,
+GPIO_SetValue, el checksum, la entrada TCP, la tabla ARP y el envio de
+un archivo por TCP de uIP) contra los modelos del simulador y deja un JSON con ciclos,
+instrucciones y accesos a registros por unidad (byte o llamada).
+
+Los numeros salen del simulador, no de un cronometro: dos corridas del
+mismo codigo dan exactamente el mismo JSON. Por eso tiene sentido
+guardarse el reporte de antes de un cambio y compararlo con el de despues:
+cualquier diferencia la causo el cambio.
+
+USO
+---
+    make bench
+    cp build/bench/bench.json /tmp/antes.json
+    ... cambiar un driver ...
+    make bench
+    python3 tools/bench_compare.py /tmp/antes.json build/bench/bench.json
+
+Devuelve 1 si alguna metrica empeoro mas que el umbral (--umbral, en %,
+por defecto 2) o si algun benchmark dejo de verificar; 0 si no.
+"""
+
+import argparse
+import json
+import sys
+
+METRICAS = ("ciclos_por_unidad", "instrucciones_por_unidad",
+            "accesos_por_unidad")
+CORTAS = {"ciclos_por_unidad": "ciclos/u",
+          "instrucciones_por_unidad": "instr/u",
+          "accesos_por_unidad": "accesos/u"}
+
+
+def cargar(ruta):
+    """Lee un reporte y lo devuelve indexado por nombre de benchmark."""
+    try:
+        with open(ruta) as f:
+            reporte = json.load(f)
+    except FileNotFoundError:
+        raise SystemExit(f"bench_compare: no existe el archivo {ruta}")
+    except json.JSONDecodeError as e:
+        raise SystemExit(f"bench_compare: {ruta} no es JSON valido ({e})")
+
+    if reporte.get("formato") != 1:
+        raise SystemExit(f"bench_compare: {ruta}: formato de reporte "
+                         f"desconocido ({reporte.get('formato')})")
+    return {b["nombre"]: b for b in reporte["benchmarks"]}
+
+
+def variacion(antes, despues):
+    """Cambio relativo en %; None si no se puede calcular."""
+    if antes == 0:
+        return None if despues == 0 else float("inf")
+    return 100.0 * (despues - antes) / antes
+
+
+def comparar(antes, despues, umbral):
+    peores = []
+
+    print(f"{'benchmark':<18} {'metrica':<10} {'antes':>12} "
+          f"{'despues':>12} {'cambio':>9}")
+    for nombre in list(antes) + [n for n in despues if n not in antes]:
+        if nombre not in despues:
+            print(f"{nombre:<18} (ya no esta en el reporte nuevo)")
+            continue
+        if nombre not in antes:
+            print(f"{nombre:<18} (nuevo)")
+            continue
+
+        a, d = antes[nombre], despues[nombre]
+        for m in METRICAS:
+            v = variacion(a[m], d[m])
+            texto = "=" if v is None or v == 0 else f"{v:+.2f}%"
+            marca = ""
+            if v is not None and v > umbral:
+                marca = "  <-- peor"
+                peores.append(f"{nombre} {CORTAS[m]}")
+            print(f"{nombre:<18} {CORTAS[m]:<10} {a[m]:>12.2f} "
+                  f"{d[m]:>12.2f} {texto:>9}{marca}")
+        if a.get("ok") and not d.get("ok"):
+            print(f"{nombre:<18} dejo de verificar  <-- ERROR")
+            peores.append(f"{nombre} (verificacion)")
+
+    if peores:
+        print(f"\nbench_compare: {len(peores)} regresion(es) por encima "
+              f"de {umbral:g}%: " + ", ".join(peores))
+        return 1
+    print(f"\nbench_compare: sin regresiones por encima de {umbral:g}%")
+    return 0
+
+
+def main():
+    p = argparse.ArgumentParser(
+        description="Compara dos reportes de 'make bench' y avisa si algun "
+                    "driver se puso mas lento.")
+    p.add_argument("antes", help="reporte de referencia (JSON)")
+    p.add_argument("despues", help="reporte nuevo (JSON)")
+    p.add_argument("--umbral", type=float, default=2.0,
+                   help="empeoramiento tolerado, en %% (por defecto 2)")
+    args = p.parse_args()
+
+    return comparar(cargar(args.antes), cargar(args.despues), args.umbral)
+
+
+if __name__ == "__main__":
+    sys.exit(main())